@@ -12,7 +12,7 @@ float Gaussian( float x, float d )
 
 kernel void downsampleAndThreshold(texture2d<float, access::read> colorTexture [[texture(0)]],
                   texture2d<float, access::write> downsampledBrightTexture [[texture(1)]],
-                  constant Uniforms& uniforms [[ buffer(0) ]],
+                  constant ObjectUniforms& objectUniforms [[ buffer(0) ]],
                   ushort2 gid [[thread_position_in_grid]],
                   ushort2 tid [[thread_position_in_threadgroup]],
                   ushort2 dtid [[threadgroup_position_in_grid]])
@@ -26,7 +26,7 @@ kernel void downsampleAndThreshold(texture2d<float, access::read> colorTexture [
 
 kernel void blur(texture2d<float, access::read> inputTexture [[texture(0)]],
                   texture2d<float, access::write> resultTexture [[texture(1)]],
-                  constant Uniforms& uniforms [[ buffer(0) ]],
+                  constant FrameUniforms& frameUniforms [[ buffer(12) ]],
                   ushort2 gid [[thread_position_in_grid]],
                   ushort2 tid [[thread_position_in_threadgroup]],
                   ushort2 dtid [[threadgroup_position_in_grid]])
@@ -37,7 +37,7 @@ kernel void blur(texture2d<float, access::read> inputTexture [[texture(0)]],
     const int radius = 13;
     for (int x = 0; x < radius; ++x)
     {
-        const float4 color = inputTexture.read( gid + ushort2( x * uniforms.tilesXY.z - radius / 2, x * uniforms.tilesXY.w - radius / 2 ) );
+        const float4 color = inputTexture.read( gid + ushort2( x * frameUniforms.tilesXY.z - radius / 2, x * frameUniforms.tilesXY.w - radius / 2 ) );
         accumColor += color;
     }
     
@@ -50,7 +50,7 @@ kernel void blur(texture2d<float, access::read> inputTexture [[texture(0)]],
 
     for (int x = 0; x < 9; ++x)
     {
-        const float4 color = inputTexture.read( gid + ushort2( x * uniforms.tilesXY.z - 5, x * uniforms.tilesXY.w - 5 ) ) * weights[ x ];
+        const float4 color = inputTexture.read( gid + ushort2( x * frameUniforms.tilesXY.z - 5, x * frameUniforms.tilesXY.w - 5 ) ) * weights[ x ];
         accumColor += color;
     }*/
     
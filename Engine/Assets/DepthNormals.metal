@@ -3,11 +3,7 @@
 
 using namespace metal;
 
-struct Uniforms
-{
-    matrix_float4x4 localToClip;
-    matrix_float4x4 localToView;
-};
+#include "MetalCommon.h"
 
 struct Vertex
 {
@@ -24,15 +20,30 @@ struct ColorInOut
 };
 
 vertex ColorInOut depthnormals_vertex( Vertex vert [[stage_in]],
-                                       constant Uniforms& uniforms [[ buffer(5) ]])
+                                       constant ObjectUniforms& objectUniforms [[ buffer(5) ]])
 {
     ColorInOut out;
     
     float4 in_position = float4( vert.position.xyz, 1.0 );
     float4 in_normal = float4( vert.normal.xyz, 0.0 );
-    out.position = uniforms.localToClip * in_position;
-    out.mvPosition = uniforms.localToView * in_position;
-    out.normal = uniforms.localToView * in_normal;
+    out.position = objectUniforms.localToClip * in_position;
+    out.mvPosition = objectUniforms.localToView * in_position;
+    out.normal = objectUniforms.localToView * in_normal;
+    return out;
+}
+
+vertex ColorInOut depthnormals_instanced_vertex( Vertex vert [[stage_in]],
+                                                 constant ObjectUniforms& objectUniforms [[ buffer(5) ]],
+                                                 constant SkinUniforms& skinUniforms [[ buffer(15) ]],
+                                                 unsigned int instance [[ instance_id ]])
+{
+    ColorInOut out;
+    
+    float4 in_position = skinUniforms.boneMatrices[ instance ] * float4( vert.position.xyz, 1.0 );
+    float4 in_normal = skinUniforms.boneMatrices[ instance ] * float4( vert.normal.xyz, 0.0 );
+    out.position = objectUniforms.localToClip * in_position;
+    out.mvPosition = objectUniforms.localToView * in_position;
+    out.normal = objectUniforms.localToView * in_normal;
     return out;
 }
 
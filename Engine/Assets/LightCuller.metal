@@ -35,7 +35,9 @@ struct PointLight
 };
 
 kernel void light_culler(texture2d<float, access::read> depthNormalsTexture [[texture(0)]],
-                         constant Uniforms& uniforms [[ buffer(0) ]],
+                         constant ObjectUniforms& objectUniforms [[ buffer(0) ]],
+                         constant FrameUniforms& frameUniforms [[ buffer(12) ]],
+                         constant CameraUniforms& cameraUniforms [[ buffer(13) ]],
                          const device float4* pointLightBufferCenterAndRadius [[ buffer(1) ]],
                          device uint* perTileLightIndexBufferOut [[ buffer(2) ]],
                          const device float4* spotLightBufferCenterAndRadius [[ buffer(3) ]],
@@ -54,7 +56,7 @@ kernel void light_culler(texture2d<float, access::read> depthNormalsTexture [[te
     ushort2 groupIdx = dtid;
 
     uint localIdxFlattened = localIdx.x + localIdx.y * TILE_RES;
-    uint tileIdxFlattened = groupIdx.x + groupIdx.y * uniforms.tilesXY.x;
+    uint tileIdxFlattened = groupIdx.x + groupIdx.y * frameUniforms.tilesXY.x;
 
     if (localIdxFlattened == 0)
     {
@@ -74,8 +76,8 @@ kernel void light_culler(texture2d<float, access::read> depthNormalsTexture [[te
         uint pyp = TILE_RES * (groupIdx.y + 1);
 
         // Evenly divisible by tile res
-        float winWidth  = float( TILE_RES * uniforms.tilesXY.x );
-        float winHeight = float( TILE_RES * uniforms.tilesXY.y );
+        float winWidth  = float( TILE_RES * frameUniforms.tilesXY.x );
+        float winHeight = float( TILE_RES * frameUniforms.tilesXY.y );
 
         float4 v0 = float4( pxm / winWidth * 2.0f - 1.0f, (winHeight - pym) / winHeight * 2.0f - 1.0f, 1.0f, 1.0f );
         float4 v1 = float4( pxp / winWidth * 2.0f - 1.0f, (winHeight - pym) / winHeight * 2.0f - 1.0f, 1.0f, 1.0f );
@@ -84,10 +86,10 @@ kernel void light_culler(texture2d<float, access::read> depthNormalsTexture [[te
 
         // four corners of the tile, clockwise from top-left
         float4 frustum[ 4 ];
-        frustum[ 0 ] = ConvertClipToView( v0, uniforms.clipToView );
-        frustum[ 1 ] = ConvertClipToView( v1, uniforms.clipToView );
-        frustum[ 2 ] = ConvertClipToView( v2, uniforms.clipToView );
-        frustum[ 3 ] = ConvertClipToView( v3, uniforms.clipToView );
+        frustum[ 0 ] = ConvertClipToView( v0, cameraUniforms.clipToView );
+        frustum[ 1 ] = ConvertClipToView( v1, cameraUniforms.clipToView );
+        frustum[ 2 ] = ConvertClipToView( v2, cameraUniforms.clipToView );
+        frustum[ 3 ] = ConvertClipToView( v3, cameraUniforms.clipToView );
 
         // create plane equations for the four sides of the frustum,
         // with the positive half-space outside the frustum (and remember,
@@ -124,7 +126,7 @@ kernel void light_culler(texture2d<float, access::read> depthNormalsTexture [[te
     float maxZ = as_type< float >( zMin );
 #endif
     
-    int numPointLights = uniforms.numLights & 0xFFFFu;
+    int numPointLights = frameUniforms.numLights & 0xFFFFu;
 
     for (int i = 0; i < numPointLights; i += NUM_THREADS_PER_TILE)
     {
@@ -134,7 +136,7 @@ kernel void light_culler(texture2d<float, access::read> depthNormalsTexture [[te
         {
             float4 center = pointLightBufferCenterAndRadius[ il ];
             float radius = center.w;
-            center.xyz = (uniforms.localToView * float4( center.xyz, 1.0f ) ).xyz;
+            center.xyz = (objectUniforms.localToView * float4( center.xyz, 1.0f ) ).xyz;
 
 #if USE_MINMAX_Z
             if (-center.z + minZ < radius && center.z - maxZ < radius)
@@ -161,7 +163,7 @@ kernel void light_culler(texture2d<float, access::read> depthNormalsTexture [[te
     int numPointLightsInThisTile = atomic_load_explicit( &ldsLightIdxCounter, memory_order::memory_order_relaxed );
 
     // Spot lights.
-    int numSpotLights = (uniforms.numLights & 0xFFFF0000u) >> 16;
+    int numSpotLights = (frameUniforms.numLights & 0xFFFF0000u) >> 16;
 
     for (int i = 0; i < numSpotLights; i += NUM_THREADS_PER_TILE)
     {
@@ -171,7 +173,7 @@ kernel void light_culler(texture2d<float, access::read> depthNormalsTexture [[te
         {
             float4 center = spotLightBufferCenterAndRadius[ il ];
             float radius = center.w * 10.0f; // FIXME: Multiply was added, but more clever culling should be done instead.
-            center.xyz = (uniforms.localToView * float4( center.xyz, 1.0f )).xyz;
+            center.xyz = (objectUniforms.localToView * float4( center.xyz, 1.0f )).xyz;
 #if USE_MINMAX_Z
             if (-center.z + minZ < radius && center.z - maxZ < radius)
 #endif
@@ -190,7 +192,7 @@ kernel void light_culler(texture2d<float, access::read> depthNormalsTexture [[te
     threadgroup_barrier( mem_flags::mem_threadgroup );
 
     {   // write back
-        int startOffset = uniforms.maxNumLightsPerTile * tileIdxFlattened;
+        int startOffset = frameUniforms.maxNumLightsPerTile * tileIdxFlattened;
 
         for (int i = localIdxFlattened; i < numPointLightsInThisTile; i += NUM_THREADS_PER_TILE)
         {
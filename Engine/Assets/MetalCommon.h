@@ -1,26 +1,44 @@
 #include <simd/simd.h>
 
-struct Uniforms
+// Uniform blocks, split by how often they change. Must match PerObjectUboStruct in GfxDevice.hpp.
+// Graphics functions read the object block at buffer(5) and the others at buffer(12)-buffer(15).
+// Compute kernels read the object block at buffer(0).
+struct FrameUniforms
+{
+    uint windowWidth;
+    uint windowHeight;
+    uint numLights; // 16 bits for point light count, 16 for spot light count
+    uint maxNumLightsPerTile;
+    float4 tilesXY;
+    float minAmbient;
+    int isVR;
+};
+
+struct CameraUniforms
 {
-    matrix_float4x4 localToClip;
-    matrix_float4x4 localToView;
-    matrix_float4x4 localToWorld;
-    matrix_float4x4 localToShadowClip;
     matrix_float4x4 clipToView;
     float4 lightPosition;
     float4 lightDirection;
     float4 lightColor;
     float lightConeAngle;
     int lightType; // 0: None, 1: Spot, 2: Dir, 3: Point
-    float minAmbient;
-    uint maxNumLightsPerTile;
-    uint windowWidth;
-    uint windowHeight;
-    uint numLights; // 16 bits for point light count, 16 for spot light count
-    float f0;
+};
+
+struct MaterialUniforms
+{
     float4 tex0scaleOffset;
-    float4 tilesXY;
-    matrix_float4x4 boneMatrices[ 80 ];
-    int isVR;
+    float f0;
+};
+
+struct ObjectUniforms
+{
+    matrix_float4x4 localToClip;
+    matrix_float4x4 localToView;
+    matrix_float4x4 localToWorld;
+    matrix_float4x4 localToShadowClip;
 };
 
+struct SkinUniforms
+{
+    matrix_float4x4 boneMatrices[ 80 ];
+};
@@ -23,19 +23,21 @@ struct ColorInOut
 };
 
 vertex ColorInOut moments_skin_vertex( VertexSkin vert [[stage_in]],
-                                       constant Uniforms& uniforms [[ buffer(5) ]])
+                                       constant ObjectUniforms& objectUniforms [[ buffer(5) ]],
+                                       constant CameraUniforms& cameraUniforms [[ buffer(13) ]],
+                                       constant SkinUniforms& skinUniforms [[ buffer(15) ]])
 {
     ColorInOut out;
     
     float4 in_position = float4( vert.position, 1.0 );
      
-     float4 position2 = uniforms.boneMatrices[ vert.boneIndex.x ] * in_position * vert.boneWeights.x;
-     position2 += uniforms.boneMatrices[ vert.boneIndex.y ] * in_position * vert.boneWeights.y;
-     position2 += uniforms.boneMatrices[ vert.boneIndex.z ] * in_position * vert.boneWeights.z;
-     position2 += uniforms.boneMatrices[ vert.boneIndex.w ] * in_position * vert.boneWeights.w;
-     out.position = uniforms.localToClip * position2;
+     float4 position2 = skinUniforms.boneMatrices[ vert.boneIndex.x ] * in_position * vert.boneWeights.x;
+     position2 += skinUniforms.boneMatrices[ vert.boneIndex.y ] * in_position * vert.boneWeights.y;
+     position2 += skinUniforms.boneMatrices[ vert.boneIndex.z ] * in_position * vert.boneWeights.z;
+     position2 += skinUniforms.boneMatrices[ vert.boneIndex.w ] * in_position * vert.boneWeights.w;
+     out.position = objectUniforms.localToClip * position2;
     
-    if (uniforms.lightType == 2)
+    if (cameraUniforms.lightType == 2)
     {
         out.position.z = out.position.z * 0.5f + 0.5f; // -1..1 to 0..1 conversion
     }
@@ -44,14 +46,34 @@ vertex ColorInOut moments_skin_vertex( VertexSkin vert [[stage_in]],
 }
 
 vertex ColorInOut moments_vertex(Vertex vert [[stage_in]],
-                               constant Uniforms& uniforms [[ buffer(5) ]])
+                               constant ObjectUniforms& objectUniforms [[ buffer(5) ]],
+                               constant CameraUniforms& cameraUniforms [[ buffer(13) ]])
 {
     ColorInOut out;
 
     float4 in_position = float4( vert.position, 1.0 );
-    out.position = uniforms.localToClip * in_position;
+    out.position = objectUniforms.localToClip * in_position;
 
-    if (uniforms.lightType == 2)
+    if (cameraUniforms.lightType == 2)
+    {
+        out.position.z = out.position.z * 0.5f + 0.5f; // -1..1 to 0..1 conversion
+    }
+    
+    return out;
+}
+
+vertex ColorInOut moments_instanced_vertex(Vertex vert [[stage_in]],
+                               constant ObjectUniforms& objectUniforms [[ buffer(5) ]],
+                               constant CameraUniforms& cameraUniforms [[ buffer(13) ]],
+                               constant SkinUniforms& skinUniforms [[ buffer(15) ]],
+                               unsigned int instance [[ instance_id ]])
+{
+    ColorInOut out;
+
+    float4 in_position = skinUniforms.boneMatrices[ instance ] * float4( vert.position, 1.0 );
+    out.position = objectUniforms.localToClip * in_position;
+
+    if (cameraUniforms.lightType == 2)
     {
         out.position.z = out.position.z * 0.5f + 0.5f; // -1..1 to 0..1 conversion
     }
@@ -3,7 +3,7 @@
 
 using namespace metal;
 
-struct Uniforms
+struct ObjectUniforms
 {
     matrix_float4x4 localToClip;
 };
@@ -24,12 +24,12 @@ struct Vertex
 constexpr sampler samp( coord::normalized, address::repeat, filter::linear );
 
 vertex ColorInOut skybox_vertex( Vertex vert [[stage_in]],
-                                constant Uniforms& uniforms [[ buffer(5) ]])
+                                constant ObjectUniforms& objectUniforms [[ buffer(5) ]])
 {
     ColorInOut out;
 
     float4 in_position = float4( vert.position, 1.0 );
-    out.position = uniforms.localToClip * in_position;
+    out.position = objectUniforms.localToClip * in_position;
 
     out.texCoords = vert.position;
     return out;
@@ -22,14 +22,15 @@ struct ColorInOut
 constexpr sampler s( coord::normalized, address::repeat, filter::linear );
 
 vertex ColorInOut sprite_vertex(Vertex vert [[stage_in]],
-                                constant Uniforms& uniforms [[ buffer(5) ]])
+                                constant ObjectUniforms& objectUniforms [[ buffer(5) ]],
+                                constant CameraUniforms& cameraUniforms [[ buffer(13) ]])
 {
     ColorInOut out;
     
     float4 in_position = float4( float3( vert.position ), 1.0 );
-    out.position = uniforms.localToClip * in_position;
+    out.position = objectUniforms.localToClip * in_position;
     
-    out.color = half4( vert.color * uniforms.lightColor );
+    out.color = half4( vert.color * cameraUniforms.lightColor );
     out.texCoords = vert.texcoord;
     return out;
 }
@@ -75,25 +75,54 @@ float3 tangentSpaceTransform( float3 tangent, float3 bitangent, float3 normal, f
 }
 
 vertex StandardColorInOut standard_vertex( StandardVertex vert [[stage_in]],
-                               constant Uniforms& uniforms [[ buffer(5) ]],
+                               constant ObjectUniforms& objectUniforms [[ buffer(5) ]],
                                unsigned int vid [[ vertex_id ]] )
 {
     StandardColorInOut out;
     
     float4 in_position = float4( vert.position, 1.0 );
-    out.position = uniforms.localToClip * in_position;
-    out.positionVS = (uniforms.localToView * in_position).xyz;
-    out.positionWS = (uniforms.localToWorld * in_position).xyz;
+    out.position = objectUniforms.localToClip * in_position;
+    out.positionVS = (objectUniforms.localToView * in_position).xyz;
+    out.positionWS = (objectUniforms.localToWorld * in_position).xyz;
     
     out.color = half4( vert.color );
-    out.projCoord = uniforms.localToShadowClip * in_position;
+    out.projCoord = objectUniforms.localToShadowClip * in_position;
     
-    out.tangentVS_u.xyz = (uniforms.localToView * float4( vert.tangent.xyz, 0 )).xyz;
+    out.tangentVS_u.xyz = (objectUniforms.localToView * float4( vert.tangent.xyz, 0 )).xyz;
     out.tangentVS_u.w = vert.texcoord.x;
     float3 ct = cross( vert.normal, vert.tangent.xyz ) * vert.tangent.w;
-    out.bitangentVS_v.xyz = normalize( uniforms.localToView * float4( ct, 0 ) ).xyz;
+    out.bitangentVS_v.xyz = normalize( objectUniforms.localToView * float4( ct, 0 ) ).xyz;
     out.bitangentVS_v.w = vert.texcoord.y;
-    out.normalVS = (uniforms.localToView * float4( vert.normal, 0 )).xyz;
+    out.normalVS = (objectUniforms.localToView * float4( vert.normal, 0 )).xyz;
+    
+    return out;
+}
+
+// Instanced draws store world-to-X matrices in localToX and instance localToWorld matrices in boneMatrices.
+vertex StandardColorInOut standard_instanced_vertex( StandardVertex vert [[stage_in]],
+                               constant ObjectUniforms& objectUniforms [[ buffer(5) ]],
+                               constant SkinUniforms& skinUniforms [[ buffer(15) ]],
+                               unsigned int instance [[ instance_id ]] )
+{
+    StandardColorInOut out;
+    
+    const matrix_float4x4 localToWorld = skinUniforms.boneMatrices[ instance ];
+    float4 in_position = localToWorld * float4( vert.position, 1.0 );
+    float3 normal = (localToWorld * float4( vert.normal, 0 )).xyz;
+    float3 tangent = (localToWorld * float4( vert.tangent.xyz, 0 )).xyz;
+    out.position = objectUniforms.localToClip * in_position;
+    out.positionVS = (objectUniforms.localToView * in_position).xyz;
+    out.positionWS = in_position.xyz;
+    
+    out.color = half4( vert.color );
+    out.projCoord = objectUniforms.localToShadowClip * in_position;
+    
+    out.tangentVS_u.xyz = (objectUniforms.localToView * float4( tangent, 0 )).xyz;
+    out.tangentVS_u.w = vert.texcoord.x;
+    float3 ct = cross( normal, tangent ) * vert.tangent.w;
+    out.bitangentVS_v.xyz = normalize( objectUniforms.localToView * float4( ct, 0 ) ).xyz;
+    out.bitangentVS_v.w = vert.texcoord.y;
+    out.normalVS = (objectUniforms.localToView * float4( normal, 0 )).xyz;
     
     return out;
 }
@@ -138,7 +167,10 @@ fragment half4 standard_fragment( StandardColorInOut in [[stage_in]],
                                texture2d<float, access::sample> normalMap [[texture(2)]],
                                texture2d<float, access::sample> specularMap [[texture(3)]],
                                texturecube<float, access::sample> cubeMap [[texture(4)]],
-                               constant Uniforms& uniforms [[ buffer(5) ]],
+                               constant ObjectUniforms& objectUniforms [[ buffer(5) ]],
+                               constant FrameUniforms& frameUniforms [[ buffer(12) ]],
+                               constant CameraUniforms& cameraUniforms [[ buffer(13) ]],
+                               constant MaterialUniforms& materialUniforms [[ buffer(14) ]],
                                const device uint* perTileLightIndexBuffer [[ buffer(6) ]],
                                const device float4* pointLightBufferCenterAndRadius [[ buffer(7) ]],
                                const device float4* spotLightBufferCenterAndRadius [[ buffer(8) ]],
@@ -154,7 +186,7 @@ fragment half4 standard_fragment( StandardColorInOut in [[stage_in]],
     //const float4 specular = float4( specularMap.sample( sampler0, uv ) );
     
     const float3 normalVS = tangentSpaceTransform( in.tangentVS_u.xyz, in.bitangentVS_v.xyz, in.normalVS, normalTS.xyz );
-    const float3 surfaceToDirectionalLightVS = -uniforms.lightDirection.xyz;
+    const float3 surfaceToDirectionalLightVS = -cameraUniforms.lightDirection.xyz;
 
     const float3 N = normalize( normalVS );
     const float3 V = normalize( in.positionVS.xyz );
@@ -168,7 +200,7 @@ fragment half4 standard_fragment( StandardColorInOut in [[stage_in]],
     const float dotLH = saturate( dot( L, H ) );
     const float dotNH = saturate( dot( N, H ) );
     
-    const float3 f0 = float3( uniforms.f0, uniforms.f0, uniforms.f0 );
+    const float3 f0 = float3( materialUniforms.f0, materialUniforms.f0, materialUniforms.f0 );
     
     const float roughness = 0.5f;
     const float a = roughness * roughness;
@@ -180,11 +212,11 @@ fragment half4 standard_fragment( StandardColorInOut in [[stage_in]],
 
     float4 ambient = float4( 0.1f, 0.1f, 0.1f, 1.0f );
 
-    const int tileIndex = GetTileIndex( in.position.xy, uniforms.windowWidth );
-    int index = uniforms.maxNumLightsPerTile * tileIndex;
+    const int tileIndex = GetTileIndex( in.position.xy, frameUniforms.windowWidth );
+    int index = frameUniforms.maxNumLightsPerTile * tileIndex;
     int nextLightIndex = perTileLightIndexBuffer[ index ];
 
-    float4 outColor = uniforms.lightColor;
+    float4 outColor = cameraUniforms.lightColor;
     outColor = ambient * float4( albedoColor ) + outColor * float4( albedoColor ) + max( 0.0f, dotNL );
     
     while (nextLightIndex != LIGHT_INDEX_BUFFER_SENTINEL)
@@ -200,7 +232,7 @@ fragment half4 standard_fragment( StandardColorInOut in [[stage_in]],
         
         if (lightDistance < radius)
         {
-            const float3 vecToLightVS = (uniforms.localToView * float4( vecToLightWS, 0 )).xyz;
+            const float3 vecToLightVS = (objectUniforms.localToView * float4( vecToLightWS, 0 )).xyz;
             const float3 L = normalize( -vecToLightVS );
             const float3 H = normalize( L + V );
             
@@ -208,7 +240,7 @@ fragment half4 standard_fragment( StandardColorInOut in [[stage_in]],
             const float dotLH = saturate( dot( L, H ) );
             const float dotNH = saturate( dot( N, H ) );
             
-            const float3 f0 = float3( uniforms.f0 );
+            const float3 f0 = float3( materialUniforms.f0 );
             
             const float roughness = 0.5f;
             const float a = roughness * roughness;
@@ -247,10 +279,10 @@ fragment half4 standard_fragment( StandardColorInOut in [[stage_in]],
         outColor.rgb += accumDiffuseAndSpecular;
     }
     
-	outColor.rgb = max( outColor.rgb, float3( uniforms.minAmbient, uniforms.minAmbient, uniforms.minAmbient ) );
+	outColor.rgb = max( outColor.rgb, float3( frameUniforms.minAmbient, frameUniforms.minAmbient, frameUniforms.minAmbient ) );
 
 #ifdef DEBUG_LIGHT_COUNT
-    const int numLights = GetNumLightsInThisTile( tileIndex, uniforms.maxNumLightsPerTile, perTileLightIndexBuffer );
+    const int numLights = GetNumLightsInThisTile( tileIndex, frameUniforms.maxNumLightsPerTile, perTileLightIndexBuffer );
 
     if (numLights == 0)
     {
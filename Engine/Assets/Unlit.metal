@@ -48,17 +48,37 @@ struct Vertex
 };
 
 vertex ColorInOut unlit_vertex(Vertex vert [[stage_in]],
-                               constant Uniforms& uniforms [[ buffer(5) ]])
+                               constant ObjectUniforms& objectUniforms [[ buffer(5) ]],
+                               constant MaterialUniforms& materialUniforms [[ buffer(14) ]])
 {
     ColorInOut out;
 
     float4 in_position = float4( vert.position, 1.0 );
     
-    out.position = uniforms.localToClip * in_position;
+    out.position = objectUniforms.localToClip * in_position;
     out.color = half4( vert.color );
-    out.texCoords = vert.texcoord * uniforms.tex0scaleOffset.xy + uniforms.tex0scaleOffset.wz;
+    out.texCoords = vert.texcoord * materialUniforms.tex0scaleOffset.xy + materialUniforms.tex0scaleOffset.wz;
     out.tintColor = float4( 1, 1, 1, 1 );
-    out.projCoord = uniforms.localToShadowClip * in_position;
+    out.projCoord = objectUniforms.localToShadowClip * in_position;
+    return out;
+}
+
+// Instanced draws store world-to-X matrices in localToX and instance localToWorld matrices in boneMatrices.
+vertex ColorInOut unlit_instanced_vertex(Vertex vert [[stage_in]],
+                               constant ObjectUniforms& objectUniforms [[ buffer(5) ]],
+                               constant MaterialUniforms& materialUniforms [[ buffer(14) ]],
+                               constant SkinUniforms& skinUniforms [[ buffer(15) ]],
+                               unsigned int instance [[ instance_id ]])
+{
+    ColorInOut out;
+
+    float4 in_position = skinUniforms.boneMatrices[ instance ] * float4( vert.position, 1.0 );
+    
+    out.position = objectUniforms.localToClip * in_position;
+    out.color = half4( vert.color );
+    out.texCoords = vert.texcoord * materialUniforms.tex0scaleOffset.xy + materialUniforms.tex0scaleOffset.wz;
+    out.tintColor = float4( 1, 1, 1, 1 );
+    out.projCoord = objectUniforms.localToShadowClip * in_position;
     return out;
 }
 
@@ -66,14 +86,14 @@ fragment float4 unlit_fragment( ColorInOut in [[stage_in]],
                                texture2d<float, access::sample> textureMap [[texture(0)]],
                                texture2d<float, access::sample> _ShadowMap [[texture(1)]],
                                texturecube<float, access::sample> _ShadowMapCube [[texture(2)]],
-                               constant Uniforms& uniforms [[ buffer(5) ]],
+                               constant CameraUniforms& cameraUniforms [[ buffer(13) ]],
                                sampler sampler0 [[sampler(0)]] )
 {
     float4 sampledColor = textureMap.sample( sampler0, in.texCoords ) * in.tintColor;
 
     float depth = in.projCoord.z / in.projCoord.w;
 
-    if (uniforms.lightType == 2)
+    if (cameraUniforms.lightType == 2)
     {
         depth = depth * 0.5f + 0.5f;
     }
@@ -28,22 +28,23 @@ struct Vertex
 };
 
 vertex ColorInOut unlit_skin_vertex(Vertex vert [[stage_in]],
-                               constant Uniforms& uniforms [[ buffer(5) ]])
+                               constant ObjectUniforms& objectUniforms [[ buffer(5) ]],
+                               constant SkinUniforms& skinUniforms [[ buffer(15) ]])
 {
     ColorInOut out;
 
     float4 in_position = float4( vert.position, 1.0 );
     
-    float4 position2 = uniforms.boneMatrices[ vert.boneIndex.x ] * in_position * vert.boneWeights.x;
-    position2 += uniforms.boneMatrices[ vert.boneIndex.y ] * in_position * vert.boneWeights.y;
-    position2 += uniforms.boneMatrices[ vert.boneIndex.z ] * in_position * vert.boneWeights.z;
-    position2 += uniforms.boneMatrices[ vert.boneIndex.w ] * in_position * vert.boneWeights.w;
-    out.position = uniforms.localToClip * position2;
+    float4 position2 = skinUniforms.boneMatrices[ vert.boneIndex.x ] * in_position * vert.boneWeights.x;
+    position2 += skinUniforms.boneMatrices[ vert.boneIndex.y ] * in_position * vert.boneWeights.y;
+    position2 += skinUniforms.boneMatrices[ vert.boneIndex.z ] * in_position * vert.boneWeights.z;
+    position2 += skinUniforms.boneMatrices[ vert.boneIndex.w ] * in_position * vert.boneWeights.w;
+    out.position = objectUniforms.localToClip * position2;
 
     out.color = half4( vert.color );
     out.texCoords = vert.texcoord;
     out.tintColor = float4( 1, 1, 1, 1 );
-    out.projCoord = uniforms.localToShadowClip * in_position;
+    out.projCoord = objectUniforms.localToShadowClip * in_position;
     return out;
 }
 
@@ -1,8 +1,10 @@
 "C:\Program Files (x86)\Windows Kits\10\bin\10.0.17134.0\x64\fxc" /nologo /all_resources_bound /Ges /WX /O3 /Zi /T ps_5_1 /Fo ..\..\..\aether3d_build\Samples\depthnormals_frag.obj hlsl\depthnormals_frag.hlsl
 "C:\Program Files (x86)\Windows Kits\10\bin\10.0.17134.0\x64\fxc" /nologo /all_resources_bound /Ges /WX /O3 /Zi /T vs_5_1 /Fo ..\..\..\aether3d_build\Samples\depthnormals_vert.obj hlsl\depthnormals_vert.hlsl
+"C:\Program Files (x86)\Windows Kits\10\bin\10.0.17134.0\x64\fxc" /nologo /all_resources_bound /Ges /WX /O3 /Zi /T vs_5_1 /Fo ..\..\..\aether3d_build\Samples\depthnormals_instanced_vert.obj hlsl\depthnormals_instanced_vert.hlsl
 
 "C:\Program Files (x86)\Windows Kits\10\bin\10.0.17134.0\x64\fxc" /nologo /all_resources_bound /Ges /WX /O3 /Zi /T ps_5_1 /Fo ..\..\..\aether3d_build\Samples\moments_frag.obj hlsl\moments_frag.hlsl
 "C:\Program Files (x86)\Windows Kits\10\bin\10.0.17134.0\x64\fxc" /nologo /all_resources_bound /Ges /WX /O3 /Zi /T vs_5_1 /Fo ..\..\..\aether3d_build\Samples\moments_vert.obj hlsl\moments_vert.hlsl
+"C:\Program Files (x86)\Windows Kits\10\bin\10.0.17134.0\x64\fxc" /nologo /all_resources_bound /Ges /WX /O3 /Zi /T vs_5_1 /Fo ..\..\..\aether3d_build\Samples\moments_instanced_vert.obj hlsl\moments_instanced_vert.hlsl
 "C:\Program Files (x86)\Windows Kits\10\bin\10.0.17134.0\x64\fxc" /nologo /all_resources_bound /Ges /WX /O3 /Zi /T vs_5_1 /Fo ..\..\..\aether3d_build\Samples\moments_skin_vert.obj hlsl\moments_skin_vert.hlsl
 
 "C:\Program Files (x86)\Windows Kits\10\bin\10.0.17134.0\x64\fxc" /nologo /all_resources_bound /Ges /WX /O3 /Zi /T ps_5_1 /Fo ..\..\..\aether3d_build\Samples\sdf_frag.obj hlsl\sdf_frag.hlsl
@@ -16,12 +18,14 @@
 
 "C:\Program Files (x86)\Windows Kits\10\bin\10.0.17134.0\x64\fxc" /nologo /all_resources_bound /Ges /WX /O3 /Zi /T ps_5_1 /Fo ..\..\..\aether3d_build\Samples\Standard_frag.obj hlsl\Standard_frag.hlsl
 "C:\Program Files (x86)\Windows Kits\10\bin\10.0.17134.0\x64\fxc" /nologo /all_resources_bound /Ges /WX /O3 /Zi /T vs_5_1 /Fo ..\..\..\aether3d_build\Samples\Standard_vert.obj hlsl\Standard_vert.hlsl
+"C:\Program Files (x86)\Windows Kits\10\bin\10.0.17134.0\x64\fxc" /nologo /all_resources_bound /Ges /WX /O3 /Zi /T vs_5_1 /Fo ..\..\..\aether3d_build\Samples\Standard_instanced_vert.obj hlsl\Standard_instanced_vert.hlsl
 
 "C:\Program Files (x86)\Windows Kits\10\bin\10.0.17134.0\x64\fxc" /nologo /all_resources_bound /Ges /WX /O3 /Zi /T ps_5_1 /Fo ..\..\..\aether3d_build\Samples\unlit_cube_frag.obj hlsl\unlit_cube_frag.hlsl
 "C:\Program Files (x86)\Windows Kits\10\bin\10.0.17134.0\x64\fxc" /nologo /all_resources_bound /Ges /WX /O3 /Zi /T vs_5_1 /Fo ..\..\..\aether3d_build\Samples\unlit_cube_vert.obj hlsl\unlit_cube_vert.hlsl
 
 "C:\Program Files (x86)\Windows Kits\10\bin\10.0.17134.0\x64\fxc" /nologo /all_resources_bound /Ges /WX /O3 /Zi /T ps_5_1 /Fo ..\..\..\aether3d_build\Samples\unlit_frag.obj hlsl\unlit_frag.hlsl
 "C:\Program Files (x86)\Windows Kits\10\bin\10.0.17134.0\x64\fxc" /nologo /all_resources_bound /Ges /WX /O3 /Zi /T vs_5_1 /Fo ..\..\..\aether3d_build\Samples\unlit_vert.obj hlsl\unlit_vert.hlsl
+"C:\Program Files (x86)\Windows Kits\10\bin\10.0.17134.0\x64\fxc" /nologo /all_resources_bound /Ges /WX /O3 /Zi /T vs_5_1 /Fo ..\..\..\aether3d_build\Samples\unlit_instanced_vert.obj hlsl\unlit_instanced_vert.hlsl
 "C:\Program Files (x86)\Windows Kits\10\bin\10.0.17134.0\x64\fxc" /nologo /all_resources_bound /Ges /WX /O3 /Zi /T vs_5_1 /Fo ..\..\..\aether3d_build\Samples\unlit_skin_vert.obj hlsl\unlit_skin_vert.hlsl
 
 "C:\Program Files (x86)\Windows Kits\10\bin\10.0.17134.0\x64\fxc" /nologo /all_resources_bound /Ges /WX /O3 /Zi /T cs_5_1 /Fo ..\..\..\aether3d_build\Samples\LightCuller.obj /E CSMain hlsl\LightCuller.hlsl
@@ -0,0 +1,64 @@
+#if !VULKAN
+#define layout(a,b)  
+#else
+#define register(a) blank
+#endif
+
+#include "ubo.h"
+#include "indirect.h"
+
+layout(set=1, binding=0) StructuredBuffer< IndirectInstance > instances : register(t3);
+layout(set=1, binding=1) RWStructuredBuffer< IndirectCommand > drawCommands : register(u1);
+layout(set=1, binding=2) RWStructuredBuffer< uint > visibleInstances : register(u2);
+
+bool IsOutsideFrustum( float4 clipCorners[ 8 ] )
+{
+    // A box is outside if all its corners are outside the same clip plane. Testing in clip space needs no divide, so corners behind the camera work too.
+    // Near plane is tested against -w, which is conservative for [0, w] depth ranges.
+    bool allLeft = true, allRight = true, allBelow = true, allAbove = true, allNear = true, allFar = true;
+
+    for (int i = 0; i < 8; ++i)
+    {
+        const float4 c = clipCorners[ i ];
+        allLeft = allLeft && c.x < -c.w;
+        allRight = allRight && c.x > c.w;
+        allBelow = allBelow && c.y < -c.w;
+        allAbove = allAbove && c.y > c.w;
+        allNear = allNear && c.z < -c.w;
+        allFar = allFar && c.z > c.w;
+    }
+
+    return allLeft || allRight || allBelow || allAbove || allNear || allFar;
+}
+
+// localToClip contains worldToClip. Draw commands' instanceCount must be 0 before the dispatch.
+[numthreads( INDIRECT_CULLER_THREADS, 1, 1 )]
+void CSMain( uint3 globalIdx : SV_DispatchThreadID )
+{
+    const IndirectInstance instance = instances[ globalIdx.x ];
+
+    if (instance.drawIndex == INDIRECT_INVALID_DRAW)
+    {
+        return;
+    }
+
+    const float4x4 localToClipInstance = mul( localToClip, instance.localToWorld );
+    float4 clipCorners[ 8 ];
+
+    for (int i = 0; i < 8; ++i)
+    {
+        const float3 corner = float3( (i & 1) ? instance.aabbMax.x : instance.aabbMin.x,
+                                      (i & 2) ? instance.aabbMax.y : instance.aabbMin.y,
+                                      (i & 4) ? instance.aabbMax.z : instance.aabbMin.z );
+        clipCorners[ i ] = mul( localToClipInstance, float4( corner, 1.0f ) );
+    }
+
+    if (IsOutsideFrustum( clipCorners ))
+    {
+        return;
+    }
+
+    uint slot;
+    InterlockedAdd( drawCommands[ instance.drawIndex ].instanceCount, 1, slot );
+    visibleInstances[ drawCommands[ instance.drawIndex ].firstInstance + slot ] = globalIdx.x;
+}
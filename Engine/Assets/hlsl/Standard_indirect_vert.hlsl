@@ -0,0 +1,52 @@
+#if !VULKAN
+#define layout(a,b)  
+#else
+#define register(a) blank
+#endif
+
+#include "ubo.h"
+#include "indirect.h"
+
+layout(set=1, binding=0) StructuredBuffer< IndirectInstance > instances : register(t3);
+layout(set=1, binding=2) StructuredBuffer< uint > visibleInstances : register(t4);
+
+struct VS_INPUT
+{
+    float3 pos : POSITION;
+    float2 uv : TEXCOORD0;
+    float4 color : COLOR;
+    float3 normal : NORMAL;
+    float4 tangent : TANGENT;
+};
+
+struct PS_INPUT
+{
+    float4 pos : SV_Position;
+    float4 positionVS_u : TEXCOORD0;
+    float4 positionWS_v : TEXCOORD1;
+    float3 tangentVS : TANGENT;
+    float3 bitangentVS : BINORMAL;
+    float3 normalVS : NORMAL;
+};
+
+// Indirect draws store worldToClip in localToClip and worldToView in localToView.
+// The instance id includes the draw command's firstInstance, so it indexes visibleInstances directly.
+PS_INPUT main( VS_INPUT input, uint instance : SV_InstanceID )
+{
+    const matrix localToWorldInstance = instances[ visibleInstances[ instance ] ].localToWorld;
+
+    PS_INPUT output = (PS_INPUT)0;
+    float4 position = mul( localToWorldInstance, float4( input.pos, 1.0f ) );
+    float3 normal = mul( localToWorldInstance, float4( input.normal, 0 ) ).xyz;
+    float3 tangent = mul( localToWorldInstance, float4( input.tangent.xyz, 0 ) ).xyz;
+
+    output.pos = mul( localToClip, position );
+    output.positionVS_u = float4( mul( localToView, position ).xyz, input.uv.x );
+    output.positionWS_v = float4( position.xyz, input.uv.y );
+    output.normalVS = mul( localToView, float4( normal, 0 ) ).xyz;
+    output.tangentVS = mul( localToView, float4( tangent, 0 ) ).xyz;
+    float3 ct = cross( normal, tangent ) * input.tangent.w;
+    output.bitangentVS.xyz = mul( localToView, float4( ct, 0 ) ).xyz;
+
+    return output;
+}
@@ -0,0 +1,26 @@
+#if !VULKAN
+#define layout(a,b)  
+#else
+#define register(a) blank
+#endif
+
+struct VSOutput
+{
+    float4 pos : SV_Position;
+    float3 mvPosition : POSITION;
+    float3 normal : NORMAL;
+};
+
+#include "ubo.h"
+
+// Instanced draws store worldToClip in localToClip and worldToView in localToView.
+VSOutput main( float3 pos : POSITION, float3 normal : NORMAL, uint instance : SV_InstanceID )
+{
+    float4 position = mul( boneMatrices[ instance ], float4( pos, 1.0 ) );
+
+    VSOutput vsOut;
+    vsOut.pos = mul( localToClip, position );
+    vsOut.mvPosition = mul( localToView, position ).xyz;
+    vsOut.normal = mul( localToView, mul( boneMatrices[ instance ], float4( normal, 0.0 ) ) ).xyz;
+    return vsOut;
+}
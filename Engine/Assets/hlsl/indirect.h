@@ -0,0 +1,24 @@
+// Layouts shared by IndirectCuller and the indirect vertex shaders. Must match GfxDevice::IndirectInstance and VkDrawIndexedIndirectCommand.
+
+#define INDIRECT_CULLER_THREADS 64
+#define INDIRECT_INVALID_DRAW 0xFFFFFFFF
+
+struct IndirectInstance
+{
+    matrix localToWorld;
+    float4 aabbMin; // Mesh-local. w is unused.
+    float4 aabbMax; // Mesh-local. w is unused.
+    uint drawIndex; // INDIRECT_INVALID_DRAW for padding.
+    uint padding0;
+    uint padding1;
+    uint padding2;
+};
+
+struct IndirectCommand
+{
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
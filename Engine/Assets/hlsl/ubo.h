@@ -1,23 +1,40 @@
-layout(set=0, binding=0) cbuffer cbPerFrame : register(b0)
+// Uniform blocks, split by how often they change. Must match PerObjectUboStruct in GfxDevice.hpp.
+layout(set=0, binding=0) cbuffer cbObject : register(b0)
 {
     matrix localToClip;
     matrix localToView;
     matrix localToWorld;
     matrix localToShadowClip;
+};
+
+layout(set=0, binding=13) cbuffer cbFrame : register(b1)
+{
+    uint windowWidth;
+    uint windowHeight;
+    uint numLights; // 16 bits for point light count, 16 for spot light count
+    uint maxNumLightsPerTile;
+    float4 tilesXY;
+    float minAmbient;
+    int isVR;
+};
+
+layout(set=0, binding=14) cbuffer cbCamera : register(b2)
+{
     matrix clipToView;
     float4 lightPosition;
     float4 lightDirection;
     float4 lightColor;
     float lightConeAngle;
     int lightType;
-    float minAmbient;
-    uint maxNumLightsPerTile;
-    uint windowWidth;
-    uint windowHeight;
-    uint numLights; // 16 bits for point light count, 16 for spot light count
-    float f0;
+};
+
+layout(set=0, binding=15) cbuffer cbMaterial : register(b3)
+{
     float4 tex0scaleOffset;
-    float4 tilesXY;
+    float f0;
+};
+
+layout(set=0, binding=16) cbuffer cbSkin : register(b4)
+{
     matrix boneMatrices[ 80 ];
-    int isVR;
 };
@@ -0,0 +1,39 @@
+#if !VULKAN
+#define layout(a,b)  
+#else
+#define register(a) blank
+#endif
+
+struct VSOutput
+{
+    float4 pos : SV_POSITION;
+    float2 uv : TEXCOORD;
+    float4 color : COLOR;
+    float4 projCoord : TANGENT;
+};
+    
+#include "ubo.h"
+#include "indirect.h"
+
+layout(set=1, binding=0) StructuredBuffer< IndirectInstance > instances : register(t3);
+layout(set=1, binding=2) StructuredBuffer< uint > visibleInstances : register(t4);
+
+// Indirect draws store worldToClip in localToClip and worldToShadowClip in localToShadowClip.
+// The instance id includes the draw command's firstInstance, so it indexes visibleInstances directly.
+VSOutput main( float3 pos : POSITION, float2 uv : TEXCOORD, float4 color : COLOR, uint instance : SV_InstanceID )
+{
+    float4 position = mul( instances[ visibleInstances[ instance ] ].localToWorld, float4( pos, 1.0 ) );
+
+    VSOutput vsOut;
+    vsOut.pos = mul( localToClip, position );
+    
+    if (isVR == 1)
+    {
+        vsOut.pos.y = -vsOut.pos.y;
+    }
+
+    vsOut.uv = uv;
+    vsOut.color = color;
+    vsOut.projCoord = mul( localToShadowClip, position );
+    return vsOut;
+}
@@ -1,25 +1,23 @@
 #include "AudioSourceComponent.hpp"
 #include "AudioSystem.hpp"
+#include "ComponentPool.hpp"
 #include <string>
 
-static constexpr int MaxComponents = 30;
-
-ae3d::AudioSourceComponent audioSourceComponents[ MaxComponents ];
-unsigned nextFreeAudioSourceComponent = 0;
+ae3d::ComponentPool< ae3d::AudioSourceComponent > audioSourceComponents( "audio source" );
 
 unsigned ae3d::AudioSourceComponent::New()
 {
-    if (nextFreeAudioSourceComponent == MaxComponents - 1)
-    {
-        return nextFreeAudioSourceComponent;
-    }
-    
-    return nextFreeAudioSourceComponent++;
+    return audioSourceComponents.New();
 }
 
 ae3d::AudioSourceComponent* ae3d::AudioSourceComponent::Get( unsigned index )
 {
-    return &audioSourceComponents[ index ];
+    return audioSourceComponents.Get( index );
+}
+
+void ae3d::AudioSourceComponent::Release( unsigned index )
+{
+    audioSourceComponents.Release( index );
 }
 
 void ae3d::AudioSourceComponent::SetClipId( unsigned audioClipId )
@@ -3,10 +3,9 @@
 #include "CameraComponent.hpp"
 #include <locale>
 #include <sstream>
+#include "ComponentPool.hpp"
 
-static constexpr int MaxComponents = 20;
-ae3d::CameraComponent cameraComponents[ MaxComponents ];
-unsigned nextFreeCameraComponent = 0;
+ae3d::ComponentPool< ae3d::CameraComponent > cameraComponents( "camera" );
 
 namespace GfxDeviceGlobal
 {
@@ -16,26 +15,29 @@ namespace GfxDeviceGlobal
 
 unsigned ae3d::CameraComponent::New()
 {
-    if (nextFreeCameraComponent == MaxComponents - 1)
-    {
-        return nextFreeCameraComponent;
-    }
+    const unsigned index = cameraComponents.New();
+    CameraComponent* camera = cameraComponents.Get( index );
 
-    cameraComponents[ nextFreeCameraComponent ].viewport[ 0 ] = 0;
-    cameraComponents[ nextFreeCameraComponent ].viewport[ 1 ] = 0;
+    camera->viewport[ 0 ] = 0;
+    camera->viewport[ 1 ] = 0;
 #if RENDERER_METAL
-    cameraComponents[ nextFreeCameraComponent ].viewport[ 2 ] = GfxDeviceGlobal::backBufferWidth * 2;
-    cameraComponents[ nextFreeCameraComponent ].viewport[ 3 ] = GfxDeviceGlobal::backBufferHeight * 2;
+    camera->viewport[ 2 ] = GfxDeviceGlobal::backBufferWidth * 2;
+    camera->viewport[ 3 ] = GfxDeviceGlobal::backBufferHeight * 2;
 #else
-    cameraComponents[ nextFreeCameraComponent ].viewport[ 2 ] = GfxDeviceGlobal::backBufferWidth;
-    cameraComponents[ nextFreeCameraComponent ].viewport[ 3 ] = GfxDeviceGlobal::backBufferHeight;
+    camera->viewport[ 2 ] = GfxDeviceGlobal::backBufferWidth;
+    camera->viewport[ 3 ] = GfxDeviceGlobal::backBufferHeight;
 #endif
-    return nextFreeCameraComponent++;
+    return index;
 }
 
 ae3d::CameraComponent* ae3d::CameraComponent::Get( unsigned index )
 {
-    return &cameraComponents[ index ];
+    return cameraComponents.Get( index );
+}
+
+void ae3d::CameraComponent::Release( unsigned index )
+{
+    cameraComponents.Release( index );
 }
 
 ae3d::Vec3 ae3d::CameraComponent::GetScreenPoint( const ae3d::Vec3 &worldPoint, float viewWidth, float viewHeight ) const
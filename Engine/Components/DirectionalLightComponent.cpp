@@ -3,24 +3,24 @@
 #include <vector>
 #include <sstream>
 #include <string>
+#include "ComponentPool.hpp"
 
-std::vector< ae3d::DirectionalLightComponent > directionalLightComponents;
-unsigned nextFreeDirectionalLightComponent = 0;
+ae3d::ComponentPool< ae3d::DirectionalLightComponent > directionalLightComponents( "directional light" );
 extern bool someLightCastsShadow;
 
 unsigned ae3d::DirectionalLightComponent::New()
 {
-    if (nextFreeDirectionalLightComponent == directionalLightComponents.size())
-    {
-        directionalLightComponents.resize( directionalLightComponents.size() + 10 );
-    }
-
-    return nextFreeDirectionalLightComponent++;
+    return directionalLightComponents.New();
 }
 
 ae3d::DirectionalLightComponent* ae3d::DirectionalLightComponent::Get( unsigned index )
 {
-    return &directionalLightComponents[ index ];
+    return directionalLightComponents.Get( index );
+}
+
+void ae3d::DirectionalLightComponent::Release( unsigned index )
+{
+    directionalLightComponents.Release( index );
 }
 
 void ae3d::DirectionalLightComponent::SetCastShadow( bool enable, int shadowMapSize )
@@ -1,7 +1,9 @@
 // This is an independent project of an individual developer. Dear PVS-Studio, please check it.
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 #include "GameObject.hpp"
+#include <utility>
 #include "AudioSourceComponent.hpp"
+#include "ComponentPool.hpp"
 #include "CameraComponent.hpp"
 #include "DirectionalLightComponent.hpp"
 #include "MeshRendererComponent.hpp"
@@ -13,98 +15,162 @@
 
 using namespace ae3d;
 
-unsigned ae3d::GameObject::GetNextComponentIndex()
+namespace
 {
-    return nextFreeComponentIndex >= MaxComponents ? InvalidComponentIndex : nextFreeComponentIndex++;
+    // Incremented when any enabled flag or parent changes. Starts at 1 so that new game objects have a stale cache.
+    unsigned hierarchyVersion = 1;
 }
 
-ae3d::GameObject::GameObject( const GameObject& other )
+void ae3d::GameObject::OnHierarchyChanged()
 {
-    *this = other;
+    ++hierarchyVersion;
 }
 
-GameObject& ae3d::GameObject::operator=( const GameObject& go )
+void ae3d::GameObject::SetEnabled( bool enabled )
 {
-    name = go.name;
-    
-    for (unsigned i = 0; i < MaxComponents; ++i)
-    {
-        components[ i ].type = -1;
-        components[ i ].handle = InvalidComponentIndex;
-    }
+    isEnabled = enabled;
+    OnHierarchyChanged();
+}
 
-    if (go.GetComponent< TransformComponent >())
+ae3d::GameObject::GameObject()
+{
+    for (unsigned i = 0; i < MaxComponentTypes; ++i)
     {
-        AddComponent< TransformComponent >();
-        *GetComponent< TransformComponent >() = *go.GetComponent< TransformComponent >();
+        componentHandles[ i ] = InvalidComponentIndex;
     }
+}
 
-    if (go.GetComponent< MeshRendererComponent >())
-    {
-        AddComponent< MeshRendererComponent >();
-        *GetComponent< MeshRendererComponent >() = *go.GetComponent< MeshRendererComponent >();
-    }
+ae3d::GameObject::GameObject( const GameObject& other ) : GameObject()
+{
+    *this = other;
+}
 
-    if (go.GetComponent< CameraComponent >())
-    {
-        AddComponent< CameraComponent >();
-        *GetComponent< CameraComponent >() = *go.GetComponent< CameraComponent >();
-    }
+ae3d::GameObject::GameObject( GameObject&& other ) noexcept : GameObject()
+{
+    *this = std::move( other );
+}
 
-    if (go.GetComponent< DirectionalLightComponent >())
+ae3d::GameObject::~GameObject()
+{
+    // Pools may already be gone if this game object has static storage duration and is destroyed at exit.
+    if (!IsComponentStorageDestroyed())
     {
-        AddComponent< DirectionalLightComponent >();
-        *GetComponent< DirectionalLightComponent >() = *go.GetComponent< DirectionalLightComponent >();
+        RemoveComponents();
     }
+}
 
-    if (go.GetComponent< AudioSourceComponent >())
+template< class T > void ae3d::GameObject::CopyComponent( const GameObject& go )
+{
+    if (go.GetComponent< T >())
     {
-        AddComponent< AudioSourceComponent >();
-        *GetComponent< AudioSourceComponent >() = *go.GetComponent< AudioSourceComponent >();
+        AddComponent< T >();
+        *GetComponent< T >() = *go.GetComponent< T >();
+        // Component assignment can copy the back pointer, so it's restored.
+        GetComponent< T >()->gameObject = this;
     }
+}
 
-    if (go.GetComponent< SpriteRendererComponent >())
+template< class T > void ae3d::GameObject::MoveComponent( GameObject& go )
+{
+    if (go.GetComponent< T >())
     {
-        AddComponent< SpriteRendererComponent >();
-        *GetComponent< SpriteRendererComponent >() = *go.GetComponent< SpriteRendererComponent >();
-    }
+        componentHandles[ T::Type() ] = go.componentHandles[ T::Type() ];
+        componentMask |= GetComponentBit< T >();
+        GetComponent< T >()->gameObject = this;
 
-    if (go.GetComponent< TextRendererComponent >())
-    {
-        AddComponent< TextRendererComponent >();
-        *GetComponent< TextRendererComponent >() = *go.GetComponent< TextRendererComponent >();
+        go.componentHandles[ T::Type() ] = InvalidComponentIndex;
+        go.componentMask &= ~GetComponentBit< T >();
     }
+}
+
+void ae3d::GameObject::RemoveComponents()
+{
+    RemoveComponent< TransformComponent >();
+    RemoveComponent< MeshRendererComponent >();
+    RemoveComponent< CameraComponent >();
+    RemoveComponent< DirectionalLightComponent >();
+    RemoveComponent< AudioSourceComponent >();
+    RemoveComponent< SpriteRendererComponent >();
+    RemoveComponent< TextRendererComponent >();
+    RemoveComponent< SpotLightComponent >();
+    RemoveComponent< PointLightComponent >();
+}
 
-    if (go.GetComponent< SpotLightComponent >())
+GameObject& ae3d::GameObject::operator=( const GameObject& go )
+{
+    if (&go == this)
     {
-        AddComponent< SpotLightComponent >();
-        *GetComponent< SpotLightComponent >() = *go.GetComponent< SpotLightComponent >();
+        return *this;
     }
 
-    if (go.GetComponent< PointLightComponent >())
+    name = go.name;
+
+    RemoveComponents();
+
+    CopyComponent< TransformComponent >( go );
+    CopyComponent< MeshRendererComponent >( go );
+    CopyComponent< CameraComponent >( go );
+    CopyComponent< DirectionalLightComponent >( go );
+    CopyComponent< AudioSourceComponent >( go );
+    CopyComponent< SpriteRendererComponent >( go );
+    CopyComponent< TextRendererComponent >( go );
+    CopyComponent< SpotLightComponent >( go );
+    CopyComponent< PointLightComponent >( go );
+
+    return *this;
+}
+
+GameObject& ae3d::GameObject::operator=( GameObject&& go ) noexcept
+{
+    if (&go == this)
     {
-        AddComponent< PointLightComponent >();
-        *GetComponent< PointLightComponent >() = *go.GetComponent< PointLightComponent >();
+        return *this;
     }
 
+    name = std::move( go.name );
+    layer = go.layer;
+    isEnabled = go.isEnabled;
+
+    RemoveComponents();
+
+    MoveComponent< TransformComponent >( go );
+    MoveComponent< MeshRendererComponent >( go );
+    MoveComponent< CameraComponent >( go );
+    MoveComponent< DirectionalLightComponent >( go );
+    MoveComponent< AudioSourceComponent >( go );
+    MoveComponent< SpriteRendererComponent >( go );
+    MoveComponent< TextRendererComponent >( go );
+    MoveComponent< SpotLightComponent >( go );
+    MoveComponent< PointLightComponent >( go );
+
+    // Cached enabled flags follow transforms' game objects, which have changed.
+    OnHierarchyChanged();
+
     return *this;
 }
 
 bool ae3d::GameObject::IsEnabled() const
 {
+    if (cachedIsEnabledVersion == hierarchyVersion)
+    {
+        return cachedIsEnabled;
+    }
+
+    cachedIsEnabled = isEnabled;
     const TransformComponent* transform = GetComponent< TransformComponent >();
 
-    while (transform)
+    while (transform && cachedIsEnabled)
     {
         if (transform->GetGameObject() && !transform->GetGameObject()->isEnabled)
         {
-            return false;
+            cachedIsEnabled = false;
         }
         
         transform = transform->GetParent();
     }
     
-    return isEnabled;
+    cachedIsEnabledVersion = hierarchyVersion;
+    return cachedIsEnabled;
 }
 
 std::string ae3d::GameObject::GetSerialized() const
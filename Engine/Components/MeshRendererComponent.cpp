@@ -1,13 +1,16 @@
 // This is an independent project of an individual developer. Dear PVS-Studio, please check it.
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 #include "MeshRendererComponent.hpp"
+#include <algorithm>
 #include <string>
 #include <vector>
+#include "ComponentPool.hpp"
 #include "Frustum.hpp"
 #include "GfxDevice.hpp"
 #include "Matrix.hpp"
 #include "Mesh.hpp"
 #include "Material.hpp"
+#include "OcclusionCuller.hpp"
 #include "Shader.hpp"
 #include "System.hpp"
 #include "SubMesh.hpp"
@@ -18,26 +21,25 @@ using namespace ae3d;
 
 namespace GfxDeviceGlobal
 {
-    extern PerObjectUboStruct perObjectUboStruct;
+    extern thread_local PerObjectUboStruct perObjectUboStruct;
+    extern thread_local int boneMatrixCount;
 }
 
 namespace MathUtil
 {
-    void GetMinMax( const Vec3* aPoints, int count, Vec3& outMin, Vec3& outMax );
-    void GetCorners( const Vec3& min, const Vec3& max, Vec3 outCorners[ 8 ] );
+    void TransformAABB( const Vec3& localMin, const Vec3& localMax, const Matrix44& localToWorld, Vec3& outCenter, Vec3& outExtent );
 }
 
-std::vector< ae3d::MeshRendererComponent > meshRendererComponents;
-unsigned nextFreeMeshRendererComponent = 0;
+ae3d::ComponentPool< ae3d::MeshRendererComponent > meshRendererComponents( "mesh renderer" );
 
 unsigned ae3d::MeshRendererComponent::New()
 {
-    if (nextFreeMeshRendererComponent == meshRendererComponents.size())
-    {
-        meshRendererComponents.resize( meshRendererComponents.size() + 10 );
-    }
-    
-    return nextFreeMeshRendererComponent++;
+    return meshRendererComponents.New();
+}
+
+void ae3d::MeshRendererComponent::Release( unsigned index )
+{
+    meshRendererComponents.Release( index );
 }
 
 Material* ae3d::MeshRendererComponent::GetMaterial( int subMeshIndex )
@@ -47,7 +49,7 @@ Material* ae3d::MeshRendererComponent::GetMaterial( int subMeshIndex )
 
 ae3d::MeshRendererComponent* ae3d::MeshRendererComponent::Get( unsigned index )
 {
-    return &meshRendererComponents[ index ];
+    return meshRendererComponents.Get( index );
 }
 
 std::string GetSerialized( ae3d::MeshRendererComponent* component )
@@ -65,6 +67,10 @@ std::string GetSerialized( ae3d::MeshRendererComponent* component )
 
     outStr += "\nmeshrenderer_cast_shadow ";
     outStr += component->CastsShadow() ? "1" : "0";
+    outStr += "\nmeshrenderer_occluder ";
+    outStr += component->IsOccluder() ? "1" : "0";
+    outStr += "\nmeshrenderer_static ";
+    outStr += component->IsStatic() ? "1" : "0";
     outStr += "\nmeshrenderer_enabled ";
     outStr += component->IsEnabled() ? "1" : "0";
     outStr += "\n\n";
@@ -72,61 +78,88 @@ std::string GetSerialized( ae3d::MeshRendererComponent* component )
     return outStr;
 }
 
-void ae3d::MeshRendererComponent::Cull( const class Frustum& cameraFrustum, const struct Matrix44& localToWorld )
+void ae3d::MeshRendererComponent::CullSubMeshes( const class Frustum& cameraFrustum, const struct Matrix44& localToWorld )
 {
     if (!mesh)
     {
         return;
     }
 
-    isCulled = false;
-    
-    Vec3 aabbWorld[ 8 ];
-    MathUtil::GetCorners( mesh->GetAABBMin(), mesh->GetAABBMax(), aabbWorld );
-    
-    for (std::size_t v = 0; v < 8; ++v)
+    int subMeshCount = 0;
+    SubMesh* subMeshes = mesh->GetSubMeshes( subMeshCount);
+
+    // Submeshes are tested in groups of 32 so that one mask word holds the result.
+    const int GroupSize = 32;
+    float bounds[ 6 ][ GroupSize ];
+    AABBArrays boxes;
+    boxes.centerX = bounds[ 0 ];
+    boxes.centerY = bounds[ 1 ];
+    boxes.centerZ = bounds[ 2 ];
+    boxes.extentX = bounds[ 3 ];
+    boxes.extentY = bounds[ 4 ];
+    boxes.extentZ = bounds[ 5 ];
+
+    for (int groupStart = 0; groupStart < subMeshCount; groupStart += GroupSize)
     {
-        Matrix44::TransformPoint( aabbWorld[ v ], localToWorld, &aabbWorld[ v ] );
+        const int groupCount = subMeshCount - groupStart < GroupSize ? subMeshCount - groupStart : GroupSize;
+
+        for (int i = 0; i < groupCount; ++i)
+        {
+            Vec3 center, extent;
+            MathUtil::TransformAABB( subMeshes[ groupStart + i ].aabbMin, subMeshes[ groupStart + i ].aabbMax, localToWorld, center, extent );
+            bounds[ 0 ][ i ] = center.x;
+            bounds[ 1 ][ i ] = center.y;
+            bounds[ 2 ][ i ] = center.z;
+            bounds[ 3 ][ i ] = extent.x;
+            bounds[ 4 ][ i ] = extent.y;
+            bounds[ 5 ][ i ] = extent.z;
+        }
+
+        unsigned visibleMask;
+        cameraFrustum.BoxesInFrustum( boxes, static_cast< unsigned >( groupCount ), &visibleMask );
+
+        for (int i = 0; i < groupCount; ++i)
+        {
+            const int subMeshIndex = groupStart + i;
+            const bool hasValidMaterial = materials[ subMeshIndex ] != nullptr && materials[ subMeshIndex ]->IsValidShader();
+            isSubMeshCulled[ subMeshIndex ] = !hasValidMaterial || ((visibleMask >> i) & 1) == 0;
+        }
     }
-    
-    Vec3 aabbMinWorld, aabbMaxWorld;
-    MathUtil::GetMinMax( aabbWorld, 8, aabbMinWorld, aabbMaxWorld );
-    
-    if (!cameraFrustum.BoxInFrustum( aabbMinWorld, aabbMaxWorld ))
+}
+
+void ae3d::MeshRendererComponent::AddOccluder( OcclusionCuller& occlusionCuller, const Matrix44& localToWorld )
+{
+    if (!mesh)
     {
-        isCulled = true;
         return;
     }
 
+    static_assert( sizeof( VertexBuffer::Face ) == 3 * sizeof( unsigned short ), "faces are read as an index array" );
+
     int subMeshCount = 0;
-    SubMesh* subMeshes = mesh->GetSubMeshes( subMeshCount);
+    SubMesh* subMeshes = mesh->GetSubMeshes( subMeshCount );
 
     for (int subMeshIndex = 0; subMeshIndex < subMeshCount; ++subMeshIndex)
     {
-        isSubMeshCulled[ subMeshIndex ] = false;
+        const SubMesh& subMesh = subMeshes[ subMeshIndex ];
 
-        if (materials[ subMeshIndex ] == nullptr || !materials[ subMeshIndex ]->IsValidShader())
+        if (subMesh.indices.empty() || !subMesh.verticesPTNTC_Skinned.empty())
         {
-            isSubMeshCulled[ subMeshIndex ] = true;
             continue;
         }
-        
-        Vec3 meshAabbMinWorld = subMeshes[ subMeshIndex ].aabbMin;
-        Vec3 meshAabbMaxWorld = subMeshes[ subMeshIndex ].aabbMax;
-        
-        Vec3 meshAabbWorld[ 8 ];
-        MathUtil::GetCorners( meshAabbMinWorld, meshAabbMaxWorld, meshAabbWorld );
-        
-        for (std::size_t v = 0; v < 8; ++v)
+
+        const unsigned short* indices = &subMesh.indices[ 0 ].a;
+        const unsigned indexCount = static_cast< unsigned >( subMesh.indices.size() * 3 );
+
+        if (!subMesh.verticesPTNTC.empty())
         {
-            Matrix44::TransformPoint( meshAabbWorld[ v ], localToWorld, &meshAabbWorld[ v ] );
+            occlusionCuller.AddOccluder( &subMesh.verticesPTNTC[ 0 ].position, sizeof( VertexBuffer::VertexPTNTC ),
+                                         static_cast< unsigned >( subMesh.verticesPTNTC.size() ), indices, indexCount, localToWorld );
         }
-        
-        MathUtil::GetMinMax( meshAabbWorld, 8, meshAabbMinWorld, meshAabbMaxWorld );
-        
-        if (!cameraFrustum.BoxInFrustum( meshAabbMinWorld, meshAabbMaxWorld ))
+        else if (!subMesh.verticesPTN.empty())
         {
-            isSubMeshCulled[ subMeshIndex ] = true;
+            occlusionCuller.AddOccluder( &subMesh.verticesPTN[ 0 ].position, sizeof( VertexBuffer::VertexPTN ),
+                                         static_cast< unsigned >( subMesh.verticesPTN.size() ), indices, indexCount, localToWorld );
         }
     }
 }
@@ -136,6 +169,9 @@ void ae3d::MeshRendererComponent::ApplySkin( unsigned subMeshIndex )
     int subMeshCount = 0;
     SubMesh* subMeshes = mesh->GetSubMeshes( subMeshCount );
 
+    // The draw uploads only the bone matrices that are set here.
+    GfxDeviceGlobal::boneMatrixCount = static_cast< int >( std::min( subMeshes[ subMeshIndex ].joints.size(), static_cast< std::size_t >( PerObjectUboStruct::MaxBoneMatrices ) ) );
+
     if (!subMeshes[ subMeshIndex ].joints.empty())
     {
         for (std::size_t j = 0; j < subMeshes[ subMeshIndex ].joints.size(); ++j)
@@ -147,111 +183,147 @@ void ae3d::MeshRendererComponent::ApplySkin( unsigned subMeshIndex )
                 const std::size_t frames = joint.animTransforms.size();
                 Matrix44::Multiply( joint.globalBindposeInverse,
                                    joint.animTransforms[ animFrame % frames ],
-                                   GfxDeviceGlobal::perObjectUboStruct.boneMatrices[ j ] );
+                                   GfxDeviceGlobal::perObjectUboStruct.skin.boneMatrices[ j ] );
             }
         }
     }
 
 }
 
-void ae3d::MeshRendererComponent::Render( const Matrix44& localToView, const Matrix44& localToClip, const Matrix44& localToWorld,
-                                          const Matrix44& shadowView, const Matrix44& shadowProjection, Shader* overrideShader,
-                                          Shader* overrideSkinShader, RenderType renderType )
+void ae3d::MeshRendererComponent::RenderSubMesh( unsigned subMeshIndex, const Matrix44& localToView, const Matrix44& localToClip, const Matrix44& localToWorld,
+                                                 const Matrix44& shadowView, const Matrix44& shadowProjection, Shader* overrideShader, Shader* overrideSkinShader )
 {
-    if (isCulled || !mesh || !isEnabled)
+    int subMeshCount = 0;
+    SubMesh* subMeshes = mesh->GetSubMeshes( subMeshCount );
+
+    Shader* shader = overrideShader ? overrideShader : materials[ subMeshIndex ]->GetShader();
+    
+    if (overrideSkinShader && !subMeshes[ subMeshIndex ].joints.empty())
     {
-        return;
+        shader = overrideSkinShader;
     }
-    
-	int subMeshCount = 0;
-    SubMesh* subMeshes = mesh->GetSubMeshes( subMeshCount );
 
-    for (int subMeshIndex = 0; subMeshIndex < subMeshCount; ++subMeshIndex)
+    DrawSubMesh( subMeshIndex, *shader, overrideShader != nullptr, localToView, localToClip, localToWorld, shadowView, shadowProjection, 1, 0, 0 );
+}
+
+void ae3d::MeshRendererComponent::RenderSubMeshInstanced( unsigned subMeshIndex, const Matrix44* localToWorlds, int instanceCount, const Matrix44& worldToView,
+                                                          const Matrix44& worldToClip, const Matrix44& shadowView, const Matrix44& shadowProjection, Shader* overrideInstancedShader )
+{
+    System::Assert( !IsSubMeshSkinned( subMeshIndex ), "skinned submeshes use bone matrices and can't be instanced" );
+    System::Assert( instanceCount > 0 && instanceCount <= PerObjectUboStruct::MaxInstances, "invalid instance count" );
+
+    Shader* shader = overrideInstancedShader ? overrideInstancedShader : materials[ subMeshIndex ]->GetInstancedShader();
+
+    for (int i = 0; i < instanceCount; ++i)
     {
-        if (isSubMeshCulled[ subMeshIndex ])
-        {
-            continue;
-        }
-        
-        if (materials[ subMeshIndex ]->GetBlendingMode() != Material::BlendingMode::Off && renderType == RenderType::Opaque)
-        {
-            continue;
-        }
+        GfxDeviceGlobal::perObjectUboStruct.skin.boneMatrices[ i ] = localToWorlds[ i ];
+    }
 
-        if (materials[ subMeshIndex ]->GetBlendingMode() == Material::BlendingMode::Off && renderType == RenderType::Transparent)
-        {
-            continue;
-        }
+    // Instanced shaders apply each instance's localToWorld before the world-space matrices.
+    DrawSubMesh( subMeshIndex, *shader, overrideInstancedShader != nullptr, worldToView, worldToClip, Matrix44::identity, shadowView, shadowProjection, instanceCount, 0, 0 );
+}
 
-        Shader* shader = overrideShader ? overrideShader : materials[ subMeshIndex ]->GetShader();
-        
-        if (overrideSkinShader && !subMeshes[ subMeshIndex ].joints.empty())
-        {
-            shader = overrideSkinShader;
-        }
-        
-        GfxDevice::CullMode cullMode = GfxDevice::CullMode::Back;
-        GfxDevice::BlendMode blendMode = GfxDevice::BlendMode::Off;
+#if RENDERER_VULKAN
+void ae3d::MeshRendererComponent::RenderSubMeshIndirect( unsigned subMeshIndex, unsigned firstIndirectDraw, unsigned indirectDrawCount, const Matrix44& worldToView,
+                                                         const Matrix44& worldToClip, const Matrix44& shadowView, const Matrix44& shadowProjection )
+{
+    System::Assert( !IsSubMeshSkinned( subMeshIndex ), "skinned submeshes use bone matrices and can't be drawn indirectly" );
+    System::Assert( indirectDrawCount > 0, "invalid indirect draw count" );
+
+    // Like instanced shaders, indirect shaders apply each instance's localToWorld before the world-space matrices.
+    DrawSubMesh( subMeshIndex, *materials[ subMeshIndex ]->GetIndirectShader(), false, worldToView, worldToClip, Matrix44::identity, shadowView, shadowProjection, 1,
+                 firstIndirectDraw, indirectDrawCount );
+}
+#endif
+
+bool ae3d::MeshRendererComponent::IsSubMeshSkinned( unsigned subMeshIndex ) const
+{
+    int subMeshCount = 0;
+    SubMesh* subMeshes = mesh->GetSubMeshes( subMeshCount );
+    return !subMeshes[ subMeshIndex ].joints.empty();
+}
+
+void ae3d::MeshRendererComponent::DrawSubMesh( unsigned subMeshIndex, Shader& shader, bool hasOverrideShader, const Matrix44& localToView, const Matrix44& localToClip,
+                                               const Matrix44& localToWorld, const Matrix44& shadowView, const Matrix44& shadowProjection, int instanceCount,
+                                               unsigned firstIndirectDraw, unsigned indirectDrawCount )
+{
+    int subMeshCount = 0;
+    SubMesh* subMeshes = mesh->GetSubMeshes( subMeshCount );
+
+    GfxDevice::CullMode cullMode = GfxDevice::CullMode::Back;
+    GfxDevice::BlendMode blendMode = GfxDevice::BlendMode::Off;
 
 #if AE3D_OPENVR
-        GfxDeviceGlobal::perObjectUboStruct.isVR = 1;
+    GfxDeviceGlobal::perObjectUboStruct.frame.isVR = 1;
 #endif
 
-        if (overrideShader)
-        {
-            shader->Use();
-            GfxDeviceGlobal::perObjectUboStruct.localToClip = localToClip;
-            GfxDeviceGlobal::perObjectUboStruct.localToView = localToView;
-            ApplySkin( subMeshIndex );
-        }
-        else
-        {
-            Matrix44 localToShadowClip;
-            
-            Matrix44::Multiply( localToWorld, shadowView, localToShadowClip );
-            Matrix44::Multiply( localToShadowClip, shadowProjection, localToShadowClip );
+    if (hasOverrideShader)
+    {
+        shader.Use();
+        GfxDeviceGlobal::perObjectUboStruct.object.localToClip = localToClip;
+        GfxDeviceGlobal::perObjectUboStruct.object.localToView = localToView;
+        ApplySkin( subMeshIndex );
+    }
+    else
+    {
+        Matrix44 localToShadowClip;
+        
+        Matrix44::Multiply( localToWorld, shadowView, localToShadowClip );
+        Matrix44::Multiply( localToShadowClip, shadowProjection, localToShadowClip );
 #ifndef RENDERER_METAL
-            Matrix44::Multiply( localToShadowClip, Matrix44::bias, localToShadowClip );
+        Matrix44::Multiply( localToShadowClip, Matrix44::bias, localToShadowClip );
 #endif
-            materials[ subMeshIndex ]->Apply();
-            
-            GfxDeviceGlobal::perObjectUboStruct.localToClip = localToClip;
-            GfxDeviceGlobal::perObjectUboStruct.localToView = localToView;
-            GfxDeviceGlobal::perObjectUboStruct.localToWorld = localToWorld;
-            GfxDeviceGlobal::perObjectUboStruct.localToShadowClip = localToShadowClip;
-
-            ApplySkin( subMeshIndex );
-            
-            if (!materials[ subMeshIndex ]->IsBackFaceCulled())
-            {
-                cullMode = GfxDevice::CullMode::Off;
-            }
-            
-            if (materials[ subMeshIndex ]->GetBlendingMode() == Material::BlendingMode::Alpha)
-            {
-                blendMode = GfxDevice::BlendMode::AlphaBlend;
-            }
-        }
+        materials[ subMeshIndex ]->Apply();
         
-        GfxDevice::DepthFunc depthFunc;
+        GfxDeviceGlobal::perObjectUboStruct.object.localToClip = localToClip;
+        GfxDeviceGlobal::perObjectUboStruct.object.localToView = localToView;
+        GfxDeviceGlobal::perObjectUboStruct.object.localToWorld = localToWorld;
+        GfxDeviceGlobal::perObjectUboStruct.object.localToShadowClip = localToShadowClip;
+
+        ApplySkin( subMeshIndex );
         
-        if (materials[ subMeshIndex ]->GetDepthFunction() == Material::DepthFunction::LessOrEqualWriteOn)
-        {
-            depthFunc = GfxDevice::DepthFunc::LessOrEqualWriteOn;
-        }
-        else if (materials[ subMeshIndex ]->GetDepthFunction() == Material::DepthFunction::NoneWriteOff)
+        if (!materials[ subMeshIndex ]->IsBackFaceCulled())
         {
-            depthFunc = GfxDevice::DepthFunc::NoneWriteOff;
+            cullMode = GfxDevice::CullMode::Off;
         }
-        else
+        
+        if (materials[ subMeshIndex ]->GetBlendingMode() == Material::BlendingMode::Alpha)
         {
-            System::Assert( false, "material has unhandled depth function" );
-            depthFunc = GfxDevice::DepthFunc::NoneWriteOff;
+            blendMode = GfxDevice::BlendMode::AlphaBlend;
         }
-        
-        GfxDevice::Draw( subMeshes[ subMeshIndex ].vertexBuffer, 0, subMeshes[ subMeshIndex ].vertexBuffer.GetFaceCount() / 3,
-                         *shader, blendMode, depthFunc, cullMode, isWireframe ? GfxDevice::FillMode::Wireframe : GfxDevice::FillMode::Solid, GfxDevice::PrimitiveTopology::Triangles );
     }
+    
+    GfxDevice::DepthFunc depthFunc;
+    
+    if (materials[ subMeshIndex ]->GetDepthFunction() == Material::DepthFunction::LessOrEqualWriteOn)
+    {
+        depthFunc = GfxDevice::DepthFunc::LessOrEqualWriteOn;
+    }
+    else if (materials[ subMeshIndex ]->GetDepthFunction() == Material::DepthFunction::NoneWriteOff)
+    {
+        depthFunc = GfxDevice::DepthFunc::NoneWriteOff;
+    }
+    else
+    {
+        System::Assert( false, "material has unhandled depth function" );
+        depthFunc = GfxDevice::DepthFunc::NoneWriteOff;
+    }
+    
+    const GfxDevice::FillMode fillMode = isWireframe ? GfxDevice::FillMode::Wireframe : GfxDevice::FillMode::Solid;
+
+#if RENDERER_VULKAN
+    if (indirectDrawCount > 0)
+    {
+        GfxDevice::DrawIndirect( firstIndirectDraw, indirectDrawCount, shader, blendMode, depthFunc, cullMode, fillMode );
+        return;
+    }
+#else
+    (void)firstIndirectDraw;
+    System::Assert( indirectDrawCount == 0, "indirect draws are only supported on Vulkan" );
+#endif
+
+    GfxDevice::DrawInstanced( subMeshes[ subMeshIndex ].vertexBuffer, 0, subMeshes[ subMeshIndex ].vertexBuffer.GetFaceCount() / 3,
+                              shader, blendMode, depthFunc, cullMode, fillMode, GfxDevice::PrimitiveTopology::Triangles, instanceCount );
 }
 
 void ae3d::MeshRendererComponent::SetMaterial( Material* material, unsigned subMeshIndex )
@@ -3,24 +3,24 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include "ComponentPool.hpp"
 
 extern bool someLightCastsShadow;
-std::vector< ae3d::PointLightComponent > pointLightComponents;
-unsigned nextFreePointLightComponent = 0;
+ae3d::ComponentPool< ae3d::PointLightComponent > pointLightComponents( "point light" );
 
 unsigned ae3d::PointLightComponent::New()
 {
-    if (nextFreePointLightComponent == pointLightComponents.size())
-    {
-        pointLightComponents.resize( pointLightComponents.size() + 10 );
-    }
-    
-    return nextFreePointLightComponent++;
+    return pointLightComponents.New();
 }
 
 ae3d::PointLightComponent* ae3d::PointLightComponent::Get( unsigned index )
 {
-    return &pointLightComponents[ index ];
+    return pointLightComponents.Get( index );
+}
+
+void ae3d::PointLightComponent::Release( unsigned index )
+{
+    pointLightComponents.Release( index );
 }
 
 void ae3d::PointLightComponent::SetCastShadow( bool enable, int shadowMapSize )
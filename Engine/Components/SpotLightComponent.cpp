@@ -1,27 +1,24 @@
 #include "SpotLightComponent.hpp"
+#include "ComponentPool.hpp"
 #include "System.hpp"
 #include <string>
 
 extern bool someLightCastsShadow;
-static constexpr int MaxComponents = 100;
-ae3d::SpotLightComponent spotLightComponents[ MaxComponents ];
-unsigned nextFreeSpotlLightComponent = 0;
+ae3d::ComponentPool< ae3d::SpotLightComponent > spotLightComponents( "spot light" );
 
 unsigned ae3d::SpotLightComponent::New()
 {
-    System::Assert( nextFreeSpotlLightComponent < MaxComponents, "Too many spot light components!" );
-    
-    if (nextFreeSpotlLightComponent == MaxComponents - 1)
-    {
-        return nextFreeSpotlLightComponent;
-    }
-    
-    return nextFreeSpotlLightComponent++;
+    return spotLightComponents.New();
 }
 
 ae3d::SpotLightComponent* ae3d::SpotLightComponent::Get( unsigned index )
 {
-    return &spotLightComponents[ index ];
+    return spotLightComponents.Get( index );
+}
+
+void ae3d::SpotLightComponent::Release( unsigned index )
+{
+    spotLightComponents.Release( index );
 }
 
 void ae3d::SpotLightComponent::SetCastShadow( bool enable, int shadowMapSize )
@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <sstream>
 #include <vector>
+#include "ComponentPool.hpp"
 #include "GfxDevice.hpp"
 #include "Renderer.hpp"
 #include "RenderTexture.hpp"
@@ -15,12 +16,11 @@
 
 extern ae3d::Renderer renderer;
 
-std::vector<ae3d::SpriteRendererComponent> spriteRendererComponents;
-unsigned nextFreeSpriteComponent = 0;
+ae3d::ComponentPool< ae3d::SpriteRendererComponent > spriteRendererComponents( "sprite renderer" );
 
 namespace GfxDeviceGlobal
 {
-    extern PerObjectUboStruct perObjectUboStruct;
+    extern thread_local PerObjectUboStruct perObjectUboStruct;
 }
 
 struct Drawable
@@ -172,8 +172,8 @@ void RenderQueue::Render( ae3d::GfxDevice::BlendMode blendMode, const float* loc
     for (auto& drawable : drawables)
     {
         renderer.builtinShaders.spriteRendererShader.Use();
-        GfxDeviceGlobal::perObjectUboStruct.localToClip.InitFrom( localToClip );
-        GfxDeviceGlobal::perObjectUboStruct.lightColor = ae3d::Vec4( 1, 1, 1, 1 );
+        GfxDeviceGlobal::perObjectUboStruct.object.localToClip.InitFrom( localToClip );
+        GfxDeviceGlobal::perObjectUboStruct.camera.lightColor = ae3d::Vec4( 1, 1, 1, 1 );
 
         if (drawable.texture->IsRenderTexture())
         {
@@ -204,12 +204,12 @@ struct ae3d::SpriteRendererComponent::Impl
 
 unsigned ae3d::SpriteRendererComponent::New()
 {
-    if (nextFreeSpriteComponent == spriteRendererComponents.size())
-    {
-        spriteRendererComponents.resize( spriteRendererComponents.size() + 10 );
-    }
+    return spriteRendererComponents.New();
+}
 
-    return nextFreeSpriteComponent++;
+void ae3d::SpriteRendererComponent::Release( unsigned index )
+{
+    spriteRendererComponents.Release( index );
 }
 
 ae3d::SpriteInfo ae3d::SpriteRendererComponent::GetSpriteInfo( int index ) const
@@ -224,13 +224,12 @@ ae3d::SpriteInfo ae3d::SpriteRendererComponent::GetSpriteInfo( int index ) const
 
 ae3d::SpriteRendererComponent* ae3d::SpriteRendererComponent::Get( unsigned index )
 {
-    if (index >= spriteRendererComponents.size())
+    if (index >= spriteRendererComponents.GetHandleCount())
     {
         System::Print( "SpriteRendererComponent: invalid index: %u\n", index );
     }
     
-    System::Assert( index < spriteRendererComponents.size(), "Tried to get a too high index for spriteRendererComponents." );
-    return &spriteRendererComponents[ index ];
+    return spriteRendererComponents.Get( index );
 }
 
 ae3d::SpriteRendererComponent::SpriteRendererComponent()
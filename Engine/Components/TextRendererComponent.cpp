@@ -2,6 +2,7 @@
 #include <locale>
 #include <vector>
 #include <sstream>
+#include "ComponentPool.hpp"
 #include "Font.hpp"
 #include "GfxDevice.hpp"
 #include "Renderer.hpp"
@@ -11,27 +12,26 @@
 
 extern ae3d::Renderer renderer;
 
-std::vector< ae3d::TextRendererComponent > textComponents;
-unsigned nextFreeTextComponent = 0;
+ae3d::ComponentPool< ae3d::TextRendererComponent > textComponents( "text renderer" );
 
 namespace GfxDeviceGlobal
 {
-    extern PerObjectUboStruct perObjectUboStruct;
+    extern thread_local PerObjectUboStruct perObjectUboStruct;
 }
 
 unsigned ae3d::TextRendererComponent::New()
 {
-    if (nextFreeTextComponent == textComponents.size())
-    {
-        textComponents.resize( textComponents.size() + 10 );
-    }
-    
-    return nextFreeTextComponent++;
+    return textComponents.New();
 }
 
 ae3d::TextRendererComponent* ae3d::TextRendererComponent::Get( unsigned index )
 {
-    return &textComponents[ index ];
+    return textComponents.Get( index );
+}
+
+void ae3d::TextRendererComponent::Release( unsigned index )
+{
+    textComponents.Release( index );
 }
 
 struct ae3d::TextRendererComponent::Impl
@@ -123,8 +123,8 @@ void ae3d::TextRendererComponent::Render( const float* localToClip )
         auto shader = m().shader;
         shader->Use();
         shader->SetTexture(  m().font->GetTexture(), 0 );
-        GfxDeviceGlobal::perObjectUboStruct.localToClip.InitFrom( localToClip );
-        GfxDeviceGlobal::perObjectUboStruct.lightColor = Vec4( 1, 1, 1, 1 );
+        GfxDeviceGlobal::perObjectUboStruct.object.localToClip.InitFrom( localToClip );
+        GfxDeviceGlobal::perObjectUboStruct.camera.lightColor = Vec4( 1, 1, 1, 1 );
         
         GfxDevice::Draw( m().vertexBuffer, 0, m().vertexBuffer.GetFaceCount() / 3, *m().shader, ae3d::GfxDevice::BlendMode::AlphaBlend,
                          ae3d::GfxDevice::DepthFunc::LessOrEqualWriteOff, ae3d::GfxDevice::CullMode::Off, ae3d::GfxDevice::FillMode::Solid, GfxDevice::PrimitiveTopology::Triangles );
@@ -5,8 +5,12 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include "ComponentPool.hpp"
+#include "GameObject.hpp"
+#include "JobSystem.hpp"
 #include "Matrix.hpp"
 #include "System.hpp"
+#include "TransformKernel.hpp"
 
 namespace
 {
@@ -15,45 +19,246 @@ namespace
         return fabsf( f1 - f2 ) < 0.0001f;
     }
 
-    std::vector< ae3d::TransformComponent > transformComponents;
-    unsigned nextFreeTransformComponent = 0;
+    ae3d::ComponentPool< ae3d::TransformComponent > transformComponents( "transform" );
+    constexpr unsigned TransformBatchSize = 256;
+
+    // Structure-of-arrays data indexed by TransformComponent::index. Hot data is kept apart from the components
+    // so that the update loop only touches what it needs. Chunks never move, so references returned by getters stay valid.
+    struct TransformChunks
+    {
+        ~TransformChunks()
+        {
+            ae3d::OnComponentStorageDestroyed();
+
+            for (auto chunk : chunks)
+            {
+                delete chunk;
+            }
+        }
+
+        std::vector< ae3d::TransformChunk* > chunks;
+    };
+
+    TransformChunks transformChunks;
+    ae3d::TransformArrays transforms = { nullptr };
+
+    // Component indices sorted by hierarchy depth, so parents are always updated before their children.
+    // Components at depth d are hierarchyOrder[ depthStarts[ d ] ] .. hierarchyOrder[ depthStarts[ d + 1 ] - 1 ].
+    std::vector< unsigned > hierarchyOrder;
+    std::vector< unsigned > depthStarts;
+    bool isHierarchyOrderDirty = true;
+    // Incremented by UpdateLocalMatrices. World versions are never 0 after a transform's first update.
+    unsigned worldUpdateCount = 0;
 }
 
 unsigned ae3d::TransformComponent::New()
 {
-    if (nextFreeTransformComponent == transformComponents.size())
+    const unsigned handle = transformComponents.New();
+    transformComponents.Get( handle )->index = handle;
+
+    if (handle == transformChunks.chunks.size() * TransformChunk::Size)
     {
-        transformComponents.resize( transformComponents.size() + 10 );
+        TransformChunk* chunk = new TransformChunk();
+
+        for (unsigned slot = 0; slot < TransformChunk::Size; ++slot)
+        {
+            chunk->localScales[ slot ] = 1;
+            chunk->parents[ slot ] = -1;
+            chunk->isLocalDirty[ slot ] = 1;
+            chunk->hasWorldChanged[ slot ] = 0;
+            chunk->worldVersions[ slot ] = 0;
+        }
+
+        transformChunks.chunks.push_back( chunk );
+        transforms.chunks = transformChunks.chunks.data();
     }
 
-    return nextFreeTransformComponent++;
+    isHierarchyOrderDirty = true;
+    return handle;
 }
 
 ae3d::TransformComponent* ae3d::TransformComponent::Get( unsigned index )
 {
-    System::Assert( index < static_cast< unsigned >( transformComponents.size() ), "invalid transform index" );
-    return &transformComponents[ index ];
+    return transformComponents.Get( index );
+}
+
+void ae3d::TransformComponent::Release( unsigned index )
+{
+    TransformComponent* component = transformComponents.Get( index );
+
+    // Children go to the last copy of this transform, or become roots so that they don't get attached to whichever transform reuses the index.
+    int heir = component->lastCopy;
+
+    for (int ancestor = heir; ancestor != -1; ancestor = transforms.Parent( static_cast< unsigned >( ancestor ) ))
+    {
+        if (ancestor == static_cast< int >( index ))
+        {
+            // The copy was attached under this transform, so taking the children would make a cycle.
+            heir = -1;
+            break;
+        }
+    }
+
+    while (component->firstChild != -1)
+    {
+        transformComponents.Get( static_cast< unsigned >( component->firstChild ) )->SetParentIndex( heir );
+    }
+
+    component->UnlinkCopies();
+    component->SetParentIndex( -1 );
+
+    transforms.LocalPosition( index ) = Vec3( 0, 0, 0 );
+    transforms.LocalRotation( index ) = Quaternion();
+    transforms.LocalScale( index ) = 1;
+    transforms.IsLocalDirty( index ) = 1;
+
+    transformComponents.Release( index );
+    isHierarchyOrderDirty = true;
+    GameObject::OnHierarchyChanged();
+}
+
+void ae3d::TransformComponent::SetParentIndex( int parent )
+{
+    const int oldParent = transforms.Parent( index );
+
+    if (oldParent != -1)
+    {
+        if (previousSibling != -1)
+        {
+            transformComponents.Get( static_cast< unsigned >( previousSibling ) )->nextSibling = nextSibling;
+        }
+        else
+        {
+            transformComponents.Get( static_cast< unsigned >( oldParent ) )->firstChild = nextSibling;
+        }
+
+        if (nextSibling != -1)
+        {
+            transformComponents.Get( static_cast< unsigned >( nextSibling ) )->previousSibling = previousSibling;
+        }
+    }
+
+    previousSibling = -1;
+    nextSibling = -1;
+
+    if (parent != -1)
+    {
+        TransformComponent* parentComponent = transformComponents.Get( static_cast< unsigned >( parent ) );
+        nextSibling = parentComponent->firstChild;
+
+        if (nextSibling != -1)
+        {
+            transformComponents.Get( static_cast< unsigned >( nextSibling ) )->previousSibling = static_cast< int >( index );
+        }
+
+        parentComponent->firstChild = static_cast< int >( index );
+    }
+
+    transforms.Parent( index ) = parent;
+    transforms.IsLocalDirty( index ) = 1;
+    isHierarchyOrderDirty = true;
+}
+
+void ae3d::TransformComponent::UnlinkCopies()
+{
+    if (copiedFrom != -1)
+    {
+        transformComponents.Get( static_cast< unsigned >( copiedFrom ) )->lastCopy = -1;
+        copiedFrom = -1;
+    }
+
+    if (lastCopy != -1)
+    {
+        transformComponents.Get( static_cast< unsigned >( lastCopy ) )->copiedFrom = -1;
+        lastCopy = -1;
+    }
+}
+
+ae3d::TransformComponent& ae3d::TransformComponent::operator=( const TransformComponent& other )
+{
+    if (&other == this)
+    {
+        return *this;
+    }
+
+    transforms.LocalPosition( index ) = transforms.LocalPosition( other.index );
+    transforms.LocalRotation( index ) = transforms.LocalRotation( other.index );
+    transforms.LocalScale( index ) = transforms.LocalScale( other.index );
+    SetParentIndex( transforms.Parent( other.index ) );
+
+    // Other's children go to its newest copy, so earlier links of both transforms are replaced.
+    if (copiedFrom != -1)
+    {
+        transformComponents.Get( static_cast< unsigned >( copiedFrom ) )->lastCopy = -1;
+    }
+
+    TransformComponent* source = transformComponents.Get( other.index );
+
+    if (source->lastCopy != -1)
+    {
+        transformComponents.Get( static_cast< unsigned >( source->lastCopy ) )->copiedFrom = -1;
+    }
+
+    source->lastCopy = static_cast< int >( index );
+    copiedFrom = static_cast< int >( other.index );
+#if defined( AE3D_OPENVR )
+    hmdView = other.hmdView;
+#endif
+    isEnabled = other.isEnabled;
+    return *this;
+}
+
+const ae3d::Vec3& ae3d::TransformComponent::GetLocalPosition() const
+{
+    return transforms.LocalPosition( index );
+}
+
+const ae3d::Quaternion& ae3d::TransformComponent::GetLocalRotation() const
+{
+    return transforms.LocalRotation( index );
+}
+
+float ae3d::TransformComponent::GetLocalScale() const
+{
+    return transforms.LocalScale( index );
+}
+
+const ae3d::Vec3& ae3d::TransformComponent::GetWorldPosition() const
+{
+    return transforms.GlobalPosition( index );
+}
+
+const ae3d::Quaternion& ae3d::TransformComponent::GetWorldRotation() const
+{
+    return transforms.GlobalRotation( index );
+}
+
+const ae3d::Matrix44& ae3d::TransformComponent::GetLocalToWorldMatrix()
+{
+    return transforms.LocalToWorldMatrix( index );
 }
 
 ae3d::TransformComponent* ae3d::TransformComponent::GetParent() const
 {
-    System::Assert( parent < static_cast< int >( transformComponents.size() ), "invalid parent transform index" );
-    return parent == -1 ? nullptr : &transformComponents[ parent ];
+    const int parent = transforms.Parent( index );
+    return parent == -1 ? nullptr : transformComponents.Get( static_cast< unsigned >( parent ) );
 }
 
 void ae3d::TransformComponent::LookAt( const Vec3& aLocalPosition, const Vec3& center, const Vec3& up )
 {
     Matrix44 lookAt;
     lookAt.MakeLookAt( aLocalPosition, center, up );
-    localRotation.FromMatrix( lookAt );
-    localPosition = aLocalPosition;
+    transforms.LocalRotation( index ).FromMatrix( lookAt );
+    transforms.LocalPosition( index ) = aLocalPosition;
+    transforms.IsLocalDirty( index ) = 1;
 }
 
 void ae3d::TransformComponent::MoveForward( float amount )
 {
     if (!IsAlmost( amount, 0 ))
     {
-        localPosition += localRotation * Vec3( 0, 0, amount );
+        transforms.LocalPosition( index ) += transforms.LocalRotation( index ) * Vec3( 0, 0, amount );
+        transforms.IsLocalDirty( index ) = 1;
     }
 }
 
@@ -61,13 +266,15 @@ void ae3d::TransformComponent::MoveRight( float amount )
 {
     if (!IsAlmost( amount, 0 ))
     {
-        localPosition += localRotation * Vec3( amount, 0, 0 );
+        transforms.LocalPosition( index ) += transforms.LocalRotation( index ) * Vec3( amount, 0, 0 );
+        transforms.IsLocalDirty( index ) = 1;
     }
 }
 
 void ae3d::TransformComponent::MoveUp( float amount )
 {
-    localPosition.y += amount;
+    transforms.LocalPosition( index ).y += amount;
+    transforms.IsLocalDirty( index ) = 1;
 }
 
 void ae3d::TransformComponent::OffsetRotate( const Vec3& axis, float angleDeg )
@@ -79,11 +286,11 @@ void ae3d::TransformComponent::OffsetRotate( const Vec3& axis, float angleDeg )
 
     if (IsAlmost( axis.y, 0 ))
     {
-        newRotation = localRotation * rot;
+        newRotation = transforms.LocalRotation( index ) * rot;
     }
     else
     {
-        newRotation = rot * localRotation;
+        newRotation = rot * transforms.LocalRotation( index );
     }
 
     newRotation.Normalize();
@@ -94,67 +301,145 @@ void ae3d::TransformComponent::OffsetRotate( const Vec3& axis, float angleDeg )
         return;
     }
 
-    localRotation = newRotation;
+    transforms.LocalRotation( index ) = newRotation;
+    transforms.IsLocalDirty( index ) = 1;
 }
 
-void ae3d::TransformComponent::UpdateLocalMatrices()
+void ae3d::TransformComponent::SortHierarchy()
 {
+    const unsigned nextFreeTransformComponent = transformComponents.GetHandleCount();
+    std::vector< int > depths( nextFreeTransformComponent, -1 );
+    int maxDepth = 0;
+
     for (unsigned componentIndex = 0; componentIndex < nextFreeTransformComponent; ++componentIndex)
     {
-        transformComponents[ componentIndex ].SolveLocalMatrix();
+        // Walks up to the first ancestor with a known depth, then walks the same chain again assigning depths.
+        int depth = 0;
+        int ancestor = transforms.Parent( componentIndex );
+
+        while (ancestor != -1 && depths[ ancestor ] == -1)
+        {
+            ++depth;
+            ancestor = transforms.Parent( ancestor );
+        }
+
+        depth += (ancestor == -1) ? 0 : depths[ ancestor ] + 1;
+
+        for (int index = static_cast< int >( componentIndex ); index != -1 && depths[ index ] == -1; --depth)
+        {
+            depths[ index ] = depth;
+            maxDepth = depth > maxDepth ? depth : maxDepth;
+            index = transforms.Parent( index );
+        }
     }
 
+    // Counting sort by depth.
+    depthStarts.assign( maxDepth + 2, 0 );
+
     for (unsigned componentIndex = 0; componentIndex < nextFreeTransformComponent; ++componentIndex)
     {
-        int parent = transformComponents[ componentIndex ].parent;
+        ++depthStarts[ depths[ componentIndex ] + 1 ];
+    }
 
-        Matrix44 transform = transformComponents[ componentIndex ].localMatrix;
+    for (std::size_t depth = 1; depth < depthStarts.size(); ++depth)
+    {
+        depthStarts[ depth ] += depthStarts[ depth - 1 ];
+    }
 
-        Quaternion worldRotation = transformComponents[ componentIndex ].localRotation;
-        
-        while (parent != -1)
-        {
-            Matrix44::Multiply( transform, transformComponents[ parent ].GetLocalMatrix(), transform );
-            worldRotation = worldRotation * transformComponents[ parent ].localRotation;
-            parent = transformComponents[ parent ].parent;
-        }
+    std::vector< unsigned > nextSlot( depthStarts.begin(), depthStarts.end() - 1 );
+    hierarchyOrder.resize( nextFreeTransformComponent );
+
+    for (unsigned componentIndex = 0; componentIndex < nextFreeTransformComponent; ++componentIndex)
+    {
+        hierarchyOrder[ nextSlot[ depths[ componentIndex ] ]++ ] = componentIndex;
+    }
+
+    isHierarchyOrderDirty = false;
+}
+
+void ae3d::TransformComponent::UpdateLocalMatrices()
+{
+    if (isHierarchyOrderDirty)
+    {
+        SortHierarchy();
+    }
 
-        transformComponents[ componentIndex ].localToWorldMatrix = transform;
-        Matrix44::TransformPoint( Vec3( 0, 0, 0 ), transform, &transformComponents[ componentIndex ].globalPosition );
-        transformComponents[ componentIndex ].globalRotation = worldRotation;
+    const unsigned worldVersion = ++worldUpdateCount;
+
+    // Components at the same depth don't depend on each other, so each depth is updated in parallel.
+    for (std::size_t depth = 0; depth + 1 < depthStarts.size(); ++depth)
+    {
+        const unsigned depthStart = depthStarts[ depth ];
+
+        JobSystem::ParallelFor( depthStarts[ depth + 1 ] - depthStart, TransformBatchSize, [depthStart, worldVersion]( unsigned begin, unsigned end )
+        {
+            // Changed transforms are gathered into groups of 4 for the kernel.
+            unsigned batch[ 4 ];
+            unsigned batchCount = 0;
+
+            for (unsigned orderIndex = begin; orderIndex < end; ++orderIndex)
+            {
+                const unsigned componentIndex = hierarchyOrder[ depthStart + orderIndex ];
+                const int parent = transforms.Parent( componentIndex );
+
+                transforms.HasWorldChanged( componentIndex ) = transforms.IsLocalDirty( componentIndex ) || (parent != -1 && transforms.HasWorldChanged( parent ));
+
+                if (!transforms.HasWorldChanged( componentIndex ))
+                {
+                    continue;
+                }
+
+                transforms.IsLocalDirty( componentIndex ) = 0;
+                transforms.WorldVersion( componentIndex ) = worldVersion;
+                batch[ batchCount++ ] = componentIndex;
+
+                if (batchCount == 4)
+                {
+                    UpdateWorldMatrices4( transforms, batch );
+                    batchCount = 0;
+                }
+            }
+
+            if (batchCount > 0)
+            {
+                // Repeats the last transform to fill the batch.
+                for (unsigned lane = batchCount; lane < 4; ++lane)
+                {
+                    batch[ lane ] = batch[ batchCount - 1 ];
+                }
+
+                UpdateWorldMatrices4( transforms, batch );
+            }
+        } );
     }
 }
 
+unsigned ae3d::TransformComponent::GetWorldVersion() const
+{
+    return transforms.WorldVersion( index );
+}
+
 const ae3d::Matrix44& ae3d::TransformComponent::GetLocalMatrix()
 {
-    return localMatrix;
+    return transforms.LocalMatrix( index );
 }
 
 void ae3d::TransformComponent::SetLocalPosition( const Vec3& localPos )
 {
-    localPosition = localPos;
+    transforms.LocalPosition( index ) = localPos;
+    transforms.IsLocalDirty( index ) = 1;
 }
 
 void ae3d::TransformComponent::SetLocalRotation( const Quaternion& localRot )
 {
-    localRotation = localRot;
+    transforms.LocalRotation( index ) = localRot;
+    transforms.IsLocalDirty( index ) = 1;
 }
 
 void ae3d::TransformComponent::SetLocalScale( float aLocalScale )
 {
-    localScale = aLocalScale;
-}
-
-void ae3d::TransformComponent::SolveLocalMatrix()
-{
-    localRotation.GetMatrix( localMatrix );
-    
-    if (localScale != 1)
-    {
-        localMatrix.Scale( localScale, localScale, localScale );
-    }
-    
-    localMatrix.SetTranslation( localPosition );
+    transforms.LocalScale( index ) = aLocalScale;
+    transforms.IsLocalDirty( index ) = 1;
 }
 
 void ae3d::TransformComponent::SetVrView( const Matrix44& view )
@@ -168,6 +453,13 @@ void ae3d::TransformComponent::SetVrView( const Matrix44& view )
 
 void ae3d::TransformComponent::SetParent( TransformComponent* aParent )
 {
+    if (aParent == nullptr)
+    {
+        SetParentIndex( -1 );
+        GameObject::OnHierarchyChanged();
+        return;
+    }
+
     const TransformComponent* testComponent = aParent;
     
     // Disallows cycles.
@@ -178,17 +470,11 @@ void ae3d::TransformComponent::SetParent( TransformComponent* aParent )
             return;
         }
         
-        testComponent = testComponent->parent == -1 ? nullptr : &transformComponents[ testComponent->parent ];
+        testComponent = testComponent->GetParent();
     }
 
-    for (std::size_t componentIndex = 0; componentIndex < transformComponents.size(); ++componentIndex)
-    {
-        if (&transformComponents[ componentIndex ] == aParent)
-        {
-            parent = static_cast< int >( componentIndex );
-            return;
-        }
-    }
+    SetParentIndex( static_cast< int >( aParent->index ) );
+    GameObject::OnHierarchyChanged();
 }
 
 std::string GetSerialized( ae3d::TransformComponent* component )
@@ -212,7 +498,7 @@ ae3d::Vec3 ae3d::TransformComponent::GetViewDirection() const
     ae3d::Matrix44 view;
     GetWorldRotation().GetMatrix( view );
     Matrix44 translation;
-    translation.SetTranslation( -globalPosition );
+    translation.SetTranslation( -transforms.GlobalPosition( index ) );
     Matrix44::Multiply( translation, view, view );
 
     return Vec3( view.m[ 2 ], view.m[ 6 ], view.m[ 10 ] ).Normalized();
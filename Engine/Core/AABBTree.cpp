@@ -0,0 +1,330 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "AABBTree.hpp"
+#include "Frustum.hpp"
+#include "System.hpp"
+
+using namespace ae3d;
+
+namespace
+{
+    // Leaf AABBs are grown by this fraction of their size plus MinFatMargin, so small movements don't reinsert them.
+    const float FatMarginRatio = 0.1f;
+    const float MinFatMargin = 0.1f;
+
+    float Min( float a, float b ) { return a < b ? a : b; }
+    float Max( float a, float b ) { return a > b ? a : b; }
+    int Max( int a, int b ) { return a > b ? a : b; }
+
+    void Union( const Vec3& aMin, const Vec3& aMax, const Vec3& bMin, const Vec3& bMax, Vec3& outMin, Vec3& outMax )
+    {
+        outMin = Vec3( Min( aMin.x, bMin.x ), Min( aMin.y, bMin.y ), Min( aMin.z, bMin.z ) );
+        outMax = Vec3( Max( aMax.x, bMax.x ), Max( aMax.y, bMax.y ), Max( aMax.z, bMax.z ) );
+    }
+
+    float SurfaceArea( const Vec3& aabbMin, const Vec3& aabbMax )
+    {
+        const Vec3 size = aabbMax - aabbMin;
+        return 2 * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    bool Contains( const Vec3& outerMin, const Vec3& outerMax, const Vec3& innerMin, const Vec3& innerMax )
+    {
+        return outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z &&
+               innerMax.x <= outerMax.x && innerMax.y <= outerMax.y && innerMax.z <= outerMax.z;
+    }
+}
+
+int AABBTree::AllocateNode()
+{
+    int node;
+
+    if (freeList == NullNode)
+    {
+        node = static_cast< int >( nodes.size() );
+        nodes.push_back( Node() );
+    }
+    else
+    {
+        node = freeList;
+        freeList = nodes[ node ].parentOrNext;
+    }
+
+    nodes[ node ].parentOrNext = NullNode;
+    nodes[ node ].child1 = NullNode;
+    nodes[ node ].child2 = NullNode;
+    nodes[ node ].height = 0;
+    return node;
+}
+
+void AABBTree::FreeNode( int node )
+{
+    nodes[ node ].parentOrNext = freeList;
+    nodes[ node ].height = -1;
+    freeList = node;
+}
+
+int AABBTree::CreateProxy( const Vec3& aabbMin, const Vec3& aabbMax, unsigned userData )
+{
+    const int proxy = AllocateNode();
+    const Vec3 margin = (aabbMax - aabbMin) * FatMarginRatio + Vec3( MinFatMargin, MinFatMargin, MinFatMargin );
+    nodes[ proxy ].aabbMin = aabbMin - margin;
+    nodes[ proxy ].aabbMax = aabbMax + margin;
+    nodes[ proxy ].userData = userData;
+    InsertLeaf( proxy );
+    return proxy;
+}
+
+void AABBTree::DestroyProxy( int proxy )
+{
+    System::Assert( 0 <= proxy && proxy < static_cast< int >( nodes.size() ) && nodes[ proxy ].IsLeaf(), "invalid AABB tree proxy" );
+
+    RemoveLeaf( proxy );
+    FreeNode( proxy );
+}
+
+bool AABBTree::MoveProxy( int proxy, const Vec3& aabbMin, const Vec3& aabbMax )
+{
+    System::Assert( 0 <= proxy && proxy < static_cast< int >( nodes.size() ) && nodes[ proxy ].IsLeaf(), "invalid AABB tree proxy" );
+
+    if (Contains( nodes[ proxy ].aabbMin, nodes[ proxy ].aabbMax, aabbMin, aabbMax ))
+    {
+        return false;
+    }
+
+    RemoveLeaf( proxy );
+    const Vec3 margin = (aabbMax - aabbMin) * FatMarginRatio + Vec3( MinFatMargin, MinFatMargin, MinFatMargin );
+    nodes[ proxy ].aabbMin = aabbMin - margin;
+    nodes[ proxy ].aabbMax = aabbMax + margin;
+    InsertLeaf( proxy );
+    return true;
+}
+
+void AABBTree::Query( const Frustum& frustum, std::vector< unsigned >& outUserData ) const
+{
+    if (root == NullNode)
+    {
+        return;
+    }
+
+    std::vector< int > stack;
+    stack.reserve( 64 );
+    stack.push_back( root );
+
+    while (!stack.empty())
+    {
+        const Node& node = nodes[ stack.back() ];
+        stack.pop_back();
+
+        if (!frustum.BoxInFrustum( node.aabbMin, node.aabbMax ))
+        {
+            continue;
+        }
+
+        if (node.IsLeaf())
+        {
+            outUserData.push_back( node.userData );
+        }
+        else
+        {
+            stack.push_back( node.child1 );
+            stack.push_back( node.child2 );
+        }
+    }
+}
+
+void AABBTree::InsertLeaf( int leaf )
+{
+    if (root == NullNode)
+    {
+        root = leaf;
+        nodes[ root ].parentOrNext = NullNode;
+        return;
+    }
+
+    // Descends towards the sibling that grows the total surface area the least.
+    const Vec3 leafMin = nodes[ leaf ].aabbMin;
+    const Vec3 leafMax = nodes[ leaf ].aabbMax;
+    int index = root;
+
+    while (!nodes[ index ].IsLeaf())
+    {
+        const int child1 = nodes[ index ].child1;
+        const int child2 = nodes[ index ].child2;
+
+        Vec3 combinedMin, combinedMax;
+        Union( nodes[ index ].aabbMin, nodes[ index ].aabbMax, leafMin, leafMax, combinedMin, combinedMax );
+        const float area = SurfaceArea( nodes[ index ].aabbMin, nodes[ index ].aabbMax );
+        const float combinedArea = SurfaceArea( combinedMin, combinedMax );
+
+        // Cost of making a new parent for this node and the leaf.
+        const float cost = 2 * combinedArea;
+        // Minimum cost of pushing the leaf further down the tree.
+        const float inheritanceCost = 2 * (combinedArea - area);
+
+        float childCosts[ 2 ];
+        const int children[ 2 ] = { child1, child2 };
+
+        for (int c = 0; c < 2; ++c)
+        {
+            const Node& child = nodes[ children[ c ] ];
+            Vec3 unionMin, unionMax;
+            Union( child.aabbMin, child.aabbMax, leafMin, leafMax, unionMin, unionMax );
+            childCosts[ c ] = SurfaceArea( unionMin, unionMax ) + inheritanceCost;
+
+            if (!child.IsLeaf())
+            {
+                childCosts[ c ] -= SurfaceArea( child.aabbMin, child.aabbMax );
+            }
+        }
+
+        if (cost < childCosts[ 0 ] && cost < childCosts[ 1 ])
+        {
+            break;
+        }
+
+        index = childCosts[ 0 ] < childCosts[ 1 ] ? child1 : child2;
+    }
+
+    const int sibling = index;
+    const int oldParent = nodes[ sibling ].parentOrNext;
+    const int newParent = AllocateNode();
+    nodes[ newParent ].parentOrNext = oldParent;
+    nodes[ newParent ].height = nodes[ sibling ].height + 1;
+    nodes[ newParent ].child1 = sibling;
+    nodes[ newParent ].child2 = leaf;
+    nodes[ sibling ].parentOrNext = newParent;
+    nodes[ leaf ].parentOrNext = newParent;
+
+    if (oldParent == NullNode)
+    {
+        root = newParent;
+    }
+    else if (nodes[ oldParent ].child1 == sibling)
+    {
+        nodes[ oldParent ].child1 = newParent;
+    }
+    else
+    {
+        nodes[ oldParent ].child2 = newParent;
+    }
+
+    Refit( newParent );
+}
+
+void AABBTree::RemoveLeaf( int leaf )
+{
+    if (leaf == root)
+    {
+        root = NullNode;
+        return;
+    }
+
+    const int parent = nodes[ leaf ].parentOrNext;
+    const int grandParent = nodes[ parent ].parentOrNext;
+    const int sibling = nodes[ parent ].child1 == leaf ? nodes[ parent ].child2 : nodes[ parent ].child1;
+
+    nodes[ sibling ].parentOrNext = grandParent;
+    FreeNode( parent );
+
+    if (grandParent == NullNode)
+    {
+        root = sibling;
+        return;
+    }
+
+    if (nodes[ grandParent ].child1 == parent)
+    {
+        nodes[ grandParent ].child1 = sibling;
+    }
+    else
+    {
+        nodes[ grandParent ].child2 = sibling;
+    }
+
+    Refit( grandParent );
+}
+
+void AABBTree::Refit( int node )
+{
+    while (node != NullNode)
+    {
+        node = Balance( node );
+
+        Node& n = nodes[ node ];
+        const Node& child1 = nodes[ n.child1 ];
+        const Node& child2 = nodes[ n.child2 ];
+        n.height = 1 + Max( child1.height, child2.height );
+        Union( child1.aabbMin, child1.aabbMax, child2.aabbMin, child2.aabbMax, n.aabbMin, n.aabbMax );
+
+        node = n.parentOrNext;
+    }
+}
+
+int AABBTree::Balance( int iA )
+{
+    Node& a = nodes[ iA ];
+
+    if (a.IsLeaf() || a.height < 2)
+    {
+        return iA;
+    }
+
+    const int iB = a.child1;
+    const int iC = a.child2;
+    Node& b = nodes[ iB ];
+    Node& c = nodes[ iC ];
+    const int balance = c.height - b.height;
+
+    // Rotates the taller child up, and its shorter child down under a.
+    if (balance > 1 || balance < -1)
+    {
+        const int iUp = balance > 1 ? iC : iB;
+        const int iStay = balance > 1 ? iB : iC;
+        Node& up = nodes[ iUp ];
+        Node& stay = nodes[ iStay ];
+        const int iF = up.child1;
+        const int iG = up.child2;
+        const bool keepF = nodes[ iF ].height > nodes[ iG ].height;
+        const int iKeep = keepF ? iF : iG;
+        const int iMove = keepF ? iG : iF;
+
+        up.child1 = iA;
+        up.child2 = iKeep;
+        up.parentOrNext = a.parentOrNext;
+        a.parentOrNext = iUp;
+
+        if (up.parentOrNext == NullNode)
+        {
+            root = iUp;
+        }
+        else if (nodes[ up.parentOrNext ].child1 == iA)
+        {
+            nodes[ up.parentOrNext ].child1 = iUp;
+        }
+        else
+        {
+            nodes[ up.parentOrNext ].child2 = iUp;
+        }
+
+        if (balance > 1)
+        {
+            a.child2 = iMove;
+        }
+        else
+        {
+            a.child1 = iMove;
+        }
+
+        nodes[ iMove ].parentOrNext = iA;
+
+        Union( stay.aabbMin, stay.aabbMax, nodes[ iMove ].aabbMin, nodes[ iMove ].aabbMax, a.aabbMin, a.aabbMax );
+        a.height = 1 + Max( stay.height, nodes[ iMove ].height );
+        Union( a.aabbMin, a.aabbMax, nodes[ iKeep ].aabbMin, nodes[ iKeep ].aabbMax, up.aabbMin, up.aabbMax );
+        up.height = 1 + Max( a.height, nodes[ iKeep ].height );
+
+        return iUp;
+    }
+
+    return iA;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include "Vec3.hpp"
+
+namespace ae3d
+{
+    /// Dynamic bounding volume hierarchy of world-space AABBs. Leaves store fattened boxes, so objects that move a little
+    /// don't change the tree. The tree is kept balanced with rotations when leaves are inserted and removed.
+    class AABBTree
+    {
+    public:
+        static const int NullNode = -1;
+
+        /// \param aabbMin AABB's minimum corner.
+        /// \param aabbMax AABB's maximum corner.
+        /// \param userData Value returned by Query.
+        /// \return Proxy that identifies the leaf until it's destroyed.
+        int CreateProxy( const Vec3& aabbMin, const Vec3& aabbMax, unsigned userData );
+
+        /// \param proxy Proxy from CreateProxy.
+        void DestroyProxy( int proxy );
+
+        /// Reinserts the leaf if the new AABB is not contained in its fattened AABB.
+        /// \param proxy Proxy from CreateProxy.
+        /// \param aabbMin AABB's minimum corner.
+        /// \param aabbMax AABB's maximum corner.
+        /// \return True if the leaf was reinserted.
+        bool MoveProxy( int proxy, const Vec3& aabbMin, const Vec3& aabbMax );
+
+        /// \param proxy Proxy from CreateProxy.
+        /// \param userData Value returned by Query.
+        void SetUserData( int proxy, unsigned userData ) { nodes[ proxy ].userData = userData; }
+
+        /// Gathers user data of leaves whose fattened AABB intersects the frustum. Subtrees outside the frustum are skipped.
+        /// \param frustum Frustum.
+        /// \param outUserData Receives user data. Not cleared.
+        void Query( const class Frustum& frustum, std::vector< unsigned >& outUserData ) const;
+
+        /// \return Height of the tree. A single leaf has height 0.
+        int GetHeight() const { return root == NullNode ? 0 : nodes[ root ].height; }
+
+    private:
+        struct Node
+        {
+            bool IsLeaf() const { return child1 == NullNode; }
+
+            Vec3 aabbMin;
+            Vec3 aabbMax;
+            /// Parent or next free node.
+            int parentOrNext = NullNode;
+            int child1 = NullNode;
+            int child2 = NullNode;
+            /// Leaf is 0, free node is -1.
+            int height = -1;
+            unsigned userData = 0;
+        };
+
+        int AllocateNode();
+        void FreeNode( int node );
+        void InsertLeaf( int leaf );
+        void RemoveLeaf( int leaf );
+        /// Rotates node's subtree if its children's heights differ by more than one.
+        /// \return New root of the subtree.
+        int Balance( int node );
+        /// Recomputes AABBs and heights from node up to the root, balancing on the way.
+        void Refit( int node );
+
+        std::vector< Node > nodes;
+        int root = NullNode;
+        int freeList = NullNode;
+    };
+}
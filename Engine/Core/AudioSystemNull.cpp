@@ -0,0 +1,41 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "AudioSystem.hpp"
+#include "FileSystem.hpp"
+
+// Silent audio system used by headless builds that don't link against an audio library.
+
+namespace AudioGlobal
+{
+    unsigned clipCount = 0;
+}
+
+void ae3d::AudioSystem::Init()
+{
+}
+
+void ae3d::AudioSystem::Deinit()
+{
+}
+
+unsigned ae3d::AudioSystem::GetClipIdForData( const FileSystem::FileContentsData& clipData )
+{
+    return clipData.isLoaded ? ++AudioGlobal::clipCount : 0;
+}
+
+float ae3d::AudioSystem::GetClipLengthForId( unsigned /*handle*/ )
+{
+    return 0;
+}
+
+void ae3d::AudioSystem::Play( unsigned /*clipId*/, bool /*isLooping*/ )
+{
+}
+
+void ae3d::AudioSystem::SetListenerPosition( float /*x*/, float /*y*/, float /*z*/ )
+{
+}
+
+void ae3d::AudioSystem::SetListenerOrientation( float /*forwardX*/, float /*forwardY*/, float /*forwardZ*/ )
+{
+}
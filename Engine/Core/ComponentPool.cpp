@@ -0,0 +1,49 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "ComponentPool.hpp"
+#include <cstring>
+#include <string>
+
+namespace
+{
+    // Function-local so that pools in other translation units can register during static initialization.
+    std::vector< const ae3d::ComponentPoolStats* >& GetPools()
+    {
+        static std::vector< const ae3d::ComponentPoolStats* > pools;
+        return pools;
+    }
+
+    // Trivially destructible, so it can be read during static destruction.
+    bool isComponentStorageDestroyed = false;
+}
+
+void ae3d::RegisterComponentPool( const ComponentPoolStats* stats )
+{
+    GetPools().push_back( stats );
+}
+
+void ae3d::OnComponentStorageDestroyed()
+{
+    isComponentStorageDestroyed = true;
+}
+
+bool ae3d::IsComponentStorageDestroyed()
+{
+    return isComponentStorageDestroyed;
+}
+
+void ae3d::System::Statistics::GetComponentPoolStatistics( char* outStr, unsigned outStrSize )
+{
+    std::string str;
+
+    for (const auto stats : GetPools())
+    {
+        str += std::string( stats->name ) + " components: " + std::to_string( stats->liveCount ) + " / " + std::to_string( stats->capacity ) + "\n";
+    }
+
+    if (outStrSize > 0)
+    {
+        std::strncpy( outStr, str.c_str(), outStrSize - 1 );
+        outStr[ outStrSize - 1 ] = '\0';
+    }
+}
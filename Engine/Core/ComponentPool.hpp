@@ -0,0 +1,130 @@
+#pragma once
+
+#include <new>
+#include <vector>
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+#include "System.hpp"
+
+namespace ae3d
+{
+    /// Component pool occupancy.
+    struct ComponentPoolStats
+    {
+        /// Component type name.
+        const char* name = "";
+        /// Components that have been created and not released.
+        unsigned liveCount = 0;
+        /// Components that fit into allocated chunks.
+        unsigned capacity = 0;
+    };
+
+    /// Adds a pool into the list printed by System::Statistics::GetComponentPoolStatistics. Pools call this when they are constructed.
+    void RegisterComponentPool( const ComponentPoolStats* stats );
+
+    /// Called by pool and component storage destructors. Static destruction order across translation units is unspecified,
+    /// so game objects with static storage duration can be destroyed after the pools.
+    void OnComponentStorageDestroyed();
+
+    /// \return True after some component storage has been destroyed at exit. Components can't be released after that.
+    bool IsComponentStorageDestroyed();
+
+    /// Stores components of type T in chunks that never move, so component pointers stay valid when the pool grows.
+    /// Each chunk is twice the size of the previous one. Released handles are reused by New.
+    template< typename T > class ComponentPool
+    {
+    public:
+        /// \param name Component type name for statistics.
+        explicit ComponentPool( const char* name )
+        {
+            stats.name = name;
+            RegisterComponentPool( &stats );
+        }
+
+        ComponentPool( const ComponentPool& ) = delete;
+        ComponentPool& operator=( const ComponentPool& ) = delete;
+
+        ~ComponentPool()
+        {
+            OnComponentStorageDestroyed();
+
+            for (auto chunk : chunks)
+            {
+                delete[] chunk;
+            }
+        }
+
+        /// \return Handle of a default-constructed component.
+        unsigned New()
+        {
+            unsigned handle;
+
+            if (!freeHandles.empty())
+            {
+                handle = freeHandles.back();
+                freeHandles.pop_back();
+            }
+            else
+            {
+                if (nextUnusedHandle == stats.capacity)
+                {
+                    const unsigned chunkSize = FirstChunkSize << chunks.size();
+                    chunks.push_back( new T[ chunkSize ] );
+                    stats.capacity += chunkSize;
+                }
+
+                handle = nextUnusedHandle++;
+            }
+
+            ++stats.liveCount;
+            return handle;
+        }
+
+        /// Resets the component to its default state and lets New return its handle again.
+        /// \param handle Handle from New.
+        void Release( unsigned handle )
+        {
+            T* component = Get( handle );
+            component->~T();
+            new (component) T();
+
+            freeHandles.push_back( handle );
+            --stats.liveCount;
+        }
+
+        /// \param handle Handle from New.
+        /// \return Component. The pointer stays valid until the pool is destroyed.
+        T* Get( unsigned handle )
+        {
+            System::Assert( handle < nextUnusedHandle, "invalid component handle" );
+
+            // Chunk c holds handles FirstChunkSize * (2^c - 1) .. FirstChunkSize * (2^(c + 1) - 1) - 1.
+            const unsigned chunkIndex = FloorLog2( handle / FirstChunkSize + 1 );
+            const unsigned chunkStart = FirstChunkSize * ((1u << chunkIndex) - 1);
+            return &chunks[ chunkIndex ][ handle - chunkStart ];
+        }
+
+        /// \return Number of handles that New has returned, including released ones. Handles are smaller than this.
+        unsigned GetHandleCount() const { return nextUnusedHandle; }
+
+    private:
+        static const unsigned FirstChunkSize = 16;
+
+        static unsigned FloorLog2( unsigned value )
+        {
+#if defined( _MSC_VER )
+            unsigned long index;
+            _BitScanReverse( &index, value );
+            return static_cast< unsigned >( index );
+#else
+            return 31u - static_cast< unsigned >( __builtin_clz( value ) );
+#endif
+        }
+
+        std::vector< T* > chunks;
+        std::vector< unsigned > freeHandles;
+        unsigned nextUnusedHandle = 0;
+        ComponentPoolStats stats;
+    };
+}
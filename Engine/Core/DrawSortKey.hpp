@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+namespace ae3d
+{
+    /// Packs draw state into 64 bits, so sorting keys orders draws. Fields from the most significant bit:
+    /// Opaque:      queue (2) | shader (10) | material (12) | submesh (16) | depth (24), front-to-back.
+    /// Transparent: queue (2) | depth (24), back-to-front | shader (10) | material (12) | submesh (16).
+    /// Ids wider than their field wrap around, which only makes draws with different state share a group.
+    namespace DrawSortKey
+    {
+        /// Queues are drawn in this order.
+        enum class Queue : std::uint64_t { Opaque = 0, Transparent = 1 };
+
+        const unsigned ShaderBits = 10;
+        const unsigned MaterialBits = 12;
+        const unsigned MeshBits = 16;
+        const unsigned DepthBits = 24;
+
+        /// \param viewDepth Distance along the camera's view direction.
+        /// \param farDepth Camera's far plane distance.
+        /// \return Depth in DepthBits. Depths behind the camera or past the far plane are clamped.
+        inline std::uint64_t QuantizeDepth( float viewDepth, float farDepth )
+        {
+            const float normalizedDepth = viewDepth / farDepth;
+            const float maxDepth = static_cast< float >( (1u << DepthBits) - 1 );
+            return normalizedDepth <= 0 ? 0 : (normalizedDepth >= 1 ? static_cast< std::uint64_t >( maxDepth ) : static_cast< std::uint64_t >( normalizedDepth * maxDepth ));
+        }
+
+        /// \return Key that groups draws by state and orders each group front-to-back.
+        inline std::uint64_t MakeOpaque( unsigned shaderId, unsigned materialId, unsigned meshId, std::uint64_t quantizedDepth )
+        {
+            return (static_cast< std::uint64_t >( Queue::Opaque ) << 62) |
+                   (static_cast< std::uint64_t >( shaderId & ((1u << ShaderBits) - 1) ) << 52) |
+                   (static_cast< std::uint64_t >( materialId & ((1u << MaterialBits) - 1) ) << 40) |
+                   (static_cast< std::uint64_t >( meshId & ((1u << MeshBits) - 1) ) << 24) |
+                   quantizedDepth;
+        }
+
+        /// \return Key that orders draws back-to-front, grouping draws at equal depth by state.
+        inline std::uint64_t MakeTransparent( unsigned shaderId, unsigned materialId, unsigned meshId, std::uint64_t quantizedDepth )
+        {
+            const std::uint64_t invertedDepth = ((1u << DepthBits) - 1) - quantizedDepth;
+
+            return (static_cast< std::uint64_t >( Queue::Transparent ) << 62) |
+                   (invertedDepth << 38) |
+                   (static_cast< std::uint64_t >( shaderId & ((1u << ShaderBits) - 1) ) << 28) |
+                   (static_cast< std::uint64_t >( materialId & ((1u << MaterialBits) - 1) ) << 16) |
+                   static_cast< std::uint64_t >( meshId & ((1u << MeshBits) - 1) );
+        }
+    }
+}
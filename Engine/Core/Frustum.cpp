@@ -1,6 +1,7 @@
 // This is an independent project of an individual developer. Dear PVS-Studio, please check it.
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 #include "Frustum.hpp"
+#include <cmath>
 
 using namespace ae3d;
 
@@ -153,6 +154,34 @@ bool Frustum::BoxInFrustum( const Vec3& min, const Vec3& max ) const
     return result;
 }
 
+#ifndef SIMD_SSE3
+#if !(RENDERER_METAL && !(__i386__))
+void Frustum::BoxesInFrustum( const AABBArrays& boxes, unsigned count, unsigned* outVisibleMask ) const
+{
+    // Without SIMD the branchy per-box test of BoxInFrustum is faster than evaluating every plane with absolute normals.
+    for (unsigned word = 0; word < (count + 31) / 32; ++word)
+    {
+        const unsigned first = word * 32;
+        const unsigned last = first + 32 < count ? first + 32 : count;
+        unsigned bits = 0;
+
+        for (unsigned i = first; i < last; ++i)
+        {
+            const Vec3 center( boxes.centerX[ i ], boxes.centerY[ i ], boxes.centerZ[ i ] );
+            const Vec3 extent( boxes.extentX[ i ], boxes.extentY[ i ], boxes.extentZ[ i ] );
+
+            if (BoxInFrustum( center - extent, center + extent ))
+            {
+                bits |= 1u << (i - first);
+            }
+        }
+
+        outVisibleMask[ word ] = bits;
+    }
+}
+#endif
+#endif
+
 const Vec3& Frustum::NearTopLeft() const { return nearTopLeft; }
 const Vec3& Frustum::NearTopRight() const { return nearTopRight; }
 const Vec3& Frustum::NearBottomLeft() const { return nearBottomLeft; }
@@ -0,0 +1,95 @@
+#if RENDERER_METAL && !(__i386__)
+#include "Frustum.hpp"
+#include <arm_neon.h>
+
+using namespace ae3d;
+
+void Frustum::BoxesInFrustum( const AABBArrays& boxes, unsigned count, unsigned* outVisibleMask ) const
+{
+    for (unsigned word = 0; word < (count + 31) / 32; ++word)
+    {
+        outVisibleMask[ word ] = 0;
+    }
+
+    float32x4_t normalX[ 6 ], normalY[ 6 ], normalZ[ 6 ], absNormalX[ 6 ], absNormalY[ 6 ], absNormalZ[ 6 ], planeD[ 6 ];
+
+    for (int p = 0; p < 6; ++p)
+    {
+        normalX[ p ] = vdupq_n_f32( planes[ p ].normal.x );
+        normalY[ p ] = vdupq_n_f32( planes[ p ].normal.y );
+        normalZ[ p ] = vdupq_n_f32( planes[ p ].normal.z );
+        absNormalX[ p ] = vabsq_f32( normalX[ p ] );
+        absNormalY[ p ] = vabsq_f32( normalY[ p ] );
+        absNormalZ[ p ] = vabsq_f32( normalZ[ p ] );
+        planeD[ p ] = vdupq_n_f32( planes[ p ].d );
+    }
+
+    const uint32_t laneBitValues[ 4 ] = { 1, 2, 4, 8 };
+    const uint32x4_t laneBits = vld1q_u32( laneBitValues );
+
+    for (unsigned i = 0; i < count; i += 4)
+    {
+        float32x4_t centerX, centerY, centerZ, extentX, extentY, extentZ;
+
+        if (i + 4 <= count)
+        {
+            centerX = vld1q_f32( &boxes.centerX[ i ] );
+            centerY = vld1q_f32( &boxes.centerY[ i ] );
+            centerZ = vld1q_f32( &boxes.centerZ[ i ] );
+            extentX = vld1q_f32( &boxes.extentX[ i ] );
+            extentY = vld1q_f32( &boxes.extentY[ i ] );
+            extentZ = vld1q_f32( &boxes.extentZ[ i ] );
+        }
+        else
+        {
+            // Pads the last group by repeating its last box. Padding lanes are masked out below.
+            float lanes[ 6 ][ 4 ];
+
+            for (unsigned lane = 0; lane < 4; ++lane)
+            {
+                const unsigned box = i + lane < count ? i + lane : count - 1;
+                lanes[ 0 ][ lane ] = boxes.centerX[ box ];
+                lanes[ 1 ][ lane ] = boxes.centerY[ box ];
+                lanes[ 2 ][ lane ] = boxes.centerZ[ box ];
+                lanes[ 3 ][ lane ] = boxes.extentX[ box ];
+                lanes[ 4 ][ lane ] = boxes.extentY[ box ];
+                lanes[ 5 ][ lane ] = boxes.extentZ[ box ];
+            }
+
+            centerX = vld1q_f32( lanes[ 0 ] );
+            centerY = vld1q_f32( lanes[ 1 ] );
+            centerZ = vld1q_f32( lanes[ 2 ] );
+            extentX = vld1q_f32( lanes[ 3 ] );
+            extentY = vld1q_f32( lanes[ 4 ] );
+            extentZ = vld1q_f32( lanes[ 5 ] );
+        }
+
+        uint32x4_t isVisible = vdupq_n_u32( 0xFFFFFFFF );
+
+        // The box is outside if its corner furthest along the normal is behind the plane.
+        for (int p = 0; p < 6; ++p)
+        {
+            float32x4_t distance = vmulq_f32( normalX[ p ], centerX );
+            distance = vmlaq_f32( distance, normalY[ p ], centerY );
+            distance = vaddq_f32( vmlaq_f32( distance, normalZ[ p ], centerZ ), planeD[ p ] );
+            float32x4_t radius = vmulq_f32( absNormalX[ p ], extentX );
+            radius = vmlaq_f32( radius, absNormalY[ p ], extentY );
+            radius = vmlaq_f32( radius, absNormalZ[ p ], extentZ );
+            isVisible = vandq_u32( isVisible, vcgeq_f32( vaddq_f32( distance, radius ), vdupq_n_f32( 0 ) ) );
+        }
+
+        // Horizontal add of lane bits. vpadd works on both 32- and 64-bit ARM.
+        const uint32x4_t selectedBits = vandq_u32( isVisible, laneBits );
+        uint32x2_t sum = vpadd_u32( vget_low_u32( selectedBits ), vget_high_u32( selectedBits ) );
+        sum = vpadd_u32( sum, sum );
+        unsigned bits = vget_lane_u32( sum, 0 );
+
+        if (i + 4 > count)
+        {
+            bits &= (1u << (count - i)) - 1;
+        }
+
+        outVisibleMask[ i / 32 ] |= bits << (i % 32);
+    }
+}
+#endif
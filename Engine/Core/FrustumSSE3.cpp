@@ -0,0 +1,89 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#ifdef SIMD_SSE3
+#include "Frustum.hpp"
+#include <pmmintrin.h>
+
+using namespace ae3d;
+
+void Frustum::BoxesInFrustum( const AABBArrays& boxes, unsigned count, unsigned* outVisibleMask ) const
+{
+    for (unsigned word = 0; word < (count + 31) / 32; ++word)
+    {
+        outVisibleMask[ word ] = 0;
+    }
+
+    __m128 normalX[ 6 ], normalY[ 6 ], normalZ[ 6 ], absNormalX[ 6 ], absNormalY[ 6 ], absNormalZ[ 6 ], planeD[ 6 ];
+    const __m128 signMask = _mm_set1_ps( -0.0f );
+
+    for (int p = 0; p < 6; ++p)
+    {
+        normalX[ p ] = _mm_set1_ps( planes[ p ].normal.x );
+        normalY[ p ] = _mm_set1_ps( planes[ p ].normal.y );
+        normalZ[ p ] = _mm_set1_ps( planes[ p ].normal.z );
+        absNormalX[ p ] = _mm_andnot_ps( signMask, normalX[ p ] );
+        absNormalY[ p ] = _mm_andnot_ps( signMask, normalY[ p ] );
+        absNormalZ[ p ] = _mm_andnot_ps( signMask, normalZ[ p ] );
+        planeD[ p ] = _mm_set1_ps( planes[ p ].d );
+    }
+
+    for (unsigned i = 0; i < count; i += 4)
+    {
+        __m128 centerX, centerY, centerZ, extentX, extentY, extentZ;
+
+        if (i + 4 <= count)
+        {
+            centerX = _mm_loadu_ps( &boxes.centerX[ i ] );
+            centerY = _mm_loadu_ps( &boxes.centerY[ i ] );
+            centerZ = _mm_loadu_ps( &boxes.centerZ[ i ] );
+            extentX = _mm_loadu_ps( &boxes.extentX[ i ] );
+            extentY = _mm_loadu_ps( &boxes.extentY[ i ] );
+            extentZ = _mm_loadu_ps( &boxes.extentZ[ i ] );
+        }
+        else
+        {
+            // Pads the last group by repeating its last box. Padding lanes are masked out below.
+            float lanes[ 6 ][ 4 ];
+
+            for (unsigned lane = 0; lane < 4; ++lane)
+            {
+                const unsigned box = i + lane < count ? i + lane : count - 1;
+                lanes[ 0 ][ lane ] = boxes.centerX[ box ];
+                lanes[ 1 ][ lane ] = boxes.centerY[ box ];
+                lanes[ 2 ][ lane ] = boxes.centerZ[ box ];
+                lanes[ 3 ][ lane ] = boxes.extentX[ box ];
+                lanes[ 4 ][ lane ] = boxes.extentY[ box ];
+                lanes[ 5 ][ lane ] = boxes.extentZ[ box ];
+            }
+
+            centerX = _mm_loadu_ps( lanes[ 0 ] );
+            centerY = _mm_loadu_ps( lanes[ 1 ] );
+            centerZ = _mm_loadu_ps( lanes[ 2 ] );
+            extentX = _mm_loadu_ps( lanes[ 3 ] );
+            extentY = _mm_loadu_ps( lanes[ 4 ] );
+            extentZ = _mm_loadu_ps( lanes[ 5 ] );
+        }
+
+        __m128 isVisible = _mm_castsi128_ps( _mm_set1_epi32( -1 ) );
+
+        // The box is outside if its corner furthest along the normal is behind the plane.
+        for (int p = 0; p < 6; ++p)
+        {
+            __m128 distance = _mm_add_ps( _mm_mul_ps( normalX[ p ], centerX ), _mm_mul_ps( normalY[ p ], centerY ) );
+            distance = _mm_add_ps( _mm_add_ps( distance, _mm_mul_ps( normalZ[ p ], centerZ ) ), planeD[ p ] );
+            __m128 radius = _mm_add_ps( _mm_mul_ps( absNormalX[ p ], extentX ), _mm_mul_ps( absNormalY[ p ], extentY ) );
+            radius = _mm_add_ps( radius, _mm_mul_ps( absNormalZ[ p ], extentZ ) );
+            isVisible = _mm_and_ps( isVisible, _mm_cmpge_ps( _mm_add_ps( distance, radius ), _mm_setzero_ps() ) );
+        }
+
+        unsigned bits = static_cast< unsigned >( _mm_movemask_ps( isVisible ) );
+
+        if (i + 4 > count)
+        {
+            bits &= (1u << (count - i)) - 1;
+        }
+
+        outVisibleMask[ i / 32 ] |= bits << (i % 32);
+    }
+}
+#endif
@@ -0,0 +1,268 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "JobSystem.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "System.hpp"
+
+namespace
+{
+    constexpr int MaxWorkers = 63;
+
+    struct Job
+    {
+        std::function< void() > function;
+        ae3d::JobSystem::Counter* counter = nullptr;
+        ae3d::JobSystem::Counter* dependency = nullptr;
+    };
+
+    // Owner pushes and pops at the back, thieves steal from the front so they take the oldest, usually largest, work.
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque< Job > jobs;
+    };
+
+    // Queue 0 is shared by all threads that are not workers, queue n + 1 belongs to worker n.
+    WorkQueue queues[ MaxWorkers + 1 ];
+    std::atomic< int > queuedJobCount{ 0 };
+    std::atomic< bool > isRunning{ false };
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    int workerCount = 0;
+    thread_local int threadQueueIndex = 0;
+
+    struct WorkerThreads
+    {
+        ~WorkerThreads() { ae3d::JobSystem::Deinit(); }
+
+        std::vector< std::thread > threads;
+    };
+
+    WorkerThreads workerThreads;
+
+    bool PopJob( int queueIndex, Job& outJob )
+    {
+        std::lock_guard< std::mutex > lock( queues[ queueIndex ].mutex );
+
+        if (queues[ queueIndex ].jobs.empty())
+        {
+            return false;
+        }
+
+        outJob = std::move( queues[ queueIndex ].jobs.back() );
+        queues[ queueIndex ].jobs.pop_back();
+        return true;
+    }
+
+    bool StealJob( int queueIndex, Job& outJob )
+    {
+        std::lock_guard< std::mutex > lock( queues[ queueIndex ].mutex );
+
+        if (queues[ queueIndex ].jobs.empty())
+        {
+            return false;
+        }
+
+        outJob = std::move( queues[ queueIndex ].jobs.front() );
+        queues[ queueIndex ].jobs.pop_front();
+        return true;
+    }
+
+    void PushJob( int queueIndex, Job&& job )
+    {
+        {
+            std::lock_guard< std::mutex > lock( queues[ queueIndex ].mutex );
+            queues[ queueIndex ].jobs.push_back( std::move( job ) );
+        }
+
+        ++queuedJobCount;
+        wakeCondition.notify_one();
+    }
+
+    /// \return True if a job was run.
+    bool TryRunJob()
+    {
+        Job job;
+        bool foundJob = PopJob( threadQueueIndex, job );
+
+        for (int offset = 1; offset <= workerCount && !foundJob; ++offset)
+        {
+            foundJob = StealJob( (threadQueueIndex + offset) % (workerCount + 1), job );
+        }
+
+        if (!foundJob)
+        {
+            return false;
+        }
+
+        --queuedJobCount;
+
+        // Requeues at the front so that the jobs it depends on get picked first.
+        if (job.dependency != nullptr && job.dependency->value.load() > 0)
+        {
+            {
+                std::lock_guard< std::mutex > lock( queues[ threadQueueIndex ].mutex );
+                queues[ threadQueueIndex ].jobs.push_front( std::move( job ) );
+            }
+
+            ++queuedJobCount;
+            return false;
+        }
+
+        job.function();
+
+        if (job.counter != nullptr)
+        {
+            --job.counter->value;
+        }
+
+        return true;
+    }
+
+    /// Runs jobs on the calling thread until all queues are empty.
+    void DrainQueues()
+    {
+        while (queuedJobCount.load() > 0)
+        {
+            if (!TryRunJob())
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void WorkerMain( int queueIndex )
+    {
+        threadQueueIndex = queueIndex;
+
+        while (isRunning.load())
+        {
+            if (TryRunJob())
+            {
+                continue;
+            }
+
+            std::unique_lock< std::mutex > lock( wakeMutex );
+            wakeCondition.wait_for( lock, std::chrono::milliseconds( 1 ), [] { return queuedJobCount.load() > 0 || !isRunning.load(); } );
+        }
+    }
+}
+
+void ae3d::JobSystem::Init( int aWorkerCount )
+{
+    if (isRunning.load())
+    {
+        return;
+    }
+
+    if (aWorkerCount <= 0)
+    {
+        const int hardwareThreads = static_cast< int >( std::thread::hardware_concurrency() );
+        aWorkerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+    }
+
+    workerCount = aWorkerCount < MaxWorkers ? aWorkerCount : MaxWorkers;
+    isRunning = true;
+
+    for (int workerIndex = 0; workerIndex < workerCount; ++workerIndex)
+    {
+        workerThreads.threads.push_back( std::thread( WorkerMain, workerIndex + 1 ) );
+    }
+}
+
+void ae3d::JobSystem::Deinit()
+{
+    if (!isRunning.load())
+    {
+        return;
+    }
+
+    // TryRunJob also returns false when it requeues a job whose dependency is pending, so it can't tell when the queues are empty.
+    DrainQueues();
+
+    isRunning = false;
+    wakeCondition.notify_all();
+
+    for (auto& thread : workerThreads.threads)
+    {
+        thread.join();
+    }
+
+    // Jobs that were running when the workers stopped may have queued more jobs.
+    DrainQueues();
+
+    workerThreads.threads.clear();
+    workerCount = 0;
+}
+
+int ae3d::JobSystem::GetWorkerCount()
+{
+    return workerCount;
+}
+
+void ae3d::JobSystem::Run( const std::function< void() >& function, Counter* counter, Counter* dependency )
+{
+    Init( 0 );
+
+    if (counter != nullptr)
+    {
+        ++counter->value;
+    }
+
+    Job job;
+    job.function = function;
+    job.counter = counter;
+    job.dependency = dependency;
+    PushJob( threadQueueIndex, std::move( job ) );
+}
+
+void ae3d::JobSystem::Wait( Counter* counter )
+{
+    System::Assert( counter != nullptr, "Wait needs a counter" );
+
+    while (counter->value.load() > 0)
+    {
+        if (!TryRunJob())
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void ae3d::JobSystem::ParallelFor( unsigned count, unsigned batchSize, const std::function< void( unsigned begin, unsigned end ) >& function )
+{
+    batchSize = batchSize > 0 ? batchSize : 1;
+
+    if (count <= batchSize)
+    {
+        function( 0, count );
+        return;
+    }
+
+    Init( 0 );
+
+    if (workerCount == 0)
+    {
+        function( 0, count );
+        return;
+    }
+
+    Counter counter;
+
+    // The calling thread takes the last batch itself instead of queueing it.
+    unsigned begin = 0;
+
+    for (; begin + batchSize < count; begin += batchSize)
+    {
+        const unsigned end = begin + batchSize;
+        Run( [ &function, begin, end ]() { function( begin, end ); }, &counter, nullptr );
+    }
+
+    function( begin, count );
+    Wait( &counter );
+}
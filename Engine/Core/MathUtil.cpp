@@ -1,5 +1,7 @@
 // This is an independent project of an individual developer. Dear PVS-Studio, please check it.
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include <cmath>
+#include "Matrix.hpp"
 #include "Vec3.hpp"
 
 using namespace ae3d;
@@ -59,6 +61,20 @@ namespace MathUtil
         outCorners[ 7 ] = Vec3( max.x, min.y, max.z );
     }
 
+    // Transforms the center and projects the extent onto world axes with the absolute rotation-scale part of the matrix.
+    // Gives the same box as transforming all 8 corners and taking their min/max, with one point transform.
+    void TransformAABB( const Vec3& localMin, const Vec3& localMax, const Matrix44& localToWorld, Vec3& outCenter, Vec3& outExtent )
+    {
+        const Vec3 localCenter = (localMin + localMax) * 0.5f;
+        const Vec3 localExtent = (localMax - localMin) * 0.5f;
+        const float* m = localToWorld.m;
+
+        Matrix44::TransformPoint( localCenter, localToWorld, &outCenter );
+        outExtent = Vec3( std::abs( m[ 0 ] ) * localExtent.x + std::abs( m[ 4 ] ) * localExtent.y + std::abs( m[  8 ] ) * localExtent.z,
+                          std::abs( m[ 1 ] ) * localExtent.x + std::abs( m[ 5 ] ) * localExtent.y + std::abs( m[  9 ] ) * localExtent.z,
+                          std::abs( m[ 2 ] ) * localExtent.x + std::abs( m[ 6 ] ) * localExtent.y + std::abs( m[ 10 ] ) * localExtent.z );
+    }
+
     float Floor( float f )
     {
         return floorf( f );
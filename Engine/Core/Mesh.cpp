@@ -206,6 +206,115 @@ unsigned ae3d::Mesh::GetSubMeshCount() const
     return (unsigned)m().subMeshes.size();
 }
 
+bool ae3d::Mesh::CanBatchSubMesh( unsigned subMeshIndex ) const
+{
+    const SubMesh& subMesh = m().subMeshes[ subMeshIndex ];
+    return subMesh.joints.empty() && subMesh.verticesPTNTC_Skinned.empty() && (!subMesh.verticesPTNTC.empty() || !subMesh.verticesPTN.empty());
+}
+
+bool ae3d::Mesh::AppendTransformedSubMesh( const Mesh& source, unsigned subMeshIndex, const Matrix44& localToWorld )
+{
+    const SubMesh& sourceSubMesh = source.m().subMeshes[ subMeshIndex ];
+    const bool isPTNTC = !sourceSubMesh.verticesPTNTC.empty();
+    const std::size_t sourceVertexCount = isPTNTC ? sourceSubMesh.verticesPTNTC.size() : sourceSubMesh.verticesPTN.size();
+
+    if (m().subMeshes.empty())
+    {
+        const float maxValue = 99999999.0f;
+        m().subMeshes.resize( 1 );
+        m().subMeshes[ 0 ].aabbMin = {  maxValue,  maxValue,  maxValue };
+        m().subMeshes[ 0 ].aabbMax = { -maxValue, -maxValue, -maxValue };
+    }
+
+    SubMesh& batch = m().subMeshes[ 0 ];
+    const std::size_t vertexOffset = batch.verticesPTNTC.size();
+
+    if (vertexOffset + sourceVertexCount > 65536)
+    {
+        return false;
+    }
+
+    // Normals are transformed by the inverse transpose to stay perpendicular to non-uniformly scaled surfaces.
+    Matrix44 normalMatrix;
+    Matrix44::InverseTranspose( &localToWorld.m[ 0 ], &normalMatrix.m[ 0 ] );
+
+    const float* l = &localToWorld.m[ 0 ];
+    const float determinant = l[ 0 ] * (l[ 5 ] * l[ 10 ] - l[ 6 ] * l[ 9 ]) - l[ 1 ] * (l[ 4 ] * l[ 10 ] - l[ 6 ] * l[ 8 ]) + l[ 2 ] * (l[ 4 ] * l[ 9 ] - l[ 5 ] * l[ 8 ]);
+    // Mirroring transforms flip the winding and the bitangent.
+    const bool isMirrored = determinant < 0;
+
+    batch.verticesPTNTC.resize( vertexOffset + sourceVertexCount );
+
+    for (std::size_t v = 0; v < sourceVertexCount; ++v)
+    {
+        VertexBuffer::VertexPTNTC& vertex = batch.verticesPTNTC[ vertexOffset + v ];
+
+        if (isPTNTC)
+        {
+            vertex = sourceSubMesh.verticesPTNTC[ v ];
+        }
+        else
+        {
+            const VertexBuffer::VertexPTN& sourceVertex = sourceSubMesh.verticesPTN[ v ];
+            vertex.position = sourceVertex.position;
+            vertex.u = sourceVertex.u;
+            vertex.v = sourceVertex.v;
+            vertex.normal = sourceVertex.normal;
+            vertex.tangent = Vec4( 1, 0, 0, 1 );
+            vertex.color = Vec4( 1, 1, 1, 1 );
+        }
+
+        const Vec3 localPosition = vertex.position;
+        const Vec3 localNormal = vertex.normal;
+        const Vec3 localTangent = Vec3( vertex.tangent.x, vertex.tangent.y, vertex.tangent.z );
+        Vec3 worldTangent;
+        Matrix44::TransformPoint( localPosition, localToWorld, &vertex.position );
+        Matrix44::TransformDirection( localNormal, normalMatrix, &vertex.normal );
+        Matrix44::TransformDirection( localTangent, localToWorld, &worldTangent );
+        vertex.normal = vertex.normal.Normalized();
+        worldTangent = worldTangent.Normalized();
+        vertex.tangent = Vec4( worldTangent.x, worldTangent.y, worldTangent.z, isMirrored ? -vertex.tangent.w : vertex.tangent.w );
+
+        batch.aabbMin.x = vertex.position.x < batch.aabbMin.x ? vertex.position.x : batch.aabbMin.x;
+        batch.aabbMin.y = vertex.position.y < batch.aabbMin.y ? vertex.position.y : batch.aabbMin.y;
+        batch.aabbMin.z = vertex.position.z < batch.aabbMin.z ? vertex.position.z : batch.aabbMin.z;
+        batch.aabbMax.x = vertex.position.x > batch.aabbMax.x ? vertex.position.x : batch.aabbMax.x;
+        batch.aabbMax.y = vertex.position.y > batch.aabbMax.y ? vertex.position.y : batch.aabbMax.y;
+        batch.aabbMax.z = vertex.position.z > batch.aabbMax.z ? vertex.position.z : batch.aabbMax.z;
+    }
+
+    const unsigned short offset = static_cast< unsigned short >( vertexOffset );
+
+    for (const VertexBuffer::Face& face : sourceSubMesh.indices)
+    {
+        if (isMirrored)
+        {
+            batch.indices.push_back( VertexBuffer::Face( face.a + offset, face.c + offset, face.b + offset ) );
+        }
+        else
+        {
+            batch.indices.push_back( VertexBuffer::Face( face.a + offset, face.b + offset, face.c + offset ) );
+        }
+    }
+
+    return true;
+}
+
+void ae3d::Mesh::GenerateAppended( const char* name )
+{
+    if (m().subMeshes.empty())
+    {
+        return;
+    }
+
+    SubMesh& batch = m().subMeshes[ 0 ];
+    batch.name = name;
+    batch.vertexBuffer.Generate( batch.indices.data(), static_cast< int >( batch.indices.size() ), batch.verticesPTNTC.data(), static_cast< int >( batch.verticesPTNTC.size() ) );
+    batch.vertexBuffer.SetDebugName( name );
+    m().aabbMin = batch.aabbMin;
+    m().aabbMax = batch.aabbMax;
+}
+
 ae3d::Mesh::LoadResult ae3d::Mesh::Load( const FileSystem::FileContentsData& meshData )
 {
     for (const auto& entry : gMeshCache)
@@ -261,6 +370,9 @@ ae3d::Mesh::LoadResult ae3d::Mesh::Load( const FileSystem::FileContentsData& mes
         firstSubMesh.vertexBuffer.SetDebugName( "default mesh" );
         firstSubMesh.aabbMin = {-s, -s, -s};
         firstSubMesh.aabbMax = { s,  s, s };
+        // Culling uses the mesh's AABB.
+        m().aabbMin = firstSubMesh.aabbMin;
+        m().aabbMax = firstSubMesh.aabbMax;
         return LoadResult::FileNotFound;
     }
     
@@ -0,0 +1,237 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "OcclusionCuller.hpp"
+#include <cfloat>
+#include <cmath>
+#include <utility>
+#include "JobSystem.hpp"
+
+using namespace ae3d;
+
+namespace
+{
+    // Vertices closer to the camera plane than this are treated as crossing it.
+    const float MinW = 0.0001f;
+
+    float Min( float a, float b ) { return a < b ? a : b; }
+    float Max( float a, float b ) { return a > b ? a : b; }
+    int Min( int a, int b ) { return a < b ? a : b; }
+    int Max( int a, int b ) { return a > b ? a : b; }
+
+    void TransformToClip( float x, float y, float z, const Matrix44& m, float* outClip )
+    {
+        outClip[ 0 ] = m.m[ 0 ] * x + m.m[ 4 ] * y + m.m[  8 ] * z + m.m[ 12 ];
+        outClip[ 1 ] = m.m[ 1 ] * x + m.m[ 5 ] * y + m.m[  9 ] * z + m.m[ 13 ];
+        outClip[ 2 ] = m.m[ 2 ] * x + m.m[ 6 ] * y + m.m[ 10 ] * z + m.m[ 14 ];
+        outClip[ 3 ] = m.m[ 3 ] * x + m.m[ 7 ] * y + m.m[ 11 ] * z + m.m[ 15 ];
+    }
+
+    // Clamps before converting, because coordinates near the camera plane don't fit in an int.
+    int ToPixel( float coordinate, int size )
+    {
+        return coordinate < -1 ? -1 : (coordinate > size ? size : static_cast< int >( coordinate ));
+    }
+
+    // Maps NDC [-1, 1] to pixels, y down.
+    float ToScreenX( float ndcX ) { return (ndcX * 0.5f + 0.5f) * OcclusionCuller::Width; }
+    float ToScreenY( float ndcY ) { return (0.5f - ndcY * 0.5f) * OcclusionCuller::Height; }
+}
+
+void OcclusionCuller::Begin( const Matrix44& aWorldToClip )
+{
+    worldToClip = aWorldToClip;
+    triangles.clear();
+}
+
+void OcclusionCuller::AddOccluder( const Vec3* positions, unsigned positionStride, unsigned vertexCount,
+                                   const unsigned short* indices, unsigned indexCount, const Matrix44& localToWorld )
+{
+    Matrix44 localToClip;
+    Matrix44::Multiply( localToWorld, worldToClip, localToClip );
+
+    clipPositions.resize( vertexCount * 4 );
+    const unsigned char* position = reinterpret_cast< const unsigned char* >( positions );
+
+    for (unsigned v = 0; v < vertexCount; ++v)
+    {
+        const Vec3& p = *reinterpret_cast< const Vec3* >( position + v * positionStride );
+        TransformToClip( p.x, p.y, p.z, localToClip, &clipPositions[ v * 4 ] );
+    }
+
+    for (unsigned i = 0; i + 2 < indexCount; i += 3)
+    {
+        if (indices[ i + 0 ] >= vertexCount || indices[ i + 1 ] >= vertexCount || indices[ i + 2 ] >= vertexCount)
+        {
+            continue;
+        }
+
+        const float* clip[ 3 ] = { &clipPositions[ indices[ i + 0 ] * 4 ], &clipPositions[ indices[ i + 1 ] * 4 ], &clipPositions[ indices[ i + 2 ] * 4 ] };
+
+        if (clip[ 0 ][ 3 ] < MinW || clip[ 1 ][ 3 ] < MinW || clip[ 2 ][ 3 ] < MinW)
+        {
+            continue;
+        }
+
+        float x[ 3 ], y[ 3 ], z[ 3 ];
+
+        for (int c = 0; c < 3; ++c)
+        {
+            const float invW = 1.0f / clip[ c ][ 3 ];
+            x[ c ] = ToScreenX( clip[ c ][ 0 ] * invW );
+            y[ c ] = ToScreenY( clip[ c ][ 1 ] * invW );
+            z[ c ] = clip[ c ][ 2 ] * invW;
+        }
+
+        Triangle triangle;
+        triangle.minX = Max( 0, ToPixel( std::floor( Min( x[ 0 ], Min( x[ 1 ], x[ 2 ] ) ) ), Width ) );
+        triangle.maxX = Min( Width - 1, ToPixel( std::ceil( Max( x[ 0 ], Max( x[ 1 ], x[ 2 ] ) ) ), Width ) );
+        triangle.minY = Max( 0, ToPixel( std::floor( Min( y[ 0 ], Min( y[ 1 ], y[ 2 ] ) ) ), Height ) );
+        triangle.maxY = Min( Height - 1, ToPixel( std::ceil( Max( y[ 0 ], Max( y[ 1 ], y[ 2 ] ) ) ), Height ) );
+
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+        {
+            continue;
+        }
+
+        float area = (x[ 1 ] - x[ 0 ]) * (y[ 2 ] - y[ 0 ]) - (x[ 2 ] - x[ 0 ]) * (y[ 1 ] - y[ 0 ]);
+
+        if (std::fabs( area ) < 0.0001f)
+        {
+            continue;
+        }
+
+        // Both windings are rasterized, so occluders don't depend on the mesh's culling mode.
+        if (area < 0)
+        {
+            std::swap( x[ 1 ], x[ 2 ] );
+            std::swap( y[ 1 ], y[ 2 ] );
+            std::swap( z[ 1 ], z[ 2 ] );
+            area = -area;
+        }
+
+        // Edge e goes from vertex e to the next one. Its function is zero on the opposite vertex's barycentric weight.
+        for (int e = 0; e < 3; ++e)
+        {
+            const int next = (e + 1) % 3;
+            triangle.edgeA[ e ] = y[ e ] - y[ next ];
+            triangle.edgeB[ e ] = x[ next ] - x[ e ];
+            triangle.edgeC[ e ] = -(triangle.edgeA[ e ] * x[ e ] + triangle.edgeB[ e ] * y[ e ]);
+        }
+
+        // Edge 1 (v1 -> v2) is the weight of v0, edge 2 of v1 and edge 0 of v2.
+        const float invArea = 1.0f / area;
+        triangle.depthA = (triangle.edgeA[ 1 ] * z[ 0 ] + triangle.edgeA[ 2 ] * z[ 1 ] + triangle.edgeA[ 0 ] * z[ 2 ]) * invArea;
+        triangle.depthB = (triangle.edgeB[ 1 ] * z[ 0 ] + triangle.edgeB[ 2 ] * z[ 1 ] + triangle.edgeB[ 0 ] * z[ 2 ]) * invArea;
+        triangle.depthC = (triangle.edgeC[ 1 ] * z[ 0 ] + triangle.edgeC[ 2 ] * z[ 1 ] + triangle.edgeC[ 0 ] * z[ 2 ]) * invArea;
+
+        triangles.push_back( triangle );
+    }
+}
+
+void OcclusionCuller::Rasterize()
+{
+    JobSystem::ParallelFor( Height / BandHeight, 1, [&]( unsigned begin, unsigned end )
+    {
+        for (unsigned band = begin; band < end; ++band)
+        {
+            RasterizeBand( static_cast< int >( band ) );
+        }
+    } );
+}
+
+bool OcclusionCuller::IsOccluded( const Vec3& worldMin, const Vec3& worldMax ) const
+{
+    float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+    float minDepth = FLT_MAX;
+
+    for (int c = 0; c < 8; ++c)
+    {
+        float clip[ 4 ];
+        TransformToClip( (c & 1) ? worldMax.x : worldMin.x, (c & 2) ? worldMax.y : worldMin.y, (c & 4) ? worldMax.z : worldMin.z, worldToClip, clip );
+
+        if (clip[ 3 ] < MinW)
+        {
+            return false;
+        }
+
+        const float invW = 1.0f / clip[ 3 ];
+        const float x = ToScreenX( clip[ 0 ] * invW );
+        const float y = ToScreenY( clip[ 1 ] * invW );
+        minX = Min( minX, x );
+        maxX = Max( maxX, x );
+        minY = Min( minY, y );
+        maxY = Max( maxY, y );
+        minDepth = Min( minDepth, clip[ 2 ] * invW );
+    }
+
+    // Pixels whose center is inside the box's screen rectangle.
+    const int pixelMinX = Max( 0, ToPixel( std::ceil( minX - 0.5f ), Width ) );
+    const int pixelMaxX = Min( Width - 1, ToPixel( std::floor( maxX - 0.5f ), Width ) );
+    const int pixelMinY = Max( 0, ToPixel( std::ceil( minY - 0.5f ), Height ) );
+    const int pixelMaxY = Min( Height - 1, ToPixel( std::floor( maxY - 0.5f ), Height ) );
+
+    // Boxes that fall between pixel centers or outside the buffer are left to the frustum test.
+    if (pixelMinX > pixelMaxX || pixelMinY > pixelMaxY)
+    {
+        return false;
+    }
+
+    return IsRectOccluded( pixelMinX, pixelMaxX, pixelMinY, pixelMaxY, minDepth );
+}
+
+#ifndef SIMD_SSE3
+void OcclusionCuller::RasterizeBand( int band )
+{
+    const int bandMinY = band * BandHeight;
+    const int bandMaxY = bandMinY + BandHeight - 1;
+
+    for (int y = bandMinY; y <= bandMaxY; ++y)
+    {
+        for (int x = 0; x < Width; ++x)
+        {
+            depthBuffer[ y * Width + x ] = FLT_MAX;
+        }
+    }
+
+    for (const Triangle& triangle : triangles)
+    {
+        const int minY = Max( triangle.minY, bandMinY );
+        const int maxY = Min( triangle.maxY, bandMaxY );
+
+        for (int y = minY; y <= maxY; ++y)
+        {
+            const float pixelY = y + 0.5f;
+            float* row = &depthBuffer[ y * Width ];
+
+            for (int x = triangle.minX; x <= triangle.maxX; ++x)
+            {
+                const float pixelX = x + 0.5f;
+                const bool isInside = triangle.edgeA[ 0 ] * pixelX + triangle.edgeB[ 0 ] * pixelY + triangle.edgeC[ 0 ] >= 0 &&
+                                      triangle.edgeA[ 1 ] * pixelX + triangle.edgeB[ 1 ] * pixelY + triangle.edgeC[ 1 ] >= 0 &&
+                                      triangle.edgeA[ 2 ] * pixelX + triangle.edgeB[ 2 ] * pixelY + triangle.edgeC[ 2 ] >= 0;
+
+                if (isInside)
+                {
+                    row[ x ] = Min( row[ x ], triangle.depthA * pixelX + triangle.depthB * pixelY + triangle.depthC );
+                }
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::IsRectOccluded( int minX, int maxX, int minY, int maxY, float depth ) const
+{
+    for (int y = minY; y <= maxY; ++y)
+    {
+        for (int x = minX; x <= maxX; ++x)
+        {
+            if (depthBuffer[ y * Width + x ] >= depth)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+#endif
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+#include "Matrix.hpp"
+#include "Vec3.hpp"
+
+namespace ae3d
+{
+    /// Low-resolution software depth buffer for CPU occlusion culling. Occluder triangles are rasterized on worker threads,
+    /// then AABBs are tested against the buffer. Depth is clip-space z / w, so smaller is closer.
+    /// Boxes that cross the camera plane are never reported occluded.
+    class OcclusionCuller
+    {
+    public:
+        static const int Width = 256;
+        static const int Height = 128;
+
+        /// Clears occluders. Call before AddOccluder.
+        /// \param worldToClip View-projection matrix of the camera.
+        void Begin( const Matrix44& worldToClip );
+
+        /// Transforms occluder triangles into screen space. Triangles that cross the camera plane are skipped.
+        /// \param positions First vertex position.
+        /// \param positionStride Bytes between vertex positions.
+        /// \param vertexCount Vertex count. Triangles with out-of-range indices are skipped.
+        /// \param indices Triangle list indices.
+        /// \param indexCount Index count.
+        /// \param localToWorld Local-to-World matrix.
+        void AddOccluder( const Vec3* positions, unsigned positionStride, unsigned vertexCount,
+                          const unsigned short* indices, unsigned indexCount, const Matrix44& localToWorld );
+
+        /// \return True if AddOccluder has added triangles since Begin.
+        bool HasOccluders() const { return !triangles.empty(); }
+
+        /// Clears the depth buffer and rasterizes occluders into it. Bands of rows are rasterized in parallel.
+        void Rasterize();
+
+        /// Can be called from many threads after Rasterize.
+        /// \param worldMin AABB's minimum corner in world space.
+        /// \param worldMax AABB's maximum corner in world space.
+        /// \return True if the AABB is behind the occluders at every pixel it covers.
+        bool IsOccluded( const Vec3& worldMin, const Vec3& worldMax ) const;
+
+        /// \return Triangle count added since Begin.
+        unsigned GetTriangleCount() const { return static_cast< unsigned >( triangles.size() ); }
+
+    private:
+        /// Screen-space triangle as edge functions and a depth plane. A pixel center (x, y) is inside if
+        /// edgeA[ e ] * x + edgeB[ e ] * y + edgeC[ e ] >= 0 for all three edges.
+        struct Triangle
+        {
+            float edgeA[ 3 ];
+            float edgeB[ 3 ];
+            float edgeC[ 3 ];
+            float depthA;
+            float depthB;
+            float depthC;
+            int minX;
+            int maxX;
+            int minY;
+            int maxY;
+        };
+
+        static const int BandHeight = 8;
+
+        /// Rasterizes triangles overlapping rows [band * BandHeight, (band + 1) * BandHeight).
+        void RasterizeBand( int band );
+
+        /// \return True if every pixel in the inclusive rectangle is closer than depth.
+        bool IsRectOccluded( int minX, int maxX, int minY, int maxY, float depth ) const;
+
+        Matrix44 worldToClip;
+        std::vector< Triangle > triangles;
+        /// Clip-space positions of the occluder that's being added. Kept as a member to reuse its memory.
+        std::vector< float > clipPositions;
+        /// Width * Height depths, row by row.
+        std::vector< float > depthBuffer = std::vector< float >( Width * Height );
+    };
+}
@@ -0,0 +1,109 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#ifdef SIMD_SSE3
+#include "OcclusionCuller.hpp"
+#include <cfloat>
+#include <pmmintrin.h>
+
+using namespace ae3d;
+
+static_assert( OcclusionCuller::Width % 4 == 0, "rows are processed 4 pixels at a time" );
+
+void OcclusionCuller::RasterizeBand( int band )
+{
+    const int bandMinY = band * BandHeight;
+    const int bandMaxY = bandMinY + BandHeight - 1;
+    const __m128 farDepth = _mm_set1_ps( FLT_MAX );
+
+    for (int i = bandMinY * Width; i < (bandMaxY + 1) * Width; i += 4)
+    {
+        _mm_storeu_ps( &depthBuffer[ i ], farDepth );
+    }
+
+    const __m128 laneOffsets = _mm_setr_ps( 0.5f, 1.5f, 2.5f, 3.5f );
+    const __m128 zero = _mm_setzero_ps();
+
+    for (const Triangle& triangle : triangles)
+    {
+        const int minY = triangle.minY > bandMinY ? triangle.minY : bandMinY;
+        const int maxY = triangle.maxY < bandMaxY ? triangle.maxY : bandMaxY;
+        const int minX = triangle.minX & ~3;
+
+        // Functions are stepped 4 pixels at a time along a row.
+        __m128 edgeA[ 3 ], edgeStep[ 3 ];
+
+        for (int e = 0; e < 3; ++e)
+        {
+            edgeA[ e ] = _mm_set1_ps( triangle.edgeA[ e ] );
+            edgeStep[ e ] = _mm_set1_ps( triangle.edgeA[ e ] * 4 );
+        }
+
+        const __m128 depthA = _mm_set1_ps( triangle.depthA );
+        const __m128 depthStep = _mm_set1_ps( triangle.depthA * 4 );
+        const __m128 firstX = _mm_add_ps( _mm_set1_ps( static_cast< float >( minX ) ), laneOffsets );
+
+        for (int y = minY; y <= maxY; ++y)
+        {
+            const float pixelY = y + 0.5f;
+            __m128 edge[ 3 ];
+
+            for (int e = 0; e < 3; ++e)
+            {
+                edge[ e ] = _mm_add_ps( _mm_mul_ps( edgeA[ e ], firstX ), _mm_set1_ps( triangle.edgeB[ e ] * pixelY + triangle.edgeC[ e ] ) );
+            }
+
+            __m128 depth = _mm_add_ps( _mm_mul_ps( depthA, firstX ), _mm_set1_ps( triangle.depthB * pixelY + triangle.depthC ) );
+            float* row = &depthBuffer[ y * Width ];
+
+            for (int x = minX; x <= triangle.maxX; x += 4)
+            {
+                __m128 isInside = _mm_cmpge_ps( edge[ 0 ], zero );
+                isInside = _mm_and_ps( isInside, _mm_cmpge_ps( edge[ 1 ], zero ) );
+                isInside = _mm_and_ps( isInside, _mm_cmpge_ps( edge[ 2 ], zero ) );
+
+                if (_mm_movemask_ps( isInside ) != 0)
+                {
+                    const __m128 oldDepth = _mm_loadu_ps( &row[ x ] );
+                    const __m128 newDepth = _mm_min_ps( oldDepth, depth );
+                    _mm_storeu_ps( &row[ x ], _mm_or_ps( _mm_and_ps( isInside, newDepth ), _mm_andnot_ps( isInside, oldDepth ) ) );
+                }
+
+                for (int e = 0; e < 3; ++e)
+                {
+                    edge[ e ] = _mm_add_ps( edge[ e ], edgeStep[ e ] );
+                }
+
+                depth = _mm_add_ps( depth, depthStep );
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::IsRectOccluded( int minX, int maxX, int minY, int maxY, float depth ) const
+{
+    const __m128 boxDepth = _mm_set1_ps( depth );
+    const __m128i laneX = _mm_setr_epi32( 0, 1, 2, 3 );
+    // Lanes outside [minX, maxX] are masked off. Rows are padded to 4 pixels, so loads stay in the buffer.
+    const __m128i firstValidX = _mm_set1_epi32( minX - 1 );
+    const __m128i lastValidX = _mm_set1_epi32( maxX + 1 );
+
+    for (int y = minY; y <= maxY; ++y)
+    {
+        const float* row = &depthBuffer[ y * Width ];
+
+        for (int x = minX & ~3; x <= maxX; x += 4)
+        {
+            const __m128i pixelX = _mm_add_epi32( _mm_set1_epi32( x ), laneX );
+            const __m128i isInRect = _mm_and_si128( _mm_cmpgt_epi32( pixelX, firstValidX ), _mm_cmplt_epi32( pixelX, lastValidX ) );
+            const __m128 isVisible = _mm_and_ps( _mm_castsi128_ps( isInRect ), _mm_cmpge_ps( _mm_loadu_ps( &row[ x ] ), boxDepth ) );
+
+            if (_mm_movemask_ps( isVisible ) != 0)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+#endif
@@ -0,0 +1,64 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "RadixSort.hpp"
+#include <utility>
+
+void ae3d::RadixSort( std::vector< SortKeyIndex >& items, std::vector< SortKeyIndex >& scratch )
+{
+    const std::size_t count = items.size();
+
+    if (count < 2)
+    {
+        return;
+    }
+
+    const int ByteCount = 8;
+    std::size_t histograms[ ByteCount ][ 256 ] = {};
+
+    // All histograms are built in one pass over the keys.
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const std::uint64_t key = items[ i ].key;
+
+        for (int byte = 0; byte < ByteCount; ++byte)
+        {
+            ++histograms[ byte ][ (key >> (byte * 8)) & 0xFF ];
+        }
+    }
+
+    scratch.resize( count );
+    std::vector< SortKeyIndex >* source = &items;
+    std::vector< SortKeyIndex >* destination = &scratch;
+
+    for (int byte = 0; byte < ByteCount; ++byte)
+    {
+        std::size_t* histogram = histograms[ byte ];
+
+        if (histogram[ ((*source)[ 0 ].key >> (byte * 8)) & 0xFF ] == count)
+        {
+            continue;
+        }
+
+        std::size_t offset = 0;
+
+        for (int bucket = 0; bucket < 256; ++bucket)
+        {
+            const std::size_t bucketCount = histogram[ bucket ];
+            histogram[ bucket ] = offset;
+            offset += bucketCount;
+        }
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const SortKeyIndex& item = (*source)[ i ];
+            (*destination)[ histogram[ (item.key >> (byte * 8)) & 0xFF ]++ ] = item;
+        }
+
+        std::swap( source, destination );
+    }
+
+    if (source != &items)
+    {
+        items.swap( scratch );
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace ae3d
+{
+    /// Sort key and the index of the item it was made for.
+    struct SortKeyIndex
+    {
+        std::uint64_t key;
+        unsigned index;
+    };
+
+    /// Sorts items by key in linear time with a least-significant-digit radix sort, 8 bits per pass.
+    /// Passes over bytes that are equal in every key are skipped. The sort is stable.
+    /// \param items Items. Sorted in place.
+    /// \param scratch Temporary storage. Resized to items' size, kept as a parameter to reuse its memory.
+    void RadixSort( std::vector< SortKeyIndex >& items, std::vector< SortKeyIndex >& scratch );
+}
@@ -0,0 +1,262 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "RenderGraph.hpp"
+#include <map>
+#include "System.hpp"
+
+using namespace ae3d;
+
+void RenderGraph::Reset()
+{
+    resources.clear();
+    passes.clear();
+}
+
+unsigned RenderGraph::ImportTexture( RenderTexture* texture, bool isOutput )
+{
+    resources.emplace_back();
+    resources.back().texture = texture;
+    resources.back().isTexture = true;
+    resources.back().isOutput = isOutput;
+    return static_cast< unsigned >( resources.size() - 1 );
+}
+
+unsigned RenderGraph::ImportBuffer( bool isOutput )
+{
+    resources.emplace_back();
+    resources.back().isOutput = isOutput;
+    return static_cast< unsigned >( resources.size() - 1 );
+}
+
+unsigned RenderGraph::CreateTexture( const TextureDesc& desc )
+{
+    System::Assert( desc.width > 0 && desc.height > 0, "invalid transient texture dimension" );
+
+    resources.emplace_back();
+    resources.back().desc = desc;
+    resources.back().isTexture = true;
+    resources.back().isTransient = true;
+    return static_cast< unsigned >( resources.size() - 1 );
+}
+
+unsigned RenderGraph::AddPass( const char* name, Queue queue, const std::function< void( RenderGraph& ) >& execute )
+{
+    passes.emplace_back();
+    passes.back().name = name;
+    passes.back().queue = queue;
+    passes.back().execute = execute;
+    return static_cast< unsigned >( passes.size() - 1 );
+}
+
+void RenderGraph::Read( unsigned pass, unsigned resource )
+{
+    System::Assert( pass < passes.size() && resource < resources.size(), "invalid pass or resource" );
+
+    passes[ pass ].accesses.push_back( { resource, false, false } );
+}
+
+void RenderGraph::Write( unsigned pass, unsigned resource, bool discardsContents )
+{
+    System::Assert( pass < passes.size() && resource < resources.size(), "invalid pass or resource" );
+    System::Assert( passes[ pass ].queue == Queue::Graphics || !resources[ resource ].isTexture, "only graphics passes can write textures" );
+
+    passes[ pass ].accesses.push_back( { resource, true, discardsContents } );
+}
+
+RenderTexture* RenderGraph::GetTexture( unsigned resource ) const
+{
+    System::Assert( resource < resources.size() && resources[ resource ].isTexture, "resource is not a texture" );
+
+    return resources[ resource ].texture;
+}
+
+unsigned RenderGraph::GetTransitionCount() const
+{
+    std::size_t count = 0;
+
+    for (const Pass& pass : passes)
+    {
+        count += pass.transitions.size();
+    }
+
+    return static_cast< unsigned >( count );
+}
+
+void RenderGraph::Compile()
+{
+    CullPasses();
+    AssignTransientTextures();
+    ComputeTransitions();
+}
+
+void RenderGraph::CullPasses()
+{
+    // Walks passes backwards. A pass is live if it writes a resource whose contents a later live pass or the next frame needs.
+    std::vector< unsigned char > isNeeded( resources.size() );
+
+    for (std::size_t r = 0; r < resources.size(); ++r)
+    {
+        isNeeded[ r ] = resources[ r ].isOutput ? 1 : 0;
+    }
+
+    for (std::size_t p = passes.size(); p-- > 0;)
+    {
+        Pass& pass = passes[ p ];
+        pass.isLive = false;
+
+        for (const Access& access : pass.accesses)
+        {
+            pass.isLive = pass.isLive || (access.isWrite && isNeeded[ access.resource ]);
+        }
+
+        if (!pass.isLive)
+        {
+            continue;
+        }
+
+        // Earlier contents of discarded resources aren't needed, unless the pass also reads them.
+        for (const Access& access : pass.accesses)
+        {
+            if (access.isWrite && access.discardsContents)
+            {
+                isNeeded[ access.resource ] = 0;
+            }
+        }
+
+        for (const Access& access : pass.accesses)
+        {
+            if (!access.isWrite || !access.discardsContents)
+            {
+                isNeeded[ access.resource ] = 1;
+            }
+        }
+    }
+}
+
+void RenderGraph::AssignTransientTextures()
+{
+    for (Resource& resource : resources)
+    {
+        resource.firstPass = -1;
+        resource.lastPass = -1;
+    }
+
+    for (int p = 0; p < static_cast< int >( passes.size() ); ++p)
+    {
+        if (!passes[ p ].isLive)
+        {
+            continue;
+        }
+
+        for (const Access& access : passes[ p ].accesses)
+        {
+            Resource& resource = resources[ access.resource ];
+            resource.firstPass = resource.firstPass == -1 ? p : resource.firstPass;
+            resource.lastPass = p;
+        }
+    }
+
+    for (PooledTexture& pooled : pool)
+    {
+        pooled.lastPass = -1;
+    }
+
+    // Assigns in the order of first passes, so a pooled texture is reused as soon as its previous transient texture's last pass is over.
+    for (int p = 0; p < static_cast< int >( passes.size() ); ++p)
+    {
+        for (const Access& access : passes[ p ].accesses)
+        {
+            Resource& resource = resources[ access.resource ];
+
+            if (!resource.isTransient || resource.firstPass != p || resource.texture != nullptr)
+            {
+                continue;
+            }
+
+            PooledTexture* freeTexture = nullptr;
+
+            for (PooledTexture& pooled : pool)
+            {
+                if (pooled.lastPass < p && pooled.desc.width == resource.desc.width && pooled.desc.height == resource.desc.height &&
+                    pooled.desc.dataType == resource.desc.dataType)
+                {
+                    freeTexture = &pooled;
+                    break;
+                }
+            }
+
+            if (freeTexture == nullptr)
+            {
+                pool.emplace_back();
+                freeTexture = &pool.back();
+                freeTexture->texture.reset( new RenderTexture() );
+                freeTexture->texture->Create2D( resource.desc.width, resource.desc.height, resource.desc.dataType, TextureWrap::Clamp, TextureFilter::Nearest, "render graph transient" );
+                freeTexture->desc = resource.desc;
+            }
+
+            freeTexture->lastPass = resource.lastPass;
+            resource.texture = freeTexture->texture.get();
+        }
+    }
+}
+
+void RenderGraph::ComputeTransitions()
+{
+    // States are tracked per render texture instead of per resource, because transient textures that share a pooled texture share its state.
+    std::map< RenderTexture*, GfxDevice::TextureState > states;
+
+    for (Pass& pass : passes)
+    {
+        pass.transitions.clear();
+
+        if (!pass.isLive)
+        {
+            continue;
+        }
+
+        for (const Access& access : pass.accesses)
+        {
+            const Resource& resource = resources[ access.resource ];
+
+            if (!resource.isTexture || resource.texture == nullptr)
+            {
+                continue;
+            }
+
+            GfxDevice::TextureState after = GfxDevice::TextureState::RenderTarget;
+
+            if (!access.isWrite)
+            {
+                after = pass.queue == Queue::Compute ? GfxDevice::TextureState::ComputeShaderRead : GfxDevice::TextureState::PixelShaderRead;
+            }
+
+            auto state = states.insert( std::make_pair( resource.texture, GfxDevice::TextureState::Undefined ) ).first;
+
+            if (state->second != after)
+            {
+                pass.transitions.push_back( { resource.texture, state->second, after } );
+                state->second = after;
+            }
+        }
+    }
+}
+
+void RenderGraph::Execute()
+{
+    for (Pass& pass : passes)
+    {
+        if (!pass.isLive)
+        {
+            continue;
+        }
+
+        for (const Transition& transition : pass.transitions)
+        {
+            GfxDevice::TransitionRenderTexture( transition.texture, transition.before, transition.after );
+        }
+
+        pass.execute( *this );
+    }
+
+    GfxDevice::FlushOffscreenPasses();
+}
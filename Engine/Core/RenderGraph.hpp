@@ -0,0 +1,136 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include "GfxDevice.hpp"
+#include "RenderTexture.hpp"
+
+namespace ae3d
+{
+    /// Frame's passes and the resources they read and write. Passes are added in execution order, then Compile culls passes
+    /// whose writes are never read, assigns transient textures to pooled render textures and computes texture state transitions,
+    /// and Execute runs the remaining passes. Call Reset, add passes and resources, Compile and Execute once per frame.
+    class RenderGraph
+    {
+    public:
+        /// Queue that executes a pass. Determines the state a pass reads a texture in.
+        enum class Queue { Graphics, Compute };
+
+        /// Transient texture's description. Transient textures are clamped and point-sampled.
+        struct TextureDesc
+        {
+            int width = 0;
+            int height = 0;
+            RenderTexture::DataType dataType = RenderTexture::DataType::UByte;
+        };
+
+        /// Removes passes and resources. Pooled textures are kept.
+        void Reset();
+
+        /// \param texture Texture that outlives the frame. Null is the back buffer, which has no transitions.
+        /// \param isOutput True if the texture's contents are used after the frame, so passes that write it are never culled.
+        /// \return Resource.
+        unsigned ImportTexture( RenderTexture* texture, bool isOutput );
+
+        /// Imports data that is not a render texture, like light culling's tiles. It orders and keeps passes, but has no transitions.
+        /// \param isOutput True if the data is used after the frame, so passes that write it are never culled.
+        /// \return Resource.
+        unsigned ImportBuffer( bool isOutput );
+
+        /// Creates a texture that only lives from the first to the last pass that accesses it. Its contents are undefined before the first write.
+        /// Transient textures with the same desc and disjoint lifetimes share a pooled render texture.
+        /// \param desc Description.
+        /// \return Resource.
+        unsigned CreateTexture( const TextureDesc& desc );
+
+        /// \param name Name. Must outlive Execute, like a string literal.
+        /// \param queue Queue.
+        /// \param execute Called by Execute if the pass isn't culled.
+        /// \return Pass.
+        unsigned AddPass( const char* name, Queue queue, const std::function< void( RenderGraph& ) >& execute );
+
+        /// \param pass Pass.
+        /// \param resource Resource that pass reads.
+        void Read( unsigned pass, unsigned resource );
+
+        /// \param pass Pass.
+        /// \param resource Resource that pass writes. Only graphics passes can write textures.
+        /// \param discardsContents True if pass overwrites all of resource, like a clear. Otherwise the write also reads the earlier contents.
+        void Write( unsigned pass, unsigned resource, bool discardsContents );
+
+        /// Culls passes, assigns transient textures and computes transitions. Call after adding passes and before Execute.
+        void Compile();
+
+        /// Executes passes that weren't culled in the order they were added, and issues each one's transitions before it.
+        void Execute();
+
+        /// \param resource Texture resource.
+        /// \return Imported texture or transient texture's pooled texture. Transient textures are only valid after Compile.
+        RenderTexture* GetTexture( unsigned resource ) const;
+
+        /// \param pass Pass.
+        /// \return True if Compile culled pass.
+        bool IsCulled( unsigned pass ) const { return !passes[ pass ].isLive; }
+
+        /// \return Transitions that Compile computed.
+        unsigned GetTransitionCount() const;
+
+        /// \return Pooled textures. Grows to the most transient textures of a desc that have been live at the same time.
+        unsigned GetPooledTextureCount() const { return static_cast< unsigned >( pool.size() ); }
+
+    private:
+        struct Resource
+        {
+            RenderTexture* texture = nullptr;
+            TextureDesc desc;
+            bool isTexture = false;
+            bool isTransient = false;
+            bool isOutput = false;
+            /// First and last live pass that accesses the resource, set by Compile.
+            int firstPass = -1;
+            int lastPass = -1;
+        };
+
+        struct Access
+        {
+            unsigned resource;
+            bool isWrite;
+            bool discardsContents;
+        };
+
+        struct Transition
+        {
+            RenderTexture* texture;
+            GfxDevice::TextureState before;
+            GfxDevice::TextureState after;
+        };
+
+        struct Pass
+        {
+            const char* name = "";
+            Queue queue = Queue::Graphics;
+            std::function< void( RenderGraph& ) > execute;
+            std::vector< Access > accesses;
+            /// Issued before execute, set by Compile.
+            std::vector< Transition > transitions;
+            bool isLive = true;
+        };
+
+        struct PooledTexture
+        {
+            std::unique_ptr< RenderTexture > texture;
+            TextureDesc desc;
+            /// Last pass of the transient texture that was assigned to this one in Compile, or -1.
+            int lastPass = -1;
+        };
+
+        void CullPasses();
+        void AssignTransientTextures();
+        void ComputeTransitions();
+
+        std::vector< Resource > resources;
+        std::vector< Pass > passes;
+        std::vector< PooledTexture > pool;
+    };
+}
@@ -2,29 +2,40 @@
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 #include "Scene.hpp"
 #include <algorithm>
+#include <cmath>
+#include <functional>
 #include <locale>
 #include <string>
 #include <sstream>
+#include <tuple>
 #include <vector>
+#include "AABBTree.hpp"
 #include "AudioSourceComponent.hpp"
 #include "AudioSystem.hpp"
 #include "CameraComponent.hpp"
+#include "CommandStream.hpp"
 #include "DirectionalLightComponent.hpp"
+#include "DrawSortKey.hpp"
 #include "FileSystem.hpp"
 #include "Frustum.hpp"
 #include "GameObject.hpp"
 #include "GfxDevice.hpp"
+#include "JobSystem.hpp"
 #include "LightTiler.hpp"
 #include "Matrix.hpp"
 #include "Material.hpp"
 #include "Mesh.hpp"
 #include "MeshRendererComponent.hpp"
+#include "OcclusionCuller.hpp"
 #include "PointLightComponent.hpp"
+#include "RadixSort.hpp"
+#include "RenderGraph.hpp"
 #include "RenderTexture.hpp"
 #include "Renderer.hpp"
 #include "SpriteRendererComponent.hpp"
 #include "SpotLightComponent.hpp"
 #include "Statistics.hpp"
+#include "SubMesh.hpp"
 #include "System.hpp"
 #include "TextRendererComponent.hpp"
 #include "TransformComponent.hpp"
@@ -33,8 +44,6 @@
 using namespace ae3d;
 extern Renderer renderer;
 float GetVRFov();
-void BeginOffscreen();
-void EndOffscreen();
 std::string GetSerialized( ae3d::TextRendererComponent* component );
 std::string GetSerialized( ae3d::CameraComponent* component );
 std::string GetSerialized( ae3d::AudioSourceComponent* component );
@@ -46,13 +55,13 @@ std::string GetSerialized( ae3d::TransformComponent* component );
 
 namespace GfxDeviceGlobal
 {
-    extern PerObjectUboStruct perObjectUboStruct;
     extern ae3d::LightTiler lightTiler;
 }
 
 namespace MathUtil
 {
     void GetMinMax( const Vec3* aPoints, int count, Vec3& outMin, Vec3& outMax );
+    void TransformAABB( const Vec3& localMin, const Vec3& localMax, const Matrix44& localToWorld, Vec3& outCenter, Vec3& outExtent );
     bool IsNaN( float f );
 }
 
@@ -76,13 +85,28 @@ namespace SceneGlobal
 
 bool someLightCastsShadow = false;
 
-void SetupCameraForSpotShadowCasting( const Vec3& lightPosition, const Vec3& lightDirection, ae3d::CameraComponent& outCamera,
+static void RecordBeginPass( CommandStream& stream, RenderTexture* target, unsigned cubeMapFace, const int viewport[ 4 ], const Vec3& clearColor, unsigned clearFlags )
+{
+    RenderCommand::BeginPassData& data = stream.Add( RenderCommand::Type::BeginPass ).beginPass;
+    data.target = target;
+    data.cubeMapFace = cubeMapFace;
+    data.viewport[ 0 ] = viewport[ 0 ];
+    data.viewport[ 1 ] = viewport[ 1 ];
+    data.viewport[ 2 ] = viewport[ 2 ];
+    data.viewport[ 3 ] = viewport[ 3 ];
+    data.clearColor[ 0 ] = clearColor.x;
+    data.clearColor[ 1 ] = clearColor.y;
+    data.clearColor[ 2 ] = clearColor.z;
+    data.clearFlags = clearFlags;
+}
+
+void SetupCameraForSpotShadowCasting( const Vec3& lightPosition, const Vec3& lightDirection, const Vec3& up, ae3d::CameraComponent& outCamera,
                                      ae3d::TransformComponent& outCameraTransform )
 {
 #if RENDERER_METAL
-    outCameraTransform.LookAt( lightPosition, lightPosition - lightDirection * 200, Vec3( 0, 1, 0 ) );
+    outCameraTransform.LookAt( lightPosition, lightPosition - lightDirection * 200, up );
 #else
-    outCameraTransform.LookAt( lightPosition, lightPosition + lightDirection * 200, Vec3( 0, 1, 0 ) );
+    outCameraTransform.LookAt( lightPosition, lightPosition + lightDirection * 200, up );
 #endif
     outCamera.SetProjectionType( ae3d::CameraComponent::ProjectionType::Perspective );
     outCamera.SetProjection( 45, 1, 0.1f, 200 );
@@ -166,67 +190,602 @@ void SetupCameraForDirectionalShadowCasting( const Vec3& lightDirection, const F
     outCamera.SetProjection( viewMinLS.x, viewMaxLS.x, viewMinLS.y, viewMaxLS.y, -viewMaxLS.z, -viewMinLS.z );
 }
 
-void ae3d::Scene::Add( GameObject* gameObject )
+struct ae3d::Scene::DrawQueue
 {
-    for (const auto& go : gameObjects)
+    struct SubMeshDraw
+    {
+        /// Index into the meshRenderers argument of RenderSortedSubMeshes.
+        unsigned listIndex;
+        unsigned subMeshIndex;
+    };
+
+    /// Returns a small id for the key's field. Ids are assigned in order of first use and cleared every frame.
+    template< typename T > static unsigned GetSortId( std::unordered_map< const T*, unsigned >& ids, const T* object )
+    {
+        auto result = ids.insert( std::make_pair( object, static_cast< unsigned >( ids.size() ) ) );
+        return result.first->second;
+    }
+
+    /// Returns the id of the mesh's first submesh. Submeshes get consecutive ids, so draws of the same submesh sort next to each other.
+    unsigned GetSubMeshBaseId( const Mesh* mesh, unsigned subMeshCount )
     {
-        if (go == gameObject)
+        auto result = meshIds.insert( std::make_pair( mesh, nextSubMeshId ) );
+
+        if (result.second)
         {
-            return;
+            nextSubMeshId += subMeshCount;
         }
+
+        return result.first->second;
     }
 
-    if (nextFreeGameObject >= gameObjects.size())
+    // Per meshRenderers entry.
+    std::vector< Matrix44 > localToViews;
+    std::vector< Matrix44 > localToClips;
+    std::vector< std::uint64_t > quantizedDepths;
+
+    std::vector< SubMeshDraw > draws;
+    /// Index is into draws.
+    std::vector< SortKeyIndex > sortKeys;
+    std::vector< SortKeyIndex > sortScratch;
+
+    std::unordered_map< const Shader*, unsigned > shaderIds;
+    std::unordered_map< const Material*, unsigned > materialIds;
+    std::unordered_map< const Mesh*, unsigned > meshIds;
+    unsigned nextSubMeshId = 0;
+};
+
+struct ae3d::Scene::StaticBatch
+{
+    Mesh mesh;
+    /// Component handle. The component is not attached to a game object.
+    unsigned meshRenderer = 0;
+    int proxy = AABBTree::NullNode;
+    unsigned layer = 0;
+};
+
+#if RENDERER_VULKAN
+struct ae3d::Scene::IndirectQueue
+{
+    /// Submesh of a member whose instance is culled and drawn on the GPU.
+    struct SubMeshInstance
+    {
+        const Material* material;
+        const VertexBuffer* vertexBuffer;
+        /// Index into draws while the queue is rebuilt, then into sortedDraws.
+        unsigned drawIndex;
+        /// Index of the instance in the camera's resident instances.
+        unsigned instanceIndex;
+    };
+
+    /// Mesh renderer whose submeshes are drawn on the GPU.
+    struct Member
     {
-        gameObjects.resize( gameObjects.size() + 10 );
+        const MeshRendererComponent* meshRenderer;
+        unsigned firstSubMeshInstance;
+        unsigned subMeshCount;
+        /// FrameMeshRenderer::worldVersion of the uploaded instances.
+        unsigned uploadedWorldVersion;
+    };
+
+    /// Mesh renderer and submesh whose material is applied when drawing a draw.
+    struct DrawOwner
+    {
+        MeshRendererComponent* meshRenderer;
+        unsigned subMeshIndex;
+        const Material* material;
+    };
+
+    /// Resident instances and draws of a camera or a cube map face.
+    struct CameraQueue
+    {
+        /// Handle of GfxDevice::CreateIndirectInstances, or -1.
+        int instances = -1;
+        /// Mesh renderers in the order of frameMeshRenderers.
+        std::vector< Member > members;
+        std::vector< SubMeshInstance > subMeshInstances;
+        std::vector< GfxDevice::IndirectDraw > draws;
+        /// Per draws entry.
+        std::vector< DrawOwner > drawOwners;
+        /// Indices into draws, sorted by material.
+        std::vector< unsigned > drawOrder;
+        /// Draws in drawOrder with their instance ranges, as given to CullIndirect.
+        std::vector< GfxDevice::IndirectDraw > sortedDraws;
+    };
+
+    /// Releases the instances of queues whose camera isn't rendered in this frame, so removed cameras' queues don't keep theirs.
+    /// \param cameras Cameras that are rendered in this frame.
+    void BeginFrame( const std::vector< const CameraComponent* >& cameras )
+    {
+        for (auto it = std::begin( cameraQueues ); it != std::end( cameraQueues ); )
+        {
+            if (std::find( std::begin( cameras ), std::end( cameras ), it->first.first ) == std::end( cameras ))
+            {
+                Release( it->second );
+                it = cameraQueues.erase( it );
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    void ReleaseAll()
+    {
+        for (auto& cameraQueue : cameraQueues)
+        {
+            Release( cameraQueue.second );
+        }
+
+        cameraQueues.clear();
     }
 
-    gameObjects[ nextFreeGameObject++ ] = gameObject;
+    static void Release( CameraQueue& cameraQueue )
+    {
+        if (cameraQueue.instances != -1)
+        {
+            GfxDevice::ReleaseIndirectInstances( cameraQueue.instances );
+            cameraQueue.instances = -1;
+        }
+    }
+
+    /// Keyed by camera and cube map face.
+    std::map< std::pair< const CameraComponent*, int >, CameraQueue > cameraQueues;
+    /// Index into draws for each material and submesh vertex buffer. Used when rebuilding a queue.
+    std::map< std::pair< const Material*, const VertexBuffer* >, unsigned > drawIndices;
+    /// Index into sortedDraws per draws entry. Used when rebuilding a queue.
+    std::vector< unsigned > sortedDrawIndices;
+    /// Next free instance of each sortedDraws entry. Used when rebuilding a queue.
+    std::vector< unsigned > nextInstances;
+    /// Per members entry, in this frame.
+    std::vector< unsigned > memberFrameMeshRenderers;
+    /// Instances given to GfxDevice::UpdateIndirectInstances.
+    std::vector< unsigned > updatedIndices;
+    std::vector< GfxDevice::IndirectInstance > updatedInstances;
+    /// Per frameMeshRenderers entry.
+    std::vector< unsigned char > isIndirect;
+};
+#endif
+
+ae3d::Scene::Scene()
+    : meshRendererTree( new AABBTree() )
+    , occlusionCuller( new OcclusionCuller() )
+    , drawQueue( new DrawQueue() )
+    , commandStream( new CommandStream() )
+    , renderGraph( new RenderGraph() )
+#if RENDERER_VULKAN
+    , indirectQueue( new IndirectQueue() )
+#endif
+{
+}
+
+ae3d::Scene::~Scene()
+{
+    ReleaseStaticBatches();
+#if RENDERER_VULKAN
+    indirectQueue->ReleaseAll();
+#endif
+}
+
+ae3d::Scene::GameObjectHandle ae3d::Scene::Add( GameObject* gameObject )
+{
+    GameObjectHandle handle;
+
+    if (gameObject == nullptr)
+    {
+        return handle;
+    }
+
+    const auto existing = gameObjectToSlotIndex.find( gameObject );
+
+    if (existing != std::end( gameObjectToSlotIndex ))
+    {
+        handle.index = existing->second;
+        handle.generation = gameObjectSlots[ existing->second ].generation;
+        return handle;
+    }
+
+    if (firstFreeSlot == InvalidSlot)
+    {
+        handle.index = static_cast< unsigned >( gameObjectSlots.size() );
+        gameObjectSlots.push_back( GameObjectSlot() );
+    }
+    else
+    {
+        handle.index = firstFreeSlot;
+        firstFreeSlot = gameObjectSlots[ firstFreeSlot ].denseIndex;
+    }
+
+    GameObjectSlot& slot = gameObjectSlots[ handle.index ];
+    slot.denseIndex = static_cast< unsigned >( gameObjects.size() );
+    slot.isFree = false;
+    handle.generation = slot.generation;
+
+    gameObjects.push_back( gameObject );
+    gameObjectSlotIndices.push_back( handle.index );
+    gameObjectToSlotIndex[ gameObject ] = handle.index;
+
+    return handle;
 }
 
 void ae3d::Scene::Remove( GameObject* gameObject )
 {
-    for (std::size_t i = 0; i < gameObjects.size(); ++i)
+    const auto existing = gameObjectToSlotIndex.find( gameObject );
+
+    if (existing != std::end( gameObjectToSlotIndex ))
+    {
+        GameObjectHandle handle;
+        handle.index = existing->second;
+        handle.generation = gameObjectSlots[ existing->second ].generation;
+        Remove( handle );
+    }
+}
+
+void ae3d::Scene::Remove( GameObjectHandle handle )
+{
+    if (Get( handle ) == nullptr)
+    {
+        return;
+    }
+
+    GameObjectSlot& slot = gameObjectSlots[ handle.index ];
+
+    gameObjectToSlotIndex.erase( gameObjects[ slot.denseIndex ] );
+    gameObjects[ slot.denseIndex ] = nullptr;
+    ++removedGameObjectCount;
+
+    if (slot.meshRendererProxy != AABBTree::NullNode)
+    {
+        meshRendererTree->DestroyProxy( slot.meshRendererProxy );
+        slot.meshRendererProxy = AABBTree::NullNode;
+    }
+
+    ++slot.generation;
+
+    // Skips 0 on wrap-around so that default-constructed handles stay invalid.
+    if (slot.generation == 0)
+    {
+        slot.generation = 1;
+    }
+
+    slot.isFree = true;
+    slot.denseIndex = firstFreeSlot;
+    firstFreeSlot = handle.index;
+
+    // Keeps holes from piling up when game objects are added and removed without rendering.
+    if (removedGameObjectCount > gameObjects.size() / 2)
+    {
+        CompactGameObjects();
+    }
+}
+
+ae3d::GameObject* ae3d::Scene::Get( GameObjectHandle handle ) const
+{
+    if (handle.index >= gameObjectSlots.size() || gameObjectSlots[ handle.index ].isFree || gameObjectSlots[ handle.index ].generation != handle.generation)
+    {
+        return nullptr;
+    }
+
+    return gameObjects[ gameObjectSlots[ handle.index ].denseIndex ];
+}
+
+void ae3d::Scene::CompactGameObjects()
+{
+    if (removedGameObjectCount == 0)
     {
-        if (gameObject == gameObjects[ i ])
+        return;
+    }
+
+    unsigned liveCount = 0;
+
+    for (unsigned denseIndex = 0; denseIndex < static_cast< unsigned >( gameObjects.size() ); ++denseIndex)
+    {
+        if (gameObjects[ denseIndex ] == nullptr)
         {
-            gameObjects.erase( std::begin( gameObjects ) + i );
-            return;
+            continue;
         }
+
+        gameObjects[ liveCount ] = gameObjects[ denseIndex ];
+        gameObjectSlotIndices[ liveCount ] = gameObjectSlotIndices[ denseIndex ];
+        gameObjectSlots[ gameObjectSlotIndices[ liveCount ] ].denseIndex = liveCount;
+        ++liveCount;
     }
+
+    gameObjects.resize( liveCount );
+    gameObjectSlotIndices.resize( liveCount );
+    removedGameObjectCount = 0;
 }
 
-void ae3d::Scene::RenderDepthAndNormalsForAllCameras( std::vector< GameObject* >& cameras )
+void ae3d::Scene::BuildStaticBatches( float cellSize )
 {
-    Statistics::BeginDepthNormalsProfiling();
+    System::Assert( cellSize > 0, "static batch cell size must be positive" );
 
-    for (auto camera : cameras)
+    CompactGameObjects();
+    ReleaseStaticBatches();
+    TransformComponent::UpdateLocalMatrices();
+
+    // Submeshes with the same state and cell go into the same batches.
+    struct StaticSubMesh
     {
-        CameraComponent* cameraComponent = camera->GetComponent< CameraComponent >();
+        MeshRendererComponent* meshRenderer;
+        const Matrix44* localToWorld;
+        Material* material;
+        unsigned subMeshIndex;
+        unsigned layer;
+        int cell[ 3 ];
+        bool castsShadow;
+        bool isOccluder;
+    };
 
-        if (cameraComponent->GetDepthNormalsTexture().GetID() != 0)
+    std::vector< StaticSubMesh > subMeshes;
+
+    for (GameObject* gameObject : gameObjects)
+    {
+        MeshRendererComponent* meshRenderer = gameObject->GetComponent< MeshRendererComponent >();
+
+        if (meshRenderer == nullptr)
+        {
+            continue;
+        }
+
+        meshRenderer->isStaticBatched = false;
+        Mesh* mesh = meshRenderer->GetMesh();
+
+        if (!meshRenderer->IsStatic() || !meshRenderer->IsEnabled() || !gameObject->IsEnabled() || mesh == nullptr || mesh->GetSubMeshCount() == 0)
+        {
+            continue;
+        }
+
+        // Mesh renderers are batched whole, so a submesh that can't be batched keeps the others individual.
+        bool canBatch = !meshRenderer->isWireframe;
+
+        for (unsigned subMeshIndex = 0; subMeshIndex < mesh->GetSubMeshCount(); ++subMeshIndex)
+        {
+            canBatch = canBatch && mesh->CanBatchSubMesh( subMeshIndex ) && meshRenderer->GetMaterial( subMeshIndex ) != nullptr;
+        }
+
+        if (!canBatch)
+        {
+            continue;
+        }
+
+        auto transform = gameObject->GetComponent< TransformComponent >();
+        const Matrix44& localToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
+
+        for (unsigned subMeshIndex = 0; subMeshIndex < mesh->GetSubMeshCount(); ++subMeshIndex)
+        {
+            Vec3 worldCenter, worldExtent;
+            MathUtil::TransformAABB( mesh->GetSubMeshAABBMin( subMeshIndex ), mesh->GetSubMeshAABBMax( subMeshIndex ), localToWorld, worldCenter, worldExtent );
+
+            StaticSubMesh subMesh;
+            subMesh.meshRenderer = meshRenderer;
+            subMesh.localToWorld = &localToWorld;
+            subMesh.material = meshRenderer->GetMaterial( subMeshIndex );
+            subMesh.subMeshIndex = subMeshIndex;
+            subMesh.layer = gameObject->GetLayer();
+            subMesh.cell[ 0 ] = static_cast< int >( std::floor( worldCenter.x / cellSize ) );
+            subMesh.cell[ 1 ] = static_cast< int >( std::floor( worldCenter.y / cellSize ) );
+            subMesh.cell[ 2 ] = static_cast< int >( std::floor( worldCenter.z / cellSize ) );
+            subMesh.castsShadow = meshRenderer->CastsShadow();
+            subMesh.isOccluder = meshRenderer->IsOccluder();
+            subMeshes.push_back( subMesh );
+        }
+
+        meshRenderer->isStaticBatched = true;
+    }
+
+    auto isSameBatch = []( const StaticSubMesh& a, const StaticSubMesh& b )
+    {
+        return a.material == b.material && a.layer == b.layer && a.castsShadow == b.castsShadow && a.isOccluder == b.isOccluder &&
+               a.cell[ 0 ] == b.cell[ 0 ] && a.cell[ 1 ] == b.cell[ 1 ] && a.cell[ 2 ] == b.cell[ 2 ];
+    };
+
+    // Stable, so batch contents follow the scene's game object order.
+    std::stable_sort( std::begin( subMeshes ), std::end( subMeshes ), []( const StaticSubMesh& a, const StaticSubMesh& b )
+    {
+        return std::tie( a.material, a.layer, a.castsShadow, a.isOccluder, a.cell[ 0 ], a.cell[ 1 ], a.cell[ 2 ] ) <
+               std::tie( b.material, b.layer, b.castsShadow, b.isOccluder, b.cell[ 0 ], b.cell[ 1 ], b.cell[ 2 ] );
+    } );
+
+    for (std::size_t i = 0; i < subMeshes.size(); ++i)
+    {
+        const StaticSubMesh& subMesh = subMeshes[ i ];
+        const Mesh& mesh = *subMesh.meshRenderer->GetMesh();
+
+        // Batches that would run out of 16-bit indices continue in a new batch.
+        if (i == 0 || !isSameBatch( subMeshes[ i - 1 ], subMesh ) ||
+            !staticBatches.back()->mesh.AppendTransformedSubMesh( mesh, subMesh.subMeshIndex, *subMesh.localToWorld ))
+        {
+            staticBatches.emplace_back( new StaticBatch() );
+            StaticBatch& batch = *staticBatches.back();
+            batch.layer = subMesh.layer;
+            batch.mesh.AppendTransformedSubMesh( mesh, subMesh.subMeshIndex, *subMesh.localToWorld );
+
+            batch.meshRenderer = MeshRendererComponent::New();
+            MeshRendererComponent* batchRenderer = MeshRendererComponent::Get( batch.meshRenderer );
+            batchRenderer->SetMesh( &batch.mesh );
+            batchRenderer->SetMaterial( subMesh.material, 0 );
+            batchRenderer->SetCastShadow( subMesh.castsShadow );
+            batchRenderer->SetOccluder( subMesh.isOccluder );
+        }
+    }
+
+    for (auto& batch : staticBatches)
+    {
+        batch->mesh.GenerateAppended( "static batch" );
+    }
+}
+
+void ae3d::Scene::PrecompilePSOs()
+{
+#if RENDERER_VULKAN
+    CompactGameObjects();
+
+    // Targets of passes that draw with the materials' shaders. Null is the back buffer.
+    std::vector< RenderTexture* > materialTargets;
+    // Targets of passes that draw with depth and normals or shadow shaders. Transient depth and normals textures don't exist yet, so they're not included.
+    std::vector< RenderTexture* > depthNormalsTargets;
+    std::vector< RenderTexture* > shadowMaps;
+
+    for (GameObject* gameObject : gameObjects)
+    {
+        CameraComponent* camera = gameObject->GetComponent< CameraComponent >();
+
+        if (camera)
+        {
+            materialTargets.push_back( camera->GetTargetTexture() );
+
+            depthNormalsTargets.push_back( &camera->GetDepthNormalsTexture() );
+        }
+
+        DirectionalLightComponent* dirLight = gameObject->GetComponent< DirectionalLightComponent >();
+        SpotLightComponent* spotLight = gameObject->GetComponent< SpotLightComponent >();
+        PointLightComponent* pointLight = gameObject->GetComponent< PointLightComponent >();
+
+        if (dirLight && dirLight->CastsShadow())
+        {
+            shadowMaps.push_back( &dirLight->shadowMap );
+        }
+
+        if (spotLight && spotLight->CastsShadow())
+        {
+            shadowMaps.push_back( &spotLight->shadowMap );
+        }
+
+        if (pointLight && pointLight->CastsShadow())
+        {
+            shadowMaps.push_back( &pointLight->shadowMap );
+        }
+    }
+
+    for (std::vector< RenderTexture* >* targets : { &materialTargets, &depthNormalsTargets, &shadowMaps })
+    {
+        // Render textures that aren't created yet have no render pass.
+        targets->erase( std::remove_if( targets->begin(), targets->end(), []( RenderTexture* target ) { return target && target->GetRenderPass() == VK_NULL_HANDLE; } ),
+                        targets->end() );
+        std::sort( targets->begin(), targets->end() );
+        targets->erase( std::unique( targets->begin(), targets->end() ), targets->end() );
+    }
+
+    std::vector< GfxDevice::PSODesc > descs;
+
+    const auto addDescs = [ &descs ]( GfxDevice::PSODesc desc, const std::vector< RenderTexture* >& targets, Shader* shader )
+    {
+        if (shader == nullptr)
+        {
+            return;
+        }
+
+        desc.shader = shader;
+
+        for (RenderTexture* target : targets)
+        {
+            desc.renderTarget = target;
+            descs.push_back( desc );
+        }
+    };
+
+    for (GameObject* gameObject : gameObjects)
+    {
+        MeshRendererComponent* meshRenderer = gameObject->GetComponent< MeshRendererComponent >();
+
+        if (meshRenderer == nullptr || meshRenderer->GetMesh() == nullptr)
+        {
+            continue;
+        }
+
+        int subMeshCount = 0;
+        SubMesh* subMeshes = meshRenderer->GetMesh()->GetSubMeshes( subMeshCount );
+
+        for (int subMeshIndex = 0; subMeshIndex < subMeshCount; ++subMeshIndex)
         {
-            std::vector< unsigned > gameObjectsWithMeshRenderer;
-            gameObjectsWithMeshRenderer.reserve( gameObjects.size() );
-            int i = -1;
+            Material* material = meshRenderer->GetMaterial( subMeshIndex );
 
-            for (auto gameObject : gameObjects)
+            if (material == nullptr)
             {
-                ++i;
+                continue;
+            }
 
-                if (gameObject == nullptr || (gameObject->GetLayer() & cameraComponent->GetLayerMask()) == 0 || !gameObject->IsEnabled())
-                {
-                    continue;
-                }
+            const bool isSkinned = !subMeshes[ subMeshIndex ].joints.empty();
 
-                auto meshRenderer = gameObject->GetComponent< MeshRendererComponent >();
+            // Same state as MeshRendererComponent::DrawSubMesh.
+            GfxDevice::PSODesc desc;
+            desc.vertexFormat = subMeshes[ subMeshIndex ].vertexBuffer.GetVertexFormat();
+            desc.depthFunc = material->GetDepthFunction() == Material::DepthFunction::LessOrEqualWriteOn ? GfxDevice::DepthFunc::LessOrEqualWriteOn : GfxDevice::DepthFunc::NoneWriteOff;
+            desc.fillMode = meshRenderer->IsWireframe() ? GfxDevice::FillMode::Wireframe : GfxDevice::FillMode::Solid;
 
-                if (meshRenderer)
-                {
-                    gameObjectsWithMeshRenderer.push_back( i );
-                }
+            // Override shaders are drawn with back-face culling and without blending.
+            if (meshRenderer->CastsShadow())
+            {
+                addDescs( desc, shadowMaps, isSkinned ? &renderer.builtinShaders.momentsSkinShader : &renderer.builtinShaders.momentsShader );
+                addDescs( desc, shadowMaps, isSkinned ? nullptr : &renderer.builtinShaders.momentsInstancedShader );
             }
 
+            addDescs( desc, depthNormalsTargets, &renderer.builtinShaders.depthNormalsShader );
+            addDescs( desc, depthNormalsTargets, isSkinned ? nullptr : &renderer.builtinShaders.depthNormalsInstancedShader );
+
+            desc.cullMode = material->IsBackFaceCulled() ? GfxDevice::CullMode::Back : GfxDevice::CullMode::Off;
+            desc.blendMode = material->GetBlendingMode() == Material::BlendingMode::Alpha ? GfxDevice::BlendMode::AlphaBlend : GfxDevice::BlendMode::Off;
+
+            addDescs( desc, materialTargets, material->GetShader() );
+            addDescs( desc, materialTargets, isSkinned ? nullptr : material->GetInstancedShader() );
+            addDescs( desc, materialTargets, isSkinned ? nullptr : material->GetIndirectShader() );
+        }
+    }
+
+    GfxDevice::PrecompilePSOs( descs.data(), static_cast< unsigned >( descs.size() ) );
+#endif
+}
+
+void ae3d::Scene::ReleaseStaticBatches()
+{
+    for (auto& batch : staticBatches)
+    {
+        if (batch->proxy != AABBTree::NullNode)
+        {
+            meshRendererTree->DestroyProxy( batch->proxy );
+        }
+
+        MeshRendererComponent::Release( batch->meshRenderer );
+    }
+
+    staticBatches.clear();
+}
+
+void ae3d::Scene::AddDepthNormalsPasses( const std::vector< GameObject* >& cameras, unsigned lightTiles )
+{
+    for (auto camera : cameras)
+    {
+        CameraComponent* cameraComponent = camera->GetComponent< CameraComponent >();
+        unsigned depthNormals = 0;
+
+        if (cameraComponent->GetDepthNormalsTexture().GetID() != 0)
+        {
+            // Materials can sample it, also after the frame.
+            depthNormals = renderGraph->ImportTexture( &cameraComponent->GetDepthNormalsTexture(), true );
+        }
+        else if (cameraComponent->transientDepthNormalsWidth > 0 && cameraComponent->transientDepthNormalsHeight > 0)
+        {
+            RenderGraph::TextureDesc desc;
+            desc.width = cameraComponent->transientDepthNormalsWidth;
+            desc.height = cameraComponent->transientDepthNormalsHeight;
+            desc.dataType = RenderTexture::DataType::Float;
+            depthNormals = renderGraph->CreateTexture( desc );
+        }
+        else
+        {
+            continue;
+        }
+
+        const unsigned depthNormalsPass = renderGraph->AddPass( "Depth and normals", RenderGraph::Queue::Graphics, [this, camera, cameraComponent, depthNormals]( RenderGraph& graph )
+        {
+            Statistics::SetCurrentPass( Statistics::Pass::DepthNormals );
+            Statistics::BeginDepthNormalsProfiling();
+
+            std::vector< unsigned > meshRenderers;
+            GetMeshRenderersInLayers( cameraComponent->GetLayerMask(), meshRenderers );
+
             Frustum frustum;
 
             if (cameraComponent->GetProjectionType() == CameraComponent::ProjectionType::Perspective)
@@ -240,27 +799,31 @@ void ae3d::Scene::RenderDepthAndNormalsForAllCameras( std::vector< GameObject* >
             }
 
             auto cameraTransform = camera->GetComponent< TransformComponent >();
-            // TODO: world position
-            Vec3 position = cameraTransform ? cameraTransform->GetLocalPosition() : Vec3( 0, 0, 0 );
+            const Vec3 position = cameraTransform ? cameraTransform->GetWorldPosition() : Vec3( 0, 0, 0 );
             const Matrix44& view = cameraComponent->GetView();
             const Vec3 viewDir = Vec3( view.m[ 2 ], view.m[ 6 ], view.m[ 10 ] ).Normalized();
             frustum.Update( position, viewDir );
 
-            RenderDepthAndNormals( cameraComponent, view, gameObjectsWithMeshRenderer, 0, frustum );
+            RenderDepthAndNormals( cameraComponent, graph.GetTexture( depthNormals ), view, meshRenderers, 0, frustum );
+            Statistics::EndDepthNormalsProfiling();
+        } );
+        renderGraph->Write( depthNormalsPass, depthNormals, true );
 
+        const unsigned lightCullingPass = renderGraph->AddPass( "Light culling", RenderGraph::Queue::Compute, [this, cameraComponent, depthNormals]( RenderGraph& graph )
+        {
             int goWithPointLightIndex = 0;
             int goWithSpotLightIndex = 0;
             
-            for (auto gameObject : gameObjects)
+            for (const auto& light : frameLights)
             {
-                if (gameObject == nullptr || (gameObject->GetLayer() & cameraComponent->GetLayerMask()) == 0 || !gameObject->IsEnabled())
+                if ((light.layer & cameraComponent->GetLayerMask()) == 0)
                 {
                     continue;
                 }
 
-                auto transform = gameObject->GetComponent< TransformComponent >();
-                auto pointLight = gameObject->GetComponent< PointLightComponent >();
-                auto spotLight = gameObject->GetComponent< SpotLightComponent >();
+                auto transform = light.transform;
+                auto pointLight = light.pointLight;
+                auto spotLight = light.spotLight;
 
                 if (transform && pointLight)
                 {
@@ -280,12 +843,12 @@ void ae3d::Scene::RenderDepthAndNormalsForAllCameras( std::vector< GameObject* >
             GfxDeviceGlobal::lightTiler.UpdateLightBuffers();
             Statistics::BeginLightCullerProfiling();
             GfxDeviceGlobal::lightTiler.CullLights( renderer.builtinShaders.lightCullShader, cameraComponent->GetProjection(),
-                                                    view, cameraComponent->GetDepthNormalsTexture() );
+                                                    cameraComponent->GetView(), *graph.GetTexture( depthNormals ) );
             Statistics::EndLightCullerProfiling();
-        }
+        } );
+        renderGraph->Read( lightCullingPass, depthNormals );
+        renderGraph->Write( lightCullingPass, lightTiles, true );
     }
-
-    Statistics::EndDepthNormalsProfiling();
 }
 
 const float scale = 2000;
@@ -315,31 +878,71 @@ void ae3d::Scene::SetAmbient( const Vec3& color )
     ambientColor = color;
 }
 
-void ae3d::Scene::RenderRTCameras( std::vector< GameObject* >& rtCameras )
+void ae3d::Scene::AddRTCameraPasses( const std::vector< GameObject* >& rtCameras, const std::vector< unsigned >& shadowMaps, unsigned lightTiles,
+                                     std::vector< unsigned >& outTargets )
 {
     for (auto rtCamera : rtCameras)
     {
-        auto transform = rtCamera->GetComponent< TransformComponent >();
-
-        if (transform && !rtCamera->GetComponent< CameraComponent >()->GetTargetTexture()->IsCube())
+        if (!rtCamera->GetComponent< TransformComponent >())
         {
-            RenderWithCamera( rtCamera, 0, "2D RT" );
+            continue;
         }
-        else if (transform && rtCamera->GetComponent< CameraComponent >()->GetTargetTexture()->IsCube())
+
+        CameraComponent* cameraComponent = rtCamera->GetComponent< CameraComponent >();
+        const unsigned target = renderGraph->ImportTexture( cameraComponent->GetTargetTexture(), true );
+        const unsigned pass = renderGraph->AddPass( "RT camera", RenderGraph::Queue::Graphics, [this, rtCamera]( RenderGraph& )
         {
-            const Vec3 cameraPos = transform->GetLocalPosition();
+            Statistics::SetCurrentPass( Statistics::Pass::RenderTexture );
+            auto transform = rtCamera->GetComponent< TransformComponent >();
 
-            for (int cubeMapFace = 0; cubeMapFace < 6; ++cubeMapFace)
+            if (!rtCamera->GetComponent< CameraComponent >()->GetTargetTexture()->IsCube())
             {
-                transform->LookAt( cameraPos, cameraPos + directions[ cubeMapFace ], ups[ cubeMapFace ] );
-                RenderWithCamera( rtCamera, cubeMapFace, "Cube Map RT" );
+                RenderWithCamera( rtCamera, 0, nullptr, "2D RT" );
             }
-        }
+            else
+            {
+                const Vec3 cameraPos = transform->GetWorldPosition();
+
+                // Faces' rotations are passed to RenderWithCamera, because the transform's world rotation isn't updated until the next hierarchy update.
+                for (int cubeMapFace = 0; cubeMapFace < 6; ++cubeMapFace)
+                {
+                    Matrix44 lookAt;
+                    lookAt.MakeLookAt( cameraPos, cameraPos + directions[ cubeMapFace ], ups[ cubeMapFace ] );
+                    Quaternion faceRotation;
+                    faceRotation.FromMatrix( lookAt );
+                    RenderWithCamera( rtCamera, cubeMapFace, &faceRotation, "Cube Map RT" );
+                }
+            }
+        } );
+
+        // Each face of a cube map is cleared, so clearing discards all of it.
+        renderGraph->Write( pass, target, cameraComponent->GetClearFlag() == CameraComponent::ClearFlag::DepthAndColor );
+        ReadCameraPassInputs( pass, shadowMaps, lightTiles, outTargets );
+        outTargets.push_back( target );
+    }
+}
+
+void ae3d::Scene::ReadCameraPassInputs( unsigned pass, const std::vector< unsigned >& shadowMaps, unsigned lightTiles, const std::vector< unsigned >& cameraTargets )
+{
+    // Materials can sample any render texture, so camera passes read all shadow maps and earlier cameras' targets.
+    for (unsigned shadowMap : shadowMaps)
+    {
+        renderGraph->Read( pass, shadowMap );
+    }
+
+    for (unsigned cameraTarget : cameraTargets)
+    {
+        renderGraph->Read( pass, cameraTarget );
     }
+
+    renderGraph->Read( pass, lightTiles );
 }
 
-void ae3d::Scene::RenderShadowMaps( std::vector< GameObject* >& cameras )
+void ae3d::Scene::AddShadowMapPasses( const std::vector< GameObject* >& cameras, std::vector< unsigned >& outShadowMaps )
 {
+    // Shadow maps of frameLights, imported on first use. ~0u if not imported.
+    std::vector< unsigned > lightShadowMaps( frameLights.size(), ~0u );
+
     for (auto camera : cameras)
     {
         if (camera == nullptr || !camera->GetComponent<TransformComponent>())
@@ -347,8 +950,6 @@ void ae3d::Scene::RenderShadowMaps( std::vector< GameObject* >& cameras )
             continue;
         }
         
-        TransformComponent* cameraTransform = camera->GetComponent<TransformComponent>();
-
         // Shadow pass
 
         if (camera->GetComponent<CameraComponent>()->GetProjectionType() != ae3d::CameraComponent::ProjectionType::Perspective)
@@ -356,33 +957,45 @@ void ae3d::Scene::RenderShadowMaps( std::vector< GameObject* >& cameras )
             continue;
         }
 
-        for (auto go : gameObjects)
+        for (std::size_t lightIndex = 0; lightIndex < frameLights.size(); ++lightIndex)
         {
-            if (!go || !go->IsEnabled())
+            const FrameLight& light = frameLights[ lightIndex ];
+
+            if (!light.transform)
             {
                 continue;
             }
             
-            auto lightTransform = go->GetComponent<TransformComponent>();
-            
-            if (!lightTransform)
+            if (!((light.dirLight && light.dirLight->CastsShadow()) || (light.spotLight && light.spotLight->CastsShadow()) ||
+                  (light.pointLight && light.pointLight->CastsShadow())))
             {
                 continue;
             }
-            
-            auto dirLight = go->GetComponent<DirectionalLightComponent>();
-            auto spotLight = go->GetComponent<SpotLightComponent>();
-            auto pointLight = go->GetComponent<PointLightComponent>();
 
-            if (((dirLight && dirLight->CastsShadow()) || (spotLight && spotLight->CastsShadow()) ||
-                                   (pointLight && pointLight->CastsShadow())))
+            if (lightShadowMaps[ lightIndex ] == ~0u)
             {
+                RenderTexture* shadowMap = light.dirLight ? &light.dirLight->shadowMap : (light.spotLight ? &light.spotLight->shadowMap : &light.pointLight->shadowMap);
+                // Shadow maps are rendered again in the next frame.
+                lightShadowMaps[ lightIndex ] = renderGraph->ImportTexture( shadowMap, false );
+                outShadowMaps.push_back( lightShadowMaps[ lightIndex ] );
+            }
+
+            const unsigned pass = renderGraph->AddPass( "Shadow map", RenderGraph::Queue::Graphics, [this, camera, lightIndex]( RenderGraph& )
+            {
+                Statistics::SetCurrentPass( Statistics::Pass::ShadowMap );
                 Statistics::BeginShadowMapProfiling();
+
+                const FrameLight& frameLight = frameLights[ lightIndex ];
+                auto lightTransform = frameLight.transform;
+                auto dirLight = frameLight.dirLight;
+                auto spotLight = frameLight.spotLight;
+                auto pointLight = frameLight.pointLight;
+                TransformComponent* cameraTransform = camera->GetComponent<TransformComponent>();
                 
                 Frustum eyeFrustum;
                 
                 auto cameraComponent = camera->GetComponent< CameraComponent >();
-                
+
                 if (cameraComponent->GetProjectionType() == CameraComponent::ProjectionType::Perspective)
                 {
                     eyeFrustum.SetProjection( cameraComponent->GetFovDegrees(), cameraComponent->GetAspect(), cameraComponent->GetNear(), cameraComponent->GetFar() );
@@ -391,59 +1004,57 @@ void ae3d::Scene::RenderShadowMaps( std::vector< GameObject* >& cameras )
                 {
                     eyeFrustum.SetProjection( cameraComponent->GetLeft(), cameraComponent->GetRight(), cameraComponent->GetBottom(), cameraComponent->GetTop(), cameraComponent->GetNear(), cameraComponent->GetFar() );
                 }
-                
+            
                 Matrix44 eyeView;
                 cameraTransform->GetWorldRotation().GetMatrix( eyeView );
                 Matrix44 translation;
                 translation.SetTranslation( -cameraTransform->GetWorldPosition() );
                 Matrix44::Multiply( translation, eyeView, eyeView );
-                
+            
                 const Vec3 eyeViewDir = Vec3( eyeView.m[2], eyeView.m[6], eyeView.m[10] ).Normalized();
                 eyeFrustum.Update( cameraTransform->GetWorldPosition(), eyeViewDir );
-                
+            
                 if (!SceneGlobal::isShadowCameraCreated)
                 {
                     SceneGlobal::shadowCamera.AddComponent< CameraComponent >();
                     SceneGlobal::shadowCamera.GetComponent< CameraComponent >()->SetClearFlag( ae3d::CameraComponent::ClearFlag::DepthAndColor );
                     SceneGlobal::shadowCamera.AddComponent< TransformComponent >();
                     SceneGlobal::isShadowCameraCreated = true;
-                    // Component adding can invalidate lightTransform pointer.
-                    lightTransform = go->GetComponent<TransformComponent>();
                 }
-                
+            
                 if (dirLight)
                 {
-                    SceneGlobal::shadowCamera.GetComponent< CameraComponent >()->SetTargetTexture( &go->GetComponent<DirectionalLightComponent>()->shadowMap );
+                    SceneGlobal::shadowCamera.GetComponent< CameraComponent >()->SetTargetTexture( &dirLight->shadowMap );
                     SetupCameraForDirectionalShadowCasting( lightTransform->GetViewDirection(), eyeFrustum, aabbMin, aabbMax, *SceneGlobal::shadowCamera.GetComponent< CameraComponent >(), *SceneGlobal::shadowCamera.GetComponent< TransformComponent >() );
-                    GfxDeviceGlobal::perObjectUboStruct.lightType = PerObjectUboStruct::LightType::Dir;
                     RenderShadowsWithCamera( &SceneGlobal::shadowCamera, 0 );
-                    Material::SetGlobalRenderTexture( &go->GetComponent<DirectionalLightComponent>()->shadowMap );
+                    Material::SetGlobalRenderTexture( &dirLight->shadowMap );
                 }
                 else if (spotLight)
                 {
-                    SceneGlobal::shadowCamera.GetComponent< CameraComponent >()->SetTargetTexture( &go->GetComponent<SpotLightComponent>()->shadowMap );
-                    SetupCameraForSpotShadowCasting( lightTransform->GetWorldPosition(), lightTransform->GetViewDirection(), *SceneGlobal::shadowCamera.GetComponent< CameraComponent >(), *SceneGlobal::shadowCamera.GetComponent< TransformComponent >() );
-                    GfxDeviceGlobal::perObjectUboStruct.lightType = PerObjectUboStruct::LightType::Spot;
+                    SceneGlobal::shadowCamera.GetComponent< CameraComponent >()->SetTargetTexture( &spotLight->shadowMap );
+                    SetupCameraForSpotShadowCasting( lightTransform->GetWorldPosition(), lightTransform->GetViewDirection(), Vec3( 0, 1, 0 ), *SceneGlobal::shadowCamera.GetComponent< CameraComponent >(), *SceneGlobal::shadowCamera.GetComponent< TransformComponent >() );
                     RenderShadowsWithCamera( &SceneGlobal::shadowCamera, 0 );
-                    Material::SetGlobalRenderTexture( &go->GetComponent<SpotLightComponent>()->shadowMap );
+                    Material::SetGlobalRenderTexture( &spotLight->shadowMap );
                 }
                 else if (pointLight)
                 {
-                    SceneGlobal::shadowCamera.GetComponent< CameraComponent >()->SetTargetTexture( &go->GetComponent<PointLightComponent>()->shadowMap );
-                    GfxDeviceGlobal::perObjectUboStruct.lightType = PerObjectUboStruct::LightType::Point;
-                    
+                    SceneGlobal::shadowCamera.GetComponent< CameraComponent >()->SetTargetTexture( &pointLight->shadowMap );
+                
+                    // Faces are set up on the shadow camera, so the light's transform isn't dirtied every frame.
                     for (int cubeMapFace = 0; cubeMapFace < 6; ++cubeMapFace)
                     {
-                        lightTransform->LookAt( lightTransform->GetLocalPosition(), lightTransform->GetLocalPosition() + directions[ cubeMapFace ], ups[ cubeMapFace ] );
-                        SetupCameraForSpotShadowCasting( lightTransform->GetWorldPosition(), lightTransform->GetViewDirection(), *SceneGlobal::shadowCamera.GetComponent< CameraComponent >(), *SceneGlobal::shadowCamera.GetComponent< TransformComponent >() );
+                        SetupCameraForSpotShadowCasting( lightTransform->GetWorldPosition(), directions[ cubeMapFace ].Normalized(), ups[ cubeMapFace ], *SceneGlobal::shadowCamera.GetComponent< CameraComponent >(), *SceneGlobal::shadowCamera.GetComponent< TransformComponent >() );
                         RenderShadowsWithCamera( &SceneGlobal::shadowCamera, cubeMapFace );
                     }
-                    
-                    Material::SetGlobalRenderTexture( &go->GetComponent<PointLightComponent>()->shadowMap );
-                }
                 
+                    Material::SetGlobalRenderTexture( &pointLight->shadowMap );
+                }
+            
                 Statistics::EndShadowMapProfiling();
-            }
+            } );
+
+            // The shadow camera clears each face of a cube map.
+            renderGraph->Write( pass, lightShadowMaps[ lightIndex ], true );
         }
     }
 }
@@ -470,79 +1081,102 @@ void ae3d::Scene::Render()
 #if RENDERER_VULKAN && !AE3D_OPENVR
     GfxDevice::BeginFrame();
 #endif
-    GenerateAABB();
 #if RENDERER_D3D12
     GfxDevice::ResetCommandList();
 #endif
     Statistics::ResetFrameStatistics();
+    CompactGameObjects();
     TransformComponent::UpdateLocalMatrices();
-    
-    std::vector< GameObject* > rtCameras;
-    rtCameras.reserve( gameObjects.size() / 4 );
-    std::vector< GameObject* > cameras;
-    cameras.reserve( gameObjects.size() / 4 );
-    
-    for (auto gameObject : gameObjects)
+    ExtractRenderLists();
+#if RENDERER_VULKAN
+    std::vector< const CameraComponent* > renderedCameras;
+
+    for (auto camera : frameCameras)
     {
-        if (gameObject == nullptr || !gameObject->IsEnabled())
-        {
-            continue;
-        }
+        renderedCameras.push_back( camera->GetComponent< CameraComponent >() );
+    }
 
-        auto cameraComponent = gameObject->GetComponent<CameraComponent>();
-        
-        if (cameraComponent && cameraComponent->GetTargetTexture() != nullptr && gameObject->GetComponent<TransformComponent>())
-        {
-            rtCameras.push_back( gameObject );
-        }
-        if (cameraComponent && cameraComponent->GetTargetTexture() == nullptr && gameObject->GetComponent<TransformComponent>())
-        {
-            cameras.push_back( gameObject );
-        }
+    for (auto rtCamera : frameRTCameras)
+    {
+        renderedCameras.push_back( rtCamera->GetComponent< CameraComponent >() );
     }
+
+    indirectQueue->BeginFrame( renderedCameras );
+#endif
+    GenerateAABB();
+    // The previous frame's commands are kept until now for GetRenderCommandsDump.
+    commandStream->Clear();
+    executedCommandCount = 0;
+
 #if RENDERER_VULKAN
-    if (cameras.empty())
+    if (frameCameras.empty())
     {
         GfxDevice::BeginRenderPassAndCommandBuffer();
         GfxDevice::EndRenderPassAndCommandBuffer();
     }
 #endif
 
-    BubbleSort( cameras.data(), (int)cameras.size() );
-    BubbleSort( rtCameras.data(), (int)rtCameras.size() );
-    
+    renderGraph->Reset();
+    // Light culling's tiles. Each camera's light culling overwrites them for the camera passes that follow it.
+    const unsigned lightTiles = renderGraph->ImportBuffer( false );
+    std::vector< unsigned > shadowMaps;
+    std::vector< unsigned > cameraTargets;
+
     if (someLightCastsShadow)
     {
-        RenderShadowMaps( rtCameras );
+        AddShadowMapPasses( frameRTCameras, shadowMaps );
     }
 
-    RenderDepthAndNormalsForAllCameras( rtCameras );
-    RenderRTCameras( rtCameras );
-    RenderDepthAndNormalsForAllCameras( cameras );
+    AddDepthNormalsPasses( frameRTCameras, lightTiles );
+    AddRTCameraPasses( frameRTCameras, shadowMaps, lightTiles, cameraTargets );
+    AddDepthNormalsPasses( frameCameras, lightTiles );
+
+    const unsigned backBuffer = renderGraph->ImportTexture( nullptr, true );
+    const unsigned primaryPass = renderGraph->AddPass( "Primary", RenderGraph::Queue::Graphics, [this]( RenderGraph& )
+    {
+        Statistics::SetCurrentPass( Statistics::Pass::Primary );
 
 #if RENDERER_VULKAN && !AE3D_OPENVR
-    GfxDevice::BeginRenderPassAndCommandBuffer();
+        GfxDevice::BeginRenderPassAndCommandBuffer();
 #endif
 
 #if RENDERER_METAL
-    GfxDevice::BeginBackBufferEncoding();
+        GfxDevice::BeginBackBufferEncoding();
 #endif    
-    for (auto camera : cameras)
-    {
-        auto cameraTransform = camera->GetComponent< TransformComponent >();
-        auto cameraPos = cameraTransform->GetWorldPosition();
-        auto cameraDir = cameraTransform->GetViewDirection();
+        for (auto camera : frameCameras)
+        {
+            auto cameraTransform = camera->GetComponent< TransformComponent >();
+            auto cameraPos = cameraTransform->GetWorldPosition();
+            auto cameraDir = cameraTransform->GetViewDirection();
         
-        AudioSystem::SetListenerPosition( cameraPos.x, cameraPos.y, cameraPos.z );
-        AudioSystem::SetListenerOrientation( cameraDir.x, cameraDir.y, cameraDir.z );
+            AudioSystem::SetListenerPosition( cameraPos.x, cameraPos.y, cameraPos.z );
+            AudioSystem::SetListenerOrientation( cameraDir.x, cameraDir.y, cameraDir.z );
 
-        RenderWithCamera( camera, 0, "Primary Pass" );
-    }
+            RenderWithCamera( camera, 0, nullptr, "Primary Pass" );
+        }
     
-    GfxDevice::SetRenderTarget( nullptr, 0 );
+        GfxDevice::SetRenderTarget( nullptr, 0 );
 #if RENDERER_D3D12
-    GfxDevice::ClearScreen( GfxDevice::ClearFlags::Depth );
+        GfxDevice::ClearScreen( GfxDevice::ClearFlags::Depth );
 #endif
+    } );
+    renderGraph->Write( primaryPass, backBuffer, false );
+    ReadCameraPassInputs( primaryPass, shadowMaps, lightTiles, cameraTargets );
+
+    renderGraph->Compile();
+    renderGraph->Execute();
+    Statistics::SetCurrentPass( Statistics::Pass::Other );
+}
+
+std::string ae3d::Scene::GetRenderCommandsDump() const
+{
+    return commandStream->GetDump();
+}
+
+void ae3d::Scene::ExecuteRecordedCommands()
+{
+    GfxDevice::ExecuteCommands( *commandStream, executedCommandCount );
+    executedCommandCount = commandStream->GetCommandCount();
 }
 
 void ae3d::Scene::EndFrame()
@@ -556,58 +1190,39 @@ void ae3d::Scene::EndFrame()
 #endif
 }
 
-void ae3d::Scene::RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const char* debugGroupName )
+void ae3d::Scene::RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const Quaternion* faceRotation, const char* debugGroupName )
 {
     ae3d::System::Assert( 0 <= cubeMapFace && cubeMapFace < 6, "invalid cube map face" );
 
     CameraComponent* camera = cameraGo->GetComponent< CameraComponent >();
-    const Vec3 color = camera->GetClearColor();
-    GfxDevice::SetClearColor( color.x, color.y, color.z );
-#ifndef RENDERER_VULKAN
-    GfxDevice::SetViewport( camera->GetViewport() );
-#endif
-#ifndef RENDERER_METAL
-    GfxDevice::SetRenderTarget( camera->GetTargetTexture(), cubeMapFace );
-#endif
-#ifdef RENDERER_VULKAN
-    if (camera->GetTargetTexture())
-    {
-        BeginOffscreen();
-    }
+    unsigned clearFlags = 0;
 
-    GfxDevice::SetViewport( camera->GetViewport() );
-    GfxDevice::SetScissor( camera->GetViewport() );
-#endif
-#ifndef RENDERER_METAL
-    GfxDevice::PushGroupMarker( debugGroupName );
-#endif
     if (camera->GetClearFlag() == CameraComponent::ClearFlag::DepthAndColor)
     {
-        GfxDevice::ClearScreen( GfxDevice::ClearFlags::Color | GfxDevice::ClearFlags::Depth );
+        clearFlags = GfxDevice::ClearFlags::Color | GfxDevice::ClearFlags::Depth;
     }
     else if (camera->GetClearFlag() == CameraComponent::ClearFlag::Depth)
     {
-        GfxDevice::ClearScreen( GfxDevice::ClearFlags::Depth );
+        clearFlags = GfxDevice::ClearFlags::Depth;
     }
     else if (camera->GetClearFlag() == CameraComponent::ClearFlag::DontClear)
     {
-        GfxDevice::ClearScreen( GfxDevice::ClearFlags::DontClear );
+        clearFlags = GfxDevice::ClearFlags::DontClear;
     }
     else
     {
         System::Assert( false, "Unhandled clear flag." );
     }
-#if RENDERER_METAL
-    GfxDevice::SetRenderTarget( camera->GetTargetTexture(), cubeMapFace );
-    GfxDevice::PushGroupMarker( debugGroupName );
-#endif
+
+    RecordBeginPass( *commandStream, camera->GetTargetTexture(), static_cast< unsigned >( cubeMapFace ), camera->GetViewport(), camera->GetClearColor(), clearFlags );
+    commandStream->Add( RenderCommand::Type::PushGroupMarker ).groupMarker.name = debugGroupName;
     
     Matrix44 view;
 
     if (skybox != nullptr && camera->GetProjectionType() != ae3d::CameraComponent::ProjectionType::Orthographic)
     {
         auto cameraTrans = cameraGo->GetComponent< TransformComponent >();
-        cameraTrans->GetLocalRotation().GetMatrix( view );
+        (faceRotation != nullptr ? *faceRotation : cameraTrans->GetLocalRotation()).GetMatrix( view );
 #if defined( AE3D_OPENVR )
         Matrix44 vrView = cameraTrans->GetVrView();
         // Cancels translation.
@@ -619,7 +1234,12 @@ void ae3d::Scene::RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const
 #else
         camera->SetView( view );
 #endif
-        renderer.RenderSkybox( skybox, *camera );
+        Matrix44 skyboxLocalToClip;
+        Matrix44::Multiply( camera->GetView(), camera->GetProjection(), skyboxLocalToClip );
+
+        RenderCommand::DrawSkyboxData& data = commandStream->Add( RenderCommand::Type::DrawSkybox ).drawSkybox;
+        data.skyTexture = skybox;
+        data.localToClip = commandStream->AddMatrix( skyboxLocalToClip );
     }
     
     float fovDegrees;
@@ -634,7 +1254,7 @@ void ae3d::Scene::RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const
     auto cameraTransform = cameraGo->GetComponent< TransformComponent >();
     position = cameraTransform->GetWorldPosition();
     fovDegrees = camera->GetFovDegrees();
-    cameraTransform->GetWorldRotation().GetMatrix( view );
+    (faceRotation != nullptr ? *faceRotation : cameraTransform->GetWorldRotation()).GetMatrix( view );
     Matrix44 translation;
     translation.SetTranslation( -cameraTransform->GetWorldPosition() );
     Matrix44::Multiply( translation, view, view );
@@ -655,165 +1275,102 @@ void ae3d::Scene::RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const
     const Vec3 viewDir = Vec3( view.m[2], view.m[6], view.m[10] ).Normalized();
     frustum.Update( position, viewDir );
 
-    std::vector< unsigned > gameObjectsWithMeshRenderer;
-    gameObjectsWithMeshRenderer.reserve( gameObjects.size() );
-    int gameObjectIndex = -1;
+    std::vector< unsigned > meshRenderers;
+    GetMeshRenderersInLayers( camera->GetLayerMask(), meshRenderers );
     
-    GfxDeviceGlobal::perObjectUboStruct.lightColor = Vec4( 0, 0, 0, 1 );
-    GfxDeviceGlobal::perObjectUboStruct.minAmbient = ambientColor.x;
-    GfxDeviceGlobal::perObjectUboStruct.lightType = PerObjectUboStruct::LightType::Empty;
+    RenderCommand::SetLightData lightData = {};
+    lightData.color[ 3 ] = 1;
+    lightData.minAmbient = ambientColor.x;
+    lightData.lightType = PerObjectUboStruct::LightType::Spot;
     
-    for (auto gameObject : gameObjects)
+    for (const auto& light : frameLights)
     {
-        ++gameObjectIndex;
-        
-        if (gameObject == nullptr || (gameObject->GetLayer() & camera->GetLayerMask()) == 0 || !gameObject->IsEnabled())
-        {
-            continue;
-        }
-        
-        auto transform = gameObject->GetComponent< TransformComponent >();
-        auto spriteRenderer = gameObject->GetComponent< SpriteRendererComponent >();
-        auto dirLight = gameObject->GetComponent< DirectionalLightComponent >();
-        
-        if (dirLight)
+        auto dirLight = light.dirLight;
+
+        if (dirLight && (light.layer & camera->GetLayerMask()) != 0)
         {
-            auto lightTransform = gameObject->GetComponent< TransformComponent >();
+            auto lightTransform = light.transform;
 
             Vec4 lightDirection = Vec4( lightTransform != nullptr ? lightTransform->GetViewDirection() : Vec3( 1, 0, 0 ), 0 );
             Vec3 lightDirectionVS;
             Matrix44::TransformDirection( Vec3( lightDirection.x, lightDirection.y, lightDirection.z ), camera->GetView(), &lightDirectionVS );
-            GfxDeviceGlobal::perObjectUboStruct.lightColor = Vec4( dirLight->GetColor() );
-            GfxDeviceGlobal::perObjectUboStruct.lightDirection = Vec4( lightDirectionVS.x, lightDirectionVS.y, lightDirectionVS.z, 0 );
+            const Vec4 lightColor = Vec4( dirLight->GetColor() );
+            lightData.color[ 0 ] = lightColor.x;
+            lightData.color[ 1 ] = lightColor.y;
+            lightData.color[ 2 ] = lightColor.z;
+            lightData.color[ 3 ] = lightColor.w;
+            lightData.direction[ 0 ] = lightDirectionVS.x;
+            lightData.direction[ 1 ] = lightDirectionVS.y;
+            lightData.direction[ 2 ] = lightDirectionVS.z;
+            lightData.direction[ 3 ] = 0;
             
             // FIXME: This is an ugly hack to get shadow shaders to work with different light types.
             if (dirLight->CastsShadow())
             {
-                GfxDeviceGlobal::perObjectUboStruct.lightType = PerObjectUboStruct::LightType::Dir;
+                lightData.lightType = PerObjectUboStruct::LightType::Dir;
             }
         }
-        else
-        {
-            GfxDeviceGlobal::perObjectUboStruct.lightType = PerObjectUboStruct::LightType::Spot;
-        }
-        
-        if (spriteRenderer)
-        {
-            Matrix44 localToClip;
-            Matrix44::Multiply( transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity, camera->GetProjection(), localToClip );
-            spriteRenderer->Render( localToClip.m );
-        }
-        
-        auto textRenderer = gameObject->GetComponent< TextRendererComponent >();
-        
-        if (textRenderer)
-        {
-            Matrix44 localToClip;
-            Matrix44::Multiply( transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity, camera->GetProjection(), localToClip );
-            textRenderer->Render( localToClip.m );
-        }
-        
-        auto meshRenderer = gameObject->GetComponent< MeshRendererComponent >();
-
-        if (meshRenderer)
-        {
-            gameObjectsWithMeshRenderer.push_back( gameObjectIndex );
-        }
     }
 
-    auto meshSorterByMesh = [&](unsigned j, unsigned k)
-    {
-        return gameObjects[ j ]->GetComponent< MeshRendererComponent >()->GetMesh() <
-               gameObjects[ k ]->GetComponent< MeshRendererComponent >()->GetMesh();
-    };
+    commandStream->Add( RenderCommand::Type::SetLight ).setLight = lightData;
 
-    std::sort( std::begin( gameObjectsWithMeshRenderer ), std::end( gameObjectsWithMeshRenderer ), meshSorterByMesh );
-    
-    for (auto j : gameObjectsWithMeshRenderer)
+    for (const auto& spriteOrText : frameSpritesAndTexts)
     {
-        auto transform = gameObjects[ j ]->GetComponent< TransformComponent >();
-        auto meshLocalToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
+        if ((spriteOrText.layer & camera->GetLayerMask()) == 0)
+        {
+            continue;
+        }
 
-        Matrix44 localToView;
         Matrix44 localToClip;
-        Matrix44::Multiply( meshLocalToWorld, view, localToView );
-        Matrix44::Multiply( localToView, camera->GetProjection(), localToClip );
+        Matrix44::Multiply( spriteOrText.localToWorld, camera->GetProjection(), localToClip );
 
-        auto* meshRenderer = gameObjects[ j ]->GetComponent< MeshRendererComponent >();
-        meshRenderer->Cull( frustum, meshLocalToWorld );
-        meshRenderer->Render( localToView, localToClip, meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, nullptr, nullptr, MeshRendererComponent::RenderType::Opaque );
-    }
-
-    for (auto j : gameObjectsWithMeshRenderer)
-    {
-        auto transform = gameObjects[ j ]->GetComponent< TransformComponent >();
-        auto meshLocalToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
-        
-        Matrix44 localToView;
-        Matrix44 localToClip;
-        Matrix44::Multiply( meshLocalToWorld, view, localToView );
-        Matrix44::Multiply( localToView, camera->GetProjection(), localToClip );
+        if (spriteOrText.spriteRenderer)
+        {
+            RenderCommand::DrawSpriteData& data = commandStream->Add( RenderCommand::Type::DrawSprite ).drawSprite;
+            data.spriteRenderer = spriteOrText.spriteRenderer;
+            data.localToClip = commandStream->AddMatrix( localToClip );
+        }
         
-        gameObjects[ j ]->GetComponent< MeshRendererComponent >()->Render( localToView, localToClip, meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, nullptr, nullptr, MeshRendererComponent::RenderType::Transparent );
+        if (spriteOrText.textRenderer)
+        {
+            RenderCommand::DrawTextData& data = commandStream->Add( RenderCommand::Type::DrawText ).drawText;
+            data.textRenderer = spriteOrText.textRenderer;
+            data.localToClip = commandStream->AddMatrix( localToClip );
+        }
     }
 
-    GfxDevice::PopGroupMarker();
+    Matrix44 worldToClip;
+    Matrix44::Multiply( view, camera->GetProjection(), worldToClip );
 
-#if RENDERER_METAL
-    GfxDevice::SetRenderTarget( nullptr, 0 );
-#endif
 #if RENDERER_VULKAN
-    GfxDevice::SetRenderTarget( nullptr, 0 );
-    
-    if (camera->GetTargetTexture())
-    {
-        EndOffscreen();
-    }
+    RenderIndirectSubMeshes( camera, cubeMapFace, meshRenderers, view, worldToClip );
 #endif
+
+    CullMeshRenderers( frustum, meshRenderers );
+    CullOccludedMeshRenderers( worldToClip, meshRenderers );
+
+    RenderSortedSubMeshes( meshRenderers, view, camera->GetProjection(), camera->GetFar(), DrawPass::Camera, nullptr, nullptr, nullptr );
+
+    commandStream->Add( RenderCommand::Type::PopGroupMarker );
+    commandStream->Add( RenderCommand::Type::EndPass ).endPass.target = camera->GetTargetTexture();
+    ExecuteRecordedCommands();
 }
 
-void ae3d::Scene::RenderDepthAndNormals( CameraComponent* camera, const Matrix44& worldToView, std::vector< unsigned > gameObjectsWithMeshRenderer,
+void ae3d::Scene::RenderDepthAndNormals( CameraComponent* camera, RenderTexture* target, const Matrix44& worldToView, std::vector< unsigned >& meshRenderers,
                                          int cubeMapFace, const Frustum& frustum )
 {
-#if RENDERER_METAL
-    GfxDevice::SetViewport( camera->GetViewport() );
-    GfxDevice::ClearScreen( GfxDevice::ClearFlags::Color | GfxDevice::ClearFlags::Depth );
-    GfxDevice::SetRenderTarget( &camera->GetDepthNormalsTexture(), cubeMapFace );
-#else
-    GfxDevice::SetRenderTarget( &camera->GetDepthNormalsTexture(), cubeMapFace );
-#if RENDERER_VULKAN
-    BeginOffscreen();
-    GfxDevice::SetScissor( camera->GetViewport() );
-#endif
-    GfxDevice::SetViewport( camera->GetViewport() );
-    GfxDevice::ClearScreen( GfxDevice::ClearFlags::Color | GfxDevice::ClearFlags::Depth );
-#endif
-    GfxDevice::PushGroupMarker( "DepthNormal" );
+    RecordBeginPass( *commandStream, target, static_cast< unsigned >( cubeMapFace ), camera->GetViewport(), camera->GetClearColor(),
+                     GfxDevice::ClearFlags::Color | GfxDevice::ClearFlags::Depth );
+    commandStream->Add( RenderCommand::Type::PushGroupMarker ).groupMarker.name = "DepthNormal";
 
-    for (auto j : gameObjectsWithMeshRenderer)
-    {
-        auto transform = gameObjects[ j ]->GetComponent< TransformComponent >();
-        auto meshLocalToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
-        
-        Matrix44 localToView;
-        Matrix44 localToClip;
-        Matrix44::Multiply( meshLocalToWorld, worldToView, localToView );
-        Matrix44::Multiply( localToView, camera->GetProjection(), localToClip );
-        
-        auto meshRenderer = gameObjects[ j ]->GetComponent< MeshRendererComponent >();
+    CullMeshRenderers( frustum, meshRenderers );
 
-        meshRenderer->Cull( frustum, meshLocalToWorld );
-        meshRenderer->Render( localToView, localToClip, meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, &renderer.builtinShaders.depthNormalsShader, &renderer.builtinShaders.depthNormalsShader, MeshRendererComponent::RenderType::Opaque );
-        meshRenderer->Render( localToView, localToClip, meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, &renderer.builtinShaders.depthNormalsShader,
-                             &renderer.builtinShaders.depthNormalsShader, MeshRendererComponent::RenderType::Transparent );
-    }
+    RenderSortedSubMeshes( meshRenderers, worldToView, camera->GetProjection(), camera->GetFar(), DrawPass::DepthNormals,
+                           &renderer.builtinShaders.depthNormalsShader, &renderer.builtinShaders.depthNormalsShader, &renderer.builtinShaders.depthNormalsInstancedShader );
 
-    GfxDevice::PopGroupMarker();
-    
-    GfxDevice::SetRenderTarget( nullptr, 0 );
-#if RENDERER_VULKAN
-    EndOffscreen();
-#endif
+    commandStream->Add( RenderCommand::Type::PopGroupMarker );
+    commandStream->Add( RenderCommand::Type::EndPass ).endPass.target = target;
+    ExecuteRecordedCommands();
 }
 
 void ae3d::Scene::RenderShadowsWithCamera( GameObject* cameraGo, int cubeMapFace )
@@ -823,35 +1380,18 @@ void ae3d::Scene::RenderShadowsWithCamera( GameObject* cameraGo, int cubeMapFace
     System::Assert( camera->GetTargetTexture() != nullptr, "cannot render shadows if target texture is missing!" );
     int viewport[ 4 ] = { 0, 0, camera->GetTargetTexture()->GetWidth(), camera->GetTargetTexture()->GetHeight() };
 
-#if !RENDERER_METAL
-    GfxDevice::SetRenderTarget( camera->GetTargetTexture(), cubeMapFace );
-#endif
-#ifndef RENDERER_VULKAN
-    GfxDevice::SetViewport( viewport );
-#endif    
-    const Vec3 color = camera->GetClearColor();
-    GfxDevice::SetClearColor( color.x, color.y, color.z );
-    
-    if (camera->GetClearFlag() == CameraComponent::ClearFlag::DepthAndColor)
-    {
-        GfxDevice::ClearScreen( GfxDevice::ClearFlags::Color | GfxDevice::ClearFlags::Depth );
-    }
-#if RENDERER_METAL
-    GfxDevice::SetRenderTarget( camera->GetTargetTexture(), cubeMapFace );
-#endif
-#if RENDERER_VULKAN
-    BeginOffscreen();
-    GfxDevice::SetScissor( viewport );
-    GfxDevice::SetViewport( viewport );
-#endif
-
-    GfxDevice::PushGroupMarker( "Shadow maps" );
+    // Other clear flags keep the target's contents.
+    const unsigned clearFlags = camera->GetClearFlag() == CameraComponent::ClearFlag::DepthAndColor ? (GfxDevice::ClearFlags::Color | GfxDevice::ClearFlags::Depth) : 0;
+    RecordBeginPass( *commandStream, camera->GetTargetTexture(), static_cast< unsigned >( cubeMapFace ), viewport, camera->GetClearColor(), clearFlags );
+    commandStream->Add( RenderCommand::Type::PushGroupMarker ).groupMarker.name = "Shadow maps";
 
+    // The shadow camera is set up after transforms have been updated for the frame and has no parent,
+    // so its local transform is read instead of its world transform.
     Matrix44 view;
-    auto cameraTransform = cameraGo->GetComponent< TransformComponent >();
-    cameraTransform->GetWorldRotation().GetMatrix( view );
+    const TransformComponent& cameraTransform = *cameraGo->GetComponent< TransformComponent >();
+    cameraTransform.GetLocalRotation().GetMatrix( view );
     Matrix44 translation;
-    translation.SetTranslation( -cameraTransform->GetWorldPosition() );
+    translation.SetTranslation( -cameraTransform.GetLocalPosition() );
     Matrix44::Multiply( translation, view, view );
     
     SceneGlobal::shadowCameraViewMatrix = view;
@@ -862,70 +1402,36 @@ void ae3d::Scene::RenderShadowsWithCamera( GameObject* cameraGo, int cubeMapFace
     if (camera->GetProjectionType() == CameraComponent::ProjectionType::Perspective)
     {
         frustum.SetProjection( camera->GetFovDegrees(), camera->GetAspect(), camera->GetNear(), camera->GetFar() );
-        GfxDeviceGlobal::perObjectUboStruct.lightType = PerObjectUboStruct::LightType::Spot;
+        commandStream->Add( RenderCommand::Type::SetLightType ).setLightType.lightType = PerObjectUboStruct::LightType::Spot;
     }
     else
     {
         frustum.SetProjection( camera->GetLeft(), camera->GetRight(), camera->GetBottom(), camera->GetTop(), camera->GetNear(), camera->GetFar() );
-        GfxDeviceGlobal::perObjectUboStruct.lightType = PerObjectUboStruct::LightType::Dir;
+        commandStream->Add( RenderCommand::Type::SetLightType ).setLightType.lightType = PerObjectUboStruct::LightType::Dir;
     }
     
     const Vec3 viewDir = Vec3( view.m[2], view.m[6], view.m[10] ).Normalized();
-    frustum.Update( cameraTransform->GetWorldPosition(), viewDir );
+    frustum.Update( cameraTransform.GetLocalPosition(), viewDir );
     
-    std::vector< unsigned > gameObjectsWithMeshRenderer;
-    gameObjectsWithMeshRenderer.reserve( gameObjects.size() );
-    int gameObjectIndex = -1;
+    std::vector< unsigned > meshRenderers;
+    meshRenderers.reserve( frameMeshRenderers.size() );
     
-    for (auto gameObject : gameObjects)
+    for (unsigned i = 0; i < static_cast< unsigned >( frameMeshRenderers.size() ); ++i)
     {
-        ++gameObjectIndex;
-        
-        if (gameObject == nullptr || !gameObject->IsEnabled())
+        if (frameMeshRenderers[ i ].castsShadow)
         {
-            continue;
-        }
-        
-        auto meshRenderer = gameObject->GetComponent< MeshRendererComponent >();
-        
-        if (meshRenderer && meshRenderer->CastsShadow())
-        {
-            gameObjectsWithMeshRenderer.push_back( gameObjectIndex );
+            meshRenderers.push_back( i );
         }
     }
     
-    auto meshSorterByMesh = [&](unsigned j, unsigned k)
-    {
-        return gameObjects[ j ]->GetComponent< MeshRendererComponent >()->GetMesh() <
-               gameObjects[ k ]->GetComponent< MeshRendererComponent >()->GetMesh();
-    };
-    std::sort( std::begin( gameObjectsWithMeshRenderer ), std::end( gameObjectsWithMeshRenderer ), meshSorterByMesh );
+    CullMeshRenderers( frustum, meshRenderers );
     
-    for (auto j : gameObjectsWithMeshRenderer)
-    {
-        auto transform = gameObjects[ j ]->GetComponent< TransformComponent >();
-        auto meshLocalToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
-        
-        Matrix44 localToView;
-        Matrix44 localToClip;
-        Matrix44::Multiply( meshLocalToWorld, view, localToView );
-        Matrix44::Multiply( localToView, camera->GetProjection(), localToClip );
-
-        auto* meshRenderer = gameObjects[ j ]->GetComponent< MeshRendererComponent >();
-        
-        meshRenderer->Cull( frustum, meshLocalToWorld );
-        meshRenderer->Render( localToView, localToClip, meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, &renderer.builtinShaders.momentsShader,
-                             &renderer.builtinShaders.momentsSkinShader, MeshRendererComponent::RenderType::Opaque );
-    }
-
-    GfxDevice::PopGroupMarker();
+    RenderSortedSubMeshes( meshRenderers, view, camera->GetProjection(), camera->GetFar(), DrawPass::Shadow,
+                           &renderer.builtinShaders.momentsShader, &renderer.builtinShaders.momentsSkinShader, &renderer.builtinShaders.momentsInstancedShader );
 
-#if RENDERER_METAL
-    GfxDevice::SetRenderTarget( nullptr, 0 );
-#endif
-#if RENDERER_VULKAN
-    EndOffscreen();
-#endif
+    commandStream->Add( RenderCommand::Type::PopGroupMarker );
+    commandStream->Add( RenderCommand::Type::EndPass ).endPass.target = camera->GetTargetTexture();
+    ExecuteRecordedCommands();
 }
 
 void ae3d::Scene::SetSkybox( TextureCube* skyTexture )
@@ -1323,7 +1829,47 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
         {
             if (outGameObjects.empty())
             {
-                System::Print( "Failed to parse %s at line %d: found meshrenderer_cast_shadow but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
+                System::Print( "Failed to parse %s at line %d: found meshrenderer_cast_shadow but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
+                return DeserializeResult::ParseError;
+            }
+
+            auto meshRenderer = outGameObjects.back().GetComponent< MeshRendererComponent >();
+
+            if (meshRenderer == nullptr)
+            {
+                System::Print( "Failed to parse %s at line %d: found mesh_cast_shadow but the game object doesn't have a mesh renderer component.\n", serialized.path.c_str(), lineNo );
+                return DeserializeResult::ParseError;
+            }
+
+            std::string str;
+            lineStream >> str;
+            meshRenderer->SetCastShadow( str == std::string( "1" ) );
+        }
+        else if (token == "meshrenderer_occluder")
+        {
+            if (outGameObjects.empty())
+            {
+                System::Print( "Failed to parse %s at line %d: found meshrenderer_occluder but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
+                return DeserializeResult::ParseError;
+            }
+
+            auto meshRenderer = outGameObjects.back().GetComponent< MeshRendererComponent >();
+
+            if (meshRenderer == nullptr)
+            {
+                System::Print( "Failed to parse %s at line %d: found meshrenderer_occluder but the game object doesn't have a mesh renderer component.\n", serialized.path.c_str(), lineNo );
+                return DeserializeResult::ParseError;
+            }
+
+            std::string str;
+            lineStream >> str;
+            meshRenderer->SetOccluder( str == std::string( "1" ) );
+        }
+        else if (token == "meshrenderer_static")
+        {
+            if (outGameObjects.empty())
+            {
+                System::Print( "Failed to parse %s at line %d: found meshrenderer_static but there are no game objects defined before this line.\n", serialized.path.c_str(), lineNo );
                 return DeserializeResult::ParseError;
             }
 
@@ -1331,13 +1877,13 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
 
             if (meshRenderer == nullptr)
             {
-                System::Print( "Failed to parse %s at line %d: found mesh_cast_shadow but the game object doesn't have a mesh renderer component.\n", serialized.path.c_str(), lineNo );
+                System::Print( "Failed to parse %s at line %d: found meshrenderer_static but the game object doesn't have a mesh renderer component.\n", serialized.path.c_str(), lineNo );
                 return DeserializeResult::ParseError;
             }
 
             std::string str;
             lineStream >> str;
-            meshRenderer->SetCastShadow( str == std::string( "1" ) );
+            meshRenderer->SetStatic( str == std::string( "1" ) );
         }
         else if (token == "meshrenderer")
         {
@@ -1704,6 +2250,142 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
     return DeserializeResult::Success;
 }
 
+void ae3d::Scene::ExtractRenderLists()
+{
+    frameMeshRenderers.clear();
+    frameSpritesAndTexts.clear();
+    frameLights.clear();
+    frameCameras.clear();
+    frameRTCameras.clear();
+
+    const unsigned lightBits = GameObject::GetComponentBit< DirectionalLightComponent >() | GameObject::GetComponentBit< SpotLightComponent >() |
+                               GameObject::GetComponentBit< PointLightComponent >();
+    const unsigned spriteOrTextBits = GameObject::GetComponentBit< SpriteRendererComponent >() | GameObject::GetComponentBit< TextRendererComponent >();
+    const unsigned cameraBits = GameObject::GetComponentBit< CameraComponent >() | GameObject::GetComponentBit< TransformComponent >();
+
+    for (unsigned i = 0; i < static_cast< unsigned >( gameObjects.size() ); ++i)
+    {
+        GameObject* gameObject = gameObjects[ i ];
+        const bool hasMeshRenderer = gameObject->IsEnabled() && gameObject->HasComponents( GameObject::GetComponentBit< MeshRendererComponent >() ) &&
+                                     !gameObject->GetComponent< MeshRendererComponent >()->isStaticBatched;
+        GameObjectSlot& slot = gameObjectSlots[ gameObjectSlotIndices[ i ] ];
+
+        if (!hasMeshRenderer && slot.meshRendererProxy != AABBTree::NullNode)
+        {
+            meshRendererTree->DestroyProxy( slot.meshRendererProxy );
+            slot.meshRendererProxy = AABBTree::NullNode;
+        }
+
+        if (!gameObject->IsEnabled())
+        {
+            continue;
+        }
+
+        auto transform = gameObject->GetComponent< TransformComponent >();
+        const Matrix44& localToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
+
+        if (hasMeshRenderer)
+        {
+            frameMeshRenderers.emplace_back();
+            FrameMeshRenderer& entry = frameMeshRenderers.back();
+            entry.meshRenderer = gameObject->GetComponent< MeshRendererComponent >();
+            entry.localToWorld = localToWorld;
+            entry.slotIndex = gameObjectSlotIndices[ i ];
+            entry.layer = gameObject->GetLayer();
+            entry.castsShadow = entry.meshRenderer->CastsShadow();
+            entry.worldVersion = transform ? transform->GetWorldVersion() : 0;
+        }
+
+        if (gameObject->HasAnyComponent( spriteOrTextBits ))
+        {
+            frameSpritesAndTexts.emplace_back();
+            FrameSpriteOrText& entry = frameSpritesAndTexts.back();
+            entry.spriteRenderer = gameObject->GetComponent< SpriteRendererComponent >();
+            entry.textRenderer = gameObject->GetComponent< TextRendererComponent >();
+            entry.localToWorld = localToWorld;
+            entry.layer = gameObject->GetLayer();
+        }
+
+        if (gameObject->HasAnyComponent( lightBits ))
+        {
+            frameLights.emplace_back();
+            FrameLight& entry = frameLights.back();
+            entry.transform = transform;
+            entry.dirLight = gameObject->GetComponent< DirectionalLightComponent >();
+            entry.spotLight = gameObject->GetComponent< SpotLightComponent >();
+            entry.pointLight = gameObject->GetComponent< PointLightComponent >();
+            entry.layer = gameObject->GetLayer();
+        }
+
+        if (gameObject->HasComponents( cameraBits ))
+        {
+            if (gameObject->GetComponent< CameraComponent >()->GetTargetTexture() != nullptr)
+            {
+                frameRTCameras.push_back( gameObject );
+            }
+            else
+            {
+                frameCameras.push_back( gameObject );
+            }
+        }
+    }
+
+    for (unsigned b = 0; b < static_cast< unsigned >( staticBatches.size() ); ++b)
+    {
+        frameMeshRenderers.emplace_back();
+        FrameMeshRenderer& entry = frameMeshRenderers.back();
+        entry.meshRenderer = MeshRendererComponent::Get( staticBatches[ b ]->meshRenderer );
+        entry.localToWorld = Matrix44::identity;
+        entry.slotIndex = b;
+        entry.layer = staticBatches[ b ]->layer;
+        entry.castsShadow = entry.meshRenderer->CastsShadow();
+        entry.isStaticBatch = true;
+    }
+
+    BubbleSort( frameCameras.data(), (int)frameCameras.size() );
+    BubbleSort( frameRTCameras.data(), (int)frameRTCameras.size() );
+
+    // Passes sort their draws by DrawSortKey, whose ids are per frame.
+    drawQueue->shaderIds.clear();
+    drawQueue->materialIds.clear();
+    drawQueue->meshIds.clear();
+    drawQueue->nextSubMeshId = 0;
+
+    // Entries don't share any mutable state, so bounds are computed in parallel.
+    JobSystem::ParallelFor( static_cast< unsigned >( frameMeshRenderers.size() ), 128, [&]( unsigned begin, unsigned end )
+    {
+        for (unsigned i = begin; i < end; ++i)
+        {
+            FrameMeshRenderer& entry = frameMeshRenderers[ i ];
+            const Mesh* mesh = entry.meshRenderer->GetMesh();
+            const Vec3 localMin = mesh ? mesh->GetAABBMin() : Vec3( -1, -1, -1 );
+            const Vec3 localMax = mesh ? mesh->GetAABBMax() : Vec3(  1,  1,  1 );
+
+            Vec3 worldCenter, worldExtent;
+            MathUtil::TransformAABB( localMin, localMax, entry.localToWorld, worldCenter, worldExtent );
+            entry.aabbMin = worldCenter - worldExtent;
+            entry.aabbMax = worldCenter + worldExtent;
+        }
+    } );
+
+    // Most objects stay inside their fattened leaf AABB, so refitting the tree only touches the ones that moved further.
+    for (unsigned i = 0; i < static_cast< unsigned >( frameMeshRenderers.size() ); ++i)
+    {
+        const FrameMeshRenderer& entry = frameMeshRenderers[ i ];
+        int& proxy = entry.isStaticBatch ? staticBatches[ entry.slotIndex ]->proxy : gameObjectSlots[ entry.slotIndex ].meshRendererProxy;
+
+        if (proxy == AABBTree::NullNode)
+        {
+            proxy = meshRendererTree->CreateProxy( entry.aabbMin, entry.aabbMax, i );
+        }
+        else
+        {
+            meshRendererTree->MoveProxy( proxy, entry.aabbMin, entry.aabbMax );
+            meshRendererTree->SetUserData( proxy, i );
+        }
+    }
+}
+
 void ae3d::Scene::GenerateAABB()
 {
     Statistics::BeginSceneAABB();
@@ -1712,57 +2394,521 @@ void ae3d::Scene::GenerateAABB()
     aabbMin = {  maxValue,  maxValue,  maxValue };
     aabbMax = { -maxValue, -maxValue, -maxValue };
     
-    for (auto& o : gameObjects)
+    for (const auto& entry : frameMeshRenderers)
+    {
+        aabbMin.x = entry.aabbMin.x < aabbMin.x ? entry.aabbMin.x : aabbMin.x;
+        aabbMin.y = entry.aabbMin.y < aabbMin.y ? entry.aabbMin.y : aabbMin.y;
+        aabbMin.z = entry.aabbMin.z < aabbMin.z ? entry.aabbMin.z : aabbMin.z;
+        aabbMax.x = entry.aabbMax.x > aabbMax.x ? entry.aabbMax.x : aabbMax.x;
+        aabbMax.y = entry.aabbMax.y > aabbMax.y ? entry.aabbMax.y : aabbMax.y;
+        aabbMax.z = entry.aabbMax.z > aabbMax.z ? entry.aabbMax.z : aabbMax.z;
+    }
+    
+    Statistics::EndSceneAABB();
+}
+
+void ae3d::Scene::GetMeshRenderersInLayers( unsigned layerMask, std::vector< unsigned >& outMeshRenderers ) const
+{
+    outMeshRenderers.clear();
+    outMeshRenderers.reserve( frameMeshRenderers.size() );
+
+    for (unsigned i = 0; i < static_cast< unsigned >( frameMeshRenderers.size() ); ++i)
+    {
+        if ((frameMeshRenderers[ i ].layer & layerMask) != 0)
+        {
+            outMeshRenderers.push_back( i );
+        }
+    }
+}
+
+void ae3d::Scene::CullMeshRenderers( const Frustum& frustum, std::vector< unsigned >& meshRenderers )
+{
+    frameMeshRenderersInFrustum.clear();
+    meshRendererTree->Query( frustum, frameMeshRenderersInFrustum );
+
+    // Tree leaves are fattened, so the tight bounds can still be outside.
+    const unsigned candidateCount = static_cast< unsigned >( frameMeshRenderersInFrustum.size() );
+    frustumTestBounds.resize( candidateCount * 6 );
+    frustumTestVisibleMask.resize( (candidateCount + 31) / 32 );
+
+    AABBArrays candidateBounds;
+    candidateBounds.centerX = frustumTestBounds.data();
+    candidateBounds.centerY = candidateBounds.centerX + candidateCount;
+    candidateBounds.centerZ = candidateBounds.centerY + candidateCount;
+    candidateBounds.extentX = candidateBounds.centerZ + candidateCount;
+    candidateBounds.extentY = candidateBounds.extentX + candidateCount;
+    candidateBounds.extentZ = candidateBounds.extentY + candidateCount;
+
+    for (unsigned c = 0; c < candidateCount; ++c)
+    {
+        const FrameMeshRenderer& entry = frameMeshRenderers[ frameMeshRenderersInFrustum[ c ] ];
+        const Vec3 center = (entry.aabbMin + entry.aabbMax) * 0.5f;
+        const Vec3 extent = (entry.aabbMax - entry.aabbMin) * 0.5f;
+        frustumTestBounds[ candidateCount * 0 + c ] = center.x;
+        frustumTestBounds[ candidateCount * 1 + c ] = center.y;
+        frustumTestBounds[ candidateCount * 2 + c ] = center.z;
+        frustumTestBounds[ candidateCount * 3 + c ] = extent.x;
+        frustumTestBounds[ candidateCount * 4 + c ] = extent.y;
+        frustumTestBounds[ candidateCount * 5 + c ] = extent.z;
+    }
+
+    frustum.BoxesInFrustum( candidateBounds, candidateCount, frustumTestVisibleMask.data() );
+
+    isFrameMeshRendererInFrustum.assign( frameMeshRenderers.size(), 0 );
+
+    for (unsigned c = 0; c < candidateCount; ++c)
+    {
+        isFrameMeshRendererInFrustum[ frameMeshRenderersInFrustum[ c ] ] = (frustumTestVisibleMask[ c / 32 ] >> (c % 32)) & 1;
+    }
+
+    // Keeps the mesh order.
+    meshRenderers.erase( std::remove_if( std::begin( meshRenderers ), std::end( meshRenderers ), [&]( unsigned i ) { return isFrameMeshRendererInFrustum[ i ] == 0; } ),
+                         std::end( meshRenderers ) );
+
+    // CullSubMeshes only writes into its own component, so batches don't share any mutable state.
+    JobSystem::ParallelFor( static_cast< unsigned >( meshRenderers.size() ), 128, [&]( unsigned begin, unsigned end )
+    {
+        for (unsigned i = begin; i < end; ++i)
+        {
+            const FrameMeshRenderer& entry = frameMeshRenderers[ meshRenderers[ i ] ];
+            entry.meshRenderer->CullSubMeshes( frustum, entry.localToWorld );
+        }
+    } );
+}
+
+void ae3d::Scene::CullOccludedMeshRenderers( const Matrix44& worldToClip, std::vector< unsigned >& meshRenderers )
+{
+    occlusionCuller->Begin( worldToClip );
+
+    for (auto j : meshRenderers)
+    {
+        if (frameMeshRenderers[ j ].meshRenderer->IsOccluder())
+        {
+            frameMeshRenderers[ j ].meshRenderer->AddOccluder( *occlusionCuller, frameMeshRenderers[ j ].localToWorld );
+        }
+    }
+
+    if (!occlusionCuller->HasOccluders())
+    {
+        return;
+    }
+
+    occlusionCuller->Rasterize();
+
+    // Occluders are not tested, because their own triangles would hide them.
+    isFrameMeshRendererOccluded.assign( frameMeshRenderers.size(), 0 );
+    int testedCount = 0;
+
+    for (auto j : meshRenderers)
+    {
+        testedCount += frameMeshRenderers[ j ].meshRenderer->IsOccluder() ? 0 : 1;
+    }
+
+    JobSystem::ParallelFor( static_cast< unsigned >( meshRenderers.size() ), 64, [&]( unsigned begin, unsigned end )
+    {
+        for (unsigned i = begin; i < end; ++i)
+        {
+            const FrameMeshRenderer& entry = frameMeshRenderers[ meshRenderers[ i ] ];
+
+            if (!entry.meshRenderer->IsOccluder())
+            {
+                isFrameMeshRendererOccluded[ meshRenderers[ i ] ] = occlusionCuller->IsOccluded( entry.aabbMin, entry.aabbMax ) ? 1 : 0;
+            }
+        }
+    } );
+
+    const std::size_t countBefore = meshRenderers.size();
+
+    // Keeps the mesh order.
+    meshRenderers.erase( std::remove_if( std::begin( meshRenderers ), std::end( meshRenderers ), [&]( unsigned i ) { return isFrameMeshRendererOccluded[ i ] != 0; } ),
+                         std::end( meshRenderers ) );
+
+    Statistics::IncOcclusionTestedObjects( testedCount );
+    Statistics::IncOcclusionCulledObjects( static_cast< int >( countBefore - meshRenderers.size() ) );
+}
+
+void ae3d::Scene::RenderSortedSubMeshes( const std::vector< unsigned >& meshRenderers, const Matrix44& worldToView, const Matrix44& projection, float farDepth,
+                                         DrawPass pass, Shader* overrideShader, Shader* overrideSkinShader, Shader* overrideInstancedShader )
+{
+    DrawQueue& queue = *drawQueue;
+    const unsigned meshRendererCount = static_cast< unsigned >( meshRenderers.size() );
+    queue.localToViews.resize( meshRendererCount );
+    queue.localToClips.resize( meshRendererCount );
+    queue.quantizedDepths.resize( meshRendererCount );
+
+    JobSystem::ParallelFor( meshRendererCount, 128, [&]( unsigned begin, unsigned end )
+    {
+        for (unsigned i = begin; i < end; ++i)
+        {
+            const FrameMeshRenderer& entry = frameMeshRenderers[ meshRenderers[ i ] ];
+            Matrix44::Multiply( entry.localToWorld, worldToView, queue.localToViews[ i ] );
+            Matrix44::Multiply( queue.localToViews[ i ], projection, queue.localToClips[ i ] );
+
+            // The camera looks towards negative view-space z.
+            const Vec3 center = (entry.aabbMin + entry.aabbMax) * 0.5f;
+            const float viewDepth = -(worldToView.m[ 2 ] * center.x + worldToView.m[ 6 ] * center.y + worldToView.m[ 10 ] * center.z + worldToView.m[ 14 ]);
+            queue.quantizedDepths[ i ] = DrawSortKey::QuantizeDepth( viewDepth, farDepth );
+        }
+    } );
+
+    queue.draws.clear();
+    queue.sortKeys.clear();
+
+    for (unsigned i = 0; i < meshRendererCount; ++i)
+    {
+        MeshRendererComponent* meshRenderer = frameMeshRenderers[ meshRenderers[ i ] ].meshRenderer;
+        Mesh* mesh = meshRenderer->GetMesh();
+
+        if (mesh == nullptr || !meshRenderer->IsEnabled())
+        {
+            continue;
+        }
+
+        const unsigned subMeshCount = mesh->GetSubMeshCount();
+        const unsigned subMeshBaseId = queue.GetSubMeshBaseId( mesh, subMeshCount );
+
+        for (unsigned subMeshIndex = 0; subMeshIndex < subMeshCount; ++subMeshIndex)
+        {
+            if (meshRenderer->isSubMeshCulled[ subMeshIndex ])
+            {
+                continue;
+            }
+
+            Material* material = meshRenderer->GetMaterial( subMeshIndex );
+            const bool isTransparent = material->GetBlendingMode() != Material::BlendingMode::Off;
+
+            if (isTransparent && pass == DrawPass::Shadow)
+            {
+                continue;
+            }
+
+            SortKeyIndex sortKey;
+            sortKey.index = static_cast< unsigned >( queue.draws.size() );
+            const unsigned meshId = subMeshBaseId + subMeshIndex;
+
+            if (pass != DrawPass::Camera)
+            {
+                // The override shader replaces material state, so only mesh changes matter.
+                sortKey.key = DrawSortKey::MakeOpaque( 0, 0, meshId, queue.quantizedDepths[ i ] );
+            }
+            else
+            {
+                const unsigned shaderId = DrawQueue::GetSortId< Shader >( queue.shaderIds, material->GetShader() );
+                const unsigned materialId = DrawQueue::GetSortId< Material >( queue.materialIds, material );
+                sortKey.key = isTransparent ? DrawSortKey::MakeTransparent( shaderId, materialId, meshId, queue.quantizedDepths[ i ] ) :
+                                              DrawSortKey::MakeOpaque( shaderId, materialId, meshId, queue.quantizedDepths[ i ] );
+            }
+
+            queue.sortKeys.push_back( sortKey );
+            queue.draws.push_back( { i, subMeshIndex } );
+        }
+    }
+
+    RadixSort( queue.sortKeys, queue.sortScratch );
+
+    Matrix44 worldToClip;
+    Matrix44::Multiply( worldToView, projection, worldToClip );
+
+    CommandStream& stream = *commandStream;
+    const unsigned viewMatrices = stream.AddMatrix( worldToView );
+    stream.AddMatrix( worldToClip );
+    stream.AddMatrix( SceneGlobal::shadowCameraViewMatrix );
+    stream.AddMatrix( SceneGlobal::shadowCameraProjectionMatrix );
+
+    const std::size_t drawCount = queue.sortKeys.size();
+    std::size_t first = 0;
+
+    while (first < drawCount)
+    {
+        const DrawQueue::SubMeshDraw& draw = queue.draws[ queue.sortKeys[ first ].index ];
+        const FrameMeshRenderer& entry = frameMeshRenderers[ meshRenderers[ draw.listIndex ] ];
+        MeshRendererComponent* meshRenderer = entry.meshRenderer;
+        Material* material = meshRenderer->GetMaterial( draw.subMeshIndex );
+        Shader* instancedShader = overrideShader ? overrideInstancedShader : material->GetInstancedShader();
+        std::size_t last = first + 1;
+
+        // Extends the run while the draws only differ by localToWorld.
+        if (instancedShader != nullptr && instancedShader->IsValid() && !meshRenderer->IsSubMeshSkinned( draw.subMeshIndex ))
+        {
+            while (last < drawCount && last - first < static_cast< std::size_t >( PerObjectUboStruct::MaxInstances ))
+            {
+                const DrawQueue::SubMeshDraw& other = queue.draws[ queue.sortKeys[ last ].index ];
+                const MeshRendererComponent* otherMeshRenderer = frameMeshRenderers[ meshRenderers[ other.listIndex ] ].meshRenderer;
+
+                if (other.subMeshIndex != draw.subMeshIndex || otherMeshRenderer->mesh != meshRenderer->mesh ||
+                    otherMeshRenderer->materials[ other.subMeshIndex ] != material || otherMeshRenderer->isWireframe != meshRenderer->isWireframe)
+                {
+                    break;
+                }
+
+                ++last;
+            }
+        }
+
+        if (last - first == 1)
+        {
+            const unsigned localMatrices = stream.AddMatrix( queue.localToViews[ draw.listIndex ] );
+            stream.AddMatrix( queue.localToClips[ draw.listIndex ] );
+            stream.AddMatrix( entry.localToWorld );
+
+            RenderCommand::DrawSubMeshData& data = stream.Add( RenderCommand::Type::DrawSubMesh ).drawSubMesh;
+            data.meshRenderer = meshRenderer;
+            data.subMeshIndex = draw.subMeshIndex;
+            data.overrideShader = overrideShader;
+            data.overrideSkinShader = overrideSkinShader;
+            data.localMatrices = localMatrices;
+            data.viewMatrices = viewMatrices;
+        }
+        else
+        {
+            const unsigned instanceMatrices = stream.AddMatrix( entry.localToWorld );
+
+            for (std::size_t d = first + 1; d < last; ++d)
+            {
+                stream.AddMatrix( frameMeshRenderers[ meshRenderers[ queue.draws[ queue.sortKeys[ d ].index ].listIndex ] ].localToWorld );
+            }
+
+            RenderCommand::DrawSubMeshInstancedData& data = stream.Add( RenderCommand::Type::DrawSubMeshInstanced ).drawSubMeshInstanced;
+            data.meshRenderer = meshRenderer;
+            data.subMeshIndex = draw.subMeshIndex;
+            data.overrideInstancedShader = overrideInstancedShader;
+            data.instanceMatrices = instanceMatrices;
+            data.instanceCount = static_cast< unsigned >( last - first );
+            data.viewMatrices = viewMatrices;
+        }
+
+        first = last;
+    }
+}
+
+#if RENDERER_VULKAN
+void ae3d::Scene::RenderIndirectSubMeshes( const CameraComponent* camera, int cubeMapFace, std::vector< unsigned >& meshRenderers, const Matrix44& worldToView,
+                                           const Matrix44& worldToClip )
+{
+    IndirectQueue& queue = *indirectQueue;
+    IndirectQueue::CameraQueue& cameraQueue = queue.cameraQueues[ std::make_pair( camera, cubeMapFace ) ];
+    queue.isIndirect.assign( frameMeshRenderers.size(), 0 );
+    queue.memberFrameMeshRenderers.clear();
+
+    // Gathers the members and compares them with the queue's. Members are mesh renderers whose submeshes can all be drawn indirectly.
+    bool isMembershipChanged = false;
+
+    for (unsigned frameIndex : meshRenderers)
     {
-        if (!o)
+        MeshRendererComponent* meshRenderer = frameMeshRenderers[ frameIndex ].meshRenderer;
+        Mesh* mesh = meshRenderer->GetMesh();
+
+        if (mesh == nullptr || !meshRenderer->IsEnabled() || meshRenderer->isOccluder || meshRenderer->isWireframe)
         {
             continue;
         }
 
-        auto meshRenderer = o->GetComponent< ae3d::MeshRendererComponent >();
-        auto meshTransform = o->GetComponent< ae3d::TransformComponent >();
+        int subMeshCount = 0;
+        SubMesh* subMeshes = mesh->GetSubMeshes( subMeshCount );
+        bool isIndirect = subMeshCount > 0;
+
+        for (int subMeshIndex = 0; subMeshIndex < subMeshCount && isIndirect; ++subMeshIndex)
+        {
+            Material* material = meshRenderer->GetMaterial( subMeshIndex );
+            isIndirect = material != nullptr && material->GetIndirectShader() != nullptr && material->GetIndirectShader()->IsValid() &&
+                         material->GetBlendingMode() == Material::BlendingMode::Off && subMeshes[ subMeshIndex ].joints.empty();
+        }
 
-        if (meshRenderer == nullptr || meshTransform == nullptr)
+        if (!isIndirect)
         {
             continue;
         }
-        
-        Vec3 oAABBmin = meshRenderer->GetMesh() ? meshRenderer->GetMesh()->GetAABBMin() : Vec3( -1, -1, -1 );
-        Vec3 oAABBmax = meshRenderer->GetMesh() ? meshRenderer->GetMesh()->GetAABBMax() : Vec3(  1,  1,  1 );
-        
-        Matrix44::TransformPoint( oAABBmin, meshTransform->GetLocalToWorldMatrix(), &oAABBmin );
-        Matrix44::TransformPoint( oAABBmax, meshTransform->GetLocalToWorldMatrix(), &oAABBmax );
-        
-        if (oAABBmin.x < aabbMin.x)
+
+        queue.isIndirect[ frameIndex ] = 1;
+        const std::size_t memberIndex = queue.memberFrameMeshRenderers.size();
+        queue.memberFrameMeshRenderers.push_back( frameIndex );
+
+        if (isMembershipChanged || memberIndex >= cameraQueue.members.size() || cameraQueue.members[ memberIndex ].meshRenderer != meshRenderer ||
+            cameraQueue.members[ memberIndex ].subMeshCount != static_cast< unsigned >( subMeshCount ))
         {
-            aabbMin.x = oAABBmin.x;
+            isMembershipChanged = true;
+            continue;
         }
-        
-        if (oAABBmin.y < aabbMin.y)
+
+        const IndirectQueue::SubMeshInstance* subMeshInstances = &cameraQueue.subMeshInstances[ cameraQueue.members[ memberIndex ].firstSubMeshInstance ];
+
+        for (int subMeshIndex = 0; subMeshIndex < subMeshCount; ++subMeshIndex)
         {
-            aabbMin.y = oAABBmin.y;
+            isMembershipChanged |= subMeshInstances[ subMeshIndex ].material != meshRenderer->GetMaterial( subMeshIndex ) ||
+                                   subMeshInstances[ subMeshIndex ].vertexBuffer != &subMeshes[ subMeshIndex ].vertexBuffer;
         }
-        
-        if (oAABBmin.z < aabbMin.z)
+    }
+
+    isMembershipChanged |= queue.memberFrameMeshRenderers.size() != cameraQueue.members.size() || cameraQueue.instances == -1;
+    queue.updatedIndices.clear();
+    queue.updatedInstances.clear();
+
+    if (isMembershipChanged)
+    {
+        IndirectQueue::Release( cameraQueue );
+        cameraQueue.members.clear();
+        cameraQueue.subMeshInstances.clear();
+        cameraQueue.draws.clear();
+        cameraQueue.drawOwners.clear();
+        cameraQueue.sortedDraws.clear();
+        queue.drawIndices.clear();
+
+        // Counts each draw's instances. Draws are submeshes' vertex buffers with a material.
+        for (unsigned frameIndex : queue.memberFrameMeshRenderers)
         {
-            aabbMin.z = oAABBmin.z;
+            MeshRendererComponent* meshRenderer = frameMeshRenderers[ frameIndex ].meshRenderer;
+            int subMeshCount = 0;
+            SubMesh* subMeshes = meshRenderer->GetMesh()->GetSubMeshes( subMeshCount );
+            cameraQueue.members.push_back( { meshRenderer, static_cast< unsigned >( cameraQueue.subMeshInstances.size() ), static_cast< unsigned >( subMeshCount ), 0 } );
+
+            for (int subMeshIndex = 0; subMeshIndex < subMeshCount; ++subMeshIndex)
+            {
+                const Material* material = meshRenderer->GetMaterial( subMeshIndex );
+                auto result = queue.drawIndices.insert( std::make_pair( std::make_pair( material, &subMeshes[ subMeshIndex ].vertexBuffer ), static_cast< unsigned >( cameraQueue.draws.size() ) ) );
+
+                if (result.second)
+                {
+                    GfxDevice::IndirectDraw draw;
+                    draw.vertexBuffer = &subMeshes[ subMeshIndex ].vertexBuffer;
+                    cameraQueue.draws.push_back( draw );
+                    cameraQueue.drawOwners.push_back( { meshRenderer, static_cast< unsigned >( subMeshIndex ), material } );
+                }
+
+                ++cameraQueue.draws[ result.first->second ].instanceCount;
+                cameraQueue.subMeshInstances.push_back( { material, &subMeshes[ subMeshIndex ].vertexBuffer, result.first->second, 0 } );
+            }
         }
-        
-        if (oAABBmax.x > aabbMax.x)
+
+        if (cameraQueue.draws.empty())
         {
-            aabbMax.x = oAABBmax.x;
+            return;
         }
-        
-        if (oAABBmax.y > aabbMax.y)
+
+        // Orders draws by material and vertex format, so each material is drawn with one DrawIndirect.
+        const unsigned drawCount = static_cast< unsigned >( cameraQueue.draws.size() );
+        cameraQueue.drawOrder.resize( drawCount );
+
+        for (unsigned d = 0; d < drawCount; ++d)
         {
-            aabbMax.y = oAABBmax.y;
+            cameraQueue.drawOrder[ d ] = d;
         }
-        
-        if (oAABBmax.z > aabbMax.z)
+
+        std::sort( std::begin( cameraQueue.drawOrder ), std::end( cameraQueue.drawOrder ), [&]( unsigned a, unsigned b )
+        {
+            const IndirectQueue::DrawOwner& ownerA = cameraQueue.drawOwners[ a ];
+            const IndirectQueue::DrawOwner& ownerB = cameraQueue.drawOwners[ b ];
+            const auto formatA = cameraQueue.draws[ a ].vertexBuffer->GetVertexFormat();
+            const auto formatB = cameraQueue.draws[ b ].vertexBuffer->GetVertexFormat();
+            return std::less< const Material* >()( ownerA.material, ownerB.material ) || (ownerA.material == ownerB.material && formatA < formatB);
+        } );
+
+        cameraQueue.sortedDraws.resize( drawCount );
+        queue.sortedDrawIndices.resize( drawCount );
+        queue.nextInstances.resize( drawCount );
+        unsigned instanceCount = 0;
+
+        for (unsigned s = 0; s < drawCount; ++s)
+        {
+            cameraQueue.sortedDraws[ s ] = cameraQueue.draws[ cameraQueue.drawOrder[ s ] ];
+            cameraQueue.sortedDraws[ s ].firstInstance = instanceCount;
+            queue.sortedDrawIndices[ cameraQueue.drawOrder[ s ] ] = s;
+            queue.nextInstances[ s ] = instanceCount;
+            instanceCount += cameraQueue.sortedDraws[ s ].instanceCount;
+        }
+
+        for (IndirectQueue::SubMeshInstance& subMeshInstance : cameraQueue.subMeshInstances)
         {
-            aabbMax.z = oAABBmax.z;
+            subMeshInstance.drawIndex = queue.sortedDrawIndices[ subMeshInstance.drawIndex ];
+            subMeshInstance.instanceIndex = queue.nextInstances[ subMeshInstance.drawIndex ]++;
+        }
+
+        cameraQueue.instances = GfxDevice::CreateIndirectInstances( instanceCount );
+
+        if (cameraQueue.instances == -1)
+        {
+            // The mesh renderers are drawn by RenderSortedSubMeshes, and the queue is rebuilt in the next frame.
+            return;
         }
     }
-    
-    Statistics::EndSceneAABB();
+
+    if (cameraQueue.sortedDraws.empty())
+    {
+        return;
+    }
+
+    // A rebuilt queue uploads all its instances. Otherwise only mesh renderers whose transform has changed since their upload are updated,
+    // so a queue that isn't rendered in every Render, or a transform update by another scene's Render, doesn't miss changes.
+    for (std::size_t memberIndex = 0; memberIndex < cameraQueue.members.size(); ++memberIndex)
+    {
+        const FrameMeshRenderer& entry = frameMeshRenderers[ queue.memberFrameMeshRenderers[ memberIndex ] ];
+        IndirectQueue::Member& member = cameraQueue.members[ memberIndex ];
+
+        if (!isMembershipChanged && entry.worldVersion == member.uploadedWorldVersion)
+        {
+            continue;
+        }
+
+        member.uploadedWorldVersion = entry.worldVersion;
+        int subMeshCount = 0;
+        const SubMesh* subMeshes = entry.meshRenderer->GetMesh()->GetSubMeshes( subMeshCount );
+
+        for (unsigned subMeshIndex = 0; subMeshIndex < member.subMeshCount; ++subMeshIndex)
+        {
+            const IndirectQueue::SubMeshInstance& subMeshInstance = cameraQueue.subMeshInstances[ member.firstSubMeshInstance + subMeshIndex ];
+
+            GfxDevice::IndirectInstance instance;
+            instance.localToWorld = entry.localToWorld;
+            instance.aabbMin = subMeshes[ subMeshIndex ].aabbMin;
+            instance.aabbMax = subMeshes[ subMeshIndex ].aabbMax;
+            instance.drawIndex = subMeshInstance.drawIndex;
+            queue.updatedIndices.push_back( subMeshInstance.instanceIndex );
+            queue.updatedInstances.push_back( instance );
+        }
+    }
+
+    if (!queue.updatedIndices.empty())
+    {
+        GfxDevice::UpdateIndirectInstances( cameraQueue.instances, queue.updatedIndices.data(), queue.updatedInstances.data(),
+                                            static_cast< unsigned >( queue.updatedIndices.size() ) );
+    }
+
+    const unsigned drawCount = static_cast< unsigned >( cameraQueue.sortedDraws.size() );
+
+    if (!GfxDevice::CullIndirect( cameraQueue.instances, cameraQueue.sortedDraws.data(), drawCount, worldToClip ))
+    {
+        return;
+    }
+
+    meshRenderers.erase( std::remove_if( std::begin( meshRenderers ), std::end( meshRenderers ), [&]( unsigned i ) { return queue.isIndirect[ i ] != 0; } ),
+                         std::end( meshRenderers ) );
+
+    CommandStream& stream = *commandStream;
+    const unsigned viewMatrices = stream.AddMatrix( worldToView );
+    stream.AddMatrix( worldToClip );
+    stream.AddMatrix( SceneGlobal::shadowCameraViewMatrix );
+    stream.AddMatrix( SceneGlobal::shadowCameraProjectionMatrix );
+
+    unsigned first = 0;
+
+    while (first < drawCount)
+    {
+        const IndirectQueue::DrawOwner& owner = cameraQueue.drawOwners[ cameraQueue.drawOrder[ first ] ];
+        const auto vertexFormat = cameraQueue.sortedDraws[ first ].vertexBuffer->GetVertexFormat();
+        unsigned last = first + 1;
+
+        while (last < drawCount && cameraQueue.drawOwners[ cameraQueue.drawOrder[ last ] ].material == owner.material &&
+               cameraQueue.sortedDraws[ last ].vertexBuffer->GetVertexFormat() == vertexFormat)
+        {
+            ++last;
+        }
+
+        RenderCommand::DrawSubMeshIndirectData& data = stream.Add( RenderCommand::Type::DrawSubMeshIndirect ).drawSubMeshIndirect;
+        data.meshRenderer = owner.meshRenderer;
+        data.subMeshIndex = owner.subMeshIndex;
+        data.firstIndirectDraw = first;
+        data.indirectDrawCount = last - first;
+        data.viewMatrices = viewMatrices;
+        first = last;
+    }
 }
+#endif
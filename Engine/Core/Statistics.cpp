@@ -1,19 +1,31 @@
 #include "Statistics.hpp"
 #include "GfxDevice.hpp"
+#include <atomic>
 #include <chrono>
 
 namespace Statistics
 {
-    int drawCalls = 0;
-    int barrierCalls = 0;
-    int fenceCalls = 0;
-    int shaderBinds = 0;
-    int renderTargetBinds = 0;
-    int createConstantBufferCalls = 0;
-    int allocCalls = 0;
-    int totalAllocCalls = 0;
-    int triangleCount = 0;
-    int psoBindCount = 0;
+    // Counters are atomic because draws can be recorded from job threads.
+    std::atomic< int > drawCalls{ 0 };
+    std::atomic< int > barrierCalls{ 0 };
+    std::atomic< int > fenceCalls{ 0 };
+    std::atomic< int > shaderBinds{ 0 };
+    std::atomic< int > renderTargetBinds{ 0 };
+    std::atomic< int > createConstantBufferCalls{ 0 };
+    std::atomic< int > allocCalls{ 0 };
+    std::atomic< int > totalAllocCalls{ 0 };
+    std::atomic< int > triangleCount{ 0 };
+    std::atomic< int > psoBindCount{ 0 };
+    std::atomic< int > uploads{ 0 };
+    std::atomic< int > uploadBytes{ 0 };
+    std::atomic< int > occlusionTestedObjects{ 0 };
+    std::atomic< int > occlusionCulledObjects{ 0 };
+    std::atomic< int > skippedDraws{ 0 };
+    Pass currentPass = Pass::Other;
+    std::atomic< int > passDrawCalls[ (int)Pass::Count ];
+    std::atomic< int > passBinds[ (int)Pass::Count ];
+    std::atomic< int > passUploads[ (int)Pass::Count ];
+    std::atomic< int > passUploadBytes[ (int)Pass::Count ];
     float depthNormalsTimeMS = 0;
     float depthNormalsTimeGpuMS = 0;
     float shadowMapTimeMS = 0;
@@ -124,6 +136,7 @@ void Statistics::EndFrameTimeProfiling()
 void Statistics::IncPSOBindCalls()
 {
     ++Statistics::psoBindCount;
+    ++Statistics::passBinds[ (int)Statistics::currentPass ];
 }
 
 int Statistics::GetPSOBindCalls()
@@ -179,16 +192,97 @@ int Statistics::GetFenceCalls()
 void Statistics::IncRenderTargetBinds()
 {
     ++Statistics::renderTargetBinds;
+    ++Statistics::passBinds[ (int)Statistics::currentPass ];
 }
 
 void Statistics::IncShaderBinds()
 {
     ++Statistics::shaderBinds;
+    ++Statistics::passBinds[ (int)Statistics::currentPass ];
 }
 
 void Statistics::IncDrawCalls()
 {
     ++Statistics::drawCalls;
+    ++Statistics::passDrawCalls[ (int)Statistics::currentPass ];
+}
+
+void Statistics::IncUploads( int bytes )
+{
+    ++Statistics::uploads;
+    Statistics::uploadBytes += bytes;
+    ++Statistics::passUploads[ (int)Statistics::currentPass ];
+    Statistics::passUploadBytes[ (int)Statistics::currentPass ] += bytes;
+}
+
+int Statistics::GetUploads()
+{
+    return Statistics::uploads;
+}
+
+int Statistics::GetUploadBytes()
+{
+    return Statistics::uploadBytes;
+}
+
+void Statistics::IncOcclusionTestedObjects( int count )
+{
+    Statistics::occlusionTestedObjects += count;
+}
+
+int Statistics::GetOcclusionTestedObjects()
+{
+    return Statistics::occlusionTestedObjects;
+}
+
+void Statistics::IncOcclusionCulledObjects( int count )
+{
+    Statistics::occlusionCulledObjects += count;
+}
+
+int Statistics::GetOcclusionCulledObjects()
+{
+    return Statistics::occlusionCulledObjects;
+}
+
+void Statistics::IncSkippedDraws()
+{
+    ++Statistics::skippedDraws;
+}
+
+int Statistics::GetSkippedDraws()
+{
+    return Statistics::skippedDraws;
+}
+
+void Statistics::SetCurrentPass( Pass pass )
+{
+    Statistics::currentPass = pass;
+}
+
+Statistics::Pass Statistics::GetCurrentPass()
+{
+    return Statistics::currentPass;
+}
+
+int Statistics::GetPassDrawCalls( Pass pass )
+{
+    return Statistics::passDrawCalls[ (int)pass ];
+}
+
+int Statistics::GetPassBinds( Pass pass )
+{
+    return Statistics::passBinds[ (int)pass ];
+}
+
+int Statistics::GetPassUploads( Pass pass )
+{
+    return Statistics::passUploads[ (int)pass ];
+}
+
+int Statistics::GetPassUploadBytes( Pass pass )
+{
+    return Statistics::passUploadBytes[ (int)pass ];
 }
 
 float Statistics::GetFrameTimeMS()
@@ -247,6 +341,20 @@ void Statistics::ResetFrameStatistics()
     allocCalls = 0;
     triangleCount = 0;
     psoBindCount = 0;
+    uploads = 0;
+    uploadBytes = 0;
+    occlusionTestedObjects = 0;
+    occlusionCulledObjects = 0;
+    skippedDraws = 0;
+    currentPass = Pass::Other;
+
+    for (int passIndex = 0; passIndex < (int)Pass::Count; ++passIndex)
+    {
+        passDrawCalls[ passIndex ] = 0;
+        passBinds[ passIndex ] = 0;
+        passUploads[ passIndex ] = 0;
+        passUploadBytes[ passIndex ] = 0;
+    }
 
     startFrameTimePoint = std::chrono::steady_clock::now();
 }
@@ -2,6 +2,9 @@
 
 namespace Statistics
 {
+    /// Render pass that per-pass counters are accumulated into. Set by Scene while it renders.
+    enum class Pass { Other, ShadowMap, DepthNormals, RenderTexture, Primary, Count };
+
     void BeginLightCullerProfiling();
     void EndLightCullerProfiling();
 
@@ -50,6 +53,22 @@ namespace Statistics
     int GetTotalAllocCalls();
     void IncPSOBindCalls();
     int GetPSOBindCalls();
+    void IncUploads( int bytes );
+    int GetUploads();
+    int GetUploadBytes();
+    void SetCurrentPass( Pass pass );
+    Pass GetCurrentPass();
+    int GetPassDrawCalls( Pass pass );
+    int GetPassBinds( Pass pass );
+    int GetPassUploads( Pass pass );
+    int GetPassUploadBytes( Pass pass );
+    void IncOcclusionTestedObjects( int count );
+    int GetOcclusionTestedObjects();
+    void IncOcclusionCulledObjects( int count );
+    int GetOcclusionCulledObjects();
+    /// Counts draws that the renderer dropped, for example because a texture or shader wasn't loaded.
+    void IncSkippedDraws();
+    int GetSkippedDraws();
     void SetDepthNormalsGpuTime( float timeMS );
     void SetShadowMapGpuTime( float timeMS );
     void SetLightCullerTimeGpuMS( float timeMS );
@@ -13,6 +13,7 @@
 #include "AudioSystem.hpp"
 #include "GfxDevice.hpp"
 #include "FileWatcher.hpp"
+#include "JobSystem.hpp"
 #include "Matrix.hpp"
 #include "Renderer.hpp"
 #include "Shader.hpp"
@@ -25,7 +26,7 @@ extern ae3d::FileWatcher fileWatcher;
 
 namespace GfxDeviceGlobal
 {
-    extern PerObjectUboStruct perObjectUboStruct;
+    extern thread_local PerObjectUboStruct perObjectUboStruct;
 }
 
 void PlatformInitGamePad();
@@ -72,6 +73,7 @@ void ae3d::System::EndFrame()
 
 void ae3d::System::Deinit()
 {
+    JobSystem::Deinit();
     GfxDevice::ReleaseGPUObjects();
     AudioSystem::Deinit();
 }
@@ -99,8 +101,8 @@ void ae3d::System::DrawUI( int scX, int scY, int scWidth, int scHeight, int elem
 
     renderer.builtinShaders.uiShader.Use();
     renderer.builtinShaders.uiShader.SetTexture( texture, 0 );
-    GfxDeviceGlobal::perObjectUboStruct.localToClip.InitFrom( &ortho[ 0 ][ 0 ] );
-    GfxDeviceGlobal::perObjectUboStruct.lightColor = Vec4( 1, 1, 1, 1 );
+    GfxDeviceGlobal::perObjectUboStruct.object.localToClip.InitFrom( &ortho[ 0 ][ 0 ] );
+    GfxDeviceGlobal::perObjectUboStruct.camera.lightColor = Vec4( 1, 1, 1, 1 );
 
     int viewport[ 4 ];
     viewport[ 0 ] = 0;
@@ -209,8 +211,8 @@ void ae3d::System::Draw( TextureBase* texture, int x, int y, int xSize, int ySiz
         renderer.builtinShaders.spriteRendererShader.SetRenderTexture( (RenderTexture*)texture, 0 );
     }
     
-    GfxDeviceGlobal::perObjectUboStruct.localToClip = mvp;
-    GfxDeviceGlobal::perObjectUboStruct.lightColor = tintColor;
+    GfxDeviceGlobal::perObjectUboStruct.object.localToClip = mvp;
+    GfxDeviceGlobal::perObjectUboStruct.camera.lightColor = tintColor;
     
     int viewport[ 4 ];
     viewport[ 0 ] = 0;
@@ -245,8 +247,8 @@ void ae3d::System::DrawLines( int handle, const Matrix44& view, const Matrix44&
     Matrix44::Multiply( view, projection, viewProjection );
     renderer.builtinShaders.spriteRendererShader.Use();
     renderer.builtinShaders.spriteRendererShader.SetTexture( Texture2D::GetDefaultTexture(), 0 );
-    GfxDeviceGlobal::perObjectUboStruct.lightColor = Vec4( 1, 1, 1, 1 );
-    GfxDeviceGlobal::perObjectUboStruct.localToClip = viewProjection;
+    GfxDeviceGlobal::perObjectUboStruct.camera.lightColor = Vec4( 1, 1, 1, 1 );
+    GfxDeviceGlobal::perObjectUboStruct.object.localToClip = viewProjection;
 
     GfxDevice::DrawLines( handle, renderer.builtinShaders.spriteRendererShader );
 }
@@ -0,0 +1,296 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "TLSFAllocator.hpp"
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+#include "System.hpp"
+
+using namespace ae3d;
+
+namespace
+{
+    unsigned FloorLog2( std::uint64_t value )
+    {
+#if defined( _MSC_VER )
+        unsigned long index;
+        _BitScanReverse64( &index, value );
+        return static_cast< unsigned >( index );
+#else
+        return 63u - static_cast< unsigned >( __builtin_clzll( value ) );
+#endif
+    }
+
+    unsigned LowestBit( std::uint64_t value )
+    {
+#if defined( _MSC_VER )
+        unsigned long index;
+        _BitScanForward64( &index, value );
+        return static_cast< unsigned >( index );
+#else
+        return static_cast< unsigned >( __builtin_ctzll( value ) );
+#endif
+    }
+
+    std::uint64_t RoundUp( std::uint64_t value, std::uint64_t alignment )
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+TLSFAllocator::TLSFAllocator( std::uint64_t aSize )
+    : size( aSize & ~(Granularity - 1) )
+{
+    for (unsigned firstLevel = 0; firstLevel < FirstLevelCount; ++firstLevel)
+    {
+        for (unsigned secondLevel = 0; secondLevel < SecondLevelCount; ++secondLevel)
+        {
+            freeLists[ firstLevel ][ secondLevel ] = NullRange;
+        }
+    }
+
+    if (size > 0)
+    {
+        const unsigned range = NewRange();
+        ranges[ range ].size = size;
+        InsertFreeRange( range );
+        freeSize = size;
+    }
+}
+
+void TLSFAllocator::GetSizeClass( std::uint64_t rangeSize, unsigned& outFirstLevel, unsigned& outSecondLevel )
+{
+    outFirstLevel = FloorLog2( rangeSize );
+    outSecondLevel = static_cast< unsigned >( rangeSize >> (outFirstLevel - SecondLevelBits) ) & (SecondLevelCount - 1);
+}
+
+unsigned TLSFAllocator::NewRange()
+{
+    if (unusedRanges != NullRange)
+    {
+        const unsigned range = unusedRanges;
+        unusedRanges = ranges[ range ].nextFree;
+        ranges[ range ] = Range();
+        return range;
+    }
+
+    ranges.emplace_back();
+    return static_cast< unsigned >( ranges.size() - 1 );
+}
+
+void TLSFAllocator::InsertFreeRange( unsigned range )
+{
+    unsigned firstLevel, secondLevel;
+    GetSizeClass( ranges[ range ].size, firstLevel, secondLevel );
+
+    const unsigned head = freeLists[ firstLevel ][ secondLevel ];
+    ranges[ range ].isFree = true;
+    ranges[ range ].prevFree = NullRange;
+    ranges[ range ].nextFree = head;
+
+    if (head != NullRange)
+    {
+        ranges[ head ].prevFree = range;
+    }
+
+    freeLists[ firstLevel ][ secondLevel ] = range;
+    firstLevelBitmap |= 1ull << firstLevel;
+    secondLevelBitmaps[ firstLevel ] |= 1u << secondLevel;
+}
+
+void TLSFAllocator::RemoveFreeRange( unsigned range )
+{
+    unsigned firstLevel, secondLevel;
+    GetSizeClass( ranges[ range ].size, firstLevel, secondLevel );
+
+    const unsigned prev = ranges[ range ].prevFree;
+    const unsigned next = ranges[ range ].nextFree;
+
+    if (prev != NullRange)
+    {
+        ranges[ prev ].nextFree = next;
+    }
+    else
+    {
+        freeLists[ firstLevel ][ secondLevel ] = next;
+    }
+
+    if (next != NullRange)
+    {
+        ranges[ next ].prevFree = prev;
+    }
+
+    if (freeLists[ firstLevel ][ secondLevel ] == NullRange)
+    {
+        secondLevelBitmaps[ firstLevel ] &= ~(1u << secondLevel);
+
+        if (secondLevelBitmaps[ firstLevel ] == 0)
+        {
+            firstLevelBitmap &= ~(1ull << firstLevel);
+        }
+    }
+
+    ranges[ range ].isFree = false;
+    ranges[ range ].prevFree = NullRange;
+    ranges[ range ].nextFree = NullRange;
+}
+
+unsigned TLSFAllocator::FindFreeRange( std::uint64_t rangeSize ) const
+{
+    unsigned exactFirstLevel, exactSecondLevel;
+    GetSizeClass( rangeSize, exactFirstLevel, exactSecondLevel );
+
+    // Ranges in rangeSize's class can be smaller than rangeSize, so the search starts from the next class unless rangeSize is the class's lower bound.
+    unsigned firstLevel, secondLevel;
+    GetSizeClass( rangeSize + (1ull << (exactFirstLevel - SecondLevelBits)) - 1, firstLevel, secondLevel );
+
+    std::uint64_t secondLevelBitmap = secondLevelBitmaps[ firstLevel ] & (~0u << secondLevel);
+
+    if (secondLevelBitmap == 0)
+    {
+        const std::uint64_t firstLevelBitmapAbove = firstLevel + 1 < FirstLevelCount ? firstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+
+        if (firstLevelBitmapAbove != 0)
+        {
+            firstLevel = LowestBit( firstLevelBitmapAbove );
+            secondLevelBitmap = secondLevelBitmaps[ firstLevel ];
+        }
+    }
+
+    if (secondLevelBitmap != 0)
+    {
+        return freeLists[ firstLevel ][ LowestBit( secondLevelBitmap ) ];
+    }
+
+    // Larger classes are empty, but rangeSize's own class can still have a range that fits.
+    for (unsigned range = freeLists[ exactFirstLevel ][ exactSecondLevel ]; range != NullRange; range = ranges[ range ].nextFree)
+    {
+        if (ranges[ range ].size >= rangeSize)
+        {
+            return range;
+        }
+    }
+
+    return NullRange;
+}
+
+unsigned TLSFAllocator::SplitEnd( unsigned range, std::uint64_t rangeSize )
+{
+    const unsigned tail = NewRange();
+    const unsigned next = ranges[ range ].nextPhysical;
+
+    ranges[ tail ].offset = ranges[ range ].offset + rangeSize;
+    ranges[ tail ].size = ranges[ range ].size - rangeSize;
+    ranges[ tail ].prevPhysical = range;
+    ranges[ tail ].nextPhysical = next;
+
+    if (next != NullRange)
+    {
+        ranges[ next ].prevPhysical = tail;
+    }
+
+    ranges[ range ].nextPhysical = tail;
+    ranges[ range ].size = rangeSize;
+
+    return tail;
+}
+
+void TLSFAllocator::MergeWithNext( unsigned range )
+{
+    const unsigned next = ranges[ range ].nextPhysical;
+    const unsigned nextOfNext = ranges[ next ].nextPhysical;
+
+    ranges[ range ].size += ranges[ next ].size;
+    ranges[ range ].nextPhysical = nextOfNext;
+
+    if (nextOfNext != NullRange)
+    {
+        ranges[ nextOfNext ].prevPhysical = range;
+    }
+
+    ranges[ next ] = Range();
+    ranges[ next ].nextFree = unusedRanges;
+    unusedRanges = next;
+}
+
+unsigned TLSFAllocator::Allocate( std::uint64_t rangeSize, std::uint64_t alignment, std::uint64_t& outOffset )
+{
+    System::Assert( alignment > 0 && (alignment & (alignment - 1)) == 0, "alignment must be a power of two" );
+
+    rangeSize = RoundUp( rangeSize > 0 ? rangeSize : 1, Granularity );
+    alignment = alignment > Granularity ? alignment : Granularity;
+
+    // Offsets are multiples of Granularity, so aligning skips at most alignment - Granularity bytes.
+    unsigned range = FindFreeRange( rangeSize + alignment - Granularity );
+
+    if (range == NullRange)
+    {
+        return InvalidAllocation;
+    }
+
+    RemoveFreeRange( range );
+
+    const std::uint64_t padding = RoundUp( ranges[ range ].offset, alignment ) - ranges[ range ].offset;
+
+    if (padding > 0)
+    {
+        const unsigned aligned = SplitEnd( range, padding );
+        InsertFreeRange( range );
+        range = aligned;
+    }
+
+    if (ranges[ range ].size - rangeSize >= Granularity)
+    {
+        InsertFreeRange( SplitEnd( range, rangeSize ) );
+    }
+
+    freeSize -= ranges[ range ].size;
+    outOffset = ranges[ range ].offset;
+    return range;
+}
+
+void TLSFAllocator::Free( unsigned allocation )
+{
+    System::Assert( allocation < ranges.size() && !ranges[ allocation ].isFree && ranges[ allocation ].size > 0, "invalid allocation" );
+
+    unsigned range = allocation;
+    freeSize += ranges[ range ].size;
+
+    const unsigned next = ranges[ range ].nextPhysical;
+
+    if (next != NullRange && ranges[ next ].isFree)
+    {
+        RemoveFreeRange( next );
+        MergeWithNext( range );
+    }
+
+    const unsigned prev = ranges[ range ].prevPhysical;
+
+    if (prev != NullRange && ranges[ prev ].isFree)
+    {
+        RemoveFreeRange( prev );
+        MergeWithNext( prev );
+        range = prev;
+    }
+
+    InsertFreeRange( range );
+}
+
+std::uint64_t TLSFAllocator::GetLargestFreeSize() const
+{
+    if (firstLevelBitmap == 0)
+    {
+        return 0;
+    }
+
+    const unsigned firstLevel = FloorLog2( firstLevelBitmap );
+    const unsigned secondLevel = FloorLog2( secondLevelBitmaps[ firstLevel ] );
+    std::uint64_t largestSize = 0;
+
+    for (unsigned range = freeLists[ firstLevel ][ secondLevel ]; range != NullRange; range = ranges[ range ].nextFree)
+    {
+        largestSize = ranges[ range ].size > largestSize ? ranges[ range ].size : largestSize;
+    }
+
+    return largestSize;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace ae3d
+{
+    /// Two-level segregated fit allocator of ranges in a block that it doesn't access itself, like a Vulkan device memory block.
+    /// Free ranges are kept in lists by size class, and bitmaps find the first non-empty list that fits, so Allocate and Free don't depend on the range count.
+    class TLSFAllocator
+    {
+    public:
+        /// Returned by Allocate when no free range fits.
+        static const unsigned InvalidAllocation = ~0u;
+        /// Sizes and offsets are multiples of this.
+        static const std::uint64_t Granularity = 256;
+
+        /// \param aSize Size of the managed block in bytes.
+        explicit TLSFAllocator( std::uint64_t aSize );
+
+        /// \param rangeSize Size in bytes.
+        /// \param alignment Alignment of the offset. Must be a power of two.
+        /// \param outOffset Receives the offset of the range.
+        /// \return Allocation that is given to Free, or InvalidAllocation if no free range fits.
+        unsigned Allocate( std::uint64_t rangeSize, std::uint64_t alignment, std::uint64_t& outOffset );
+
+        /// Frees a range and merges it with its free neighbours.
+        /// \param allocation Allocation returned by Allocate.
+        void Free( unsigned allocation );
+
+        /// \return Size of the managed block in bytes.
+        std::uint64_t GetSize() const { return size; }
+
+        /// \return Free bytes.
+        std::uint64_t GetFreeSize() const { return freeSize; }
+
+        /// \return Size of the largest free range. Fragmentation is 1 - GetLargestFreeSize() / GetFreeSize().
+        std::uint64_t GetLargestFreeSize() const;
+
+    private:
+        static const unsigned SecondLevelBits = 4;
+        static const unsigned SecondLevelCount = 1 << SecondLevelBits;
+        static const unsigned FirstLevelCount = 64;
+        static const unsigned NullRange = ~0u;
+
+        /// Free or allocated range. Ranges are linked in offset order, and free ranges are also linked in their size class's list.
+        struct Range
+        {
+            std::uint64_t offset = 0;
+            std::uint64_t size = 0;
+            unsigned prevPhysical = NullRange;
+            unsigned nextPhysical = NullRange;
+            /// Unused entries of ranges are linked through nextFree.
+            unsigned prevFree = NullRange;
+            unsigned nextFree = NullRange;
+            bool isFree = false;
+        };
+
+        /// \param rangeSize Size. At least Granularity.
+        /// \param outFirstLevel Receives the power of two below rangeSize.
+        /// \param outSecondLevel Receives the linear subdivision of [2^outFirstLevel, 2^(outFirstLevel + 1)) that rangeSize is in.
+        static void GetSizeClass( std::uint64_t rangeSize, unsigned& outFirstLevel, unsigned& outSecondLevel );
+
+        /// \return Unused entry of ranges.
+        unsigned NewRange();
+        void InsertFreeRange( unsigned range );
+        void RemoveFreeRange( unsigned range );
+        /// \return Free range of at least rangeSize bytes, or NullRange.
+        unsigned FindFreeRange( std::uint64_t rangeSize ) const;
+        /// Splits range after its first rangeSize bytes.
+        /// \return New range after range's first rangeSize bytes. It's not in a free list.
+        unsigned SplitEnd( unsigned range, std::uint64_t rangeSize );
+        /// Merges range with the range after it and makes the range after it unused.
+        void MergeWithNext( unsigned range );
+
+        std::vector< Range > ranges;
+        unsigned unusedRanges = NullRange;
+        unsigned freeLists[ FirstLevelCount ][ SecondLevelCount ];
+        /// Bit n is set if second level bitmap n is not empty.
+        std::uint64_t firstLevelBitmap = 0;
+        /// Bit n of bitmap m is set if freeLists[ m ][ n ] is not empty.
+        std::uint32_t secondLevelBitmaps[ FirstLevelCount ] = {};
+        std::uint64_t size = 0;
+        std::uint64_t freeSize = 0;
+    };
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Matrix.hpp"
+#include "Quaternion.hpp"
+#include "Vec3.hpp"
+
+namespace ae3d
+{
+    /// Structure-of-arrays data of TransformChunk::Size consecutive transform handles.
+    /// Chunks never move, so references into them stay valid when transforms are added.
+    struct TransformChunk
+    {
+        static const unsigned Size = 256;
+
+        Matrix44 localMatrices[ Size ];
+        Matrix44 localToWorldMatrices[ Size ];
+        Quaternion localRotations[ Size ];
+        Quaternion globalRotations[ Size ];
+        Vec3 localPositions[ Size ];
+        Vec3 globalPositions[ Size ];
+        float localScales[ Size ];
+        int parents[ Size ];
+        /// Local TRS or parent has changed since the last update. Flags are bytes so that threads can write neighbours.
+        unsigned char isLocalDirty[ Size ];
+        /// World matrix was recomputed in the last update, so children must be recomputed too.
+        unsigned char hasWorldChanged[ Size ];
+        /// Number of the UpdateLocalMatrices call that last recomputed the world matrix.
+        unsigned worldVersions[ Size ];
+    };
+
+    /// Chunked structure-of-arrays transform data. All accessors take a transform component handle.
+    struct TransformArrays
+    {
+        /// Chunk c holds handles c * TransformChunk::Size .. (c + 1) * TransformChunk::Size - 1.
+        TransformChunk* const* chunks;
+
+        Vec3& LocalPosition( unsigned index ) const { return Chunk( index ).localPositions[ index % TransformChunk::Size ]; }
+        Quaternion& LocalRotation( unsigned index ) const { return Chunk( index ).localRotations[ index % TransformChunk::Size ]; }
+        float& LocalScale( unsigned index ) const { return Chunk( index ).localScales[ index % TransformChunk::Size ]; }
+        int& Parent( unsigned index ) const { return Chunk( index ).parents[ index % TransformChunk::Size ]; }
+        Matrix44& LocalMatrix( unsigned index ) const { return Chunk( index ).localMatrices[ index % TransformChunk::Size ]; }
+        Matrix44& LocalToWorldMatrix( unsigned index ) const { return Chunk( index ).localToWorldMatrices[ index % TransformChunk::Size ]; }
+        Quaternion& GlobalRotation( unsigned index ) const { return Chunk( index ).globalRotations[ index % TransformChunk::Size ]; }
+        Vec3& GlobalPosition( unsigned index ) const { return Chunk( index ).globalPositions[ index % TransformChunk::Size ]; }
+        unsigned char& IsLocalDirty( unsigned index ) const { return Chunk( index ).isLocalDirty[ index % TransformChunk::Size ]; }
+        unsigned char& HasWorldChanged( unsigned index ) const { return Chunk( index ).hasWorldChanged[ index % TransformChunk::Size ]; }
+        unsigned& WorldVersion( unsigned index ) const { return Chunk( index ).worldVersions[ index % TransformChunk::Size ]; }
+
+    private:
+        TransformChunk& Chunk( unsigned index ) const { return *chunks[ index / TransformChunk::Size ]; }
+    };
+
+    /// Builds local TRS matrices of 4 transforms, multiplies them by their parent's local-to-world matrix and updates world rotations and positions.
+    /// Parents must be up-to-date and must not be in the same batch. An index can be repeated to fill the batch.
+    /// Implemented in TransformKernelSSE3.cpp, TransformKernelNEON.cpp or TransformKernel.cpp depending on the target.
+    void UpdateWorldMatrices4( const TransformArrays& arrays, const unsigned indices[ 4 ] );
+}
@@ -0,0 +1,152 @@
+#if RENDERER_METAL && !(__i386__)
+#include "TransformKernel.hpp"
+#include <arm_neon.h>
+
+static_assert( sizeof( ae3d::Quaternion ) == 4 * sizeof( float ), "Quaternion must be tightly packed for 4-wide loads" );
+
+namespace
+{
+    const ae3d::Quaternion identityRotation;
+
+    // Loads 4 quaternions and transposes them so that each register holds one component of all 4.
+    float32x4x4_t LoadTransposed( const ae3d::Quaternion* quaternions[ 4 ] )
+    {
+        const float32x4x2_t row01 = vtrnq_f32( vld1q_f32( &quaternions[ 0 ]->x ), vld1q_f32( &quaternions[ 1 ]->x ) );
+        const float32x4x2_t row23 = vtrnq_f32( vld1q_f32( &quaternions[ 2 ]->x ), vld1q_f32( &quaternions[ 3 ]->x ) );
+
+        float32x4x4_t out;
+        out.val[ 0 ] = vcombine_f32( vget_low_f32( row01.val[ 0 ] ), vget_low_f32( row23.val[ 0 ] ) );
+        out.val[ 1 ] = vcombine_f32( vget_low_f32( row01.val[ 1 ] ), vget_low_f32( row23.val[ 1 ] ) );
+        out.val[ 2 ] = vcombine_f32( vget_high_f32( row01.val[ 0 ] ), vget_high_f32( row23.val[ 0 ] ) );
+        out.val[ 3 ] = vcombine_f32( vget_high_f32( row01.val[ 1 ] ), vget_high_f32( row23.val[ 1 ] ) );
+        return out;
+    }
+
+    // W = L * P, where L's last column is ( 0, 0, 0, 1 ).
+    void MultiplyByParent( const float* local, const ae3d::Matrix44& parent, float* outWorld )
+    {
+        const float32x4_t parentRow0 = vld1q_f32( &parent.m[ 0 ] );
+        const float32x4_t parentRow1 = vld1q_f32( &parent.m[ 4 ] );
+        const float32x4_t parentRow2 = vld1q_f32( &parent.m[ 8 ] );
+        const float32x4_t parentRow3 = vld1q_f32( &parent.m[ 12 ] );
+
+        for (int row = 0; row < 4; ++row)
+        {
+            float32x4_t result = vmulq_n_f32( parentRow0, local[ row * 4 + 0 ] );
+            result = vmlaq_n_f32( result, parentRow1, local[ row * 4 + 1 ] );
+            result = vmlaq_n_f32( result, parentRow2, local[ row * 4 + 2 ] );
+
+            if (row == 3)
+            {
+                result = vaddq_f32( result, parentRow3 );
+            }
+
+            vst1q_f32( &outWorld[ row * 4 ], result );
+        }
+    }
+}
+
+void ae3d::UpdateWorldMatrices4( const TransformArrays& arrays, const unsigned indices[ 4 ] )
+{
+    const Quaternion* localRotations[ 4 ] = { &arrays.LocalRotation( indices[ 0 ] ), &arrays.LocalRotation( indices[ 1 ] ),
+                                               &arrays.LocalRotation( indices[ 2 ] ), &arrays.LocalRotation( indices[ 3 ] ) };
+    const float32x4x4_t q = LoadTransposed( localRotations );
+    const float32x4_t qx = q.val[ 0 ];
+    const float32x4_t qy = q.val[ 1 ];
+    const float32x4_t qz = q.val[ 2 ];
+    const float32x4_t qw = q.val[ 3 ];
+
+    float scaleLanes[ 4 ];
+
+    for (int lane = 0; lane < 4; ++lane)
+    {
+        scaleLanes[ lane ] = arrays.LocalScale( indices[ lane ] );
+    }
+
+    // Same as Quaternion::GetMatrix followed by Matrix44::Scale.
+    const float32x4_t scale = vld1q_f32( scaleLanes );
+    const float32x4_t one = vdupq_n_f32( 1 );
+    const float32x4_t x2 = vmulq_f32( qx, qx );
+    const float32x4_t y2 = vmulq_f32( qy, qy );
+    const float32x4_t z2 = vmulq_f32( qz, qz );
+    const float32x4_t xy = vmulq_f32( qx, qy );
+    const float32x4_t xz = vmulq_f32( qx, qz );
+    const float32x4_t yz = vmulq_f32( qy, qz );
+    const float32x4_t wx = vmulq_f32( qw, qx );
+    const float32x4_t wy = vmulq_f32( qw, qy );
+    const float32x4_t wz = vmulq_f32( qw, qz );
+
+    float32x4_t basis[ 3 ][ 3 ];
+    basis[ 0 ][ 0 ] = vmulq_f32( vmlsq_n_f32( one, vaddq_f32( y2, z2 ), 2 ), scale );
+    basis[ 0 ][ 1 ] = vmulq_f32( vmulq_n_f32( vsubq_f32( xy, wz ), 2 ), scale );
+    basis[ 0 ][ 2 ] = vmulq_f32( vmulq_n_f32( vaddq_f32( xz, wy ), 2 ), scale );
+    basis[ 1 ][ 0 ] = vmulq_f32( vmulq_n_f32( vaddq_f32( xy, wz ), 2 ), scale );
+    basis[ 1 ][ 1 ] = vmulq_f32( vmlsq_n_f32( one, vaddq_f32( x2, z2 ), 2 ), scale );
+    basis[ 1 ][ 2 ] = vmulq_f32( vmulq_n_f32( vsubq_f32( yz, wx ), 2 ), scale );
+    basis[ 2 ][ 0 ] = vmulq_f32( vmulq_n_f32( vsubq_f32( xz, wy ), 2 ), scale );
+    basis[ 2 ][ 1 ] = vmulq_f32( vmulq_n_f32( vaddq_f32( yz, wx ), 2 ), scale );
+    basis[ 2 ][ 2 ] = vmulq_f32( vmlsq_n_f32( one, vaddq_f32( x2, y2 ), 2 ), scale );
+
+    float basisLanes[ 3 ][ 3 ][ 4 ];
+
+    for (int row = 0; row < 3; ++row)
+    {
+        for (int column = 0; column < 3; ++column)
+        {
+            vst1q_f32( basisLanes[ row ][ column ], basis[ row ][ column ] );
+        }
+    }
+
+    const Quaternion* parentRotations[ 4 ];
+
+    for (int lane = 0; lane < 4; ++lane)
+    {
+        const unsigned index = indices[ lane ];
+        const int parent = arrays.Parent( index );
+        const Vec3& position = arrays.LocalPosition( index );
+        float* local = arrays.LocalMatrix( index ).m;
+
+        for (int row = 0; row < 3; ++row)
+        {
+            local[ row * 4 + 0 ] = basisLanes[ row ][ 0 ][ lane ];
+            local[ row * 4 + 1 ] = basisLanes[ row ][ 1 ][ lane ];
+            local[ row * 4 + 2 ] = basisLanes[ row ][ 2 ][ lane ];
+            local[ row * 4 + 3 ] = 0;
+        }
+
+        local[ 12 ] = position.x;
+        local[ 13 ] = position.y;
+        local[ 14 ] = position.z;
+        local[ 15 ] = 1;
+
+        const Matrix44& parentMatrix = parent == -1 ? Matrix44::identity : arrays.LocalToWorldMatrix( parent );
+        float* world = arrays.LocalToWorldMatrix( index ).m;
+
+        MultiplyByParent( local, parentMatrix, world );
+        arrays.GlobalPosition( index ) = Vec3( world[ 12 ], world[ 13 ], world[ 14 ] );
+        parentRotations[ lane ] = parent == -1 ? &identityRotation : &arrays.GlobalRotation( parent );
+    }
+
+    // Same as Quaternion::operator*: globalRotation = localRotation * parentGlobalRotation.
+    const float32x4x4_t a = LoadTransposed( parentRotations );
+    const float32x4_t ax = a.val[ 0 ];
+    const float32x4_t ay = a.val[ 1 ];
+    const float32x4_t az = a.val[ 2 ];
+    const float32x4_t aw = a.val[ 3 ];
+
+    float32x4x4_t global;
+    global.val[ 0 ] = vmlsq_f32( vmlaq_f32( vmlaq_f32( vmulq_f32( qw, ax ), qx, aw ), qy, az ), qz, ay );
+    global.val[ 1 ] = vmlsq_f32( vmlaq_f32( vmlaq_f32( vmulq_f32( qw, ay ), qy, aw ), qz, ax ), qx, az );
+    global.val[ 2 ] = vmlsq_f32( vmlaq_f32( vmlaq_f32( vmulq_f32( qw, az ), qz, aw ), qx, ay ), qy, ax );
+    global.val[ 3 ] = vmlsq_f32( vmlsq_f32( vmlsq_f32( vmulq_f32( qw, aw ), qx, ax ), qy, ay ), qz, az );
+
+    // vst4q interleaves the component registers back into x, y, z, w order.
+    float globalLanes[ 16 ];
+    vst4q_f32( globalLanes, global );
+
+    for (int lane = 0; lane < 4; ++lane)
+    {
+        arrays.GlobalRotation( indices[ lane ] ) = Quaternion( Vec3( globalLanes[ lane * 4 + 0 ], globalLanes[ lane * 4 + 1 ], globalLanes[ lane * 4 + 2 ] ), globalLanes[ lane * 4 + 3 ] );
+    }
+}
+#endif
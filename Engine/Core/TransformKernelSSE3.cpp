@@ -0,0 +1,127 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#ifdef SIMD_SSE3
+#include "TransformKernel.hpp"
+#include <pmmintrin.h>
+
+static_assert( sizeof( ae3d::Quaternion ) == 4 * sizeof( float ), "Quaternion must be tightly packed for 4-wide loads" );
+
+namespace
+{
+    const ae3d::Quaternion identityRotation;
+
+    // W = L * P, where L's last column is ( 0, 0, 0, 1 ).
+    void MultiplyByParent( const float* local, const ae3d::Matrix44& parent, float* outWorld )
+    {
+        const __m128 parentRow0 = _mm_load_ps( &parent.m[ 0 ] );
+        const __m128 parentRow1 = _mm_load_ps( &parent.m[ 4 ] );
+        const __m128 parentRow2 = _mm_load_ps( &parent.m[ 8 ] );
+        const __m128 parentRow3 = _mm_load_ps( &parent.m[ 12 ] );
+
+        for (int row = 0; row < 4; ++row)
+        {
+            __m128 result = _mm_mul_ps( _mm_set1_ps( local[ row * 4 + 0 ] ), parentRow0 );
+            result = _mm_add_ps( result, _mm_mul_ps( _mm_set1_ps( local[ row * 4 + 1 ] ), parentRow1 ) );
+            result = _mm_add_ps( result, _mm_mul_ps( _mm_set1_ps( local[ row * 4 + 2 ] ), parentRow2 ) );
+
+            if (row == 3)
+            {
+                result = _mm_add_ps( result, parentRow3 );
+            }
+
+            _mm_store_ps( &outWorld[ row * 4 ], result );
+        }
+    }
+}
+
+void ae3d::UpdateWorldMatrices4( const TransformArrays& arrays, const unsigned indices[ 4 ] )
+{
+    // Each register holds one component of all 4 transforms.
+    __m128 qx = _mm_loadu_ps( &arrays.LocalRotation( indices[ 0 ] ).x );
+    __m128 qy = _mm_loadu_ps( &arrays.LocalRotation( indices[ 1 ] ).x );
+    __m128 qz = _mm_loadu_ps( &arrays.LocalRotation( indices[ 2 ] ).x );
+    __m128 qw = _mm_loadu_ps( &arrays.LocalRotation( indices[ 3 ] ).x );
+    _MM_TRANSPOSE4_PS( qx, qy, qz, qw );
+
+    const Vec3* positions[ 4 ] = { &arrays.LocalPosition( indices[ 0 ] ), &arrays.LocalPosition( indices[ 1 ] ),
+                                   &arrays.LocalPosition( indices[ 2 ] ), &arrays.LocalPosition( indices[ 3 ] ) };
+    const __m128 px = _mm_set_ps( positions[ 3 ]->x, positions[ 2 ]->x, positions[ 1 ]->x, positions[ 0 ]->x );
+    const __m128 py = _mm_set_ps( positions[ 3 ]->y, positions[ 2 ]->y, positions[ 1 ]->y, positions[ 0 ]->y );
+    const __m128 pz = _mm_set_ps( positions[ 3 ]->z, positions[ 2 ]->z, positions[ 1 ]->z, positions[ 0 ]->z );
+    const __m128 scale = _mm_set_ps( arrays.LocalScale( indices[ 3 ] ), arrays.LocalScale( indices[ 2 ] ), arrays.LocalScale( indices[ 1 ] ), arrays.LocalScale( indices[ 0 ] ) );
+
+    // Same as Quaternion::GetMatrix followed by Matrix44::Scale and Matrix44::SetTranslation.
+    const __m128 one = _mm_set1_ps( 1 );
+    const __m128 two = _mm_set1_ps( 2 );
+    const __m128 x2 = _mm_mul_ps( qx, qx );
+    const __m128 y2 = _mm_mul_ps( qy, qy );
+    const __m128 z2 = _mm_mul_ps( qz, qz );
+    const __m128 xy = _mm_mul_ps( qx, qy );
+    const __m128 xz = _mm_mul_ps( qx, qz );
+    const __m128 yz = _mm_mul_ps( qy, qz );
+    const __m128 wx = _mm_mul_ps( qw, qx );
+    const __m128 wy = _mm_mul_ps( qw, qy );
+    const __m128 wz = _mm_mul_ps( qw, qz );
+
+    __m128 rows[ 4 ][ 4 ];
+    rows[ 0 ][ 0 ] = _mm_mul_ps( _mm_sub_ps( one, _mm_mul_ps( two, _mm_add_ps( y2, z2 ) ) ), scale );
+    rows[ 0 ][ 1 ] = _mm_mul_ps( _mm_mul_ps( two, _mm_sub_ps( xy, wz ) ), scale );
+    rows[ 0 ][ 2 ] = _mm_mul_ps( _mm_mul_ps( two, _mm_add_ps( xz, wy ) ), scale );
+    rows[ 0 ][ 3 ] = _mm_setzero_ps();
+    rows[ 1 ][ 0 ] = _mm_mul_ps( _mm_mul_ps( two, _mm_add_ps( xy, wz ) ), scale );
+    rows[ 1 ][ 1 ] = _mm_mul_ps( _mm_sub_ps( one, _mm_mul_ps( two, _mm_add_ps( x2, z2 ) ) ), scale );
+    rows[ 1 ][ 2 ] = _mm_mul_ps( _mm_mul_ps( two, _mm_sub_ps( yz, wx ) ), scale );
+    rows[ 1 ][ 3 ] = _mm_setzero_ps();
+    rows[ 2 ][ 0 ] = _mm_mul_ps( _mm_mul_ps( two, _mm_sub_ps( xz, wy ) ), scale );
+    rows[ 2 ][ 1 ] = _mm_mul_ps( _mm_mul_ps( two, _mm_add_ps( yz, wx ) ), scale );
+    rows[ 2 ][ 2 ] = _mm_mul_ps( _mm_sub_ps( one, _mm_mul_ps( two, _mm_add_ps( x2, y2 ) ) ), scale );
+    rows[ 2 ][ 3 ] = _mm_setzero_ps();
+    rows[ 3 ][ 0 ] = px;
+    rows[ 3 ][ 1 ] = py;
+    rows[ 3 ][ 2 ] = pz;
+    rows[ 3 ][ 3 ] = one;
+
+    // Transposes each row back to one register per transform and stores it.
+    for (int row = 0; row < 4; ++row)
+    {
+        _MM_TRANSPOSE4_PS( rows[ row ][ 0 ], rows[ row ][ 1 ], rows[ row ][ 2 ], rows[ row ][ 3 ] );
+
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            _mm_store_ps( &arrays.LocalMatrix( indices[ lane ] ).m[ row * 4 ], rows[ row ][ lane ] );
+        }
+    }
+
+    const Quaternion* parentRotations[ 4 ];
+
+    for (int lane = 0; lane < 4; ++lane)
+    {
+        const unsigned index = indices[ lane ];
+        const int parent = arrays.Parent( index );
+        const Matrix44& parentMatrix = parent == -1 ? Matrix44::identity : arrays.LocalToWorldMatrix( parent );
+        float* world = arrays.LocalToWorldMatrix( index ).m;
+
+        MultiplyByParent( arrays.LocalMatrix( index ).m, parentMatrix, world );
+        arrays.GlobalPosition( index ) = Vec3( world[ 12 ], world[ 13 ], world[ 14 ] );
+        parentRotations[ lane ] = parent == -1 ? &identityRotation : &arrays.GlobalRotation( parent );
+    }
+
+    // Same as Quaternion::operator*: globalRotation = localRotation * parentGlobalRotation.
+    __m128 ax = _mm_loadu_ps( &parentRotations[ 0 ]->x );
+    __m128 ay = _mm_loadu_ps( &parentRotations[ 1 ]->x );
+    __m128 az = _mm_loadu_ps( &parentRotations[ 2 ]->x );
+    __m128 aw = _mm_loadu_ps( &parentRotations[ 3 ]->x );
+    _MM_TRANSPOSE4_PS( ax, ay, az, aw );
+
+    __m128 gx = _mm_sub_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( qw, ax ), _mm_mul_ps( qx, aw ) ), _mm_mul_ps( qy, az ) ), _mm_mul_ps( qz, ay ) );
+    __m128 gy = _mm_sub_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( qw, ay ), _mm_mul_ps( qy, aw ) ), _mm_mul_ps( qz, ax ) ), _mm_mul_ps( qx, az ) );
+    __m128 gz = _mm_sub_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( qw, az ), _mm_mul_ps( qz, aw ) ), _mm_mul_ps( qx, ay ) ), _mm_mul_ps( qy, ax ) );
+    __m128 gw = _mm_sub_ps( _mm_sub_ps( _mm_sub_ps( _mm_mul_ps( qw, aw ), _mm_mul_ps( qx, ax ) ), _mm_mul_ps( qy, ay ) ), _mm_mul_ps( qz, az ) );
+    _MM_TRANSPOSE4_PS( gx, gy, gz, gw );
+
+    _mm_storeu_ps( &arrays.GlobalRotation( indices[ 0 ] ).x, gx );
+    _mm_storeu_ps( &arrays.GlobalRotation( indices[ 1 ] ).x, gy );
+    _mm_storeu_ps( &arrays.GlobalRotation( indices[ 2 ] ).x, gz );
+    _mm_storeu_ps( &arrays.GlobalRotation( indices[ 3 ] ).x, gw );
+}
+#endif
@@ -37,13 +37,16 @@ namespace ae3d
         friend class GameObject;
         
         /// \return Component's type code. Must be unique for each component type.
-        static int Type() { return 3; }
+        static constexpr int Type() { return 3; }
         
         /// \return Component handle that uniquely identifies the instance.
         static unsigned New();
         
         /// \return Component at index or null if index is invalid.
         static AudioSourceComponent* Get( unsigned index );
+
+        /// Resets the component at index and lets New return the index again.
+        static void Release( unsigned index );
         
         GameObject* gameObject = nullptr;
         unsigned clipId = 0;
@@ -79,6 +79,12 @@ namespace ae3d
         /// \return Depth and normals texture.
         RenderTexture& GetDepthNormalsTexture() { return depthNormalsTexture; }
 
+        /// Renders depth and normals for light culling into a texture that only lives until light culling and shares memory with other cameras'
+        /// transient depth and normals of the same size. Ignored if GetDepthNormalsTexture() has been created, because materials can sample it.
+        /// \param width Width. 0 disables transient depth and normals, which is the default.
+        /// \param height Height.
+        void SetTransientDepthNormalsSize( int width, int height ) { transientDepthNormalsWidth = width; transientDepthNormalsHeight = height; }
+
         /// \param color Color in range 0-1.
         void SetClearColor( const Vec3& color );
 
@@ -145,7 +151,7 @@ namespace ae3d
         friend class Scene;
 
         /// \return Component's type code. Must be unique for each component type.
-        static int Type() { return 0; }
+        static constexpr int Type() { return 0; }
         
         /// \return Component handle that uniquely identifies the instance.
         static unsigned New();
@@ -153,11 +159,16 @@ namespace ae3d
         /// \return Component at index or null if index is invalid.
         static CameraComponent* Get( unsigned index );
 
+        /// Resets the component at index and lets New return the index again.
+        static void Release( unsigned index );
+
         Matrix44 viewToClip;
         Matrix44 worldToView;
         Vec3 clearColor;
         RenderTexture* targetTexture = nullptr;
         RenderTexture depthNormalsTexture;
+        int transientDepthNormalsWidth = 0;
+        int transientDepthNormalsHeight = 0;
 
         struct OrthoParams
         {
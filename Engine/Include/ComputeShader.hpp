@@ -93,7 +93,6 @@ namespace ae3d
         void SetRenderTexture( unsigned slot, class RenderTexture* renderTexture );
         
 #if RENDERER_D3D12
-        void SetCBV( unsigned slot, ID3D12Resource* buffer );
         void SetSRV( unsigned slot, ID3D12Resource* buffer, const D3D12_SHADER_RESOURCE_VIEW_DESC& srvDesc );
         void SetUAV( unsigned slot, ID3D12Resource* buffer, const D3D12_UNORDERED_ACCESS_VIEW_DESC& uavDesc );
         ID3DBlob* blobShader = nullptr;
@@ -116,7 +115,6 @@ namespace ae3d
 #endif
         RenderTexture* renderTextures[ SLOT_COUNT ];
 #if RENDERER_D3D12
-        ID3D12Resource* uniformBuffers[ SLOT_COUNT ];
         ID3D12Resource* textureBuffers[ SLOT_COUNT ];
         ID3D12Resource* uavBuffers[ SLOT_COUNT ];
         D3D12_SHADER_RESOURCE_VIEW_DESC srvDescs[ SLOT_COUNT ];
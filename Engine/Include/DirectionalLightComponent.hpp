@@ -41,7 +41,7 @@ namespace ae3d
         friend class Scene;
 
         /// \return Component's type code. Must be unique for each component type.
-        static int Type() { return 6; }
+        static constexpr int Type() { return 6; }
 
         /// \return Component handle that uniquely identifies the instance.
         static unsigned New();
@@ -49,6 +49,9 @@ namespace ae3d
         /// \return Component at index or null if index is invalid.
         static DirectionalLightComponent* Get( unsigned index );
 
+        /// Resets the component at index and lets New return the index again.
+        static void Release( unsigned index );
+
         RenderTexture shadowMap;
         GameObject* gameObject = nullptr;
         bool castsShadow = false;
@@ -11,64 +11,78 @@ namespace ae3d
         /// Invalid component index.
         static const unsigned InvalidComponentIndex = 99999999;
 
-        /// Adds a component into the game object. There can be multiple components of the same type.
+        /// Adds a component into the game object. There can be one component of each type, so adding a type that already exists does nothing.
         template< class T > void AddComponent()
         {
-            const unsigned index = GetNextComponentIndex();
-            
-            if (index != InvalidComponentIndex)
+            if ((componentMask & GetComponentBit< T >()) == 0)
             {
-                components[ index ].handle = T::New();
-                components[ index ].type = T::Type();
+                componentHandles[ T::Type() ] = T::New();
+                componentMask |= GetComponentBit< T >();
                 GetComponent< T >()->gameObject = this;
+                OnHierarchyChanged();
             }            
         }
 
-        /// Remove a component from the game object.
+        /// Removes a component from the game object and returns it to its pool.
         template< class T > void RemoveComponent()
         {
-            for (unsigned i = 0; i < nextFreeComponentIndex; ++i)
+            if ((componentMask & GetComponentBit< T >()) != 0)
             {
-                if (components[ i ].type == T::Type())
-                {
-                    GetComponent< T >()->gameObject = nullptr;
-                    components[ i ].handle = 0;
-                    components[ i ].type = -1;
-                    return;
-                }
+                T::Release( componentHandles[ T::Type() ] );
+                componentHandles[ T::Type() ] = InvalidComponentIndex;
+                componentMask &= ~GetComponentBit< T >();
+                OnHierarchyChanged();
             }
         }
 
-        /// \return The first component of type T or null if there is no such component.
+        /// \return The component of type T or null if there is no such component.
         template< class T > T* GetComponent() const
         {
-            for (const auto& component : components)
-            {
-                if (T::Type() == component.type)
-                {
-                    return T::Get( component.handle );
-                }
-            }
+            return (componentMask & GetComponentBit< T >()) != 0 ? T::Get( componentHandles[ T::Type() ] ) : nullptr;
+        }
 
-            return nullptr;
+        /// \return Bit of component type T in component masks. Combine bits with | to test for several components with HasComponents.
+        template< class T > static unsigned GetComponentBit()
+        {
+            static_assert( T::Type() >= 0 && T::Type() < MaxComponentTypes, "Component type code must be smaller than MaxComponentTypes" );
+            return 1u << T::Type();
         }
 
+        /// \param mask Component bits from GetComponentBit.
+        /// \return True if the game object has all components in mask.
+        bool HasComponents( unsigned mask ) const { return (componentMask & mask) == mask; }
+
+        /// \param mask Component bits from GetComponentBit.
+        /// \return True if the game object has at least one component in mask.
+        bool HasAnyComponent( unsigned mask ) const { return (componentMask & mask) != 0; }
+
         /// Constructor.
-        GameObject() = default;
+        GameObject();
 
         /// Copy constructor.
         GameObject( const GameObject& other );
 
+        /// Move constructor. Takes other's components, so children of its transform stay attached.
+        GameObject( GameObject&& other ) noexcept;
+
+        /// Returns components to their pools.
+        ~GameObject();
+
+        /// Returns this game object's components to their pools and adds copies of go's components.
         /// \param go Other game object.
         GameObject& operator=( const GameObject& go );
 
+        /// Returns this game object's components to their pools and takes go's components.
+        /// \param go Other game object. Has no components afterwards.
+        GameObject& operator=( GameObject&& go ) noexcept;
+
         /// \param aName Game Object's name.
         void SetName( const char* aName ) { name = aName; }
         
         /// \param enabled True if the game object should be rendered, false otherwise.
-        void SetEnabled( bool enabled ) { isEnabled = enabled; }
+        void SetEnabled( bool enabled );
         
-        /// \return True if this game object and all its parents are enabled.
+        /// \return True if this game object and all its parents are enabled. Cached until some game object's enabled flag or hierarchy changes.
         bool IsEnabled() const;
     
         /// \return Game Object's name.
@@ -84,19 +98,30 @@ namespace ae3d
         std::string GetSerialized() const;
 
     private:
-        struct ComponentEntry
-        {
-            int type = -1;
-            unsigned handle = 0;
-        };
+        friend class TransformComponent;
+
+        /// Invalidates cached enabled flags of all game objects.
+        static void OnHierarchyChanged();
+
+        /// Adds a component of type T and copies go's component into it, if go has one.
+        template< class T > void CopyComponent( const GameObject& go );
+
+        /// Takes go's component of type T, if go has one.
+        template< class T > void MoveComponent( GameObject& go );
 
-        unsigned GetNextComponentIndex();
+        /// Removes all components.
+        void RemoveComponents();
 
-        static const int MaxComponents = 10;
-        unsigned nextFreeComponentIndex = 0;
-        ComponentEntry components[ MaxComponents ];
+        /// Component type codes must be smaller than this.
+        static const int MaxComponentTypes = 10;
+        /// Bit n is set if componentHandles[ n ] holds a component whose type code is n.
+        unsigned componentMask = 0;
+        /// Handles of types that aren't in componentMask are InvalidComponentIndex.
+        unsigned componentHandles[ MaxComponentTypes ];
         std::string name;
         unsigned layer = 1;
         bool isEnabled = true;
+        mutable bool cachedIsEnabled = true;
+        mutable unsigned cachedIsEnabledVersion = 0;
     };
 }
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+namespace ae3d
+{
+    /// Runs jobs on worker threads. Each worker owns a job deque and steals from other workers when its own deque is empty.
+    /// Workers are started on first use. The thread that waits for a job also runs queued jobs, so waiting inside a job is fine.
+    namespace JobSystem
+    {
+        /// Tracks unfinished jobs. Jobs that were queued with a counter decrement it when they have run.
+        struct Counter
+        {
+            /// Unfinished job count.
+            std::atomic< int > value{ 0 };
+        };
+
+        /// Starts worker threads. Does nothing if the workers are already running.
+        /// \param workerCount Worker thread count. 0 uses hardware thread count minus one, leaving a core for the calling thread.
+        void Init( int workerCount );
+
+        /// Finishes queued jobs and joins worker threads. Called by System::Deinit.
+        void Deinit();
+
+        /// \return Worker thread count, not counting the calling thread.
+        int GetWorkerCount();
+
+        /// Queues a job.
+        /// \param job Job function.
+        /// \param counter Incremented now and decremented after the job has run. Can be null.
+        /// \param dependency The job doesn't start before this counter reaches zero. Queue the jobs it counts first. Can be null.
+        void Run( const std::function< void() >& job, Counter* counter, Counter* dependency );
+
+        /// Runs queued jobs on the calling thread until counter reaches zero.
+        /// \param counter Counter that was given to Run.
+        void Wait( Counter* counter );
+
+        /// Splits [0, count) into batches of batchSize elements, calls function( begin, end ) for each batch in parallel and returns when all batches have run.
+        /// \param count Element count.
+        /// \param batchSize Elements per job. Small batches balance better but cost more in scheduling.
+        /// \param function Function that processes elements [begin, end).
+        void ParallelFor( unsigned count, unsigned batchSize, const std::function< void( unsigned begin, unsigned end ) >& function );
+    }
+}
@@ -50,6 +50,20 @@ namespace ae3d
         /// \param shader Shader.
         void SetShader( Shader* shader );
 
+        /// \return Instanced variant of the shader, or null if this material's draws are not instanced.
+        Shader* GetInstancedShader() { return instancedShader; }
+
+        /// Identical draws using this material are batched into instanced draws that use this shader.
+        /// \param aShader Variant of the shader that reads each instance's localToWorld from boneMatrices, like Standard_instanced_vert.
+        void SetInstancedShader( Shader* aShader ) { instancedShader = aShader; }
+
+        /// \return GPU-driven variant of the shader, or null if this material's draws are culled and drawn on the CPU.
+        Shader* GetIndirectShader() { return indirectShader; }
+
+        /// Opaque, non-skinned draws using this material are culled in a compute shader and drawn with indirect draws that use this shader. Vulkan only.
+        /// \param aShader Variant of the shader that reads each instance's localToWorld from the indirect culler's buffers, like Standard_indirect_vert.
+        void SetIndirectShader( Shader* aShader ) { indirectShader = aShader; }
+
         /// \param texture Texture.
         /// \param slot Slot index.
         void SetTexture( class Texture2D* texture, int slot );
@@ -73,6 +87,8 @@ namespace ae3d
         TextureCube* texCubeSlots[ TEXTURE_SLOT_COUNT ] = {};
         RenderTexture* rtSlots[ TEXTURE_SLOT_COUNT ] = {};
         Shader* shader = nullptr;
+        Shader* instancedShader = nullptr;
+        Shader* indirectShader = nullptr;
         DepthFunction depthFunction = DepthFunction::LessOrEqualWriteOn;
         BlendingMode blendingMode = BlendingMode::Off;
         float depthFactor = 0;
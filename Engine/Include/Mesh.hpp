@@ -10,6 +10,7 @@ namespace ae3d
         struct FileContentsData;
     }
 
+    struct Matrix44;
     struct SubMesh;
     struct Vec3;
     
@@ -67,6 +68,7 @@ namespace ae3d
         
       private:
         friend class MeshRendererComponent;
+        friend class Scene;
         
         struct Impl;
         Impl& m() { return reinterpret_cast<Impl&>(_storage); }
@@ -78,5 +80,20 @@ namespace ae3d
         std::aligned_storage<StorageSize, StorageAlign>::type _storage = {};
         
         SubMesh* GetSubMeshes( int& outCount );
+
+        /// \param subMeshIndex Submesh index.
+        /// \return True if the submesh has CPU-side vertices and no joints, so it can be merged into a static batch.
+        bool CanBatchSubMesh( unsigned subMeshIndex ) const;
+
+        /// Transforms a submesh of source into world space and appends it to this mesh's only submesh. Static batches are built this way.
+        /// \param source Mesh. Its submesh must pass CanBatchSubMesh.
+        /// \param subMeshIndex Submesh index in source.
+        /// \param localToWorld Local-to-World matrix of source.
+        /// \return False if the vertices wouldn't fit in 16-bit indices, in which case nothing is appended.
+        bool AppendTransformedSubMesh( const Mesh& source, unsigned subMeshIndex, const Matrix44& localToWorld );
+
+        /// Generates the vertex buffer of submeshes appended by AppendTransformedSubMesh.
+        /// \param name Debug name.
+        void GenerateAppended( const char* name );
     };
 }
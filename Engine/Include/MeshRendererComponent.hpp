@@ -17,6 +17,22 @@ namespace ae3d
         /// \param enabled True, if the object casts shadow.
         void SetCastShadow( bool enabled ) { castShadow = enabled; }
 
+        /// \return True, if the mesh hides objects behind it from the occlusion culler.
+        bool IsOccluder() const { return isOccluder; }
+
+        /// Occluders are rasterized into a CPU depth buffer, and objects behind them aren't rendered.
+        /// Use for large, simple meshes like walls. The mesh must have been loaded from a file.
+        /// \param enabled True, if the mesh hides objects behind it from the occlusion culler.
+        void SetOccluder( bool enabled ) { isOccluder = enabled; }
+
+        /// \return True, if the mesh doesn't move and can be merged into a static batch.
+        bool IsStatic() const { return isStatic; }
+
+        /// Scene::BuildStaticBatches merges static meshes that share a material into a few large pre-transformed meshes.
+        /// Static meshes must not move or change after the batches are built. The mesh must have been loaded from a file.
+        /// \param enabled True, if the mesh doesn't move.
+        void SetStatic( bool enabled ) { isStatic = enabled; }
+
         /// \return True, if the component is enabled.
         bool IsEnabled() const { return isEnabled; }
         
@@ -49,26 +65,36 @@ namespace ae3d
     private:
         friend class GameObject;
         friend class Scene;
-        
-        enum class RenderType { Opaque, Transparent };
+        friend void ExecuteCommonCommand( const class CommandStream& stream, const struct RenderCommand& command );
         
         /// \return Component's type code. Must be unique for each component type.
-        static int Type() { return 5; }
+        static constexpr int Type() { return 5; }
         
         /// \return Component handle that uniquely identifies the instance.
         static unsigned New();
         
         /// \return Component at index or null if index is invalid.
         static MeshRendererComponent* Get( unsigned index );
+
+        /// Resets the component at index and lets New return the index again.
+        static void Release( unsigned index );
         
         /// Applies skin
         /// \param subMeshIndex Submesh index
         void ApplySkin( unsigned subMeshIndex );
         
+        /// Culls submeshes. The whole mesh's bounds must already have been tested against the frustum.
         /// \param cameraFrustum cameraFrustum
         /// \param localToWorld Local-to-World matrix
-        void Cull( const class Frustum& cameraFrustum, const struct Matrix44& localToWorld );
+        void CullSubMeshes( const class Frustum& cameraFrustum, const struct Matrix44& localToWorld );
+
+        /// Adds the mesh's triangles to the occlusion culler. Skinned submeshes are skipped.
+        /// \param occlusionCuller Occlusion culler.
+        /// \param localToWorld Local-to-World matrix
+        void AddOccluder( class OcclusionCuller& occlusionCuller, const Matrix44& localToWorld );
         
+        /// Draws a submesh that CullSubMeshes didn't cull. Scene orders the draws of all mesh renderers by sort key.
+        /// \param subMeshIndex Submesh index.
         /// \param localToView Model-view matrix.
         /// \param localToClip Model-view-projection matrix.
         /// \param localToWorld Transforms mesh AABB from mesh-local space into world-space.
@@ -76,19 +102,54 @@ namespace ae3d
         /// \param shadowProjection Shadow camera projection matrix.
         /// \param overrideShader Override shader. Used for shadow pass.
         /// \param overrideSkinShader Override shader for skinned meshes. Used for shadow pass.
-        /// \param renderType Renderer type.
-        void Render( const struct Matrix44& localToView, const Matrix44& localToClip, const Matrix44& localToWorld,
-                     const Matrix44& shadowView, const Matrix44& shadowProjection, class Shader* overrideShader,
-                     Shader* overrideSkinShader, RenderType renderType );
+        void RenderSubMesh( unsigned subMeshIndex, const struct Matrix44& localToView, const Matrix44& localToClip, const Matrix44& localToWorld,
+                            const Matrix44& shadowView, const Matrix44& shadowProjection, class Shader* overrideShader, Shader* overrideSkinShader );
+
+        /// Draws a non-skinned submesh once per localToWorld matrix in one instanced draw.
+        /// \param subMeshIndex Submesh index.
+        /// \param localToWorlds Instances' Local-to-World matrices.
+        /// \param instanceCount Instance count, at most PerObjectUboStruct::MaxInstances.
+        /// \param worldToView Camera view matrix.
+        /// \param worldToClip Camera view-projection matrix.
+        /// \param shadowView Shadow camera view matrix.
+        /// \param shadowProjection Shadow camera projection matrix.
+        /// \param overrideInstancedShader Instanced override shader. If null, the material's instanced shader is used.
+        void RenderSubMeshInstanced( unsigned subMeshIndex, const Matrix44* localToWorlds, int instanceCount, const Matrix44& worldToView, const Matrix44& worldToClip,
+                                     const Matrix44& shadowView, const Matrix44& shadowProjection, Shader* overrideInstancedShader );
+
+#if RENDERER_VULKAN
+        /// Applies a submesh's material and draws the visible instances of indirect draws that use it.
+        /// \param subMeshIndex Submesh index. Its material must have an indirect shader.
+        /// \param firstIndirectDraw First draw of the last GfxDevice::CullIndirect call.
+        /// \param indirectDrawCount Draw count. The draws must use the submesh's material.
+        /// \param worldToView Camera view matrix.
+        /// \param worldToClip Camera view-projection matrix.
+        /// \param shadowView Shadow camera view matrix.
+        /// \param shadowProjection Shadow camera projection matrix.
+        void RenderSubMeshIndirect( unsigned subMeshIndex, unsigned firstIndirectDraw, unsigned indirectDrawCount, const Matrix44& worldToView, const Matrix44& worldToClip,
+                                    const Matrix44& shadowView, const Matrix44& shadowProjection );
+#endif
+
+        /// \return True if the submesh has joints.
+        bool IsSubMeshSkinned( unsigned subMeshIndex ) const;
+
+        /// Sets per-object uniforms and draws a submesh instanceCount times.
+        /// \param hasOverrideShader If false, the material's uniforms and render state are applied.
+        /// \param indirectDrawCount If not 0, draws indirect draws firstIndirectDraw to firstIndirectDraw + indirectDrawCount - 1 instead. Vulkan only.
+        void DrawSubMesh( unsigned subMeshIndex, Shader& shader, bool hasOverrideShader, const Matrix44& localToView, const Matrix44& localToClip, const Matrix44& localToWorld,
+                          const Matrix44& shadowView, const Matrix44& shadowProjection, int instanceCount, unsigned firstIndirectDraw, unsigned indirectDrawCount );
 
         Mesh* mesh = nullptr;
         Array< Material* > materials;
         Array< bool > isSubMeshCulled;
         GameObject* gameObject = nullptr;
         int animFrame = 0;
-        bool isCulled = false;
         bool isWireframe = false;
         bool isEnabled = true;
         bool castShadow = true;
+        bool isOccluder = false;
+        bool isStatic = false;
+        /// Set by Scene::BuildStaticBatches when a static batch draws this mesh renderer's submeshes.
+        bool isStaticBatched = false;
     };
 }
@@ -49,13 +49,16 @@ namespace ae3d
         friend class Scene;
         
         /// \return Component's type code. Must be unique for each component type.
-        static int Type() { return 8; }
+        static constexpr int Type() { return 8; }
         
         /// \return Component handle that uniquely identifies the instance.
         static unsigned New();
         
         /// \return Component at index or null if index is invalid.
         static PointLightComponent* Get( unsigned index );
+
+        /// Resets the component at index and lets New return the index again.
+        static void Release( unsigned index );
         
         RenderTexture shadowMap;
         Vec3 color{ 1, 1, 1 };
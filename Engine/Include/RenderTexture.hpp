@@ -51,6 +51,9 @@ namespace ae3d
         /// \return render pass.
         VkRenderPass GetRenderPass() { return renderPass; }
 
+        /// \return Render pass that is compatible with GetRenderPass() but loads the attachments instead of clearing them.
+        VkRenderPass GetLoadRenderPass() { return loadRenderPass; }
+
         /// \return Color image.
         VkImage GetColorImage() { return color.image; }
 
@@ -71,7 +74,6 @@ namespace ae3d
         struct FrameBufferAttachment
         {
             VkImage image;
-            VkDeviceMemory mem;
             VkImageView view;
         };
 
@@ -79,6 +81,7 @@ namespace ae3d
 		FrameBufferAttachment depth = {};
         VkFormat colorFormat = VK_FORMAT_B8G8R8A8_UNORM;
         VkRenderPass renderPass = VK_NULL_HANDLE;
+        VkRenderPass loadRenderPass = VK_NULL_HANDLE;
         int sampleCount = 1;
         VkImageLayout layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 #endif
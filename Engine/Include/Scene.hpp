@@ -2,8 +2,11 @@
 
 #include <vector>
 #include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include "Array.hpp"
+#include "Matrix.hpp"
 #include "Vec3.hpp"
 
 namespace ae3d
@@ -12,6 +15,8 @@ namespace ae3d
     {
         struct FileContentsData;
     }
+
+    struct Quaternion;
     
     /// Contains game objects in a transform hierarchy.
     class Scene
@@ -19,15 +24,49 @@ namespace ae3d
     public:
         /// Result of GetSerialized.
         enum class DeserializeResult { Success, ParseError };
+
+        /// Identifies a game object in the scene. Becomes stale when the game object is removed, even if its slot is reused.
+        struct GameObjectHandle
+        {
+            /// Slot index.
+            unsigned index = 0;
+            /// Slot generation when the handle was created. 0 is never valid.
+            unsigned generation = 0;
+        };
         
+        Scene();
+        Scene( const Scene& ) = delete;
+        Scene& operator=( const Scene& ) = delete;
+        ~Scene();
+
         /// Adds a game object into the scene if it does not exist there already.
-        void Add( class GameObject* gameObject );
+        /// \param gameObject Game object. Null is ignored.
+        /// \return Handle to the game object, or an invalid handle if gameObject is null.
+        GameObjectHandle Add( class GameObject* gameObject );
         
         /// Ends the rendering. Called after scene.Render() and UI/line rendering etc.
         void EndFrame();
         
         /// \param gameObject Game object to remove. Does nothing if it is null or doesn't exist in the scene.
         void Remove( GameObject* gameObject );
+
+        /// \param handle Handle of the game object to remove. Does nothing if the handle is stale.
+        void Remove( GameObjectHandle handle );
+
+        /// \param handle Handle returned by Add.
+        /// \return Game object or null if the handle is stale.
+        GameObject* Get( GameObjectHandle handle ) const;
+
+        /// Merges submeshes of static mesh renderers that share a material and layer into pre-transformed batches, so they are drawn in a few draw calls.
+        /// Batched mesh renderers are not drawn individually. Moving, disabling or removing them doesn't affect the batches until this is called again.
+        /// Call after adding the scene's static game objects, for example after Deserialize.
+        /// \param cellSize Size of the world-space grid cells. Batches don't span cells, so they can still be culled.
+        void BuildStaticBatches( float cellSize );
+
+        /// Compiles the PSOs that the mesh renderers' draws into cameras' targets and shadow maps need on job threads, so the first frames don't stall on them.
+        /// Call after adding the scene's cameras, lights and mesh renderers, for example after Deserialize. Draws that come before their PSO has compiled compile it themselves.
+        /// Only Vulkan compiles PSOs here, other renderers do nothing.
+        void PrecompilePSOs();
         
         /// Renders the scene.
         void Render();
@@ -41,6 +80,9 @@ namespace ae3d
         /// \return Scene's contents in a textual format that can be saved into file etc.
         std::string GetSerialized() const;
 
+        /// \return Rendering commands of the last Render() in a textual format, one per line. Dumps of different frames can be diffed.
+        std::string GetRenderCommandsDump() const;
+
         /// Deserializes a scene additively from file contents. Must be called after renderer is initialized.
         /// \param serialized Serialized scene contents.
         /// \param outGameObjects Returns game objects that were created from serialized scene contents.
@@ -54,20 +96,197 @@ namespace ae3d
                                        Array< class Mesh* >& outMeshes ) const;
         
     private:
-        void RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const char* debugGroupName );
+        /// Enabled mesh renderer gathered by ExtractRenderLists.
+        struct FrameMeshRenderer
+        {
+            Matrix44 localToWorld;
+            class MeshRendererComponent* meshRenderer = nullptr;
+            /// World-space AABB.
+            Vec3 aabbMin;
+            /// World-space AABB.
+            Vec3 aabbMax;
+            /// Index into gameObjectSlots, or into staticBatches if isStaticBatch is set.
+            unsigned slotIndex = 0;
+            unsigned layer = 0;
+            bool castsShadow = false;
+            bool isStaticBatch = false;
+            /// Transform's TransformComponent::GetWorldVersion, or 0 if there is no transform.
+            unsigned worldVersion = 0;
+        };
+
+        /// Enabled sprite or text renderer gathered by ExtractRenderLists. Kept in one list to preserve their draw order.
+        struct FrameSpriteOrText
+        {
+            Matrix44 localToWorld;
+            class SpriteRendererComponent* spriteRenderer = nullptr;
+            class TextRendererComponent* textRenderer = nullptr;
+            unsigned layer = 0;
+        };
+
+        /// Enabled light gathered by ExtractRenderLists. Only one of the light components is set.
+        struct FrameLight
+        {
+            /// Can be null.
+            class TransformComponent* transform = nullptr;
+            class DirectionalLightComponent* dirLight = nullptr;
+            class SpotLightComponent* spotLight = nullptr;
+            class PointLightComponent* pointLight = nullptr;
+            unsigned layer = 0;
+        };
+
+        /// Gathers enabled game objects' renderable components into per-frame lists that are shared by all passes.
+        /// Must be called after transforms have been updated.
+        void ExtractRenderLists();
+        /// \param faceRotation Rotation of the cube map face, or null to use the camera's world rotation.
+        void RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const Quaternion* faceRotation, const char* debugGroupName );
         void RenderShadowsWithCamera( GameObject* cameraGo, int cubeMapFace );
-        void RenderShadowMaps( std::vector< GameObject* >& cameras );
-        void RenderRTCameras( std::vector< GameObject* >& rtCameras );
-        void RenderDepthAndNormalsForAllCameras( std::vector< GameObject* >& cameras );
-        void RenderDepthAndNormals( class CameraComponent* camera, const struct Matrix44& view, std::vector< unsigned > gameObjectsWithMeshRenderer,
+        /// Adds passes that render the shadow maps of frameLights once per camera into renderGraph. Compile culls all but the last camera's passes.
+        /// \param cameras Cameras whose frustums the shadow maps cover.
+        /// \param outShadowMaps Imported shadow maps are appended here.
+        void AddShadowMapPasses( const std::vector< GameObject* >& cameras, std::vector< unsigned >& outShadowMaps );
+        /// Adds depth and normals and light culling passes of cameras that have a depth and normals texture into renderGraph.
+        /// \param cameras Cameras.
+        /// \param lightTiles Light culling's tiles, which light culling passes write.
+        void AddDepthNormalsPasses( const std::vector< GameObject* >& cameras, unsigned lightTiles );
+        /// Adds passes of cameras that render into a render texture into renderGraph.
+        /// \param rtCameras Cameras.
+        /// \param shadowMaps Shadow maps from AddShadowMapPasses.
+        /// \param lightTiles Light culling's tiles.
+        /// \param outTargets Imported target textures are appended here.
+        void AddRTCameraPasses( const std::vector< GameObject* >& rtCameras, const std::vector< unsigned >& shadowMaps, unsigned lightTiles,
+                                std::vector< unsigned >& outTargets );
+        /// Makes a camera pass read the resources that its materials can sample.
+        void ReadCameraPassInputs( unsigned pass, const std::vector< unsigned >& shadowMaps, unsigned lightTiles, const std::vector< unsigned >& cameraTargets );
+        void RenderDepthAndNormals( class CameraComponent* camera, class RenderTexture* target, const Matrix44& view, std::vector< unsigned >& meshRenderers,
                                     int cubeMapFace, const class Frustum& frustum );
+        /// Generates the scene AABB from frameMeshRenderers.
         void GenerateAABB();
+        /// Removes the holes that Remove left in gameObjects, keeping the remaining game objects in the order they were added.
+        void CompactGameObjects();
+        /// Gathers indices of frameMeshRenderers whose layer is in layerMask.
+        void GetMeshRenderersInLayers( unsigned layerMask, std::vector< unsigned >& outMeshRenderers ) const;
+        /// Culls mesh renderers against frustum using meshRendererTree, then culls the visible ones' submeshes in parallel.
+        /// Must be called before rendering the game objects.
+        /// \param meshRenderers Indices of frameMeshRenderers. Culled ones are removed.
+        void CullMeshRenderers( const class Frustum& frustum, std::vector< unsigned >& meshRenderers );
+        /// Rasterizes occluders in meshRenderers into occlusionCuller and removes mesh renderers that are hidden behind them.
+        /// \param worldToClip Camera's view-projection matrix.
+        /// \param meshRenderers Indices of frameMeshRenderers that passed CullMeshRenderers. Occluded ones are removed.
+        void CullOccludedMeshRenderers( const Matrix44& worldToClip, std::vector< unsigned >& meshRenderers );
+
+        /// Selects the submeshes that a pass draws and the fields of their sort keys.
+        enum class DrawPass
+        {
+            /// Opaque and transparent submeshes with their materials.
+            Camera,
+            /// Opaque and transparent submeshes with an override shader, sorted by mesh and depth.
+            DepthNormals,
+            /// Opaque submeshes with an override shader, sorted by mesh and depth.
+            Shadow
+        };
+
+        /// Working memory of RenderSortedSubMeshes. Defined in Scene.cpp.
+        struct DrawQueue;
+
+        /// Mesh built by BuildStaticBatches and the mesh renderer that draws it. Defined in Scene.cpp.
+        struct StaticBatch;
+
+        /// Releases staticBatches' mesh renderers and tree proxies.
+        void ReleaseStaticBatches();
 
+#if RENDERER_VULKAN
+        /// Working memory of RenderIndirectSubMeshes. Defined in Scene.cpp.
+        struct IndirectQueue;
+
+        /// Culls mesh renderers whose materials all have an indirect shader on the GPU, records their draws into commandStream, and removes them from meshRenderers.
+        /// Occluders and skinned, alpha-blended or wireframe mesh renderers are left in meshRenderers, as are all of them if GfxDevice::CullIndirect fails.
+        /// The camera's instances stay in GPU memory between frames. Only mesh renderers whose transform has changed are updated,
+        /// and the draws are rebuilt only when the mesh renderers, their meshes or their materials change.
+        /// \param camera Camera.
+        /// \param cubeMapFace Cube map face, or 0 if the camera doesn't render into a cube map.
+        /// \param meshRenderers Indices of frameMeshRenderers in the camera's layers.
+        /// \param worldToView Camera's view matrix.
+        /// \param worldToClip Camera's view-projection matrix.
+        void RenderIndirectSubMeshes( const class CameraComponent* camera, int cubeMapFace, std::vector< unsigned >& meshRenderers, const Matrix44& worldToView,
+                                      const Matrix44& worldToClip );
+#endif
+
+        /// Records draws of meshRenderers' submeshes into commandStream in DrawSortKey order: opaque ones grouped by state and front-to-back, then transparent ones back-to-front.
+        /// Consecutive draws of the same non-skinned submesh and material are merged into instanced draws if there's an instanced shader.
+        /// \param meshRenderers Indices of frameMeshRenderers that passed CullMeshRenderers.
+        /// \param worldToView Camera's view matrix.
+        /// \param projection Camera's projection matrix.
+        /// \param farDepth Camera's far plane distance, used to quantize depth.
+        /// \param pass Pass.
+        /// \param overrideShader Replaces materials' shaders. Null in Camera pass.
+        /// \param overrideSkinShader Replaces skinned submeshes' shaders. Null in Camera pass.
+        /// \param overrideInstancedShader Replaces materials' instanced shaders. Null in Camera pass.
+        void RenderSortedSubMeshes( const std::vector< unsigned >& meshRenderers, const Matrix44& worldToView, const Matrix44& projection, float farDepth,
+                                    DrawPass pass, class Shader* overrideShader, Shader* overrideSkinShader, Shader* overrideInstancedShader );
+        /// Executes commands that have been recorded into commandStream since the last call. Called at the end of each pass.
+        void ExecuteRecordedCommands();
+
+        struct GameObjectSlot
+        {
+            /// Index into gameObjects, or next free slot if isFree is set.
+            unsigned denseIndex = 0;
+            /// Incremented when the slot is freed.
+            unsigned generation = 1;
+            /// Mesh renderer's leaf in meshRendererTree, or -1 if the game object has no enabled mesh renderer.
+            int meshRendererProxy = -1;
+            /// Set when the game object has been removed and the slot can be reused.
+            bool isFree = false;
+        };
+
+        /// Game objects in the order they were added. Remove leaves a null hole so that sprite, text and serialization order is kept.
+        /// Holes are removed by CompactGameObjects.
         std::vector< GameObject* > gameObjects;
-        unsigned nextFreeGameObject = 0;
+        /// Slot index of each element in gameObjects.
+        std::vector< unsigned > gameObjectSlotIndices;
+        /// Null holes in gameObjects.
+        unsigned removedGameObjectCount = 0;
+        std::vector< GameObjectSlot > gameObjectSlots;
+        std::unordered_map< GameObject*, unsigned > gameObjectToSlotIndex;
+        static const unsigned InvalidSlot = 0xFFFFFFFF;
+        unsigned firstFreeSlot = InvalidSlot;
         TextureCube* skybox = nullptr;
         Vec3 aabbMin;
         Vec3 aabbMax;
         Vec3 ambientColor = Vec3( 0.1f, 0.1f, 0.1f );
+
+        // Per-frame render lists, rebuilt by ExtractRenderLists. Kept as members to reuse their memory.
+        std::vector< FrameMeshRenderer > frameMeshRenderers;
+        std::vector< FrameSpriteOrText > frameSpritesAndTexts;
+        std::vector< FrameLight > frameLights;
+        /// Cameras without a target texture, sorted by render order.
+        std::vector< GameObject* > frameCameras;
+        /// Cameras with a target texture, sorted by render order.
+        std::vector< GameObject* > frameRTCameras;
+        /// Indices of frameMeshRenderers whose tree leaf intersects the frustum in CullMeshRenderers.
+        std::vector< unsigned > frameMeshRenderersInFrustum;
+        /// Centers and extents of frameMeshRenderersInFrustum as 6 consecutive arrays for Frustum::BoxesInFrustum.
+        std::vector< float > frustumTestBounds;
+        /// Result of Frustum::BoxesInFrustum for frameMeshRenderersInFrustum.
+        std::vector< unsigned > frustumTestVisibleMask;
+        /// Per frameMeshRenderers entry, set by CullMeshRenderers.
+        std::vector< unsigned char > isFrameMeshRendererInFrustum;
+        /// Per frameMeshRenderers entry, set by CullOccludedMeshRenderers.
+        std::vector< unsigned char > isFrameMeshRendererOccluded;
+        /// World-space bounds of enabled mesh renderers. Persists between frames and is refitted by ExtractRenderLists.
+        std::unique_ptr< class AABBTree > meshRendererTree;
+        /// Depth buffer of occluders for the camera that's being rendered.
+        std::unique_ptr< class OcclusionCuller > occlusionCuller;
+        std::unique_ptr< DrawQueue > drawQueue;
+        /// Commands of the frame. Passes record their commands and execute them at the end of the pass.
+        std::unique_ptr< class CommandStream > commandStream;
+        /// Commands in commandStream that have been executed.
+        std::size_t executedCommandCount = 0;
+        /// Passes of the frame, rebuilt by Render. Keeps pooled transient textures between frames.
+        std::unique_ptr< class RenderGraph > renderGraph;
+        std::vector< std::unique_ptr< StaticBatch > > staticBatches;
+#if RENDERER_VULKAN
+        /// Resident indirect instances of cameras. Persists between frames.
+        std::unique_ptr< IndirectQueue > indirectQueue;
+#endif
     };
 }
@@ -62,7 +62,7 @@ namespace ae3d
         /// \param textureUnit Texture unit.
         void SetRenderTexture( class RenderTexture* renderTexture, int textureUnit );
 
-        /// \param offset Offset into the currently bound uniform buffer.
+        /// \param offset Offset into the object uniform block (b0).
         /// \param data Data to be copied into the uniform buffer.
         /// \param dataBytes Copied data's size in bytes.
         void SetUniform( int offset, void* data, int dataBytes );
@@ -76,6 +76,10 @@ namespace ae3d
         ID3DBlob* blobShaderPixel = nullptr;
 #endif
 
+#if RENDERER_NULL
+        bool IsValid() const { return true; }
+#endif
+
 #if RENDERER_METAL
         void LoadFromLibrary( const char* vertexShaderName, const char* fragmentShaderName );
         bool IsValid() const { return vertexProgram != nullptr; }
@@ -53,13 +53,16 @@ namespace ae3d
         friend class Scene;
         
         /// \return Component's type code. Must be unique for each component type.
-        static int Type() { return 7; }
+        static constexpr int Type() { return 7; }
         
         /// \return Component handle that uniquely identifies the instance.
         static unsigned New();
         
         /// \return Component at index or null if index is invalid.
         static SpotLightComponent* Get( unsigned index );
+
+        /// Resets the component at index and lets New return the index again.
+        static void Release( unsigned index );
         
         RenderTexture shadowMap;
         GameObject* gameObject = nullptr;
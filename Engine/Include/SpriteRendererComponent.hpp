@@ -67,9 +67,10 @@ namespace ae3d
     private:
         friend class GameObject;
         friend class Scene;
+        friend void ExecuteCommonCommand( const class CommandStream& stream, const struct RenderCommand& command );
         
         /* \return Component's type code. Must be unique for each component type. */
-        static int Type() { return 1; }
+        static constexpr int Type() { return 1; }
         
         /* \return Component handle that uniquely identifies the instance. */
         static unsigned New();
@@ -77,6 +78,9 @@ namespace ae3d
         /* \return Component at index or null if index is invalid. */
         static SpriteRendererComponent* Get( unsigned index );
 
+        /* Resets the component at index and lets New return the index again. */
+        static void Release( unsigned index );
+
         /* \param localToClip Transforms coordinates to clip space. */
         void Render( const float* localToClip );
         
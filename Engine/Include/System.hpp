@@ -197,6 +197,9 @@ namespace ae3d
             int GetBarrierCallCount();
             int GetFenceCallCount();
             void GetGpuMemoryUsage( unsigned& outUsedMBytes, unsigned& outBudgetMBytes );
+            /// \param outStr Receives one "name components: live / capacity" line per component type. Truncated to outStrSize bytes including the terminator.
+            /// \param outStrSize Size of outStr in bytes.
+            void GetComponentPoolStatistics( char* outStr, unsigned outStrSize );
         }
     }
 }
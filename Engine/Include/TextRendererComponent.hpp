@@ -55,9 +55,10 @@ namespace ae3d
       private:
         friend class GameObject;
         friend class Scene;
+        friend void ExecuteCommonCommand( const class CommandStream& stream, const struct RenderCommand& command );
 
         /** \return Component's type code. Must be unique for each component type. */
-        static int Type() { return 4; }
+        static constexpr int Type() { return 4; }
         
         /** \return Component handle that uniquely identifies the instance. */
         static unsigned New();
@@ -65,6 +66,9 @@ namespace ae3d
         /** \return Component at index or null if index is invalid. */
         static TextRendererComponent* Get( unsigned index );
 
+        /** Resets the component at index and lets New return the index again. */
+        static void Release( unsigned index );
+
         /** \param localToClip Transforms screen-space coordinates to clip space. */
         void Render( const float* localToClip );
 
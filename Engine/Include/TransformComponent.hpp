@@ -6,30 +6,34 @@
 
 namespace ae3d
 {
-    /// Stores a position and an orientation.
+    /// Stores a position and an orientation. Position, orientation, scale, parent and matrices are stored in
+    /// structure-of-arrays form indexed by the component handle, so that UpdateLocalMatrices can process 4 transforms at a time.
     class TransformComponent
     {
     public:
-        /// \return Local position.
-        const Vec3& GetLocalPosition() const { return localPosition; }
+        /// Constructor.
+        TransformComponent() = default;
+
+        /// Components are created by New, so they are not copy-constructed.
+        TransformComponent( const TransformComponent& other ) = delete;
+
+        /// Copies local position, rotation, scale, parent and enabled state, but keeps this component's storage.
+        TransformComponent& operator=( const TransformComponent& other );
 
         /// \return Local position.
-        Vec3& GetLocalPosition() { return localPosition; }
+        const Vec3& GetLocalPosition() const;
 
         /// \return Local rotation.
-        const Quaternion& GetLocalRotation() const { return localRotation; }
+        const Quaternion& GetLocalRotation() const;
 
         /// \return Local scale.
-        float& GetLocalScale() { return localScale; }
-
-        /// \return Local scale.
-        float GetLocalScale() const { return localScale; }
+        float GetLocalScale() const;
 
         /// \return World position.
-        const Vec3& GetWorldPosition() const { return globalPosition; }
+        const Vec3& GetWorldPosition() const;
 
         /// \return World rotation.
-        const Quaternion& GetWorldRotation() const { return globalRotation; }
+        const Quaternion& GetWorldRotation() const;
 
         /// \return GameObject that owns this component.
         class GameObject* GetGameObject() const { return gameObject; }
@@ -83,7 +87,7 @@ namespace ae3d
         const Matrix44& GetLocalMatrix();
 
         /// \return Local-to-world transform matrix.
-        const Matrix44& GetLocalToWorldMatrix() { return localToWorldMatrix; }
+        const Matrix44& GetLocalToWorldMatrix();
 
         /// \return View direction (normalized)
         Vec3 GetViewDirection() const;
@@ -96,7 +100,7 @@ namespace ae3d
         friend class Scene;
 
         /// \return Component's type code. Must be unique for each component type.
-        static int Type() { return 2; }
+        static constexpr int Type() { return 2; }
         
         /// \return Component handle that uniquely identifies the instance.
         static unsigned New();
@@ -104,19 +108,37 @@ namespace ae3d
         /// \return Component at index or null if index is invalid.
         static TransformComponent* Get( unsigned index );
 
-        /// Updates matrices.
-        static void UpdateLocalMatrices();
+        /// Resets the component at index and lets New return the index again.
+        static void Release( unsigned index );
 
-        void SolveLocalMatrix();
+        /// Updates matrices of transforms whose local TRS or parent has changed, and of their children.
+        static void UpdateLocalMatrices();
 
-        Matrix44 localMatrix;
-        Matrix44 localToWorldMatrix;
-        Vec3 localPosition;
-        Quaternion localRotation;
-        Quaternion globalRotation;
-        float localScale = 1;
-        Vec3 globalPosition;
-        int parent = -1;
+        /// Sorts component indices by hierarchy depth.
+        static void SortHierarchy();
+
+        /// \return Number of the UpdateLocalMatrices call that last changed the local-to-world matrix. Caches of world matrices compare it
+        ///         with the version they stored, so they see changes even if other scenes' renders have updated the transforms since.
+        unsigned GetWorldVersion() const;
+
+        /// Unlinks this transform from its current parent's children and links it into the new parent's children.
+        /// \param parent Parent's index or -1 if there is no parent.
+        void SetParentIndex( int parent );
+
+        /// Clears lastCopy and copiedFrom, and the links that point back to this transform.
+        void UnlinkCopies();
+
+        /// Index into the structure-of-arrays data.
+        unsigned index = 0;
+        /// Index of the first child or -1. Children are linked through nextSibling and previousSibling, so detaching is O(1).
+        int firstChild = -1;
+        int nextSibling = -1;
+        int previousSibling = -1;
+        /// Index of the transform that was last copied from this one or -1. Release gives this transform's children to it,
+        /// so hierarchies survive when game objects are copied and the originals destroyed, like in std::vector reallocation.
+        int lastCopy = -1;
+        /// Index of the transform that this one was copied from or -1. Its lastCopy is this transform.
+        int copiedFrom = -1;
 #if defined( AE3D_OPENVR )
         Matrix44 hmdView; // For VR
 #endif
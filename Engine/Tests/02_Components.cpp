@@ -107,7 +107,11 @@ bool TestTransform()
         return false;
     }
     
-    TransformComponent copy = *gGo.GetComponent< TransformComponent >();
+    // Transforms live in the component pool, so they are copied by assignment.
+    GameObject copyGo;
+    copyGo.AddComponent< TransformComponent >();
+    TransformComponent& copy = *copyGo.GetComponent< TransformComponent >();
+    copy = *gGo.GetComponent< TransformComponent >();
     bool success = copy.GetLocalPosition().x == gGo.GetComponent< TransformComponent >()->GetLocalPosition().x &&
         copy.GetLocalPosition().y == gGo.GetComponent< TransformComponent >()->GetLocalPosition().y &&
         copy.GetLocalPosition().z == gGo.GetComponent< TransformComponent >()->GetLocalPosition().z;
@@ -0,0 +1,386 @@
+// Renders a scene through the headless null renderer and checks that every pass recorded work.
+// Build the engine with Makefile_Null first. Useful for profiling Scene::Render on machines without a GPU.
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "CameraComponent.hpp"
+#include "DirectionalLightComponent.hpp"
+#include "FileSystem.hpp"
+#include "GameObject.hpp"
+#include "Material.hpp"
+#include "Mesh.hpp"
+#include "MeshRendererComponent.hpp"
+#include "PointLightComponent.hpp"
+#include "RenderTexture.hpp"
+#include "Shader.hpp"
+#include "Statistics.hpp"
+#include "System.hpp"
+#include "Scene.hpp"
+#include "TransformComponent.hpp"
+#include "Vec3.hpp"
+#include "Window.hpp"
+
+using namespace ae3d;
+
+// Builds an .ae3d file of a cube from -1 to 1 in PTN format. The built-in cube has no CPU-side geometry, so it can't be an occluder.
+FileSystem::FileContentsData MakeCubeMeshFile()
+{
+    FileSystem::FileContentsData file;
+    file.path = "occluder_cube.ae3d";
+    file.isLoaded = true;
+
+    auto append = [&file]( const void* data, std::size_t size )
+    {
+        const unsigned char* bytes = static_cast< const unsigned char* >( data );
+        file.data.insert( file.data.end(), bytes, bytes + size );
+    };
+
+    const unsigned char magic[ 2 ] = { 'a', '9' };
+    const float aabb[ 6 ] = { -1, -1, -1, 1, 1, 1 };
+    const unsigned short meshCount = 1;
+    const unsigned short nameLength = 0;
+    const unsigned short vertexCount = 8;
+    const unsigned char vertexFormatPTN = 1;
+    const unsigned short faceCount = 12;
+    const unsigned char terminator = 100;
+
+    append( magic, sizeof( magic ) );
+    append( aabb, sizeof( aabb ) );
+    append( &meshCount, sizeof( meshCount ) );
+    append( aabb, sizeof( aabb ) );
+    append( &nameLength, sizeof( nameLength ) );
+    append( &vertexCount, sizeof( vertexCount ) );
+    append( &vertexFormatPTN, sizeof( vertexFormatPTN ) );
+
+    for (int i = 0; i < 8; ++i)
+    {
+        // Position, texture coordinate and normal.
+        const float vertex[ 8 ] = { (i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f, 0, 0, 0, 1, 0 };
+        append( vertex, sizeof( vertex ) );
+    }
+
+    const unsigned short faces[ 12 * 3 ] =
+    {
+        0, 2, 1, 1, 2, 3,
+        4, 5, 6, 5, 7, 6,
+        0, 1, 4, 1, 5, 4,
+        2, 6, 3, 3, 6, 7,
+        0, 4, 2, 2, 4, 6,
+        1, 3, 5, 3, 7, 5
+    };
+
+    append( &faceCount, sizeof( faceCount ) );
+    append( faces, sizeof( faces ) );
+    append( &terminator, sizeof( terminator ) );
+
+    return file;
+}
+
+int main()
+{
+    const int width = 1280;
+    const int height = 720;
+    const int cubeDimension = 20;
+    const int frameCount = 10;
+
+    Window::Create( width, height, WindowCreateFlags::Empty );
+    System::LoadBuiltinAssets();
+
+    GameObject camera;
+    camera.AddComponent< CameraComponent >();
+    camera.GetComponent< CameraComponent >()->SetProjectionType( CameraComponent::ProjectionType::Perspective );
+    camera.GetComponent< CameraComponent >()->SetProjection( 45, (float)width / (float)height, 1, 400 );
+    camera.GetComponent< CameraComponent >()->SetClearFlag( CameraComponent::ClearFlag::DepthAndColor );
+    camera.AddComponent< TransformComponent >();
+    // Both cameras' depth and normals share a transient texture.
+    camera.GetComponent< CameraComponent >()->SetTransientDepthNormalsSize( width, height );
+
+    // Shadow maps are only rendered for cameras that have a target texture.
+    RenderTexture cameraTarget;
+    cameraTarget.Create2D( width, height, RenderTexture::DataType::UByte, TextureWrap::Clamp, TextureFilter::Linear, "cameraTarget" );
+
+    GameObject rtCamera;
+    rtCamera.AddComponent< CameraComponent >();
+    rtCamera.GetComponent< CameraComponent >()->SetProjectionType( CameraComponent::ProjectionType::Perspective );
+    rtCamera.GetComponent< CameraComponent >()->SetProjection( 45, (float)width / (float)height, 1, 400 );
+    rtCamera.GetComponent< CameraComponent >()->SetClearFlag( CameraComponent::ClearFlag::DepthAndColor );
+    rtCamera.GetComponent< CameraComponent >()->SetTargetTexture( &cameraTarget );
+    rtCamera.GetComponent< CameraComponent >()->SetTransientDepthNormalsSize( width, height );
+    rtCamera.AddComponent< TransformComponent >();
+
+    GameObject dirLight;
+    dirLight.AddComponent< DirectionalLightComponent >();
+    dirLight.GetComponent< DirectionalLightComponent >()->SetCastShadow( true, 512 );
+    dirLight.AddComponent< TransformComponent >();
+    dirLight.GetComponent< TransformComponent >()->LookAt( { 0, 0, 0 }, Vec3( 0, -1, -0.2f ).Normalized(), { 0, 1, 0 } );
+
+    GameObject pointLight;
+    pointLight.AddComponent< PointLightComponent >();
+    pointLight.GetComponent< PointLightComponent >()->SetRadius( 20 );
+    pointLight.AddComponent< TransformComponent >();
+    pointLight.GetComponent< TransformComponent >()->SetLocalPosition( { 0, 0, -80 } );
+
+    // Empty contents make Mesh fall back to its built-in cube.
+    Mesh cubeMesh;
+    cubeMesh.Load( FileSystem::FileContentsData() );
+
+    Shader shader;
+    shader.Load( "unlit_vertex", "unlit_fragment" );
+
+    Shader instancedShader;
+    instancedShader.Load( "unlit_instanced_vertex", "unlit_fragment" );
+
+    Material material;
+    material.SetShader( &shader );
+    material.SetInstancedShader( &instancedShader );
+
+    std::vector< GameObject > cubes( cubeDimension * cubeDimension );
+
+    Scene scene;
+    scene.Add( &camera );
+    scene.Add( &rtCamera );
+    scene.Add( &dirLight );
+    scene.Add( &pointLight );
+
+    for (int i = 0; i < (int)cubes.size(); ++i)
+    {
+        const float x = (float)(i % cubeDimension) * 4 - cubeDimension * 2;
+        const float y = (float)(i / cubeDimension) * 4 - cubeDimension * 2;
+
+        cubes[ i ].AddComponent< MeshRendererComponent >();
+        cubes[ i ].GetComponent< MeshRendererComponent >()->SetMesh( &cubeMesh );
+        cubes[ i ].GetComponent< MeshRendererComponent >()->SetMaterial( &material, 0 );
+        cubes[ i ].AddComponent< TransformComponent >();
+        cubes[ i ].GetComponent< TransformComponent >()->SetLocalPosition( { x, y, -100 } );
+        scene.Add( &cubes[ i ] );
+    }
+
+    // Component storage grows in chunks that never move, so references stay valid when components are added.
+    const Matrix44* firstCubeLocalToWorld = &cubes[ 0 ].GetComponent< TransformComponent >()->GetLocalToWorldMatrix();
+    const Vec3* firstCubePosition = &cubes[ 0 ].GetComponent< TransformComponent >()->GetLocalPosition();
+    std::vector< GameObject > unusedTransforms( 1000 );
+
+    for (auto& unusedTransform : unusedTransforms)
+    {
+        unusedTransform.AddComponent< TransformComponent >();
+    }
+
+    bool success = firstCubeLocalToWorld == &cubes[ 0 ].GetComponent< TransformComponent >()->GetLocalToWorldMatrix();
+    success &= firstCubePosition == &cubes[ 0 ].GetComponent< TransformComponent >()->GetLocalPosition();
+
+    // Destroyed game objects return their components, so churn doesn't grow the pools.
+    char poolStatsBefore[ 1024 ] = {};
+    char poolStatsAfter[ 1024 ] = {};
+    System::Statistics::GetComponentPoolStatistics( poolStatsBefore, sizeof( poolStatsBefore ) );
+
+    for (int churn = 0; churn < 1000; ++churn)
+    {
+        GameObject temporary;
+        temporary.AddComponent< TransformComponent >();
+        temporary.AddComponent< MeshRendererComponent >();
+        temporary = cubes[ 0 ];
+    }
+
+    System::Statistics::GetComponentPoolStatistics( poolStatsAfter, sizeof( poolStatsAfter ) );
+    success &= std::string( poolStatsBefore ) == poolStatsAfter;
+
+    // Children of a destroyed transform become roots.
+    GameObject orphan;
+    orphan.AddComponent< TransformComponent >();
+    {
+        GameObject parent;
+        parent.AddComponent< TransformComponent >();
+        orphan.GetComponent< TransformComponent >()->SetParent( parent.GetComponent< TransformComponent >() );
+        success &= orphan.GetComponent< TransformComponent >()->GetParent() == parent.GetComponent< TransformComponent >();
+    }
+    success &= orphan.GetComponent< TransformComponent >()->GetParent() == nullptr;
+
+    // Moving game objects, like std::vector reallocation does, keeps their hierarchy.
+    std::vector< GameObject > hierarchy( 2 );
+    hierarchy[ 0 ].AddComponent< TransformComponent >();
+    hierarchy[ 1 ].AddComponent< TransformComponent >();
+    hierarchy[ 1 ].GetComponent< TransformComponent >()->SetParent( hierarchy[ 0 ].GetComponent< TransformComponent >() );
+    hierarchy.reserve( hierarchy.capacity() * 2 );
+    success &= hierarchy[ 1 ].GetComponent< TransformComponent >()->GetParent() == hierarchy[ 0 ].GetComponent< TransformComponent >();
+    success &= hierarchy[ 0 ].GetComponent< TransformComponent >()->GetGameObject() == &hierarchy[ 0 ];
+
+    // Copies of a parent and child stay parent and child when the originals are destroyed.
+    GameObject parentCopy;
+    GameObject childCopy;
+    {
+        GameObject parent;
+        parent.AddComponent< TransformComponent >();
+        GameObject child;
+        child.AddComponent< TransformComponent >();
+        child.GetComponent< TransformComponent >()->SetParent( parent.GetComponent< TransformComponent >() );
+
+        parentCopy = parent;
+        childCopy = child;
+        success &= childCopy.GetComponent< TransformComponent >()->GetParent() == parent.GetComponent< TransformComponent >();
+        success &= parentCopy.GetComponent< TransformComponent >()->GetParent() == nullptr;
+    }
+    success &= childCopy.GetComponent< TransformComponent >()->GetParent() == parentCopy.GetComponent< TransformComponent >();
+
+    char statStr[ 1024 ] = {};
+    float totalFrameTimeMS = 0;
+    std::string previousDump;
+
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+        scene.Render();
+
+        success &= ::Statistics::GetPassDrawCalls( ::Statistics::Pass::Primary ) > 0;
+        // Cubes share the mesh and material, so they are instanced.
+        success &= ::Statistics::GetPassDrawCalls( ::Statistics::Pass::Primary ) < (int)cubes.size();
+        success &= ::Statistics::GetPassDrawCalls( ::Statistics::Pass::ShadowMap ) > 0;
+        success &= ::Statistics::GetPassDrawCalls( ::Statistics::Pass::RenderTexture ) > 0;
+        success &= ::Statistics::GetPassDrawCalls( ::Statistics::Pass::DepthNormals ) > 0;
+        success &= ::Statistics::GetPassUploads( ::Statistics::Pass::Primary ) > 0;
+
+        // The scene doesn't change after the first frame, so neither do its commands.
+        const std::string dump = scene.GetRenderCommandsDump();
+        success &= dump.find( "DrawSubMeshInstanced" ) != std::string::npos;
+        success &= frame < 2 || dump == previousDump;
+        previousDump = dump;
+
+        scene.EndFrame();
+        Window::SwapBuffers();
+        totalFrameTimeMS += ::Statistics::GetFrameTimeMS();
+    }
+
+    System::Statistics::GetStatistics( statStr );
+    std::printf( "%s", statStr );
+    System::Statistics::GetComponentPoolStatistics( statStr, sizeof( statStr ) );
+    std::printf( "%s", statStr );
+    std::printf( "average frame time over %d frames: %f ms\n", frameCount, totalFrameTimeMS / frameCount );
+
+    // Removing keeps the other game objects in the order they were added, and the removed one's handle stays stale when its slot is reused.
+    GameObject first, second, third, fourth;
+    first.SetName( "first" );
+    second.SetName( "second" );
+    third.SetName( "third" );
+    fourth.SetName( "fourth" );
+
+    Scene orderScene;
+    orderScene.Add( &first );
+    const Scene::GameObjectHandle secondHandle = orderScene.Add( &second );
+    orderScene.Add( &third );
+    orderScene.Remove( secondHandle );
+    success &= orderScene.Get( secondHandle ) == nullptr;
+
+    const std::string serialized = orderScene.GetSerialized();
+    success &= serialized.find( "first" ) < serialized.find( "third" ) && serialized.find( "second" ) == std::string::npos;
+
+    // A free slot's generation has already been incremented for its next game object.
+    Scene::GameObjectHandle freeSlotHandle = secondHandle;
+    ++freeSlotHandle.generation;
+    success &= orderScene.Get( freeSlotHandle ) == nullptr;
+
+    const Scene::GameObjectHandle fourthHandle = orderScene.Add( &fourth );
+    success &= fourthHandle.index == secondHandle.index && orderScene.Get( secondHandle ) == nullptr && orderScene.Get( fourthHandle ) == &fourth;
+
+    // Boxes behind an occluder wall are culled, boxes beside it and in front of it are not.
+    GameObject occlusionCamera;
+    occlusionCamera.AddComponent< CameraComponent >();
+    occlusionCamera.GetComponent< CameraComponent >()->SetProjectionType( CameraComponent::ProjectionType::Perspective );
+    occlusionCamera.GetComponent< CameraComponent >()->SetProjection( 45, (float)width / (float)height, 1, 400 );
+    occlusionCamera.AddComponent< TransformComponent >();
+
+    Mesh occluderMesh;
+    success &= occluderMesh.Load( MakeCubeMeshFile() ) == Mesh::LoadResult::Success;
+
+    GameObject wall;
+    wall.AddComponent< MeshRendererComponent >();
+    wall.GetComponent< MeshRendererComponent >()->SetMesh( &occluderMesh );
+    wall.GetComponent< MeshRendererComponent >()->SetMaterial( &material, 0 );
+    wall.GetComponent< MeshRendererComponent >()->SetOccluder( true );
+    wall.AddComponent< TransformComponent >();
+    wall.GetComponent< TransformComponent >()->SetLocalPosition( { 0, 0, -50 } );
+    wall.GetComponent< TransformComponent >()->SetLocalScale( 5 );
+
+    const Vec3 behindPositions[] = { { -4, 0, -150 }, { 0, 0, -150 }, { 4, 2, -150 } };
+    const Vec3 besidePositions[] = { { -60, 0, -150 }, { 60, 0, -150 } };
+    const Vec3 frontPositions[] = { { 0, 0, -20 } };
+    const int behindCount = sizeof( behindPositions ) / sizeof( behindPositions[ 0 ] );
+    const int visibleCount = sizeof( besidePositions ) / sizeof( besidePositions[ 0 ] ) + sizeof( frontPositions ) / sizeof( frontPositions[ 0 ] );
+
+    std::vector< GameObject > occludees( behindCount + visibleCount );
+
+    for (int i = 0; i < (int)occludees.size(); ++i)
+    {
+        occludees[ i ].AddComponent< MeshRendererComponent >();
+        occludees[ i ].GetComponent< MeshRendererComponent >()->SetMesh( &cubeMesh );
+        occludees[ i ].GetComponent< MeshRendererComponent >()->SetMaterial( &material, 0 );
+        occludees[ i ].AddComponent< TransformComponent >();
+        occludees[ i ].GetComponent< TransformComponent >()->SetLocalPosition( i < behindCount ? behindPositions[ i ] :
+                                                                                i < behindCount + 2 ? besidePositions[ i - behindCount ] : frontPositions[ 0 ] );
+    }
+
+    Scene occlusionScene;
+    occlusionScene.Add( &occlusionCamera );
+    occlusionScene.Add( &wall );
+    std::vector< Scene::GameObjectHandle > behindHandles;
+
+    for (int i = 0; i < (int)occludees.size(); ++i)
+    {
+        const Scene::GameObjectHandle handle = occlusionScene.Add( &occludees[ i ] );
+
+        if (i < behindCount)
+        {
+            behindHandles.push_back( handle );
+        }
+    }
+
+    occlusionScene.Render();
+    occlusionScene.EndFrame();
+    success &= ::Statistics::GetOcclusionTestedObjects() == behindCount + visibleCount;
+    success &= ::Statistics::GetOcclusionCulledObjects() == behindCount;
+
+    // Without the boxes behind the wall, nothing is culled, so none of the culled boxes were in front of it or beside it.
+    for (const auto& handle : behindHandles)
+    {
+        occlusionScene.Remove( handle );
+    }
+
+    occlusionScene.Render();
+    occlusionScene.EndFrame();
+    success &= ::Statistics::GetOcclusionTestedObjects() == visibleCount;
+    success &= ::Statistics::GetOcclusionCulledObjects() == 0;
+
+    // Each face of a cube map camera renders with its own orientation, so a box on +X is drawn even though the camera's transform looks at -Z.
+    RenderTexture cubeTarget;
+    cubeTarget.CreateCube( 256, RenderTexture::DataType::UByte, TextureWrap::Clamp, TextureFilter::Linear, "cubeTarget" );
+
+    GameObject cubeCamera;
+    cubeCamera.AddComponent< CameraComponent >();
+    cubeCamera.GetComponent< CameraComponent >()->SetProjectionType( CameraComponent::ProjectionType::Perspective );
+    cubeCamera.GetComponent< CameraComponent >()->SetProjection( 90, 1, 1, 400 );
+    cubeCamera.GetComponent< CameraComponent >()->SetClearFlag( CameraComponent::ClearFlag::DepthAndColor );
+    cubeCamera.GetComponent< CameraComponent >()->SetTargetTexture( &cubeTarget );
+    cubeCamera.GetComponent< CameraComponent >()->SetTransientDepthNormalsSize( 256, 256 );
+    cubeCamera.AddComponent< TransformComponent >();
+
+    GameObject boxOnPositiveX;
+    boxOnPositiveX.AddComponent< MeshRendererComponent >();
+    boxOnPositiveX.GetComponent< MeshRendererComponent >()->SetMesh( &cubeMesh );
+    boxOnPositiveX.GetComponent< MeshRendererComponent >()->SetMaterial( &material, 0 );
+    boxOnPositiveX.AddComponent< TransformComponent >();
+    boxOnPositiveX.GetComponent< TransformComponent >()->SetLocalPosition( { 100, 0, 0 } );
+
+    Scene cubeScene;
+    cubeScene.Add( &occlusionCamera );
+    cubeScene.Add( &cubeCamera );
+    cubeScene.Add( &boxOnPositiveX );
+    cubeScene.Render();
+    cubeScene.EndFrame();
+    success &= ::Statistics::GetPassDrawCalls( ::Statistics::Pass::RenderTexture ) > 0;
+
+    System::Deinit();
+
+    if (!success)
+    {
+        std::printf( "Null renderer did not record draws for every pass.\n" );
+    }
+
+    return success ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+// Compares batched frustum culling against the per-box path and checks that they agree.
+// Build with "make frustum", which produces a scalar and an SSE3 version.
+// The scalar batched test reuses the per-box test and is expected to be about 10 % slower than it, because it reads
+// six separate arrays instead of two.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "Frustum.hpp"
+#include "Matrix.hpp"
+#include "Quaternion.hpp"
+#include "Vec3.hpp"
+
+using namespace ae3d;
+
+namespace MathUtil
+{
+    void GetMinMax( const Vec3* aPoints, int count, Vec3& outMin, Vec3& outMax );
+    void GetCorners( const Vec3& min, const Vec3& max, Vec3 outCorners[ 8 ] );
+    void TransformAABB( const Vec3& localMin, const Vec3& localMax, const Matrix44& localToWorld, Vec3& outCenter, Vec3& outExtent );
+}
+
+float Random( float min, float max )
+{
+    return min + (max - min) * (static_cast< float >( std::rand() ) / static_cast< float >( RAND_MAX ));
+}
+
+double MillisecondsSince( const std::chrono::high_resolution_clock::time_point& start )
+{
+    return std::chrono::duration< double, std::milli >( std::chrono::high_resolution_clock::now() - start ).count();
+}
+
+int main()
+{
+    const unsigned boxCount = 100000;
+    const int iterations = 20;
+
+    std::vector< Vec3 > localMins( boxCount );
+    std::vector< Vec3 > localMaxs( boxCount );
+    std::vector< Matrix44 > localToWorlds( boxCount );
+
+    for (unsigned i = 0; i < boxCount; ++i)
+    {
+        localMins[ i ] = Vec3( Random( -2, 0 ), Random( -2, 0 ), Random( -2, 0 ) );
+        localMaxs[ i ] = Vec3( Random( 0, 2 ), Random( 0, 2 ), Random( 0, 2 ) );
+
+        Quaternion rotation;
+        rotation.FromAxisAngle( Vec3( Random( -1, 1 ), Random( -1, 1 ), Random( -1, 1 ) ).Normalized(), Random( 0, 360 ) );
+        rotation.GetMatrix( localToWorlds[ i ] );
+        const float scale = Random( 0.5f, 2 );
+        localToWorlds[ i ].Scale( scale, scale, scale );
+        localToWorlds[ i ].SetTranslation( Vec3( Random( -500, 500 ), Random( -50, 50 ), Random( -500, 500 ) ) );
+    }
+
+    Frustum frustum;
+    frustum.SetProjection( 45, 16.0f / 9.0f, 1, 400 );
+    frustum.Update( Vec3( 0, 0, 0 ), Vec3( 0, 0, 1 ) );
+
+    // Per-box path: transforms 8 corners, then tests min/max.
+    // TransformPoint's input and output must not alias, so corners are transformed into another array.
+    std::vector< unsigned char > perBoxVisible( boxCount );
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+        for (unsigned i = 0; i < boxCount; ++i)
+        {
+            Vec3 corners[ 8 ];
+            Vec3 worldCorners[ 8 ];
+            MathUtil::GetCorners( localMins[ i ], localMaxs[ i ], corners );
+
+            for (int v = 0; v < 8; ++v)
+            {
+                Matrix44::TransformPoint( corners[ v ], localToWorlds[ i ], &worldCorners[ v ] );
+            }
+
+            Vec3 worldMin, worldMax;
+            MathUtil::GetMinMax( worldCorners, 8, worldMin, worldMax );
+            perBoxVisible[ i ] = frustum.BoxInFrustum( worldMin, worldMax ) ? 1 : 0;
+        }
+    }
+
+    const double perBoxMS = MillisecondsSince( start ) / iterations;
+
+    // Batched path: transforms center and extent, then tests SoA arrays.
+    std::vector< float > bounds( boxCount * 6 );
+    std::vector< unsigned > visibleMask( (boxCount + 31) / 32 );
+    AABBArrays boxes;
+    boxes.centerX = &bounds[ boxCount * 0 ];
+    boxes.centerY = &bounds[ boxCount * 1 ];
+    boxes.centerZ = &bounds[ boxCount * 2 ];
+    boxes.extentX = &bounds[ boxCount * 3 ];
+    boxes.extentY = &bounds[ boxCount * 4 ];
+    boxes.extentZ = &bounds[ boxCount * 5 ];
+
+    start = std::chrono::high_resolution_clock::now();
+
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+        for (unsigned i = 0; i < boxCount; ++i)
+        {
+            Vec3 center, extent;
+            MathUtil::TransformAABB( localMins[ i ], localMaxs[ i ], localToWorlds[ i ], center, extent );
+            bounds[ boxCount * 0 + i ] = center.x;
+            bounds[ boxCount * 1 + i ] = center.y;
+            bounds[ boxCount * 2 + i ] = center.z;
+            bounds[ boxCount * 3 + i ] = extent.x;
+            bounds[ boxCount * 4 + i ] = extent.y;
+            bounds[ boxCount * 5 + i ] = extent.z;
+        }
+
+        frustum.BoxesInFrustum( boxes, boxCount, visibleMask.data() );
+    }
+
+    const double batchedMS = MillisecondsSince( start ) / iterations;
+
+    // Frustum test only, with bounds already in world space.
+    std::vector< Vec3 > worldMins( boxCount );
+    std::vector< Vec3 > worldMaxs( boxCount );
+
+    for (unsigned i = 0; i < boxCount; ++i)
+    {
+        const Vec3 center( boxes.centerX[ i ], boxes.centerY[ i ], boxes.centerZ[ i ] );
+        const Vec3 extent( boxes.extentX[ i ], boxes.extentY[ i ], boxes.extentZ[ i ] );
+        worldMins[ i ] = center - extent;
+        worldMaxs[ i ] = center + extent;
+    }
+
+    unsigned visibleCount = 0;
+    start = std::chrono::high_resolution_clock::now();
+
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+        visibleCount = 0;
+
+        for (unsigned i = 0; i < boxCount; ++i)
+        {
+            visibleCount += frustum.BoxInFrustum( worldMins[ i ], worldMaxs[ i ] ) ? 1 : 0;
+        }
+    }
+
+    const double perBoxTestMS = MillisecondsSince( start ) / iterations;
+
+    start = std::chrono::high_resolution_clock::now();
+
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+        frustum.BoxesInFrustum( boxes, boxCount, visibleMask.data() );
+    }
+
+    const double batchedTestMS = MillisecondsSince( start ) / iterations;
+
+    unsigned mismatchCount = 0;
+
+    for (unsigned i = 0; i < boxCount; ++i)
+    {
+        const unsigned char batchedVisible = (visibleMask[ i / 32 ] >> (i % 32)) & 1;
+        mismatchCount += batchedVisible != perBoxVisible[ i ] ? 1 : 0;
+    }
+
+    std::printf( "%u boxes, %u visible, %u mismatches\n", boxCount, visibleCount, mismatchCount );
+    std::printf( "transform and test: per box %.3f ms, batched %.3f ms\n", perBoxMS, batchedMS );
+    std::printf( "test only:          per box %.3f ms, batched %.3f ms\n", perBoxTestMS, batchedTestMS );
+
+    return mismatchCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+// Builds small render graphs and checks their culled passes, transient texture sharing and transitions.
+// Build the engine with Makefile_Null first, then "make rendergraph".
+#include <cstdio>
+#include <string>
+#include "RenderGraph.hpp"
+#include "RenderTexture.hpp"
+
+using namespace ae3d;
+
+int main()
+{
+    bool success = true;
+    std::string executedPasses;
+
+    RenderTexture shadowMap;
+    shadowMap.Create2D( 512, 512, RenderTexture::DataType::R32G32, TextureWrap::Clamp, TextureFilter::Linear, "shadowMap" );
+
+    RenderGraph::TextureDesc depthNormalsDesc;
+    depthNormalsDesc.width = 640;
+    depthNormalsDesc.height = 360;
+    depthNormalsDesc.dataType = RenderTexture::DataType::Float;
+
+    RenderGraph graph;
+
+    for (int frame = 0; frame < 2; ++frame)
+    {
+        executedPasses.clear();
+        graph.Reset();
+
+        const unsigned backBuffer = graph.ImportTexture( nullptr, true );
+        const unsigned shadowMapResource = graph.ImportTexture( &shadowMap, false );
+        const unsigned lightTiles = graph.ImportBuffer( false );
+        const unsigned depthNormals1 = graph.CreateTexture( depthNormalsDesc );
+        const unsigned depthNormals2 = graph.CreateTexture( depthNormalsDesc );
+        const unsigned unusedTexture = graph.CreateTexture( depthNormalsDesc );
+
+        // Overwritten by the next shadow pass before anything reads it.
+        const unsigned shadowPass1 = graph.AddPass( "shadow 1", RenderGraph::Queue::Graphics, [&]( RenderGraph& ) { executedPasses += "shadow 1,"; } );
+        graph.Write( shadowPass1, shadowMapResource, true );
+
+        const unsigned shadowPass2 = graph.AddPass( "shadow 2", RenderGraph::Queue::Graphics, [&]( RenderGraph& ) { executedPasses += "shadow 2,"; } );
+        graph.Write( shadowPass2, shadowMapResource, true );
+
+        const unsigned depthPass1 = graph.AddPass( "depth 1", RenderGraph::Queue::Graphics, [&]( RenderGraph& ) { executedPasses += "depth 1,"; } );
+        graph.Write( depthPass1, depthNormals1, true );
+
+        const unsigned cullPass1 = graph.AddPass( "cull 1", RenderGraph::Queue::Compute, [&]( RenderGraph& ) { executedPasses += "cull 1,"; } );
+        graph.Read( cullPass1, depthNormals1 );
+        graph.Write( cullPass1, lightTiles, true );
+
+        const unsigned rtPass = graph.AddPass( "rt", RenderGraph::Queue::Graphics, [&]( RenderGraph& ) { executedPasses += "rt,"; } );
+        graph.Read( rtPass, lightTiles );
+        graph.Read( rtPass, shadowMapResource );
+        graph.Write( rtPass, backBuffer, false );
+
+        const unsigned depthPass2 = graph.AddPass( "depth 2", RenderGraph::Queue::Graphics, [&]( RenderGraph& ) { executedPasses += "depth 2,"; } );
+        graph.Write( depthPass2, depthNormals2, true );
+
+        const unsigned cullPass2 = graph.AddPass( "cull 2", RenderGraph::Queue::Compute, [&]( RenderGraph& ) { executedPasses += "cull 2,"; } );
+        graph.Read( cullPass2, depthNormals2 );
+        graph.Write( cullPass2, lightTiles, true );
+
+        // Writes a texture that nothing reads.
+        const unsigned unusedPass = graph.AddPass( "unused", RenderGraph::Queue::Graphics, [&]( RenderGraph& ) { executedPasses += "unused,"; } );
+        graph.Write( unusedPass, unusedTexture, true );
+
+        const unsigned primaryPass = graph.AddPass( "primary", RenderGraph::Queue::Graphics, [&]( RenderGraph& ) { executedPasses += "primary,"; } );
+        graph.Read( primaryPass, lightTiles );
+        graph.Read( primaryPass, shadowMapResource );
+        graph.Write( primaryPass, backBuffer, false );
+
+        graph.Compile();
+        graph.Execute();
+
+        success &= graph.IsCulled( shadowPass1 ) && graph.IsCulled( unusedPass );
+        success &= executedPasses == "shadow 2,depth 1,cull 1,rt,depth 2,cull 2,primary,";
+
+        // Depth and normals textures' lifetimes don't overlap, and the unused texture isn't allocated.
+        success &= graph.GetTexture( depthNormals1 ) == graph.GetTexture( depthNormals2 );
+        success &= graph.GetTexture( unusedTexture ) == nullptr;
+        success &= graph.GetPooledTextureCount() == 1;
+
+        // Shadow map: render target, then pixel shader read. Depth and normals: render target and compute read, twice, because they share a texture.
+        success &= graph.GetTransitionCount() == 6;
+    }
+
+    if (!success)
+    {
+        std::printf( "Render graph culled, shared or transitioned incorrectly. Executed passes: %s\n", executedPasses.c_str() );
+    }
+
+    return success ? 0 : 1;
+}
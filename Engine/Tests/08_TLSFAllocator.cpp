@@ -0,0 +1,87 @@
+// Allocates and frees ranges with TLSFAllocator and checks their alignment, overlap, merging and statistics.
+// Build the engine with Makefile_Null first, then "make tlsf".
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include "TLSFAllocator.hpp"
+
+using namespace ae3d;
+
+struct TestRange
+{
+    std::uint64_t offset;
+    std::uint64_t size;
+    unsigned allocation;
+};
+
+int main()
+{
+    bool success = true;
+    const std::uint64_t blockSize = 1024 * 1024;
+
+    TLSFAllocator allocator( blockSize );
+    success &= allocator.GetFreeSize() == blockSize && allocator.GetLargestFreeSize() == blockSize;
+
+    // Sizes and alignments like those of small buffers and textures.
+    std::vector< TestRange > ranges;
+    std::uint32_t random = 12345;
+
+    for (int i = 0; i < 200; ++i)
+    {
+        random = random * 1664525u + 1013904223u;
+        const std::uint64_t size = 1 + (random >> 8) % 8192;
+        const std::uint64_t alignment = (i % 4 == 0) ? 65536 : 256;
+
+        TestRange range;
+        range.size = size;
+        range.allocation = allocator.Allocate( size, alignment, range.offset );
+
+        if (range.allocation == TLSFAllocator::InvalidAllocation)
+        {
+            break;
+        }
+
+        success &= range.offset % alignment == 0 && range.offset + size <= blockSize;
+        ranges.push_back( range );
+    }
+
+    success &= !ranges.empty();
+
+    for (std::size_t i = 0; i < ranges.size(); ++i)
+    {
+        for (std::size_t j = i + 1; j < ranges.size(); ++j)
+        {
+            const bool overlaps = ranges[ i ].offset < ranges[ j ].offset + ranges[ j ].size && ranges[ j ].offset < ranges[ i ].offset + ranges[ i ].size;
+            success &= !overlaps;
+        }
+    }
+
+    // Every other range is freed, so free memory is fragmented.
+    for (std::size_t i = 0; i < ranges.size(); i += 2)
+    {
+        allocator.Free( ranges[ i ].allocation );
+    }
+
+    success &= allocator.GetLargestFreeSize() < allocator.GetFreeSize();
+
+    for (std::size_t i = 1; i < ranges.size(); i += 2)
+    {
+        allocator.Free( ranges[ i ].allocation );
+    }
+
+    // Freed ranges merge back into one range of the whole block.
+    success &= allocator.GetFreeSize() == blockSize && allocator.GetLargestFreeSize() == blockSize;
+
+    std::uint64_t offset = 0;
+    const unsigned whole = allocator.Allocate( blockSize, 256, offset );
+    success &= whole != TLSFAllocator::InvalidAllocation && offset == 0 && allocator.GetFreeSize() == 0;
+    success &= allocator.Allocate( 256, 256, offset ) == TLSFAllocator::InvalidAllocation;
+    allocator.Free( whole );
+
+    if (!success)
+    {
+        std::printf( "TLSF allocator returned overlapping or misaligned ranges, or didn't merge freed ranges.\n" );
+    }
+
+    return success ? 0 : 1;
+}
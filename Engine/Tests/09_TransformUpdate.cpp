@@ -0,0 +1,147 @@
+// Updates 100k transforms with the 4-wide transform kernel and compares speed and results against a per-transform update.
+// Build with "make transform", which produces a scalar and an SSE3 version.
+// The scalar version is expected to be about 10 % slower than the per-transform update, see TransformKernel.cpp.
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "Matrix.hpp"
+#include "Quaternion.hpp"
+#include "TransformKernel.hpp"
+#include "Vec3.hpp"
+
+using namespace ae3d;
+
+float Random( float min, float max )
+{
+    return min + (max - min) * (static_cast< float >( std::rand() ) / static_cast< float >( RAND_MAX ));
+}
+
+double MillisecondsSince( const std::chrono::high_resolution_clock::time_point& start )
+{
+    return std::chrono::duration< double, std::milli >( std::chrono::high_resolution_clock::now() - start ).count();
+}
+
+int main()
+{
+    const unsigned transformCount = 100000;
+    // Each root has 3 children, so the update runs in two depths like TransformComponent::UpdateLocalMatrices.
+    const unsigned rootCount = transformCount / 4;
+    const int iterations = 20;
+
+    std::vector< TransformChunk* > chunks( (transformCount + TransformChunk::Size - 1) / TransformChunk::Size );
+
+    for (auto& chunk : chunks)
+    {
+        chunk = new TransformChunk();
+    }
+
+    TransformArrays arrays;
+    arrays.chunks = chunks.data();
+
+    for (unsigned i = 0; i < transformCount; ++i)
+    {
+        arrays.LocalPosition( i ) = Vec3( Random( -500, 500 ), Random( -50, 50 ), Random( -500, 500 ) );
+        arrays.LocalRotation( i ).FromAxisAngle( Vec3( Random( -1, 1 ), Random( -1, 1 ), Random( -1, 1 ) ).Normalized(), Random( 0, 360 ) );
+        arrays.LocalScale( i ) = i % 2 == 0 ? 1 : Random( 0.5f, 2 );
+        arrays.Parent( i ) = i < rootCount ? -1 : static_cast< int >( (i - rootCount) / 3 );
+    }
+
+    // Per-transform path, like the update before transforms were stored as structure-of-arrays. It writes the same outputs
+    // as the batched path into per-component storage, like the old TransformComponent did.
+    struct ReferenceTransform
+    {
+        Matrix44 localMatrix;
+        Matrix44 localToWorldMatrix;
+        Quaternion globalRotation;
+        Vec3 globalPosition;
+    };
+
+    std::vector< ReferenceTransform > references( transformCount );
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+        for (unsigned i = 0; i < transformCount; ++i)
+        {
+            ReferenceTransform& reference = references[ i ];
+            Matrix44& local = reference.localMatrix;
+            arrays.LocalRotation( i ).GetMatrix( local );
+            const float scale = arrays.LocalScale( i );
+
+            if (scale != 1)
+            {
+                local.Scale( scale, scale, scale );
+            }
+
+            local.SetTranslation( arrays.LocalPosition( i ) );
+            const int parent = arrays.Parent( i );
+
+            if (parent != -1)
+            {
+                Matrix44::Multiply( local, references[ parent ].localToWorldMatrix, reference.localToWorldMatrix );
+                reference.globalRotation = arrays.LocalRotation( i ) * references[ parent ].globalRotation;
+            }
+            else
+            {
+                reference.localToWorldMatrix = local;
+                reference.globalRotation = arrays.LocalRotation( i );
+            }
+
+            const float* world = reference.localToWorldMatrix.m;
+            reference.globalPosition = Vec3( world[ 12 ], world[ 13 ], world[ 14 ] );
+        }
+    }
+
+    const double perTransformMS = MillisecondsSince( start ) / iterations;
+
+    // Batched path. Roots come before their children, so every batch's parents are up-to-date.
+    start = std::chrono::high_resolution_clock::now();
+
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+        for (unsigned i = 0; i < transformCount; i += 4)
+        {
+            unsigned batch[ 4 ];
+
+            for (unsigned lane = 0; lane < 4; ++lane)
+            {
+                // Roots and children don't share a batch because rootCount is a multiple of 4.
+                batch[ lane ] = i + lane < transformCount ? i + lane : transformCount - 1;
+            }
+
+            UpdateWorldMatrices4( arrays, batch );
+        }
+    }
+
+    const double batchedMS = MillisecondsSince( start ) / iterations;
+
+    unsigned mismatchCount = 0;
+
+    for (unsigned i = 0; i < transformCount; ++i)
+    {
+        bool matches = true;
+
+        for (int element = 0; element < 16; ++element)
+        {
+            matches &= std::fabs( arrays.LocalToWorldMatrix( i ).m[ element ] - references[ i ].localToWorldMatrix.m[ element ] ) < 0.01f;
+        }
+
+        const Quaternion& rotation = arrays.GlobalRotation( i );
+        const Quaternion& referenceRotation = references[ i ].globalRotation;
+        matches &= std::fabs( rotation.x - referenceRotation.x ) < 0.001f && std::fabs( rotation.y - referenceRotation.y ) < 0.001f &&
+                   std::fabs( rotation.z - referenceRotation.z ) < 0.001f && std::fabs( rotation.w - referenceRotation.w ) < 0.001f;
+        mismatchCount += matches ? 0 : 1;
+    }
+
+    for (auto chunk : chunks)
+    {
+        delete chunk;
+    }
+
+    std::printf( "%u transforms, %u mismatches\n", transformCount, mismatchCount );
+    std::printf( "update: per transform %.3f ms, batched %.3f ms\n", perTransformMS, batchedMS );
+
+    return mismatchCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+// Creates, moves and destroys random boxes in AABBTree and compares Query against brute-force frustum tests.
+// Build the engine with Makefile_Null first, then "make aabbtree".
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include "AABBTree.hpp"
+#include "Frustum.hpp"
+#include "Vec3.hpp"
+
+using namespace ae3d;
+
+struct TestBox
+{
+    Vec3 aabbMin;
+    Vec3 aabbMax;
+    int proxy;
+    bool isAlive;
+};
+
+std::uint32_t randomState = 12345;
+
+float Random( float min, float max )
+{
+    randomState = randomState * 1664525u + 1013904223u;
+    return min + (max - min) * static_cast< float >( randomState >> 8 ) / static_cast< float >( 1u << 24 );
+}
+
+int main()
+{
+    bool success = true;
+    const unsigned boxCount = 2000;
+
+    AABBTree tree;
+    std::vector< TestBox > boxes( boxCount );
+
+    for (unsigned i = 0; i < boxCount; ++i)
+    {
+        const Vec3 center( Random( -500, 500 ), Random( -50, 50 ), Random( -500, 500 ) );
+        const Vec3 halfSize( Random( 0.1f, 5 ), Random( 0.1f, 5 ), Random( 0.1f, 5 ) );
+        boxes[ i ].aabbMin = center - halfSize;
+        boxes[ i ].aabbMax = center + halfSize;
+        boxes[ i ].proxy = tree.CreateProxy( boxes[ i ].aabbMin, boxes[ i ].aabbMax, i );
+        boxes[ i ].isAlive = true;
+    }
+
+    Frustum frustum;
+    frustum.SetProjection( 45, 16.0f / 9.0f, 1, 400 );
+
+    std::vector< unsigned > queried;
+    std::vector< unsigned char > queryCounts( boxCount );
+
+    for (int round = 0; round < 50; ++round)
+    {
+        for (unsigned i = 0; i < boxCount; ++i)
+        {
+            TestBox& box = boxes[ i ];
+            const float action = Random( 0, 1 );
+
+            if (!box.isAlive)
+            {
+                // Dead boxes come back now and then, so freed nodes are reused.
+                if (action < 0.2f)
+                {
+                    box.proxy = tree.CreateProxy( box.aabbMin, box.aabbMax, i );
+                    box.isAlive = true;
+                }
+            }
+            else if (action < 0.05f)
+            {
+                tree.DestroyProxy( box.proxy );
+                box.isAlive = false;
+            }
+            else if (action < 0.6f)
+            {
+                // Mostly small movements that stay inside the fattened AABB, and some big jumps.
+                const float distance = action < 0.5f ? 0.5f : 100;
+                const Vec3 offset( Random( -distance, distance ), Random( -distance, distance ), Random( -distance, distance ) );
+                box.aabbMin += offset;
+                box.aabbMax += offset;
+                tree.MoveProxy( box.proxy, box.aabbMin, box.aabbMax );
+            }
+        }
+
+        frustum.Update( Vec3( Random( -100, 100 ), 0, Random( -100, 100 ) ), Vec3( Random( -1, 1 ), Random( -0.2f, 0.2f ), Random( -1, 1 ) ).Normalized() );
+
+        queried.clear();
+        tree.Query( frustum, queried );
+
+        for (auto& count : queryCounts)
+        {
+            count = 0;
+        }
+
+        for (const unsigned userData : queried)
+        {
+            success &= userData < boxCount && boxes[ userData ].isAlive;
+            ++queryCounts[ userData < boxCount ? userData : 0 ];
+        }
+
+        unsigned aliveCount = 0;
+
+        for (unsigned i = 0; i < boxCount; ++i)
+        {
+            const TestBox& box = boxes[ i ];
+            aliveCount += box.isAlive ? 1 : 0;
+
+            // Every visible box is returned exactly once.
+            if (box.isAlive && frustum.BoxInFrustum( box.aabbMin, box.aabbMax ))
+            {
+                success &= queryCounts[ i ] == 1;
+            }
+
+            // Returned boxes are visible when grown by the largest possible fattened AABB, which contains the box
+            // and is at most its size * (1 + 2 * 0.1) + 2 * 0.1 per axis.
+            if (queryCounts[ i ] > 0)
+            {
+                const Vec3 size = box.aabbMax - box.aabbMin;
+                const Vec3 fatSize = size * 1.2f + Vec3( 0.2f, 0.2f, 0.2f );
+                success &= queryCounts[ i ] == 1 && frustum.BoxInFrustum( box.aabbMin - fatSize, box.aabbMax + fatSize );
+            }
+        }
+
+        // Balanced trees of this size are far below this height.
+        success &= aliveCount < 2 || tree.GetHeight() < 40;
+    }
+
+    if (!success)
+    {
+        std::printf( "AABB tree query didn't match brute-force frustum tests.\n" );
+    }
+
+    return success ? 0 : 1;
+}
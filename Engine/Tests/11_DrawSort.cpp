@@ -0,0 +1,147 @@
+// Compares RadixSort against std::stable_sort and checks the order of DrawSortKey keys.
+// Build the engine with Makefile_Null first, then "make drawsort".
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include "DrawSortKey.hpp"
+#include "RadixSort.hpp"
+
+using namespace ae3d;
+
+std::uint64_t randomState = 12345;
+
+std::uint64_t Random64()
+{
+    randomState = randomState * 6364136223846793005ull + 1442695040888963407ull;
+    return randomState;
+}
+
+// Sorts a copy of items with both sorts and compares keys and indices, so stability is checked too.
+bool SortsLikeStableSort( const std::vector< SortKeyIndex >& items )
+{
+    std::vector< SortKeyIndex > radixSorted = items;
+    std::vector< SortKeyIndex > scratch;
+    RadixSort( radixSorted, scratch );
+
+    std::vector< SortKeyIndex > stableSorted = items;
+    std::stable_sort( stableSorted.begin(), stableSorted.end(), []( const SortKeyIndex& a, const SortKeyIndex& b ) { return a.key < b.key; } );
+
+    bool matches = radixSorted.size() == stableSorted.size();
+
+    for (std::size_t i = 0; matches && i < radixSorted.size(); ++i)
+    {
+        matches = radixSorted[ i ].key == stableSorted[ i ].key && radixSorted[ i ].index == stableSorted[ i ].index;
+    }
+
+    return matches;
+}
+
+int main()
+{
+    bool success = true;
+
+    // Random keys, including sizes that skip the sort.
+    for (unsigned count : { 0u, 1u, 2u, 3u, 100u, 10000u })
+    {
+        std::vector< SortKeyIndex > items( count );
+
+        for (unsigned i = 0; i < count; ++i)
+        {
+            items[ i ].key = Random64();
+            items[ i ].index = i;
+        }
+
+        success &= SortsLikeStableSort( items );
+    }
+
+    // Few distinct keys, so many items have equal keys.
+    std::vector< SortKeyIndex > items( 5000 );
+
+    for (unsigned i = 0; i < items.size(); ++i)
+    {
+        items[ i ].key = Random64() % 7 * 0x0101010101010101ull;
+        items[ i ].index = i;
+    }
+
+    success &= SortsLikeStableSort( items );
+
+    // Every byte is equal in all keys, so every pass is skipped.
+    for (unsigned i = 0; i < items.size(); ++i)
+    {
+        items[ i ].key = 0x123456789ABCDEF0ull;
+    }
+
+    success &= SortsLikeStableSort( items );
+
+    // Keys differ only in one byte, so all passes but one are skipped.
+    for (int byte = 0; byte < 8; ++byte)
+    {
+        for (unsigned i = 0; i < items.size(); ++i)
+        {
+            items[ i ].key = 0x123456789ABCDEF0ull ^ ((Random64() & 0xFF) << (byte * 8));
+        }
+
+        success &= SortsLikeStableSort( items );
+    }
+
+    // Transparent keys sort back-to-front, and after all opaque keys.
+    const float farDepth = 400;
+    std::vector< SortKeyIndex > drawKeys;
+    std::vector< float > depths;
+
+    for (unsigned i = 0; i < 1000; ++i)
+    {
+        const float depth = static_cast< float >( Random64() % 100000 ) / 100000.0f * farDepth;
+        const bool isTransparent = i % 2 == 0;
+        const unsigned shaderId = static_cast< unsigned >( Random64() % 2000 );
+        const unsigned materialId = static_cast< unsigned >( Random64() % 5000 );
+        const unsigned meshId = static_cast< unsigned >( Random64() % 70000 );
+        const std::uint64_t quantizedDepth = DrawSortKey::QuantizeDepth( depth, farDepth );
+
+        SortKeyIndex drawKey;
+        drawKey.key = isTransparent ? DrawSortKey::MakeTransparent( shaderId, materialId, meshId, quantizedDepth ) :
+                                      DrawSortKey::MakeOpaque( shaderId, materialId, meshId, quantizedDepth );
+        drawKey.index = i;
+        drawKeys.push_back( drawKey );
+        depths.push_back( depth );
+    }
+
+    // Extreme ids and depths of the opaque queue.
+    SortKeyIndex lastOpaque;
+    lastOpaque.key = DrawSortKey::MakeOpaque( ~0u, ~0u, ~0u, DrawSortKey::QuantizeDepth( farDepth * 2, farDepth ) );
+    lastOpaque.index = static_cast< unsigned >( drawKeys.size() );
+    drawKeys.push_back( lastOpaque );
+    depths.push_back( farDepth );
+
+    std::vector< SortKeyIndex > scratch;
+    RadixSort( drawKeys, scratch );
+
+    bool isTransparentQueue = false;
+    float previousTransparentDepth = farDepth;
+
+    for (const auto& drawKey : drawKeys)
+    {
+        const bool isTransparent = drawKey.index % 2 == 0 && drawKey.index != lastOpaque.index;
+
+        // Once the transparent queue starts, no opaque key follows.
+        success &= !isTransparentQueue || isTransparent;
+        isTransparentQueue = isTransparent;
+
+        if (isTransparent)
+        {
+            // Depths that quantize to the same value can be in any order.
+            success &= depths[ drawKey.index ] <= previousTransparentDepth + farDepth / (1u << DrawSortKey::DepthBits);
+            previousTransparentDepth = depths[ drawKey.index ];
+        }
+    }
+
+    success &= isTransparentQueue;
+
+    if (!success)
+    {
+        std::printf( "RadixSort didn't match std::stable_sort, or draw sort keys were in the wrong order.\n" );
+    }
+
+    return success ? 0 : 1;
+}
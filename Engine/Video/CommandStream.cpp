@@ -0,0 +1,178 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "CommandStream.hpp"
+#include <map>
+#include <sstream>
+#include "ComputeShader.hpp"
+#include "GfxDevice.hpp"
+#include "MeshRendererComponent.hpp"
+#include "Renderer.hpp"
+#include "SpriteRendererComponent.hpp"
+#include "System.hpp"
+#include "TextRendererComponent.hpp"
+
+extern ae3d::Renderer renderer;
+
+namespace GfxDeviceGlobal
+{
+    extern thread_local PerObjectUboStruct perObjectUboStruct;
+}
+
+void ae3d::CommandStream::Clear()
+{
+    commands.clear();
+    matrices.clear();
+}
+
+ae3d::RenderCommand& ae3d::CommandStream::Add( RenderCommand::Type type )
+{
+    commands.emplace_back();
+    commands.back().type = type;
+    return commands.back();
+}
+
+unsigned ae3d::CommandStream::AddMatrix( const Matrix44& matrix )
+{
+    matrices.push_back( matrix );
+    return static_cast< unsigned >( matrices.size() - 1 );
+}
+
+std::string ae3d::CommandStream::GetDump() const
+{
+    // Pointers differ between runs, so objects are dumped as ids. 0 is null.
+    std::map< const void*, unsigned > ids;
+    ids[ nullptr ] = 0;
+
+    auto id = [&]( const void* object )
+    {
+        return ids.insert( std::make_pair( object, static_cast< unsigned >( ids.size() ) ) ).first->second;
+    };
+
+    std::stringstream stream;
+
+    for (const RenderCommand& command : commands)
+    {
+        switch (command.type)
+        {
+        case RenderCommand::Type::BeginPass:
+        {
+            const RenderCommand::BeginPassData& data = command.beginPass;
+            stream << "BeginPass target " << id( data.target ) << " face " << data.cubeMapFace << " viewport " << data.viewport[ 0 ] << " " << data.viewport[ 1 ]
+                   << " " << data.viewport[ 2 ] << " " << data.viewport[ 3 ] << " clear color " << data.clearColor[ 0 ] << " " << data.clearColor[ 1 ] << " "
+                   << data.clearColor[ 2 ] << " flags " << data.clearFlags << "\n";
+            break;
+        }
+        case RenderCommand::Type::EndPass:
+            stream << "EndPass target " << id( command.endPass.target ) << "\n";
+            break;
+        case RenderCommand::Type::PushGroupMarker:
+            stream << "PushGroupMarker " << command.groupMarker.name << "\n";
+            break;
+        case RenderCommand::Type::PopGroupMarker:
+            stream << "PopGroupMarker\n";
+            break;
+        case RenderCommand::Type::SetLight:
+            stream << "SetLight type " << command.setLight.lightType << " color " << command.setLight.color[ 0 ] << " " << command.setLight.color[ 1 ] << " "
+                   << command.setLight.color[ 2 ] << " min ambient " << command.setLight.minAmbient << "\n";
+            break;
+        case RenderCommand::Type::SetLightType:
+            stream << "SetLightType " << command.setLightType.lightType << "\n";
+            break;
+        case RenderCommand::Type::DrawSkybox:
+            stream << "DrawSkybox texture " << id( command.drawSkybox.skyTexture ) << "\n";
+            break;
+        case RenderCommand::Type::DrawSprite:
+            stream << "DrawSprite sprite renderer " << id( command.drawSprite.spriteRenderer ) << "\n";
+            break;
+        case RenderCommand::Type::DrawText:
+            stream << "DrawText text renderer " << id( command.drawText.textRenderer ) << "\n";
+            break;
+        case RenderCommand::Type::DrawSubMesh:
+            stream << "DrawSubMesh mesh renderer " << id( command.drawSubMesh.meshRenderer ) << " submesh " << command.drawSubMesh.subMeshIndex
+                   << " override shader " << id( command.drawSubMesh.overrideShader ) << " override skin shader " << id( command.drawSubMesh.overrideSkinShader ) << "\n";
+            break;
+        case RenderCommand::Type::DrawSubMeshInstanced:
+            stream << "DrawSubMeshInstanced mesh renderer " << id( command.drawSubMeshInstanced.meshRenderer ) << " submesh " << command.drawSubMeshInstanced.subMeshIndex
+                   << " override shader " << id( command.drawSubMeshInstanced.overrideInstancedShader ) << " instances " << command.drawSubMeshInstanced.instanceCount << "\n";
+            break;
+        case RenderCommand::Type::DrawSubMeshIndirect:
+            stream << "DrawSubMeshIndirect mesh renderer " << id( command.drawSubMeshIndirect.meshRenderer ) << " submesh " << command.drawSubMeshIndirect.subMeshIndex
+                   << " draws " << command.drawSubMeshIndirect.firstIndirectDraw << " " << command.drawSubMeshIndirect.indirectDrawCount << "\n";
+            break;
+        case RenderCommand::Type::Dispatch:
+            stream << "Dispatch shader " << id( command.dispatch.shader ) << " groups " << command.dispatch.groupCount[ 0 ] << " " << command.dispatch.groupCount[ 1 ]
+                   << " " << command.dispatch.groupCount[ 2 ] << "\n";
+            break;
+        }
+    }
+
+    return stream.str();
+}
+
+void ae3d::ExecuteCommonCommand( const CommandStream& stream, const RenderCommand& command )
+{
+    switch (command.type)
+    {
+    case RenderCommand::Type::PushGroupMarker:
+        GfxDevice::PushGroupMarker( command.groupMarker.name );
+        break;
+    case RenderCommand::Type::PopGroupMarker:
+        GfxDevice::PopGroupMarker();
+        break;
+    case RenderCommand::Type::SetLight:
+        GfxDeviceGlobal::perObjectUboStruct.camera.lightColor = Vec4( command.setLight.color[ 0 ], command.setLight.color[ 1 ], command.setLight.color[ 2 ], command.setLight.color[ 3 ] );
+        GfxDeviceGlobal::perObjectUboStruct.camera.lightDirection = Vec4( command.setLight.direction[ 0 ], command.setLight.direction[ 1 ], command.setLight.direction[ 2 ],
+                                                                   command.setLight.direction[ 3 ] );
+        GfxDeviceGlobal::perObjectUboStruct.frame.minAmbient = command.setLight.minAmbient;
+        GfxDeviceGlobal::perObjectUboStruct.camera.lightType = static_cast< PerObjectUboStruct::LightType >( command.setLight.lightType );
+        break;
+    case RenderCommand::Type::SetLightType:
+        GfxDeviceGlobal::perObjectUboStruct.camera.lightType = static_cast< PerObjectUboStruct::LightType >( command.setLightType.lightType );
+        break;
+    case RenderCommand::Type::DrawSkybox:
+        renderer.RenderSkybox( command.drawSkybox.skyTexture, stream.GetMatrix( command.drawSkybox.localToClip ) );
+        break;
+    case RenderCommand::Type::DrawSprite:
+        command.drawSprite.spriteRenderer->Render( stream.GetMatrix( command.drawSprite.localToClip ).m );
+        break;
+    case RenderCommand::Type::DrawText:
+        command.drawText.textRenderer->Render( stream.GetMatrix( command.drawText.localToClip ).m );
+        break;
+    case RenderCommand::Type::DrawSubMesh:
+    {
+        const RenderCommand::DrawSubMeshData& data = command.drawSubMesh;
+        data.meshRenderer->RenderSubMesh( data.subMeshIndex, stream.GetMatrix( data.localMatrices ), stream.GetMatrix( data.localMatrices + 1 ),
+                                          stream.GetMatrix( data.localMatrices + 2 ), stream.GetMatrix( data.viewMatrices + 2 ), stream.GetMatrix( data.viewMatrices + 3 ),
+                                          data.overrideShader, data.overrideSkinShader );
+        break;
+    }
+    case RenderCommand::Type::DrawSubMeshInstanced:
+    {
+        const RenderCommand::DrawSubMeshInstancedData& data = command.drawSubMeshInstanced;
+        data.meshRenderer->RenderSubMeshInstanced( data.subMeshIndex, &stream.GetMatrix( data.instanceMatrices ), static_cast< int >( data.instanceCount ),
+                                                   stream.GetMatrix( data.viewMatrices ), stream.GetMatrix( data.viewMatrices + 1 ), stream.GetMatrix( data.viewMatrices + 2 ),
+                                                   stream.GetMatrix( data.viewMatrices + 3 ), data.overrideInstancedShader );
+        break;
+    }
+    case RenderCommand::Type::DrawSubMeshIndirect:
+    {
+#if RENDERER_VULKAN
+        const RenderCommand::DrawSubMeshIndirectData& data = command.drawSubMeshIndirect;
+        data.meshRenderer->RenderSubMeshIndirect( data.subMeshIndex, data.firstIndirectDraw, data.indirectDrawCount, stream.GetMatrix( data.viewMatrices ),
+                                                  stream.GetMatrix( data.viewMatrices + 1 ), stream.GetMatrix( data.viewMatrices + 2 ), stream.GetMatrix( data.viewMatrices + 3 ) );
+#else
+        System::Assert( false, "indirect draws are only supported on Vulkan" );
+#endif
+        break;
+    }
+    case RenderCommand::Type::Dispatch:
+        command.dispatch.shader->Begin();
+        command.dispatch.shader->Dispatch( command.dispatch.groupCount[ 0 ], command.dispatch.groupCount[ 1 ], command.dispatch.groupCount[ 2 ] );
+        command.dispatch.shader->End();
+        break;
+    case RenderCommand::Type::BeginPass:
+    case RenderCommand::Type::EndPass:
+        System::Assert( false, "passes are executed by GfxDevice::ExecuteCommands" );
+        break;
+    }
+}
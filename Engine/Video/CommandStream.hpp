@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Matrix.hpp"
+
+namespace ae3d
+{
+    class ComputeShader;
+    class MeshRendererComponent;
+    class RenderTexture;
+    class Shader;
+    class SpriteRendererComponent;
+    class TextRendererComponent;
+    class TextureCube;
+
+    /// Command recorded by Scene and replayed by GfxDevice::ExecuteCommands. Plain data, so commands can be recorded on any thread and dumped.
+    /// Matrices are indices into the stream's matrices. Pointed-to objects must outlive the stream's execution.
+    struct RenderCommand
+    {
+        enum class Type : std::uint8_t
+        {
+            BeginPass,
+            EndPass,
+            PushGroupMarker,
+            PopGroupMarker,
+            SetLight,
+            SetLightType,
+            DrawSkybox,
+            DrawSprite,
+            DrawText,
+            DrawSubMesh,
+            DrawSubMeshInstanced,
+            DrawSubMeshIndirect,
+            Dispatch
+        };
+
+        /// Sets the render target, viewport and clear color, and clears the target.
+        struct BeginPassData
+        {
+            /// Null for the back buffer.
+            RenderTexture* target;
+            unsigned cubeMapFace;
+            int viewport[ 4 ];
+            float clearColor[ 3 ];
+            /// GfxDevice::ClearFlags. 0 doesn't clear.
+            unsigned clearFlags;
+        };
+
+        /// Ends the pass of the previous BeginPass.
+        struct EndPassData
+        {
+            /// Same as in BeginPass.
+            RenderTexture* target;
+        };
+
+        struct GroupMarkerData
+        {
+            /// Must outlive the stream's execution, like a string literal.
+            const char* name;
+        };
+
+        /// Sets perObjectUboStruct's light for the following draws.
+        struct SetLightData
+        {
+            float color[ 4 ];
+            /// View-space direction of a directional light.
+            float direction[ 4 ];
+            float minAmbient;
+            /// PerObjectUboStruct::LightType.
+            int lightType;
+        };
+
+        /// Sets perObjectUboStruct's light type for the following draws.
+        struct SetLightTypeData
+        {
+            /// PerObjectUboStruct::LightType.
+            int lightType;
+        };
+
+        struct DrawSkyboxData
+        {
+            TextureCube* skyTexture;
+            /// Camera's rotation-only view-projection matrix.
+            unsigned localToClip;
+        };
+
+        struct DrawSpriteData
+        {
+            SpriteRendererComponent* spriteRenderer;
+            unsigned localToClip;
+        };
+
+        struct DrawTextData
+        {
+            TextRendererComponent* textRenderer;
+            unsigned localToClip;
+        };
+
+        /// Draws one submesh with MeshRendererComponent::RenderSubMesh.
+        struct DrawSubMeshData
+        {
+            MeshRendererComponent* meshRenderer;
+            unsigned subMeshIndex;
+            /// Can be null.
+            Shader* overrideShader;
+            /// Can be null.
+            Shader* overrideSkinShader;
+            /// localToView, localToClip and localToWorld.
+            unsigned localMatrices;
+            /// worldToView, worldToClip, shadow camera's view and shadow camera's projection.
+            unsigned viewMatrices;
+        };
+
+        /// Draws a submesh's instances with MeshRendererComponent::RenderSubMeshInstanced.
+        struct DrawSubMeshInstancedData
+        {
+            MeshRendererComponent* meshRenderer;
+            unsigned subMeshIndex;
+            /// Can be null.
+            Shader* overrideInstancedShader;
+            /// Instances' localToWorld matrices.
+            unsigned instanceMatrices;
+            unsigned instanceCount;
+            /// Same as in DrawSubMeshData.
+            unsigned viewMatrices;
+        };
+
+        /// Draws a submesh's draws of the last GfxDevice::CullIndirect with MeshRendererComponent::RenderSubMeshIndirect. Vulkan only.
+        struct DrawSubMeshIndirectData
+        {
+            MeshRendererComponent* meshRenderer;
+            unsigned subMeshIndex;
+            unsigned firstIndirectDraw;
+            unsigned indirectDrawCount;
+            /// Same as in DrawSubMeshData.
+            unsigned viewMatrices;
+        };
+
+        /// Dispatches a compute shader. Must be recorded outside passes.
+        struct DispatchData
+        {
+            ComputeShader* shader;
+            unsigned groupCount[ 3 ];
+        };
+
+        Type type;
+
+        union
+        {
+            BeginPassData beginPass;
+            EndPassData endPass;
+            GroupMarkerData groupMarker;
+            SetLightData setLight;
+            SetLightTypeData setLightType;
+            DrawSkyboxData drawSkybox;
+            DrawSpriteData drawSprite;
+            DrawTextData drawText;
+            DrawSubMeshData drawSubMesh;
+            DrawSubMeshInstancedData drawSubMeshInstanced;
+            DrawSubMeshIndirectData drawSubMeshIndirect;
+            DispatchData dispatch;
+        };
+
+        /// \return True for DrawSubMesh and DrawSubMeshInstanced. A range of them can be recorded in parallel, because they don't change state that later commands read.
+        bool IsSubMeshDraw() const { return type == Type::DrawSubMesh || type == Type::DrawSubMeshInstanced; }
+    };
+
+    /// Rendering commands of a frame, recorded by Scene and replayed by GfxDevice::ExecuteCommands.
+    /// Not thread-safe, but streams can be recorded on different threads.
+    class CommandStream
+    {
+    public:
+        /// Removes all commands and matrices, keeping their memory.
+        void Clear();
+
+        /// \param type Type.
+        /// \return New command. Valid until the next Add.
+        RenderCommand& Add( RenderCommand::Type type );
+
+        /// \param matrix Matrix.
+        /// \return Matrix's index for RenderCommand.
+        unsigned AddMatrix( const Matrix44& matrix );
+
+        /// \return Command count.
+        std::size_t GetCommandCount() const { return commands.size(); }
+
+        /// \param index Index in [0, GetCommandCount()).
+        /// \return Command.
+        const RenderCommand& GetCommand( std::size_t index ) const { return commands[ index ]; }
+
+        /// \param index Matrix index of a command.
+        /// \return Matrix.
+        const Matrix44& GetMatrix( unsigned index ) const { return matrices[ index ]; }
+
+        /// Objects are numbered in the order they first appear, so streams of identical frames produce identical dumps.
+        /// \return Commands in a textual format, one per line.
+        std::string GetDump() const;
+
+    private:
+        std::vector< RenderCommand > commands;
+        std::vector< Matrix44 > matrices;
+    };
+
+    /// Executes a command that behaves the same on all backends. Called by GfxDevice::ExecuteCommands for commands other than BeginPass and EndPass.
+    /// \param stream Stream that contains command.
+    /// \param command Command.
+    void ExecuteCommonCommand( const CommandStream& stream, const RenderCommand& command );
+}
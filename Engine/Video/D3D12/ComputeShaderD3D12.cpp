@@ -10,9 +10,7 @@
 #include "TextureBase.hpp"
 #include "Texture2D.hpp"
 
-extern int AE3D_CB_SIZE;
-
-void TransitionResource( GpuResource& gpuResource, D3D12_RESOURCE_STATES newState );
+void CreateUniformBufferViews( D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle, int instanceCount );
 
 namespace GfxDeviceGlobal
 {
@@ -22,7 +20,7 @@ namespace GfxDeviceGlobal
     extern ID3D12DescriptorHeap* computeCbvSrvUavHeaps[ 3 ];
     extern D3D12_UNORDERED_ACCESS_VIEW_DESC uav1Desc;
     extern ID3D12PipelineState* cachedPSO;
-	extern PerObjectUboStruct perObjectUboStruct;
+	extern thread_local PerObjectUboStruct perObjectUboStruct;
     extern ID3D12Resource* uav1;
 }
 
@@ -57,8 +55,8 @@ void ae3d::ComputeShader::SetUniform( UniformName uniform, float x, float y )
 {
     if( uniform == UniformName::TilesZW )
     {
-        GfxDeviceGlobal::perObjectUboStruct.tilesXY.z = x;
-        GfxDeviceGlobal::perObjectUboStruct.tilesXY.w = y;
+        GfxDeviceGlobal::perObjectUboStruct.frame.tilesXY.z = x;
+        GfxDeviceGlobal::perObjectUboStruct.frame.tilesXY.w = y;
     }
 }
 
@@ -81,17 +79,13 @@ void ae3d::ComputeShader::Dispatch( unsigned groupCountX, unsigned groupCountY,
         Global::psos.push_back( pso );
     }
 
-    SetCBV( 0, (ID3D12Resource*)GfxDevice::GetCurrentConstantBuffer() );
-
     D3D12_CPU_DESCRIPTOR_HANDLE handle = GfxDeviceGlobal::computeCbvSrvUavHeaps[ heapIndex ]->GetCPUDescriptorHandleForHeapStart();
 
-    D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-    cbvDesc.BufferLocation = uniformBuffers[ 0 ]->GetGPUVirtualAddress();
-    cbvDesc.SizeInBytes = AE3D_CB_SIZE;
-    GfxDeviceGlobal::device->CreateConstantBufferView( &cbvDesc, handle );
+    CreateUniformBufferViews( handle, 0 );
 
-    handle.ptr += GfxDeviceGlobal::device->GetDescriptorHandleIncrementSize( D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV );
+    handle.ptr += GfxDeviceGlobal::device->GetDescriptorHandleIncrementSize( D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV ) * UboBlockTracker::BlockCount;
 
+    // Scene's render graph transitions render textures before the passes that read them.
     GfxDeviceGlobal::device->CreateShaderResourceView( textureBuffers[ 0 ], &srvDescs[ 0 ], handle );
 
     handle.ptr += GfxDeviceGlobal::device->GetDescriptorHandleIncrementSize( D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV );
@@ -106,26 +100,12 @@ void ae3d::ComputeShader::Dispatch( unsigned groupCountX, unsigned groupCountY,
 
     GfxDeviceGlobal::device->CreateUnorderedAccessView( uavBuffers[ 0 ], nullptr, &GfxDeviceGlobal::uav1Desc, handle );
 
-    GpuResource depthNormals = {};
-    depthNormals.resource = textureBuffers[ 1 ];
-    depthNormals.usageState = D3D12_RESOURCE_STATE_RENDER_TARGET;
-
-    if (depthNormals.resource != nullptr)
-    {
-        TransitionResource( depthNormals, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE );
-    }
-
     GfxDeviceGlobal::cachedPSO = pso;
     GfxDeviceGlobal::graphicsCommandList->SetPipelineState( pso );
     GfxDeviceGlobal::graphicsCommandList->SetDescriptorHeaps( 1, &GfxDeviceGlobal::computeCbvSrvUavHeaps[ heapIndex ] );
     GfxDeviceGlobal::graphicsCommandList->SetComputeRootSignature( GfxDeviceGlobal::rootSignatureTileCuller );
     GfxDeviceGlobal::graphicsCommandList->SetComputeRootDescriptorTable( 0, GfxDeviceGlobal::computeCbvSrvUavHeaps[ heapIndex ]->GetGPUDescriptorHandleForHeapStart() );
     GfxDeviceGlobal::graphicsCommandList->Dispatch( groupCountX, groupCountY, groupCountZ );
-
-    if (depthNormals.resource != nullptr)
-    {
-        TransitionResource( depthNormals, D3D12_RESOURCE_STATE_RENDER_TARGET );
-    }
 }
 
 void ae3d::ComputeShader::Load( const char* source )
@@ -152,7 +132,6 @@ void ae3d::ComputeShader::Load( const char* /*metalShaderName*/, const FileSyste
 {
     for (int slotIndex = 0; slotIndex < SLOT_COUNT; ++slotIndex)
     {
-        uniformBuffers[ slotIndex ] = nullptr;
         textureBuffers[ slotIndex ] = nullptr;
         uavBuffers[ slotIndex ] = nullptr;
     }
@@ -186,18 +165,6 @@ void ae3d::ComputeShader::SetRenderTexture( unsigned slot, RenderTexture* render
     }
 }
 
-void ae3d::ComputeShader::SetCBV( unsigned slot, ID3D12Resource* buffer )
-{
-    if (slot < SLOT_COUNT)
-    {
-        uniformBuffers[ slot ] = buffer;
-    }
-    else
-    {
-        System::Print( "SetCBV: too high slot, max is 3\n" );
-    }
-}
-
 void ae3d::ComputeShader::SetSRV( unsigned slot, ID3D12Resource* buffer, const D3D12_SHADER_RESOURCE_VIEW_DESC& srvDesc )
 {
     if (slot < SLOT_COUNT)
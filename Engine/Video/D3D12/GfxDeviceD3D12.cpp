@@ -5,10 +5,12 @@
 #include <dxgi1_4.h>
 #include <d3dx12.h>
 #include <pix3.h>
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <sstream>
 #include <cmath>
+#include "CommandStream.hpp"
 #include "ComputeShader.hpp"
 #include "DescriptorHeapManager.hpp"
 #include "Macros.hpp"
@@ -23,13 +25,18 @@
 #include "TextureCube.hpp"
 #include "VertexBuffer.hpp"
 
-int AE3D_CB_SIZE = (D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT * 3 + 80 * 64);
+/// Bytes of the largest uniform block. The constant buffer ring is this much larger than its capacity, so a block's CBV at any allocation is inside it.
+int AE3D_CB_SIZE = sizeof( PerObjectUboStruct::Skin );
+/// Bytes of the constant buffer ring that draws and dispatches suballocate their changed uniform blocks from. It's reset after each frame's fence.
+constexpr std::size_t UBO_RING_CAPACITY = 16 * 1024 * 1024;
+/// Draws' descriptor tables are reused after this many draws.
+constexpr unsigned DRAW_DESCRIPTOR_TABLE_COUNT = 1000;
 
 void DestroyShaders(); // Defined in ShaderD3D12.cpp
 void DestroyComputeShaders(); // Defined in ComputeShaderD3D12.cpp
 float GetFloatAnisotropy( ae3d::Anisotropy anisotropy );
 extern ae3d::Renderer renderer;
-constexpr int RESOURCE_BINDING_COUNT = 10;
+constexpr int RESOURCE_BINDING_COUNT = UboBlockTracker::BlockCount + 9;
 
 namespace WindowGlobal
 {
@@ -57,6 +64,7 @@ namespace ae3d
                 stm << "draw calls: " << ::Statistics::GetDrawCalls() << "\n";
                 stm << "barrier calls: " << ::Statistics::GetBarrierCalls() << "\n";
                 stm << "triangles: " << ::Statistics::GetTriangleCount() << "\n";
+                stm << "occlusion culled: " << ::Statistics::GetOcclusionCulledObjects() << " / " << ::Statistics::GetOcclusionTestedObjects() << " tested\n";
                 stm << "PSO binds: " << ::Statistics::GetPSOBindCalls() << "\n";
 
 				std::strcpy( outStr, stm.str().c_str() );
@@ -179,9 +187,17 @@ namespace GfxDeviceGlobal
     ID3D12Resource* uav1 = nullptr;
     D3D12_UNORDERED_ACCESS_VIEW_DESC uav1Desc = {};
     std::vector< ae3d::VertexBuffer > lineBuffers;
-    std::vector< ID3D12Resource* > constantBuffers;
-    std::vector< ID3D12Resource* > mappedConstantBuffers;
-    int currentConstantBufferIndex = 0;
+    ID3D12Resource* uboRing = nullptr;
+    std::uint8_t* mappedUboRing = nullptr;
+    std::size_t uboRingOffset = 0;
+    /// Incremented when the ring is reset, so blocks of earlier frames are uploaded again.
+    unsigned uboRingSerial = 0;
+    /// Blocks that the thread uploaded last. Draws create their CBVs again if their uniforms haven't changed.
+    thread_local UboBlockTracker uboBlockTracker;
+    thread_local D3D12_GPU_VIRTUAL_ADDRESS uboBlockAddresses[ UboBlockTracker::BlockCount ] = {};
+    /// Bone matrices that skinning has set for the next draw. Consumed by the draw's uniform upload.
+    thread_local int boneMatrixCount = 0;
+    unsigned currentDescriptorTableIndex = 0;
     unsigned frameIndex = 0;
     ae3d::LightTiler lightTiler;
 
@@ -197,7 +213,7 @@ namespace GfxDeviceGlobal
     D3D12_CPU_DESCRIPTOR_HANDLE msaaDepthHandle = {};
     ID3D12DescriptorHeap* computeCbvSrvUavHeaps[ 3 ] = {};
     TimerQuery timerQuery;
-    PerObjectUboStruct perObjectUboStruct;
+    thread_local PerObjectUboStruct perObjectUboStruct;
     ae3d::VertexBuffer uiVertexBuffer;
     std::vector< ae3d::VertexBuffer::VertexPTC > uiVertices( 512 * 1024 );
     std::vector< ae3d::VertexBuffer::Face > uiFaces( 512 * 1024 );
@@ -307,9 +323,42 @@ namespace ae3d
     void CreateRenderer( int samples );
 }
 
-void UploadPerObjectUbo()
+/// Copies the blocks of perObjectUboStruct that changed since the thread's last upload in this frame into the constant buffer ring,
+/// and creates CBVs for all blocks.
+/// \param cpuHandle First of UboBlockTracker::BlockCount consecutive descriptors, for b0-b4.
+/// \param instanceCount Instance count of an instanced draw, or 0. Instanced shaders read a bone matrix per instance.
+void CreateUniformBufferViews( D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle, int instanceCount )
 {
-    memcpy_s( (char*)ae3d::GfxDevice::GetCurrentMappedConstantBuffer(), AE3D_CB_SIZE, &GfxDeviceGlobal::perObjectUboStruct, sizeof( GfxDeviceGlobal::perObjectUboStruct ) );
+    // Skin is most of the uniforms, so only the matrices that skinning or instancing set are uploaded.
+    const int boneMatrixCount = std::max( instanceCount, GfxDeviceGlobal::boneMatrixCount );
+    GfxDeviceGlobal::boneMatrixCount = 0;
+
+    const unsigned changedBlocks = GfxDeviceGlobal::uboBlockTracker.GetChangedBlocks( GfxDeviceGlobal::perObjectUboStruct, boneMatrixCount, GfxDeviceGlobal::uboRingSerial );
+    const UINT incrementSize = GfxDeviceGlobal::device->GetDescriptorHandleIncrementSize( D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV );
+    constexpr std::size_t alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+
+    for (int block = 0; block < UboBlockTracker::BlockCount; ++block)
+    {
+        const UboBlockTracker::Block b = static_cast< UboBlockTracker::Block >( block );
+
+        if ((changedBlocks & (1u << block)) != 0)
+        {
+            const std::size_t size = UboBlockTracker::GetUploadSize( b, boneMatrixCount );
+            ae3d::System::Assert( GfxDeviceGlobal::uboRingOffset + size <= UBO_RING_CAPACITY, "constant buffer ring is full" );
+
+            memcpy_s( GfxDeviceGlobal::mappedUboRing + GfxDeviceGlobal::uboRingOffset, UBO_RING_CAPACITY + AE3D_CB_SIZE - GfxDeviceGlobal::uboRingOffset,
+                      UboBlockTracker::GetBlockData( GfxDeviceGlobal::perObjectUboStruct, b ), size );
+            GfxDeviceGlobal::uboBlockAddresses[ block ] = GfxDeviceGlobal::uboRing->GetGPUVirtualAddress() + GfxDeviceGlobal::uboRingOffset;
+            GfxDeviceGlobal::uboRingOffset += ((size + alignment - 1) / alignment) * alignment;
+        }
+
+        D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
+        cbvDesc.BufferLocation = GfxDeviceGlobal::uboBlockAddresses[ block ];
+        cbvDesc.SizeInBytes = (UINT)(((UboBlockTracker::GetBlockSize( b ) + alignment - 1) / alignment) * alignment);
+        GfxDeviceGlobal::device->CreateConstantBufferView( &cbvDesc, cpuHandle );
+
+        cpuHandle.ptr += incrementSize;
+    }
 }
 
 void WaitForPreviousFrame()
@@ -532,7 +581,7 @@ void CreateRootSignature()
     // Graphics
     {
         CD3DX12_DESCRIPTOR_RANGE descRange1[ 3 ];
-        descRange1[ 0 ].Init( D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0 );
+        descRange1[ 0 ].Init( D3D12_DESCRIPTOR_RANGE_TYPE_CBV, UboBlockTracker::BlockCount, 0 );
         descRange1[ 1 ].Init( D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 8, 0 );
         descRange1[ 2 ].Init( D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 1 );
 		ae3d::System::Assert( descRange1[ 0 ].NumDescriptors + descRange1[ 1 ].NumDescriptors + descRange1[ 2 ].NumDescriptors == RESOURCE_BINDING_COUNT, "Resource count mismatch!" );
@@ -567,7 +616,7 @@ void CreateRootSignature()
     // Tile Culler
     {
         CD3DX12_DESCRIPTOR_RANGE descRange1[ 3 ];
-        descRange1[ 0 ].Init( D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0 );
+        descRange1[ 0 ].Init( D3D12_DESCRIPTOR_RANGE_TYPE_CBV, UboBlockTracker::BlockCount, 0 );
         descRange1[ 1 ].Init( D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3, 0 );
         descRange1[ 2 ].Init( D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0 );
 
@@ -874,57 +923,54 @@ void CreateDepthStencil()
 
 void CreateConstantBuffers()
 {
-    GfxDeviceGlobal::constantBuffers.resize( 10000 );
-    GfxDeviceGlobal::mappedConstantBuffers.resize( GfxDeviceGlobal::constantBuffers.size() );
-    ae3d::System::Assert( DescriptorHeapManager::numDescriptors >= GfxDeviceGlobal::constantBuffers.size(), "There are more constant buffers than descriptors" );
-
-    for (std::size_t bufferIndex = 0; bufferIndex < GfxDeviceGlobal::constantBuffers.size(); ++bufferIndex)
-    {
-        D3D12_HEAP_PROPERTIES prop = {};
-        prop.Type = D3D12_HEAP_TYPE_UPLOAD;
-        prop.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-        prop.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-        prop.CreationNodeMask = 1;
-        prop.VisibleNodeMask = 1;
-
-        D3D12_RESOURCE_DESC buf = {};
-        buf.Alignment = 0;
-        buf.DepthOrArraySize = 1;
-        buf.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-        buf.Flags = D3D12_RESOURCE_FLAG_NONE;
-        buf.Format = DXGI_FORMAT_UNKNOWN;
-        buf.Height = 1;
-        buf.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-        buf.MipLevels = 1;
-        buf.SampleDesc.Count = 1;
-        buf.SampleDesc.Quality = 0;
-        buf.Width = AE3D_CB_SIZE;
-
-        ID3D12Resource* constantBuffer;
-        HRESULT hr = GfxDeviceGlobal::device->CreateCommittedResource(
-            &prop,
-            D3D12_HEAP_FLAG_NONE,
-            &buf,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS( &constantBuffer ) );
-        if (FAILED( hr ))
-        {
-            ae3d::System::Print( "Unable to create shader constant buffer!" );
-            return;
-        }
+    // Draws' descriptor tables are indexed from the start of the heap.
+    const unsigned tableDescriptorCount = DRAW_DESCRIPTOR_TABLE_COUNT * RESOURCE_BINDING_COUNT;
+    ae3d::System::Assert( DescriptorHeapManager::numDescriptors >= tableDescriptorCount, "There are more descriptor table descriptors than descriptors" );
+
+    for (unsigned descriptorIndex = 0; descriptorIndex < tableDescriptorCount; ++descriptorIndex)
+    {
+        DescriptorHeapManager::AllocateDescriptor( D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV );
+    }
+
+    D3D12_HEAP_PROPERTIES prop = {};
+    prop.Type = D3D12_HEAP_TYPE_UPLOAD;
+    prop.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    prop.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    prop.CreationNodeMask = 1;
+    prop.VisibleNodeMask = 1;
+
+    D3D12_RESOURCE_DESC buf = {};
+    buf.Alignment = 0;
+    buf.DepthOrArraySize = 1;
+    buf.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    buf.Flags = D3D12_RESOURCE_FLAG_NONE;
+    buf.Format = DXGI_FORMAT_UNKNOWN;
+    buf.Height = 1;
+    buf.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    buf.MipLevels = 1;
+    buf.SampleDesc.Count = 1;
+    buf.SampleDesc.Quality = 0;
+    buf.Width = UBO_RING_CAPACITY + AE3D_CB_SIZE;
 
-        constantBuffer->SetName( L"ConstantBuffer" );
-
-        auto handle = DescriptorHeapManager::AllocateDescriptor( D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV );
+    HRESULT hr = GfxDeviceGlobal::device->CreateCommittedResource(
+        &prop,
+        D3D12_HEAP_FLAG_NONE,
+        &buf,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS( &GfxDeviceGlobal::uboRing ) );
+    if (FAILED( hr ))
+    {
+        ae3d::System::Print( "Unable to create shader constant buffer!" );
+        return;
+    }
 
-        GfxDeviceGlobal::constantBuffers[ bufferIndex ] = constantBuffer;
+    GfxDeviceGlobal::uboRing->SetName( L"ConstantBuffer ring" );
 
-        hr = constantBuffer->Map( 0, nullptr, reinterpret_cast<void**>( &GfxDeviceGlobal::mappedConstantBuffers[ bufferIndex ] ) );
-        if (FAILED( hr ))
-        {
-            ae3d::System::Print( "Unable to map shader constant buffer!" );
-        }
+    hr = GfxDeviceGlobal::uboRing->Map( 0, nullptr, reinterpret_cast<void**>( &GfxDeviceGlobal::mappedUboRing ) );
+    if (FAILED( hr ))
+    {
+        ae3d::System::Print( "Unable to map shader constant buffer!" );
     }
 }
 
@@ -1124,21 +1170,6 @@ void ae3d::GfxDevice::SetPolygonOffset( bool enable, float, float )
     }
 }
 
-void ae3d::GfxDevice::CreateNewUniformBuffer()
-{
-    GfxDeviceGlobal::currentConstantBufferIndex = (GfxDeviceGlobal::currentConstantBufferIndex + 1) % GfxDeviceGlobal::mappedConstantBuffers.size();
-}
-
-void* ae3d::GfxDevice::GetCurrentMappedConstantBuffer()
-{
-    return GfxDeviceGlobal::mappedConstantBuffers[ GfxDeviceGlobal::currentConstantBufferIndex ];
-}
-
-void* ae3d::GfxDevice::GetCurrentConstantBuffer()
-{
-    return GfxDeviceGlobal::constantBuffers[ GfxDeviceGlobal::currentConstantBufferIndex ];
-}
-
 void ae3d::GfxDevice::PushGroupMarker( const char* name )
 {
 	PIXBeginEvent( GfxDeviceGlobal::graphicsCommandList, 0, name );
@@ -1162,6 +1193,14 @@ void ae3d::GfxDevice::DrawLines( int handle, Shader& shader )
 void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startFace, int endFace, Shader& shader, BlendMode blendMode, DepthFunc depthFunc,
                             CullMode cullMode, FillMode fillMode, PrimitiveTopology topology )
 {
+    DrawInstanced( vertexBuffer, startFace, endFace, shader, blendMode, depthFunc, cullMode, fillMode, topology, 1 );
+}
+
+void ae3d::GfxDevice::DrawInstanced( VertexBuffer& vertexBuffer, int startFace, int endFace, Shader& shader, BlendMode blendMode, DepthFunc depthFunc,
+                                     CullMode cullMode, FillMode fillMode, PrimitiveTopology topology, int instanceCount )
+{
+    System::Assert( instanceCount > 0 && instanceCount <= PerObjectUboStruct::MaxInstances, "Invalid instance count" );
+
     DXGI_FORMAT rtvFormat = GfxDeviceGlobal::currentRenderTarget ? GfxDeviceGlobal::currentRenderTarget->GetDXGIFormat() : DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
     
     if (GfxDeviceGlobal::sampleCount > 1)
@@ -1185,17 +1224,24 @@ void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startFace, int endFa
         CreatePSO( vertexBuffer.GetVertexFormat(), shader, blendMode, depthFunc, cullMode, fillMode, rtvFormat, GfxDeviceGlobal::currentRenderTarget ? 1 : GfxDeviceGlobal::sampleCount, topology );
     }
 
-    const unsigned index = (GfxDeviceGlobal::currentConstantBufferIndex * RESOURCE_BINDING_COUNT) % GfxDeviceGlobal::constantBuffers.size();
+    GfxDeviceGlobal::currentDescriptorTableIndex = (GfxDeviceGlobal::currentDescriptorTableIndex + 1) % DRAW_DESCRIPTOR_TABLE_COUNT;
+    const unsigned index = GfxDeviceGlobal::currentDescriptorTableIndex * RESOURCE_BINDING_COUNT;
 
     D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = DescriptorHeapManager::GetCbvSrvUavCpuHandle( index );
 
-    D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-    cbvDesc.BufferLocation = GfxDeviceGlobal::constantBuffers[ GfxDeviceGlobal::currentConstantBufferIndex ]->GetGPUVirtualAddress();
-    cbvDesc.SizeInBytes = AE3D_CB_SIZE;
-    GfxDeviceGlobal::device->CreateConstantBufferView( &cbvDesc, cpuHandle );
+    const unsigned activePointLights = GfxDeviceGlobal::lightTiler.GetPointLightCount();
+    const unsigned activeSpotLights = GfxDeviceGlobal::lightTiler.GetSpotLightCount();
+    const unsigned numLights = ((activeSpotLights & 0xFFFFu) << 16) | (activePointLights & 0xFFFFu);
+
+    GfxDeviceGlobal::perObjectUboStruct.frame.windowWidth = GfxDeviceGlobal::backBufferWidth;
+    GfxDeviceGlobal::perObjectUboStruct.frame.windowHeight = GfxDeviceGlobal::backBufferHeight;
+    GfxDeviceGlobal::perObjectUboStruct.frame.numLights = numLights;
+    GfxDeviceGlobal::perObjectUboStruct.frame.maxNumLightsPerTile = GfxDeviceGlobal::lightTiler.GetMaxNumLightsPerTile();
+
+    CreateUniformBufferViews( cpuHandle, instanceCount );
 
 	const UINT incrementSize = GfxDeviceGlobal::device->GetDescriptorHandleIncrementSize( D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV );
-	cpuHandle.ptr += incrementSize;
+	cpuHandle.ptr += incrementSize * UboBlockTracker::BlockCount;
     GfxDeviceGlobal::device->CreateShaderResourceView( GfxDeviceGlobal::texture0->GetGpuResource()->resource, GfxDeviceGlobal::texture0->GetSRVDesc(), cpuHandle );
 
     cpuHandle.ptr += incrementSize;
@@ -1229,15 +1275,6 @@ void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startFace, int endFa
 
         cpuHandle.ptr += incrementSize;
         GfxDeviceGlobal::device->CreateShaderResourceView( GfxDeviceGlobal::textureCube->GetGpuResource()->resource, GfxDeviceGlobal::textureCube->GetSRVDesc(), cpuHandle ); // t7
-
-        const unsigned activePointLights = GfxDeviceGlobal::lightTiler.GetPointLightCount();
-        const unsigned activeSpotLights = GfxDeviceGlobal::lightTiler.GetSpotLightCount();
-        const unsigned numLights = ((activeSpotLights & 0xFFFFu) << 16) | (activePointLights & 0xFFFFu);
-
-        GfxDeviceGlobal::perObjectUboStruct.windowWidth = GfxDeviceGlobal::backBufferWidth;
-        GfxDeviceGlobal::perObjectUboStruct.windowHeight = GfxDeviceGlobal::backBufferHeight;
-        GfxDeviceGlobal::perObjectUboStruct.numLights = numLights;
-        GfxDeviceGlobal::perObjectUboStruct.maxNumLightsPerTile = GfxDeviceGlobal::lightTiler.GetMaxNumLightsPerTile();
     }
     else
     {
@@ -1292,18 +1329,16 @@ void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startFace, int endFa
     GfxDeviceGlobal::graphicsCommandList->IASetIndexBuffer( topology == PrimitiveTopology::Lines ? nullptr : vertexBuffer.GetIndexView() );
     GfxDeviceGlobal::graphicsCommandList->IASetPrimitiveTopology( topology == PrimitiveTopology::Lines ? D3D_PRIMITIVE_TOPOLOGY_LINELIST : D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
 
-    UploadPerObjectUbo();
-
     if (topology == PrimitiveTopology::Triangles)
     {
-        GfxDeviceGlobal::graphicsCommandList->DrawIndexedInstanced( endFace * 3 - startFace * 3, 1, startFace * 3, 0, 0 );
+        GfxDeviceGlobal::graphicsCommandList->DrawIndexedInstanced( endFace * 3 - startFace * 3, instanceCount, startFace * 3, 0, 0 );
     }
     else
     {
-        GfxDeviceGlobal::graphicsCommandList->DrawInstanced( endFace / 6 - startFace / 6, 1, startFace / 6, 0 );
+        GfxDeviceGlobal::graphicsCommandList->DrawInstanced( endFace / 6 - startFace / 6, instanceCount, startFace / 6, 0 );
     }
 
-    Statistics::IncTriangleCount( endFace - startFace );
+    Statistics::IncTriangleCount( (endFace - startFace) * instanceCount );
     Statistics::IncDrawCalls();
 }
 
@@ -1386,10 +1421,7 @@ void ae3d::GfxDevice::ReleaseGPUObjects()
 
     GfxDeviceGlobal::lightTiler.DestroyBuffers();
 
-    for (std::size_t cbInd = 0; cbInd < GfxDeviceGlobal::constantBuffers.size(); ++cbInd)
-    {
-        AE3D_SAFE_RELEASE( GfxDeviceGlobal::constantBuffers[ cbInd ] );
-    }
+    AE3D_SAFE_RELEASE( GfxDeviceGlobal::uboRing );
 
     /*ID3D12DebugDevice* d3dDebug = nullptr;
     GfxDeviceGlobal::device->QueryInterface( IID_PPV_ARGS( &d3dDebug ) );
@@ -1520,6 +1552,9 @@ void ae3d::GfxDevice::Present()
 
     WaitForPreviousFrame();
 
+    GfxDeviceGlobal::uboRingOffset = 0;
+    ++GfxDeviceGlobal::uboRingSerial;
+
     hr = GfxDeviceGlobal::commandListAllocator->Reset();
     AE3D_CHECK_D3D( hr, "commandListAllocator Reset" );
 
@@ -1569,3 +1604,56 @@ void ae3d::GfxDevice::SetRenderTarget( RenderTexture* target, unsigned cubeMapFa
         TransitionResource( *target->GetGpuResource(), D3D12_RESOURCE_STATE_RENDER_TARGET );
     }
 }
+
+void ae3d::GfxDevice::ExecuteCommands( const CommandStream& stream, std::size_t firstCommand )
+{
+    for (std::size_t i = firstCommand; i < stream.GetCommandCount(); ++i)
+    {
+        const RenderCommand& command = stream.GetCommand( i );
+
+        if (command.type == RenderCommand::Type::BeginPass)
+        {
+            const RenderCommand::BeginPassData& data = command.beginPass;
+            int viewport[ 4 ] = { data.viewport[ 0 ], data.viewport[ 1 ], data.viewport[ 2 ], data.viewport[ 3 ] };
+
+            SetClearColor( data.clearColor[ 0 ], data.clearColor[ 1 ], data.clearColor[ 2 ] );
+            SetRenderTarget( data.target, data.cubeMapFace );
+            SetViewport( viewport );
+
+            // ClearScreen also binds the target.
+            if (data.clearFlags != 0)
+            {
+                ClearScreen( data.clearFlags );
+            }
+        }
+        else if (command.type == RenderCommand::Type::EndPass)
+        {
+            SetRenderTarget( nullptr, 0 );
+        }
+        else
+        {
+            ExecuteCommonCommand( stream, command );
+        }
+    }
+}
+
+void ae3d::GfxDevice::TransitionRenderTexture( RenderTexture* texture, TextureState /*before*/, TextureState after )
+{
+    // GpuResource tracks its own state, so before isn't needed.
+    if (after == TextureState::RenderTarget)
+    {
+        TransitionResource( *texture->GetGpuResource(), D3D12_RESOURCE_STATE_RENDER_TARGET );
+    }
+    else if (after == TextureState::PixelShaderRead)
+    {
+        TransitionResource( *texture->GetGpuResource(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE );
+    }
+    else if (after == TextureState::ComputeShaderRead)
+    {
+        TransitionResource( *texture->GetGpuResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE );
+    }
+}
+
+void ae3d::GfxDevice::FlushOffscreenPasses()
+{
+}
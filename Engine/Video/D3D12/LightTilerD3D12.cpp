@@ -11,8 +11,6 @@
 #include "System.hpp"
 #include "Vec3.hpp"
 
-extern int AE3D_CB_SIZE;
-
 using namespace ae3d;
 
 namespace GfxDeviceGlobal
@@ -22,6 +20,7 @@ namespace GfxDeviceGlobal
     extern ID3D12Device* device;
     extern ID3D12Resource* uav1;
     extern D3D12_UNORDERED_ACCESS_VIEW_DESC uav1Desc;
+    extern thread_local PerObjectUboStruct perObjectUboStruct;
 }
 
 void ae3d::LightTiler::DestroyBuffers()
@@ -349,19 +348,15 @@ void ae3d::LightTiler::UpdateLightBuffers()
 
 void ae3d::LightTiler::CullLights( ComputeShader& shader, const Matrix44& projection, const Matrix44& localToView, RenderTexture& depthNormalTarget )
 {
-    GfxDevice::CreateNewUniformBuffer();
-
-    PerObjectUboStruct uniforms;
-
-    Matrix44::Invert( projection, uniforms.clipToView );
+    PerObjectUboStruct& uniforms = GfxDeviceGlobal::perObjectUboStruct;
 
-    uniforms.localToView = localToView;
-    uniforms.windowWidth = depthNormalTarget.GetWidth();
-    uniforms.windowHeight = depthNormalTarget.GetHeight();
-    uniforms.numLights = (((unsigned)activeSpotLights & 0xFFFFu) << 16) | ((unsigned)activePointLights & 0xFFFFu);
-    uniforms.maxNumLightsPerTile = GetMaxNumLightsPerTile();
+    Matrix44::Invert( projection, uniforms.camera.clipToView );
 
-    memcpy_s( ae3d::GfxDevice::GetCurrentMappedConstantBuffer(), AE3D_CB_SIZE, &uniforms, sizeof( PerObjectUboStruct ) );
+    uniforms.object.localToView = localToView;
+    uniforms.frame.windowWidth = depthNormalTarget.GetWidth();
+    uniforms.frame.windowHeight = depthNormalTarget.GetHeight();
+    uniforms.frame.numLights = (((unsigned)activeSpotLights & 0xFFFFu) << 16) | ((unsigned)activePointLights & 0xFFFFu);
+    uniforms.frame.maxNumLightsPerTile = GetMaxNumLightsPerTile();
 
     D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc0 = {};
     srvDesc0.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
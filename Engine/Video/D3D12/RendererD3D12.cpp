@@ -11,7 +11,9 @@ void ae3d::BuiltinShaders::Load()
     skyboxShader.Load( "", "", FileSystem::FileContents( "skybox_vert.obj" ), FileSystem::FileContents( "skybox_frag.obj" ), FileSystem::FileContents( "" ), FileSystem::FileContents( "" ) );
     momentsShader.Load( "", "", FileSystem::FileContents( "moments_vert.obj" ), FileSystem::FileContents( "moments_frag.obj" ), FileSystem::FileContents( "" ), FileSystem::FileContents( "" ) );
     momentsSkinShader.Load( "", "", FileSystem::FileContents( "moments_skin_vert.obj" ), FileSystem::FileContents( "moments_frag.obj" ), FileSystem::FileContents( "" ), FileSystem::FileContents( "" ) );
+    momentsInstancedShader.Load( "", "", FileSystem::FileContents( "moments_instanced_vert.obj" ), FileSystem::FileContents( "moments_frag.obj" ), FileSystem::FileContents( "" ), FileSystem::FileContents( "" ) );
     depthNormalsShader.Load( "", "", FileSystem::FileContents( "depthnormals_vert.obj" ), FileSystem::FileContents( "depthnormals_frag.obj" ), FileSystem::FileContents( "" ), FileSystem::FileContents( "" ) );
+    depthNormalsInstancedShader.Load( "", "", FileSystem::FileContents( "depthnormals_instanced_vert.obj" ), FileSystem::FileContents( "depthnormals_frag.obj" ), FileSystem::FileContents( "" ), FileSystem::FileContents( "" ) );
     uiShader.Load( "", "", FileSystem::FileContents( "sprite_vert.obj" ), FileSystem::FileContents( "sprite_frag.obj" ), FileSystem::FileContents( "" ), FileSystem::FileContents( "" ) );
 
     lightCullShader.Load( "", FileSystem::FileContents( "LightCuller.obj" ), FileSystem::FileContents( "" ) );
@@ -23,7 +23,7 @@ namespace GfxDeviceGlobal
     extern ID3D12Device* device;
     extern ae3d::TextureBase* texture0;
     extern ae3d::TextureBase* texture1;
-	extern PerObjectUboStruct perObjectUboStruct;
+	extern thread_local PerObjectUboStruct perObjectUboStruct;
     extern ae3d::RenderTexture* currentRenderTarget;
 }
 
@@ -258,12 +258,12 @@ void ae3d::Shader::ReflectVariables()
 void ae3d::Shader::Use()
 {
     System::Assert( IsValid(), "Shader not loaded" );
-    GfxDevice::CreateNewUniformBuffer();
 }
 
 void ae3d::Shader::SetUniform( int offset, void* data, int dataBytes )
 {
-    memcpy_s( (char*)GfxDevice::GetCurrentMappedConstantBuffer() + offset, AE3D_CB_SIZE, data, dataBytes );
+    System::Assert( offset + dataBytes <= (int)sizeof( PerObjectUboStruct::Object ), "Uniform is outside the object block" );
+    memcpy_s( (char*)&GfxDeviceGlobal::perObjectUboStruct.object + offset, sizeof( PerObjectUboStruct::Object ) - offset, data, dataBytes );
 }
 
 void ae3d::Shader::SetTexture( ae3d::Texture2D* texture, int textureUnit )
@@ -272,7 +272,7 @@ void ae3d::Shader::SetTexture( ae3d::Texture2D* texture, int textureUnit )
     {
         if( texture != nullptr )
         {
-            GfxDeviceGlobal::perObjectUboStruct.tex0scaleOffset = texture->GetScaleOffset();
+            GfxDeviceGlobal::perObjectUboStruct.material.tex0scaleOffset = texture->GetScaleOffset();
         }
 
         GfxDeviceGlobal::texture0 = texture ? texture : Texture2D::GetDefaultTexture();
@@ -293,7 +293,7 @@ void ae3d::Shader::SetTexture( ae3d::TextureCube* texture, int textureUnit )
     {
         if( texture != nullptr )
         {
-            GfxDeviceGlobal::perObjectUboStruct.tex0scaleOffset = texture->GetScaleOffset();
+            GfxDeviceGlobal::perObjectUboStruct.material.tex0scaleOffset = texture->GetScaleOffset();
         }
 
         GfxDeviceGlobal::texture0 = texture;
@@ -322,7 +322,7 @@ void ae3d::Shader::SetRenderTexture( ae3d::RenderTexture* texture, int textureUn
     {
         if( texture != nullptr )
         {
-            GfxDeviceGlobal::perObjectUboStruct.tex0scaleOffset = texture->GetScaleOffset();
+            GfxDeviceGlobal::perObjectUboStruct.material.tex0scaleOffset = texture->GetScaleOffset();
         }
 
         GfxDeviceGlobal::texture0 = texture;
@@ -1,40 +1,117 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #if RENDERER_METAL
 #import <MetalKit/MetalKit.h>
 #endif
 #include "Matrix.hpp"
 #include "Vec3.hpp"
+#if RENDERER_VULKAN
+#include "VertexBuffer.hpp"
+#endif
 
+/// Shader uniforms, split into blocks by how often they change. Backends upload a block only when it differs from its last upload in the frame,
+/// so a draw that only moves an object uploads the object block. Blocks are bound at b0-b4 in HLSL (object, frame, camera, material, skin).
 struct PerObjectUboStruct
 {
     enum LightType : int { Empty, Spot, Dir, Point };
-    
-    ae3d::Matrix44 localToClip;
-    ae3d::Matrix44 localToView;
-    ae3d::Matrix44 localToWorld;
-    ae3d::Matrix44 localToShadowClip;
-    ae3d::Matrix44 clipToView;
-    ae3d::Vec4 lightPosition;
-    ae3d::Vec4 lightDirection;
-    ae3d::Vec4 lightColor = ae3d::Vec4( 1, 1, 1, 1 );
-    float lightConeAngleCos = 0;
-    LightType lightType = LightType::Empty;
-    float minAmbient = 0.2f;
-    unsigned maxNumLightsPerTile = 0;
-    unsigned windowWidth = 1;
-    unsigned windowHeight = 1;
-    unsigned numLights = 0; // 16 bits for point light count, 16 for spot light count
-    float f0 = 0.8f;
-    ae3d::Vec4 tex0scaleOffset = ae3d::Vec4( 1, 1, 0, 0 );
-    ae3d::Vec4 tilesXY = ae3d::Vec4( 0, 0, 0, 0 );
-    ae3d::Matrix44 boneMatrices[ 80 ];
-    int isVR = 0;
+    static const int MaxBoneMatrices = 80;
+    /// Instanced draws read their localToWorld matrices from the skin block, so a run holds at most one instance per bone matrix.
+    /// A separate instance buffer would lift the cap but add a binding to every backend, while runs rarely reach 80 instances.
+    static const int MaxInstances = MaxBoneMatrices;
+
+    /// Changes when the window, light culling or VR state changes.
+    struct Frame
+    {
+        unsigned windowWidth = 1;
+        unsigned windowHeight = 1;
+        unsigned numLights = 0; // 16 bits for point light count, 16 for spot light count
+        unsigned maxNumLightsPerTile = 0;
+        ae3d::Vec4 tilesXY = ae3d::Vec4( 0, 0, 0, 0 );
+        float minAmbient = 0.2f;
+        int isVR = 0;
+    };
+
+    /// Changes when the camera or the light that is rendered changes. Sprites and text also tint with lightColor.
+    struct Camera
+    {
+        ae3d::Matrix44 clipToView;
+        ae3d::Vec4 lightPosition;
+        ae3d::Vec4 lightDirection;
+        ae3d::Vec4 lightColor = ae3d::Vec4( 1, 1, 1, 1 );
+        float lightConeAngleCos = 0;
+        LightType lightType = LightType::Empty;
+    };
+
+    /// Changes when the material or its first texture changes.
+    struct Material
+    {
+        ae3d::Vec4 tex0scaleOffset = ae3d::Vec4( 1, 1, 0, 0 );
+        float f0 = 0.8f;
+    };
+
+    /// Changes every draw.
+    struct Object
+    {
+        ae3d::Matrix44 localToClip;
+        ae3d::Matrix44 localToView;
+        ae3d::Matrix44 localToWorld;
+        ae3d::Matrix44 localToShadowClip;
+    };
+
+    /// Skinned meshes' bone matrices, or instanced draws' localToWorld matrices indexed by instance id.
+    /// Backends upload only the matrices a draw uses.
+    struct Skin
+    {
+        ae3d::Matrix44 boneMatrices[ MaxBoneMatrices ];
+    };
+
+    Frame frame;
+    Camera camera;
+    Material material;
+    Object object;
+    Skin skin;
+};
+
+/// Remembers the uniform blocks that a thread uploaded last, so its next draw can reuse the blocks that didn't change.
+class UboBlockTracker
+{
+public:
+    /// Blocks in their binding order.
+    enum Block { Object, Frame, Camera, Material, Skin, BlockCount };
+
+    /// \param uniforms Uniforms that the next draw reads.
+    /// \param boneMatrixCount Skin matrices that the next draw reads.
+    /// \param serial Identifies the uniform memory that holds the uploads. When it changes, every block must be uploaded again.
+    /// \return Bitmask of ( 1 << Block ) for blocks that must be uploaded. They are remembered as uploaded.
+    unsigned GetChangedBlocks( const PerObjectUboStruct& uniforms, int boneMatrixCount, unsigned serial );
+
+    /// \param uniforms Uniforms.
+    /// \param block Block.
+    /// \return Block's data in uniforms.
+    static const void* GetBlockData( const PerObjectUboStruct& uniforms, Block block );
+
+    /// \param block Block.
+    /// \param boneMatrixCount Skin matrices that the draw reads.
+    /// \return Bytes of block that a draw uploads.
+    static std::size_t GetUploadSize( Block block, int boneMatrixCount );
+
+    /// \param block Block.
+    /// \return Bytes of block that shaders can read, which backends bind.
+    static std::size_t GetBlockSize( Block block );
+
+private:
+    void* GetUploadedBlockData( Block block );
+
+    PerObjectUboStruct uploaded;
+    int uploadedBoneMatrixCount = 0;
+    unsigned uploadedSerial = ~0u;
 };
 
 namespace ae3d
 {
+    class CommandStream;
     class RenderTexture;
     class VertexBuffer;
     class Shader;
@@ -83,6 +160,15 @@ namespace ae3d
             Lines
         };
 
+        /// Render texture's state between passes, tracked by RenderGraph.
+        enum class TextureState
+        {
+            Undefined,
+            RenderTarget,
+            PixelShaderRead,
+            ComputeShaderRead
+        };
+
         void DrawUI( int scX, int scY, int scWidth, int scHeight, int elemCount, int offset );
         void MapUIVertexBuffer( int vertexSize, int indexSize, void** outMappedVertices, void** outMappedIndices );
         void UnmapUIVertexBuffer();
@@ -90,29 +176,44 @@ namespace ae3d
         int CreateLineBuffer( const Vec3* lines, int lineCount, const Vec3& color );
 #if RENDERER_D3D12
         void ResetCommandList();
-        void  CreateNewUniformBuffer();
-        void* GetCurrentMappedConstantBuffer();
-        void* GetCurrentConstantBuffer();
 #endif
 #if RENDERER_METAL
-        static const int UNIFORM_BUFFER_SIZE = sizeof( PerObjectUboStruct ) + 16 * 4;
         void InitMetal( id <MTLDevice> metalDevice, MTKView* view, int sampleCount, int uiVBSize, int uiIBSize );
         void SetCurrentDrawableMetal( MTKView* view );
         void DrawVertexBuffer( id<MTLBuffer> vertexBuffer, id<MTLBuffer> indexBuffer, int elementCount, int indexOffset );
         id <MTLDevice> GetMetalDevice();
         id <MTLLibrary> GetDefaultMetalShaderLibrary();
-        id <MTLBuffer> GetNewUniformBuffer();
-        id <MTLBuffer> GetCurrentUniformBuffer();
         void PresentDrawable();
         void BeginFrame();
         void BeginBackBufferEncoding();
         void EndBackBufferEncoding();
 #endif
 #if RENDERER_VULKAN
+        /// State of a PSO that PrecompilePSOs compiles.
+        struct PSODesc
+        {
+            Shader* shader = nullptr;
+            VertexBuffer::VertexFormat vertexFormat = VertexBuffer::VertexFormat::PTNTC;
+            BlendMode blendMode = BlendMode::Off;
+            DepthFunc depthFunc = DepthFunc::LessOrEqualWriteOn;
+            CullMode cullMode = CullMode::Back;
+            FillMode fillMode = FillMode::Solid;
+            PrimitiveTopology topology = PrimitiveTopology::Triangles;
+            /// Render texture whose render pass the PSO is compiled for, or null for the back buffer.
+            RenderTexture* renderTarget = nullptr;
+        };
+
+        /// Compiles PSOs on job threads, so draws don't compile them on first use. A draw that needs a PSO that is still compiling compiles it too, and the first compiled PSO is kept.
+        /// Call at load time with descs gathered from a scene, like Scene::PrecompilePSOs does, or from the application's own list.
+        /// \param descs PSO states. PSOs that are already compiled or compiling are skipped. Shaders and render textures must outlive the compilation.
+        /// \param descCount Desc count.
+        void PrecompilePSOs( const PSODesc* descs, unsigned descCount );
+        /// \return PSOs that PrecompilePSOs queued and that haven't finished compiling.
+        unsigned GetCompilingPSOCount();
+        /// Waits for PrecompilePSOs' jobs and removes all PSOs, so they are compiled again with reloaded shaders.
         void ResetPSOCache();
-        void GetNewUniformBuffer();
+        /// Creates each frame's uniform ring. Draws suballocate their uniforms from it and bind them with dynamic offsets.
         void CreateUniformBuffers();
-        std::uint8_t* GetCurrentUbo();
         void BeginRenderPassAndCommandBuffer();
         void BeginRenderPass();
         void EndRenderPassAndCommandBuffer();
@@ -122,7 +223,80 @@ namespace ae3d
 #endif
         void ClearScreen( unsigned clearFlags );
         void Draw( VertexBuffer& vertexBuffer, int startIndex, int endIndex, Shader& shader, BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode, PrimitiveTopology topology );
+        /// Draws instanceCount instances. Instanced shaders read instance i's localToWorld from perObjectUboStruct.skin.boneMatrices[ i ].
+        void DrawInstanced( VertexBuffer& vertexBuffer, int startIndex, int endIndex, Shader& shader, BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode, PrimitiveTopology topology, int instanceCount );
         void DrawLines( int handle, Shader& shader );
+        /// Executes commands from firstCommand to the end of stream. Begins and ends passes in the order this backend needs its target, viewport and clear calls.
+        /// \param stream Stream.
+        /// \param firstCommand Index of the first command to execute.
+        void ExecuteCommands( const CommandStream& stream, std::size_t firstCommand );
+        /// Makes a pass's accesses to texture visible to the next pass that accesses it. Called by RenderGraph outside passes, only when the state changes.
+        /// \param texture Texture.
+        /// \param before State of the previous access in the frame, or Undefined before the first one.
+        /// \param after State of the next access.
+        void TransitionRenderTexture( RenderTexture* texture, TextureState before, TextureState after );
+        /// Submits offscreen passes that the backend has batched. Called by RenderGraph after the frame's passes.
+        void FlushOffscreenPasses();
+#if RENDERER_VULKAN
+        /// Instance of a submesh that is culled and drawn on the GPU.
+        struct IndirectInstance
+        {
+            Matrix44 localToWorld;
+            /// Mesh-local AABB.
+            Vec3 aabbMin;
+            /// Mesh-local AABB.
+            Vec3 aabbMax;
+            /// Index of the instance's draw in CullIndirect's draws.
+            unsigned drawIndex = 0;
+        };
+
+        /// Submesh whose instances are culled by CullIndirect and drawn by DrawIndirect.
+        struct IndirectDraw
+        {
+            VertexBuffer* vertexBuffer = nullptr;
+            /// The draw's instances are instances firstInstance to firstInstance + instanceCount - 1 of CullIndirect's instances.
+            unsigned firstInstance = 0;
+            unsigned instanceCount = 0;
+        };
+
+        /// Creates instances that stay in GPU memory between frames, so only changed instances need to be updated. Their values are undefined until updated.
+        /// \param instanceCount Instance count.
+        /// \return Handle, or -1 if the instance buffer doesn't have room.
+        int CreateIndirectInstances( unsigned instanceCount );
+        /// \param handle Handle returned by CreateIndirectInstances. Must not have been given to CullIndirect earlier in the current frame.
+        void ReleaseIndirectInstances( int handle );
+        /// Updates instances. Frames that the GPU is still executing get the update when the CPU starts recording them again.
+        /// Must not be called for a handle that has been given to CullIndirect earlier in the current frame.
+        /// \param handle Handle returned by CreateIndirectInstances.
+        /// \param indices Indices of the updated instances.
+        /// \param instances New values of the updated instances.
+        /// \param count Updated instance count.
+        void UpdateIndirectInstances( int handle, const unsigned* indices, const IndirectInstance* instances, unsigned count );
+        /// Culls instances against worldToClip's frustum in a compute shader that writes the draws' indirect commands.
+        /// Each call uses new memory for the commands until Present, so draws of earlier calls can still be executed.
+        /// \param instances Handle returned by CreateIndirectInstances.
+        /// \param draws Draws.
+        /// \param drawCount Draw count.
+        /// \param worldToClip Camera's view-projection matrix.
+        /// \return False if this frame's indirect buffers don't have room, in which case the caller should draw the instances with DrawInstanced.
+        bool CullIndirect( int instances, const IndirectDraw* draws, unsigned drawCount, const Matrix44& worldToClip );
+        /// Draws the visible instances of draws firstDraw to firstDraw + drawCount - 1 of the last CullIndirect call. The draws must have the same vertex format.
+        /// Indirect shaders read instances' localToWorld from the culler's buffers, like Standard_indirect_vert.
+        void DrawIndirect( unsigned firstDraw, unsigned drawCount, Shader& shader, BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode );
+
+        /// Starts recording draws of the current render pass into secondary command buffers on job threads.
+        /// The calling thread's bound textures and perObjectUboStruct become the initial state of each secondary command buffer.
+        /// \param cmdBufferCount Number of secondary command buffers that will be recorded.
+        /// \return False if the current render pass can't be continued with secondary command buffers, in which case the caller should draw inline.
+        bool BeginParallelRecording( unsigned cmdBufferCount );
+        /// Begins recording the calling thread's draws into a secondary command buffer from the thread's command pool. Can be called from jobs.
+        /// \param cmdBufferIndex Index in [0, cmdBufferCount) of BeginParallelRecording. Command buffers are executed in index order.
+        void BeginSecondaryCommandBuffer( unsigned cmdBufferIndex );
+        /// Ends the calling thread's secondary command buffer and restores the thread's draw state from before BeginSecondaryCommandBuffer.
+        void EndSecondaryCommandBuffer();
+        /// Executes the recorded secondary command buffers in the current render pass, and continues the render pass inline.
+        void EndParallelRecording();
+#endif
 
         void BeginDepthNormalsGpuQuery();
         void EndDepthNormalsGpuQuery();
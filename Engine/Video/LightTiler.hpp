@@ -5,6 +5,7 @@
 #endif
 #if RENDERER_VULKAN
 #include <vulkan/vulkan.h>
+#include "Vulkan/VulkanUtils.hpp"
 #endif
 #include "Vec3.hpp"
 
@@ -45,16 +46,17 @@ namespace ae3d
         unsigned GetMaxNumLightsPerTile() const;
         
 #if RENDERER_VULKAN
-        VkBuffer GetPointLightBuffer() const { return pointLightCenterAndRadiusBuffer; }
-        VkBufferView* GetPointLightBufferView() { return &pointLightBufferView; }
-        VkBuffer GetPointLightColorBuffer() const { return pointLightColorBuffer; }
-        VkBufferView* GetPointLightColorBufferView() { return &pointLightColorView; }
-        VkBuffer GetSpotLightBuffer() const { return spotLightCenterAndRadiusBuffer; }
-        VkBuffer GetSpotLightColorBuffer() const { return spotLightColorBuffer; }
-        VkBufferView* GetSpotLightColorBufferView() { return &spotLightColorView; }
-        VkBufferView* GetSpotLightBufferView() { return &spotLightBufferView; }
-        VkBufferView* GetSpotLightParamsView() { return &spotLightParamsView; }
-        VkBufferView* GetLightIndexBufferView() { return &perTileLightIndexBufferView; }
+        // Light and light index buffers have a copy per frame in flight. UpdateLightBuffers and CullLights record commands that write the copy of GfxDeviceGlobal::frameIndex.
+        VkBuffer GetPointLightBuffer( unsigned frameIndex ) const { return pointLightCenterAndRadiusBuffers[ frameIndex ].buffer; }
+        VkBufferView* GetPointLightBufferView( unsigned frameIndex ) { return &pointLightCenterAndRadiusBuffers[ frameIndex ].view; }
+        VkBuffer GetPointLightColorBuffer( unsigned frameIndex ) const { return pointLightColorBuffers[ frameIndex ].buffer; }
+        VkBufferView* GetPointLightColorBufferView( unsigned frameIndex ) { return &pointLightColorBuffers[ frameIndex ].view; }
+        VkBuffer GetSpotLightBuffer( unsigned frameIndex ) const { return spotLightCenterAndRadiusBuffers[ frameIndex ].buffer; }
+        VkBuffer GetSpotLightColorBuffer( unsigned frameIndex ) const { return spotLightColorBuffers[ frameIndex ].buffer; }
+        VkBufferView* GetSpotLightColorBufferView( unsigned frameIndex ) { return &spotLightColorBuffers[ frameIndex ].view; }
+        VkBufferView* GetSpotLightBufferView( unsigned frameIndex ) { return &spotLightCenterAndRadiusBuffers[ frameIndex ].view; }
+        VkBufferView* GetSpotLightParamsView( unsigned frameIndex ) { return &spotLightParamsBuffers[ frameIndex ].view; }
+        VkBufferView* GetLightIndexBufferView( unsigned frameIndex ) { return &perTileLightIndexBuffers[ frameIndex ].view; }
 #endif
         unsigned GetNumTilesX() const;
         unsigned GetNumTilesY() const;
@@ -78,34 +80,27 @@ namespace ae3d
         ID3D12Resource* spotLightParamsBuffer = nullptr;
 #endif
 #if RENDERER_VULKAN
-        VkBuffer pointLightCenterAndRadiusBuffer = VK_NULL_HANDLE;
-        VkDeviceMemory pointLightCenterAndRadiusMemory = VK_NULL_HANDLE;
-        void* mappedPointLightCenterAndRadiusMemory = nullptr;
-        VkBufferView pointLightBufferView = VK_NULL_HANDLE;
-        
-        VkBuffer pointLightColorBuffer = VK_NULL_HANDLE;
-        VkDeviceMemory pointLightColorMemory = VK_NULL_HANDLE;
-        void* mappedPointLightColorMemory = nullptr;
-        VkBufferView pointLightColorView = VK_NULL_HANDLE;
-
-        VkBuffer spotLightColorBuffer = VK_NULL_HANDLE;
-        VkDeviceMemory spotLightColorMemory = VK_NULL_HANDLE;
-        void* mappedSpotLightColorMemory = nullptr;
-        VkBufferView spotLightColorView = VK_NULL_HANDLE;
+        /// Device-local texel buffer.
+        struct LightBuffer
+        {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            MemoryAllocation memory;
+            VkBufferView view = VK_NULL_HANDLE;
+        };
 
-        VkBuffer spotLightCenterAndRadiusBuffer = VK_NULL_HANDLE;
-        VkDeviceMemory spotLightCenterAndRadiusMemory = VK_NULL_HANDLE;
-        void* mappedSpotLightCenterAndRadiusMemory = nullptr;
-        VkBufferView spotLightBufferView = VK_NULL_HANDLE;
+        /// Creates a buffer for each frame in flight.
+        static void CreateLightBuffers( LightBuffer* buffers, VkDeviceSize size, VkBufferUsageFlags usage, VkFormat format, const char* debugName );
+        static void DestroyLightBuffers( LightBuffer* buffers );
 
-        VkBuffer spotLightParamsBuffer = VK_NULL_HANDLE;
-        VkDeviceMemory spotLightParamsMemory = VK_NULL_HANDLE;
-        void* mappedSpotLightParamsMemory = nullptr;
-        VkBufferView spotLightParamsView = VK_NULL_HANDLE;
-        
-        VkBuffer perTileLightIndexBuffer = VK_NULL_HANDLE;
-        VkDeviceMemory perTileLightIndexBufferMemory = VK_NULL_HANDLE;
-        VkBufferView perTileLightIndexBufferView = VK_NULL_HANDLE;
+        LightBuffer pointLightCenterAndRadiusBuffers[ MAX_FRAMES_IN_FLIGHT ];
+        LightBuffer pointLightColorBuffers[ MAX_FRAMES_IN_FLIGHT ];
+        LightBuffer spotLightColorBuffers[ MAX_FRAMES_IN_FLIGHT ];
+        LightBuffer spotLightCenterAndRadiusBuffers[ MAX_FRAMES_IN_FLIGHT ];
+        LightBuffer spotLightParamsBuffers[ MAX_FRAMES_IN_FLIGHT ];
+        LightBuffer perTileLightIndexBuffers[ MAX_FRAMES_IN_FLIGHT ];
+        /// GfxDeviceGlobal::frameSerial of the last UpdateLightBuffers and CullLights. Later calls in the same frame must wait for the earlier camera's reads.
+        unsigned lightBufferFrameSerial = ~0u;
+        unsigned lightIndexBufferFrameSerial = ~0u;
 #endif
         static const int TileRes = 16;
         static const int MaxLights = 2048;
@@ -10,7 +10,7 @@ ae3d::RenderTexture* ae3d::Material::sTexRT;
 
 namespace GfxDeviceGlobal
 {
-    extern PerObjectUboStruct perObjectUboStruct;
+    extern thread_local PerObjectUboStruct perObjectUboStruct;
 }
 
 bool ae3d::Material::IsValidShader() const
@@ -72,7 +72,7 @@ void ae3d::Material::Apply()
         GfxDevice::SetPolygonOffset( false, 0, 0 );
     }
 
-    GfxDeviceGlobal::perObjectUboStruct.f0 = f0;
+    GfxDeviceGlobal::perObjectUboStruct.material.f0 = f0;
 }
 
 void ae3d::Material::SetShader( Shader* aShader )
@@ -5,13 +5,13 @@
 #include "System.hpp"
 #include "Texture2D.hpp"
 
-void UploadPerObjectUbo();
+void BindComputeUniformBuffers( id<MTLComputeCommandEncoder> encoder );
 
 extern id <MTLCommandQueue> commandQueue;
 
 namespace GfxDeviceGlobal
 {
-    extern PerObjectUboStruct perObjectUboStruct;
+    extern thread_local PerObjectUboStruct perObjectUboStruct;
 }
 
 void ae3d::ComputeShader::Load( const char* source )
@@ -67,8 +67,8 @@ void ae3d::ComputeShader::SetUniform( UniformName uniform, float x, float y )
 {
     if( uniform == UniformName::TilesZW )
     {
-        GfxDeviceGlobal::perObjectUboStruct.tilesXY.z = x;
-        GfxDeviceGlobal::perObjectUboStruct.tilesXY.w = y;
+        GfxDeviceGlobal::perObjectUboStruct.frame.tilesXY.z = x;
+        GfxDeviceGlobal::perObjectUboStruct.frame.tilesXY.w = y;
     }
 }
 
@@ -89,9 +89,6 @@ void ae3d::ComputeShader::Dispatch( unsigned groupCountX, unsigned groupCountY,
     MTLSize threadgroupCounts = MTLSizeMake( 16, 16, 1 );
     MTLSize threadgroups = MTLSizeMake( groupCountX, groupCountY, groupCountZ );
 
-    SetUniformBuffer( 0, GfxDevice::GetCurrentUniformBuffer() );
-    UploadPerObjectUbo();
-    GfxDevice::GetNewUniformBuffer();
     id<MTLCommandBuffer> commandBuffer = [commandQueue commandBuffer];
     commandBuffer.label = @"ComputeCommand";
     
@@ -110,6 +107,8 @@ void ae3d::ComputeShader::Dispatch( unsigned groupCountX, unsigned groupCountY,
         }
     }
 
+    BindComputeUniformBuffers( commandEncoder );
+
     [commandEncoder dispatchThreadgroups:threadgroups threadsPerThreadgroup:threadgroupCounts];
     [commandEncoder endEncoding];
     
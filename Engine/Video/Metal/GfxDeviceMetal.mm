@@ -1,8 +1,10 @@
 #import <Foundation/Foundation.h>
 #import <MetalKit/MetalKit.h>
 #include <string.h>
+#include <algorithm>
 #include <unordered_map>
 #include <vector>
+#include "CommandStream.hpp"
 #include "GfxDevice.hpp"
 #include "LightTiler.hpp"
 #include "Renderer.hpp"
@@ -17,7 +19,12 @@
 float GetFloatAnisotropy( ae3d::Anisotropy anisotropy );
 extern ae3d::Renderer renderer;
 
-constexpr int UboCount = 1400;
+/// Bytes of the uniform ring that draws and dispatches suballocate their changed uniform blocks from.
+constexpr std::size_t UboRingSize = 8 * 1024 * 1024;
+/// Buffer indices of uniform blocks in vertex and fragment functions.
+constexpr NSUInteger UboBlockIndices[ UboBlockTracker::BlockCount ] = { 5, 12, 13, 14, 15 };
+/// Buffer indices of uniform blocks in compute kernels. Their slots start at 0 and light buffers are at 1-3.
+constexpr NSUInteger ComputeUboBlockIndices[ UboBlockTracker::BlockCount ] = { 0, 12, 13, 14, 15 };
 id <MTLDevice> device;
 id <MTLCommandQueue> commandQueue;
 id <MTLLibrary> defaultLibrary;
@@ -81,8 +88,13 @@ namespace GfxDeviceGlobal
     ae3d::GfxDevice::ClearFlags clearFlags = ae3d::GfxDevice::ClearFlags::Depth;
     std::unordered_map< std::uint64_t, id <MTLRenderPipelineState> > psoCache;
     id<MTLSamplerState> samplerStates[ 5 ];
-    id<MTLBuffer> uniformBuffers[ UboCount ];
-    int currentUboIndex;
+    id<MTLBuffer> uboRing;
+    std::size_t uboRingOffset = 0;
+    /// Incremented when the ring wraps, so each thread's blocks are uploaded again before they're overwritten.
+    unsigned uboRingSerial = 0;
+    thread_local UboBlockTracker uboBlockTracker;
+    thread_local NSUInteger uboBlockOffsets[ UboBlockTracker::BlockCount ];
+    thread_local int boneMatrixCount = 0;
     ae3d::RenderTexture::DataType currentRenderTargetDataType = ae3d::RenderTexture::DataType::UByte;
     ae3d::LightTiler lightTiler;
     std::vector< ae3d::VertexBuffer > lineBuffers;
@@ -90,7 +102,7 @@ namespace GfxDeviceGlobal
     MTLScissorRect scissor;
     unsigned frameIndex = 0;
     ae3d::VertexBuffer uiBuffer;
-    PerObjectUboStruct perObjectUboStruct;
+    thread_local PerObjectUboStruct perObjectUboStruct;
     id <MTLRenderPipelineState> cachedPSO;
     
     struct Samplers
@@ -185,15 +197,54 @@ namespace GfxDeviceGlobal
     }
 }
 
-void UploadPerObjectUbo()
+/// Copies the blocks of perObjectUboStruct that changed since the thread's last upload into the uniform ring.
+/// \param instanceCount Instance count of an instanced draw, or 0. Instanced shaders read a bone matrix per instance.
+void UploadPerObjectUbo( int instanceCount )
 {
-    id<MTLBuffer> uniformBuffer = ae3d::GfxDevice::GetCurrentUniformBuffer();
-    uint8_t* bufferPointer = (uint8_t *)[uniformBuffer contents];
+    // Skin is most of the uniforms, so only the matrices that skinning or instancing set are uploaded.
+    const int boneMatrixCount = std::max( instanceCount, GfxDeviceGlobal::boneMatrixCount );
+    GfxDeviceGlobal::boneMatrixCount = 0;
 
-    memcpy( bufferPointer, &GfxDeviceGlobal::perObjectUboStruct, sizeof( GfxDeviceGlobal::perObjectUboStruct ) );
+    constexpr std::size_t alignment = 256;
+
+    if (GfxDeviceGlobal::uboRingOffset + sizeof( PerObjectUboStruct ) + UboBlockTracker::BlockCount * alignment > UboRingSize)
+    {
+        GfxDeviceGlobal::uboRingOffset = 0;
+        ++GfxDeviceGlobal::uboRingSerial;
+    }
+
+    const unsigned changedBlocks = GfxDeviceGlobal::uboBlockTracker.GetChangedBlocks( GfxDeviceGlobal::perObjectUboStruct, boneMatrixCount, GfxDeviceGlobal::uboRingSerial );
+    uint8_t* ringPointer = (uint8_t *)[GfxDeviceGlobal::uboRing contents];
+
+    for (int block = 0; block < UboBlockTracker::BlockCount; ++block)
+    {
+        if ((changedBlocks & (1u << block)) == 0)
+        {
+            continue;
+        }
+
+        const UboBlockTracker::Block b = static_cast< UboBlockTracker::Block >( block );
+        const std::size_t size = UboBlockTracker::GetUploadSize( b, boneMatrixCount );
+
+        memcpy( ringPointer + GfxDeviceGlobal::uboRingOffset, UboBlockTracker::GetBlockData( GfxDeviceGlobal::perObjectUboStruct, b ), size );
 #if !TARGET_OS_IPHONE
-    [uniformBuffer didModifyRange:NSMakeRange( 0, sizeof( GfxDeviceGlobal::perObjectUboStruct ) )];
+        [GfxDeviceGlobal::uboRing didModifyRange:NSMakeRange( GfxDeviceGlobal::uboRingOffset, size )];
 #endif
+        GfxDeviceGlobal::uboBlockOffsets[ block ] = GfxDeviceGlobal::uboRingOffset;
+        GfxDeviceGlobal::uboRingOffset += ((size + alignment - 1) / alignment) * alignment;
+    }
+}
+
+/// Uploads changed uniform blocks and binds all blocks for a dispatch.
+/// \param encoder Encoder of the dispatch.
+void BindComputeUniformBuffers( id<MTLComputeCommandEncoder> encoder )
+{
+    UploadPerObjectUbo( 0 );
+
+    for (int block = 0; block < UboBlockTracker::BlockCount; ++block)
+    {
+        [encoder setBuffer:GfxDeviceGlobal::uboRing offset:GfxDeviceGlobal::uboBlockOffsets[ block ] atIndex:ComputeUboBlockIndices[ block ]];
+    }
 }
 
 namespace ae3d
@@ -216,6 +267,11 @@ namespace ae3d
                 str += "draw calls: ";
                 str += std::to_string( ::Statistics::GetDrawCalls() );
                 str += "\n";
+                str += "occlusion culled: ";
+                str += std::to_string( ::Statistics::GetOcclusionCulledObjects() );
+                str += " / ";
+                str += std::to_string( ::Statistics::GetOcclusionTestedObjects() );
+                str += " tested\n";
                 str += "scene AABB: ";
                 str += std::to_string( ::Statistics::GetSceneAABBTimeMS() );
                 str += "\nmemory: ";
@@ -235,17 +291,6 @@ namespace
     float clearColor[] = { 0, 0, 0, 0 };
 }
 
-id <MTLBuffer> ae3d::GfxDevice::GetNewUniformBuffer()
-{
-    GfxDeviceGlobal::currentUboIndex = (GfxDeviceGlobal::currentUboIndex + 1) % UboCount;
-    return GfxDeviceGlobal::uniformBuffers[ GfxDeviceGlobal::currentUboIndex ];
-}
-
-id <MTLBuffer> ae3d::GfxDevice::GetCurrentUniformBuffer()
-{
-    return GfxDeviceGlobal::uniformBuffers[ GfxDeviceGlobal::currentUboIndex ];
-}
-
 void ae3d::GfxDevice::DrawUI( int scX, int scY, int scWidth, int scHeight, int elemCount, int offset )
 {
     int scissor[ 4 ] = { scX, scY, scWidth, scHeight };
@@ -346,15 +391,13 @@ void ae3d::GfxDevice::InitMetal( id <MTLDevice> metalDevice, MTKView* aView, int
     GfxDeviceGlobal::backBufferHeight = aView.bounds.size.height;
     GfxDeviceGlobal::sampleCount = sampleCount;
     
-    for (std::size_t uboIndex = 0; uboIndex < UboCount; ++uboIndex)
-    {
+    // Skin block's binding is its full size even when fewer matrices were uploaded, so the ring has room for it past its end.
 #if !TARGET_OS_IPHONE
-        GfxDeviceGlobal::uniformBuffers[ uboIndex ] = [GfxDevice::GetMetalDevice() newBufferWithLength:UNIFORM_BUFFER_SIZE options:MTLResourceStorageModeManaged];
+    GfxDeviceGlobal::uboRing = [GfxDevice::GetMetalDevice() newBufferWithLength:UboRingSize + sizeof( PerObjectUboStruct::Skin ) options:MTLResourceStorageModeManaged];
 #else
-        GfxDeviceGlobal::uniformBuffers[ uboIndex ] = [GfxDevice::GetMetalDevice() newBufferWithLength:UNIFORM_BUFFER_SIZE options:MTLResourceCPUCacheModeDefaultCache];
+    GfxDeviceGlobal::uboRing = [GfxDevice::GetMetalDevice() newBufferWithLength:UboRingSize + sizeof( PerObjectUboStruct::Skin ) options:MTLResourceCPUCacheModeDefaultCache];
 #endif
-        GfxDeviceGlobal::uniformBuffers[ uboIndex ].label = @"uniform buffer";
-    }
+    GfxDeviceGlobal::uboRing.label = @"uniform ring";
     
     MTLDepthStencilDescriptor *depthStateDesc = [[MTLDepthStencilDescriptor alloc] init];
     depthStateDesc.depthCompareFunction = MTLCompareFunctionLessEqual;
@@ -663,6 +706,12 @@ void ae3d::GfxDevice::DrawLines( int handle, Shader& shader )
 
 void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startIndex, int endIndex, Shader& shader, BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode, PrimitiveTopology topology )
 {
+    DrawInstanced( vertexBuffer, startIndex, endIndex, shader, blendMode, depthFunc, cullMode, fillMode, topology, 1 );
+}
+
+void ae3d::GfxDevice::DrawInstanced( VertexBuffer& vertexBuffer, int startIndex, int endIndex, Shader& shader, BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode, PrimitiveTopology topology, int instanceCount )
+{
+    System::Assert( instanceCount > 0 && instanceCount <= PerObjectUboStruct::MaxInstances, "Invalid instance count" );
     Statistics::IncDrawCalls();
 
     for (int slot = 0; slot < 4; ++slot)
@@ -694,8 +743,6 @@ void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startIndex, int endI
     }
     
     [renderEncoder setVertexBuffer:vertexBuffer.GetVertexBuffer() offset:0 atIndex:0];
-    [renderEncoder setVertexBuffer:GetCurrentUniformBuffer() offset:0 atIndex:5];
-    [renderEncoder setFragmentBuffer:GetCurrentUniformBuffer() offset:0 atIndex:5];
     
     MTLViewport viewport;
     viewport.originX = GfxDeviceGlobal::viewport[ 0 ];
@@ -706,9 +753,8 @@ void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startIndex, int endI
     viewport.zfar = 1;
     [renderEncoder setViewport:viewport];
     
-    if (shader.GetMetalVertexShaderName() == "standard_vertex")
+    if (shader.GetMetalVertexShaderName() == "standard_vertex" || shader.GetMetalVertexShaderName() == "standard_instanced_vertex")
     {
-        [renderEncoder setFragmentBuffer:GetCurrentUniformBuffer() offset:0 atIndex:5];
         [renderEncoder setFragmentBuffer:GfxDeviceGlobal::lightTiler.GetPerTileLightIndexBuffer() offset:0 atIndex:6];
         [renderEncoder setFragmentBuffer:GfxDeviceGlobal::lightTiler.GetPointLightCenterAndRadiusBuffer() offset:0 atIndex:7];
         [renderEncoder setFragmentBuffer:GfxDeviceGlobal::lightTiler.GetSpotLightCenterAndRadiusBuffer() offset:0 atIndex:8];
@@ -773,19 +819,26 @@ void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startIndex, int endI
         System::Assert( false, "Unhandled vertex format" );
     }
     
-    UploadPerObjectUbo();
-    
+    UploadPerObjectUbo( instanceCount );
+
+    for (int block = 0; block < UboBlockTracker::BlockCount; ++block)
+    {
+        [renderEncoder setVertexBuffer:GfxDeviceGlobal::uboRing offset:GfxDeviceGlobal::uboBlockOffsets[ block ] atIndex:UboBlockIndices[ block ]];
+        [renderEncoder setFragmentBuffer:GfxDeviceGlobal::uboRing offset:GfxDeviceGlobal::uboBlockOffsets[ block ] atIndex:UboBlockIndices[ block ]];
+    }
+
     if (topology == PrimitiveTopology::Triangles)
     {
         [renderEncoder drawIndexedPrimitives:MTLPrimitiveTypeTriangle
                                   indexCount:(endIndex - startIndex) * 3
                                indexType:MTLIndexTypeUInt16
                              indexBuffer:vertexBuffer.GetIndexBuffer()
-                       indexBufferOffset:startIndex * 2 * 3];
+                       indexBufferOffset:startIndex * 2 * 3
+                           instanceCount:instanceCount];
     }
     else // MTLPrimitiveTypeLine
     {
-        [renderEncoder drawPrimitives:MTLPrimitiveTypeLine vertexStart:0 vertexCount:vertexBuffer.GetFaceCount()];
+        [renderEncoder drawPrimitives:MTLPrimitiveTypeLine vertexStart:0 vertexCount:vertexBuffer.GetFaceCount() instanceCount:instanceCount];
     }
 }
 
@@ -900,3 +953,45 @@ void ae3d::GfxDevice::SetRenderTarget( ae3d::RenderTexture* renderTexture, unsig
     GfxDeviceGlobal::cachedPSO = nil;
 }
 
+
+void ae3d::GfxDevice::ExecuteCommands( const CommandStream& stream, std::size_t firstCommand )
+{
+    for (std::size_t i = firstCommand; i < stream.GetCommandCount(); ++i)
+    {
+        const RenderCommand& command = stream.GetCommand( i );
+
+        if (command.type == RenderCommand::Type::BeginPass)
+        {
+            const RenderCommand::BeginPassData& data = command.beginPass;
+            int viewport[ 4 ] = { data.viewport[ 0 ], data.viewport[ 1 ], data.viewport[ 2 ], data.viewport[ 3 ] };
+
+            SetClearColor( data.clearColor[ 0 ], data.clearColor[ 1 ], data.clearColor[ 2 ] );
+            SetViewport( viewport );
+
+            // Clear flags become the load actions of the encoder that SetRenderTarget begins.
+            if (data.clearFlags != 0)
+            {
+                ClearScreen( data.clearFlags );
+            }
+
+            SetRenderTarget( data.target, data.cubeMapFace );
+        }
+        else if (command.type == RenderCommand::Type::EndPass)
+        {
+            SetRenderTarget( nullptr, 0 );
+        }
+        else
+        {
+            ExecuteCommonCommand( stream, command );
+        }
+    }
+}
+
+void ae3d::GfxDevice::TransitionRenderTexture( RenderTexture* /*texture*/, TextureState /*before*/, TextureState /*after*/ )
+{
+    // Metal tracks hazards between encoders.
+}
+
+void ae3d::GfxDevice::FlushOffscreenPasses()
+{
+}
@@ -10,7 +10,7 @@ namespace GfxDeviceGlobal
 {
     extern int backBufferWidth;
     extern int backBufferHeight;
-    extern PerObjectUboStruct perObjectUboStruct;
+    extern thread_local PerObjectUboStruct perObjectUboStruct;
 }
 
 using namespace ae3d;
@@ -64,15 +64,15 @@ void ae3d::LightTiler::CullLights( ComputeShader& shader, const Matrix44& viewTo
 {
     shader.SetRenderTexture( 0, &depthNormalTarget );
 
-    Matrix44::Invert( viewToClip, GfxDeviceGlobal::perObjectUboStruct.clipToView );
+    Matrix44::Invert( viewToClip, GfxDeviceGlobal::perObjectUboStruct.camera.clipToView );
 
-    GfxDeviceGlobal::perObjectUboStruct.localToView = worldToView;
-    GfxDeviceGlobal::perObjectUboStruct.windowWidth = depthNormalTarget.GetWidth();
-    GfxDeviceGlobal::perObjectUboStruct.windowHeight = depthNormalTarget.GetHeight();
-    GfxDeviceGlobal::perObjectUboStruct.numLights = (((unsigned)activeSpotLights & 0xFFFFu) << 16) | ((unsigned)activePointLights & 0xFFFFu);
-    GfxDeviceGlobal::perObjectUboStruct.maxNumLightsPerTile = GetMaxNumLightsPerTile();
-    GfxDeviceGlobal::perObjectUboStruct.tilesXY.x = GetNumTilesX();
-    GfxDeviceGlobal::perObjectUboStruct.tilesXY.y = GetNumTilesY();
+    GfxDeviceGlobal::perObjectUboStruct.object.localToView = worldToView;
+    GfxDeviceGlobal::perObjectUboStruct.frame.windowWidth = depthNormalTarget.GetWidth();
+    GfxDeviceGlobal::perObjectUboStruct.frame.windowHeight = depthNormalTarget.GetHeight();
+    GfxDeviceGlobal::perObjectUboStruct.frame.numLights = (((unsigned)activeSpotLights & 0xFFFFu) << 16) | ((unsigned)activePointLights & 0xFFFFu);
+    GfxDeviceGlobal::perObjectUboStruct.frame.maxNumLightsPerTile = GetMaxNumLightsPerTile();
+    GfxDeviceGlobal::perObjectUboStruct.frame.tilesXY.x = GetNumTilesX();
+    GfxDeviceGlobal::perObjectUboStruct.frame.tilesXY.y = GetNumTilesY();
 
     shader.SetUniformBuffer( 1, pointLightCenterAndRadiusBuffer );
     shader.SetUniformBuffer( 2, perTileLightIndexBuffer);
@@ -10,7 +10,9 @@ void ae3d::BuiltinShaders::Load()
     skyboxShader.LoadFromLibrary( "skybox_vertex", "skybox_fragment" );
     momentsShader.LoadFromLibrary( "moments_vertex", "moments_fragment" );
     momentsSkinShader.LoadFromLibrary( "moments_skin_vertex", "moments_fragment" );
+    momentsInstancedShader.LoadFromLibrary( "moments_instanced_vertex", "moments_fragment" );
     depthNormalsShader.LoadFromLibrary( "depthnormals_vertex", "depthnormals_fragment" );
+    depthNormalsInstancedShader.LoadFromLibrary( "depthnormals_instanced_vertex", "depthnormals_fragment" );
     lightCullShader.Load( "light_culler", FileSystem::FileContents(""), FileSystem::FileContents("") );
     uiShader.LoadFromLibrary( "sprite_vertex", "sprite_fragment" );
 }
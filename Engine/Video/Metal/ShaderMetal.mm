@@ -12,7 +12,7 @@ extern id<MTLTexture> textures[ 5 ];
 namespace GfxDeviceGlobal
 {
     void SetSampler( int textureUnit, ae3d::TextureFilter filter, ae3d::TextureWrap wrap, ae3d::Anisotropy anisotropy );
-    extern PerObjectUboStruct perObjectUboStruct;
+    extern thread_local PerObjectUboStruct perObjectUboStruct;
 }
 
 int ae3d::Shader::GetUniformLocation( const char* name )
@@ -65,7 +65,6 @@ void ae3d::Shader::LoadFromLibrary( const char* vertexShaderName, const char* fr
 void ae3d::Shader::Use()
 {
     System::Assert( IsValid(), "Shader not loaded" );
-    GfxDevice::GetNewUniformBuffer();
 }
 
 void ae3d::Shader::LoadUniforms( MTLRenderPipelineReflection* reflection )
@@ -78,7 +77,7 @@ void ae3d::Shader::LoadUniforms( MTLRenderPipelineReflection* reflection )
         {
             for( MTLStructMember* reflectedUniform in arg.bufferStructType.members )
             {
-                System::Assert( reflectedUniform.offset + 16 * 4 < GfxDevice::UNIFORM_BUFFER_SIZE, "Uniform buffer is too small" );
+                System::Assert( reflectedUniform.offset + 16 * 4 <= sizeof( PerObjectUboStruct::Skin ), "Uniform buffer is too small" );
                 ++count;
             }
         }
@@ -108,7 +107,7 @@ void ae3d::Shader::SetTexture( Texture2D* texture, int textureUnit )
         if (textureUnit == 0)
         {
             textures[ textureUnit ] = texture->GetMetalTexture();
-            GfxDeviceGlobal::perObjectUboStruct.tex0scaleOffset = texture->GetScaleOffset();
+            GfxDeviceGlobal::perObjectUboStruct.material.tex0scaleOffset = texture->GetScaleOffset();
         }
         else if (textureUnit < 5)
         {
@@ -130,7 +129,7 @@ void ae3d::Shader::SetRenderTexture( ae3d::RenderTexture* renderTexture, int tex
         if (textureUnit == 0)
         {
             textures[ 0 ] = renderTexture->GetMetalTexture();
-            GfxDeviceGlobal::perObjectUboStruct.tex0scaleOffset = renderTexture->GetScaleOffset();
+            GfxDeviceGlobal::perObjectUboStruct.material.tex0scaleOffset = renderTexture->GetScaleOffset();
         }
         else if (textureUnit == 1)
         {
@@ -164,7 +163,7 @@ void ae3d::Shader::SetTexture( TextureCube* texture, int textureUnit )
         if (textureUnit == 0)
         {
             textures[ 0 ] = texture->GetMetalTexture();
-            GfxDeviceGlobal::perObjectUboStruct.tex0scaleOffset = texture->GetScaleOffset();
+            GfxDeviceGlobal::perObjectUboStruct.material.tex0scaleOffset = texture->GetScaleOffset();
         }
         else if (textureUnit < 5)
         {
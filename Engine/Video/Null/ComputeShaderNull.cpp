@@ -0,0 +1,59 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "ComputeShader.hpp"
+#include "GfxDevice.hpp"
+#include "System.hpp"
+
+namespace GfxDeviceGlobal
+{
+    extern thread_local PerObjectUboStruct perObjectUboStruct;
+}
+
+void UploadPerObjectUbo( int instanceCount );
+
+void ae3d::ComputeShader::Load( const char* /*source*/ )
+{
+    for (int slot = 0; slot < SLOT_COUNT; ++slot)
+    {
+        renderTextures[ slot ] = nullptr;
+    }
+}
+
+void ae3d::ComputeShader::Load( const char* /*metalShaderName*/, const FileSystem::FileContentsData& /*dataHLSL*/, const FileSystem::FileContentsData& /*dataSPIRV*/ )
+{
+    Load( "" );
+}
+
+void ae3d::ComputeShader::SetUniform( UniformName uniform, float x, float y )
+{
+    if (uniform == UniformName::TilesZW)
+    {
+        GfxDeviceGlobal::perObjectUboStruct.frame.tilesXY.z = x;
+        GfxDeviceGlobal::perObjectUboStruct.frame.tilesXY.w = y;
+    }
+}
+
+void ae3d::ComputeShader::SetRenderTexture( unsigned slot, class RenderTexture* renderTexture )
+{
+    if (slot < SLOT_COUNT)
+    {
+        renderTextures[ slot ] = renderTexture;
+    }
+    else
+    {
+        System::Print( "ComputeShader:SetRenderTexture: Too high slot!\n" );
+    }
+}
+
+void ae3d::ComputeShader::Begin()
+{
+}
+
+void ae3d::ComputeShader::End()
+{
+}
+
+void ae3d::ComputeShader::Dispatch( unsigned /*groupCountX*/, unsigned /*groupCountY*/, unsigned /*groupCountZ*/ )
+{
+    UploadPerObjectUbo( 0 );
+}
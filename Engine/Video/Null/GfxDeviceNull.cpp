@@ -0,0 +1,330 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "GfxDevice.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "CommandStream.hpp"
+#include "LightTiler.hpp"
+#include "RenderTexture.hpp"
+#include "Renderer.hpp"
+#include "Shader.hpp"
+#include "Statistics.hpp"
+#include "System.hpp"
+#include "Texture2D.hpp"
+#include "TextureCube.hpp"
+#include "VertexBuffer.hpp"
+
+// Headless renderer: runs the same CPU work as a real backend (state setup, uniform uploads,
+// statistics) but never touches a GPU. Used for benchmarking Scene::Render and in CI.
+
+extern ae3d::Renderer renderer;
+
+constexpr unsigned UI_VERTICE_COUNT = 512 * 1024;
+constexpr unsigned UI_FACE_COUNT = 128 * 1024;
+
+namespace GfxDeviceGlobal
+{
+    unsigned backBufferWidth;
+    unsigned backBufferHeight;
+    ae3d::LightTiler lightTiler;
+    thread_local PerObjectUboStruct perObjectUboStruct;
+    ae3d::VertexBuffer uiVertexBuffer;
+    ae3d::VertexBuffer::VertexPTC uiVertices[ UI_VERTICE_COUNT ];
+    ae3d::VertexBuffer::Face uiFaces[ UI_FACE_COUNT ];
+    std::vector< ae3d::VertexBuffer > lineBuffers;
+    ae3d::RenderTexture* renderTexture0 = nullptr;
+    // Stands in for the mapped uniform buffer so a draw costs the same memcpys as on a real device.
+    std::uint8_t uboData[ sizeof( PerObjectUboStruct ) ];
+    thread_local UboBlockTracker uboBlockTracker;
+    thread_local int boneMatrixCount = 0;
+    unsigned frameSerial = 0;
+    std::uint64_t boundPSOHash = 0;
+    float clearColor[ 4 ];
+}
+
+/// Copies the blocks of perObjectUboStruct that changed since the thread's last upload into uboData.
+/// \param instanceCount Instance count of the draw, or 0 for a dispatch. Instanced shaders read a bone matrix per instance.
+void UploadPerObjectUbo( int instanceCount )
+{
+    const int boneMatrixCount = std::max( instanceCount, GfxDeviceGlobal::boneMatrixCount );
+    GfxDeviceGlobal::boneMatrixCount = 0;
+
+    const unsigned changedBlocks = GfxDeviceGlobal::uboBlockTracker.GetChangedBlocks( GfxDeviceGlobal::perObjectUboStruct, boneMatrixCount, GfxDeviceGlobal::frameSerial );
+    std::size_t blockOffset = 0;
+
+    for (int block = 0; block < UboBlockTracker::BlockCount; ++block)
+    {
+        const UboBlockTracker::Block b = static_cast< UboBlockTracker::Block >( block );
+
+        if ((changedBlocks & (1u << block)) != 0)
+        {
+            const std::size_t uploadSize = UboBlockTracker::GetUploadSize( b, boneMatrixCount );
+            std::memcpy( &GfxDeviceGlobal::uboData[ blockOffset ], UboBlockTracker::GetBlockData( GfxDeviceGlobal::perObjectUboStruct, b ), uploadSize );
+            Statistics::IncUploads( (int)uploadSize );
+        }
+
+        blockOffset += UboBlockTracker::GetBlockSize( b );
+    }
+}
+
+namespace ae3d
+{
+    namespace System
+    {
+        namespace Statistics
+        {
+            void GetStatistics( char* outStr )
+            {
+                const char* passNames[] = { "other", "shadow", "depth normals", "render texture", "primary" };
+
+                std::string str;
+                str = "frame time: " + std::to_string( ::Statistics::GetFrameTimeMS() ) + " ms\n";
+                str += "shadow pass time CPU: " + std::to_string( ::Statistics::GetShadowMapTimeMS() ) + " ms\n";
+                str += "depth pass time CPU: " + std::to_string( ::Statistics::GetDepthNormalsTimeMS() ) + " ms\n";
+                str += "draw calls: " + std::to_string( ::Statistics::GetDrawCalls() ) + "\n";
+                str += "uploads: " + std::to_string( ::Statistics::GetUploads() ) + " (" + std::to_string( ::Statistics::GetUploadBytes() / 1024 ) + " KiB)\n";
+                str += "triangles: " + std::to_string( ::Statistics::GetTriangleCount() ) + "\n";
+                str += "occlusion culled: " + std::to_string( ::Statistics::GetOcclusionCulledObjects() ) + " / " + std::to_string( ::Statistics::GetOcclusionTestedObjects() ) + " tested\n";
+
+                for (int passIndex = 0; passIndex < (int)::Statistics::Pass::Count; ++passIndex)
+                {
+                    const ::Statistics::Pass pass = (::Statistics::Pass)passIndex;
+                    str += std::string( passNames[ passIndex ] ) + " pass: " + std::to_string( ::Statistics::GetPassDrawCalls( pass ) ) + " draws, " +
+                           std::to_string( ::Statistics::GetPassBinds( pass ) ) + " binds, " + std::to_string( ::Statistics::GetPassUploads( pass ) ) + " uploads\n";
+                }
+
+                std::strcpy( outStr, str.c_str() );
+            }
+        }
+    }
+
+    void CreateRenderer( int /*samples*/ )
+    {
+        GfxDeviceGlobal::uiVertexBuffer.GenerateDynamic( UI_FACE_COUNT, UI_VERTICE_COUNT );
+        GfxDeviceGlobal::lightTiler.Init();
+    }
+}
+
+void ae3d::GfxDevice::Init( int width, int height )
+{
+    GfxDeviceGlobal::backBufferWidth = width;
+    GfxDeviceGlobal::backBufferHeight = height;
+}
+
+void ae3d::GfxDevice::DrawUI( int scX, int scY, int scWidth, int scHeight, int elemCount, int offset )
+{
+    int scissor[ 4 ] = {};
+    scissor[ 0 ] = scX < 0 ? 0 : scX;
+    scissor[ 1 ] = scY < 0 ? 0 : scY;
+    scissor[ 2 ] = scWidth > 8191 ? 8191 : scWidth;
+    scissor[ 3 ] = scHeight > 8191 ? 8191 : scHeight;
+    SetScissor( scissor );
+
+    Draw( GfxDeviceGlobal::uiVertexBuffer, offset, offset + elemCount, renderer.builtinShaders.uiShader, BlendMode::AlphaBlend, DepthFunc::NoneWriteOff, CullMode::Off, FillMode::Solid, GfxDevice::PrimitiveTopology::Triangles );
+}
+
+void ae3d::GfxDevice::MapUIVertexBuffer( int /*vertexSize*/, int /*indexSize*/, void** outMappedVertices, void** outMappedIndices )
+{
+    *outMappedVertices = GfxDeviceGlobal::uiVertices;
+    *outMappedIndices = GfxDeviceGlobal::uiFaces;
+}
+
+void ae3d::GfxDevice::UnmapUIVertexBuffer()
+{
+    GfxDeviceGlobal::uiVertexBuffer.UpdateDynamic( GfxDeviceGlobal::uiFaces, UI_FACE_COUNT, GfxDeviceGlobal::uiVertices, UI_VERTICE_COUNT );
+}
+
+void ae3d::GfxDevice::BeginDepthNormalsGpuQuery()
+{
+}
+
+void ae3d::GfxDevice::EndDepthNormalsGpuQuery()
+{
+}
+
+void ae3d::GfxDevice::BeginShadowMapGpuQuery()
+{
+}
+
+void ae3d::GfxDevice::EndShadowMapGpuQuery()
+{
+}
+
+void ae3d::GfxDevice::BeginLightCullerGpuQuery()
+{
+}
+
+void ae3d::GfxDevice::EndLightCullerGpuQuery()
+{
+}
+
+void ae3d::GfxDevice::SetPolygonOffset( bool, float, float )
+{
+}
+
+void ae3d::GfxDevice::PushGroupMarker( const char* )
+{
+}
+
+void ae3d::GfxDevice::PopGroupMarker()
+{
+}
+
+void ae3d::GfxDevice::SetClearColor( float red, float green, float blue )
+{
+    GfxDeviceGlobal::clearColor[ 0 ] = red;
+    GfxDeviceGlobal::clearColor[ 1 ] = green;
+    GfxDeviceGlobal::clearColor[ 2 ] = blue;
+    GfxDeviceGlobal::clearColor[ 3 ] = 0.0f;
+}
+
+void ae3d::GfxDevice::GetGpuMemoryUsage( unsigned& outUsedMBytes, unsigned& outBudgetMBytes )
+{
+    outUsedMBytes = 0;
+    outBudgetMBytes = 0;
+}
+
+void ae3d::GfxDevice::ClearScreen( unsigned /*clearFlags*/ )
+{
+}
+
+void ae3d::GfxDevice::DrawLines( int handle, Shader& shader )
+{
+    if (handle < 0)
+    {
+        return;
+    }
+
+    Draw( GfxDeviceGlobal::lineBuffers[ handle ], 0, GfxDeviceGlobal::lineBuffers[ handle ].GetFaceCount() / 3, shader, BlendMode::Off, DepthFunc::NoneWriteOff, CullMode::Off, FillMode::Solid, GfxDevice::PrimitiveTopology::Lines );
+}
+
+void ae3d::GfxDevice::SetViewport( int /*viewport*/[ 4 ] )
+{
+}
+
+void ae3d::GfxDevice::SetScissor( int /*scissor*/[ 4 ] )
+{
+}
+
+static std::uint64_t GetPSOHash( ae3d::VertexBuffer& vertexBuffer, ae3d::Shader& shader, ae3d::GfxDevice::BlendMode blendMode, ae3d::GfxDevice::DepthFunc depthFunc,
+                                 ae3d::GfxDevice::CullMode cullMode, ae3d::GfxDevice::FillMode fillMode, ae3d::GfxDevice::PrimitiveTopology topology )
+{
+    std::uint64_t outResult = (std::uint64_t)&shader;
+    outResult += (unsigned)vertexBuffer.GetVertexFormat();
+    outResult += (unsigned)blendMode << 4;
+    outResult += (unsigned)depthFunc << 8;
+    outResult += (unsigned)cullMode << 12;
+    outResult += (unsigned)fillMode << 16;
+    outResult += (unsigned)topology << 20;
+    outResult += (std::uint64_t)GfxDeviceGlobal::renderTexture0;
+
+    return outResult;
+}
+
+void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startIndex, int endIndex, Shader& shader, BlendMode blendMode, DepthFunc depthFunc,
+                            CullMode cullMode, FillMode fillMode, PrimitiveTopology topology )
+{
+    DrawInstanced( vertexBuffer, startIndex, endIndex, shader, blendMode, depthFunc, cullMode, fillMode, topology, 1 );
+}
+
+void ae3d::GfxDevice::DrawInstanced( VertexBuffer& vertexBuffer, int startIndex, int endIndex, Shader& shader, BlendMode blendMode, DepthFunc depthFunc,
+                                     CullMode cullMode, FillMode fillMode, PrimitiveTopology topology, int instanceCount )
+{
+    System::Assert( instanceCount > 0 && instanceCount <= PerObjectUboStruct::MaxInstances, "Invalid instance count" );
+    System::Assert( startIndex > -1 && startIndex <= vertexBuffer.GetFaceCount() / 3, "Invalid vertex buffer draw range in startIndex" );
+    System::Assert( endIndex > -1 && endIndex >= startIndex && endIndex <= vertexBuffer.GetFaceCount() / 3, "Invalid vertex buffer draw range in endIndex" );
+
+    if (!shader.IsValid())
+    {
+        return;
+    }
+
+    const std::uint64_t psoHash = GetPSOHash( vertexBuffer, shader, blendMode, depthFunc, cullMode, fillMode, topology );
+
+    if (psoHash != GfxDeviceGlobal::boundPSOHash)
+    {
+        GfxDeviceGlobal::boundPSOHash = psoHash;
+        Statistics::IncPSOBindCalls();
+    }
+
+    const unsigned activePointLights = GfxDeviceGlobal::lightTiler.GetPointLightCount();
+    const unsigned activeSpotLights = GfxDeviceGlobal::lightTiler.GetSpotLightCount();
+    const unsigned lightCount = ((activeSpotLights & 0xFFFFu) << 16) | (activePointLights & 0xFFFFu);
+
+    GfxDeviceGlobal::perObjectUboStruct.frame.windowWidth = GfxDeviceGlobal::backBufferWidth;
+    GfxDeviceGlobal::perObjectUboStruct.frame.windowHeight = GfxDeviceGlobal::backBufferHeight;
+    GfxDeviceGlobal::perObjectUboStruct.frame.numLights = lightCount;
+    GfxDeviceGlobal::perObjectUboStruct.frame.maxNumLightsPerTile = GfxDeviceGlobal::lightTiler.GetMaxNumLightsPerTile();
+    GfxDeviceGlobal::perObjectUboStruct.frame.tilesXY.x = (float)GfxDeviceGlobal::lightTiler.GetNumTilesX();
+    GfxDeviceGlobal::perObjectUboStruct.frame.tilesXY.y = (float)GfxDeviceGlobal::lightTiler.GetNumTilesY();
+
+    UploadPerObjectUbo( instanceCount );
+
+    Statistics::IncTriangleCount( (endIndex - startIndex) * instanceCount );
+    Statistics::IncDrawCalls();
+}
+
+void ae3d::GfxDevice::Present()
+{
+    ++GfxDeviceGlobal::frameSerial;
+    Statistics::EndFrameTimeProfiling();
+}
+
+void ae3d::GfxDevice::ReleaseGPUObjects()
+{
+    GfxDeviceGlobal::lightTiler.DestroyBuffers();
+    Shader::DestroyShaders();
+    Texture2D::DestroyTextures();
+    TextureCube::DestroyTextures();
+    RenderTexture::DestroyTextures();
+    VertexBuffer::DestroyBuffers();
+}
+
+void ae3d::GfxDevice::SetRenderTarget( RenderTexture* target, unsigned /*cubeMapFace*/ )
+{
+    GfxDeviceGlobal::renderTexture0 = target;
+    Statistics::IncRenderTargetBinds();
+}
+
+void ae3d::GfxDevice::ExecuteCommands( const CommandStream& stream, std::size_t firstCommand )
+{
+    for (std::size_t i = firstCommand; i < stream.GetCommandCount(); ++i)
+    {
+        const RenderCommand& command = stream.GetCommand( i );
+
+        if (command.type == RenderCommand::Type::BeginPass)
+        {
+            const RenderCommand::BeginPassData& data = command.beginPass;
+            int viewport[ 4 ] = { data.viewport[ 0 ], data.viewport[ 1 ], data.viewport[ 2 ], data.viewport[ 3 ] };
+
+            SetClearColor( data.clearColor[ 0 ], data.clearColor[ 1 ], data.clearColor[ 2 ] );
+            SetRenderTarget( data.target, data.cubeMapFace );
+            SetViewport( viewport );
+
+            if (data.clearFlags != 0)
+            {
+                ClearScreen( data.clearFlags );
+            }
+        }
+        else if (command.type == RenderCommand::Type::EndPass)
+        {
+            SetRenderTarget( nullptr, 0 );
+        }
+        else
+        {
+            ExecuteCommonCommand( stream, command );
+        }
+    }
+}
+
+void ae3d::GfxDevice::TransitionRenderTexture( RenderTexture* /*texture*/, TextureState /*before*/, TextureState /*after*/ )
+{
+    Statistics::IncBarrierCalls();
+}
+
+void ae3d::GfxDevice::FlushOffscreenPasses()
+{
+}
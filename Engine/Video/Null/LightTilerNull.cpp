@@ -0,0 +1,60 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "LightTiler.hpp"
+#include "ComputeShader.hpp"
+#include "GfxDevice.hpp"
+#include "Matrix.hpp"
+#include "RenderTexture.hpp"
+#include "Statistics.hpp"
+
+namespace GfxDeviceGlobal
+{
+    extern unsigned backBufferWidth;
+    extern unsigned backBufferHeight;
+    extern thread_local PerObjectUboStruct perObjectUboStruct;
+}
+
+void ae3d::LightTiler::DestroyBuffers()
+{
+}
+
+void ae3d::LightTiler::Init()
+{
+}
+
+void ae3d::LightTiler::UpdateLightBuffers()
+{
+    // Point light center/radius and color, spot light center/radius, params and color.
+    for (int bufferIndex = 0; bufferIndex < 5; ++bufferIndex)
+    {
+        Statistics::IncUploads( MaxLights * 4 * (int)sizeof( float ) );
+    }
+}
+
+unsigned ae3d::LightTiler::GetNumTilesX() const
+{
+    return (unsigned)((GfxDeviceGlobal::backBufferWidth + TileRes - 1) / (float)TileRes);
+}
+
+unsigned ae3d::LightTiler::GetNumTilesY() const
+{
+    return (unsigned)((GfxDeviceGlobal::backBufferHeight + TileRes - 1) / (float)TileRes);
+}
+
+void ae3d::LightTiler::CullLights( ComputeShader& shader, const Matrix44& projection, const Matrix44& localToView, RenderTexture& depthNormalTarget )
+{
+    Matrix44::Invert( projection, GfxDeviceGlobal::perObjectUboStruct.camera.clipToView );
+
+    GfxDeviceGlobal::perObjectUboStruct.object.localToView = localToView;
+    GfxDeviceGlobal::perObjectUboStruct.frame.windowWidth = depthNormalTarget.GetWidth();
+    GfxDeviceGlobal::perObjectUboStruct.frame.windowHeight = depthNormalTarget.GetHeight();
+    GfxDeviceGlobal::perObjectUboStruct.frame.numLights = (((unsigned)activeSpotLights & 0xFFFFu) << 16) | ((unsigned)activePointLights & 0xFFFFu);
+    GfxDeviceGlobal::perObjectUboStruct.frame.maxNumLightsPerTile = GetMaxNumLightsPerTile();
+    GfxDeviceGlobal::perObjectUboStruct.frame.tilesXY.x = (float)GetNumTilesX();
+    GfxDeviceGlobal::perObjectUboStruct.frame.tilesXY.y = (float)GetNumTilesY();
+
+    shader.Begin();
+    shader.SetRenderTexture( 0, &depthNormalTarget );
+    shader.Dispatch( GetNumTilesX(), GetNumTilesY(), 1 );
+    shader.End();
+}
@@ -0,0 +1,51 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "RenderTexture.hpp"
+#include "System.hpp"
+
+void ae3d::RenderTexture::DestroyTextures()
+{
+}
+
+void ae3d::RenderTexture::ResolveTo( RenderTexture* target )
+{
+    System::Assert( target != nullptr, "null resolve target" );
+    System::Assert( target->GetWidth() == width && target->GetHeight() == height, "resolve target dimension mismatch" );
+}
+
+void ae3d::RenderTexture::Create2D( int aWidth, int aHeight, DataType aDataType, TextureWrap aWrap, TextureFilter aFilter, const char* debugName )
+{
+    if (aWidth <= 0 || aHeight <= 0)
+    {
+        System::Print( "Render texture has invalid dimension!\n" );
+        return;
+    }
+
+    width = aWidth;
+    height = aHeight;
+    wrap = aWrap;
+    filter = aFilter;
+    isCube = false;
+    isRenderTexture = true;
+    dataType = aDataType;
+    handle = 1;
+    path = debugName ? debugName : "";
+}
+
+void ae3d::RenderTexture::CreateCube( int aDimension, DataType aDataType, TextureWrap aWrap, TextureFilter aFilter, const char* debugName )
+{
+    if (aDimension <= 0)
+    {
+        System::Print( "Render texture has invalid dimension!\n" );
+        return;
+    }
+
+    width = height = aDimension;
+    wrap = aWrap;
+    filter = aFilter;
+    isCube = true;
+    isRenderTexture = true;
+    dataType = aDataType;
+    handle = 1;
+    path = debugName ? debugName : "";
+}
@@ -0,0 +1,19 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "Renderer.hpp"
+
+ae3d::Renderer renderer;
+
+void ae3d::BuiltinShaders::Load()
+{
+    spriteRendererShader.Load( "sprite_vert", "sprite_frag" );
+    sdfShader.Load( "sprite_vert", "sdf_frag" );
+    skyboxShader.Load( "skybox_vert", "skybox_frag" );
+    momentsShader.Load( "moments_vert", "moments_frag" );
+    momentsSkinShader.Load( "moments_skin_vert", "moments_frag" );
+    momentsInstancedShader.Load( "moments_instanced_vert", "moments_frag" );
+    depthNormalsShader.Load( "depthnormals_vert", "depthnormals_frag" );
+    depthNormalsInstancedShader.Load( "depthnormals_instanced_vert", "depthnormals_frag" );
+    uiShader.Load( "sprite_vert", "sprite_frag" );
+    lightCullShader.Load( "light_culler" );
+}
@@ -0,0 +1,91 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "Shader.hpp"
+#include <cstring>
+#include "FileSystem.hpp"
+#include "GfxDevice.hpp"
+#include "RenderTexture.hpp"
+#include "Statistics.hpp"
+#include "System.hpp"
+#include "Texture2D.hpp"
+#include "TextureCube.hpp"
+
+namespace GfxDeviceGlobal
+{
+    extern thread_local PerObjectUboStruct perObjectUboStruct;
+    extern ae3d::RenderTexture* renderTexture0;
+}
+
+void ae3d::Shader::DestroyShaders()
+{
+}
+
+void ae3d::Shader::Load( const char* vertexSource, const char* fragmentSource )
+{
+    vertexPath = vertexSource;
+    fragmentPath = fragmentSource;
+}
+
+void ae3d::Shader::Load( const char* /*metalVertexShaderName*/, const char* /*metalFragmentShaderName*/,
+                         const FileSystem::FileContentsData& /*vertexDataHLSL*/, const FileSystem::FileContentsData& /*fragmentDataHLSL*/,
+                         const FileSystem::FileContentsData& vertexDataSPIRV, const FileSystem::FileContentsData& fragmentDataSPIRV )
+{
+    vertexPath = vertexDataSPIRV.path;
+    fragmentPath = fragmentDataSPIRV.path;
+}
+
+void ae3d::Shader::Use()
+{
+    System::Assert( IsValid(), "no valid shader" );
+    Statistics::IncShaderBinds();
+}
+
+void ae3d::Shader::SetUniform( int offset, void* data, int dataBytes )
+{
+    System::Assert( offset >= 0 && offset + dataBytes <= (int)sizeof( PerObjectUboStruct::Object ), "uniform does not fit into the object block" );
+    std::memcpy( reinterpret_cast< std::uint8_t* >( &GfxDeviceGlobal::perObjectUboStruct.object ) + offset, data, dataBytes );
+}
+
+void ae3d::Shader::SetTexture( Texture2D* texture, int textureUnit )
+{
+    if (texture == nullptr)
+    {
+        return;
+    }
+
+    if (textureUnit == 0)
+    {
+        GfxDeviceGlobal::perObjectUboStruct.material.tex0scaleOffset = texture->GetScaleOffset();
+    }
+    else if (textureUnit != 1)
+    {
+        System::Print( "Shader tries to set a texture to too high unit %d\n", textureUnit );
+    }
+}
+
+void ae3d::Shader::SetTexture( TextureCube* texture, int textureUnit )
+{
+    if (texture == nullptr)
+    {
+        return;
+    }
+
+    if (textureUnit != 0 && textureUnit != 1 && textureUnit != 12)
+    {
+        System::Print( "Shader tries to set a texture to too high unit %d\n", textureUnit );
+    }
+}
+
+void ae3d::Shader::SetRenderTexture( RenderTexture* texture, int textureUnit )
+{
+    // Null check also prevents feedback.
+    if (texture == nullptr || texture == GfxDeviceGlobal::renderTexture0)
+    {
+        return;
+    }
+
+    if (textureUnit != 0 && textureUnit != 1)
+    {
+        System::Print( "Shader tries to set a texture to too high unit %d\n", textureUnit );
+    }
+}
@@ -0,0 +1,144 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "Texture2D.hpp"
+#include <string>
+#include <cstdint>
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.c"
+#include "DDSLoader.hpp"
+#include "FileSystem.hpp"
+#include "Statistics.hpp"
+#include "System.hpp"
+
+bool HasStbExtension( const std::string& path ); // Defined in TextureCommon.cpp
+
+namespace MathUtil
+{
+    int GetMipmapCount( int width, int height );
+}
+
+namespace Texture2DGlobal
+{
+    ae3d::Texture2D defaultTexture;
+    ae3d::Texture2D defaultTextureUAV;
+}
+
+void ae3d::Texture2D::DestroyTextures()
+{
+}
+
+void ae3d::Texture2D::LoadFromData( const void* /*imageData*/, int aWidth, int aHeight, int channels, const char* debugName )
+{
+    width = aWidth;
+    height = aHeight;
+    wrap = TextureWrap::Repeat;
+    filter = TextureFilter::Linear;
+    opaque = (channels == 3 || channels == 1);
+    handle = 1;
+    path = debugName;
+
+    Statistics::IncUploads( width * height * channels );
+}
+
+void ae3d::Texture2D::Load( const FileSystem::FileContentsData& fileContents, TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace, Anisotropy aAnisotropy )
+{
+    filter = aFilter;
+    wrap = aWrap;
+    mipmaps = aMipmaps;
+    anisotropy = aAnisotropy;
+    colorSpace = aColorSpace;
+    handle = 1;
+    width = 256;
+    height = 256;
+    path = fileContents.path;
+
+    if (!fileContents.isLoaded)
+    {
+        *this = *GetDefaultTexture();
+        return;
+    }
+
+    const bool isDDS = fileContents.path.find( ".dds" ) != std::string::npos || fileContents.path.find( ".DDS" ) != std::string::npos;
+
+    if (HasStbExtension( fileContents.path ))
+    {
+        LoadSTB( fileContents );
+    }
+    else if (isDDS)
+    {
+        LoadDDS( fileContents.path.c_str() );
+    }
+    else
+    {
+        System::Print( "Unknown/unsupported texture file extension: %s\n", fileContents.path.c_str() );
+    }
+}
+
+void ae3d::Texture2D::CreateUAV( int aWidth, int aHeight, const char* debugName )
+{
+    width = aWidth;
+    height = aHeight;
+    handle = 1;
+    path = debugName;
+}
+
+void ae3d::Texture2D::SetLayout( TextureLayout /*layout*/ )
+{
+}
+
+void ae3d::Texture2D::LoadDDS( const char* aPath )
+{
+    DDSLoader::Output ddsOutput;
+    auto fileContents = FileSystem::FileContents( aPath );
+    const DDSLoader::LoadResult loadResult = DDSLoader::Load( fileContents, width, height, opaque, ddsOutput );
+
+    if (loadResult != DDSLoader::LoadResult::Success)
+    {
+        ae3d::System::Print( "DDS Loader could not load %s", aPath );
+        return;
+    }
+
+    mipLevelCount = mipmaps == Mipmaps::Generate ? ddsOutput.dataOffsets.count : 1;
+
+    Statistics::IncUploads( (int)fileContents.data.size() );
+}
+
+void ae3d::Texture2D::LoadSTB( const FileSystem::FileContentsData& fileContents )
+{
+    int components;
+    unsigned char* data = stbi_load_from_memory( fileContents.data.data(), static_cast<int>(fileContents.data.size()), &width, &height, &components, 4 );
+
+    if (data == nullptr)
+    {
+        const std::string reason( stbi_failure_reason() );
+        System::Print( "%s failed to load. stb_image's reason: %s\n", fileContents.path.c_str(), reason.c_str() );
+        return;
+    }
+
+    opaque = (components == 3 || components == 1);
+    mipLevelCount = mipmaps == Mipmaps::Generate ? MathUtil::GetMipmapCount( width, height ) : 1;
+
+    Statistics::IncUploads( width * height * 4 );
+
+    stbi_image_free( data );
+}
+
+ae3d::Texture2D* ae3d::Texture2D::GetDefaultTexture()
+{
+    if (Texture2DGlobal::defaultTexture.GetID() == 0)
+    {
+        Texture2DGlobal::defaultTexture.LoadFromData( nullptr, 32, 32, 4, "default texture 2d" );
+    }
+
+    return &Texture2DGlobal::defaultTexture;
+}
+
+ae3d::Texture2D* ae3d::Texture2D::GetDefaultTextureUAV()
+{
+    if (Texture2DGlobal::defaultTextureUAV.GetID() == 0)
+    {
+        Texture2DGlobal::defaultTextureUAV.CreateUAV( 32, 32, "default texture 2d UAV" );
+    }
+
+    return &Texture2DGlobal::defaultTextureUAV;
+}
@@ -0,0 +1,133 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "TextureCube.hpp"
+#include <string>
+#include <vector>
+#include "stb_image.c"
+#include "DDSLoader.hpp"
+#include "FileSystem.hpp"
+#include "JobSystem.hpp"
+#include "Statistics.hpp"
+#include "System.hpp"
+
+bool HasStbExtension( const std::string& path ); // Defined in TextureCommon.cpp
+
+namespace TextureCubeGlobal
+{
+    ae3d::TextureCube defaultTexture;
+}
+
+void ae3d::TextureCube::DestroyTextures()
+{
+}
+
+ae3d::TextureCube* ae3d::TextureCube::GetDefaultTexture()
+{
+    if (TextureCubeGlobal::defaultTexture.GetID() == 0)
+    {
+        FileSystem::FileContentsData emptyData;
+        emptyData.path = "default texture cube";
+
+        TextureCubeGlobal::defaultTexture.Load( emptyData, emptyData, emptyData, emptyData, emptyData, emptyData, TextureWrap::Clamp, TextureFilter::Linear, Mipmaps::None, ColorSpace::SRGB );
+        TextureCubeGlobal::defaultTexture.width = 32;
+        TextureCubeGlobal::defaultTexture.height = 32;
+    }
+
+    return &TextureCubeGlobal::defaultTexture;
+}
+
+void ae3d::TextureCube::Load( const FileSystem::FileContentsData& negX, const FileSystem::FileContentsData& posX,
+                              const FileSystem::FileContentsData& negY, const FileSystem::FileContentsData& posY,
+                              const FileSystem::FileContentsData& negZ, const FileSystem::FileContentsData& posZ,
+                              TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace )
+{
+    filter = aFilter;
+    wrap = aWrap;
+    mipmaps = aMipmaps;
+    colorSpace = aColorSpace;
+    isCube = true;
+    handle = 1;
+
+    posXpath = posX.path;
+    posYpath = posY.path;
+    posZpath = posZ.path;
+    negXpath = negX.path;
+    negYpath = negY.path;
+    negZpath = negZ.path;
+
+    const std::string paths[] = { posX.path, negX.path, negY.path, posY.path, negZ.path, posZ.path };
+    const std::vector< unsigned char >* datas[] = { &posX.data, &negX.data, &negY.data, &posY.data, &negZ.data, &posZ.data };
+
+    // Decodes stb faces in parallel up front, the loop below then only validates and uploads.
+    unsigned char* decodedFaces[ 6 ] = {};
+    int faceWidths[ 6 ] = {};
+    int faceHeights[ 6 ] = {};
+    int faceComponents[ 6 ] = {};
+    // stb_image's failure reason is thread-local, so it's read on the thread that decoded the face.
+    const char* faceFailureReasons[ 6 ] = {};
+
+    JobSystem::ParallelFor( 6, 1, [&]( unsigned begin, unsigned end )
+    {
+        for (unsigned face = begin; face < end; ++face)
+        {
+            if (HasStbExtension( paths[ face ] ))
+            {
+                decodedFaces[ face ] = stbi_load_from_memory( datas[ face ]->data(), static_cast< int >( datas[ face ]->size() ), &faceWidths[ face ], &faceHeights[ face ], &faceComponents[ face ], 4 );
+
+                if (decodedFaces[ face ] == nullptr)
+                {
+                    faceFailureReasons[ face ] = stbi_failure_reason();
+                }
+            }
+        }
+    } );
+
+    auto freeDecodedFaces = [&]()
+    {
+        for (int face = 0; face < 6; ++face)
+        {
+            stbi_image_free( decodedFaces[ face ] );
+            decodedFaces[ face ] = nullptr;
+        }
+    };
+
+    for (int face = 0; face < 6; ++face)
+    {
+        const bool isDDS = paths[ face ].find( ".dds" ) != std::string::npos || paths[ face ].find( ".DDS" ) != std::string::npos;
+
+        if (HasStbExtension( paths[ face ] ))
+        {
+            unsigned char* data = decodedFaces[ face ];
+            width = faceWidths[ face ];
+            height = faceHeights[ face ];
+            const int components = faceComponents[ face ];
+
+            if (data == nullptr)
+            {
+                const std::string reason( faceFailureReasons[ face ] != nullptr ? faceFailureReasons[ face ] : "unknown" );
+                System::Print( "%s failed to load. stb_image's reason: %s\n", paths[ face ].c_str(), reason.c_str() );
+                freeDecodedFaces();
+                return;
+            }
+
+            opaque = (components == 3 || components == 1);
+            Statistics::IncUploads( width * height * 4 );
+            stbi_image_free( data );
+            decodedFaces[ face ] = nullptr;
+        }
+        else if (isDDS)
+        {
+            DDSLoader::Output ddsOutput;
+            const DDSLoader::LoadResult loadResult = DDSLoader::Load( FileSystem::FileContents( paths[ face ].c_str() ), width, height, opaque, ddsOutput );
+
+            if (loadResult != DDSLoader::LoadResult::Success)
+            {
+                System::Print( "Could not load %s\n", paths[ face ].c_str() );
+                freeDecodedFaces();
+                return;
+            }
+
+            Statistics::IncUploads( (int)datas[ face ]->size() );
+        }
+    }
+}
@@ -0,0 +1,62 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "VertexBuffer.hpp"
+#include "Statistics.hpp"
+#include "System.hpp"
+
+void ae3d::VertexBuffer::DestroyBuffers()
+{
+}
+
+void ae3d::VertexBuffer::SetDebugName( const char* /*name*/ )
+{
+}
+
+void ae3d::VertexBuffer::Bind() const
+{
+}
+
+void ae3d::VertexBuffer::GenerateDynamic( int faceCount, int /*vertexCount*/ )
+{
+    vertexFormat = VertexFormat::PTNTC;
+    elementCount = faceCount * 3;
+}
+
+void ae3d::VertexBuffer::UpdateDynamic( const Face* /*faces*/, int faceCount, const VertexPTC* /*vertices*/, int vertexCount )
+{
+    System::Assert( faceCount * 3 <= elementCount, "Index buffer too small!" );
+
+    Statistics::IncUploads( faceCount * 3 * 2 + vertexCount * (int)sizeof( VertexPTNTC ) );
+}
+
+void ae3d::VertexBuffer::Generate( const Face* /*faces*/, int faceCount, const VertexPTC* /*vertices*/, int vertexCount, Storage /*storage*/ )
+{
+    vertexFormat = VertexFormat::PTNTC;
+    elementCount = faceCount * 3;
+
+    Statistics::IncUploads( elementCount * 2 + vertexCount * (int)sizeof( VertexPTNTC ) );
+}
+
+void ae3d::VertexBuffer::Generate( const Face* /*faces*/, int faceCount, const VertexPTN* /*vertices*/, int vertexCount )
+{
+    vertexFormat = VertexFormat::PTNTC;
+    elementCount = faceCount * 3;
+
+    Statistics::IncUploads( elementCount * 2 + vertexCount * (int)sizeof( VertexPTNTC ) );
+}
+
+void ae3d::VertexBuffer::Generate( const Face* /*faces*/, int faceCount, const VertexPTNTC* /*vertices*/, int vertexCount )
+{
+    vertexFormat = VertexFormat::PTNTC;
+    elementCount = faceCount * 3;
+
+    Statistics::IncUploads( elementCount * 2 + vertexCount * (int)sizeof( VertexPTNTC ) );
+}
+
+void ae3d::VertexBuffer::Generate( const Face* /*faces*/, int faceCount, const VertexPTNTC_Skinned* /*vertices*/, int vertexCount )
+{
+    vertexFormat = VertexFormat::PTNTC_Skinned;
+    elementCount = faceCount * 3;
+
+    Statistics::IncUploads( elementCount * 2 + vertexCount * (int)sizeof( VertexPTNTC_Skinned ) );
+}
@@ -8,7 +8,6 @@
 namespace ae3d
 {
     class TextureCube;
-    class CameraComponent;
     
     struct BuiltinShaders
     {
@@ -19,9 +18,13 @@ namespace ae3d
         Shader skyboxShader;
         Shader momentsShader;
         Shader momentsSkinShader;
+        Shader momentsInstancedShader;
         Shader depthNormalsShader;
+        Shader depthNormalsInstancedShader;
         Shader uiShader;
         ComputeShader lightCullShader;
+        /// Vulkan only.
+        ComputeShader indirectCullShader;
     };
 
     /// High-level rendering stuff.
@@ -37,7 +40,9 @@ namespace ae3d
         void GenerateSkybox();
         void GenerateTextures();
 
-        void RenderSkybox( TextureCube* skyTexture, const CameraComponent& camera );
+        /// \param skyTexture Sky texture.
+        /// \param localToClip Camera's view-projection matrix without translation.
+        void RenderSkybox( TextureCube* skyTexture, const struct Matrix44& localToClip );
 
         Texture2D& GetWhiteTexture() { return whiteTexture; }
 
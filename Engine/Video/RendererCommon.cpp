@@ -1,10 +1,10 @@
 // This is an independent project of an individual developer. Dear PVS-Studio, please check it.
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 #include "Renderer.hpp"
+#include <cstring>
 #include <vector>
 #include <math.h>
 #include "Array.hpp"
-#include "CameraComponent.hpp"
 #include "FileSystem.hpp"
 #include "LightTiler.hpp"
 #include "GfxDevice.hpp"
@@ -15,7 +15,7 @@
 
 namespace GfxDeviceGlobal
 {
-    extern PerObjectUboStruct perObjectUboStruct;
+    extern thread_local PerObjectUboStruct perObjectUboStruct;
     extern std::vector< ae3d::VertexBuffer > lineBuffers;
     extern unsigned backBufferHeight;
 }
@@ -84,16 +84,13 @@ void ae3d::Renderer::GenerateQuadBuffer()
     quadBuffer.Generate( indices, 2, vertices, 4, VertexBuffer::Storage::GPU );
 }
 
-void ae3d::Renderer::RenderSkybox( TextureCube* skyTexture, const CameraComponent& camera )
+void ae3d::Renderer::RenderSkybox( TextureCube* skyTexture, const Matrix44& localToClip )
 {
-    Matrix44 localToClip;
-    Matrix44::Multiply( camera.GetView(), camera.GetProjection(), localToClip );
-    
     builtinShaders.skyboxShader.Use();
     builtinShaders.skyboxShader.SetTexture( skyTexture, 0 );
-    GfxDeviceGlobal::perObjectUboStruct.localToClip = localToClip;
+    GfxDeviceGlobal::perObjectUboStruct.object.localToClip = localToClip;
 #if AE3D_OPENVR
-    GfxDeviceGlobal::perObjectUboStruct.isVR = 1;
+    GfxDeviceGlobal::perObjectUboStruct.frame.isVR = 1;
 #endif
 
     GfxDevice::PushGroupMarker( "Skybox" );
@@ -102,6 +99,74 @@ void ae3d::Renderer::RenderSkybox( TextureCube* skyTexture, const CameraComponen
     GfxDevice::PopGroupMarker();
 }
 
+const void* UboBlockTracker::GetBlockData( const PerObjectUboStruct& uniforms, Block block )
+{
+    switch (block)
+    {
+    case Block::Object: return &uniforms.object;
+    case Block::Frame: return &uniforms.frame;
+    case Block::Camera: return &uniforms.camera;
+    case Block::Material: return &uniforms.material;
+    case Block::Skin: return &uniforms.skin;
+    default: ae3d::System::Assert( false, "invalid uniform block" ); return nullptr;
+    }
+}
+
+void* UboBlockTracker::GetUploadedBlockData( Block block )
+{
+    return const_cast< void* >( GetBlockData( uploaded, block ) );
+}
+
+std::size_t UboBlockTracker::GetBlockSize( Block block )
+{
+    switch (block)
+    {
+    case Block::Object: return sizeof( PerObjectUboStruct::Object );
+    case Block::Frame: return sizeof( PerObjectUboStruct::Frame );
+    case Block::Camera: return sizeof( PerObjectUboStruct::Camera );
+    case Block::Material: return sizeof( PerObjectUboStruct::Material );
+    case Block::Skin: return sizeof( PerObjectUboStruct::Skin );
+    default: ae3d::System::Assert( false, "invalid uniform block" ); return 0;
+    }
+}
+
+std::size_t UboBlockTracker::GetUploadSize( Block block, int boneMatrixCount )
+{
+    return block == Block::Skin ? boneMatrixCount * sizeof( ae3d::Matrix44 ) : GetBlockSize( block );
+}
+
+unsigned UboBlockTracker::GetChangedBlocks( const PerObjectUboStruct& uniforms, int boneMatrixCount, unsigned serial )
+{
+    ae3d::System::Assert( boneMatrixCount >= 0 && boneMatrixCount <= PerObjectUboStruct::MaxBoneMatrices, "invalid bone matrix count" );
+
+    const bool isNewSerial = serial != uploadedSerial;
+    unsigned changedBlocks = 0;
+
+    for (int block = 0; block < Block::Skin; ++block)
+    {
+        const Block b = static_cast< Block >( block );
+
+        if (isNewSerial || std::memcmp( GetBlockData( uniforms, b ), GetUploadedBlockData( b ), GetBlockSize( b ) ) != 0)
+        {
+            changedBlocks |= 1u << block;
+            std::memcpy( GetUploadedBlockData( b ), GetBlockData( uniforms, b ), GetBlockSize( b ) );
+        }
+    }
+
+    // The skin block can be reused by a draw that reads the same or fewer matrices.
+    const std::size_t skinSize = GetUploadSize( Block::Skin, boneMatrixCount );
+
+    if (isNewSerial || boneMatrixCount > uploadedBoneMatrixCount || std::memcmp( uniforms.skin.boneMatrices, uploaded.skin.boneMatrices, skinSize ) != 0)
+    {
+        changedBlocks |= 1u << Block::Skin;
+        std::memcpy( GetUploadedBlockData( Block::Skin ), uniforms.skin.boneMatrices, skinSize );
+        uploadedBoneMatrixCount = boneMatrixCount;
+    }
+
+    uploadedSerial = serial;
+    return changedBlocks;
+}
+
 int ae3d::GfxDevice::CreateLineBuffer( const Vec3* lines, int lineCount, const Vec3& color )
 {
     if (lineCount == 0)
@@ -7,6 +7,7 @@
 #import <Metal/Metal.h>
 #endif
 #if RENDERER_VULKAN
+#include <cstdint>
 #include <vulkan/vulkan.h>
 #endif
 #include "Vec3.hpp"
@@ -14,7 +15,7 @@
 
 namespace ae3d
 {
-    /// Contains a vertex and index buffer. Indices are 16-bit.
+    /// Contains a vertex and index buffer. Indices are 16-bit. On Vulkan, non-dynamic buffers are ranges of large buffers shared by many meshes.
     class VertexBuffer
     {
     public:
@@ -178,8 +179,23 @@ namespace ae3d
         static const unsigned VERTEX_BUFFER_BIND_ID = 0;
 
         VkPipelineVertexInputStateCreateInfo* GetInputState() { return &inputStateCreateInfo; }
-        VkBuffer* GetVertexBuffer() { return &vertexBuffer; }
-        VkBuffer* GetIndexBuffer() { return &indexBuffer; }
+
+        /// Used to create PSOs before any buffer of the format exists. Can be called from job threads.
+        /// \param format Vertex format.
+        /// \return Input state of buffers that have format.
+        static VkPipelineVertexInputStateCreateInfo* GetInputState( VertexFormat format );
+
+        /// \return Vertex buffer. Static geometry shares it with other meshes of the same vertex format.
+        VkBuffer GetVertexBuffer() const { return vertexBuffer; }
+
+        /// \return Index buffer. Static geometry shares it with other meshes.
+        VkBuffer GetIndexBuffer() const { return indexBuffer; }
+
+        /// \return Offset of the first vertex in the vertex buffer, in vertices.
+        std::int32_t GetBaseVertex() const { return static_cast< std::int32_t >( vertexAllocation.offset ); }
+
+        /// \return Offset of the first index in the index buffer, in indices.
+        std::uint32_t GetBaseIndex() const { return indexAllocation.offset; }
 
 #endif
         /// Destroys graphics API objects.
@@ -215,19 +231,27 @@ namespace ae3d
         void CreateInputState( int vertexStride );
 
         VkBuffer vertexBuffer = VK_NULL_HANDLE;
-        VkDeviceMemory vertexMem = VK_NULL_HANDLE;
         VkPipelineVertexInputStateCreateInfo inputStateCreateInfo = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO, nullptr, 0, 0, nullptr, 0, nullptr };
         VkVertexInputBindingDescription bindingDescriptions;
         VkVertexInputAttributeDescription attributeDescriptions[ 7 ];
 
         VkBuffer indexBuffer = VK_NULL_HANDLE;
-        VkDeviceMemory indexMem = VK_NULL_HANDLE;
+
+        /// Range suballocated from a geometry arena page. Offset and count are in elements, count is 0 if unallocated.
+        struct ArenaAllocation
+        {
+            std::uint32_t offset = 0;
+            std::uint32_t count = 0;
+        };
+
+        ArenaAllocation vertexAllocation;
+        ArenaAllocation indexAllocation;
 
         struct Buffer
         {
             int size = 0;
-            VkDeviceMemory memory;
             VkBuffer buffer;
+            /// Persistently mapped.
             void* mappedData = nullptr;
         };
 
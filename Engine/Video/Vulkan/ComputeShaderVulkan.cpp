@@ -7,6 +7,7 @@
 #include "GfxDevice.hpp"
 #include "Macros.hpp"
 #include "RenderTexture.hpp"
+#include "Statistics.hpp"
 #include "System.hpp"
 #include "Texture2D.hpp"
 #include "VulkanUtils.hpp"
@@ -14,17 +15,16 @@
 extern ae3d::FileWatcher fileWatcher;
 
 void BindComputeDescriptorSet();
-void UploadPerObjectUbo();
+VkCommandBuffer BeginComputeCommands();
 
 namespace GfxDeviceGlobal
 {
     extern VkDevice device;
-    extern VkQueue computeQueue;
     extern VkCommandBuffer computeCmdBuffer;
     extern VkPipelineLayout pipelineLayout;
     extern VkPipelineCache pipelineCache;
-    extern PerObjectUboStruct perObjectUboStruct;
-    extern VkImageView boundViews[ 13 ];
+    extern thread_local PerObjectUboStruct perObjectUboStruct;
+    extern thread_local VkImageView boundViews[ 13 ];
 }
 
 namespace ComputeShaderGlobal
@@ -131,8 +131,8 @@ void ae3d::ComputeShader::SetUniform( UniformName uniform, float x, float y )
 {
     if( uniform == UniformName::TilesZW )
     {
-        GfxDeviceGlobal::perObjectUboStruct.tilesXY.z = x;
-        GfxDeviceGlobal::perObjectUboStruct.tilesXY.w = y;
+        GfxDeviceGlobal::perObjectUboStruct.frame.tilesXY.z = x;
+        GfxDeviceGlobal::perObjectUboStruct.frame.tilesXY.w = y;
     }
 }
 
@@ -165,42 +165,28 @@ void ae3d::ComputeShader::SetTexture2D( unsigned slot, Texture2D* texture )
 
 void ae3d::ComputeShader::Begin()
 {
-    VkCommandBufferBeginInfo cmdBufInfo = {};
-    cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-
-    VkResult err = vkBeginCommandBuffer( GfxDeviceGlobal::computeCmdBuffer, &cmdBufInfo );
-    AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer" );
+    BeginComputeCommands();
 }
 
 void ae3d::ComputeShader::End()
 {
-    vkEndCommandBuffer( GfxDeviceGlobal::computeCmdBuffer );
-
-    VkPipelineStageFlags pipelineStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.pWaitDstStageMask = &pipelineStages;
-    submitInfo.waitSemaphoreCount = 0;
-    submitInfo.pWaitSemaphores = nullptr;
-    submitInfo.signalSemaphoreCount = 0;
-    submitInfo.pSignalSemaphores = nullptr;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &GfxDeviceGlobal::computeCmdBuffer;
-
-    VkResult err = vkQueueSubmit( GfxDeviceGlobal::computeQueue, 1, &submitInfo, VK_NULL_HANDLE );
-    AE3D_CHECK_VULKAN( err, "vkQueueSubmit compute" );
-
-    err = vkQueueWaitIdle( GfxDeviceGlobal::computeQueue );
-    AE3D_CHECK_VULKAN( err, "vkQueueWaitIdle" );
+    // Dispatches are submitted with the frame's offscreen passes, so the GPU orders them with draws instead of the CPU waiting for them.
+    VkMemoryBarrier computeToReaders = {};
+    computeToReaders.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    computeToReaders.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    computeToReaders.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+    vkCmdPipelineBarrier( GfxDeviceGlobal::computeCmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                          VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                          0, 1, &computeToReaders, 0, nullptr, 0, nullptr );
+    Statistics::IncBarrierCalls();
 }
 
 void ae3d::ComputeShader::Dispatch( unsigned groupCountX, unsigned groupCountY, unsigned groupCountZ )
 {
-    System::Assert( GfxDeviceGlobal::computeCmdBuffer != VK_NULL_HANDLE, "Uninitialized compute command buffer" );
+    System::Assert( GfxDeviceGlobal::computeCmdBuffer != VK_NULL_HANDLE, "Dispatch called without ComputeShader::Begin" );
 
     BindComputeDescriptorSet();
-    UploadPerObjectUbo();
 
     vkCmdBindPipeline( GfxDeviceGlobal::computeCmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pso );
     vkCmdDispatch( GfxDeviceGlobal::computeCmdBuffer, groupCountX, groupCountY, groupCountZ );
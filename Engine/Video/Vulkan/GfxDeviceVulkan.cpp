@@ -1,14 +1,22 @@
 // This is an independent project of an individual developer. Dear PVS-Studio, please check it.
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 #include "GfxDevice.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <fstream>
 #include <map>
+#include <mutex>
+#include <unordered_map>
 #include <vector> 
 #include <string>
 #include <vulkan/vulkan.h>
 #include "Array.hpp"
+#include "CommandStream.hpp"
 #include "FileSystem.hpp"
+#include "JobSystem.hpp"
 #include "LightTiler.hpp"
 #include "Macros.hpp"
 #include "RenderTexture.hpp"
@@ -18,6 +26,7 @@
 #include "Statistics.hpp"
 #include "Texture2D.hpp"
 #include "TextureCube.hpp"
+#include "TLSFAllocator.hpp"
 #include "VertexBuffer.hpp"
 #include "VulkanUtils.hpp"
 #include "VR.hpp"
@@ -43,14 +52,68 @@ PFN_vkGetShaderInfoAMD getShaderInfoAMD;
 constexpr unsigned UI_VERTICE_COUNT = 512 * 1024;
 constexpr unsigned UI_FACE_COUNT = 128 * 1024;
 
-struct Ubo
+/// Bytes of the largest uniform block. Descriptors bind each block's size at the draw's dynamic offsets.
+constexpr VkDeviceSize UBO_RANGE = sizeof( PerObjectUboStruct::Skin );
+/// Descriptor set bindings of UboBlockTracker's blocks. Must match ubo.h.
+constexpr std::uint32_t UBO_BLOCK_BINDINGS[ UboBlockTracker::BlockCount ] = { 0, 13, 14, 15, 16 };
+/// Initial capacity of a frame's uniform ring.
+constexpr VkDeviceSize UBO_RING_CAPACITY = 4 * 1024 * 1024;
+/// Threads take chunks of this size from the frame's uniform ring, so draws suballocate without locking.
+constexpr VkDeviceSize UBO_CHUNK_SIZE = 64 * 1024;
+
+/// Block of a frame's uniform ring.
+struct UboBlock
 {
-    VkBuffer ubo = VK_NULL_HANDLE;
-    VkDeviceMemory uboMemory = VK_NULL_HANDLE;
-    VkDescriptorBufferInfo uboDesc = {};
-    std::uint8_t* uboData = nullptr;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    ae3d::MemoryAllocation memory;
+    /// Persistently mapped.
+    std::uint8_t* mappedData = nullptr;
+    /// Bytes that are suballocated. The buffer is UBO_RANGE larger, so a block bound at any suballocation's offset is inside it.
+    VkDeviceSize capacity = 0;
 };
 
+/// Range of a frame's uniform ring.
+struct UboAllocation
+{
+    VkBuffer buffer;
+    /// Dynamic offset.
+    std::uint32_t offset;
+    std::uint8_t* data;
+};
+
+/// Buffers and dynamic offsets of the uniform blocks that a draw binds, in binding order.
+struct UboBindings
+{
+    VkBuffer buffers[ UboBlockTracker::BlockCount ] = {};
+    std::uint32_t offsets[ UboBlockTracker::BlockCount ] = {};
+};
+
+/// Instance in the indirect culler's instance buffer. Must match IndirectInstance in indirect.h.
+struct GpuIndirectInstance
+{
+    ae3d::Matrix44 localToWorld;
+    ae3d::Vec4 aabbMin;
+    ae3d::Vec4 aabbMax;
+    unsigned drawIndex = 0;
+    unsigned padding[ 3 ] = {};
+};
+
+static_assert( sizeof( GpuIndirectInstance ) == 112, "must match the std430 layout of IndirectInstance in indirect.h" );
+
+// Per frame.
+constexpr unsigned INDIRECT_INSTANCE_COUNT = 64 * 1024;
+constexpr unsigned INDIRECT_DRAW_COUNT = 4096;
+constexpr unsigned INDIRECT_CULLS_PER_FRAME = 32;
+// CullIndirect's ranges start at multiples of this, so their offsets are aligned to 256 bytes, the largest minStorageBufferOffsetAlignment.
+// Also the culler's thread group size.
+constexpr unsigned INDIRECT_RANGE_ALIGNMENT = 64;
+static_assert( ae3d::TLSFAllocator::Granularity == INDIRECT_RANGE_ALIGNMENT * sizeof( std::uint32_t ), "resident instance ranges must be aligned like CullIndirect's ranges" );
+constexpr unsigned INDIRECT_INVALID_DRAW = 0xFFFFFFFF;
+// Threads that can record secondary command buffers, including the main thread.
+constexpr unsigned MAX_RECORDING_THREADS = 64;
+// ExecuteCommands records at least this many consecutive submesh draws into each secondary command buffer.
+constexpr std::size_t MIN_DRAWS_PER_SECONDARY_CMD_BUFFER = 64;
+
 namespace GfxDeviceGlobal
 {
     struct SwapchainBuffer
@@ -62,7 +125,7 @@ namespace GfxDeviceGlobal
     struct DepthStencil
     {
         VkImage image = VK_NULL_HANDLE;
-        VkDeviceMemory mem = VK_NULL_HANDLE;
+        ae3d::MemoryAllocation mem;
         VkImageView view = VK_NULL_HANDLE;
     } depthStencil;
     
@@ -70,11 +133,11 @@ namespace GfxDeviceGlobal
     {
         VkImage colorImage = VK_NULL_HANDLE;
         VkImageView colorView = VK_NULL_HANDLE;
-        VkDeviceMemory colorMem = VK_NULL_HANDLE;
+        ae3d::MemoryAllocation colorMem;
 
         VkImage depthImage = VK_NULL_HANDLE;
         VkImageView depthView = VK_NULL_HANDLE;
-        VkDeviceMemory depthMem = VK_NULL_HANDLE;
+        ae3d::MemoryAllocation depthMem;
     } msaaTarget;
 
     VkInstance instance = VK_NULL_HANDLE;
@@ -83,60 +146,235 @@ namespace GfxDeviceGlobal
     VkPhysicalDeviceProperties properties;
     VkClearColorValue clearColor;
     
-    VkCommandBuffer drawCmdBuffers[ 4 ];
     VkCommandBuffer setupCmdBuffer = VK_NULL_HANDLE;
-    VkCommandBuffer prePresentCmdBuffer = VK_NULL_HANDLE;
-    VkCommandBuffer postPresentCmdBuffer = VK_NULL_HANDLE;
+    /// Command buffer that compute dispatches are recorded to. Set by BeginComputeCommands to the frame's offscreenCmdBuffer.
     VkCommandBuffer computeCmdBuffer = VK_NULL_HANDLE;
-    VkCommandBuffer offscreenCmdBuffer = VK_NULL_HANDLE;
-    VkCommandBuffer currentCmdBuffer = VK_NULL_HANDLE;
+    /// Thread-local like the other draw state, so job threads can record secondary command buffers in parallel.
+    thread_local VkCommandBuffer currentCmdBuffer = VK_NULL_HANDLE;
     VkCommandBuffer texCmdBuffer = VK_NULL_HANDLE;
     
     VkSwapchainKHR swapChain = VK_NULL_HANDLE;
     VkSurfaceKHR surface = VK_NULL_HANDLE;
     VkRenderPass renderPass = VK_NULL_HANDLE;
+    /// Like renderPass, but loads its attachments. Continues renderPass after secondary command buffers.
+    VkRenderPass loadRenderPass = VK_NULL_HANDLE;
+    /// Loaded from and saved to PipelineCacheFileName, so PSOs compile faster on later runs.
     VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    const char* const PipelineCacheFileName = "pipeline_cache.bin";
     VkFormat colorFormat;
     VkFormat depthFormat;
     VkColorSpaceKHR colorSpace;
     VkPhysicalDeviceMemoryProperties deviceMemoryProperties;
     VkQueue graphicsQueue = VK_NULL_HANDLE;
-    VkQueue computeQueue = VK_NULL_HANDLE;
     std::uint32_t graphicsQueueIndex = 0;
     Array< SwapchainBuffer > swapchainBuffers;
     Array< VkFramebuffer > frameBuffers;
     VkPhysicalDeviceFeatures deviceFeatures;
-    VkSemaphore presentCompleteSemaphore = VK_NULL_HANDLE;
-    VkSemaphore renderCompleteSemaphore = VK_NULL_HANDLE;
     VkSemaphore offscreenSemaphore = VK_NULL_HANDLE;
     VkCommandPool cmdPool = VK_NULL_HANDLE;
     VkQueryPool queryPool = VK_NULL_HANDLE;
     float timings[ 3 ];
-    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
     VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    /// PSOs that PrecompilePSOs or another thread is still compiling are VK_NULL_HANDLE.
     std::map< std::uint64_t, VkPipeline > psoCache;
+    std::mutex psoCacheMutex;
+    /// Counts PrecompilePSOs' unfinished jobs.
+    ae3d::JobSystem::Counter psoCompileCounter;
     VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
-    Array< VkDescriptorSet > descriptorSets;
-    unsigned descriptorSetIndex = 0;
+    /// Set 1, used by the indirect culler and indirect shaders.
+    VkDescriptorSetLayout indirectDescriptorSetLayout = VK_NULL_HANDLE;
     std::uint32_t queueNodeIndex = UINT32_MAX;
     std::uint32_t currentBuffer = 0;
     ae3d::RenderTexture* renderTexture0 = nullptr;
     VkFramebuffer frameBuffer0 = VK_NULL_HANDLE;
-    VkImageView boundViews[ 13 ];
-    VkSampler boundSamplers[ 2 ];
-    Array< VkBuffer > pendingFreeVBs;
-    Array< Ubo > ubos;
-	unsigned currentUbo = 0;
+    thread_local VkImageView boundViews[ 13 ];
+    thread_local VkSampler boundSamplers[ 2 ];
+    thread_local VkCommandBuffer boundGeometryCmdBuffer = VK_NULL_HANDLE;
+    thread_local VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+    thread_local VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+    /// Guards adding blocks to the frame's uniform ring and taking chunks from it.
+    std::mutex uboMutex;
+    /// Incremented by BeginFrame, so threads don't suballocate from chunks of earlier frames.
+    unsigned frameSerial = 0;
+
+    /// Part of the frame's uniform ring that a thread suballocates its draws' uniforms from.
+    struct UboChunk
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        std::uint8_t* mappedData = nullptr;
+        VkDeviceSize offset = 0;
+        VkDeviceSize end = 0;
+        unsigned frameSerial = ~0u;
+    };
+
+    thread_local UboChunk uboChunk;
+    /// Blocks that the thread uploaded last in the frame. Draws bind them again if their uniforms haven't changed.
+    thread_local UboBlockTracker uboBlockTracker;
+    thread_local UboBindings uboBindings;
+    /// Bone matrices that skinning has set for the next draw. Consumed by the draw's uniform upload.
+    thread_local int boneMatrixCount = 0;
+
+    /// Bindings that a set 0 was written with. Uniform blocks' offsets are dynamic, and the light tiler's buffer views are the copies of the frame,
+    /// which owns the cache, so they're not part of the key.
+    struct DescriptorSetKey
+    {
+        VkBuffer ubos[ UboBlockTracker::BlockCount ];
+        VkImageView views[ 4 ];
+        VkSampler samplers[ 2 ];
+    };
+
+    struct CachedDescriptorSet
+    {
+        DescriptorSetKey key;
+        VkDescriptorSet descriptorSet;
+    };
+
+    /// Guards frames' descriptor set pools and caches.
+    std::mutex descriptorSetMutex;
+    /// Set that the thread bound last in the frame. Consecutive draws with the same bindings reuse it without locking the cache.
+    thread_local DescriptorSetKey lastDescriptorSetKey;
+    thread_local VkDescriptorSet lastDescriptorSet = VK_NULL_HANDLE;
+    thread_local unsigned lastDescriptorSetFrameSerial = ~0u;
     VkSampleCountFlagBits msaaSampleBits = VK_SAMPLE_COUNT_1_BIT;
 	unsigned backBufferWidth;
 	unsigned backBufferHeight;
     ae3d::LightTiler lightTiler;
-    PerObjectUboStruct perObjectUboStruct;
-    ae3d::VertexBuffer uiVertexBuffer;
+
+    /// Resources of a frame that the GPU can still be executing while the CPU records the next frame. BeginFrame waits for the frame's fence before reusing them.
+    struct FrameResources
+    {
+        /// Signaled when the frame's draw command buffer and all earlier submits have finished.
+        VkFence fence = VK_NULL_HANDLE;
+        /// Signaled when FlushOffscreenPasses's last submit has finished.
+        VkFence offscreenFence = VK_NULL_HANDLE;
+        bool isOffscreenFencePending = false;
+        /// True if the frame's offscreen passes wrote timestamps 2 * frame index and 2 * frame index + 1.
+        bool usedOffscreen = false;
+        VkCommandBuffer drawCmdBuffer = VK_NULL_HANDLE;
+        VkCommandBuffer offscreenCmdBuffer = VK_NULL_HANDLE;
+        VkCommandBuffer prePresentCmdBuffer = VK_NULL_HANDLE;
+        VkCommandBuffer postPresentCmdBuffer = VK_NULL_HANDLE;
+        VkSemaphore presentCompleteSemaphore = VK_NULL_HANDLE;
+        VkSemaphore renderCompleteSemaphore = VK_NULL_HANDLE;
+        /// Uniform ring. Blocks are added when the last one is full, and BeginFrame merges them into one.
+        std::vector< UboBlock > uboBlocks;
+        /// Start of the last block's unused part. Guarded by uboMutex.
+        VkDeviceSize uboBlockOffset = 0;
+        /// Set 0 pools. A pool is added when all are full, so the frame's draw count isn't limited. BeginFrame resets them and keeps them for later frames.
+        std::vector< VkDescriptorPool > descriptorPools;
+        /// Pool that sets are allocated from, and sets that have been allocated from it.
+        std::size_t currentDescriptorPool = 0;
+        unsigned currentPoolDescriptorSets = 0;
+        /// Sets that have been written in the frame, by their key's hash.
+        std::unordered_map< std::uint64_t, CachedDescriptorSet > descriptorSetCache;
+        /// CullIndirect's descriptor sets.
+        VkDescriptorPool indirectDescriptorPool = VK_NULL_HANDLE;
+        /// Updated by UnmapUIVertexBuffer, so the UI of an earlier frame isn't overwritten while the GPU reads it.
+        ae3d::VertexBuffer uiVertexBuffer;
+    };
+
+    FrameResources frames[ MAX_FRAMES_IN_FLIGHT ];
+    /// Frame that the CPU is recording.
+    unsigned frameIndex = 0;
+
+    /// Buffers of CullIndirect. Each frame has its own range of the buffers. Each call takes the next ranges of the frame, which are reused after the frame's fence.
+    /// Instances are resident: each frame has a copy of all of them, and a copy is updated when the CPU starts recording its frame again.
+    struct IndirectBuffers
+    {
+        /// Instances of CreateIndirectInstances' handles.
+        struct ResidentRange
+        {
+            unsigned allocation = ae3d::TLSFAllocator::InvalidAllocation;
+            unsigned firstInstance = 0;
+            /// Instance count rounded up to INDIRECT_RANGE_ALIGNMENT. Instances after the handle's count have INDIRECT_INVALID_DRAW.
+            unsigned instanceCount = 0;
+        };
+
+        VkBuffer instances = VK_NULL_HANDLE;
+        ae3d::MemoryAllocation instancesMemory;
+        GpuIndirectInstance* mappedInstances = nullptr;
+        /// Values of the instances, copied to frames' copies.
+        std::vector< GpuIndirectInstance > residentInstances;
+        /// Instances whose frame's copy is out of date, per frame.
+        std::vector< unsigned > pendingInstances[ MAX_FRAMES_IN_FLIGHT ];
+        /// Indexed by handle. Unused entries have InvalidAllocation.
+        std::vector< ResidentRange > residentRanges;
+        /// Allocates resident ranges in bytes of uint32 indices like visibleInstances, so TLSFAllocator::Granularity is INDIRECT_RANGE_ALIGNMENT instances.
+        ae3d::TLSFAllocator residentAllocator{ INDIRECT_INSTANCE_COUNT * sizeof( std::uint32_t ) };
+        VkBuffer commands = VK_NULL_HANDLE;
+        ae3d::MemoryAllocation commandsMemory;
+        VkDrawIndexedIndirectCommand* mappedCommands = nullptr;
+        VkBuffer visibleInstances = VK_NULL_HANDLE;
+        ae3d::MemoryAllocation visibleInstancesMemory;
+        /// Ends of the used ranges. Start at the current frame's ranges.
+        unsigned usedInstances = 0;
+        unsigned usedCommands = 0;
+        unsigned cullCount = 0;
+        /// First command of the last CullIndirect call.
+        unsigned firstCommand = 0;
+        /// Set 1 of the last CullIndirect call.
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        /// Draws of the last CullIndirect call.
+        std::vector< ae3d::GfxDevice::IndirectDraw > draws;
+    } indirect;
+    thread_local PerObjectUboStruct perObjectUboStruct;
+
+    /// Render pass that GfxDevice has begun on a primary command buffer. EndParallelRecording continues it.
+    struct ActiveRenderPass
+    {
+        /// Null if no render pass has been begun by GfxDevice, for example in VR.
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        VkRenderPass loadRenderPass = VK_NULL_HANDLE;
+        VkFramebuffer frameBuffer = VK_NULL_HANDLE;
+        std::uint32_t width = 0;
+        std::uint32_t height = 0;
+        /// Last viewport and scissor, because secondary command buffers don't inherit them.
+        VkViewport viewport = {};
+        VkRect2D scissor = {};
+    } activeRenderPass;
+
+    /// Command pool of a thread that records secondary command buffers.
+    struct RecordingThread
+    {
+        /// Indexed by frame, because a frame's command buffers can be executing while the next frame is recorded.
+        VkCommandPool cmdPools[ MAX_FRAMES_IN_FLIGHT ] = {};
+        std::vector< VkCommandBuffer > cmdBuffers[ MAX_FRAMES_IN_FLIGHT ];
+        /// Command buffers that have been recorded in the frame. The frame's pool is reset in BeginFrame after the frame's fence.
+        unsigned usedCmdBuffers[ MAX_FRAMES_IN_FLIGHT ] = {};
+    };
+
+    RecordingThread recordingThreads[ MAX_RECORDING_THREADS ];
+    std::atomic< unsigned > recordingThreadCount{ 0 };
+    /// Index into recordingThreads, or -1 if the thread hasn't recorded yet.
+    thread_local int recordingThreadIndex = -1;
+
+    /// State of BeginParallelRecording.
+    struct ParallelRecording
+    {
+        /// Indexed by BeginSecondaryCommandBuffer's cmdBufferIndex.
+        std::vector< VkCommandBuffer > cmdBuffers;
+        PerObjectUboStruct perObjectUboStruct;
+        VkImageView boundViews[ 13 ];
+        VkSampler boundSamplers[ 2 ];
+        bool isRecording = false;
+    } parallelRecording;
+
+    /// Draw state of a thread before BeginSecondaryCommandBuffer. A thread that waits for jobs can run recording jobs, so its state is restored after them.
+    struct SavedDrawState
+    {
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        PerObjectUboStruct perObjectUboStruct;
+        VkImageView boundViews[ 13 ];
+        VkSampler boundSamplers[ 2 ];
+        int boneMatrixCount = 0;
+    };
+
+    thread_local SavedDrawState savedDrawState;
     ae3d::VertexBuffer::VertexPTC uiVertices[ UI_VERTICE_COUNT ];
     ae3d::VertexBuffer::Face uiFaces[ UI_FACE_COUNT ];
     std::vector< ae3d::VertexBuffer > lineBuffers;
-    bool usedOffscreen = false;
+    /// True between the first BeginOffscreen after a submit and FlushOffscreenPasses. Offscreen passes are batched into the frame's offscreenCmdBuffer until then.
+    bool isOffscreenCmdBufferRecording = false;
 }
 
 namespace ae3d
@@ -159,6 +397,29 @@ namespace ae3d
                 str += "fence calls: " + std::to_string( ::Statistics::GetFenceCalls() ) + "\n";
                 str += "mem alloc calls: " + std::to_string( ::Statistics::GetAllocCalls() ) + " (frame), " + std::to_string( ::Statistics::GetTotalAllocCalls() ) + " (total)\n";
                 str += "triangles: " + std::to_string( ::Statistics::GetTriangleCount() ) + "\n";
+                str += "occlusion culled: " + std::to_string( ::Statistics::GetOcclusionCulledObjects() ) + " / " + std::to_string( ::Statistics::GetOcclusionTestedObjects() ) + " tested\n";
+                str += "skipped draws: " + std::to_string( ::Statistics::GetSkippedDraws() ) + "\n";
+
+                MemoryHeapStatistics heaps[ VK_MAX_MEMORY_HEAPS ];
+                GetMemoryHeapStatistics( heaps );
+
+                for (std::uint32_t heapIndex = 0; heapIndex < GfxDeviceGlobal::deviceMemoryProperties.memoryHeapCount; ++heapIndex)
+                {
+                    const MemoryHeapStatistics& heap = heaps[ heapIndex ];
+
+                    if (heap.blockCount + heap.dedicatedCount == 0)
+                    {
+                        continue;
+                    }
+
+                    // Fraction of free bytes that are not in the largest free range.
+                    const unsigned fragmentation = heap.freeBytes > 0 ? static_cast< unsigned >( 100 - heap.largestFreeBytes * 100 / heap.freeBytes ) : 0;
+                    const bool isDeviceLocal = (GfxDeviceGlobal::deviceMemoryProperties.memoryHeaps[ heapIndex ].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+
+                    str += "memory heap " + std::to_string( heapIndex ) + (isDeviceLocal ? " (device local)" : "") + ": " + std::to_string( heap.usedBytes / 1024 ) + " KiB used, " +
+                           std::to_string( heap.freeBytes / 1024 ) + " KiB free in " + std::to_string( heap.blockCount ) + " blocks, " +
+                           std::to_string( heap.dedicatedCount ) + " dedicated, " + std::to_string( fragmentation ) + " % fragmented\n";
+                }
 
 				std::strcpy( outStr, str.c_str() );
             }
@@ -180,6 +441,13 @@ namespace WindowGlobal
     extern int presentInterval;
 }
 
+namespace VertexBufferGlobal
+{
+    void ReleasePendingAllocations( unsigned frameIndex );
+}
+
+void CreateBuffer( VkBuffer& buffer, int bufferSize, ae3d::MemoryAllocation& memory, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryFlags, const char* debugName );
+
 namespace ae3d
 {
     std::uint32_t GetMemoryType( std::uint32_t typeBits, VkFlags properties )
@@ -197,6 +465,67 @@ namespace ae3d
         return 0;
     }
 
+    void AddUboBlock( GfxDeviceGlobal::FrameResources& frame, VkDeviceSize capacity )
+    {
+        UboBlock block;
+        block.capacity = capacity;
+
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = capacity + UBO_RANGE;
+        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+
+        VkResult err = vkCreateBuffer( GfxDeviceGlobal::device, &bufferInfo, nullptr, &block.buffer );
+        AE3D_CHECK_VULKAN( err, "vkCreateBuffer UBO" );
+        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)block.buffer, VK_OBJECT_TYPE_BUFFER, "ubo ring" );
+
+        block.memory = AllocateAndBindBuffer( block.buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "ubo ring" );
+        block.mappedData = static_cast< std::uint8_t* >( block.memory.mappedData );
+
+        frame.uboBlocks.push_back( block );
+        frame.uboBlockOffset = 0;
+    }
+
+    void DestroyUboBlock( UboBlock& block )
+    {
+        vkDestroyBuffer( GfxDeviceGlobal::device, block.buffer, nullptr );
+        FreeMemory( block.memory );
+    }
+
+    /// \param size Bytes.
+    /// \return Range of the frame's uniform ring. It's aligned to minUniformBufferOffsetAlignment and valid until the frame's fence.
+    UboAllocation AllocateUbo( std::size_t size )
+    {
+        const VkDeviceSize alignment = std::max( GfxDeviceGlobal::properties.limits.minUniformBufferOffsetAlignment, (VkDeviceSize)16 );
+        const VkDeviceSize alignedSize = ((size + alignment - 1) / alignment) * alignment;
+        auto& chunk = GfxDeviceGlobal::uboChunk;
+
+        if (chunk.frameSerial != GfxDeviceGlobal::frameSerial || chunk.offset + alignedSize > chunk.end)
+        {
+            std::lock_guard< std::mutex > lock( GfxDeviceGlobal::uboMutex );
+            auto& frame = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ];
+
+            if (frame.uboBlockOffset + UBO_CHUNK_SIZE > frame.uboBlocks.back().capacity)
+            {
+                // Descriptor sets recorded this frame still reference the full blocks, so they are kept until BeginFrame.
+                AddUboBlock( frame, 2 * frame.uboBlocks.back().capacity );
+            }
+
+            const UboBlock& block = frame.uboBlocks.back();
+            chunk.buffer = block.buffer;
+            chunk.mappedData = block.mappedData;
+            chunk.offset = frame.uboBlockOffset;
+            chunk.end = frame.uboBlockOffset + UBO_CHUNK_SIZE;
+            chunk.frameSerial = GfxDeviceGlobal::frameSerial;
+            frame.uboBlockOffset += UBO_CHUNK_SIZE;
+        }
+
+        const UboAllocation allocation = { chunk.buffer, static_cast< std::uint32_t >( chunk.offset ), chunk.mappedData + chunk.offset };
+        chunk.offset += alignedSize;
+
+        return allocation;
+    }
+
     void CreateMsaaColor()
     {
         VkImageCreateInfo info = {};
@@ -218,20 +547,7 @@ namespace ae3d
         AE3D_CHECK_VULKAN( err, "Create MSAA color" );
         debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)GfxDeviceGlobal::msaaTarget.colorImage, VK_OBJECT_TYPE_IMAGE, "MSAA color" );
 
-        VkMemoryRequirements memReqs;
-        vkGetImageMemoryRequirements( GfxDeviceGlobal::device, GfxDeviceGlobal::msaaTarget.colorImage, &memReqs );
-        VkMemoryAllocateInfo memAlloc = {};
-        memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        memAlloc.allocationSize = memReqs.size;
-        memAlloc.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-        
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &memAlloc, nullptr, &GfxDeviceGlobal::msaaTarget.colorMem );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)GfxDeviceGlobal::msaaTarget.colorMem, VK_OBJECT_TYPE_DEVICE_MEMORY, "msaaTarget colorMemory" );
-
-        Statistics::IncTotalAllocCalls();
-        AE3D_CHECK_VULKAN( err, "Create MSAA color" );
-
-        vkBindImageMemory( GfxDeviceGlobal::device, GfxDeviceGlobal::msaaTarget.colorImage, GfxDeviceGlobal::msaaTarget.colorMem, 0 );
+        GfxDeviceGlobal::msaaTarget.colorMem = AllocateAndBindImage( GfxDeviceGlobal::msaaTarget.colorImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryResource::RenderTarget, "msaaTarget colorMemory" );
 
         VkImageViewCreateInfo viewInfo = {};
         viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -271,19 +587,7 @@ namespace ae3d
         AE3D_CHECK_VULKAN( err, "MSAA depth image" );
         debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)GfxDeviceGlobal::msaaTarget.depthImage, VK_OBJECT_TYPE_IMAGE, "MSAA depth" );
 
-        VkMemoryRequirements memReqs;
-        vkGetImageMemoryRequirements( GfxDeviceGlobal::device, GfxDeviceGlobal::msaaTarget.depthImage, &memReqs );
-        VkMemoryAllocateInfo memAlloc = {};
-        memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        memAlloc.allocationSize = memReqs.size;
-        memAlloc.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &memAlloc, nullptr, &GfxDeviceGlobal::msaaTarget.depthMem );
-        Statistics::IncTotalAllocCalls();
-        AE3D_CHECK_VULKAN( err, "MSAA depth memory" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)GfxDeviceGlobal::msaaTarget.depthMem, VK_OBJECT_TYPE_DEVICE_MEMORY, "msaaTarget depthMemory" );
-
-        vkBindImageMemory( GfxDeviceGlobal::device, GfxDeviceGlobal::msaaTarget.depthImage, GfxDeviceGlobal::msaaTarget.depthMem, 0 );
+        GfxDeviceGlobal::msaaTarget.depthMem = AllocateAndBindImage( GfxDeviceGlobal::msaaTarget.depthImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryResource::RenderTarget, "msaaTarget depthMemory" );
 
         // Create image view for the MSAA target
         VkImageViewCreateInfo viewInfo = {};
@@ -303,8 +607,9 @@ namespace ae3d
         AE3D_CHECK_VULKAN( err, "MSAA depth view" );
     }
 
-    void CreatePSO( VertexBuffer& vertexBuffer, ae3d::Shader& shader, ae3d::GfxDevice::BlendMode blendMode, ae3d::GfxDevice::DepthFunc depthFunc,
-                    ae3d::GfxDevice::CullMode cullMode, ae3d::GfxDevice::FillMode fillMode, VkRenderPass renderPass, ae3d::GfxDevice::PrimitiveTopology topology, std::uint64_t hash )
+    /// Compiles a PSO. Doesn't access psoCache, so it can be called from job threads without holding psoCacheMutex.
+    VkPipeline CreatePSO( VertexBuffer::VertexFormat vertexFormat, ae3d::Shader& shader, ae3d::GfxDevice::BlendMode blendMode, ae3d::GfxDevice::DepthFunc depthFunc,
+                          ae3d::GfxDevice::CullMode cullMode, ae3d::GfxDevice::FillMode fillMode, VkRenderPass renderPass, ae3d::GfxDevice::PrimitiveTopology topology )
     {
         VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = {};
         inputAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -411,7 +716,7 @@ namespace ae3d
         pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
         pipelineCreateInfo.layout = GfxDeviceGlobal::pipelineLayout;
         pipelineCreateInfo.renderPass = renderPass != VK_NULL_HANDLE ? renderPass : GfxDeviceGlobal::renderPass;
-        pipelineCreateInfo.pVertexInputState = vertexBuffer.GetInputState();
+        pipelineCreateInfo.pVertexInputState = VertexBuffer::GetInputState( vertexFormat );
         pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
         pipelineCreateInfo.pRasterizationState = &rasterizationState;
         pipelineCreateInfo.pColorBlendState = &colorBlendState;
@@ -428,7 +733,101 @@ namespace ae3d
                                                   nullptr, &pso );
         AE3D_CHECK_VULKAN( err, "vkCreateGraphicsPipelines" );
 
-        GfxDeviceGlobal::psoCache[ hash ] = pso;
+        return pso;
+    }
+
+    /// Stores a compiled PSO into psoCache, unless another thread stored one first.
+    /// \return The PSO in psoCache. pso is destroyed if it's not.
+    VkPipeline PublishPSO( std::uint64_t psoHash, VkPipeline pso )
+    {
+        std::lock_guard< std::mutex > lock( GfxDeviceGlobal::psoCacheMutex );
+        VkPipeline& cached = GfxDeviceGlobal::psoCache[ psoHash ];
+
+        if (cached != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline( GfxDeviceGlobal::device, pso, nullptr );
+            return cached;
+        }
+
+        cached = pso;
+        return pso;
+    }
+
+    /// \return PSO for the state. Creates the PSO if it's not in psoCache. Can be called from job threads.
+    VkPipeline GetPSO( VertexBuffer& vertexBuffer, ae3d::Shader& shader, ae3d::GfxDevice::BlendMode blendMode, ae3d::GfxDevice::DepthFunc depthFunc,
+                       ae3d::GfxDevice::CullMode cullMode, ae3d::GfxDevice::FillMode fillMode, VkRenderPass renderPass, ae3d::GfxDevice::PrimitiveTopology topology )
+    {
+        const std::uint64_t psoHash = GetPSOHash( vertexBuffer.GetVertexFormat(), shader, blendMode, depthFunc, cullMode, fillMode, renderPass, topology );
+
+        {
+            std::lock_guard< std::mutex > lock( GfxDeviceGlobal::psoCacheMutex );
+            auto pso = GfxDeviceGlobal::psoCache.find( psoHash );
+
+            if (pso != std::end( GfxDeviceGlobal::psoCache ) && pso->second != VK_NULL_HANDLE)
+            {
+                return pso->second;
+            }
+
+            // Other threads that draw with the state before it's published compile it too, instead of skipping their draws.
+            GfxDeviceGlobal::psoCache[ psoHash ] = VK_NULL_HANDLE;
+        }
+
+        // A PSO that PrecompilePSOs or another thread is still compiling is compiled here too. The pipeline cache usually makes the second compile cheap,
+        // and the first one to finish is kept.
+        const VkPipeline newPSO = CreatePSO( vertexBuffer.GetVertexFormat(), shader, blendMode, depthFunc, cullMode, fillMode, renderPass, topology );
+        return PublishPSO( psoHash, newPSO );
+    }
+
+    /// Creates pipelineCache from PipelineCacheFileName's contents if they were saved on this device, or empty otherwise.
+    void CreatePipelineCache()
+    {
+        std::vector< char > cacheData;
+        std::ifstream file( GfxDeviceGlobal::PipelineCacheFileName, std::ios::binary );
+
+        if (file)
+        {
+            cacheData.assign( std::istreambuf_iterator< char >( file ), std::istreambuf_iterator< char >() );
+        }
+
+        // The header is checked here because some drivers don't reject data of other devices or driver versions.
+        // Header: length, version, vendor ID and device ID as 32-bit values, followed by the pipeline cache UUID.
+        const std::size_t headerSize = 4 * sizeof( std::uint32_t ) + VK_UUID_SIZE;
+        std::uint32_t headerValues[ 4 ] = {};
+
+        if (cacheData.size() >= headerSize)
+        {
+            std::memcpy( headerValues, cacheData.data(), sizeof( headerValues ) );
+        }
+
+        const bool isCompatible = cacheData.size() >= headerSize && headerValues[ 1 ] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+                                  headerValues[ 2 ] == GfxDeviceGlobal::properties.vendorID && headerValues[ 3 ] == GfxDeviceGlobal::properties.deviceID &&
+                                  std::memcmp( cacheData.data() + sizeof( headerValues ), GfxDeviceGlobal::properties.pipelineCacheUUID, VK_UUID_SIZE ) == 0;
+
+        VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
+        pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        pipelineCacheCreateInfo.initialDataSize = isCompatible ? cacheData.size() : 0;
+        pipelineCacheCreateInfo.pInitialData = isCompatible ? cacheData.data() : nullptr;
+        VkResult err = vkCreatePipelineCache( GfxDeviceGlobal::device, &pipelineCacheCreateInfo, nullptr, &GfxDeviceGlobal::pipelineCache );
+        AE3D_CHECK_VULKAN( err, "vkCreatePipelineCache" );
+    }
+
+    /// Writes pipelineCache's contents into PipelineCacheFileName. Failing to write the file only makes the next run compile PSOs from scratch.
+    void SavePipelineCache()
+    {
+        std::size_t dataSize = 0;
+        VkResult err = vkGetPipelineCacheData( GfxDeviceGlobal::device, GfxDeviceGlobal::pipelineCache, &dataSize, nullptr );
+        AE3D_CHECK_VULKAN( err, "vkGetPipelineCacheData" );
+
+        std::vector< char > cacheData( dataSize );
+        err = vkGetPipelineCacheData( GfxDeviceGlobal::device, GfxDeviceGlobal::pipelineCache, &dataSize, cacheData.data() );
+        AE3D_CHECK_VULKAN( err, "vkGetPipelineCacheData" );
+
+        std::ofstream file( GfxDeviceGlobal::PipelineCacheFileName, std::ios::binary );
+
+        if (!file.write( cacheData.data(), static_cast< std::streamsize >( dataSize ) ))
+        {
+            System::Print( "Could not write pipeline cache to %s\n", GfxDeviceGlobal::PipelineCacheFileName );
+        }
     }
 
     void AllocateCommandBuffers()
@@ -441,47 +840,38 @@ namespace ae3d
         commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         commandBufferAllocateInfo.commandPool = GfxDeviceGlobal::cmdPool;
         commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        commandBufferAllocateInfo.commandBufferCount = GfxDeviceGlobal::swapchainBuffers.count;
-
-        VkResult err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &commandBufferAllocateInfo, GfxDeviceGlobal::drawCmdBuffers );
-        AE3D_CHECK_VULKAN( err, "vkAllocateCommandBuffers" );
-
-        for (unsigned i = 0; i < GfxDeviceGlobal::swapchainBuffers.count; ++i)
-        {
-            debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)GfxDeviceGlobal::drawCmdBuffers[ i ], VK_OBJECT_TYPE_COMMAND_BUFFER, "drawCmdBuffer" );
-        }
-        
         commandBufferAllocateInfo.commandBufferCount = 1;
 
-        err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &commandBufferAllocateInfo, &GfxDeviceGlobal::postPresentCmdBuffer );
-        AE3D_CHECK_VULKAN( err, "vkAllocateCommandBuffers" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)GfxDeviceGlobal::postPresentCmdBuffer, VK_OBJECT_TYPE_COMMAND_BUFFER, "postPresentCmdBuffer" );
+        VkResult err = VK_SUCCESS;
 
-        err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &commandBufferAllocateInfo, &GfxDeviceGlobal::prePresentCmdBuffer );
-        AE3D_CHECK_VULKAN( err, "vkAllocateCommandBuffers" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)GfxDeviceGlobal::prePresentCmdBuffer, VK_OBJECT_TYPE_COMMAND_BUFFER, "prePresentCmdBuffer" );
+        for (auto& frame : GfxDeviceGlobal::frames)
+        {
+            err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &commandBufferAllocateInfo, &frame.drawCmdBuffer );
+            AE3D_CHECK_VULKAN( err, "vkAllocateCommandBuffers" );
+            debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)frame.drawCmdBuffer, VK_OBJECT_TYPE_COMMAND_BUFFER, "drawCmdBuffer" );
 
-        err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &commandBufferAllocateInfo, &GfxDeviceGlobal::offscreenCmdBuffer );
-        AE3D_CHECK_VULKAN( err, "Offscreen command buffer" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)GfxDeviceGlobal::offscreenCmdBuffer, VK_OBJECT_TYPE_COMMAND_BUFFER, "offscreenCmdBuffer" );
+            err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &commandBufferAllocateInfo, &frame.postPresentCmdBuffer );
+            AE3D_CHECK_VULKAN( err, "vkAllocateCommandBuffers" );
+            debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)frame.postPresentCmdBuffer, VK_OBJECT_TYPE_COMMAND_BUFFER, "postPresentCmdBuffer" );
 
-        VkCommandBufferAllocateInfo computeBufAllocateInfo = {};
-        computeBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        computeBufAllocateInfo.commandPool = GfxDeviceGlobal::cmdPool;
-        computeBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        computeBufAllocateInfo.commandBufferCount = 1;
+            err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &commandBufferAllocateInfo, &frame.prePresentCmdBuffer );
+            AE3D_CHECK_VULKAN( err, "vkAllocateCommandBuffers" );
+            debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)frame.prePresentCmdBuffer, VK_OBJECT_TYPE_COMMAND_BUFFER, "prePresentCmdBuffer" );
 
-        err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &computeBufAllocateInfo, &GfxDeviceGlobal::computeCmdBuffer );
-        AE3D_CHECK_VULKAN( err, "vkAllocateCommandBuffers" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)GfxDeviceGlobal::computeCmdBuffer, VK_OBJECT_TYPE_COMMAND_BUFFER, "computeCmdBuffer" );
+            err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &commandBufferAllocateInfo, &frame.offscreenCmdBuffer );
+            AE3D_CHECK_VULKAN( err, "Offscreen command buffer" );
+            debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)frame.offscreenCmdBuffer, VK_OBJECT_TYPE_COMMAND_BUFFER, "offscreenCmdBuffer" );
+        }
     }
 
     void SubmitPrePresentBarrier()
     {
+        VkCommandBuffer& prePresentCmdBuffer = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ].prePresentCmdBuffer;
+
         VkCommandBufferBeginInfo cmdBufInfo = {};
         cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-        VkResult err = vkBeginCommandBuffer( GfxDeviceGlobal::prePresentCmdBuffer, &cmdBufInfo );
+        VkResult err = vkBeginCommandBuffer( prePresentCmdBuffer, &cmdBufInfo );
         AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer" );
 
         VkImageMemoryBarrier prePresentBarrier = {};
@@ -496,7 +886,7 @@ namespace ae3d
         prePresentBarrier.image = GfxDeviceGlobal::swapchainBuffers[ GfxDeviceGlobal::currentBuffer ].image;
 
         vkCmdPipelineBarrier(
-            GfxDeviceGlobal::prePresentCmdBuffer,
+            prePresentCmdBuffer,
             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
             0,
@@ -505,24 +895,27 @@ namespace ae3d
             1, &prePresentBarrier );
         Statistics::IncBarrierCalls();
 
-        err = vkEndCommandBuffer( GfxDeviceGlobal::prePresentCmdBuffer );
+        err = vkEndCommandBuffer( prePresentCmdBuffer );
         AE3D_CHECK_VULKAN( err, "vkEndCommandBuffer" );
 
         VkSubmitInfo submitInfo = {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
         submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &GfxDeviceGlobal::prePresentCmdBuffer;
+        submitInfo.pCommandBuffers = &prePresentCmdBuffer;
 
-        err = vkQueueSubmit( GfxDeviceGlobal::graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE );
+        // The frame's last submit, so its fence also covers the frame's earlier submits.
+        err = vkQueueSubmit( GfxDeviceGlobal::graphicsQueue, 1, &submitInfo, GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ].fence );
         AE3D_CHECK_VULKAN( err, "vkQueueSubmit" );
     }
 
     void SubmitPostPresentBarrier()
     {
+        VkCommandBuffer& postPresentCmdBuffer = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ].postPresentCmdBuffer;
+
         VkCommandBufferBeginInfo cmdBufInfo = {};
         cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-        VkResult err = vkBeginCommandBuffer( GfxDeviceGlobal::postPresentCmdBuffer, &cmdBufInfo );
+        VkResult err = vkBeginCommandBuffer( postPresentCmdBuffer, &cmdBufInfo );
         AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer" );
 
         VkImageMemoryBarrier postPresentBarrier = {};
@@ -537,7 +930,7 @@ namespace ae3d
         postPresentBarrier.image = GfxDeviceGlobal::swapchainBuffers[ GfxDeviceGlobal::currentBuffer ].image;
 
         vkCmdPipelineBarrier(
-            GfxDeviceGlobal::postPresentCmdBuffer,
+            postPresentCmdBuffer,
             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
             0,
@@ -546,13 +939,13 @@ namespace ae3d
             1, &postPresentBarrier );
         Statistics::IncBarrierCalls();
 
-        err = vkEndCommandBuffer( GfxDeviceGlobal::postPresentCmdBuffer );
+        err = vkEndCommandBuffer( postPresentCmdBuffer );
         AE3D_CHECK_VULKAN( err, "vkEndCommandBuffer" );
 
         VkSubmitInfo submitPostInfo = {};
         submitPostInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
         submitPostInfo.commandBufferCount = 1;
-        submitPostInfo.pCommandBuffers = &GfxDeviceGlobal::postPresentCmdBuffer;
+        submitPostInfo.pCommandBuffers = &postPresentCmdBuffer;
 
         err = vkQueueSubmit( GfxDeviceGlobal::graphicsQueue, 1, &submitPostInfo, VK_NULL_HANDLE );
         AE3D_CHECK_VULKAN( err, "vkQueueSubmit" );
@@ -643,15 +1036,9 @@ namespace ae3d
 
         std::uint32_t graphicsQueueNodeIndex = UINT32_MAX;
         std::uint32_t presentQueueNodeIndex = UINT32_MAX;
-        std::uint32_t computeQueueNodeIndex = UINT32_MAX;
 
         for (std::uint32_t i = 0; i < queueCount; ++i)
         {
-            if ((queueProps[ i ].queueFlags & VK_QUEUE_COMPUTE_BIT) != 0 && computeQueueNodeIndex == UINT32_MAX)
-            {
-                computeQueueNodeIndex = i;
-            }
-            
             if ((queueProps[ i ].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0)
             {
                 if (graphicsQueueNodeIndex == UINT32_MAX)
@@ -692,13 +1079,6 @@ namespace ae3d
             System::Assert( false, "graphics and present queues must have the same index" );
         }
 
-        if (computeQueueNodeIndex == UINT32_MAX)
-        {
-            System::Assert( false, "compute queue not found" );
-        }
-
-        vkGetDeviceQueue( GfxDeviceGlobal::device, computeQueueNodeIndex, 0, &GfxDeviceGlobal::computeQueue );
-
         GfxDeviceGlobal::queueNodeIndex = graphicsQueueNodeIndex;
 
         std::uint32_t formatCount;
@@ -928,9 +1308,10 @@ namespace ae3d
         vkGetPhysicalDeviceQueueFamilyProperties( GfxDeviceGlobal::physicalDevice, &queueCount, queueProps.elements );
         std::uint32_t graphicsQueueIndex = 0;
 
+        // Compute dispatches are recorded into the frame's command buffers, so the queue must also support compute.
         for (graphicsQueueIndex = 0; graphicsQueueIndex < queueCount; ++graphicsQueueIndex)
         {
-            if (queueProps[ graphicsQueueIndex ].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+            if ((queueProps[ graphicsQueueIndex ].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
             {
                 break;
             }
@@ -970,6 +1351,7 @@ namespace ae3d
         enabledFeatures.samplerAnisotropy = GfxDeviceGlobal::deviceFeatures.samplerAnisotropy;
         enabledFeatures.fragmentStoresAndAtomics = GfxDeviceGlobal::deviceFeatures.fragmentStoresAndAtomics;
         enabledFeatures.vertexPipelineStoresAndAtomics = GfxDeviceGlobal::deviceFeatures.vertexPipelineStoresAndAtomics;
+        enabledFeatures.multiDrawIndirect = GfxDeviceGlobal::deviceFeatures.multiDrawIndirect;
         
         if (debug::enabled)
         {
@@ -1089,7 +1471,8 @@ namespace ae3d
         attachments[ 1 ].format = GfxDeviceGlobal::depthFormat;
         attachments[ 1 ].samples = VK_SAMPLE_COUNT_1_BIT;
         attachments[ 1 ].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        attachments[ 1 ].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        // Stored, so loadRenderPass can continue the render pass.
+        attachments[ 1 ].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         attachments[ 1 ].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         attachments[ 1 ].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         attachments[ 1 ].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
@@ -1126,6 +1509,13 @@ namespace ae3d
         debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)GfxDeviceGlobal::renderPass, VK_OBJECT_TYPE_RENDER_PASS, "renderpass nonMSAA" );
 
         AE3D_CHECK_VULKAN( err, "vkCreateRenderPass" );   
+
+        attachments[ 0 ].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        attachments[ 1 ].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+
+        err = vkCreateRenderPass( GfxDeviceGlobal::device, &renderPassInfo, nullptr, &GfxDeviceGlobal::loadRenderPass );
+        AE3D_CHECK_VULKAN( err, "vkCreateRenderPass load" );
+        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)GfxDeviceGlobal::loadRenderPass, VK_OBJECT_TYPE_RENDER_PASS, "renderpass nonMSAA load" );
     }
 
     void CreateRenderPassMSAA()
@@ -1209,6 +1599,12 @@ namespace ae3d
 
         VkResult err = vkCreateRenderPass( GfxDeviceGlobal::device, &renderPassInfo, nullptr, &GfxDeviceGlobal::renderPass );
         AE3D_CHECK_VULKAN( err, "vkCreateRenderPass" );
+
+        attachments[ 0 ].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        attachments[ 2 ].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+
+        err = vkCreateRenderPass( GfxDeviceGlobal::device, &renderPassInfo, nullptr, &GfxDeviceGlobal::loadRenderPass );
+        AE3D_CHECK_VULKAN( err, "vkCreateRenderPass load" );
     }
 
     void CreateDepthStencil()
@@ -1225,11 +1621,6 @@ namespace ae3d
         image.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
         image.flags = 0;
 
-        VkMemoryAllocateInfo mem_alloc = {};
-        mem_alloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        mem_alloc.allocationSize = 0;
-        mem_alloc.memoryTypeIndex = 0;
-
         VkImageViewCreateInfo depthStencilView = {};
         depthStencilView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
         depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D;
@@ -1246,16 +1637,7 @@ namespace ae3d
         AE3D_CHECK_VULKAN( err, "depth stencil" );
         debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)GfxDeviceGlobal::depthStencil.image, VK_OBJECT_TYPE_IMAGE, "depthstencil" );
 
-        VkMemoryRequirements memReqs;
-        vkGetImageMemoryRequirements( GfxDeviceGlobal::device, GfxDeviceGlobal::depthStencil.image, &memReqs );
-        mem_alloc.allocationSize = memReqs.size;
-        mem_alloc.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &mem_alloc, nullptr, &GfxDeviceGlobal::depthStencil.mem );
-        Statistics::IncTotalAllocCalls();
-        AE3D_CHECK_VULKAN( err, "depth stencil memory" );
-
-        err = vkBindImageMemory( GfxDeviceGlobal::device, GfxDeviceGlobal::depthStencil.image, GfxDeviceGlobal::depthStencil.mem, 0 );
-        AE3D_CHECK_VULKAN( err, "depth stencil memory" );
+        GfxDeviceGlobal::depthStencil.mem = AllocateAndBindImage( GfxDeviceGlobal::depthStencil.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryResource::RenderTarget, "depthstencil memory" );
         SetImageLayout( GfxDeviceGlobal::setupCmdBuffer, GfxDeviceGlobal::depthStencil.image, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
                         VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1, 0, 1 );
 
@@ -1291,66 +1673,117 @@ namespace ae3d
         GfxDeviceGlobal::setupCmdBuffer = VK_NULL_HANDLE;
     }
 
-    void CreateDescriptorPool()
-    {
-        const int AE3D_DESCRIPTOR_SETS_COUNT = 1550;
+    /// Sets in each of a frame's set 0 pools.
+    const std::uint32_t DESCRIPTOR_SETS_PER_POOL = 512;
 
-        const std::uint32_t typeCount = 13;
+    void AddDescriptorPool( GfxDeviceGlobal::FrameResources& frame )
+    {
+        // Descriptors of set 0's layout.
+        const std::uint32_t typeCount = 6;
         const VkDescriptorPoolSize typeCounts[ typeCount ] =
         {
-            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT },
-            { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, AE3D_DESCRIPTOR_SETS_COUNT },
-            { VK_DESCRIPTOR_TYPE_SAMPLER, AE3D_DESCRIPTOR_SETS_COUNT },
-            { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT },
-            { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT },
-            { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, AE3D_DESCRIPTOR_SETS_COUNT },
-            { VK_DESCRIPTOR_TYPE_SAMPLER, AE3D_DESCRIPTOR_SETS_COUNT },
-            { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT },
-            { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT },
-            { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT },
-            { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT },
-            { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, AE3D_DESCRIPTOR_SETS_COUNT },
-            { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, AE3D_DESCRIPTOR_SETS_COUNT }
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, DESCRIPTOR_SETS_PER_POOL * UboBlockTracker::BlockCount },
+            { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, DESCRIPTOR_SETS_PER_POOL * 3 },
+            { VK_DESCRIPTOR_TYPE_SAMPLER, DESCRIPTOR_SETS_PER_POOL * 2 },
+            { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, DESCRIPTOR_SETS_PER_POOL * 5 },
+            { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, DESCRIPTOR_SETS_PER_POOL },
+            { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, DESCRIPTOR_SETS_PER_POOL }
         };
 
         VkDescriptorPoolCreateInfo descriptorPoolInfo = {};
         descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
         descriptorPoolInfo.poolSizeCount = typeCount;
         descriptorPoolInfo.pPoolSizes = typeCounts;
-        descriptorPoolInfo.maxSets = AE3D_DESCRIPTOR_SETS_COUNT;
-        descriptorPoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        descriptorPoolInfo.maxSets = DESCRIPTOR_SETS_PER_POOL;
 
-        VkResult err = vkCreateDescriptorPool( GfxDeviceGlobal::device, &descriptorPoolInfo, nullptr, &GfxDeviceGlobal::descriptorPool );
+        VkDescriptorPool pool = VK_NULL_HANDLE;
+        VkResult err = vkCreateDescriptorPool( GfxDeviceGlobal::device, &descriptorPoolInfo, nullptr, &pool );
         AE3D_CHECK_VULKAN( err, "vkCreateDescriptorPool" );
 
-        GfxDeviceGlobal::descriptorSets.Allocate( AE3D_DESCRIPTOR_SETS_COUNT );
+        frame.descriptorPools.push_back( pool );
+    }
+
+    void CreateDescriptorPool()
+    {
+        const VkDescriptorPoolSize indirectTypeCount = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * INDIRECT_CULLS_PER_FRAME };
+
+        VkDescriptorPoolCreateInfo indirectPoolInfo = {};
+        indirectPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        indirectPoolInfo.poolSizeCount = 1;
+        indirectPoolInfo.pPoolSizes = &indirectTypeCount;
+        indirectPoolInfo.maxSets = INDIRECT_CULLS_PER_FRAME;
+
+        for (auto& frame : GfxDeviceGlobal::frames)
+        {
+            AddDescriptorPool( frame );
+
+            VkResult err = vkCreateDescriptorPool( GfxDeviceGlobal::device, &indirectPoolInfo, nullptr, &frame.indirectDescriptorPool );
+            AE3D_CHECK_VULKAN( err, "vkCreateDescriptorPool indirect" );
+        }
+    }
+
+    /// \param frame Frame whose pools the set is allocated from. Caller must hold descriptorSetMutex.
+    /// \return Set 0 that is valid until the frame's resources are reused.
+    VkDescriptorSet AllocateDescriptorSetFromPool( GfxDeviceGlobal::FrameResources& frame )
+    {
+        if (frame.currentPoolDescriptorSets == DESCRIPTOR_SETS_PER_POOL)
+        {
+            ++frame.currentDescriptorPool;
+            frame.currentPoolDescriptorSets = 0;
+        }
 
-        for (unsigned i = 0; i < GfxDeviceGlobal::descriptorSets.count; ++i)
+        if (frame.currentDescriptorPool == frame.descriptorPools.size())
         {
-            VkDescriptorSetAllocateInfo allocInfo = {};
-            allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-            allocInfo.descriptorPool = GfxDeviceGlobal::descriptorPool;
-            allocInfo.descriptorSetCount = 1;
-            allocInfo.pSetLayouts = &GfxDeviceGlobal::descriptorSetLayout;
+            AddDescriptorPool( frame );
+        }
+
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = frame.descriptorPools[ frame.currentDescriptorPool ];
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &GfxDeviceGlobal::descriptorSetLayout;
+
+        VkDescriptorSet outDescriptorSet = VK_NULL_HANDLE;
+        VkResult err = vkAllocateDescriptorSets( GfxDeviceGlobal::device, &allocInfo, &outDescriptorSet );
+        AE3D_CHECK_VULKAN( err, "vkAllocateDescriptorSets" );
+        ++frame.currentPoolDescriptorSets;
+
+        return outDescriptorSet;
+    }
 
-            err = vkAllocateDescriptorSets( GfxDeviceGlobal::device, &allocInfo, &GfxDeviceGlobal::descriptorSets[ i ] );
-            AE3D_CHECK_VULKAN( err, "vkAllocateDescriptorSets" );
+    std::uint64_t GetDescriptorSetHash( const GfxDeviceGlobal::DescriptorSetKey& key )
+    {
+        // FNV-1a
+        const std::uint8_t* bytes = reinterpret_cast< const std::uint8_t* >( &key );
+        std::uint64_t outHash = 14695981039346656037ull;
+
+        for (std::size_t i = 0; i < sizeof( key ); ++i)
+        {
+            outHash = (outHash ^ bytes[ i ]) * 1099511628211ull;
         }
+
+        return outHash;
     }
 
-    VkDescriptorSet AllocateDescriptorSet( const VkDescriptorBufferInfo& uboDesc, const VkImageView& view0, VkSampler sampler0, const VkImageView& view1, VkSampler sampler1, const VkImageView& view11, const VkImageView& view12 )
+    void WriteDescriptorSet( VkDescriptorSet outDescriptorSet, const UboBindings& ubos, const VkImageView& view0, VkSampler sampler0, const VkImageView& view1, VkSampler sampler1, const VkImageView& view11, const VkImageView& view12 )
     {
-        VkDescriptorSet outDescriptorSet = GfxDeviceGlobal::descriptorSets[ GfxDeviceGlobal::descriptorSetIndex ];
-        GfxDeviceGlobal::descriptorSetIndex = (GfxDeviceGlobal::descriptorSetIndex + 1) % GfxDeviceGlobal::descriptorSets.count;
+        VkDescriptorBufferInfo uboDescs[ UboBlockTracker::BlockCount ] = {};
+        VkWriteDescriptorSet uboSets[ UboBlockTracker::BlockCount ] = {};
 
-        // Binding 0 : Uniform buffer
-        VkWriteDescriptorSet uboSet = {};
-        uboSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        uboSet.dstSet = outDescriptorSet;
-        uboSet.descriptorCount = 1;
-        uboSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        uboSet.pBufferInfo = &uboDesc;
-        uboSet.dstBinding = 0;
+        // Bindings 0, 13-16 : Uniform blocks, offset by the draw's dynamic offsets
+        for (int block = 0; block < UboBlockTracker::BlockCount; ++block)
+        {
+            uboDescs[ block ].buffer = ubos.buffers[ block ];
+            uboDescs[ block ].offset = 0;
+            uboDescs[ block ].range = UboBlockTracker::GetBlockSize( static_cast< UboBlockTracker::Block >( block ) );
+
+            uboSets[ block ].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            uboSets[ block ].dstSet = outDescriptorSet;
+            uboSets[ block ].descriptorCount = 1;
+            uboSets[ block ].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            uboSets[ block ].pBufferInfo = &uboDescs[ block ];
+            uboSets[ block ].dstBinding = UBO_BLOCK_BINDINGS[ block ];
+        }
 
         VkDescriptorImageInfo sampler0Desc = {};
         sampler0Desc.sampler = sampler0;
@@ -1386,7 +1819,7 @@ namespace ae3d
         bufferSet.dstSet = outDescriptorSet;
         bufferSet.descriptorCount = 1;
         bufferSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
-        bufferSet.pTexelBufferView = GfxDeviceGlobal::lightTiler.GetPointLightBufferView();
+        bufferSet.pTexelBufferView = GfxDeviceGlobal::lightTiler.GetPointLightBufferView( GfxDeviceGlobal::frameIndex );
         bufferSet.dstBinding = 3;
 
         // Binding 4 : Buffer (UAV)
@@ -1395,7 +1828,7 @@ namespace ae3d
         bufferSetUAV.dstSet = outDescriptorSet;
         bufferSetUAV.descriptorCount = 1;
         bufferSetUAV.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
-        bufferSetUAV.pTexelBufferView = GfxDeviceGlobal::lightTiler.GetLightIndexBufferView();
+        bufferSetUAV.pTexelBufferView = GfxDeviceGlobal::lightTiler.GetLightIndexBufferView( GfxDeviceGlobal::frameIndex );
         bufferSetUAV.dstBinding = 4;
 
         // Binding 5 : Image
@@ -1422,7 +1855,7 @@ namespace ae3d
         bufferSet2.dstSet = outDescriptorSet;
         bufferSet2.descriptorCount = 1;
         bufferSet2.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
-        bufferSet2.pTexelBufferView = GfxDeviceGlobal::lightTiler.GetPointLightColorBufferView();
+        bufferSet2.pTexelBufferView = GfxDeviceGlobal::lightTiler.GetPointLightColorBufferView( GfxDeviceGlobal::frameIndex );
         bufferSet2.dstBinding = 7;
 
         // Binding 8 : Buffer
@@ -1431,7 +1864,7 @@ namespace ae3d
         bufferSet3.dstSet = outDescriptorSet;
         bufferSet3.descriptorCount = 1;
         bufferSet3.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
-        bufferSet3.pTexelBufferView = GfxDeviceGlobal::lightTiler.GetSpotLightBufferView();
+        bufferSet3.pTexelBufferView = GfxDeviceGlobal::lightTiler.GetSpotLightBufferView( GfxDeviceGlobal::frameIndex );
         bufferSet3.dstBinding = 8;
 
         // Binding 9 : Buffer
@@ -1440,7 +1873,7 @@ namespace ae3d
         bufferSet4.dstSet = outDescriptorSet;
         bufferSet4.descriptorCount = 1;
         bufferSet4.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
-        bufferSet4.pTexelBufferView = GfxDeviceGlobal::lightTiler.GetSpotLightParamsView();
+        bufferSet4.pTexelBufferView = GfxDeviceGlobal::lightTiler.GetSpotLightParamsView( GfxDeviceGlobal::frameIndex );
         bufferSet4.dstBinding = 9;
 
 		// Binding 10 : Buffer
@@ -1449,7 +1882,7 @@ namespace ae3d
 		bufferSet5.dstSet = outDescriptorSet;
 		bufferSet5.descriptorCount = 1;
 		bufferSet5.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
-		bufferSet5.pTexelBufferView = GfxDeviceGlobal::lightTiler.GetSpotLightColorBufferView();
+		bufferSet5.pTexelBufferView = GfxDeviceGlobal::lightTiler.GetSpotLightColorBufferView( GfxDeviceGlobal::frameIndex );
 		bufferSet5.dstBinding = 10;
 
         VkDescriptorImageInfo sampler11Desc = {};
@@ -1480,21 +1913,85 @@ namespace ae3d
         imageSet3.pImageInfo = &sampler3Desc;
         imageSet3.dstBinding = 12;
 
-        const int setCount = 13;
-        VkWriteDescriptorSet sets[ setCount ] = { uboSet, samplerSet, imageSet, bufferSet, bufferSetUAV, imageSet2, samplerSet2, bufferSet2, bufferSet3, bufferSet4, bufferSet5, rwImageSet, imageSet3 };
+        const int setCount = 12 + UboBlockTracker::BlockCount;
+        VkWriteDescriptorSet sets[ setCount ] = { samplerSet, imageSet, bufferSet, bufferSetUAV, imageSet2, samplerSet2, bufferSet2, bufferSet3, bufferSet4, bufferSet5, rwImageSet, imageSet3,
+                                                  uboSets[ 0 ], uboSets[ 1 ], uboSets[ 2 ], uboSets[ 3 ], uboSets[ 4 ] };
         vkUpdateDescriptorSets( GfxDeviceGlobal::device, setCount, sets, 0, nullptr );
+    }
+
+    /// Returns a set 0 that has the bindings. Sets are cached per frame, so draws and dispatches with the same bindings share a set
+    /// and only new bindings are written. Can be called from job threads.
+    VkDescriptorSet AllocateDescriptorSet( const UboBindings& ubos, const VkImageView& view0, VkSampler sampler0, const VkImageView& view1, VkSampler sampler1, const VkImageView& view11, const VkImageView& view12 )
+    {
+        GfxDeviceGlobal::DescriptorSetKey key = {};
+
+        for (int block = 0; block < UboBlockTracker::BlockCount; ++block)
+        {
+            key.ubos[ block ] = ubos.buffers[ block ];
+        }
+
+        key.views[ 0 ] = view0;
+        key.views[ 1 ] = view1;
+        key.views[ 2 ] = view11;
+        key.views[ 3 ] = view12;
+        key.samplers[ 0 ] = sampler0;
+        key.samplers[ 1 ] = sampler1;
+
+        if (GfxDeviceGlobal::lastDescriptorSetFrameSerial == GfxDeviceGlobal::frameSerial &&
+            std::memcmp( &key, &GfxDeviceGlobal::lastDescriptorSetKey, sizeof( key ) ) == 0)
+        {
+            return GfxDeviceGlobal::lastDescriptorSet;
+        }
+
+        const std::uint64_t hash = GetDescriptorSetHash( key );
+        auto& frame = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ];
+        VkDescriptorSet outDescriptorSet = VK_NULL_HANDLE;
+        bool isNewSet = false;
+
+        {
+            std::lock_guard< std::mutex > lock( GfxDeviceGlobal::descriptorSetMutex );
+            auto cached = frame.descriptorSetCache.find( hash );
+
+            if (cached != std::end( frame.descriptorSetCache ) && std::memcmp( &key, &cached->second.key, sizeof( key ) ) == 0)
+            {
+                outDescriptorSet = cached->second.descriptorSet;
+            }
+            else
+            {
+                outDescriptorSet = AllocateDescriptorSetFromPool( frame );
+                isNewSet = true;
+            }
+        }
+
+        if (isNewSet)
+        {
+            // The set is only visible to this thread until it's written and added to the cache.
+            WriteDescriptorSet( outDescriptorSet, ubos, view0, sampler0, view1, sampler1, view11, view12 );
+
+            std::lock_guard< std::mutex > lock( GfxDeviceGlobal::descriptorSetMutex );
+            // If another thread added a set for the same hash meanwhile, this one isn't cached.
+            frame.descriptorSetCache.insert( { hash, { key, outDescriptorSet } } );
+        }
+
+        GfxDeviceGlobal::lastDescriptorSetKey = key;
+        GfxDeviceGlobal::lastDescriptorSet = outDescriptorSet;
+        GfxDeviceGlobal::lastDescriptorSetFrameSerial = GfxDeviceGlobal::frameSerial;
 
         return outDescriptorSet;
     }
 
     void CreateDescriptorSetLayout()
     {
-        // Binding 0 : Uniform buffer
-        VkDescriptorSetLayoutBinding layoutBindingUBO = {};
-        layoutBindingUBO.binding = 0;
-        layoutBindingUBO.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        layoutBindingUBO.descriptorCount = 1;
-        layoutBindingUBO.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+        // Bindings 0, 13-16 : Object, frame, camera, material and skin uniform blocks
+        VkDescriptorSetLayoutBinding layoutBindingUBOs[ UboBlockTracker::BlockCount ] = {};
+
+        for (int block = 0; block < UboBlockTracker::BlockCount; ++block)
+        {
+            layoutBindingUBOs[ block ].binding = UBO_BLOCK_BINDINGS[ block ];
+            layoutBindingUBOs[ block ].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            layoutBindingUBOs[ block ].descriptorCount = 1;
+            layoutBindingUBOs[ block ].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+        }
 
         // Binding 1 : Image
         VkDescriptorSetLayoutBinding layoutBindingImage = {};
@@ -1580,10 +2077,11 @@ namespace ae3d
         layoutBindingImage3.descriptorCount = 1;
         layoutBindingImage3.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
 
-        constexpr int bindingCount = 13;
-        const VkDescriptorSetLayoutBinding bindings[ bindingCount ] = { layoutBindingUBO, layoutBindingImage, layoutBindingSampler, layoutBindingBuffer,
+        constexpr int bindingCount = 12 + UboBlockTracker::BlockCount;
+        const VkDescriptorSetLayoutBinding bindings[ bindingCount ] = { layoutBindingUBOs[ 0 ], layoutBindingImage, layoutBindingSampler, layoutBindingBuffer,
                                                                         layoutBindingBufferUAV, layoutBindingImage2, layoutBindingSampler2, layoutBindingBuffer2,
-                                                                        layoutBindingBuffer3, layoutBindingBuffer4, layoutBindingBuffer5, layoutBindingUAV, layoutBindingImage3 };
+                                                                        layoutBindingBuffer3, layoutBindingBuffer4, layoutBindingBuffer5, layoutBindingUAV, layoutBindingImage3,
+                                                                        layoutBindingUBOs[ 1 ], layoutBindingUBOs[ 2 ], layoutBindingUBOs[ 3 ], layoutBindingUBOs[ 4 ] };
 
         VkDescriptorSetLayoutCreateInfo descriptorLayout = {};
         descriptorLayout.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -1593,10 +2091,31 @@ namespace ae3d
         VkResult err = vkCreateDescriptorSetLayout( GfxDeviceGlobal::device, &descriptorLayout, nullptr, &GfxDeviceGlobal::descriptorSetLayout );
         AE3D_CHECK_VULKAN( err, "vkCreateDescriptorSetLayout" );
 
+        // Set 1: indirect instances, draw commands and visible instance indices.
+        VkDescriptorSetLayoutBinding indirectBindings[ 3 ] = {};
+
+        for (std::uint32_t i = 0; i < 3; ++i)
+        {
+            indirectBindings[ i ].binding = i;
+            indirectBindings[ i ].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            indirectBindings[ i ].descriptorCount = 1;
+            indirectBindings[ i ].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+
+        VkDescriptorSetLayoutCreateInfo indirectLayout = {};
+        indirectLayout.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        indirectLayout.bindingCount = 3;
+        indirectLayout.pBindings = indirectBindings;
+
+        err = vkCreateDescriptorSetLayout( GfxDeviceGlobal::device, &indirectLayout, nullptr, &GfxDeviceGlobal::indirectDescriptorSetLayout );
+        AE3D_CHECK_VULKAN( err, "vkCreateDescriptorSetLayout indirect" );
+
+        const VkDescriptorSetLayout setLayouts[ 2 ] = { GfxDeviceGlobal::descriptorSetLayout, GfxDeviceGlobal::indirectDescriptorSetLayout };
+
         VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = {};
         pPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pPipelineLayoutCreateInfo.setLayoutCount = 1;
-        pPipelineLayoutCreateInfo.pSetLayouts = &GfxDeviceGlobal::descriptorSetLayout;
+        pPipelineLayoutCreateInfo.setLayoutCount = 2;
+        pPipelineLayoutCreateInfo.pSetLayouts = setLayouts;
 
         err = vkCreatePipelineLayout( GfxDeviceGlobal::device, &pPipelineLayoutCreateInfo, nullptr, &GfxDeviceGlobal::pipelineLayout );
         AE3D_CHECK_VULKAN( err, "vkCreatePipelineLayout" );
@@ -1607,16 +2126,54 @@ namespace ae3d
         VkSemaphoreCreateInfo semaphoreCreateInfo = {};
         semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-        VkResult err = vkCreateSemaphore( GfxDeviceGlobal::device, &semaphoreCreateInfo, nullptr, &GfxDeviceGlobal::presentCompleteSemaphore );
+        VkResult err = vkCreateSemaphore( GfxDeviceGlobal::device, &semaphoreCreateInfo, nullptr, &GfxDeviceGlobal::offscreenSemaphore );
         AE3D_CHECK_VULKAN( err, "vkCreateSemaphore" );
 
-        err = vkCreateSemaphore( GfxDeviceGlobal::device, &semaphoreCreateInfo, nullptr, &GfxDeviceGlobal::renderCompleteSemaphore );
-        AE3D_CHECK_VULKAN( err, "vkCreateSemaphore" );
+        for (auto& frame : GfxDeviceGlobal::frames)
+        {
+            err = vkCreateSemaphore( GfxDeviceGlobal::device, &semaphoreCreateInfo, nullptr, &frame.presentCompleteSemaphore );
+            AE3D_CHECK_VULKAN( err, "vkCreateSemaphore" );
 
-        err = vkCreateSemaphore( GfxDeviceGlobal::device, &semaphoreCreateInfo, nullptr, &GfxDeviceGlobal::offscreenSemaphore );
-        AE3D_CHECK_VULKAN( err, "vkCreateSemaphore" );
+            err = vkCreateSemaphore( GfxDeviceGlobal::device, &semaphoreCreateInfo, nullptr, &frame.renderCompleteSemaphore );
+            AE3D_CHECK_VULKAN( err, "vkCreateSemaphore" );
+        }
+    }
+
+    void CreateFences()
+    {
+        VkFenceCreateInfo fenceCreateInfo = {};
+        fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        // The first BeginFrame of each frame doesn't have to wait.
+        fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        for (auto& frame : GfxDeviceGlobal::frames)
+        {
+            VkResult err = vkCreateFence( GfxDeviceGlobal::device, &fenceCreateInfo, nullptr, &frame.fence );
+            AE3D_CHECK_VULKAN( err, "vkCreateFence" );
+
+            err = vkCreateFence( GfxDeviceGlobal::device, &fenceCreateInfo, nullptr, &frame.offscreenFence );
+            AE3D_CHECK_VULKAN( err, "vkCreateFence offscreen" );
+        }
     }
     
+    void CreateIndirectBuffers()
+    {
+        auto& indirect = GfxDeviceGlobal::indirect;
+
+        CreateBuffer( indirect.instances, MAX_FRAMES_IN_FLIGHT * INDIRECT_INSTANCE_COUNT * sizeof( GpuIndirectInstance ), indirect.instancesMemory, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "indirect instances" );
+        indirect.mappedInstances = static_cast< GpuIndirectInstance* >( indirect.instancesMemory.mappedData );
+        indirect.residentInstances.resize( INDIRECT_INSTANCE_COUNT );
+
+        CreateBuffer( indirect.commands, MAX_FRAMES_IN_FLIGHT * INDIRECT_DRAW_COUNT * sizeof( VkDrawIndexedIndirectCommand ), indirect.commandsMemory,
+                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "indirect commands" );
+        indirect.mappedCommands = static_cast< VkDrawIndexedIndirectCommand* >( indirect.commandsMemory.mappedData );
+
+        CreateBuffer( indirect.visibleInstances, MAX_FRAMES_IN_FLIGHT * INDIRECT_INSTANCE_COUNT * sizeof( std::uint32_t ), indirect.visibleInstancesMemory, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "indirect visible instances" );
+    }
+
     void CreateRenderer( int samples )
     {
         GfxDeviceGlobal::msaaSampleBits = GetSampleBits( samples );
@@ -1659,15 +2216,12 @@ namespace ae3d
             CreateFramebufferNonMSAA();
         }
 
-        VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
-        pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-        VkResult err = vkCreatePipelineCache( GfxDeviceGlobal::device, &pipelineCacheCreateInfo, nullptr, &GfxDeviceGlobal::pipelineCache );
-        AE3D_CHECK_VULKAN( err, "vkCreatePipelineCache" );
-
+        CreatePipelineCache();
         FlushSetupCommandBuffer();
         CreateDescriptorSetLayout();
         CreateDescriptorPool();
-        CreateSemaphores();        
+        CreateSemaphores();
+        CreateFences();
 
         GfxDevice::SetClearColor( 0, 0, 0 );
         GfxDevice::CreateUniformBuffers();
@@ -1675,16 +2229,21 @@ namespace ae3d
         VkQueryPoolCreateInfo queryPoolInfo = {};
         queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
         queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
-        queryPoolInfo.queryCount = 2;
+        queryPoolInfo.queryCount = 2 * MAX_FRAMES_IN_FLIGHT;
 
-        err = vkCreateQueryPool( GfxDeviceGlobal::device, &queryPoolInfo, nullptr, &GfxDeviceGlobal::queryPool );
+        VkResult err = vkCreateQueryPool( GfxDeviceGlobal::device, &queryPoolInfo, nullptr, &GfxDeviceGlobal::queryPool );
         AE3D_CHECK_VULKAN( err, "vkCreateQueryPool" );
 
-        GfxDeviceGlobal::uiVertexBuffer.GenerateDynamic( UI_FACE_COUNT, UI_VERTICE_COUNT );
+        for (auto& frame : GfxDeviceGlobal::frames)
+        {
+            frame.uiVertexBuffer.GenerateDynamic( UI_FACE_COUNT, UI_VERTICE_COUNT );
+        }
 
         renderer.builtinShaders.lightCullShader.LoadSPIRV( FileSystem::FileContents( "LightCuller.spv" ) );
+        renderer.builtinShaders.indirectCullShader.LoadSPIRV( FileSystem::FileContents( "IndirectCuller.spv" ) );
 
         GfxDeviceGlobal::lightTiler.Init();
+        CreateIndirectBuffers();
 
         VkCommandBufferAllocateInfo cmdBufInfo = {};
         cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -1698,21 +2257,99 @@ namespace ae3d
     }
 }
 
+/// Copies the blocks of perObjectUboStruct that changed since the thread's last upload in this frame into the frame's uniform ring.
+/// Unchanged blocks keep their earlier ranges, so a draw that only moves an object uploads only its object block.
+/// \param instanceCount Instance count of an instanced draw. Instanced shaders read a bone matrix per instance.
+/// \return Ranges of all blocks, valid until the frame's fence.
+const UboBindings& UploadPerObjectUbo( int instanceCount )
+{
+    // Skin is most of the uniforms, so only the matrices that skinning or instancing set are uploaded.
+    const int boneMatrixCount = std::max( instanceCount, GfxDeviceGlobal::boneMatrixCount );
+    GfxDeviceGlobal::boneMatrixCount = 0;
+
+    const unsigned changedBlocks = GfxDeviceGlobal::uboBlockTracker.GetChangedBlocks( GfxDeviceGlobal::perObjectUboStruct, boneMatrixCount, GfxDeviceGlobal::frameSerial );
+
+    for (int block = 0; block < UboBlockTracker::BlockCount; ++block)
+    {
+        if ((changedBlocks & (1u << block)) == 0)
+        {
+            continue;
+        }
+
+        const UboBlockTracker::Block b = static_cast< UboBlockTracker::Block >( block );
+        const std::size_t size = UboBlockTracker::GetUploadSize( b, boneMatrixCount );
+        const UboAllocation allocation = ae3d::AllocateUbo( size );
+        std::memcpy( allocation.data, UboBlockTracker::GetBlockData( GfxDeviceGlobal::perObjectUboStruct, b ), size );
+
+        GfxDeviceGlobal::uboBindings.buffers[ block ] = allocation.buffer;
+        GfxDeviceGlobal::uboBindings.offsets[ block ] = allocation.offset;
+    }
+
+    return GfxDeviceGlobal::uboBindings;
+}
+
 void BindComputeDescriptorSet()
 {
-    VkDescriptorSet descriptorSet = ae3d::AllocateDescriptorSet( GfxDeviceGlobal::ubos[ GfxDeviceGlobal::currentUbo ].uboDesc, GfxDeviceGlobal::boundViews[ 0 ], GfxDeviceGlobal::boundSamplers[ 0 ],
+    const UboBindings& ubos = UploadPerObjectUbo( 0 );
+
+    VkDescriptorSet descriptorSet = ae3d::AllocateDescriptorSet( ubos, GfxDeviceGlobal::boundViews[ 0 ], GfxDeviceGlobal::boundSamplers[ 0 ],
                                                                  GfxDeviceGlobal::boundViews[ 1 ], GfxDeviceGlobal::boundSamplers[ 1 ], GfxDeviceGlobal::boundViews[ 11 ], GfxDeviceGlobal::boundViews[ 12 ] );
 
     vkCmdBindDescriptorSets( GfxDeviceGlobal::computeCmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
-                             GfxDeviceGlobal::pipelineLayout, 0, 1, &descriptorSet, 0, nullptr );
+                             GfxDeviceGlobal::pipelineLayout, 0, 1, &descriptorSet, UboBlockTracker::BlockCount, ubos.offsets );
 }
 
-void UploadPerObjectUbo()
+void SetLightTilerUniforms()
 {
-    std::memcpy( &ae3d::GfxDevice::GetCurrentUbo()[ 0 ], &GfxDeviceGlobal::perObjectUboStruct, sizeof( GfxDeviceGlobal::perObjectUboStruct ) );
-}
-
-void ae3d::GfxDevice::Init( int width, int height )
+    const unsigned activePointLights = GfxDeviceGlobal::lightTiler.GetPointLightCount();
+    const unsigned activeSpotLights = GfxDeviceGlobal::lightTiler.GetSpotLightCount();
+    const unsigned lightCount = ((activeSpotLights & 0xFFFFu) << 16) | (activePointLights & 0xFFFFu);
+
+    GfxDeviceGlobal::perObjectUboStruct.frame.windowWidth = GfxDeviceGlobal::backBufferWidth;
+    GfxDeviceGlobal::perObjectUboStruct.frame.windowHeight = GfxDeviceGlobal::backBufferHeight;
+    GfxDeviceGlobal::perObjectUboStruct.frame.numLights = lightCount;
+    GfxDeviceGlobal::perObjectUboStruct.frame.maxNumLightsPerTile = GfxDeviceGlobal::lightTiler.GetMaxNumLightsPerTile();
+    GfxDeviceGlobal::perObjectUboStruct.frame.tilesXY.x = (float)GfxDeviceGlobal::lightTiler.GetNumTilesX();
+    GfxDeviceGlobal::perObjectUboStruct.frame.tilesXY.y = (float)GfxDeviceGlobal::lightTiler.GetNumTilesY();
+}
+
+void BindGeometry( VkBuffer vertexBuffer, VkBuffer indexBuffer )
+{
+    // Meshes are ranges of shared arena buffers, so consecutive draws usually have their buffers already bound.
+    if (GfxDeviceGlobal::boundGeometryCmdBuffer != GfxDeviceGlobal::currentCmdBuffer)
+    {
+        GfxDeviceGlobal::boundGeometryCmdBuffer = GfxDeviceGlobal::currentCmdBuffer;
+        GfxDeviceGlobal::boundVertexBuffer = VK_NULL_HANDLE;
+        GfxDeviceGlobal::boundIndexBuffer = VK_NULL_HANDLE;
+    }
+
+    if (GfxDeviceGlobal::boundVertexBuffer != vertexBuffer)
+    {
+        GfxDeviceGlobal::boundVertexBuffer = vertexBuffer;
+        VkDeviceSize offsets[ 1 ] = { 0 };
+        vkCmdBindVertexBuffers( GfxDeviceGlobal::currentCmdBuffer, ae3d::VertexBuffer::VERTEX_BUFFER_BIND_ID, 1, &GfxDeviceGlobal::boundVertexBuffer, offsets );
+    }
+
+    if (indexBuffer != VK_NULL_HANDLE && GfxDeviceGlobal::boundIndexBuffer != indexBuffer)
+    {
+        GfxDeviceGlobal::boundIndexBuffer = indexBuffer;
+        vkCmdBindIndexBuffer( GfxDeviceGlobal::currentCmdBuffer, GfxDeviceGlobal::boundIndexBuffer, 0, VK_INDEX_TYPE_UINT16 );
+    }
+}
+
+void SetActiveRenderPass( VkCommandBuffer cmdBuffer, VkRenderPass loadRenderPass, VkFramebuffer frameBuffer, std::uint32_t width, std::uint32_t height )
+{
+    auto& activeRenderPass = GfxDeviceGlobal::activeRenderPass;
+    activeRenderPass.cmdBuffer = cmdBuffer;
+    activeRenderPass.loadRenderPass = loadRenderPass;
+    activeRenderPass.frameBuffer = frameBuffer;
+    activeRenderPass.width = width;
+    activeRenderPass.height = height;
+    activeRenderPass.viewport = { 0, 0, (float)width, (float)height, 0, 1 };
+    activeRenderPass.scissor = { { 0, 0 }, { width, height } };
+}
+
+void ae3d::GfxDevice::Init( int width, int height )
 {
     GfxDeviceGlobal::backBufferWidth = width;
     GfxDeviceGlobal::backBufferHeight = height;
@@ -1727,11 +2364,53 @@ void ae3d::GfxDevice::DrawUI( int scX, int scY, int scWidth, int scHeight, int e
     scissor[ 3 ] = scHeight > 8191 ? 8191 : scHeight;
     SetScissor( scissor );
     
-    Draw( GfxDeviceGlobal::uiVertexBuffer, offset, offset + elemCount, renderer.builtinShaders.uiShader, BlendMode::AlphaBlend, DepthFunc::NoneWriteOff, CullMode::Off, FillMode::Solid, GfxDevice::PrimitiveTopology::Triangles );
+    Draw( GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ].uiVertexBuffer, offset, offset + elemCount, renderer.builtinShaders.uiShader, BlendMode::AlphaBlend, DepthFunc::NoneWriteOff, CullMode::Off, FillMode::Solid, GfxDevice::PrimitiveTopology::Triangles );
+}
+
+void ae3d::GfxDevice::PrecompilePSOs( const PSODesc* descs, unsigned descCount )
+{
+    for (unsigned i = 0; i < descCount; ++i)
+    {
+        const PSODesc desc = descs[ i ];
+
+        if (desc.shader == nullptr || desc.shader->GetVertexInfo().module == VK_NULL_HANDLE || desc.shader->GetFragmentInfo().module == VK_NULL_HANDLE)
+        {
+            continue;
+        }
+
+        const VkRenderPass renderPass = desc.renderTarget ? desc.renderTarget->GetRenderPass() : VK_NULL_HANDLE;
+        const std::uint64_t psoHash = GetPSOHash( desc.vertexFormat, *desc.shader, desc.blendMode, desc.depthFunc, desc.cullMode, desc.fillMode, renderPass, desc.topology );
+
+        {
+            std::lock_guard< std::mutex > lock( GfxDeviceGlobal::psoCacheMutex );
+
+            if (GfxDeviceGlobal::psoCache.find( psoHash ) != std::end( GfxDeviceGlobal::psoCache ))
+            {
+                continue;
+            }
+
+            // Draws that need the PSO before the job has published it compile it themselves.
+            GfxDeviceGlobal::psoCache[ psoHash ] = VK_NULL_HANDLE;
+        }
+
+        JobSystem::Run( [ desc, renderPass, psoHash ]()
+        {
+            const VkPipeline pso = CreatePSO( desc.vertexFormat, *desc.shader, desc.blendMode, desc.depthFunc, desc.cullMode, desc.fillMode, renderPass, desc.topology );
+            PublishPSO( psoHash, pso );
+        }, &GfxDeviceGlobal::psoCompileCounter, nullptr );
+    }
+}
+
+unsigned ae3d::GfxDevice::GetCompilingPSOCount()
+{
+    return static_cast< unsigned >( GfxDeviceGlobal::psoCompileCounter.value.load() );
 }
 
 void ae3d::GfxDevice::ResetPSOCache()
 {
+    JobSystem::Wait( &GfxDeviceGlobal::psoCompileCounter );
+
+    std::lock_guard< std::mutex > lock( GfxDeviceGlobal::psoCacheMutex );
     GfxDeviceGlobal::psoCache.clear();
 }
 
@@ -1743,7 +2422,7 @@ void ae3d::GfxDevice::MapUIVertexBuffer( int /*vertexSize*/, int /*indexSize*/,
 
 void ae3d::GfxDevice::UnmapUIVertexBuffer()
 {
-    GfxDeviceGlobal::uiVertexBuffer.UpdateDynamic( GfxDeviceGlobal::uiFaces, UI_FACE_COUNT, GfxDeviceGlobal::uiVertices, UI_VERTICE_COUNT );
+    GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ].uiVertexBuffer.UpdateDynamic( GfxDeviceGlobal::uiFaces, UI_FACE_COUNT, GfxDeviceGlobal::uiVertices, UI_VERTICE_COUNT );
 }
 
 void ae3d::GfxDevice::BeginDepthNormalsGpuQuery()
@@ -1807,6 +2486,7 @@ void ae3d::GfxDevice::BeginRenderPassAndCommandBuffer()
 
     VkResult err = vkBeginCommandBuffer( GfxDeviceGlobal::currentCmdBuffer, &cmdBufInfo );
     AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer" );
+    GfxDeviceGlobal::boundGeometryCmdBuffer = VK_NULL_HANDLE;
 
     VkRenderPassBeginInfo renderPassBeginInfo = {};
     renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -1834,6 +2514,8 @@ void ae3d::GfxDevice::BeginRenderPassAndCommandBuffer()
     scissor.offset.x = 0;
     scissor.offset.y = 0;
     vkCmdSetScissor( GfxDeviceGlobal::currentCmdBuffer, 0, 1, &scissor );
+
+    SetActiveRenderPass( GfxDeviceGlobal::currentCmdBuffer, GfxDeviceGlobal::loadRenderPass, renderPassBeginInfo.framebuffer, width, height );
 }
 
 void ae3d::GfxDevice::BeginRenderPass()
@@ -1867,11 +2549,14 @@ void ae3d::GfxDevice::BeginRenderPass()
     renderPassBeginInfo.framebuffer = GfxDeviceGlobal::frameBuffers[ GfxDeviceGlobal::currentBuffer ];
 
     vkCmdBeginRenderPass( GfxDeviceGlobal::currentCmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE );
+
+    SetActiveRenderPass( GfxDeviceGlobal::currentCmdBuffer, GfxDeviceGlobal::loadRenderPass, renderPassBeginInfo.framebuffer, width, height );
 }
 
 void ae3d::GfxDevice::EndRenderPass()
 {
-    vkCmdEndRenderPass( GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ] );
+    vkCmdEndRenderPass( GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ].drawCmdBuffer );
+    GfxDeviceGlobal::activeRenderPass.cmdBuffer = VK_NULL_HANDLE;
 }
 
 void ae3d::GfxDevice::EndCommandBuffer()
@@ -1882,7 +2567,8 @@ void ae3d::GfxDevice::EndCommandBuffer()
 
 void ae3d::GfxDevice::EndRenderPassAndCommandBuffer()
 {
-    vkCmdEndRenderPass( GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ] );
+    vkCmdEndRenderPass( GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ].drawCmdBuffer );
+    GfxDeviceGlobal::activeRenderPass.cmdBuffer = VK_NULL_HANDLE;
 
     VkResult err = vkEndCommandBuffer( GfxDeviceGlobal::currentCmdBuffer );
     AE3D_CHECK_VULKAN( err, "vkEndCommandBuffer" );
@@ -1898,8 +2584,24 @@ void ae3d::GfxDevice::SetClearColor( float red, float green, float blue )
 
 void ae3d::GfxDevice::GetGpuMemoryUsage( unsigned& outUsedMBytes, unsigned& outBudgetMBytes )
 {
-    outUsedMBytes = 0;
-    outBudgetMBytes = 0;
+    MemoryHeapStatistics heaps[ VK_MAX_MEMORY_HEAPS ];
+    GetMemoryHeapStatistics( heaps );
+
+    VkDeviceSize usedBytes = 0;
+    VkDeviceSize budgetBytes = 0;
+
+    // Like D3D12's local segment, usage includes free ranges of blocks, because they have been allocated from the driver.
+    for (std::uint32_t heapIndex = 0; heapIndex < GfxDeviceGlobal::deviceMemoryProperties.memoryHeapCount; ++heapIndex)
+    {
+        if ((GfxDeviceGlobal::deviceMemoryProperties.memoryHeaps[ heapIndex ].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0)
+        {
+            usedBytes += heaps[ heapIndex ].usedBytes + heaps[ heapIndex ].freeBytes;
+            budgetBytes += GfxDeviceGlobal::deviceMemoryProperties.memoryHeaps[ heapIndex ].size;
+        }
+    }
+
+    outUsedMBytes = static_cast< unsigned >( usedBytes / (1024 * 1024) );
+    outBudgetMBytes = static_cast< unsigned >( budgetBytes / (1024 * 1024) );
 }
 
 void ae3d::GfxDevice::ClearScreen( unsigned /*clearFlags*/ )
@@ -1927,6 +2629,7 @@ void ae3d::GfxDevice::SetViewport( int aViewport[ 4 ] )
     viewport.maxDepth = 1.0f;
 
     vkCmdSetViewport( GfxDeviceGlobal::currentCmdBuffer, 0, 1, &viewport );    
+    GfxDeviceGlobal::activeRenderPass.viewport = viewport;
 }
 
 void ae3d::GfxDevice::SetScissor( int aScissor[ 4 ] )
@@ -1937,6 +2640,7 @@ void ae3d::GfxDevice::SetScissor( int aScissor[ 4 ] )
     scissor.offset.x = (std::uint32_t)aScissor[ 0 ];
     scissor.offset.y = (std::uint32_t)aScissor[ 1 ];
     vkCmdSetScissor( GfxDeviceGlobal::currentCmdBuffer, 0, 1, &scissor );
+    GfxDeviceGlobal::activeRenderPass.scissor = scissor;
 }
 
 static void PrintShaderStatistics( VkPipeline pso )
@@ -1956,131 +2660,588 @@ static void PrintShaderStatistics( VkPipeline pso )
 void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startIndex, int endIndex, Shader& shader, BlendMode blendMode, DepthFunc depthFunc,
                             CullMode cullMode, FillMode fillMode, PrimitiveTopology topology )
 {
+    DrawInstanced( vertexBuffer, startIndex, endIndex, shader, blendMode, depthFunc, cullMode, fillMode, topology, 1 );
+}
+
+void ae3d::GfxDevice::DrawInstanced( VertexBuffer& vertexBuffer, int startIndex, int endIndex, Shader& shader, BlendMode blendMode, DepthFunc depthFunc,
+                                     CullMode cullMode, FillMode fillMode, PrimitiveTopology topology, int instanceCount )
+{
+    System::Assert( instanceCount > 0 && instanceCount <= PerObjectUboStruct::MaxInstances, "Invalid instance count" );
     System::Assert( startIndex > -1 && startIndex <= vertexBuffer.GetFaceCount() / 3, "Invalid vertex buffer draw range in startIndex" );
     System::Assert( endIndex > -1 && endIndex >= startIndex && endIndex <= vertexBuffer.GetFaceCount() / 3, "Invalid vertex buffer draw range in endIndex" );
     System::Assert( GfxDeviceGlobal::currentBuffer < GfxDeviceGlobal::swapchainBuffers.count, "invalid draw buffer index" );
 
     if (GfxDeviceGlobal::boundViews[ 0 ] == VK_NULL_HANDLE || GfxDeviceGlobal::boundSamplers[ 0 ] == VK_NULL_HANDLE)
     {
+        Statistics::IncSkippedDraws();
         return;
     }
 
     if (shader.GetVertexInfo().module == VK_NULL_HANDLE || shader.GetFragmentInfo().module == VK_NULL_HANDLE)
     {
+        Statistics::IncSkippedDraws();
         return;
     }
 
-    if (Statistics::GetDrawCalls() >= (int)GfxDeviceGlobal::descriptorSets.count)
+    const VkPipeline pso = GetPSO( vertexBuffer, shader, blendMode, depthFunc, cullMode, fillMode, GfxDeviceGlobal::renderTexture0 ? GfxDeviceGlobal::renderTexture0->GetRenderPass() : VK_NULL_HANDLE, topology );
+
+    if (pso == VK_NULL_HANDLE)
     {
-        System::Print( "Skipping draw because draw call count %d exceeds descriptor set count %ld \n", Statistics::GetDrawCalls(), GfxDeviceGlobal::descriptorSets.count );
+        Statistics::IncSkippedDraws();
         return;
     }
 
-    const std::uint64_t psoHash = GetPSOHash( vertexBuffer, shader, blendMode, depthFunc, cullMode, fillMode, GfxDeviceGlobal::renderTexture0 ? GfxDeviceGlobal::renderTexture0->GetRenderPass() : VK_NULL_HANDLE, topology );
+    SetLightTilerUniforms();
+    const UboBindings& ubos = UploadPerObjectUbo( instanceCount );
+
+    VkDescriptorSet descriptorSet = AllocateDescriptorSet( ubos, GfxDeviceGlobal::boundViews[ 0 ], GfxDeviceGlobal::boundSamplers[ 0 ], GfxDeviceGlobal::boundViews[ 1 ],
+                                                           GfxDeviceGlobal::boundSamplers[ 1 ], GfxDeviceGlobal::boundViews[ 11 ], GfxDeviceGlobal::boundViews[ 12 ] );
+
+    vkCmdBindDescriptorSets( GfxDeviceGlobal::currentCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                             GfxDeviceGlobal::pipelineLayout, 0, 1, &descriptorSet, UboBlockTracker::BlockCount, ubos.offsets );
+
+    vkCmdBindPipeline( GfxDeviceGlobal::currentCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pso );
+
+    BindGeometry( vertexBuffer.GetVertexBuffer(), topology == PrimitiveTopology::Triangles ? vertexBuffer.GetIndexBuffer() : VK_NULL_HANDLE );
 
-    if (GfxDeviceGlobal::psoCache.find( psoHash ) == std::end( GfxDeviceGlobal::psoCache ))
+    if (topology == PrimitiveTopology::Triangles)
+    {
+        vkCmdDrawIndexed( GfxDeviceGlobal::currentCmdBuffer, (endIndex - startIndex) * 3, instanceCount, vertexBuffer.GetBaseIndex() + startIndex * 3, vertexBuffer.GetBaseVertex(), 0 );
+    }
+    else if (topology == PrimitiveTopology::Lines)
     {
-        CreatePSO( vertexBuffer, shader, blendMode, depthFunc, cullMode, fillMode, GfxDeviceGlobal::renderTexture0 ? GfxDeviceGlobal::renderTexture0->GetRenderPass() : VK_NULL_HANDLE, topology, psoHash );
+        vkCmdDraw( GfxDeviceGlobal::currentCmdBuffer, (endIndex - startIndex) * 3, instanceCount, vertexBuffer.GetBaseVertex() + startIndex * 3, 0 );
     }
 
-    const unsigned activePointLights = GfxDeviceGlobal::lightTiler.GetPointLightCount();
-    const unsigned activeSpotLights = GfxDeviceGlobal::lightTiler.GetSpotLightCount();
-    const unsigned lightCount = ((activeSpotLights & 0xFFFFu) << 16) | (activePointLights & 0xFFFFu);
+    Statistics::IncTriangleCount( (endIndex - startIndex) * instanceCount );
+    Statistics::IncDrawCalls();
+}
 
-    GfxDeviceGlobal::perObjectUboStruct.windowWidth = GfxDeviceGlobal::backBufferWidth;
-    GfxDeviceGlobal::perObjectUboStruct.windowHeight = GfxDeviceGlobal::backBufferHeight;
-    GfxDeviceGlobal::perObjectUboStruct.numLights = lightCount;
-    GfxDeviceGlobal::perObjectUboStruct.maxNumLightsPerTile = GfxDeviceGlobal::lightTiler.GetMaxNumLightsPerTile();
-    GfxDeviceGlobal::perObjectUboStruct.tilesXY.x = (float)GfxDeviceGlobal::lightTiler.GetNumTilesX();
-    GfxDeviceGlobal::perObjectUboStruct.tilesXY.y = (float)GfxDeviceGlobal::lightTiler.GetNumTilesY();
+// Writes the current frame's copy of a resident instance and marks the other frames' copies out of date.
+void WriteIndirectInstance( unsigned index, const GpuIndirectInstance& instance )
+{
+    auto& indirect = GfxDeviceGlobal::indirect;
+    indirect.residentInstances[ index ] = instance;
+    indirect.mappedInstances[ GfxDeviceGlobal::frameIndex * INDIRECT_INSTANCE_COUNT + index ] = instance;
 
-    UploadPerObjectUbo();
+    for (unsigned frame = 0; frame < MAX_FRAMES_IN_FLIGHT; ++frame)
+    {
+        if (frame != GfxDeviceGlobal::frameIndex)
+        {
+            indirect.pendingInstances[ frame ].push_back( index );
+        }
+    }
+}
+
+int ae3d::GfxDevice::CreateIndirectInstances( unsigned instanceCount )
+{
+    System::Assert( instanceCount > 0, "CreateIndirectInstances needs instances" );
+
+    auto& indirect = GfxDeviceGlobal::indirect;
+    GfxDeviceGlobal::IndirectBuffers::ResidentRange range;
+    range.instanceCount = ((instanceCount + INDIRECT_RANGE_ALIGNMENT - 1) / INDIRECT_RANGE_ALIGNMENT) * INDIRECT_RANGE_ALIGNMENT;
+
+    std::uint64_t offset = 0;
+    range.allocation = indirect.residentAllocator.Allocate( range.instanceCount * sizeof( std::uint32_t ), TLSFAllocator::Granularity, offset );
+
+    if (range.allocation == TLSFAllocator::InvalidAllocation)
+    {
+        return -1;
+    }
 
-    VkDescriptorSet descriptorSet = AllocateDescriptorSet( GfxDeviceGlobal::ubos[ GfxDeviceGlobal::currentUbo ].uboDesc, GfxDeviceGlobal::boundViews[ 0 ], GfxDeviceGlobal::boundSamplers[ 0 ], GfxDeviceGlobal::boundViews[ 1 ],
+    range.firstInstance = static_cast< unsigned >( offset / sizeof( std::uint32_t ) );
+
+    GpuIndirectInstance invalidInstance;
+    invalidInstance.drawIndex = INDIRECT_INVALID_DRAW;
+
+    for (unsigned i = 0; i < range.instanceCount; ++i)
+    {
+        WriteIndirectInstance( range.firstInstance + i, invalidInstance );
+    }
+
+    for (unsigned handle = 0; handle < indirect.residentRanges.size(); ++handle)
+    {
+        if (indirect.residentRanges[ handle ].allocation == TLSFAllocator::InvalidAllocation)
+        {
+            indirect.residentRanges[ handle ] = range;
+            return static_cast< int >( handle );
+        }
+    }
+
+    indirect.residentRanges.push_back( range );
+    return static_cast< int >( indirect.residentRanges.size() - 1 );
+}
+
+void ae3d::GfxDevice::ReleaseIndirectInstances( int handle )
+{
+    auto& indirect = GfxDeviceGlobal::indirect;
+    System::Assert( handle >= 0 && handle < static_cast< int >( indirect.residentRanges.size() ), "Invalid indirect instances" );
+
+    // Frames that still read the range have their own copy, which is only written after their fence.
+    indirect.residentAllocator.Free( indirect.residentRanges[ handle ].allocation );
+    indirect.residentRanges[ handle ] = GfxDeviceGlobal::IndirectBuffers::ResidentRange();
+}
+
+void ae3d::GfxDevice::UpdateIndirectInstances( int handle, const unsigned* indices, const IndirectInstance* instances, unsigned count )
+{
+    auto& indirect = GfxDeviceGlobal::indirect;
+    System::Assert( handle >= 0 && handle < static_cast< int >( indirect.residentRanges.size() ), "Invalid indirect instances" );
+    const GfxDeviceGlobal::IndirectBuffers::ResidentRange& range = indirect.residentRanges[ handle ];
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        System::Assert( indices[ i ] < range.instanceCount, "Indirect instance is out of range" );
+
+        GpuIndirectInstance gpuInstance;
+        gpuInstance.localToWorld = instances[ i ].localToWorld;
+        gpuInstance.aabbMin = Vec4( instances[ i ].aabbMin, 0 );
+        gpuInstance.aabbMax = Vec4( instances[ i ].aabbMax, 0 );
+        gpuInstance.drawIndex = instances[ i ].drawIndex;
+        WriteIndirectInstance( range.firstInstance + indices[ i ], gpuInstance );
+    }
+}
+
+bool ae3d::GfxDevice::CullIndirect( int instances, const IndirectDraw* draws, unsigned drawCount, const Matrix44& worldToClip )
+{
+    auto& indirect = GfxDeviceGlobal::indirect;
+    System::Assert( instances >= 0 && instances < static_cast< int >( indirect.residentRanges.size() ) && drawCount > 0, "CullIndirect needs instances and draws" );
+
+    ComputeShader& cullShader = renderer.builtinShaders.indirectCullShader;
+    const GfxDeviceGlobal::IndirectBuffers::ResidentRange& range = indirect.residentRanges[ instances ];
+    const unsigned rangeInstanceCount = range.instanceCount;
+    const unsigned rangeCommandCount = ((drawCount + INDIRECT_RANGE_ALIGNMENT - 1) / INDIRECT_RANGE_ALIGNMENT) * INDIRECT_RANGE_ALIGNMENT;
+
+    if (cullShader.GetPSO() == VK_NULL_HANDLE || indirect.cullCount == INDIRECT_CULLS_PER_FRAME ||
+        indirect.usedInstances + rangeInstanceCount > (GfxDeviceGlobal::frameIndex + 1) * INDIRECT_INSTANCE_COUNT ||
+        indirect.usedCommands + rangeCommandCount > (GfxDeviceGlobal::frameIndex + 1) * INDIRECT_DRAW_COUNT)
+    {
+        return false;
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ].indirectDescriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &GfxDeviceGlobal::indirectDescriptorSetLayout;
+
+    VkResult err = vkAllocateDescriptorSets( GfxDeviceGlobal::device, &allocInfo, &indirect.descriptorSet );
+    AE3D_CHECK_VULKAN( err, "vkAllocateDescriptorSets indirect" );
+
+    const unsigned firstVisibleInstance = indirect.usedInstances;
+    indirect.firstCommand = indirect.usedCommands;
+    indirect.usedInstances += rangeInstanceCount;
+    indirect.usedCommands += rangeCommandCount;
+    ++indirect.cullCount;
+    indirect.draws.assign( draws, draws + drawCount );
+
+    // The culler increments instanceCount for each visible instance and writes its index to the draw's range of visible instances.
+    for (unsigned drawIndex = 0; drawIndex < drawCount; ++drawIndex)
+    {
+        const IndirectDraw& draw = draws[ drawIndex ];
+        System::Assert( draw.firstInstance + draw.instanceCount <= rangeInstanceCount, "Indirect draw's instances are out of range" );
+
+        VkDrawIndexedIndirectCommand& command = indirect.mappedCommands[ indirect.firstCommand + drawIndex ];
+        command.indexCount = static_cast< std::uint32_t >( (draw.vertexBuffer->GetFaceCount() / 3) * 3 );
+        command.instanceCount = 0;
+        command.firstIndex = draw.vertexBuffer->GetBaseIndex();
+        command.vertexOffset = draw.vertexBuffer->GetBaseVertex();
+        command.firstInstance = draw.firstInstance;
+    }
+
+    const VkDescriptorBufferInfo bufferInfos[ 3 ] =
+    {
+        { indirect.instances, (GfxDeviceGlobal::frameIndex * INDIRECT_INSTANCE_COUNT + range.firstInstance) * sizeof( GpuIndirectInstance ), rangeInstanceCount * sizeof( GpuIndirectInstance ) },
+        { indirect.commands, indirect.firstCommand * sizeof( VkDrawIndexedIndirectCommand ), rangeCommandCount * sizeof( VkDrawIndexedIndirectCommand ) },
+        { indirect.visibleInstances, firstVisibleInstance * sizeof( std::uint32_t ), rangeInstanceCount * sizeof( std::uint32_t ) }
+    };
+
+    VkWriteDescriptorSet bufferSets[ 3 ] = {};
+
+    for (std::uint32_t i = 0; i < 3; ++i)
+    {
+        bufferSets[ i ].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        bufferSets[ i ].dstSet = indirect.descriptorSet;
+        bufferSets[ i ].dstBinding = i;
+        bufferSets[ i ].descriptorCount = 1;
+        bufferSets[ i ].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bufferSets[ i ].pBufferInfo = &bufferInfos[ i ];
+    }
+
+    vkUpdateDescriptorSets( GfxDeviceGlobal::device, 3, bufferSets, 0, nullptr );
+
+    GfxDeviceGlobal::perObjectUboStruct.object.localToClip = worldToClip;
+
+    cullShader.Begin();
+
+    VkBufferMemoryBarrier hostToCompute[ 2 ] = {};
+
+    for (int i = 0; i < 2; ++i)
+    {
+        hostToCompute[ i ].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        hostToCompute[ i ].srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
+        hostToCompute[ i ].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        hostToCompute[ i ].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        hostToCompute[ i ].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        hostToCompute[ i ].buffer = bufferInfos[ i ].buffer;
+        hostToCompute[ i ].offset = bufferInfos[ i ].offset;
+        hostToCompute[ i ].size = bufferInfos[ i ].range;
+    }
+
+    vkCmdPipelineBarrier( GfxDeviceGlobal::computeCmdBuffer, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+                          nullptr, 2, hostToCompute, 0, nullptr );
+
+    vkCmdBindDescriptorSets( GfxDeviceGlobal::computeCmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                             GfxDeviceGlobal::pipelineLayout, 1, 1, &indirect.descriptorSet, 0, nullptr );
+
+    cullShader.Dispatch( rangeInstanceCount / INDIRECT_RANGE_ALIGNMENT, 1, 1 );
+
+    VkBufferMemoryBarrier computeToDraw[ 2 ] = {};
+
+    for (int i = 0; i < 2; ++i)
+    {
+        computeToDraw[ i ].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        computeToDraw[ i ].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        computeToDraw[ i ].dstAccessMask = i == 0 ? VK_ACCESS_INDIRECT_COMMAND_READ_BIT : VK_ACCESS_SHADER_READ_BIT;
+        computeToDraw[ i ].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        computeToDraw[ i ].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        computeToDraw[ i ].buffer = bufferInfos[ i + 1 ].buffer;
+        computeToDraw[ i ].offset = bufferInfos[ i + 1 ].offset;
+        computeToDraw[ i ].size = bufferInfos[ i + 1 ].range;
+    }
+
+    vkCmdPipelineBarrier( GfxDeviceGlobal::computeCmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 0,
+                          nullptr, 2, computeToDraw, 0, nullptr );
+
+    cullShader.End();
+
+    return true;
+}
+
+void ae3d::GfxDevice::DrawIndirect( unsigned firstDraw, unsigned drawCount, Shader& shader, BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode )
+{
+    auto& indirect = GfxDeviceGlobal::indirect;
+
+    System::Assert( indirect.descriptorSet != VK_NULL_HANDLE, "DrawIndirect called without CullIndirect" );
+    System::Assert( drawCount > 0 && firstDraw + drawCount <= indirect.draws.size(), "Invalid indirect draw range" );
+    System::Assert( GfxDeviceGlobal::currentBuffer < GfxDeviceGlobal::swapchainBuffers.count, "invalid draw buffer index" );
+
+    if (GfxDeviceGlobal::boundViews[ 0 ] == VK_NULL_HANDLE || GfxDeviceGlobal::boundSamplers[ 0 ] == VK_NULL_HANDLE)
+    {
+        Statistics::IncSkippedDraws();
+        return;
+    }
+
+    if (shader.GetVertexInfo().module == VK_NULL_HANDLE || shader.GetFragmentInfo().module == VK_NULL_HANDLE)
+    {
+        Statistics::IncSkippedDraws();
+        return;
+    }
+
+    VertexBuffer& vertexBuffer = *indirect.draws[ firstDraw ].vertexBuffer;
+    const VkRenderPass renderPass = GfxDeviceGlobal::renderTexture0 ? GfxDeviceGlobal::renderTexture0->GetRenderPass() : VK_NULL_HANDLE;
+    const VkPipeline pso = GetPSO( vertexBuffer, shader, blendMode, depthFunc, cullMode, fillMode, renderPass, PrimitiveTopology::Triangles );
+
+    if (pso == VK_NULL_HANDLE)
+    {
+        Statistics::IncSkippedDraws();
+        return;
+    }
+
+    SetLightTilerUniforms();
+    // Indirect shaders read instances' matrices from the indirect buffers.
+    const UboBindings& ubos = UploadPerObjectUbo( 0 );
+
+    VkDescriptorSet descriptorSet = AllocateDescriptorSet( ubos, GfxDeviceGlobal::boundViews[ 0 ], GfxDeviceGlobal::boundSamplers[ 0 ], GfxDeviceGlobal::boundViews[ 1 ],
                                                            GfxDeviceGlobal::boundSamplers[ 1 ], GfxDeviceGlobal::boundViews[ 11 ], GfxDeviceGlobal::boundViews[ 12 ] );
+    const VkDescriptorSet descriptorSets[ 2 ] = { descriptorSet, indirect.descriptorSet };
 
     vkCmdBindDescriptorSets( GfxDeviceGlobal::currentCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                             GfxDeviceGlobal::pipelineLayout, 0, 1, &descriptorSet, 0, nullptr );
+                             GfxDeviceGlobal::pipelineLayout, 0, 2, descriptorSets, UboBlockTracker::BlockCount, ubos.offsets );
 
-    vkCmdBindPipeline( GfxDeviceGlobal::currentCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, GfxDeviceGlobal::psoCache[ psoHash ] );
+    vkCmdBindPipeline( GfxDeviceGlobal::currentCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pso );
 
-    VkDeviceSize offsets[ 1 ] = { 0 };
-    vkCmdBindVertexBuffers( GfxDeviceGlobal::currentCmdBuffer, VertexBuffer::VERTEX_BUFFER_BIND_ID, 1, vertexBuffer.GetVertexBuffer(), offsets );
+    const std::uint32_t maxMultiDrawCount = GfxDeviceGlobal::deviceFeatures.multiDrawIndirect ? GfxDeviceGlobal::properties.limits.maxDrawIndirectCount : 1;
+    const unsigned endDraw = firstDraw + drawCount;
+    unsigned runStart = firstDraw;
 
-    if (topology == PrimitiveTopology::Triangles)
+    // Draws whose submeshes are in the same arena buffers are issued with one multi-draw.
+    for (unsigned drawIndex = firstDraw + 1; drawIndex <= endDraw; ++drawIndex)
     {
-        vkCmdBindIndexBuffer( GfxDeviceGlobal::currentCmdBuffer, *vertexBuffer.GetIndexBuffer(), 0, VK_INDEX_TYPE_UINT16 );
-        vkCmdDrawIndexed( GfxDeviceGlobal::currentCmdBuffer, (endIndex - startIndex) * 3, 1, startIndex * 3, 0, 0 );
+        const VertexBuffer& runBuffer = *indirect.draws[ runStart ].vertexBuffer;
+        System::Assert( drawIndex == endDraw || indirect.draws[ drawIndex ].vertexBuffer->GetVertexFormat() == vertexBuffer.GetVertexFormat(), "Indirect draws have different vertex formats" );
+
+        if (drawIndex < endDraw && drawIndex - runStart < maxMultiDrawCount &&
+            indirect.draws[ drawIndex ].vertexBuffer->GetVertexBuffer() == runBuffer.GetVertexBuffer() &&
+            indirect.draws[ drawIndex ].vertexBuffer->GetIndexBuffer() == runBuffer.GetIndexBuffer())
+        {
+            continue;
+        }
+
+        BindGeometry( runBuffer.GetVertexBuffer(), runBuffer.GetIndexBuffer() );
+
+        const VkDeviceSize commandOffset = (indirect.firstCommand + runStart) * sizeof( VkDrawIndexedIndirectCommand );
+        vkCmdDrawIndexedIndirect( GfxDeviceGlobal::currentCmdBuffer, indirect.commands, commandOffset, drawIndex - runStart, sizeof( VkDrawIndexedIndirectCommand ) );
+        Statistics::IncDrawCalls();
+
+        runStart = drawIndex;
     }
-    else if (topology == PrimitiveTopology::Lines)
+}
+
+static GfxDeviceGlobal::RecordingThread& GetRecordingThread()
+{
+    if (GfxDeviceGlobal::recordingThreadIndex == -1)
     {
-        vkCmdDraw( GfxDeviceGlobal::currentCmdBuffer, (endIndex - startIndex) * 3, 1, startIndex * 3, 0 );
+        const unsigned threadIndex = GfxDeviceGlobal::recordingThreadCount.fetch_add( 1 );
+        ae3d::System::Assert( threadIndex < MAX_RECORDING_THREADS, "too many threads record secondary command buffers" );
+        GfxDeviceGlobal::recordingThreadIndex = (int)threadIndex;
+
+        VkCommandPoolCreateInfo cmdPoolInfo = {};
+        cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        cmdPoolInfo.queueFamilyIndex = GfxDeviceGlobal::queueNodeIndex;
+        cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+        for (VkCommandPool& cmdPool : GfxDeviceGlobal::recordingThreads[ threadIndex ].cmdPools)
+        {
+            VkResult err = vkCreateCommandPool( GfxDeviceGlobal::device, &cmdPoolInfo, nullptr, &cmdPool );
+            AE3D_CHECK_VULKAN( err, "vkCreateCommandPool secondary" );
+        }
     }
 
-    Statistics::IncTriangleCount( endIndex - startIndex );
-    Statistics::IncDrawCalls();
+    return GfxDeviceGlobal::recordingThreads[ GfxDeviceGlobal::recordingThreadIndex ];
 }
 
-void ae3d::GfxDevice::GetNewUniformBuffer()
+static void BeginActiveRenderPass( VkSubpassContents contents )
 {
-    GfxDeviceGlobal::currentUbo = (GfxDeviceGlobal::currentUbo + 1) % GfxDeviceGlobal::ubos.count;
+    const auto& activeRenderPass = GfxDeviceGlobal::activeRenderPass;
+
+    VkRenderPassBeginInfo renderPassBeginInfo = {};
+    renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassBeginInfo.renderPass = activeRenderPass.loadRenderPass;
+    renderPassBeginInfo.renderArea.extent.width = activeRenderPass.width;
+    renderPassBeginInfo.renderArea.extent.height = activeRenderPass.height;
+    renderPassBeginInfo.framebuffer = activeRenderPass.frameBuffer;
+
+    vkCmdBeginRenderPass( activeRenderPass.cmdBuffer, &renderPassBeginInfo, contents );
 }
 
-void ae3d::GfxDevice::CreateUniformBuffers()
+bool ae3d::GfxDevice::BeginParallelRecording( unsigned cmdBufferCount )
 {
-    GfxDeviceGlobal::ubos.Allocate( 1800 );
+    auto& recording = GfxDeviceGlobal::parallelRecording;
+    const auto& activeRenderPass = GfxDeviceGlobal::activeRenderPass;
+
+    System::Assert( !recording.isRecording, "parallel recording has already begun" );
 
-    for (unsigned uboIndex = 0; uboIndex < GfxDeviceGlobal::ubos.count; ++uboIndex)
+    if (cmdBufferCount == 0 || activeRenderPass.cmdBuffer == VK_NULL_HANDLE || activeRenderPass.cmdBuffer != GfxDeviceGlobal::currentCmdBuffer ||
+        activeRenderPass.loadRenderPass == VK_NULL_HANDLE)
     {
-        auto& ubo = GfxDeviceGlobal::ubos[ uboIndex ];
+        return false;
+    }
 
-        const VkDeviceSize uboSize = 256 * 3 + 80 * 64;
-        static_assert( uboSize >= sizeof( PerObjectUboStruct ), "UBO size must be larger than UBO struct" );
+    recording.cmdBuffers.assign( cmdBufferCount, VK_NULL_HANDLE );
+    recording.perObjectUboStruct = GfxDeviceGlobal::perObjectUboStruct;
+    std::memcpy( recording.boundViews, GfxDeviceGlobal::boundViews, sizeof( recording.boundViews ) );
+    std::memcpy( recording.boundSamplers, GfxDeviceGlobal::boundSamplers, sizeof( recording.boundSamplers ) );
+    recording.isRecording = true;
 
-        VkBufferCreateInfo bufferInfo = {};
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = uboSize;
-        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    return true;
+}
 
-        VkResult err = vkCreateBuffer( GfxDeviceGlobal::device, &bufferInfo, nullptr, &ubo.ubo );
-        AE3D_CHECK_VULKAN( err, "vkCreateBuffer UBO" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)ubo.ubo, VK_OBJECT_TYPE_BUFFER, "ubo" );
+void ae3d::GfxDevice::BeginSecondaryCommandBuffer( unsigned cmdBufferIndex )
+{
+    auto& recording = GfxDeviceGlobal::parallelRecording;
+    const auto& activeRenderPass = GfxDeviceGlobal::activeRenderPass;
+
+    System::Assert( recording.isRecording, "BeginParallelRecording must be called first" );
+    System::Assert( cmdBufferIndex < recording.cmdBuffers.size() && recording.cmdBuffers[ cmdBufferIndex ] == VK_NULL_HANDLE, "invalid secondary command buffer index" );
+
+    auto& thread = GetRecordingThread();
+    const unsigned frameIndex = GfxDeviceGlobal::frameIndex;
 
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, ubo.ubo, &memReqs );
+    if (thread.usedCmdBuffers[ frameIndex ] == thread.cmdBuffers[ frameIndex ].size())
+    {
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = thread.cmdPools[ frameIndex ];
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        VkResult err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &allocInfo, &cmdBuffer );
+        AE3D_CHECK_VULKAN( err, "vkAllocateCommandBuffers secondary" );
+        thread.cmdBuffers[ frameIndex ].push_back( cmdBuffer );
+    }
+
+    VkCommandBuffer cmdBuffer = thread.cmdBuffers[ frameIndex ][ thread.usedCmdBuffers[ frameIndex ]++ ];
+    recording.cmdBuffers[ cmdBufferIndex ] = cmdBuffer;
+
+    VkCommandBufferInheritanceInfo inheritanceInfo = {};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = activeRenderPass.loadRenderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = activeRenderPass.frameBuffer;
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    VkResult err = vkBeginCommandBuffer( cmdBuffer, &beginInfo );
+    AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer secondary" );
+
+    vkCmdSetViewport( cmdBuffer, 0, 1, &activeRenderPass.viewport );
+    vkCmdSetScissor( cmdBuffer, 0, 1, &activeRenderPass.scissor );
+
+    auto& saved = GfxDeviceGlobal::savedDrawState;
+    saved.cmdBuffer = GfxDeviceGlobal::currentCmdBuffer;
+    saved.perObjectUboStruct = GfxDeviceGlobal::perObjectUboStruct;
+    std::memcpy( saved.boundViews, GfxDeviceGlobal::boundViews, sizeof( saved.boundViews ) );
+    std::memcpy( saved.boundSamplers, GfxDeviceGlobal::boundSamplers, sizeof( saved.boundSamplers ) );
+    saved.boneMatrixCount = GfxDeviceGlobal::boneMatrixCount;
+
+    GfxDeviceGlobal::currentCmdBuffer = cmdBuffer;
+    GfxDeviceGlobal::perObjectUboStruct = recording.perObjectUboStruct;
+    std::memcpy( GfxDeviceGlobal::boundViews, recording.boundViews, sizeof( recording.boundViews ) );
+    std::memcpy( GfxDeviceGlobal::boundSamplers, recording.boundSamplers, sizeof( recording.boundSamplers ) );
+}
 
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &ubo.uboMemory );
-        AE3D_CHECK_VULKAN( err, "vkAllocateMemory UBO" );
-        Statistics::IncTotalAllocCalls();
-        Statistics::IncAllocCalls();
+void ae3d::GfxDevice::EndSecondaryCommandBuffer()
+{
+    VkResult err = vkEndCommandBuffer( GfxDeviceGlobal::currentCmdBuffer );
+    AE3D_CHECK_VULKAN( err, "vkEndCommandBuffer secondary" );
+
+    const auto& saved = GfxDeviceGlobal::savedDrawState;
+    GfxDeviceGlobal::currentCmdBuffer = saved.cmdBuffer;
+    GfxDeviceGlobal::perObjectUboStruct = saved.perObjectUboStruct;
+    std::memcpy( GfxDeviceGlobal::boundViews, saved.boundViews, sizeof( saved.boundViews ) );
+    std::memcpy( GfxDeviceGlobal::boundSamplers, saved.boundSamplers, sizeof( saved.boundSamplers ) );
+    GfxDeviceGlobal::boneMatrixCount = saved.boneMatrixCount;
+}
 
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, ubo.ubo, ubo.uboMemory, 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory UBO" );
+void ae3d::GfxDevice::EndParallelRecording()
+{
+    auto& recording = GfxDeviceGlobal::parallelRecording;
+    const auto& activeRenderPass = GfxDeviceGlobal::activeRenderPass;
 
-        ubo.uboDesc.buffer = ubo.ubo;
-        ubo.uboDesc.offset = 0;
-        ubo.uboDesc.range = uboSize;
+    System::Assert( recording.isRecording, "BeginParallelRecording must be called first" );
+    recording.isRecording = false;
 
-        err = vkMapMemory( GfxDeviceGlobal::device, ubo.uboMemory, 0, uboSize, 0, (void **)&ubo.uboData );
-        AE3D_CHECK_VULKAN( err, "vkMapMemory UBO" );
+    for (std::size_t cmdBufferIndex = 0; cmdBufferIndex < recording.cmdBuffers.size(); ++cmdBufferIndex)
+    {
+        System::Assert( recording.cmdBuffers[ cmdBufferIndex ] != VK_NULL_HANDLE, "secondary command buffer was not recorded" );
     }
+
+    // A subpass contains either inline commands or secondary command buffers, so the inline render pass is
+    // continued with one that executes the secondary command buffers, and then with another inline one.
+    vkCmdEndRenderPass( activeRenderPass.cmdBuffer );
+    BeginActiveRenderPass( VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS );
+    vkCmdExecuteCommands( activeRenderPass.cmdBuffer, static_cast< std::uint32_t >( recording.cmdBuffers.size() ), recording.cmdBuffers.data() );
+    vkCmdEndRenderPass( activeRenderPass.cmdBuffer );
+    BeginActiveRenderPass( VK_SUBPASS_CONTENTS_INLINE );
+
+    // Executing secondary command buffers leaves the primary command buffer's state undefined.
+    vkCmdSetViewport( activeRenderPass.cmdBuffer, 0, 1, &activeRenderPass.viewport );
+    vkCmdSetScissor( activeRenderPass.cmdBuffer, 0, 1, &activeRenderPass.scissor );
+    GfxDeviceGlobal::boundGeometryCmdBuffer = VK_NULL_HANDLE;
 }
 
-std::uint8_t* ae3d::GfxDevice::GetCurrentUbo()
+void ae3d::GfxDevice::CreateUniformBuffers()
 {
-    return GfxDeviceGlobal::ubos[ GfxDeviceGlobal::currentUbo ].uboData;
+    for (auto& frame : GfxDeviceGlobal::frames)
+    {
+        AddUboBlock( frame, UBO_RING_CAPACITY );
+    }
 }
 
 void ae3d::GfxDevice::BeginFrame()
 {
     ae3d::System::Assert( acquireNextImageKHR != nullptr, "function pointers not loaded" );
     ae3d::System::Assert( GfxDeviceGlobal::swapChain != VK_NULL_HANDLE, "swap chain not initialized" );
-    
-    VkResult err = acquireNextImageKHR( GfxDeviceGlobal::device, GfxDeviceGlobal::swapChain, UINT64_MAX, GfxDeviceGlobal::presentCompleteSemaphore, (VkFence)nullptr, &GfxDeviceGlobal::currentBuffer );
+
+    auto& frame = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ];
+
+    // Only waits for the GPU to finish the frame that last used this frame's resources, so the CPU can record while the GPU renders the previous frame.
+    VkResult err = vkWaitForFences( GfxDeviceGlobal::device, 1, &frame.fence, VK_TRUE, UINT64_MAX );
+    AE3D_CHECK_VULKAN( err, "vkWaitForFences" );
+    Statistics::IncFenceCalls();
+
+    err = vkResetFences( GfxDeviceGlobal::device, 1, &frame.fence );
+    AE3D_CHECK_VULKAN( err, "vkResetFences" );
+
+    // The frame's fence also covers its offscreen submits.
+    frame.isOffscreenFencePending = false;
+
+    if (frame.usedOffscreen)
+    {
+        frame.usedOffscreen = false;
+
+        std::uint64_t timestamps[ 2 ] = {};
+        err = vkGetQueryPoolResults( GfxDeviceGlobal::device, GfxDeviceGlobal::queryPool, 2 * GfxDeviceGlobal::frameIndex, 2, sizeof( std::uint64_t ) * 2, timestamps, sizeof( std::uint64_t ), VK_QUERY_RESULT_64_BIT );
+        //AE3D_CHECK_VULKAN( err, "vkGetQueryPoolResults" );
+
+        GfxDeviceGlobal::timings[ 0 ] = (timestamps[ 1 ] - timestamps[ 0 ]) / 1000.0f;
+
+        Statistics::SetDepthNormalsGpuTime( GfxDeviceGlobal::timings[ 0 ] );
+    }
+
+    VertexBufferGlobal::ReleasePendingAllocations( GfxDeviceGlobal::frameIndex );
+
+    ++GfxDeviceGlobal::frameSerial;
+    frame.uboBlockOffset = 0;
+
+    // Blocks that were added when the ring filled up are merged, so the ring doesn't fill up again.
+    if (frame.uboBlocks.size() > 1)
+    {
+        VkDeviceSize capacity = 0;
+
+        for (UboBlock& block : frame.uboBlocks)
+        {
+            capacity += block.capacity;
+            DestroyUboBlock( block );
+        }
+
+        frame.uboBlocks.clear();
+        AddUboBlock( frame, capacity );
+    }
+
+    for (VkDescriptorPool pool : frame.descriptorPools)
+    {
+        err = vkResetDescriptorPool( GfxDeviceGlobal::device, pool, 0 );
+        AE3D_CHECK_VULKAN( err, "vkResetDescriptorPool" );
+    }
+
+    frame.currentDescriptorPool = 0;
+    frame.currentPoolDescriptorSets = 0;
+    frame.descriptorSetCache.clear();
+
+    auto& pendingInstances = GfxDeviceGlobal::indirect.pendingInstances[ GfxDeviceGlobal::frameIndex ];
+
+    for (unsigned index : pendingInstances)
+    {
+        GfxDeviceGlobal::indirect.mappedInstances[ GfxDeviceGlobal::frameIndex * INDIRECT_INSTANCE_COUNT + index ] = GfxDeviceGlobal::indirect.residentInstances[ index ];
+    }
+
+    pendingInstances.clear();
+    GfxDeviceGlobal::indirect.usedInstances = GfxDeviceGlobal::frameIndex * INDIRECT_INSTANCE_COUNT;
+    GfxDeviceGlobal::indirect.usedCommands = GfxDeviceGlobal::frameIndex * INDIRECT_DRAW_COUNT;
+    GfxDeviceGlobal::indirect.cullCount = 0;
+    GfxDeviceGlobal::indirect.descriptorSet = VK_NULL_HANDLE;
+    GfxDeviceGlobal::indirect.draws.clear();
+    err = vkResetDescriptorPool( GfxDeviceGlobal::device, frame.indirectDescriptorPool, 0 );
+    AE3D_CHECK_VULKAN( err, "vkResetDescriptorPool indirect" );
+
+    for (unsigned threadIndex = 0; threadIndex < GfxDeviceGlobal::recordingThreadCount; ++threadIndex)
+    {
+        auto& thread = GfxDeviceGlobal::recordingThreads[ threadIndex ];
+
+        if (thread.usedCmdBuffers[ GfxDeviceGlobal::frameIndex ] > 0)
+        {
+            err = vkResetCommandPool( GfxDeviceGlobal::device, thread.cmdPools[ GfxDeviceGlobal::frameIndex ], 0 );
+            AE3D_CHECK_VULKAN( err, "vkResetCommandPool secondary" );
+            thread.usedCmdBuffers[ GfxDeviceGlobal::frameIndex ] = 0;
+        }
+    }
+
+    err = acquireNextImageKHR( GfxDeviceGlobal::device, GfxDeviceGlobal::swapChain, UINT64_MAX, frame.presentCompleteSemaphore, (VkFence)nullptr, &GfxDeviceGlobal::currentBuffer );
 
     if (err == VK_TIMEOUT)
     {
@@ -2089,7 +3250,9 @@ void ae3d::GfxDevice::BeginFrame()
 
     AE3D_CHECK_VULKAN( err, "acquireNextImage" );
 
-    GfxDeviceGlobal::currentCmdBuffer = GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ];
+    GfxDeviceGlobal::currentCmdBuffer = frame.drawCmdBuffer;
+    // Render passes that aren't begun by GfxDevice, like OpenVR's, can't be continued by EndParallelRecording.
+    GfxDeviceGlobal::activeRenderPass.cmdBuffer = VK_NULL_HANDLE;
 
     SubmitPostPresentBarrier();
 
@@ -2103,17 +3266,22 @@ void ae3d::GfxDevice::BeginFrame()
 
 void SubmitQueue()
 {
+    // Compute work recorded after the render graph must execute before the draws that read it.
+    ae3d::GfxDevice::FlushOffscreenPasses();
+
+    auto& frame = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ];
+
     VkPipelineStageFlags pipelineStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
 
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submitInfo.pWaitDstStageMask = &pipelineStages;
     submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &GfxDeviceGlobal::presentCompleteSemaphore;
+    submitInfo.pWaitSemaphores = &frame.presentCompleteSemaphore;
     submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &GfxDeviceGlobal::renderCompleteSemaphore;
+    submitInfo.pSignalSemaphores = &frame.renderCompleteSemaphore;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ];
+    submitInfo.pCommandBuffers = &frame.drawCmdBuffer;
 
     VkResult err = vkQueueSubmit( GfxDeviceGlobal::graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE );
     AE3D_CHECK_VULKAN( err, "vkQueueSubmit" );
@@ -2124,6 +3292,11 @@ void ae3d::GfxDevice::Present()
     Statistics::BeginPresentTimeProfiling();
     VkResult err = VK_SUCCESS;
 
+    auto& frame = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ];
+
+    // Compute work recorded after the render graph must execute before the draws that read it.
+    FlushOffscreenPasses();
+
 #if AE3D_OPENVR
     VR::SubmitFrame();
 #else
@@ -2133,11 +3306,11 @@ void ae3d::GfxDevice::Present()
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submitInfo.pWaitDstStageMask = &pipelineStages;
     submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &GfxDeviceGlobal::presentCompleteSemaphore;
+    submitInfo.pWaitSemaphores = &frame.presentCompleteSemaphore;
     submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &GfxDeviceGlobal::renderCompleteSemaphore;
+    submitInfo.pSignalSemaphores = &frame.renderCompleteSemaphore;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ];
+    submitInfo.pCommandBuffers = &frame.drawCmdBuffer;
 
     err = vkQueueSubmit( GfxDeviceGlobal::graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE );
     AE3D_CHECK_VULKAN( err, "vkQueueSubmit" );
@@ -2150,7 +3323,7 @@ void ae3d::GfxDevice::Present()
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = &GfxDeviceGlobal::swapChain;
     presentInfo.pImageIndices = &GfxDeviceGlobal::currentBuffer;
-    presentInfo.pWaitSemaphores = &GfxDeviceGlobal::renderCompleteSemaphore;
+    presentInfo.pWaitSemaphores = &frame.renderCompleteSemaphore;
     presentInfo.waitSemaphoreCount = 1;
     err = queuePresentKHR( GfxDeviceGlobal::graphicsQueue, &presentInfo );
 
@@ -2161,34 +3334,16 @@ void ae3d::GfxDevice::Present()
 
     AE3D_CHECK_VULKAN( err, "queuePresent" );
 
-    if (GfxDeviceGlobal::usedOffscreen)
-    {
-        GfxDeviceGlobal::usedOffscreen = false;
-
-        std::uint64_t timestamps[ 2 ] = {};
-		err = vkGetQueryPoolResults( GfxDeviceGlobal::device, GfxDeviceGlobal::queryPool, 0, 2, sizeof( std::uint64_t ) * 2, timestamps, sizeof( std::uint64_t ), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT );
-		//AE3D_CHECK_VULKAN( err, "vkGetQueryPoolResults" );
-
-        GfxDeviceGlobal::timings[ 0 ] = (timestamps[ 1 ] - timestamps[ 0 ]) / 1000.0f;
-
-        Statistics::SetDepthNormalsGpuTime( GfxDeviceGlobal::timings[ 0 ] );
-    }
-
-    // FIXME: This slows down rendering
-    err = vkQueueWaitIdle( GfxDeviceGlobal::graphicsQueue );
-    AE3D_CHECK_VULKAN( err, "vkQueueWaitIdle" );
+    // The next frame's resources are reused after BeginFrame waits for their fence.
+    GfxDeviceGlobal::frameIndex = (GfxDeviceGlobal::frameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
 
-    for (unsigned i = 0; i < GfxDeviceGlobal::pendingFreeVBs.count; ++i)
-    {
-        vkDestroyBuffer( GfxDeviceGlobal::device, GfxDeviceGlobal::pendingFreeVBs[ i ], nullptr );
-    }
-
-    GfxDeviceGlobal::pendingFreeVBs.Allocate( 0 );
     Statistics::EndPresentTimeProfiling();
 }
 
 void ae3d::GfxDevice::ReleaseGPUObjects()
 {
+    JobSystem::Wait( &GfxDeviceGlobal::psoCompileCounter );
+
     VkResult err = vkDeviceWaitIdle( GfxDeviceGlobal::device );
     AE3D_CHECK_VULKAN( err, "vkDeviceWaitIdle" );
 
@@ -2206,11 +3361,18 @@ void ae3d::GfxDevice::ReleaseGPUObjects()
 
     vkDestroyImage( GfxDeviceGlobal::device, GfxDeviceGlobal::depthStencil.image, nullptr );
     vkDestroyImageView( GfxDeviceGlobal::device, GfxDeviceGlobal::depthStencil.view, nullptr );
-    vkFreeMemory( GfxDeviceGlobal::device, GfxDeviceGlobal::depthStencil.mem, nullptr );
+    FreeMemory( GfxDeviceGlobal::depthStencil.mem );
 
     vkDestroyDescriptorSetLayout( GfxDeviceGlobal::device, GfxDeviceGlobal::descriptorSetLayout, nullptr );
-    vkDestroyDescriptorPool( GfxDeviceGlobal::device, GfxDeviceGlobal::descriptorPool, nullptr );
+    vkDestroyDescriptorSetLayout( GfxDeviceGlobal::device, GfxDeviceGlobal::indirectDescriptorSetLayout, nullptr );
+    vkDestroyBuffer( GfxDeviceGlobal::device, GfxDeviceGlobal::indirect.instances, nullptr );
+    vkDestroyBuffer( GfxDeviceGlobal::device, GfxDeviceGlobal::indirect.commands, nullptr );
+    vkDestroyBuffer( GfxDeviceGlobal::device, GfxDeviceGlobal::indirect.visibleInstances, nullptr );
+    FreeMemory( GfxDeviceGlobal::indirect.instancesMemory );
+    FreeMemory( GfxDeviceGlobal::indirect.commandsMemory );
+    FreeMemory( GfxDeviceGlobal::indirect.visibleInstancesMemory );
     vkDestroyRenderPass( GfxDeviceGlobal::device, GfxDeviceGlobal::renderPass, nullptr );
+    vkDestroyRenderPass( GfxDeviceGlobal::device, GfxDeviceGlobal::loadRenderPass, nullptr );
     vkDestroyQueryPool( GfxDeviceGlobal::device, GfxDeviceGlobal::queryPool, nullptr );
 
     if (GfxDeviceGlobal::msaaTarget.colorImage != VK_NULL_HANDLE)
@@ -2219,14 +3381,27 @@ void ae3d::GfxDevice::ReleaseGPUObjects()
         vkDestroyImage( GfxDeviceGlobal::device, GfxDeviceGlobal::msaaTarget.depthImage, nullptr );
         vkDestroyImageView( GfxDeviceGlobal::device, GfxDeviceGlobal::msaaTarget.colorView, nullptr );
         vkDestroyImageView( GfxDeviceGlobal::device, GfxDeviceGlobal::msaaTarget.depthView, nullptr );
-        vkFreeMemory( GfxDeviceGlobal::device, GfxDeviceGlobal::msaaTarget.depthMem, nullptr );
-        vkFreeMemory( GfxDeviceGlobal::device, GfxDeviceGlobal::msaaTarget.colorMem, nullptr );
+        FreeMemory( GfxDeviceGlobal::msaaTarget.depthMem );
+        FreeMemory( GfxDeviceGlobal::msaaTarget.colorMem );
     }
 
-    for (unsigned i = 0; i < GfxDeviceGlobal::ubos.count; ++i)
+    for (auto& frame : GfxDeviceGlobal::frames)
     {
-        vkFreeMemory( GfxDeviceGlobal::device, GfxDeviceGlobal::ubos[ i ].uboMemory, nullptr );
-        vkDestroyBuffer( GfxDeviceGlobal::device, GfxDeviceGlobal::ubos[ i ].ubo, nullptr );
+        for (UboBlock& block : frame.uboBlocks)
+        {
+            DestroyUboBlock( block );
+        }
+
+        for (VkDescriptorPool pool : frame.descriptorPools)
+        {
+            vkDestroyDescriptorPool( GfxDeviceGlobal::device, pool, nullptr );
+        }
+
+        vkDestroyDescriptorPool( GfxDeviceGlobal::device, frame.indirectDescriptorPool, nullptr );
+        vkDestroySemaphore( GfxDeviceGlobal::device, frame.renderCompleteSemaphore, nullptr );
+        vkDestroySemaphore( GfxDeviceGlobal::device, frame.presentCompleteSemaphore, nullptr );
+        vkDestroyFence( GfxDeviceGlobal::device, frame.fence, nullptr );
+        vkDestroyFence( GfxDeviceGlobal::device, frame.offscreenFence, nullptr );
     }
 
     Shader::DestroyShaders();
@@ -2242,40 +3417,99 @@ void ae3d::GfxDevice::ReleaseGPUObjects()
         vkDestroyPipeline( GfxDeviceGlobal::device, pso.second, nullptr );
     }
 
-    vkDestroySemaphore( GfxDeviceGlobal::device, GfxDeviceGlobal::renderCompleteSemaphore, nullptr );
-    vkDestroySemaphore( GfxDeviceGlobal::device, GfxDeviceGlobal::presentCompleteSemaphore, nullptr );
     vkDestroySemaphore( GfxDeviceGlobal::device, GfxDeviceGlobal::offscreenSemaphore, nullptr );
     vkDestroyPipelineLayout( GfxDeviceGlobal::device, GfxDeviceGlobal::pipelineLayout, nullptr );
+    SavePipelineCache();
     vkDestroyPipelineCache( GfxDeviceGlobal::device, GfxDeviceGlobal::pipelineCache, nullptr );
     vkDestroySwapchainKHR( GfxDeviceGlobal::device, GfxDeviceGlobal::swapChain, nullptr );
     vkDestroySurfaceKHR( GfxDeviceGlobal::instance, GfxDeviceGlobal::surface, nullptr );
     vkDestroyCommandPool( GfxDeviceGlobal::device, GfxDeviceGlobal::cmdPool, nullptr );
+
+    for (unsigned threadIndex = 0; threadIndex < GfxDeviceGlobal::recordingThreadCount; ++threadIndex)
+    {
+        for (VkCommandPool cmdPool : GfxDeviceGlobal::recordingThreads[ threadIndex ].cmdPools)
+        {
+            vkDestroyCommandPool( GfxDeviceGlobal::device, cmdPool, nullptr );
+        }
+    }
+
+    DestroyMemoryBlocks();
     vkDestroyDevice( GfxDeviceGlobal::device, nullptr );
     vkDestroyInstance( GfxDeviceGlobal::instance, nullptr );
 }
 
 void ae3d::GfxDevice::SetRenderTarget( RenderTexture* target, unsigned /*cubeMapFace*/ )
 {
-    GfxDeviceGlobal::currentCmdBuffer = target ? GfxDeviceGlobal::offscreenCmdBuffer : GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ];
+    const auto& frame = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ];
+    GfxDeviceGlobal::currentCmdBuffer = target ? frame.offscreenCmdBuffer : frame.drawCmdBuffer;
     GfxDeviceGlobal::renderTexture0 = target;
     GfxDeviceGlobal::frameBuffer0 = target ? target->GetFrameBuffer() : VK_NULL_HANDLE;
 }
 
-void BeginOffscreen()
+/// Waits until the frame's last offscreen submit has finished, so its command buffer can be recorded again.
+static void WaitForOffscreenPasses()
 {
-    ae3d::System::Assert( GfxDeviceGlobal::renderTexture0 != nullptr, "Render texture must be set when beginning offscreen rendering" );
-    
-    // FIXME: Use fence instead of queue wait.
-    vkQueueWaitIdle( GfxDeviceGlobal::graphicsQueue );
+    auto& frame = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ];
 
-    VkCommandBufferBeginInfo cmdBufInfo = {};
-    cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    if (!frame.isOffscreenFencePending)
+    {
+        return;
+    }
 
-    VkResult err = vkBeginCommandBuffer( GfxDeviceGlobal::offscreenCmdBuffer, &cmdBufInfo );
-    AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer" );
+    VkResult err = vkWaitForFences( GfxDeviceGlobal::device, 1, &frame.offscreenFence, VK_TRUE, UINT64_MAX );
+    AE3D_CHECK_VULKAN( err, "vkWaitForFences offscreen" );
+    Statistics::IncFenceCalls();
+    frame.isOffscreenFencePending = false;
+}
+
+/// Begins the frame's offscreenCmdBuffer if it isn't recording.
+static void BeginOffscreenCmdBuffer()
+{
+    auto& frame = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ];
+
+    if (!GfxDeviceGlobal::isOffscreenCmdBufferRecording)
+    {
+        // Only needed if the frame has already submitted offscreen passes. The previous frame's offscreen passes can still be executing.
+        WaitForOffscreenPasses();
+
+        VkCommandBufferBeginInfo cmdBufInfo = {};
+        cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        VkResult err = vkBeginCommandBuffer( frame.offscreenCmdBuffer, &cmdBufInfo );
+        AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer" );
+        GfxDeviceGlobal::boundGeometryCmdBuffer = VK_NULL_HANDLE;
+
+        // Earlier frames' passes that are still executing can read the render textures that these passes overwrite.
+        vkCmdPipelineBarrier( frame.offscreenCmdBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr );
+        Statistics::IncBarrierCalls();
+
+        const std::uint32_t firstQuery = 2 * GfxDeviceGlobal::frameIndex;
+        vkCmdResetQueryPool( frame.offscreenCmdBuffer, GfxDeviceGlobal::queryPool, firstQuery, 2 );
+        vkCmdWriteTimestamp( frame.offscreenCmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, GfxDeviceGlobal::queryPool, firstQuery );
+        GfxDeviceGlobal::isOffscreenCmdBufferRecording = true;
+    }
+}
+
+/// Returns the command buffer that compute work is recorded to. Compute work and offscreen passes share the frame's offscreenCmdBuffer,
+/// so they are ordered by barriers on the GPU and submitted before the frame's draw command buffer.
+VkCommandBuffer BeginComputeCommands()
+{
+    auto& frame = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ];
+    ae3d::System::Assert( GfxDeviceGlobal::activeRenderPass.cmdBuffer != frame.offscreenCmdBuffer, "Compute work can't be recorded inside an offscreen pass" );
+
+    BeginOffscreenCmdBuffer();
+    GfxDeviceGlobal::computeCmdBuffer = frame.offscreenCmdBuffer;
+    return frame.offscreenCmdBuffer;
+}
+
+void BeginOffscreen()
+{
+    ae3d::System::Assert( GfxDeviceGlobal::renderTexture0 != nullptr, "Render texture must be set when beginning offscreen rendering" );
 
-    vkCmdResetQueryPool( GfxDeviceGlobal::offscreenCmdBuffer, GfxDeviceGlobal::queryPool, 0, 2 );
-    vkCmdWriteTimestamp( GfxDeviceGlobal::offscreenCmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, GfxDeviceGlobal::queryPool, 0 );
+    auto& frame = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ];
+    BeginOffscreenCmdBuffer();
 
     VkClearValue clearValues[ 2 ];
     clearValues[ 0 ].color = GfxDeviceGlobal::clearColor;
@@ -2292,17 +3526,33 @@ void BeginOffscreen()
     renderPassBeginInfo.pClearValues = clearValues;
     renderPassBeginInfo.framebuffer = GfxDeviceGlobal::frameBuffer0;
 
-    vkCmdBeginRenderPass( GfxDeviceGlobal::offscreenCmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE );
+    vkCmdBeginRenderPass( frame.offscreenCmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE );
 
-    GfxDeviceGlobal::usedOffscreen = true;
+    SetActiveRenderPass( frame.offscreenCmdBuffer, GfxDeviceGlobal::renderTexture0->GetLoadRenderPass(), GfxDeviceGlobal::frameBuffer0,
+                         GfxDeviceGlobal::renderTexture0->GetWidth(), GfxDeviceGlobal::renderTexture0->GetHeight() );
+
+    frame.usedOffscreen = true;
 }
 
 void EndOffscreen()
 {
-    vkCmdWriteTimestamp( GfxDeviceGlobal::offscreenCmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, GfxDeviceGlobal::queryPool, 1 );
-    vkCmdEndRenderPass( GfxDeviceGlobal::offscreenCmdBuffer );
+    vkCmdEndRenderPass( GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ].offscreenCmdBuffer );
+    GfxDeviceGlobal::activeRenderPass.cmdBuffer = VK_NULL_HANDLE;
+}
+
+void ae3d::GfxDevice::FlushOffscreenPasses()
+{
+    if (!GfxDeviceGlobal::isOffscreenCmdBufferRecording)
+    {
+        return;
+    }
+
+    auto& frame = GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ];
+
+    GfxDeviceGlobal::isOffscreenCmdBufferRecording = false;
+    vkCmdWriteTimestamp( frame.offscreenCmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, GfxDeviceGlobal::queryPool, 2 * GfxDeviceGlobal::frameIndex + 1 );
 
-    VkResult err = vkEndCommandBuffer( GfxDeviceGlobal::offscreenCmdBuffer );
+    VkResult err = vkEndCommandBuffer( frame.offscreenCmdBuffer );
     AE3D_CHECK_VULKAN( err, "vkEndCommandBuffer" );
 
     VkPipelineStageFlags pipelineStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
@@ -2315,9 +3565,144 @@ void EndOffscreen()
     submitInfo.signalSemaphoreCount = 0;
     submitInfo.pSignalSemaphores = nullptr;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &GfxDeviceGlobal::offscreenCmdBuffer;
+    submitInfo.pCommandBuffers = &frame.offscreenCmdBuffer;
 
-    err = vkQueueSubmit( GfxDeviceGlobal::graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE );
+    err = vkResetFences( GfxDeviceGlobal::device, 1, &frame.offscreenFence );
+    AE3D_CHECK_VULKAN( err, "vkResetFences offscreen" );
+
+    err = vkQueueSubmit( GfxDeviceGlobal::graphicsQueue, 1, &submitInfo, frame.offscreenFence );
     AE3D_CHECK_VULKAN( err, "vkQueueSubmit" );
+    frame.isOffscreenFencePending = true;
+}
+
+void ae3d::GfxDevice::TransitionRenderTexture( RenderTexture* texture, TextureState before, TextureState after )
+{
+    // Render passes' attachment layouts already leave textures in SHADER_READ_ONLY_OPTIMAL, so only execution and memory dependencies are needed.
+    if (before == TextureState::Undefined || !GfxDeviceGlobal::isOffscreenCmdBufferRecording)
+    {
+        // BeginOffscreen orders passes after earlier submits' reads, and the writing pass of a read was in an earlier submit or is the back buffer's.
+        return;
+    }
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, texture->IsCube() ? 6u : 1u };
+    barrier.image = texture->GetColorImage();
+
+    // Light culling's compute shaders are recorded into the same command buffer as the passes.
+    VkPipelineStageFlags srcStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    VkPipelineStageFlags dstStage = after == TextureState::ComputeShaderRead ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+    if (before == TextureState::RenderTarget)
+    {
+        barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    }
+    else
+    {
+        // Write after read only needs the reads to finish.
+        srcStage = before == TextureState::ComputeShaderRead ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        dstStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    }
+
+    vkCmdPipelineBarrier( GfxDeviceGlobal::frames[ GfxDeviceGlobal::frameIndex ].offscreenCmdBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier );
+    Statistics::IncBarrierCalls();
 }
 
+void ae3d::GfxDevice::ExecuteCommands( const CommandStream& stream, std::size_t firstCommand )
+{
+    const std::size_t commandCount = stream.GetCommandCount();
+    std::size_t i = firstCommand;
+
+    while (i < commandCount)
+    {
+        const RenderCommand& command = stream.GetCommand( i );
+
+        if (command.type == RenderCommand::Type::BeginPass)
+        {
+            const RenderCommand::BeginPassData& data = command.beginPass;
+            int viewport[ 4 ] = { data.viewport[ 0 ], data.viewport[ 1 ], data.viewport[ 2 ], data.viewport[ 3 ] };
+
+            // Clear color is used when BeginOffscreen begins the render pass. The back buffer's render pass is begun by BeginRenderPassAndCommandBuffer.
+            SetClearColor( data.clearColor[ 0 ], data.clearColor[ 1 ], data.clearColor[ 2 ] );
+            SetRenderTarget( data.target, data.cubeMapFace );
+
+            if (data.target != nullptr)
+            {
+                BeginOffscreen();
+            }
+
+            SetViewport( viewport );
+            SetScissor( viewport );
+            ++i;
+            continue;
+        }
+
+        if (command.type == RenderCommand::Type::EndPass)
+        {
+            SetRenderTarget( nullptr, 0 );
+
+            if (command.endPass.target != nullptr)
+            {
+                EndOffscreen();
+            }
+
+            ++i;
+            continue;
+        }
+
+        if (!command.IsSubMeshDraw())
+        {
+            ExecuteCommonCommand( stream, command );
+            ++i;
+            continue;
+        }
+
+        std::size_t drawsEnd = i + 1;
+
+        while (drawsEnd < commandCount && stream.GetCommand( drawsEnd ).IsSubMeshDraw())
+        {
+            ++drawsEnd;
+        }
+
+        // Long ranges of submesh draws are split into secondary command buffers that are recorded on job threads, and executed in order.
+        const std::size_t drawCount = drawsEnd - i;
+        const std::size_t maxCmdBufferCount = static_cast< std::size_t >( JobSystem::GetWorkerCount() ) + 1;
+        const unsigned cmdBufferCount = static_cast< unsigned >( std::min( drawCount / MIN_DRAWS_PER_SECONDARY_CMD_BUFFER, maxCmdBufferCount ) );
+
+        if (cmdBufferCount > 1 && BeginParallelRecording( cmdBufferCount ))
+        {
+            const std::size_t drawsBegin = i;
+
+            JobSystem::ParallelFor( cmdBufferCount, 1, [&]( unsigned begin, unsigned end )
+            {
+                for (unsigned cmdBufferIndex = begin; cmdBufferIndex < end; ++cmdBufferIndex)
+                {
+                    BeginSecondaryCommandBuffer( cmdBufferIndex );
+
+                    for (std::size_t d = drawsBegin + drawCount * cmdBufferIndex / cmdBufferCount; d < drawsBegin + drawCount * (cmdBufferIndex + 1) / cmdBufferCount; ++d)
+                    {
+                        ExecuteCommonCommand( stream, stream.GetCommand( d ) );
+                    }
+
+                    EndSecondaryCommandBuffer();
+                }
+            } );
+
+            EndParallelRecording();
+        }
+        else
+        {
+            for (std::size_t d = i; d < drawsEnd; ++d)
+            {
+                ExecuteCommonCommand( stream, stream.GetCommand( d ) );
+            }
+        }
+
+        i = drawsEnd;
+    }
+}
@@ -1,9 +1,9 @@
 #include "LightTiler.hpp"
-#include <cstring>
 #include "ComputeShader.hpp"
 #include "Macros.hpp"
 #include "RenderTexture.hpp"
 #include "Renderer.hpp"
+#include "Statistics.hpp"
 #include "System.hpp"
 #include "GfxDevice.hpp"
 #include "VulkanUtils.hpp"
@@ -20,282 +20,122 @@ namespace GfxDeviceGlobal
     extern unsigned backBufferWidth;
     extern unsigned backBufferHeight;
     extern VkDevice device;
-    extern PerObjectUboStruct perObjectUboStruct;
-    extern VkCommandBuffer computeCmdBuffer;
+    extern unsigned frameIndex;
+    extern unsigned frameSerial;
+    extern thread_local PerObjectUboStruct perObjectUboStruct;
     extern VkDescriptorSetLayout descriptorSetLayout;
-    extern VkQueue computeQueue;
-    extern VkImageView boundViews[ 2 ];
-    extern VkSampler boundSamplers[ 2 ];
+    extern thread_local VkImageView boundViews[ 13 ];
+    extern thread_local VkSampler boundSamplers[ 2 ];
 }
 
-void UploadPerObjectUbo();
+VkCommandBuffer BeginComputeCommands();
 
-void ae3d::LightTiler::DestroyBuffers()
+void ae3d::LightTiler::CreateLightBuffers( LightBuffer* buffers, VkDeviceSize size, VkBufferUsageFlags usage, VkFormat format, const char* debugName )
 {
-    vkDestroyBuffer( GfxDeviceGlobal::device, perTileLightIndexBuffer, nullptr );
-    vkDestroyBuffer( GfxDeviceGlobal::device, pointLightCenterAndRadiusBuffer, nullptr );
-    vkDestroyBuffer( GfxDeviceGlobal::device, pointLightColorBuffer, nullptr );
-    vkDestroyBuffer( GfxDeviceGlobal::device, spotLightColorBuffer, nullptr );
-    vkDestroyBuffer( GfxDeviceGlobal::device, spotLightCenterAndRadiusBuffer, nullptr );
-    vkDestroyBuffer( GfxDeviceGlobal::device, spotLightParamsBuffer, nullptr );
-    vkDestroyBufferView( GfxDeviceGlobal::device, perTileLightIndexBufferView, nullptr );
-    vkDestroyBufferView( GfxDeviceGlobal::device, pointLightBufferView, nullptr );
-    vkDestroyBufferView( GfxDeviceGlobal::device, pointLightColorView, nullptr );
-    vkDestroyBufferView( GfxDeviceGlobal::device, spotLightColorView, nullptr );
-    vkDestroyBufferView( GfxDeviceGlobal::device, spotLightBufferView, nullptr );
-    vkDestroyBufferView( GfxDeviceGlobal::device, spotLightParamsView, nullptr );
-    vkFreeMemory( GfxDeviceGlobal::device, perTileLightIndexBufferMemory, nullptr );
-    vkFreeMemory( GfxDeviceGlobal::device, pointLightCenterAndRadiusMemory, nullptr );
-    vkFreeMemory( GfxDeviceGlobal::device, pointLightColorMemory, nullptr );
-    vkFreeMemory( GfxDeviceGlobal::device, spotLightColorMemory, nullptr );
-    vkFreeMemory( GfxDeviceGlobal::device, spotLightCenterAndRadiusMemory, nullptr );
-    vkFreeMemory( GfxDeviceGlobal::device, spotLightParamsMemory, nullptr );
-}
-
-void ae3d::LightTiler::Init()
-{
-    // Light index buffer
+    for (unsigned frameIndex = 0; frameIndex < MAX_FRAMES_IN_FLIGHT; ++frameIndex)
     {
-        const unsigned numTiles = GetNumTilesX() * GetNumTilesY();
-        const unsigned maxNumLightsPerTile = GetMaxNumLightsPerTile();
+        LightBuffer& lightBuffer = buffers[ frameIndex ];
 
         VkBufferCreateInfo bufferInfo = {};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = maxNumLightsPerTile * numTiles * sizeof( unsigned );
-        bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT;
-        VkResult err = vkCreateBuffer( GfxDeviceGlobal::device, &bufferInfo, nullptr, &perTileLightIndexBuffer );
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        VkResult err = vkCreateBuffer( GfxDeviceGlobal::device, &bufferInfo, nullptr, &lightBuffer.buffer );
         AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)perTileLightIndexBuffer, VK_OBJECT_TYPE_BUFFER, "perTileLightIndexBuffer" );
-
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, perTileLightIndexBuffer, &memReqs );
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &perTileLightIndexBufferMemory );
-        AE3D_CHECK_VULKAN( err, "vkAllocateMemory perTileLightIndexBuffer" );
+        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)lightBuffer.buffer, VK_OBJECT_TYPE_BUFFER, debugName );
 
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)perTileLightIndexBufferMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "perTileLightIndexBufferMemory" );
-
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, perTileLightIndexBuffer, perTileLightIndexBufferMemory, 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory perTileLightIndexBuffer" );
+        lightBuffer.memory = AllocateAndBindBuffer( lightBuffer.buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, debugName );
 
         VkBufferViewCreateInfo bufferViewInfo = {};
         bufferViewInfo.sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
         bufferViewInfo.flags = 0;
-        bufferViewInfo.buffer = perTileLightIndexBuffer;
+        bufferViewInfo.buffer = lightBuffer.buffer;
         bufferViewInfo.range = VK_WHOLE_SIZE;
-        bufferViewInfo.format = VK_FORMAT_R32_UINT;
+        bufferViewInfo.format = format;
 
-        err = vkCreateBufferView( GfxDeviceGlobal::device, &bufferViewInfo, nullptr, &perTileLightIndexBufferView );
-        AE3D_CHECK_VULKAN( err, "light index buffer view" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)perTileLightIndexBufferView, VK_OBJECT_TYPE_BUFFER_VIEW, "perTileLightIndexBufferView" );
+        err = vkCreateBufferView( GfxDeviceGlobal::device, &bufferViewInfo, nullptr, &lightBuffer.view );
+        AE3D_CHECK_VULKAN( err, "light buffer view" );
+        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)lightBuffer.view, VK_OBJECT_TYPE_BUFFER_VIEW, debugName );
     }
+}
 
-    // Point light center/radius buffer
+void ae3d::LightTiler::DestroyLightBuffers( LightBuffer* buffers )
+{
+    for (unsigned frameIndex = 0; frameIndex < MAX_FRAMES_IN_FLIGHT; ++frameIndex)
     {
-        VkBufferCreateInfo bufferInfo = {};
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = MaxLights * 4 * sizeof( float );
-        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
-        VkResult err = vkCreateBuffer( GfxDeviceGlobal::device, &bufferInfo, nullptr, &pointLightCenterAndRadiusBuffer );
-        AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)pointLightCenterAndRadiusBuffer, VK_OBJECT_TYPE_BUFFER, "pointLightCenterAndRadiusBuffer" );
-
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, pointLightCenterAndRadiusBuffer, &memReqs );
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &pointLightCenterAndRadiusMemory );
-        AE3D_CHECK_VULKAN( err, "vkAllocateMemory pointLightCenterAndRadiusMemory" );
-
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)pointLightCenterAndRadiusMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "pointLightCenterAndRadiusMemory" );
-
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, pointLightCenterAndRadiusBuffer, pointLightCenterAndRadiusMemory, 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory pointLightCenterAndRadiusBuffer" );
-
-        err = vkMapMemory( GfxDeviceGlobal::device, pointLightCenterAndRadiusMemory, 0, bufferInfo.size, 0, &mappedPointLightCenterAndRadiusMemory );
-        AE3D_CHECK_VULKAN( err, "vkMapMemory point lights" );
-
-        VkBufferViewCreateInfo bufferViewInfo = {};
-        bufferViewInfo.sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
-        bufferViewInfo.flags = 0;
-        bufferViewInfo.buffer = pointLightCenterAndRadiusBuffer;
-        bufferViewInfo.range = VK_WHOLE_SIZE;
-        bufferViewInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-
-        err = vkCreateBufferView( GfxDeviceGlobal::device, &bufferViewInfo, nullptr, &pointLightBufferView );
-        AE3D_CHECK_VULKAN( err, "point light buffer view" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)pointLightBufferView, VK_OBJECT_TYPE_BUFFER_VIEW, "pointLightBufferView" );
+        vkDestroyBufferView( GfxDeviceGlobal::device, buffers[ frameIndex ].view, nullptr );
+        vkDestroyBuffer( GfxDeviceGlobal::device, buffers[ frameIndex ].buffer, nullptr );
+        FreeMemory( buffers[ frameIndex ].memory );
     }
+}
 
-    // Point light color buffer
-    {
-        VkBufferCreateInfo bufferInfo = {};
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = MaxLights * 4 * sizeof( float );
-        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
-        VkResult err = vkCreateBuffer( GfxDeviceGlobal::device, &bufferInfo, nullptr, &pointLightColorBuffer );
-        AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)pointLightColorBuffer, VK_OBJECT_TYPE_BUFFER, "pointLightColorBuffer" );
-
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, pointLightColorBuffer, &memReqs );
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &pointLightColorMemory );
-        AE3D_CHECK_VULKAN( err, "vkAllocateMemory pointLightColorMemory" );
-
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, pointLightColorBuffer, pointLightColorMemory, 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory pointLightColorBuffer" );
-
-        err = vkMapMemory( GfxDeviceGlobal::device, pointLightColorMemory, 0, bufferInfo.size, 0, &mappedPointLightColorMemory );
-        AE3D_CHECK_VULKAN( err, "vkMapMemory point lights" );
+void ae3d::LightTiler::DestroyBuffers()
+{
+    DestroyLightBuffers( perTileLightIndexBuffers );
+    DestroyLightBuffers( pointLightCenterAndRadiusBuffers );
+    DestroyLightBuffers( pointLightColorBuffers );
+    DestroyLightBuffers( spotLightColorBuffers );
+    DestroyLightBuffers( spotLightCenterAndRadiusBuffers );
+    DestroyLightBuffers( spotLightParamsBuffers );
+}
 
-        VkBufferViewCreateInfo bufferViewInfo = {};
-        bufferViewInfo.sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
-        bufferViewInfo.flags = 0;
-        bufferViewInfo.buffer = pointLightColorBuffer;
-        bufferViewInfo.range = VK_WHOLE_SIZE;
-        bufferViewInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+void ae3d::LightTiler::Init()
+{
+    const unsigned numTiles = GetNumTilesX() * GetNumTilesY();
+    CreateLightBuffers( perTileLightIndexBuffers, GetMaxNumLightsPerTile() * numTiles * sizeof( unsigned ), VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT,
+                        VK_FORMAT_R32_UINT, "perTileLightIndexBuffer" );
+
+    // Light buffers are written by vkCmdUpdateBuffer, so each camera's light culling reads its own lights even though the frame is submitted later.
+    const VkDeviceSize lightBufferSize = MaxLights * 4 * sizeof( float );
+    const VkBufferUsageFlags lightBufferUsage = VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    CreateLightBuffers( pointLightCenterAndRadiusBuffers, lightBufferSize, lightBufferUsage, VK_FORMAT_R32G32B32A32_SFLOAT, "pointLightCenterAndRadiusBuffer" );
+    CreateLightBuffers( pointLightColorBuffers, lightBufferSize, lightBufferUsage, VK_FORMAT_R32G32B32A32_SFLOAT, "pointLightColorBuffer" );
+    CreateLightBuffers( spotLightCenterAndRadiusBuffers, lightBufferSize, lightBufferUsage, VK_FORMAT_R32G32B32A32_SFLOAT, "spotLightCenterAndRadiusBuffer" );
+    CreateLightBuffers( spotLightParamsBuffers, lightBufferSize, lightBufferUsage, VK_FORMAT_R32G32B32A32_SFLOAT, "spotLightParamsBuffer" );
+    CreateLightBuffers( spotLightColorBuffers, lightBufferSize, lightBufferUsage, VK_FORMAT_R32G32B32A32_SFLOAT, "spotLightColorBuffer" );
+}
 
-        err = vkCreateBufferView( GfxDeviceGlobal::device, &bufferViewInfo, nullptr, &pointLightColorView );
-        AE3D_CHECK_VULKAN( err, "point light color view" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)pointLightColorView, VK_OBJECT_TYPE_BUFFER_VIEW, "pointLightColorView" );
-    }
+void ae3d::LightTiler::UpdateLightBuffers()
+{
+    VkCommandBuffer cmdBuffer = BeginComputeCommands();
+    const unsigned frameIndex = GfxDeviceGlobal::frameIndex;
 
-    // Spot light buffer
+    // The frame's copies were last read by the frame that BeginFrame waited for, unless an earlier camera of this frame reads them.
+    if (lightBufferFrameSerial == GfxDeviceGlobal::frameSerial)
     {
-        VkBufferCreateInfo bufferInfo = {};
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = MaxLights * 4 * sizeof( float );
-        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
-        VkResult err = vkCreateBuffer( GfxDeviceGlobal::device, &bufferInfo, nullptr, &spotLightCenterAndRadiusBuffer );
-        AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightCenterAndRadiusBuffer, VK_OBJECT_TYPE_BUFFER, "spotLightCenterAndRadiusBuffer" );
-
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, spotLightCenterAndRadiusBuffer, &memReqs );
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &spotLightCenterAndRadiusMemory );
-        AE3D_CHECK_VULKAN( err, "vkAllocateMemory spotLightCenterAndRadiusMemory" );
-
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, spotLightCenterAndRadiusBuffer, spotLightCenterAndRadiusMemory, 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory spotLightCenterAndRadiusBuffer" );
-
-        err = vkMapMemory( GfxDeviceGlobal::device, spotLightCenterAndRadiusMemory, 0, bufferInfo.size, 0, &mappedSpotLightCenterAndRadiusMemory );
-        AE3D_CHECK_VULKAN( err, "vkMapMemory spot lights" );
-
-        VkBufferViewCreateInfo bufferViewInfo = {};
-        bufferViewInfo.sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
-        bufferViewInfo.flags = 0;
-        bufferViewInfo.buffer = spotLightCenterAndRadiusBuffer;
-        bufferViewInfo.range = VK_WHOLE_SIZE;
-        bufferViewInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-
-        err = vkCreateBufferView( GfxDeviceGlobal::device, &bufferViewInfo, nullptr, &spotLightBufferView );
-        AE3D_CHECK_VULKAN( err, "spot light buffer view" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightBufferView, VK_OBJECT_TYPE_BUFFER_VIEW, "spotLightBufferView" );
+        vkCmdPipelineBarrier( cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                              0, nullptr, 0, nullptr, 0, nullptr );
+        Statistics::IncBarrierCalls();
     }
 
-    // Spot light params buffer
-    {
-        VkBufferCreateInfo bufferInfo = {};
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = MaxLights * 4 * sizeof( float );
-        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
-        VkResult err = vkCreateBuffer( GfxDeviceGlobal::device, &bufferInfo, nullptr, &spotLightParamsBuffer );
-        AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightParamsBuffer, VK_OBJECT_TYPE_BUFFER, "spotLightParamsBuffer" );
-
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, spotLightParamsBuffer, &memReqs );
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &spotLightParamsMemory );
-        AE3D_CHECK_VULKAN( err, "vkAllocateMemory spotLightParamsMemory" );
+    lightBufferFrameSerial = GfxDeviceGlobal::frameSerial;
 
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, spotLightParamsBuffer, spotLightParamsMemory, 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory spotLightParamsBuffer" );
+    // Only active lights are read, and vkCmdUpdateBuffer's limit of 65536 bytes fits MaxLights.
+    static_assert( MaxLights * sizeof( Vec4 ) <= 65536, "light buffers are too big for vkCmdUpdateBuffer" );
+    const VkDeviceSize pointLightBytes = activePointLights * sizeof( Vec4 );
+    const VkDeviceSize spotLightBytes = activeSpotLights * sizeof( Vec4 );
 
-        err = vkMapMemory( GfxDeviceGlobal::device, spotLightParamsMemory, 0, bufferInfo.size, 0, &mappedSpotLightParamsMemory );
-        AE3D_CHECK_VULKAN( err, "vkMapMemory spot lights" );
-
-        VkBufferViewCreateInfo bufferViewInfo = {};
-        bufferViewInfo.sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
-        bufferViewInfo.flags = 0;
-        bufferViewInfo.buffer = spotLightParamsBuffer;
-        bufferViewInfo.range = VK_WHOLE_SIZE;
-        bufferViewInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-
-        err = vkCreateBufferView( GfxDeviceGlobal::device, &bufferViewInfo, nullptr, &spotLightParamsView );
-        AE3D_CHECK_VULKAN( err, "spot light params buffer view" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightParamsView, VK_OBJECT_TYPE_BUFFER_VIEW, "spotLightParamsBufferView" );
+    if (pointLightBytes > 0)
+    {
+        vkCmdUpdateBuffer( cmdBuffer, pointLightCenterAndRadiusBuffers[ frameIndex ].buffer, 0, pointLightBytes, &pointLightCenterAndRadius[ 0 ] );
+        vkCmdUpdateBuffer( cmdBuffer, pointLightColorBuffers[ frameIndex ].buffer, 0, pointLightBytes, &pointLightColors[ 0 ] );
     }
 
-    // Spot light color buffer
+    if (spotLightBytes > 0)
     {
-        VkBufferCreateInfo bufferInfo = {};
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = MaxLights * 4 * sizeof( float );
-        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
-        VkResult err = vkCreateBuffer( GfxDeviceGlobal::device, &bufferInfo, nullptr, &spotLightColorBuffer );
-        AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightColorBuffer, VK_OBJECT_TYPE_BUFFER, "spotLightColorBuffer" );
-
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, spotLightColorBuffer, &memReqs );
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &spotLightColorMemory );
-        AE3D_CHECK_VULKAN( err, "vkAllocateMemory spotLightColorMemory" );
-
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightColorMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "spotLightColorMemory" );
-
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, spotLightColorBuffer, spotLightColorMemory, 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory spotLightColorBuffer" );
-
-        err = vkMapMemory( GfxDeviceGlobal::device, spotLightColorMemory, 0, bufferInfo.size, 0, &mappedSpotLightColorMemory );
-        AE3D_CHECK_VULKAN( err, "vkMapMemory spot lights" );
-
-        VkBufferViewCreateInfo bufferViewInfo = {};
-        bufferViewInfo.sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
-        bufferViewInfo.flags = 0;
-        bufferViewInfo.buffer = spotLightColorBuffer;
-        bufferViewInfo.range = VK_WHOLE_SIZE;
-        bufferViewInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-
-        err = vkCreateBufferView( GfxDeviceGlobal::device, &bufferViewInfo, nullptr, &spotLightColorView );
-        AE3D_CHECK_VULKAN( err, "spot light color view" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightColorView, VK_OBJECT_TYPE_BUFFER_VIEW, "spotLightColorView" );
+        vkCmdUpdateBuffer( cmdBuffer, spotLightCenterAndRadiusBuffers[ frameIndex ].buffer, 0, spotLightBytes, &spotLightCenterAndRadius[ 0 ] );
+        vkCmdUpdateBuffer( cmdBuffer, spotLightParamsBuffers[ frameIndex ].buffer, 0, spotLightBytes, &spotLightParams[ 0 ] );
+        vkCmdUpdateBuffer( cmdBuffer, spotLightColorBuffers[ frameIndex ].buffer, 0, spotLightBytes, &spotLightColors[ 0 ] );
     }
-}
 
-void ae3d::LightTiler::UpdateLightBuffers()
-{
-    std::memcpy( mappedPointLightCenterAndRadiusMemory, &pointLightCenterAndRadius[ 0 ], MaxLights * 4 * sizeof( float ) );
-    std::memcpy( mappedPointLightColorMemory, &pointLightColors[ 0 ], MaxLights * 4 * sizeof( float ) );
-    std::memcpy( mappedSpotLightCenterAndRadiusMemory, &spotLightCenterAndRadius[ 0 ], MaxLights * 4 * sizeof( float ) );
-    std::memcpy( mappedSpotLightParamsMemory, &spotLightParams[ 0 ], MaxLights * 4 * sizeof( float ) );
-    std::memcpy( mappedSpotLightColorMemory, &spotLightColors[ 0 ], MaxLights * 4 * sizeof( float ) );
+    VkMemoryBarrier transferToShader = {};
+    transferToShader.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    transferToShader.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    transferToShader.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier( cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                          1, &transferToShader, 0, nullptr, 0, nullptr );
+    Statistics::IncBarrierCalls();
 }
 
 unsigned ae3d::LightTiler::GetNumTilesX() const
@@ -310,41 +150,42 @@ unsigned ae3d::LightTiler::GetNumTilesY() const
 
 void ae3d::LightTiler::CullLights( ComputeShader& shader, const Matrix44& projection, const Matrix44& localToView, RenderTexture& depthNormalTarget )
 {
-    Matrix44::Invert( projection, GfxDeviceGlobal::perObjectUboStruct.clipToView );
-
-    GfxDeviceGlobal::perObjectUboStruct.localToView = localToView;
-    GfxDeviceGlobal::perObjectUboStruct.windowWidth = depthNormalTarget.GetWidth();
-    GfxDeviceGlobal::perObjectUboStruct.windowHeight = depthNormalTarget.GetHeight();
-    GfxDeviceGlobal::perObjectUboStruct.numLights = (((unsigned)activeSpotLights & 0xFFFFu) << 16) | ((unsigned)activePointLights & 0xFFFFu);
-    GfxDeviceGlobal::perObjectUboStruct.maxNumLightsPerTile = GetMaxNumLightsPerTile();
-    GfxDeviceGlobal::perObjectUboStruct.tilesXY.x = (float)GetNumTilesX();
-    GfxDeviceGlobal::perObjectUboStruct.tilesXY.y = (float)GetNumTilesY();
+    Matrix44::Invert( projection, GfxDeviceGlobal::perObjectUboStruct.camera.clipToView );
+
+    GfxDeviceGlobal::perObjectUboStruct.object.localToView = localToView;
+    GfxDeviceGlobal::perObjectUboStruct.frame.windowWidth = depthNormalTarget.GetWidth();
+    GfxDeviceGlobal::perObjectUboStruct.frame.windowHeight = depthNormalTarget.GetHeight();
+    GfxDeviceGlobal::perObjectUboStruct.frame.numLights = (((unsigned)activeSpotLights & 0xFFFFu) << 16) | ((unsigned)activePointLights & 0xFFFFu);
+    GfxDeviceGlobal::perObjectUboStruct.frame.maxNumLightsPerTile = GetMaxNumLightsPerTile();
+    GfxDeviceGlobal::perObjectUboStruct.frame.tilesXY.x = (float)GetNumTilesX();
+    GfxDeviceGlobal::perObjectUboStruct.frame.tilesXY.y = (float)GetNumTilesY();
     
     GfxDeviceGlobal::boundViews[ 0 ] = depthNormalTarget.GetColorView();
     GfxDeviceGlobal::boundSamplers[ 0 ] = depthNormalTarget.GetSampler();
     
-    VkCommandBufferBeginInfo cmdBufInfo = {};
-    cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-
-    VkResult err = vkBeginCommandBuffer( GfxDeviceGlobal::computeCmdBuffer, &cmdBufInfo );
-    AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer" );
+    // Recorded into the frame's offscreen command buffer, which is submitted before the draws that read the tiles.
+    VkCommandBuffer cmdBuffer = BeginComputeCommands();
+    const LightBuffer& lightIndexBuffer = perTileLightIndexBuffers[ GfxDeviceGlobal::frameIndex ];
 
-    const unsigned numTiles = GetNumTilesX() * GetNumTilesY();
-    const unsigned maxNumLightsPerTile = GetMaxNumLightsPerTile();
+    // The frame's copy was last read by the frame that BeginFrame waited for, unless an earlier camera of this frame reads it.
+    if (lightIndexBufferFrameSerial == GfxDeviceGlobal::frameSerial)
+    {
+        VkBufferMemoryBarrier fragToLightIndex = {};
+        fragToLightIndex.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        fragToLightIndex.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        fragToLightIndex.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        fragToLightIndex.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        fragToLightIndex.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        fragToLightIndex.buffer = lightIndexBuffer.buffer;
+        fragToLightIndex.size = VK_WHOLE_SIZE;
+
+        vkCmdPipelineBarrier( cmdBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+                              nullptr, 1, &fragToLightIndex, 0, nullptr );
+        Statistics::IncBarrierCalls();
+    }
 
-    VkBufferMemoryBarrier lightIndexToCompute = {};
-    lightIndexToCompute.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-    lightIndexToCompute.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-    lightIndexToCompute.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
-    lightIndexToCompute.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    lightIndexToCompute.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    lightIndexToCompute.buffer = perTileLightIndexBuffer;
-    lightIndexToCompute.size = maxNumLightsPerTile * numTiles * sizeof( unsigned );
+    lightIndexBufferFrameSerial = GfxDeviceGlobal::frameSerial;
 
-    vkCmdPipelineBarrier( GfxDeviceGlobal::computeCmdBuffer, VK_PIPELINE_STAGE_HOST_BIT,
-                                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
-                                     nullptr, 1, &lightIndexToCompute, 0, nullptr );
-    
     shader.Dispatch( GetNumTilesX(), GetNumTilesY(), 1 );
 
     VkBufferMemoryBarrier lightIndexToFrag = {};
@@ -353,30 +194,11 @@ void ae3d::LightTiler::CullLights( ComputeShader& shader, const Matrix44& projec
     lightIndexToFrag.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
     lightIndexToFrag.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     lightIndexToFrag.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    lightIndexToFrag.buffer = perTileLightIndexBuffer;
-    lightIndexToFrag.size = maxNumLightsPerTile * numTiles * sizeof( unsigned );
+    lightIndexToFrag.buffer = lightIndexBuffer.buffer;
+    lightIndexToFrag.size = VK_WHOLE_SIZE;
 
-    vkCmdPipelineBarrier( GfxDeviceGlobal::computeCmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    vkCmdPipelineBarrier( cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
                                     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
                                      nullptr, 1, &lightIndexToFrag, 0, nullptr );
-    
-    vkEndCommandBuffer( GfxDeviceGlobal::computeCmdBuffer );
-
-    VkPipelineStageFlags pipelineStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.pWaitDstStageMask = &pipelineStages;
-    submitInfo.waitSemaphoreCount = 0;
-    submitInfo.pWaitSemaphores = nullptr;
-    submitInfo.signalSemaphoreCount = 0;
-    submitInfo.pSignalSemaphores = nullptr;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &GfxDeviceGlobal::computeCmdBuffer;
-
-    err = vkQueueSubmit( GfxDeviceGlobal::computeQueue, 1, &submitInfo, VK_NULL_HANDLE );
-    AE3D_CHECK_VULKAN( err, "vkQueueSubmit compute" );
-
-    err = vkQueueWaitIdle( GfxDeviceGlobal::computeQueue );
-    AE3D_CHECK_VULKAN( err, "vkQueueWaitIdle" );
+    Statistics::IncBarrierCalls();
 }
@@ -0,0 +1,273 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "Macros.hpp"
+#include "Statistics.hpp"
+#include "System.hpp"
+#include "TLSFAllocator.hpp"
+#include "VulkanUtils.hpp"
+
+namespace GfxDeviceGlobal
+{
+    extern VkDevice device;
+    extern VkPhysicalDeviceMemoryProperties deviceMemoryProperties;
+}
+
+namespace MemoryGlobal
+{
+    /// Device memory that resources of one memory type and resource kind are suballocated from.
+    struct Block
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        /// Null if the memory type isn't host-visible.
+        std::uint8_t* mappedData = nullptr;
+        std::unique_ptr< ae3d::TLSFAllocator > allocator;
+        std::uint32_t memoryTypeIndex = 0;
+        bool isImage = false;
+    };
+
+    const VkDeviceSize MaxBlockSize = 64 * 1024 * 1024;
+    /// Render targets at least this large get dedicated allocations, because they are large and rarely freed.
+    const VkDeviceSize DedicatedRenderTargetSize = 8 * 1024 * 1024;
+
+    /// Freed blocks are left in place with a null memory, so blocks keep their indices.
+    std::vector< Block > blocks;
+    VkDeviceSize dedicatedBytes[ VK_MAX_MEMORY_HEAPS ] = {};
+    unsigned dedicatedCounts[ VK_MAX_MEMORY_HEAPS ] = {};
+    std::mutex mutex;
+}
+
+namespace
+{
+    VkDeviceSize GetBlockSize( std::uint32_t memoryTypeIndex )
+    {
+        const std::uint32_t heapIndex = GfxDeviceGlobal::deviceMemoryProperties.memoryTypes[ memoryTypeIndex ].heapIndex;
+        const VkDeviceSize heapSize = GfxDeviceGlobal::deviceMemoryProperties.memoryHeaps[ heapIndex ].size;
+
+        // Small heaps, like the 256 MB device-local and host-visible heap, would be used up by a few blocks.
+        return std::min( MemoryGlobal::MaxBlockSize, heapSize / 8 ) & ~(ae3d::TLSFAllocator::Granularity - 1);
+    }
+
+    bool IsHostVisible( std::uint32_t memoryTypeIndex )
+    {
+        return (GfxDeviceGlobal::deviceMemoryProperties.memoryTypes[ memoryTypeIndex ].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+    }
+
+    VkDeviceMemory AllocateDeviceMemory( VkDeviceSize size, std::uint32_t memoryTypeIndex, void** outMappedData, const char* debugName )
+    {
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkResult err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &memory );
+        AE3D_CHECK_VULKAN( err, "vkAllocateMemory" );
+        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)memory, VK_OBJECT_TYPE_DEVICE_MEMORY, debugName );
+        Statistics::IncAllocCalls();
+        Statistics::IncTotalAllocCalls();
+
+        *outMappedData = nullptr;
+
+        if (IsHostVisible( memoryTypeIndex ))
+        {
+            err = vkMapMemory( GfxDeviceGlobal::device, memory, 0, VK_WHOLE_SIZE, 0, outMappedData );
+            AE3D_CHECK_VULKAN( err, "vkMapMemory" );
+        }
+
+        return memory;
+    }
+
+    /// \return True if outAllocation was suballocated from block.
+    bool AllocateFromBlock( unsigned blockIndex, const VkMemoryRequirements& requirements, ae3d::MemoryAllocation& outAllocation )
+    {
+        MemoryGlobal::Block& block = MemoryGlobal::blocks[ blockIndex ];
+        std::uint64_t offset = 0;
+        const unsigned range = block.allocator->Allocate( requirements.size, requirements.alignment, offset );
+
+        if (range == ae3d::TLSFAllocator::InvalidAllocation)
+        {
+            return false;
+        }
+
+        outAllocation.memory = block.memory;
+        outAllocation.offset = offset;
+        // Ranges are multiples of TLSFAllocator::Granularity, which is at least nonCoherentAtomSize, so they can be flushed as a whole.
+        outAllocation.size = (requirements.size + ae3d::TLSFAllocator::Granularity - 1) & ~(ae3d::TLSFAllocator::Granularity - 1);
+        outAllocation.mappedData = block.mappedData ? block.mappedData + offset : nullptr;
+        outAllocation.block = blockIndex;
+        outAllocation.range = range;
+        return true;
+    }
+}
+
+ae3d::MemoryAllocation ae3d::AllocateMemory( const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, MemoryResource resource, const char* debugName )
+{
+    const std::uint32_t memoryTypeIndex = GetMemoryType( requirements.memoryTypeBits, properties );
+    const VkDeviceSize blockSize = GetBlockSize( memoryTypeIndex );
+    const bool isImage = resource != MemoryResource::Buffer;
+
+    MemoryAllocation allocation;
+    allocation.memoryTypeIndex = memoryTypeIndex;
+
+    if (requirements.size > blockSize / 2 || (resource == MemoryResource::RenderTarget && requirements.size >= MemoryGlobal::DedicatedRenderTargetSize))
+    {
+        allocation.memory = AllocateDeviceMemory( requirements.size, memoryTypeIndex, &allocation.mappedData, debugName );
+        allocation.size = requirements.size;
+
+        const std::uint32_t heapIndex = GfxDeviceGlobal::deviceMemoryProperties.memoryTypes[ memoryTypeIndex ].heapIndex;
+        std::lock_guard< std::mutex > lock( MemoryGlobal::mutex );
+        MemoryGlobal::dedicatedBytes[ heapIndex ] += requirements.size;
+        ++MemoryGlobal::dedicatedCounts[ heapIndex ];
+        return allocation;
+    }
+
+    std::lock_guard< std::mutex > lock( MemoryGlobal::mutex );
+    unsigned freeSlot = static_cast< unsigned >( MemoryGlobal::blocks.size() );
+
+    for (unsigned blockIndex = 0; blockIndex < static_cast< unsigned >( MemoryGlobal::blocks.size() ); ++blockIndex)
+    {
+        const MemoryGlobal::Block& block = MemoryGlobal::blocks[ blockIndex ];
+
+        if (block.memory == VK_NULL_HANDLE)
+        {
+            freeSlot = std::min( freeSlot, blockIndex );
+        }
+        else if (block.memoryTypeIndex == memoryTypeIndex && block.isImage == isImage && AllocateFromBlock( blockIndex, requirements, allocation ))
+        {
+            return allocation;
+        }
+    }
+
+    if (freeSlot == MemoryGlobal::blocks.size())
+    {
+        MemoryGlobal::blocks.emplace_back();
+    }
+
+    MemoryGlobal::Block& block = MemoryGlobal::blocks[ freeSlot ];
+    void* mappedData = nullptr;
+    block.memory = AllocateDeviceMemory( blockSize, memoryTypeIndex, &mappedData, isImage ? "image memory block" : "buffer memory block" );
+    block.mappedData = static_cast< std::uint8_t* >( mappedData );
+    block.allocator.reset( new TLSFAllocator( blockSize ) );
+    block.memoryTypeIndex = memoryTypeIndex;
+    block.isImage = isImage;
+
+    const bool success = AllocateFromBlock( freeSlot, requirements, allocation );
+    System::Assert( success, "Could not allocate from a new memory block" );
+
+    return allocation;
+}
+
+ae3d::MemoryAllocation ae3d::AllocateAndBindBuffer( VkBuffer buffer, VkMemoryPropertyFlags properties, const char* debugName )
+{
+    VkMemoryRequirements memReqs;
+    vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, buffer, &memReqs );
+
+    MemoryAllocation allocation = AllocateMemory( memReqs, properties, MemoryResource::Buffer, debugName );
+    VkResult err = vkBindBufferMemory( GfxDeviceGlobal::device, buffer, allocation.memory, allocation.offset );
+    AE3D_CHECK_VULKAN( err, "vkBindBufferMemory" );
+
+    return allocation;
+}
+
+ae3d::MemoryAllocation ae3d::AllocateAndBindImage( VkImage image, VkMemoryPropertyFlags properties, MemoryResource resource, const char* debugName )
+{
+    VkMemoryRequirements memReqs;
+    vkGetImageMemoryRequirements( GfxDeviceGlobal::device, image, &memReqs );
+
+    MemoryAllocation allocation = AllocateMemory( memReqs, properties, resource, debugName );
+    VkResult err = vkBindImageMemory( GfxDeviceGlobal::device, image, allocation.memory, allocation.offset );
+    AE3D_CHECK_VULKAN( err, "vkBindImageMemory" );
+
+    return allocation;
+}
+
+void ae3d::FreeMemory( MemoryAllocation& allocation )
+{
+    if (allocation.memory == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    std::lock_guard< std::mutex > lock( MemoryGlobal::mutex );
+
+    if (allocation.block == ~0u)
+    {
+        vkFreeMemory( GfxDeviceGlobal::device, allocation.memory, nullptr );
+
+        const std::uint32_t heapIndex = GfxDeviceGlobal::deviceMemoryProperties.memoryTypes[ allocation.memoryTypeIndex ].heapIndex;
+        MemoryGlobal::dedicatedBytes[ heapIndex ] -= allocation.size;
+        --MemoryGlobal::dedicatedCounts[ heapIndex ];
+
+        allocation = MemoryAllocation();
+        return;
+    }
+
+    MemoryGlobal::Block& block = MemoryGlobal::blocks[ allocation.block ];
+    block.allocator->Free( allocation.range );
+
+    // Empty blocks are freed unless they are the last block of their memory type and resource kind, so allocating and freeing one resource doesn't allocate device memory every time.
+    if (block.allocator->GetFreeSize() == block.allocator->GetSize())
+    {
+        bool hasOtherBlock = false;
+
+        for (unsigned blockIndex = 0; blockIndex < static_cast< unsigned >( MemoryGlobal::blocks.size() ); ++blockIndex)
+        {
+            const MemoryGlobal::Block& other = MemoryGlobal::blocks[ blockIndex ];
+            hasOtherBlock |= blockIndex != allocation.block && other.memory != VK_NULL_HANDLE && other.memoryTypeIndex == block.memoryTypeIndex && other.isImage == block.isImage;
+        }
+
+        if (hasOtherBlock)
+        {
+            vkFreeMemory( GfxDeviceGlobal::device, block.memory, nullptr );
+            block = MemoryGlobal::Block();
+        }
+    }
+
+    allocation = MemoryAllocation();
+}
+
+void ae3d::DestroyMemoryBlocks()
+{
+    std::lock_guard< std::mutex > lock( MemoryGlobal::mutex );
+
+    for (auto& block : MemoryGlobal::blocks)
+    {
+        if (block.memory != VK_NULL_HANDLE)
+        {
+            vkFreeMemory( GfxDeviceGlobal::device, block.memory, nullptr );
+        }
+    }
+
+    MemoryGlobal::blocks.clear();
+}
+
+void ae3d::GetMemoryHeapStatistics( MemoryHeapStatistics* outStatistics )
+{
+    std::lock_guard< std::mutex > lock( MemoryGlobal::mutex );
+
+    for (unsigned heapIndex = 0; heapIndex < VK_MAX_MEMORY_HEAPS; ++heapIndex)
+    {
+        outStatistics[ heapIndex ] = MemoryHeapStatistics();
+        outStatistics[ heapIndex ].usedBytes = MemoryGlobal::dedicatedBytes[ heapIndex ];
+        outStatistics[ heapIndex ].dedicatedCount = MemoryGlobal::dedicatedCounts[ heapIndex ];
+    }
+
+    for (const auto& block : MemoryGlobal::blocks)
+    {
+        if (block.memory == VK_NULL_HANDLE)
+        {
+            continue;
+        }
+
+        MemoryHeapStatistics& heap = outStatistics[ GfxDeviceGlobal::deviceMemoryProperties.memoryTypes[ block.memoryTypeIndex ].heapIndex ];
+        heap.usedBytes += block.allocator->GetSize() - block.allocator->GetFreeSize();
+        heap.freeBytes += block.allocator->GetFreeSize();
+        heap.largestFreeBytes = std::max< VkDeviceSize >( heap.largestFreeBytes, block.allocator->GetLargestFreeSize() );
+        ++heap.blockCount;
+    }
+}
@@ -38,7 +38,8 @@ namespace GfxDeviceGlobal
     extern VkInstance instance;
     extern VkQueue graphicsQueue;
     extern std::uint32_t graphicsQueueIndex;
-    extern VkCommandBuffer currentCmdBuffer;
+    extern thread_local VkCommandBuffer currentCmdBuffer;
+    extern thread_local VkCommandBuffer boundGeometryCmdBuffer;
     extern VkRenderPass renderPass;
 }
 
@@ -46,10 +47,10 @@ struct FramebufferDesc
 {
     VkImage image = VK_NULL_HANDLE;
     VkImageView imageView;
-    VkDeviceMemory deviceMemory;
+    ae3d::MemoryAllocation deviceMemory;
     VkImage depthStencilImage = VK_NULL_HANDLE;
     VkImageView depthStencilImageView;
-    VkDeviceMemory depthStencilDeviceMemory;
+    ae3d::MemoryAllocation depthStencilDeviceMemory;
     VkFramebuffer framebuffer;
     VkRenderPass renderPass;
     VkImageLayout imageLayout;
@@ -144,28 +145,7 @@ bool CreateFrameBuffer( int width, int height, FramebufferDesc& outFramebufferDe
 
     debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)outFramebufferDesc.image, VK_OBJECT_TYPE_IMAGE, debugName );
 
-    VkMemoryRequirements memoryRequirements = {};
-    vkGetImageMemoryRequirements( GfxDeviceGlobal::device, outFramebufferDesc.image, &memoryRequirements );
-
-    VkMemoryAllocateInfo memoryAllocateInfo;
-    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memoryAllocateInfo.pNext = nullptr;
-    memoryAllocateInfo.allocationSize = memoryRequirements.size;
-    memoryAllocateInfo.memoryTypeIndex = GetMemoryType( memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-
-    result = vkAllocateMemory( GfxDeviceGlobal::device, &memoryAllocateInfo, nullptr, &outFramebufferDesc.deviceMemory );
-    if (result != VK_SUCCESS)
-    {
-        System::Print( "Failed to create a framebuffer!\n" );
-        return false;
-    }
-
-    result = vkBindImageMemory( GfxDeviceGlobal::device, outFramebufferDesc.image, outFramebufferDesc.deviceMemory, 0 );
-    if (result != VK_SUCCESS)
-    {
-        System::Print( "Failed to create a framebuffer!\n" );
-        return false;
-    }
+    outFramebufferDesc.deviceMemory = AllocateAndBindImage( outFramebufferDesc.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryResource::RenderTarget, debugName );
 
     VkImageViewCreateInfo imageViewCreateInfo;
     imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -200,24 +180,7 @@ bool CreateFrameBuffer( int width, int height, FramebufferDesc& outFramebufferDe
 
     debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)outFramebufferDesc.image, VK_OBJECT_TYPE_IMAGE, "VR depthstencil" );
 
-    vkGetImageMemoryRequirements( GfxDeviceGlobal::device, outFramebufferDesc.depthStencilImage, &memoryRequirements );
-
-    memoryAllocateInfo.allocationSize = memoryRequirements.size;
-    memoryAllocateInfo.memoryTypeIndex = GetMemoryType( memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-
-    result = vkAllocateMemory( GfxDeviceGlobal::device, &memoryAllocateInfo, nullptr, &outFramebufferDesc.depthStencilDeviceMemory );
-    if (result != VK_SUCCESS)
-    {
-        System::Print( "Failed to create a framebuffer!\n" );
-        return false;
-    }
-
-    result = vkBindImageMemory( GfxDeviceGlobal::device, outFramebufferDesc.depthStencilImage, outFramebufferDesc.depthStencilDeviceMemory, 0 );
-    if (result != VK_SUCCESS)
-    {
-        System::Print( "Failed to create a framebuffer!\n" );
-        return false;
-    }
+    outFramebufferDesc.depthStencilDeviceMemory = AllocateAndBindImage( outFramebufferDesc.depthStencilImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryResource::RenderTarget, "VR depthstencil memory" );
 
     imageViewCreateInfo.image = outFramebufferDesc.depthStencilImage;
     imageViewCreateInfo.format = imageCreateInfo.format;
@@ -458,11 +421,13 @@ void ae3d::VR::Deinit()
     {
         vkDestroyImage( GfxDeviceGlobal::device, Global::leftEyeDesc.image, nullptr );
         vkDestroyImageView( GfxDeviceGlobal::device, Global::leftEyeDesc.imageView, nullptr );
-        vkFreeMemory( GfxDeviceGlobal::device, Global::leftEyeDesc.deviceMemory, nullptr );
+        FreeMemory( Global::leftEyeDesc.deviceMemory );
+        FreeMemory( Global::leftEyeDesc.depthStencilDeviceMemory );
 
         vkDestroyImage( GfxDeviceGlobal::device, Global::rightEyeDesc.image, nullptr );
         vkDestroyImageView( GfxDeviceGlobal::device, Global::rightEyeDesc.imageView, nullptr );
-        vkFreeMemory( GfxDeviceGlobal::device, Global::rightEyeDesc.deviceMemory, nullptr );
+        FreeMemory( Global::rightEyeDesc.deviceMemory );
+        FreeMemory( Global::rightEyeDesc.depthStencilDeviceMemory );
 
         vr::VR_Shutdown();
         Global::hmd = nullptr;
@@ -518,6 +483,7 @@ void ae3d::VR::SubmitFrame()
 
     VkResult err = vkBeginCommandBuffer( GfxDeviceGlobal::currentCmdBuffer, &cmdBufInfo );
     AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer" );
+    GfxDeviceGlobal::boundGeometryCmdBuffer = VK_NULL_HANDLE;
 
     VkCommandBuffer cmdBuffer = GfxDeviceGlobal::currentCmdBuffer;
 
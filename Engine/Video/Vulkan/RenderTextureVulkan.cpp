@@ -6,7 +6,6 @@
 #include "GfxDevice.hpp"
 #include "Macros.hpp"
 #include "System.hpp"
-#include "Statistics.hpp"
 #include "VulkanUtils.hpp"
 
 namespace ae3d
@@ -21,7 +20,7 @@ namespace GfxDeviceGlobal
     extern VkCommandBuffer setupCmdBuffer;
     extern VkFormat colorFormat;
     extern VkFormat depthFormat;
-    extern VkCommandBuffer currentCmdBuffer;
+    extern thread_local VkCommandBuffer currentCmdBuffer;
     extern VkSampleCountFlagBits msaaSampleBits;
 }
 
@@ -30,7 +29,7 @@ namespace RenderTextureGlobal
     std::vector< VkSampler > samplersToReleaseAtExit;
     std::vector< VkImage > imagesToReleaseAtExit;
     std::vector< VkImageView > imageViewsToReleaseAtExit;
-    std::vector< VkDeviceMemory > memoryToReleaseAtExit;
+    std::vector< ae3d::MemoryAllocation > memoryToReleaseAtExit;
     std::vector< VkFramebuffer > fbsToReleaseAtExit;
     std::vector< VkRenderPass > renderPassesToReleaseAtExit;
 }
@@ -54,7 +53,7 @@ void ae3d::RenderTexture::DestroyTextures()
 
     for (std::size_t memoryIndex = 0; memoryIndex < RenderTextureGlobal::memoryToReleaseAtExit.size(); ++memoryIndex)
     {
-        vkFreeMemory( GfxDeviceGlobal::device, RenderTextureGlobal::memoryToReleaseAtExit[ memoryIndex ], nullptr );
+        FreeMemory( RenderTextureGlobal::memoryToReleaseAtExit[ memoryIndex ] );
     }
 
     for (std::size_t fbIndex = 0; fbIndex < RenderTextureGlobal::fbsToReleaseAtExit.size(); ++fbIndex)
@@ -204,22 +203,7 @@ void ae3d::RenderTexture::Create2D( int aWidth, int aHeight, DataType aDataType,
     RenderTextureGlobal::imagesToReleaseAtExit.push_back( color.image );
     debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)color.image, VK_OBJECT_TYPE_IMAGE, debugName );
 
-    VkMemoryRequirements memReqs;
-    vkGetImageMemoryRequirements( GfxDeviceGlobal::device, color.image, &memReqs );
-
-    VkMemoryAllocateInfo memAlloc = {};
-    memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memAlloc.allocationSize = memReqs.size;
-
-    memAlloc.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-    err = vkAllocateMemory( GfxDeviceGlobal::device, &memAlloc, nullptr, &color.mem );
-    AE3D_CHECK_VULKAN( err, "render texture 2d color image memory" );
-    RenderTextureGlobal::memoryToReleaseAtExit.push_back( color.mem );
-    Statistics::IncAllocCalls();
-    Statistics::IncTotalAllocCalls();
-
-    err = vkBindImageMemory( GfxDeviceGlobal::device, color.image, color.mem, 0 );
-    AE3D_CHECK_VULKAN( err, "render texture 2d color image bind memory" );
+    RenderTextureGlobal::memoryToReleaseAtExit.push_back( AllocateAndBindImage( color.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryResource::RenderTarget, debugName ) );
 
     AllocateSetupCommandBuffer();
 
@@ -259,17 +243,7 @@ void ae3d::RenderTexture::Create2D( int aWidth, int aHeight, DataType aDataType,
     RenderTextureGlobal::imagesToReleaseAtExit.push_back( depth.image );
     debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)depth.image, VK_OBJECT_TYPE_IMAGE, "render texture 2d depth" );
 
-    vkGetImageMemoryRequirements( GfxDeviceGlobal::device, depth.image, &memReqs );
-    memAlloc.allocationSize = memReqs.size;
-    memAlloc.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-    err = vkAllocateMemory( GfxDeviceGlobal::device, &memAlloc, nullptr, &depth.mem );
-    AE3D_CHECK_VULKAN( err, "render texture 2d depth memory" );
-    RenderTextureGlobal::memoryToReleaseAtExit.push_back( depth.mem );
-    Statistics::IncAllocCalls();
-    Statistics::IncTotalAllocCalls();
-
-    err = vkBindImageMemory( GfxDeviceGlobal::device, depth.image, depth.mem, 0 );
-    AE3D_CHECK_VULKAN( err, "render texture 2d depth bind" );
+    RenderTextureGlobal::memoryToReleaseAtExit.push_back( AllocateAndBindImage( depth.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryResource::RenderTarget, "render texture 2d depth memory" ) );
 
     SetImageLayout( GfxDeviceGlobal::setupCmdBuffer,
         depth.image,
@@ -361,19 +335,7 @@ void ae3d::RenderTexture::CreateCube( int aDimension, DataType aDataType, Textur
     RenderTextureGlobal::imagesToReleaseAtExit.push_back( color.image );
     debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)color.image, VK_OBJECT_TYPE_IMAGE, debugName );
 
-    VkMemoryRequirements memReqs;
-    vkGetImageMemoryRequirements( GfxDeviceGlobal::device, color.image, &memReqs );
-
-    VkMemoryAllocateInfo memAllocInfo = {};
-    memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memAllocInfo.allocationSize = memReqs.size;
-    memAllocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-    err = vkAllocateMemory( GfxDeviceGlobal::device, &memAllocInfo, nullptr, &color.mem );
-    AE3D_CHECK_VULKAN( err, "vkAllocateMemory in RenderTextureCube" );
-    RenderTextureGlobal::memoryToReleaseAtExit.push_back( color.mem );
-
-    err = vkBindImageMemory( GfxDeviceGlobal::device, color.image, color.mem, 0 );
-    AE3D_CHECK_VULKAN( err, "vkBindImageMemory in RenderTextureCube" );
+    RenderTextureGlobal::memoryToReleaseAtExit.push_back( AllocateAndBindImage( color.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryResource::RenderTarget, debugName ) );
 
     AllocateSetupCommandBuffer();
 
@@ -425,21 +387,7 @@ void ae3d::RenderTexture::CreateCube( int aDimension, DataType aDataType, Textur
     RenderTextureGlobal::imagesToReleaseAtExit.push_back( depth.image );
     debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)depth.image, VK_OBJECT_TYPE_IMAGE, "render texture cube depth" );
 
-    vkGetImageMemoryRequirements( GfxDeviceGlobal::device, depth.image, &memReqs );
-
-    VkMemoryAllocateInfo memAlloc = {};
-    memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memAlloc.allocationSize = memReqs.size;
-    
-    memAlloc.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-    err = vkAllocateMemory( GfxDeviceGlobal::device, &memAlloc, nullptr, &depth.mem );
-    AE3D_CHECK_VULKAN( err, "render texture cube depth memory" );
-    RenderTextureGlobal::memoryToReleaseAtExit.push_back( depth.mem );
-    Statistics::IncAllocCalls();
-    Statistics::IncTotalAllocCalls();
-
-    err = vkBindImageMemory( GfxDeviceGlobal::device, depth.image, depth.mem, 0 );
-    AE3D_CHECK_VULKAN( err, "render texture cube depth bind" );
+    RenderTextureGlobal::memoryToReleaseAtExit.push_back( AllocateAndBindImage( depth.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryResource::RenderTarget, "render texture cube depth memory" ) );
 
     SetImageLayout( GfxDeviceGlobal::setupCmdBuffer,
         depth.image,
@@ -493,7 +441,8 @@ void ae3d::RenderTexture::CreateRenderPass()
     attachments[ 1 ].format = GfxDeviceGlobal::depthFormat;
     attachments[ 1 ].samples = attachments[ 0 ].samples;
     attachments[ 1 ].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    attachments[ 1 ].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    // Stored, so loadRenderPass can continue the render pass.
+    attachments[ 1 ].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     attachments[ 1 ].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     attachments[ 1 ].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     attachments[ 1 ].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -534,4 +483,17 @@ void ae3d::RenderTexture::CreateRenderPass()
     debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)renderPass, VK_OBJECT_TYPE_RENDER_PASS, "renderpass cube" );
 
     RenderTextureGlobal::renderPassesToReleaseAtExit.push_back( renderPass );
+
+    // Starts in the layouts that renderPass ends in.
+    attachments[ 0 ].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[ 0 ].initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    attachments[ 1 ].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[ 1 ].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    err = vkCreateRenderPass( GfxDeviceGlobal::device, &renderPassInfo, nullptr, &loadRenderPass );
+    AE3D_CHECK_VULKAN( err, "RenderTexture vkCreateRenderPass load" );
+
+    debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)loadRenderPass, VK_OBJECT_TYPE_RENDER_PASS, "renderpass load" );
+
+    RenderTextureGlobal::renderPassesToReleaseAtExit.push_back( loadRenderPass );
 }
@@ -10,6 +10,8 @@ void ae3d::BuiltinShaders::Load()
     skyboxShader.LoadSPIRV( FileSystem::FileContents( "skybox_vert.spv" ), FileSystem::FileContents( "skybox_frag.spv" ) );
     momentsShader.LoadSPIRV( FileSystem::FileContents( "moments_vert.spv" ), FileSystem::FileContents( "moments_frag.spv" ) );
     momentsSkinShader.LoadSPIRV( FileSystem::FileContents( "moments_skin_vert.spv" ), FileSystem::FileContents( "moments_frag.spv" ) );
+    momentsInstancedShader.LoadSPIRV( FileSystem::FileContents( "moments_instanced_vert.spv" ), FileSystem::FileContents( "moments_frag.spv" ) );
     depthNormalsShader.LoadSPIRV( FileSystem::FileContents( "depthnormals_vert.spv" ), FileSystem::FileContents( "depthnormals_frag.spv" ) );
+    depthNormalsInstancedShader.LoadSPIRV( FileSystem::FileContents( "depthnormals_instanced_vert.spv" ), FileSystem::FileContents( "depthnormals_frag.spv" ) );
     uiShader.LoadSPIRV( FileSystem::FileContents( "sprite_vert.spv" ), FileSystem::FileContents( "sprite_frag.spv" ) );
 }
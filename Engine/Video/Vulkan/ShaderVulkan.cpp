@@ -22,9 +22,9 @@ constexpr int MaxModuleCount = 600;
 namespace GfxDeviceGlobal
 {
     extern VkDevice device;
-    extern VkImageView boundViews[ 13 ];
-    extern VkSampler boundSamplers[ 2 ];
-	extern PerObjectUboStruct perObjectUboStruct;
+    extern thread_local VkImageView boundViews[ 13 ];
+    extern thread_local VkSampler boundSamplers[ 2 ];
+	extern thread_local PerObjectUboStruct perObjectUboStruct;
     extern VkCommandBuffer texCmdBuffer;
     extern ae3d::RenderTexture* renderTexture0;
 }
@@ -176,13 +176,13 @@ void ae3d::Shader::Load( const char* /*metalVertexShaderName*/, const char* /*me
 void ae3d::Shader::Use()
 {
     System::Assert( IsValid(), "no valid shader" );
-    GfxDevice::GetNewUniformBuffer();
 }
 
 void ae3d::Shader::SetUniform( int offset, void* data, int dataBytes )
 {
-    System::Assert( GfxDevice::GetCurrentUbo() != nullptr, "null ubo" );
-    std::memcpy( &GfxDevice::GetCurrentUbo()[ offset ], data, dataBytes );
+    // Draws copy perObjectUboStruct's changed blocks into the frame's uniform ring.
+    System::Assert( offset >= 0 && offset + dataBytes <= (int)sizeof( PerObjectUboStruct::Object ), "uniform does not fit into the object block" );
+    std::memcpy( reinterpret_cast< std::uint8_t* >( &GfxDeviceGlobal::perObjectUboStruct.object ) + offset, data, dataBytes );
 }
 
 void ae3d::Shader::SetTexture( Texture2D* texture, int textureUnit )
@@ -194,7 +194,7 @@ void ae3d::Shader::SetTexture( Texture2D* texture, int textureUnit )
     
     if (textureUnit == 0)
     {
-		GfxDeviceGlobal::perObjectUboStruct.tex0scaleOffset = texture->GetScaleOffset();
+		GfxDeviceGlobal::perObjectUboStruct.material.tex0scaleOffset = texture->GetScaleOffset();
         GfxDeviceGlobal::boundViews[ 0 ] = texture->GetView();
         GfxDeviceGlobal::boundSamplers[ 0 ] = texture->GetSampler();
     }
@@ -11,9 +11,9 @@
 #include "Array.hpp"
 #include "DDSLoader.hpp"
 #include "FileSystem.hpp"
+#include "GfxDevice.hpp"
 #include "Macros.hpp"
 #include "System.hpp"
-#include "Statistics.hpp"
 #include "VulkanUtils.hpp"
 
 bool HasStbExtension( const std::string& path ); // Defined in TextureCommon.cpp
@@ -42,7 +42,7 @@ namespace Texture2DGlobal
     std::vector< VkSampler > samplersToReleaseAtExit;
     std::vector< VkImage > imagesToReleaseAtExit;
     std::vector< VkImageView > imageViewsToReleaseAtExit;
-    std::vector< VkDeviceMemory > memoryToReleaseAtExit;
+    std::vector< ae3d::MemoryAllocation > memoryToReleaseAtExit;
 }
 
 void ae3d::Texture2D::DestroyTextures()
@@ -64,7 +64,7 @@ void ae3d::Texture2D::DestroyTextures()
 
     for (std::size_t memoryIndex = 0; memoryIndex < Texture2DGlobal::memoryToReleaseAtExit.size(); ++memoryIndex)
     {
-        vkFreeMemory( GfxDeviceGlobal::device, Texture2DGlobal::memoryToReleaseAtExit[ memoryIndex ], nullptr );
+        FreeMemory( Texture2DGlobal::memoryToReleaseAtExit[ memoryIndex ] );
     }
 }
 
@@ -145,26 +145,10 @@ void ae3d::Texture2D::CreateVulkanObjects( const DDSLoader::Output& mipChain, Vk
     AE3D_CHECK_VULKAN( err, "vkCreateImage" );
     Texture2DGlobal::imagesToReleaseAtExit.push_back( image );
 
-    VkMemoryRequirements memReqs = {};
-    vkGetImageMemoryRequirements( GfxDeviceGlobal::device, image, &memReqs );
-
-    VkMemoryAllocateInfo memAllocInfo = {};
-    memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memAllocInfo.allocationSize = memReqs.size;
-    memAllocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-
-    err = vkAllocateMemory( GfxDeviceGlobal::device, &memAllocInfo, nullptr, &deviceMemory );
-    AE3D_CHECK_VULKAN( err, "vkAllocateMemory" );
-    Statistics::IncAllocCalls();
-    Statistics::IncTotalAllocCalls();
-    Texture2DGlobal::memoryToReleaseAtExit.push_back( deviceMemory );
-	debug::SetObjectName( GfxDeviceGlobal::device, ( std::uint64_t )deviceMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "tex2d dds memory" );
-
-    err = vkBindImageMemory( GfxDeviceGlobal::device, image, deviceMemory, 0 );
-    AE3D_CHECK_VULKAN( err, "vkBindImageMemory" );
+    Texture2DGlobal::memoryToReleaseAtExit.push_back( AllocateAndBindImage( image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryResource::Image, "tex2d dds memory" ) );
 
     Array< VkBuffer > stagingBuffers( mipLevelCount );
-    Array< VkDeviceMemory > stagingMemory( mipLevelCount );
+    Array< MemoryAllocation > stagingMemory( mipLevelCount );
     
     for (int mipIndex = 0; mipIndex < mipLevelCount; ++mipIndex)
     {
@@ -189,21 +173,9 @@ void ae3d::Texture2D::CreateVulkanObjects( const DDSLoader::Output& mipChain, Vk
         AE3D_CHECK_VULKAN( err, "vkCreateBuffer staging" );
         debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)stagingBuffers[ mipIndex ], VK_OBJECT_TYPE_BUFFER, "stagingBuffer2D" );
 
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, stagingBuffers[ mipIndex ], &memReqs );
-
-        memAllocInfo.allocationSize = memReqs.size;
-        memAllocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT );
+        stagingMemory[ mipIndex ] = AllocateAndBindBuffer( stagingBuffers[ mipIndex ], VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, "stagingBuffer2D memory" );
 
-		err = vkAllocateMemory( GfxDeviceGlobal::device, &memAllocInfo, nullptr, &stagingMemory[ mipIndex ] );
-		AE3D_CHECK_VULKAN( err, "vkAllocateMemory" );
-		debug::SetObjectName( GfxDeviceGlobal::device, ( std::uint64_t )deviceMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "tex2d memory" );
-
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, stagingBuffers[ mipIndex ], stagingMemory[ mipIndex ], 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory staging" );
-
-        void* stagingData;
-        err = vkMapMemory( GfxDeviceGlobal::device, stagingMemory[ mipIndex ], 0, memReqs.size, 0, &stagingData );
-        AE3D_CHECK_VULKAN( err, "vkMapMemory in Texture2D" );
+        void* stagingData = stagingMemory[ mipIndex ].mappedData;
         VkDeviceSize amountToCopy = imageSize;
         if (mipChain.dataOffsets[ mipIndex ] + imageSize >= (unsigned)mipChain.imageData.count)
         {
@@ -214,12 +186,10 @@ void ae3d::Texture2D::CreateVulkanObjects( const DDSLoader::Output& mipChain, Vk
 
         VkMappedMemoryRange flushRange = {};
         flushRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        flushRange.memory = stagingMemory[ mipIndex ];
-        flushRange.offset = 0;
-        flushRange.size = VK_WHOLE_SIZE;
+        flushRange.memory = stagingMemory[ mipIndex ].memory;
+        flushRange.offset = stagingMemory[ mipIndex ].offset;
+        flushRange.size = stagingMemory[ mipIndex ].size;
         vkFlushMappedMemoryRanges( GfxDeviceGlobal::device, 1, &flushRange );
-
-        vkUnmapMemory( GfxDeviceGlobal::device, stagingMemory[ mipIndex ] );
     }
 
     VkImageViewCreateInfo viewInfo = {};
@@ -338,7 +308,7 @@ void ae3d::Texture2D::CreateVulkanObjects( const DDSLoader::Output& mipChain, Vk
     for (int mipLevel = 0; mipLevel < mipLevelCount; ++mipLevel)
     {
         vkDestroyBuffer( GfxDeviceGlobal::device, stagingBuffers[ mipLevel ], nullptr );
-        vkFreeMemory( GfxDeviceGlobal::device, stagingMemory[ mipLevel ], nullptr );
+        FreeMemory( stagingMemory[ mipLevel ] );
     }
     
     VkSamplerCreateInfo samplerInfo = {};
@@ -370,6 +340,9 @@ void ae3d::Texture2D::CreateUAV( int aWidth, int aHeight, const char* debugName
 
 void ae3d::Texture2D::SetLayout( TextureLayout aLayout )
 {
+    // Compute work that was recorded to the frame's command buffer must execute before the transition.
+    GfxDevice::FlushOffscreenPasses();
+
     VkCommandBufferBeginInfo cmdBufInfo = {};
     cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     cmdBufInfo.pInheritanceInfo = nullptr;
@@ -428,23 +401,7 @@ void ae3d::Texture2D::CreateVulkanObjects( void* data, int bytesPerPixel, VkForm
     AE3D_CHECK_VULKAN( err, "vkCreateImage" );
     Texture2DGlobal::imagesToReleaseAtExit.push_back( image );
 
-    VkMemoryRequirements memReqs = {};
-    vkGetImageMemoryRequirements( GfxDeviceGlobal::device, image, &memReqs );
-
-    VkMemoryAllocateInfo memAllocInfo = {};
-    memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memAllocInfo.allocationSize = memReqs.size;
-    memAllocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-
-    err = vkAllocateMemory( GfxDeviceGlobal::device, &memAllocInfo, nullptr, &deviceMemory );
-    AE3D_CHECK_VULKAN( err, "vkAllocateMemory" );
-    Statistics::IncAllocCalls();
-    Statistics::IncTotalAllocCalls();
-    Texture2DGlobal::memoryToReleaseAtExit.push_back( deviceMemory );
-	debug::SetObjectName( GfxDeviceGlobal::device, ( std::uint64_t )deviceMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "tex2d memory" );
-
-    err = vkBindImageMemory( GfxDeviceGlobal::device, image, deviceMemory, 0 );
-    AE3D_CHECK_VULKAN( err, "vkBindImageMemory" );
+    Texture2DGlobal::memoryToReleaseAtExit.push_back( AllocateAndBindImage( image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryResource::Image, "tex2d memory" ) );
 
     VkBuffer stagingBuffer = VK_NULL_HANDLE;
 
@@ -459,20 +416,8 @@ void ae3d::Texture2D::CreateVulkanObjects( void* data, int bytesPerPixel, VkForm
     AE3D_CHECK_VULKAN( err, "vkCreateBuffer staging" );
     debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)stagingBuffer, VK_OBJECT_TYPE_BUFFER, "staging2D" );
 
-    vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, stagingBuffer, &memReqs );
-
-    memAllocInfo.allocationSize = memReqs.size;
-    memAllocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT );
-    VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
-    err = vkAllocateMemory( GfxDeviceGlobal::device, &memAllocInfo, nullptr, &stagingMemory );
-    AE3D_CHECK_VULKAN( err, "vkAllocateMemory" );
-
-    err = vkBindBufferMemory( GfxDeviceGlobal::device, stagingBuffer, stagingMemory, 0 );
-    AE3D_CHECK_VULKAN( err, "vkBindBufferMemory staging" );
-
-    void* stagingData;
-    err = vkMapMemory( GfxDeviceGlobal::device, stagingMemory, 0, memReqs.size, 0, &stagingData );
-    AE3D_CHECK_VULKAN( err, "vkMapMemory in Texture2D" );
+    MemoryAllocation stagingMemory = AllocateAndBindBuffer( stagingBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, "staging2D memory" );
+    void* stagingData = stagingMemory.mappedData;
     
     if (data)
     {
@@ -481,13 +426,11 @@ void ae3d::Texture2D::CreateVulkanObjects( void* data, int bytesPerPixel, VkForm
 
     VkMappedMemoryRange flushRange = {};
     flushRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-    flushRange.memory = stagingMemory;
-    flushRange.offset = 0;
-    flushRange.size = VK_WHOLE_SIZE;
+    flushRange.memory = stagingMemory.memory;
+    flushRange.offset = stagingMemory.offset;
+    flushRange.size = stagingMemory.size;
     vkFlushMappedMemoryRanges( GfxDeviceGlobal::device, 1, &flushRange );
 
-    vkUnmapMemory( GfxDeviceGlobal::device, stagingMemory );
-
     VkImageViewCreateInfo viewInfo = {};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
@@ -645,8 +588,8 @@ void ae3d::Texture2D::CreateVulkanObjects( void* data, int bytesPerPixel, VkForm
     AE3D_CHECK_VULKAN( err, "vkQueueSubmit in Texture2D" );
 
     vkDeviceWaitIdle( GfxDeviceGlobal::device );
-    vkFreeMemory( GfxDeviceGlobal::device, stagingMemory, nullptr );
     vkDestroyBuffer( GfxDeviceGlobal::device, stagingBuffer, nullptr );
+    FreeMemory( stagingMemory );
 
     VkSamplerCreateInfo samplerInfo = {};
     samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
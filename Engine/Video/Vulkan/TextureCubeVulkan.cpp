@@ -6,9 +6,9 @@
 #include "stb_image.c"
 #include "DDSLoader.hpp"
 #include "FileSystem.hpp"
+#include "JobSystem.hpp"
 #include "Macros.hpp"
 #include "System.hpp"
-#include "Statistics.hpp"
 #include "VulkanUtils.hpp"
 
 bool HasStbExtension( const std::string& path ); // Defined in TextureCommon.cpp
@@ -36,7 +36,7 @@ namespace TextureCubeGlobal
     std::vector< VkSampler > samplersToReleaseAtExit;
     std::vector< VkImage > imagesToReleaseAtExit;
     std::vector< VkImageView > imageViewsToReleaseAtExit;
-    std::vector< VkDeviceMemory > memoryToReleaseAtExit;
+    std::vector< ae3d::MemoryAllocation > memoryToReleaseAtExit;
     std::vector< VkBuffer > buffersToReleaseAtExit;
 }
 
@@ -59,7 +59,7 @@ void ae3d::TextureCube::DestroyTextures()
 
     for (std::size_t memoryIndex = 0; memoryIndex < TextureCubeGlobal::memoryToReleaseAtExit.size(); ++memoryIndex)
     {
-        vkFreeMemory( GfxDeviceGlobal::device, TextureCubeGlobal::memoryToReleaseAtExit[ memoryIndex ], nullptr );
+        FreeMemory( TextureCubeGlobal::memoryToReleaseAtExit[ memoryIndex ] );
     }
 
     for (std::size_t bufferIndex = 0; bufferIndex < TextureCubeGlobal::buffersToReleaseAtExit.size(); ++bufferIndex)
@@ -160,9 +160,42 @@ void ae3d::TextureCube::Load( const FileSystem::FileContentsData& negX, const Fi
     const std::string paths[] = { posX.path, negX.path, negY.path, posY.path, negZ.path, posZ.path };
     const std::vector< unsigned char >* datas[] = { &posX.data, &negX.data, &negY.data, &posY.data, &negZ.data, &posZ.data };
 
+    // Decodes stb faces in parallel up front, the loop below then only validates and uploads.
+    unsigned char* decodedFaces[ 6 ] = {};
+    int faceWidths[ 6 ] = {};
+    int faceHeights[ 6 ] = {};
+    int faceComponents[ 6 ] = {};
+    // stb_image's failure reason is thread-local, so it's read on the thread that decoded the face.
+    const char* faceFailureReasons[ 6 ] = {};
+
+    JobSystem::ParallelFor( 6, 1, [&]( unsigned begin, unsigned end )
+    {
+        for (unsigned face = begin; face < end; ++face)
+        {
+            if (HasStbExtension( paths[ face ] ))
+            {
+                decodedFaces[ face ] = stbi_load_from_memory( datas[ face ]->data(), static_cast< int >( datas[ face ]->size() ), &faceWidths[ face ], &faceHeights[ face ], &faceComponents[ face ], 4 );
+
+                if (decodedFaces[ face ] == nullptr)
+                {
+                    faceFailureReasons[ face ] = stbi_failure_reason();
+                }
+            }
+        }
+    } );
+
+    auto freeDecodedFaces = [&]()
+    {
+        for (int face = 0; face < 6; ++face)
+        {
+            stbi_image_free( decodedFaces[ face ] );
+            decodedFaces[ face ] = nullptr;
+        }
+    };
+
     VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;    
     VkBuffer buffers[ 6 ];
-    VkDeviceMemory deviceMemories[ 6 ];
+    MemoryAllocation deviceMemories[ 6 ];
 
     VkCommandBufferBeginInfo cmdBufInfo = {};
     cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -179,13 +212,16 @@ void ae3d::TextureCube::Load( const FileSystem::FileContentsData& negX, const Fi
 
         if (HasStbExtension( paths[ face ] ))
         {
-            int components;
-            unsigned char* data = stbi_load_from_memory( datas[ face ]->data(), static_cast<int>(datas[ face ]->size()), &width, &height, &components, 4 );
+            unsigned char* data = decodedFaces[ face ];
+            width = faceWidths[ face ];
+            height = faceHeights[ face ];
+            const int components = faceComponents[ face ];
 
             if (data == nullptr)
             {
-                const std::string reason( stbi_failure_reason() );
+                const std::string reason( faceFailureReasons[ face ] != nullptr ? faceFailureReasons[ face ] : "unknown" );
                 System::Print( "%s failed to load. stb_image's reason: %s\n", paths[ face ].c_str(), reason.c_str() );
+                freeDecodedFaces();
                 return;
             }
 
@@ -211,33 +247,15 @@ void ae3d::TextureCube::Load( const FileSystem::FileContentsData& negX, const Fi
 
             TextureCubeGlobal::buffersToReleaseAtExit.push_back( buffers[ face ] );
 
-            VkMemoryRequirements memReqs;
-            vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, buffers[ face ], &memReqs );
-            VkMemoryAllocateInfo memAllocInfo = {};
-            memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-            memAllocInfo.pNext = nullptr;
-            memAllocInfo.allocationSize = memReqs.size;
-            memAllocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT );
-
-            err = vkAllocateMemory( GfxDeviceGlobal::device, &memAllocInfo, nullptr, &deviceMemories[ face ] );
-            AE3D_CHECK_VULKAN( err, "vkAllocateMemory in TextureCube" );
+            deviceMemories[ face ] = AllocateAndBindBuffer( buffers[ face ], VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, "cubemap memory" );
             TextureCubeGlobal::memoryToReleaseAtExit.push_back( deviceMemories[ face ] );
-            Statistics::IncAllocCalls();
-            Statistics::IncTotalAllocCalls();
-
-			debug::SetObjectName( GfxDeviceGlobal::device, ( std::uint64_t )deviceMemories[ face ], VK_OBJECT_TYPE_DEVICE_MEMORY, "cubemap memory" );
-
-            err = vkBindBufferMemory( GfxDeviceGlobal::device, buffers[ face ], deviceMemories[ face ], 0 );
-            AE3D_CHECK_VULKAN( err, "vkBindBufferMemory in TextureCube" );
 
             VkImageSubresource subRes = {};
             subRes.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
             subRes.mipLevel = 0;
             subRes.arrayLayer = 0;
 
-            void* mapped;
-            err = vkMapMemory( GfxDeviceGlobal::device, deviceMemories[ face ], 0, memReqs.size, 0, &mapped );
-            AE3D_CHECK_VULKAN( err, "vkMapMemory in TextureCube" );
+            void* mapped = deviceMemories[ face ].mappedData;
 
             const int bytesPerPixel = 4;
 
@@ -262,14 +280,13 @@ void ae3d::TextureCube::Load( const FileSystem::FileContentsData& negX, const Fi
 
             VkMappedMemoryRange flushRange = {};
             flushRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-            flushRange.memory = deviceMemories[ face ];
-            flushRange.offset = 0;
-            flushRange.size = GetMemoryUsage( width, height, format );
+            flushRange.memory = deviceMemories[ face ].memory;
+            flushRange.offset = deviceMemories[ face ].offset;
+            flushRange.size = deviceMemories[ face ].size;
             vkFlushMappedMemoryRanges( GfxDeviceGlobal::device, 1, &flushRange );
 
-            vkUnmapMemory( GfxDeviceGlobal::device, deviceMemories[ face ] );
-
             stbi_image_free( data );
+            decodedFaces[ face ] = nullptr;
         }
         else if (isDDS && GfxDeviceGlobal::deviceFeatures.textureCompressionBC)
         {
@@ -280,6 +297,7 @@ void ae3d::TextureCube::Load( const FileSystem::FileContentsData& negX, const Fi
             if (loadResult != DDSLoader::LoadResult::Success)
             {
                 ae3d::System::Print( "DDS Loader could not load %s", paths[ face ].c_str() );
+                freeDecodedFaces();
                 return;
             }
 
@@ -350,44 +368,24 @@ void ae3d::TextureCube::Load( const FileSystem::FileContentsData& negX, const Fi
 
             TextureCubeGlobal::buffersToReleaseAtExit.push_back( buffers[ face ] );
 
-            VkMemoryRequirements memReqs;
-            vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, buffers[ face ], &memReqs );
-
-            VkMemoryAllocateInfo memAllocInfo = {};
-            memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-            memAllocInfo.pNext = nullptr;
-            memAllocInfo.allocationSize = memReqs.size;
-            memAllocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT );
-
-            err = vkAllocateMemory( GfxDeviceGlobal::device, &memAllocInfo, nullptr, &deviceMemories[ face ] );
-            AE3D_CHECK_VULKAN( err, "vkAllocateMemory in TextureCube" );
+            deviceMemories[ face ] = AllocateAndBindBuffer( buffers[ face ], VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, "cubemap dds memory" );
             TextureCubeGlobal::memoryToReleaseAtExit.push_back( deviceMemories[ face ] );
-			debug::SetObjectName( GfxDeviceGlobal::device, ( std::uint64_t )deviceMemories[ face ], VK_OBJECT_TYPE_DEVICE_MEMORY, "cubemap dds memory" );
-            Statistics::IncAllocCalls();
-            Statistics::IncTotalAllocCalls();
-
-            err = vkBindBufferMemory( GfxDeviceGlobal::device, buffers[ face ], deviceMemories[ face ], 0 );
-            AE3D_CHECK_VULKAN( err, "vkBindBufferMemory in TextureCube" );
 
             VkImageSubresource subRes = {};
             subRes.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
             subRes.mipLevel = 0;
             subRes.arrayLayer = 0;
 
-            void* mapped;
-            err = vkMapMemory( GfxDeviceGlobal::device, deviceMemories[ face ], 0, memReqs.size, 0, &mapped );
-            AE3D_CHECK_VULKAN( err, "vkMapMemory in TextureCube" );
+            void* mapped = deviceMemories[ face ].mappedData;
 
             std::memcpy( mapped, &ddsOutput[ face ].imageData[ ddsOutput[ face ].dataOffsets[ 0 ] ], GetMemoryUsage( width, height, format ) );
                 
             VkMappedMemoryRange flushRange = {};
             flushRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-            flushRange.memory = deviceMemories[ face ];
-            flushRange.offset = 0;
-            flushRange.size = memReqs.size;
+            flushRange.memory = deviceMemories[ face ].memory;
+            flushRange.offset = deviceMemories[ face ].offset;
+            flushRange.size = deviceMemories[ face ].size;
             vkFlushMappedMemoryRanges( GfxDeviceGlobal::device, 1, &flushRange );
-
-            vkUnmapMemory( GfxDeviceGlobal::device, deviceMemories[ face ] );
         }
         else
         {
@@ -415,24 +413,7 @@ void ae3d::TextureCube::Load( const FileSystem::FileContentsData& negX, const Fi
     TextureCubeGlobal::imagesToReleaseAtExit.push_back( image );
     debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)image, VK_OBJECT_TYPE_IMAGE, paths[ 0 ].c_str() );
 
-    VkMemoryRequirements memReqs;
-    vkGetImageMemoryRequirements( GfxDeviceGlobal::device, image, &memReqs );
-    
-    VkMemoryAllocateInfo memAllocInfo = {};
-    memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memAllocInfo.pNext = nullptr;
-    memAllocInfo.allocationSize = memReqs.size;
-    memAllocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-    
-    err = vkAllocateMemory( GfxDeviceGlobal::device, &memAllocInfo, nullptr, &deviceMemory );
-    AE3D_CHECK_VULKAN( err, "vkAllocateMemory in TextureCube" );
-    TextureCubeGlobal::memoryToReleaseAtExit.push_back( deviceMemory );
-	debug::SetObjectName( GfxDeviceGlobal::device, ( std::uint64_t )deviceMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "cubemap memory" );
-    Statistics::IncAllocCalls();
-    Statistics::IncTotalAllocCalls();
-
-    err = vkBindImageMemory( GfxDeviceGlobal::device, image, deviceMemory, 0 );
-    AE3D_CHECK_VULKAN( err, "vkBindImageMemory in TextureCube" );
+    TextureCubeGlobal::memoryToReleaseAtExit.push_back( AllocateAndBindImage( image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryResource::Image, "cubemap memory" ) );
 
     SetImageLayout( GfxDeviceGlobal::texCmdBuffer,
         image,
@@ -537,7 +518,7 @@ void ae3d::TextureCube::Load( const FileSystem::FileContentsData& negX, const Fi
     for (int face = 0; face < 6; ++face)
     {
         Array< VkBuffer > stagingBuffers( mipLevelCount );
-        Array< VkDeviceMemory > stagingMemory( mipLevelCount );
+        Array< MemoryAllocation > stagingMemory( mipLevelCount );
         
         for (int mipLevel = 1; mipLevel < mipLevelCount; ++mipLevel)
         {
@@ -566,20 +547,10 @@ void ae3d::TextureCube::Load( const FileSystem::FileContentsData& negX, const Fi
 
                 TextureCubeGlobal::buffersToReleaseAtExit.push_back( stagingBuffers[ mipLevel ] );
 
-                vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, stagingBuffers[ mipLevel ], &memReqs );
-
-                memAllocInfo.allocationSize = memReqs.size;
-                memAllocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT );
-                err = vkAllocateMemory( GfxDeviceGlobal::device, &memAllocInfo, nullptr, &stagingMemory[ mipLevel ] );
-                AE3D_CHECK_VULKAN( err, "vkAllocateMemory" );
+                stagingMemory[ mipLevel ] = AllocateAndBindBuffer( stagingBuffers[ mipLevel ], VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, "stagingDDSCube memory" );
                 TextureCubeGlobal::memoryToReleaseAtExit.push_back( stagingMemory[ mipLevel ] );
 
-                err = vkBindBufferMemory( GfxDeviceGlobal::device, stagingBuffers[ mipLevel ], stagingMemory[ mipLevel ], 0 );
-                AE3D_CHECK_VULKAN( err, "vkBindBufferMemory staging" );
-
-                void* stagingData;
-                err = vkMapMemory( GfxDeviceGlobal::device, stagingMemory[ mipLevel ], 0, memReqs.size, 0, &stagingData );
-                AE3D_CHECK_VULKAN( err, "vkMapMemory in Texture2D" );
+                void* stagingData = stagingMemory[ mipLevel ].mappedData;
 
                 VkDeviceSize amountToCopy = imageSize;
                 if (ddsOutput[ face ].dataOffsets[ mipLevel ] + imageSize >= ddsOutput[ face ].imageData.count)
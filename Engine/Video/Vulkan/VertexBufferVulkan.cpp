@@ -1,27 +1,205 @@
 // This is an independent project of an individual developer. Dear PVS-Studio, please check it.
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 #include "VertexBuffer.hpp"
+#include <algorithm>
 #include <vector>
 #include <cstring>
 #include <cstdint>
+#include <utility>
 #include "Array.hpp"
 #include "Macros.hpp"
-#include "Statistics.hpp"
 #include "System.hpp"
 #include "VulkanUtils.hpp"
 
 namespace GfxDeviceGlobal
 {
     extern VkDevice device;
-    extern Array< VkBuffer > pendingFreeVBs;
     extern VkCommandPool cmdPool;
     extern VkQueue graphicsQueue;
+    extern unsigned frameIndex;
 }
 
+void CopyBuffer( VkBuffer source, VkBuffer& destination, int bufferSize, VkDeviceSize destinationOffset );
+void CreateBuffer( VkBuffer& buffer, int bufferSize, ae3d::MemoryAllocation& memory, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryFlags, const char* debugName );
+
 namespace VertexBufferGlobal
 {
     std::vector< VkBuffer > buffersToReleaseAtExit;
-    std::vector< VkDeviceMemory > memoryToReleaseAtExit;
+    std::vector< ae3d::MemoryAllocation > memoryToReleaseAtExit;
+
+    /// Device-local buffer that geometry is suballocated from.
+    struct ArenaPage
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        ae3d::MemoryAllocation memory;
+        /// Unused ranges as (offset, count) in elements, sorted by offset.
+        std::vector< std::pair< std::uint32_t, std::uint32_t > > freeRanges;
+    };
+
+    /// Suballocates geometry with one element size from a few large pages, so meshes don't need their own allocations
+    /// and draws of different meshes can share bound buffers.
+    struct GeometryArena
+    {
+        GeometryArena( std::uint32_t aElementSize, std::uint32_t aPageElementCount, VkBufferUsageFlags aUsage, const char* aDebugName )
+            : elementSize( aElementSize )
+            , pageElementCount( aPageElementCount )
+            , usage( aUsage )
+            , debugName( aDebugName )
+        {}
+
+        std::uint32_t elementSize;
+        std::uint32_t pageElementCount;
+        VkBufferUsageFlags usage;
+        const char* debugName;
+        std::vector< ArenaPage > pages;
+    };
+
+    // Generate() converts PTC and PTN into PTNTC, so these are all the vertex formats in device-local memory.
+    GeometryArena verticesPTNTC( sizeof( ae3d::VertexBuffer::VertexPTNTC ), 256 * 1024, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, "vertex arena PTNTC" );
+    GeometryArena verticesPTNTC_Skinned( sizeof( ae3d::VertexBuffer::VertexPTNTC_Skinned ), 128 * 1024, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, "vertex arena PTNTC_Skinned" );
+    GeometryArena indices( sizeof( ae3d::VertexBuffer::Face ) / 3, 4 * 1024 * 1024, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, "index arena" );
+
+    /// Range that is returned to its arena after in-flight command buffers have finished using it.
+    struct PendingFree
+    {
+        VkBuffer buffer;
+        std::uint32_t offset;
+        std::uint32_t count;
+    };
+
+    /// Indexed by the frame that freed the ranges.
+    std::vector< PendingFree > pendingFrees[ MAX_FRAMES_IN_FLIGHT ];
+
+    // Uploads go through one staging buffer that grows to fit the largest upload.
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    ae3d::MemoryAllocation stagingMemory;
+    int stagingSize = 0;
+    void* stagingData = nullptr;
+
+    void DestroyStagingBuffer()
+    {
+        if (stagingBuffer != VK_NULL_HANDLE)
+        {
+            vkDestroyBuffer( GfxDeviceGlobal::device, stagingBuffer, nullptr );
+            ae3d::FreeMemory( stagingMemory );
+            stagingBuffer = VK_NULL_HANDLE;
+            stagingSize = 0;
+            stagingData = nullptr;
+        }
+    }
+
+    /// \return Offset of count elements in outPage. A new page is created if no page has a large enough free range.
+    std::uint32_t Allocate( GeometryArena& arena, std::uint32_t count, ArenaPage*& outPage )
+    {
+        for (std::size_t pageIndex = 0; pageIndex <= arena.pages.size(); ++pageIndex)
+        {
+            if (pageIndex == arena.pages.size())
+            {
+                const std::uint32_t pageCount = count > arena.pageElementCount ? count : arena.pageElementCount;
+
+                ArenaPage page;
+                CreateBuffer( page.buffer, static_cast< int >( pageCount * arena.elementSize ), page.memory, arena.usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, arena.debugName );
+                page.freeRanges.push_back( std::make_pair( 0u, pageCount ) );
+                arena.pages.push_back( page );
+            }
+
+            std::vector< std::pair< std::uint32_t, std::uint32_t > >& freeRanges = arena.pages[ pageIndex ].freeRanges;
+
+            for (std::size_t rangeIndex = 0; rangeIndex < freeRanges.size(); ++rangeIndex)
+            {
+                if (freeRanges[ rangeIndex ].second >= count)
+                {
+                    const std::uint32_t offset = freeRanges[ rangeIndex ].first;
+                    freeRanges[ rangeIndex ].first += count;
+                    freeRanges[ rangeIndex ].second -= count;
+
+                    if (freeRanges[ rangeIndex ].second == 0)
+                    {
+                        freeRanges.erase( std::begin( freeRanges ) + rangeIndex );
+                    }
+
+                    outPage = &arena.pages[ pageIndex ];
+                    return offset;
+                }
+            }
+        }
+
+        ae3d::System::Assert( false, "geometry arena page has no room for the allocation" );
+        return 0;
+    }
+
+    /// Returns a range into the free list of the page that owns buffer, merging it with adjacent free ranges.
+    void Free( GeometryArena& arena, VkBuffer buffer, std::uint32_t offset, std::uint32_t count )
+    {
+        for (ArenaPage& page : arena.pages)
+        {
+            if (page.buffer != buffer)
+            {
+                continue;
+            }
+
+            std::vector< std::pair< std::uint32_t, std::uint32_t > >& freeRanges = page.freeRanges;
+            auto next = std::lower_bound( std::begin( freeRanges ), std::end( freeRanges ), std::make_pair( offset, 0u ) );
+            auto range = freeRanges.insert( next, std::make_pair( offset, count ) );
+
+            if (range + 1 != std::end( freeRanges ) && range->first + range->second == (range + 1)->first)
+            {
+                range->second += (range + 1)->second;
+                range = freeRanges.erase( range + 1 ) - 1;
+            }
+
+            if (range != std::begin( freeRanges ) && (range - 1)->first + (range - 1)->second == range->first)
+            {
+                (range - 1)->second += range->second;
+                freeRanges.erase( range );
+            }
+
+            return;
+        }
+    }
+
+    /// Copies count elements into the page at offset.
+    void Upload( const GeometryArena& arena, ArenaPage& page, std::uint32_t offset, const void* data, std::uint32_t count )
+    {
+        const int size = static_cast< int >( count * arena.elementSize );
+
+        if (size > stagingSize)
+        {
+            DestroyStagingBuffer();
+            stagingSize = size > 4 * 1024 * 1024 ? size : 4 * 1024 * 1024;
+            CreateBuffer( stagingBuffer, stagingSize, stagingMemory, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "geometry staging buffer" );
+            stagingData = stagingMemory.mappedData;
+        }
+
+        std::memcpy( stagingData, data, size );
+        // CopyBuffer waits until the copy has finished, so the staging buffer can be reused right away.
+        CopyBuffer( stagingBuffer, page.buffer, size, offset * arena.elementSize );
+    }
+
+    /// Frees ranges of buffers that were regenerated during a frame. Called when the GPU has finished the frame.
+    /// \param frameIndex Frame whose fence has been waited.
+    void ReleasePendingAllocations( unsigned frameIndex )
+    {
+        for (const PendingFree& pendingFree : pendingFrees[ frameIndex ])
+        {
+            Free( verticesPTNTC, pendingFree.buffer, pendingFree.offset, pendingFree.count );
+            Free( verticesPTNTC_Skinned, pendingFree.buffer, pendingFree.offset, pendingFree.count );
+            Free( indices, pendingFree.buffer, pendingFree.offset, pendingFree.count );
+        }
+
+        pendingFrees[ frameIndex ].clear();
+    }
+
+    void DestroyArena( GeometryArena& arena )
+    {
+        for (ArenaPage& page : arena.pages)
+        {
+            vkDestroyBuffer( GfxDeviceGlobal::device, page.buffer, nullptr );
+            ae3d::FreeMemory( page.memory );
+        }
+
+        arena.pages.clear();
+    }
 }
 
 void ae3d::VertexBuffer::DestroyBuffers()
@@ -33,16 +211,21 @@ void ae3d::VertexBuffer::DestroyBuffers()
 
     for (std::size_t memoryIndex = 0; memoryIndex < VertexBufferGlobal::memoryToReleaseAtExit.size(); ++memoryIndex)
     {
-        vkFreeMemory( GfxDeviceGlobal::device, VertexBufferGlobal::memoryToReleaseAtExit[ memoryIndex ], nullptr );
+        FreeMemory( VertexBufferGlobal::memoryToReleaseAtExit[ memoryIndex ] );
     }
+
+    VertexBufferGlobal::DestroyArena( VertexBufferGlobal::verticesPTNTC );
+    VertexBufferGlobal::DestroyArena( VertexBufferGlobal::verticesPTNTC_Skinned );
+    VertexBufferGlobal::DestroyArena( VertexBufferGlobal::indices );
+    VertexBufferGlobal::DestroyStagingBuffer();
 }
 
-void ae3d::VertexBuffer::SetDebugName( const char* name )
+void ae3d::VertexBuffer::SetDebugName( const char* /*name*/ )
 {
-    debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)vertexBuffer, VK_OBJECT_TYPE_BUFFER, name );
+    // Non-dynamic buffers are shared by many meshes, so they keep their arena names.
 }
 
-void CopyBuffer( VkBuffer source, VkBuffer& destination, int bufferSize )
+void CopyBuffer( VkBuffer source, VkBuffer& destination, int bufferSize, VkDeviceSize destinationOffset )
 {
     VkCommandBufferAllocateInfo cmdBufInfo = {};
     cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -60,6 +243,7 @@ void CopyBuffer( VkBuffer source, VkBuffer& destination, int bufferSize )
 
     VkBufferCopy copyRegion = {};
     copyRegion.size = bufferSize;
+    copyRegion.dstOffset = destinationOffset;
 
     err = vkBeginCommandBuffer( copyCommandBuffer, &cmdBufferBeginInfo );
     AE3D_CHECK_VULKAN( err, "begin staging copy" );
@@ -83,7 +267,7 @@ void CopyBuffer( VkBuffer source, VkBuffer& destination, int bufferSize )
     vkFreeCommandBuffers( GfxDeviceGlobal::device, cmdBufInfo.commandPool, 1, &copyCommandBuffer );
 }
 
-void CreateBuffer( VkBuffer& buffer, int bufferSize, VkDeviceMemory& memory, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryFlags, const char* debugName )
+void CreateBuffer( VkBuffer& buffer, int bufferSize, ae3d::MemoryAllocation& memory, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryFlags, const char* debugName )
 {
     VkBufferCreateInfo bufferInfo = {};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -93,60 +277,7 @@ void CreateBuffer( VkBuffer& buffer, int bufferSize, VkDeviceMemory& memory, VkB
     AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
     debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)buffer, VK_OBJECT_TYPE_BUFFER, debugName );
 
-    VkMemoryRequirements memReqs;
-    VkMemoryAllocateInfo memAlloc = {};
-    memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-
-    vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, buffer, &memReqs );
-    memAlloc.allocationSize = memReqs.size;
-    memAlloc.memoryTypeIndex = ae3d::GetMemoryType( memReqs.memoryTypeBits, memoryFlags );
-    err = vkAllocateMemory( GfxDeviceGlobal::device, &memAlloc, nullptr, &memory );
-    AE3D_CHECK_VULKAN( err, "vkAllocateMemory" );
-    Statistics::IncAllocCalls();
-    Statistics::IncTotalAllocCalls();
-
-    err = vkBindBufferMemory( GfxDeviceGlobal::device, buffer, memory, 0 );
-    AE3D_CHECK_VULKAN( err, "vkBindBufferMemory" );
-}
-
-void MarkForFreeing( VkBuffer vertexBuffer, VkDeviceMemory vertexMem, VkBuffer indexBuffer, VkDeviceMemory indexMem )
-{
-    for (std::size_t memoryIndex = 0; memoryIndex < VertexBufferGlobal::memoryToReleaseAtExit.size(); ++memoryIndex)
-    {
-        if (VertexBufferGlobal::memoryToReleaseAtExit[ memoryIndex ] == vertexMem)
-        {
-            VertexBufferGlobal::memoryToReleaseAtExit.erase( std::begin( VertexBufferGlobal::memoryToReleaseAtExit ) + memoryIndex );
-        }
-    }
-
-    for (std::size_t memoryIndex = 0; memoryIndex < VertexBufferGlobal::memoryToReleaseAtExit.size(); ++memoryIndex)
-    {
-        if (VertexBufferGlobal::memoryToReleaseAtExit[ memoryIndex ] == indexMem)
-        {
-            VertexBufferGlobal::memoryToReleaseAtExit.erase( std::begin( VertexBufferGlobal::memoryToReleaseAtExit ) + memoryIndex );
-        }
-    }
-
-    for (std::size_t bufferIndex = 0; bufferIndex < VertexBufferGlobal::buffersToReleaseAtExit.size(); ++bufferIndex)
-    {
-        if (VertexBufferGlobal::buffersToReleaseAtExit[ bufferIndex ] == vertexBuffer)
-        {
-            VertexBufferGlobal::buffersToReleaseAtExit.erase( std::begin( VertexBufferGlobal::buffersToReleaseAtExit ) + bufferIndex );
-        }
-    }
-
-    for (std::size_t bufferIndex = 0; bufferIndex < VertexBufferGlobal::buffersToReleaseAtExit.size(); ++bufferIndex)
-    {
-        if (VertexBufferGlobal::buffersToReleaseAtExit[ bufferIndex ] == indexBuffer)
-        {
-            VertexBufferGlobal::buffersToReleaseAtExit.erase( std::begin( VertexBufferGlobal::buffersToReleaseAtExit ) + bufferIndex );
-        }
-    }
-
-    vkFreeMemory( GfxDeviceGlobal::device, vertexMem, nullptr );
-    vkFreeMemory( GfxDeviceGlobal::device, indexMem, nullptr );
-    GfxDeviceGlobal::pendingFreeVBs.Add( vertexBuffer );
-    GfxDeviceGlobal::pendingFreeVBs.Add( indexBuffer );
+    memory = ae3d::AllocateAndBindBuffer( buffer, memoryFlags, debugName );
 }
 
 void ae3d::VertexBuffer::GenerateVertexBuffer( const void* vertexData, int vertexBufferSize, int vertexStride, const void* indexData, int indexBufferSize )
@@ -155,61 +286,26 @@ void ae3d::VertexBuffer::GenerateVertexBuffer( const void* vertexData, int verte
     System::Assert( vertexData != nullptr, "vertexData not initialized" );
     System::Assert( indexData != nullptr, "indexData not initialized" );
 
-    if (vertexBuffer != VK_NULL_HANDLE)
+    if (vertexAllocation.count != 0)
     {
-        MarkForFreeing( vertexBuffer, vertexMem, indexBuffer, indexMem );
+        auto& pendingFrees = VertexBufferGlobal::pendingFrees[ GfxDeviceGlobal::frameIndex ];
+        pendingFrees.push_back( { vertexBuffer, vertexAllocation.offset, vertexAllocation.count } );
+        pendingFrees.push_back( { indexBuffer, indexAllocation.offset, indexAllocation.count } );
     }
 
-    // Vertex buffer
-    const bool shouldCreateVertexBuffer = stagingBuffers.vertices.size != vertexBufferSize;
-
-    if (shouldCreateVertexBuffer)
-    {
-        stagingBuffers.vertices.size = vertexBufferSize;
-        CreateBuffer( stagingBuffers.vertices.buffer, vertexBufferSize, stagingBuffers.vertices.memory, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "staging vertex buffer" );
-        VertexBufferGlobal::buffersToReleaseAtExit.push_back( stagingBuffers.vertices.buffer );
-        VertexBufferGlobal::memoryToReleaseAtExit.push_back( stagingBuffers.vertices.memory );
-    }
-    
-    void* bufferData = nullptr;
-    VkResult err = vkMapMemory( GfxDeviceGlobal::device, stagingBuffers.vertices.memory, 0, vertexBufferSize, 0, &bufferData );
-    AE3D_CHECK_VULKAN( err, "map vertex memory" );
+    VertexBufferGlobal::GeometryArena& vertexArena = vertexFormat == VertexFormat::PTNTC_Skinned ? VertexBufferGlobal::verticesPTNTC_Skinned : VertexBufferGlobal::verticesPTNTC;
+    System::Assert( vertexArena.elementSize == static_cast< std::uint32_t >( vertexStride ), "vertex stride does not match the arena" );
 
-    std::memcpy( bufferData, vertexData, vertexBufferSize );
-    vkUnmapMemory( GfxDeviceGlobal::device, stagingBuffers.vertices.memory );
+    VertexBufferGlobal::ArenaPage* page = nullptr;
+    vertexAllocation.count = static_cast< std::uint32_t >( vertexBufferSize / vertexStride );
+    vertexAllocation.offset = VertexBufferGlobal::Allocate( vertexArena, vertexAllocation.count, page );
+    VertexBufferGlobal::Upload( vertexArena, *page, vertexAllocation.offset, vertexData, vertexAllocation.count );
+    vertexBuffer = page->buffer;
 
-    {
-        CreateBuffer( vertexBuffer, vertexBufferSize, vertexMem, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "vertex buffer" );
-        VertexBufferGlobal::buffersToReleaseAtExit.push_back( vertexBuffer );
-        VertexBufferGlobal::memoryToReleaseAtExit.push_back( vertexMem );
-    }
-    
-    CopyBuffer( stagingBuffers.vertices.buffer, vertexBuffer, vertexBufferSize );
-
-    // Index buffer
-    const bool shouldCreateIndexBuffer = stagingBuffers.indices.size != indexBufferSize;
-    
-    if (shouldCreateIndexBuffer)
-    {
-        stagingBuffers.indices.size = indexBufferSize;
-        CreateBuffer( stagingBuffers.indices.buffer, indexBufferSize, stagingBuffers.indices.memory, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "staging index buffer" );
-        VertexBufferGlobal::buffersToReleaseAtExit.push_back( stagingBuffers.indices.buffer );
-        VertexBufferGlobal::memoryToReleaseAtExit.push_back( stagingBuffers.indices.memory );
-    }
-    
-    err = vkMapMemory( GfxDeviceGlobal::device, stagingBuffers.indices.memory, 0, indexBufferSize, 0, &bufferData );
-    AE3D_CHECK_VULKAN( err, "map staging index memory" );
-
-    std::memcpy( bufferData, indexData, indexBufferSize );
-    vkUnmapMemory( GfxDeviceGlobal::device, stagingBuffers.indices.memory );
-
-    {
-        CreateBuffer( indexBuffer, indexBufferSize, indexMem, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "index buffer" );
-        VertexBufferGlobal::buffersToReleaseAtExit.push_back( indexBuffer );
-        VertexBufferGlobal::memoryToReleaseAtExit.push_back( indexMem );
-    }
-    
-    CopyBuffer( stagingBuffers.indices.buffer, indexBuffer, indexBufferSize );
+    indexAllocation.count = static_cast< std::uint32_t >( indexBufferSize ) / VertexBufferGlobal::indices.elementSize;
+    indexAllocation.offset = VertexBufferGlobal::Allocate( VertexBufferGlobal::indices, indexAllocation.count, page );
+    VertexBufferGlobal::Upload( VertexBufferGlobal::indices, *page, indexAllocation.offset, indexData, indexAllocation.count );
+    indexBuffer = page->buffer;
 
     CreateInputState( vertexStride );
 }
@@ -359,22 +455,41 @@ void ae3d::VertexBuffer::CreateInputState( int vertexStride )
     inputStateCreateInfo.pVertexAttributeDescriptions = &attributeDescriptions[ 0 ];
 }
 
+VkPipelineVertexInputStateCreateInfo* ae3d::VertexBuffer::GetInputState( VertexFormat format )
+{
+    // Generate functions convert PTC and PTN vertices to PTNTC, so only PTNTC and PTNTC_Skinned layouts exist.
+    static VertexBuffer* const formatBuffers = []()
+    {
+        static VertexBuffer buffers[ 2 ];
+        buffers[ 0 ].vertexFormat = VertexFormat::PTNTC;
+        buffers[ 0 ].CreateInputState( sizeof( VertexPTNTC ) );
+        buffers[ 1 ].vertexFormat = VertexFormat::PTNTC_Skinned;
+        buffers[ 1 ].CreateInputState( sizeof( VertexPTNTC_Skinned ) );
+        return buffers;
+    }();
+
+    return formatBuffers[ format == VertexFormat::PTNTC_Skinned ? 1 : 0 ].GetInputState();
+}
+
 void ae3d::VertexBuffer::GenerateDynamic( int faceCount, int vertexCount )
 {
     vertexFormat = VertexFormat::PTNTC;
     elementCount = faceCount * 3;
 
-    CreateBuffer( stagingBuffers.vertices.buffer, vertexCount * sizeof( VertexPTNTC ), stagingBuffers.vertices.memory, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "dynamic vertex buffer" );
+    MemoryAllocation vertexMemory;
+    CreateBuffer( stagingBuffers.vertices.buffer, vertexCount * sizeof( VertexPTNTC ), vertexMemory, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "dynamic vertex buffer" );
     stagingBuffers.vertices.size = vertexCount * sizeof( VertexPTNTC );
+    stagingBuffers.vertices.mappedData = vertexMemory.mappedData;
 
-    VkResult err = vkMapMemory( GfxDeviceGlobal::device, stagingBuffers.vertices.memory, 0, stagingBuffers.vertices.size, 0, &stagingBuffers.vertices.mappedData );
-    AE3D_CHECK_VULKAN( err, "vkMapMemory GenerateDynamic" );
-
-    CreateBuffer( stagingBuffers.indices.buffer, elementCount * 2, stagingBuffers.indices.memory, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "dynamic index buffer" );
+    MemoryAllocation indexMemory;
+    CreateBuffer( stagingBuffers.indices.buffer, elementCount * 2, indexMemory, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "dynamic index buffer" );
     stagingBuffers.indices.size = elementCount * 2;
+    stagingBuffers.indices.mappedData = indexMemory.mappedData;
 
-    err = vkMapMemory( GfxDeviceGlobal::device, stagingBuffers.indices.memory, 0, stagingBuffers.indices.size, 0, &stagingBuffers.indices.mappedData );
-    AE3D_CHECK_VULKAN( err, "vkMapMemory GenerateDynamic" );
+    VertexBufferGlobal::buffersToReleaseAtExit.push_back( stagingBuffers.vertices.buffer );
+    VertexBufferGlobal::buffersToReleaseAtExit.push_back( stagingBuffers.indices.buffer );
+    VertexBufferGlobal::memoryToReleaseAtExit.push_back( vertexMemory );
+    VertexBufferGlobal::memoryToReleaseAtExit.push_back( indexMemory );
 
     vertexBuffer = stagingBuffers.vertices.buffer;
     indexBuffer = stagingBuffers.indices.buffer;
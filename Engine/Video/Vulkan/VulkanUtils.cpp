@@ -190,17 +190,26 @@ namespace debug
 
 namespace ae3d
 {
-    std::uint64_t GetPSOHash( ae3d::VertexBuffer& vertexBuffer, ae3d::Shader& shader, ae3d::GfxDevice::BlendMode blendMode,
+    std::uint64_t GetPSOHash( ae3d::VertexBuffer::VertexFormat vertexFormat, ae3d::Shader& shader, ae3d::GfxDevice::BlendMode blendMode,
         ae3d::GfxDevice::DepthFunc depthFunc, ae3d::GfxDevice::CullMode cullMode, ae3d::GfxDevice::FillMode fillMode, VkRenderPass renderPass, ae3d::GfxDevice::PrimitiveTopology topology )
     {
-        std::uint64_t outResult = (ptrdiff_t)&vertexBuffer;
-        outResult += (ptrdiff_t)&shader;
-        outResult += (unsigned)blendMode;
-        outResult += ((unsigned)depthFunc) * 2;
-        outResult += ((unsigned)cullMode) * 4;
-        outResult += ((unsigned)fillMode) * 8;
-        outResult += ((ptrdiff_t)&renderPass) * 16;
-        outResult += ((unsigned)topology) * 32;
+        const std::uint64_t values[] =
+        {
+            (std::uint64_t)&shader, (std::uint64_t)renderPass, (std::uint64_t)vertexFormat, (std::uint64_t)blendMode,
+            (std::uint64_t)depthFunc, (std::uint64_t)cullMode, (std::uint64_t)fillMode, (std::uint64_t)topology
+        };
+
+        // FNV-1a over the values' bytes.
+        std::uint64_t outResult = 14695981039346656037ull;
+
+        for (std::uint64_t value : values)
+        {
+            for (int byteIndex = 0; byteIndex < 8; ++byteIndex)
+            {
+                outResult ^= (value >> (byteIndex * 8)) & 0xFF;
+                outResult *= 1099511628211ull;
+            }
+        }
 
         return outResult;
     }
@@ -2,10 +2,13 @@
 #define VULKAN_UTILS
 
 #include <vulkan/vulkan.h>
+#include "VertexBuffer.hpp"
+
+/// Frames that the CPU can record while the GPU is still executing earlier ones. Per-frame resources are reused after their frame's fence.
+constexpr unsigned MAX_FRAMES_IN_FLIGHT = 2;
 
 namespace ae3d
 {
-	class VertexBuffer;
 	class Shader;
 
 	namespace GfxDevice
@@ -20,11 +23,62 @@ namespace ae3d
     void SetImageLayout( VkCommandBuffer cmdbuffer, VkImage image, VkImageAspectFlags aspectMask, VkImageLayout oldImageLayout,
         VkImageLayout newImageLayout, unsigned layerCount, unsigned mipLevel, unsigned mipLevelCount );
 
-    std::uint64_t GetPSOHash( ae3d::VertexBuffer& vertexBuffer, ae3d::Shader& shader, ae3d::GfxDevice::BlendMode blendMode,
+    /// \return Hash of a PSO's state. PSOs don't depend on the vertex buffer, only on its format, so buffers of the same format share PSOs.
+    std::uint64_t GetPSOHash( ae3d::VertexBuffer::VertexFormat vertexFormat, ae3d::Shader& shader, ae3d::GfxDevice::BlendMode blendMode,
         ae3d::GfxDevice::DepthFunc depthFunc, ae3d::GfxDevice::CullMode cullMode, ae3d::GfxDevice::FillMode fillMode, VkRenderPass renderPass, ae3d::GfxDevice::PrimitiveTopology topology );
 
     void CreateInstance( VkInstance* outInstance );
     std::uint32_t GetMemoryType( std::uint32_t typeBits, VkFlags properties );
+
+    /// What a memory allocation is bound to. Buffers and images are suballocated from separate blocks, so they never share a bufferImageGranularity page.
+    enum class MemoryResource { Buffer, Image, RenderTarget };
+
+    /// Range of device memory. Resources are bound to memory at offset.
+    struct MemoryAllocation
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        /// Mapped address of offset, or null if the memory isn't host-visible.
+        void* mappedData = nullptr;
+        /// Index of the block that the range is suballocated from, or ~0u for a dedicated allocation.
+        unsigned block = ~0u;
+        /// Range in the block's allocator.
+        unsigned range = ~0u;
+        std::uint32_t memoryTypeIndex = 0;
+    };
+
+    /// Used and free bytes of a memory heap, summed over its blocks and dedicated allocations.
+    struct MemoryHeapStatistics
+    {
+        /// Bytes of resources.
+        VkDeviceSize usedBytes = 0;
+        /// Bytes that have been allocated from the driver but are not used by resources.
+        VkDeviceSize freeBytes = 0;
+        /// Size of the largest free range in any block.
+        VkDeviceSize largestFreeBytes = 0;
+        unsigned blockCount = 0;
+        unsigned dedicatedCount = 0;
+    };
+
+    /// Suballocates memory from a block of the memory type, or allocates it from the driver if it's large.
+    /// Host-visible memory is persistently mapped.
+    /// \param requirements Requirements of the resource.
+    /// \param properties Memory properties.
+    /// \param resource What the memory is bound to. Large render targets get dedicated allocations.
+    /// \param debugName Name of a dedicated allocation in debug tools.
+    /// \return Allocation.
+    MemoryAllocation AllocateMemory( const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, MemoryResource resource, const char* debugName );
+    /// Allocates memory for a buffer and binds it.
+    MemoryAllocation AllocateAndBindBuffer( VkBuffer buffer, VkMemoryPropertyFlags properties, const char* debugName );
+    /// Allocates memory for an image and binds it.
+    MemoryAllocation AllocateAndBindImage( VkImage image, VkMemoryPropertyFlags properties, MemoryResource resource, const char* debugName );
+    /// Frees memory from AllocateMemory and resets allocation. Resources bound to it must not be in use by the GPU.
+    void FreeMemory( MemoryAllocation& allocation );
+    /// Frees all memory blocks. Called after all resources have been destroyed.
+    void DestroyMemoryBlocks();
+    /// \param outStatistics Receives statistics of VK_MAX_MEMORY_HEAPS heaps.
+    void GetMemoryHeapStatistics( MemoryHeapStatistics* outStatistics );
 }
 
 namespace debug
@@ -0,0 +1,88 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "Window.hpp"
+#include "GfxDevice.hpp"
+
+// Headless window used with RENDERER_NULL. It never opens a display connection.
+
+namespace ae3d
+{
+    void CreateRenderer( int samples );
+}
+
+namespace WindowGlobal
+{
+    bool isOpen = false;
+    const int eventStackSize = 15;
+    ae3d::WindowEvent eventStack[ eventStackSize ];
+    int eventIndex = -1;
+    int presentInterval = 1;
+    int windowWidth = 640;
+    int windowHeight = 480;
+}
+
+void PlatformInitGamePad()
+{
+}
+
+bool ae3d::Window::IsOpen()
+{
+    return WindowGlobal::isOpen;
+}
+
+void ae3d::Window::Create( int width, int height, WindowCreateFlags flags )
+{
+    WindowGlobal::windowWidth = width == 0 ? WindowGlobal::windowWidth : width;
+    WindowGlobal::windowHeight = height == 0 ? WindowGlobal::windowHeight : height;
+
+    GfxDevice::Init( WindowGlobal::windowWidth, WindowGlobal::windowHeight );
+
+    int samples = 1;
+
+    if (flags & ae3d::WindowCreateFlags::MSAA4)
+    {
+        samples = 4;
+    }
+    else if (flags & ae3d::WindowCreateFlags::MSAA8)
+    {
+        samples = 8;
+    }
+    else if (flags & ae3d::WindowCreateFlags::MSAA16)
+    {
+        samples = 16;
+    }
+
+    ae3d::CreateRenderer( samples );
+    WindowGlobal::isOpen = true;
+}
+
+void ae3d::Window::SetTitle( const char* /*title*/ )
+{
+}
+
+void ae3d::Window::GetSize( int& outWidth, int& outHeight )
+{
+    outWidth = WindowGlobal::windowWidth;
+    outHeight = WindowGlobal::windowHeight;
+}
+
+void ae3d::Window::PumpEvents()
+{
+}
+
+void ae3d::Window::SwapBuffers()
+{
+    GfxDevice::Present();
+}
+
+bool ae3d::Window::PollEvent( WindowEvent& outEvent )
+{
+    if (WindowGlobal::eventIndex == -1)
+    {
+        return false;
+    }
+
+    outEvent = WindowGlobal::eventStack[ WindowGlobal::eventIndex ];
+    --WindowGlobal::eventIndex;
+    return true;
+}